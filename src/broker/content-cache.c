@@ -15,11 +15,15 @@
 #endif
 #include <inttypes.h>
 #include <czmq.h>
+#include <jansson.h>
 #include <flux/core.h>
 #include "src/common/libutil/xzmalloc.h"
 #include "src/common/libutil/blobref.h"
-#include "src/common/libutil/iterators.h"
+#include "src/common/libutil/blobvec.h"
+#include "src/common/libutil/blobz.h"
+#include "src/common/libutil/digestmap.h"
 #include "src/common/libutil/log.h"
+#include "src/common/libkvs/treeobj.h"
 
 #include "attr.h"
 #include "content-cache.h"
@@ -39,6 +43,11 @@ static const uint32_t default_blob_size_limit = 1048576*1024;
 
 static const uint32_t default_flush_batch_limit = 256;
 
+/* Maximum number of blobs sent upstream in one load-batch or store-batch
+ * request by ranks > 0.
+ */
+static const uint32_t default_upstream_batch_limit = 256;
+
 
 struct cache_entry {
     void *data;
@@ -51,14 +60,72 @@ struct cache_entry {
     uint8_t store_pending:1;
     zlist_t *load_requests;
     zlist_t *store_requests;
+    zlist_t *batch_requests;        /* struct batch_request waiting on entry */
+    int batch_pins;                 /* batch responses referencing data */
     int lastused;
+    uint8_t frequent:1;             /* used again after it became valid */
+    uint8_t prefetch_dir:1;         /* prefetch dirrefs once loaded */
+    uint8_t compressed:1;           /* data/len hold blobz encoding */
+    uint8_t incompressible:1;       /* compression was tried, not useful */
+    struct lru_list *lru;           /* eviction list entry is on, if any */
+    struct cache_entry *lru_prev;
+    struct cache_entry *lru_next;
+};
+
+/* Entries that may be dropped without data loss (valid, clean, not
+ * pending, and not pinned by a batch response) are kept on one of
+ * four intrusive LRU lists, so the purge never has to look at entries
+ * that are ineligible.  Recency and frequency are kept apart as in a
+ * segmented LRU:  entries used once since becoming valid are on a
+ * "recent" list, and entries used again are promoted to a "frequent"
+ * list.  Recent entries are evicted before frequent ones, so a burst
+ * of one-time loads does not flush the working set.  Each of these is
+ * further split by size, per content.purge-large-entry, so the size
+ * target can be met by evicting large entries without walking past
+ * small ones.  Entries are appended when they become eligible or are
+ * used, so each list is (approximately) in 'lastused' order.
+ */
+struct lru_list {
+    struct cache_entry *head;       /* least recently used */
+    struct cache_entry *tail;
+    int count;
+};
+
+enum {
+    LRU_RECENT_SMALL = 0,
+    LRU_RECENT_LARGE = 1,
+    LRU_FREQUENT_SMALL = 2,
+    LRU_FREQUENT_LARGE = 3,
+    LRU_LIST_COUNT = 4,
+};
+
+/* A content.load-batch or content.store-batch request in progress.
+ * Each item refers to a cache entry.  The response is sent once all
+ * items have completed.  Load items pin their (valid) entry so its data
+ * remains available until the response is sent.
+ */
+struct batch_item {
+    struct cache_entry *e;
+    int errnum;
+    uint8_t done:1;
+    uint8_t pinned:1;
+    uint8_t accept_compressed:1;    /* load item may be sent compressed */
+};
+
+struct batch_request {
+    content_cache_t *cache;
+    flux_msg_t *msg;
+    bool store;
+    int count;
+    int pending;
+    struct batch_item *items;
 };
 
 struct content_cache {
     flux_t *h;
     flux_msg_handler_t **handlers;
     uint32_t rank;
-    zhash_t *entries;
+    struct digestmap *entries;      /* cache entries by digest */
     uint8_t backing:1;              /* 'content.backing' service available */
     char *backing_name;
     char hash_name[BLOBREF_MAX_STRING_SIZE];
@@ -74,13 +141,39 @@ struct content_cache {
     uint32_t purge_old_entry;
     uint32_t purge_large_entry;
 
+    uint32_t prefetch;              /* prefetch on kvs.setroot (rank > 0) */
+    uint32_t compress;              /* move blobs upstream compressed */
+
     uint32_t acct_size;             /* total size of all cache entries */
     uint32_t acct_valid;            /* count of valid cache entries */
     uint32_t acct_dirty;            /* count of dirty cache entries */
+    uint32_t acct_compressed;       /* count of compressed cache entries */
+
+    struct lru_list lru[LRU_LIST_COUNT];
+
+    zlist_t *load_queue;            /* entries awaiting upstream load-batch */
+    zlist_t *store_queue;           /* entries awaiting upstream store-batch */
+    flux_watcher_t *prep_w;         /* sends queued upstream batches */
+
+    uint64_t load_requests;         /* load request messages received */
+    uint64_t load_blobs;            /* blobs requested by those messages */
+    uint64_t store_requests;        /* store request messages received */
+    uint64_t store_blobs;           /* blobs stored by those messages */
+    uint64_t hits;                  /* loads satisfied from cache */
+    uint64_t misses;                /* loads that went upstream/to backing */
+    uint64_t evictions;             /* entries dropped by cache purge */
+    uint64_t load_coalesced;        /* loads joining one already upstream */
+    uint64_t prefetch_blobs;        /* loads started by prefetch */
+    uint64_t inflations;            /* compressed entries decompressed */
 };
 
 static void flush_respond (content_cache_t *cache);
 static int cache_flush (content_cache_t *cache);
+static void batch_notify (content_cache_t *cache, struct cache_entry *e,
+                          bool store, int errnum);
+static void remove_entry (content_cache_t *cache, struct cache_entry *e);
+static void cache_prefetch_dirrefs (content_cache_t *cache,
+                                    struct cache_entry *e);
 
 static void message_list_destroy (zlist_t **l)
 {
@@ -160,8 +253,11 @@ static void cache_entry_destroy (void *arg)
             free (e->blobref);
         assert (!e->load_requests || zlist_size (e->load_requests) == 0);
         assert (!e->store_requests || zlist_size (e->store_requests) == 0);
+        assert (!e->batch_requests || zlist_size (e->batch_requests) == 0);
+        assert (e->batch_pins == 0);
         message_list_destroy (&e->load_requests);
         message_list_destroy (&e->store_requests);
+        zlist_destroy (&e->batch_requests);
         free (e);
     }
 }
@@ -187,9 +283,11 @@ static struct cache_entry *cache_entry_create (const char *blobref)
 }
 
 /* Make an invalid cache entry valid, filling in its data.
+ * If 'compressed' is true, 'data' is in blobz encoding.
  * Returns 0 on success, -1 on failure with errno set.
  */
-static int cache_entry_fill (struct cache_entry *e, const void *data, int len)
+static int cache_entry_fill (struct cache_entry *e, const void *data, int len,
+                             bool compressed)
 {
     int rc = -1;
 
@@ -202,54 +300,204 @@ static int cache_entry_fill (struct cache_entry *e, const void *data, int len)
         }
         memcpy (e->data, data, len);
         e->len = len;
+        e->compressed = compressed ? 1 : 0;
     }
     rc = 0;
 done:
     return rc;
 }
 
-/* Insert a cache entry, by blobref.
+/* Eviction list maintenance.
+ */
+static void lru_unlink (struct cache_entry *e)
+{
+    struct lru_list *l = e->lru;
+
+    if (l) {
+        if (e->lru_prev)
+            e->lru_prev->lru_next = e->lru_next;
+        else
+            l->head = e->lru_next;
+        if (e->lru_next)
+            e->lru_next->lru_prev = e->lru_prev;
+        else
+            l->tail = e->lru_prev;
+        l->count--;
+        e->lru = NULL;
+        e->lru_prev = e->lru_next = NULL;
+    }
+}
+
+static void lru_append (struct lru_list *l, struct cache_entry *e)
+{
+    assert (e->lru == NULL);
+    e->lru_prev = l->tail;
+    e->lru_next = NULL;
+    if (l->tail)
+        l->tail->lru_next = e;
+    else
+        l->head = e;
+    l->tail = e;
+    l->count++;
+    e->lru = l;
+}
+
+static bool lru_eligible (struct cache_entry *e)
+{
+    return (e->valid && !e->dirty && !e->load_pending && !e->store_pending
+                                  && e->batch_pins == 0);
+}
+
+/* Call after entry 'e' has been used or changed state.  The entry is
+ * moved to the tail of the appropriate list if it is eligible for
+ * eviction, otherwise it is removed from its list.
+ */
+static void lru_update (content_cache_t *cache, struct cache_entry *e)
+{
+    int i;
+
+    lru_unlink (e);
+    if (lru_eligible (e)) {
+        i = e->frequent ? LRU_FREQUENT_SMALL : LRU_RECENT_SMALL;
+        if (e->len >= cache->purge_large_entry)
+            i++; /* LRU_*_LARGE */
+        lru_append (&cache->lru[i], e);
+    }
+}
+
+/* Record a use of entry 'e' at the current epoch.  A valid entry
+ * that is used again is promoted to the frequent list.
+ */
+static void lru_touch (content_cache_t *cache, struct cache_entry *e,
+                       bool reused)
+{
+    if (reused)
+        e->frequent = 1;
+    e->lastused = cache->epoch;
+    lru_update (cache, e);
+}
+
+/* Compression
+ *
+ * A valid entry may hold its blob compressed (blobz encoding), in which
+ * case 'len' is the compressed size and cache accounting reflects it.
+ * Entries are compressed in place when a compressed copy is needed, e.g.
+ * to answer a load-batch item that accepts compressed data, or when
+ * stored compressed by a downstream peer.  They are decompressed in place
+ * on first plain use, since a consumer that wants plain data once is
+ * likely to want it again.
+ */
+
+/* Replace the data of valid entry 'e' with 'data' of 'len' bytes,
+ * taking ownership of 'data'.
+ */
+static void cache_entry_replace (content_cache_t *cache,
+                                 struct cache_entry *e,
+                                 void *data, int len, bool compressed)
+{
+    free (e->data);
+    cache->acct_size -= e->len;
+    e->data = data;
+    e->len = len;
+    cache->acct_size += e->len;
+    if (e->compressed && !compressed)
+        cache->acct_compressed--;
+    else if (!e->compressed && compressed)
+        cache->acct_compressed++;
+    e->compressed = compressed ? 1 : 0;
+    lru_update (cache, e);
+}
+
+/* Ensure valid entry 'e' holds uncompressed data.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+static int cache_entry_inflate (content_cache_t *cache, struct cache_entry *e)
+{
+    void *data;
+    int len;
+
+    if (!e->compressed)
+        return 0;
+    if (blobz_decompress (e->data, e->len, &data, &len) < 0)
+        return -1;
+    cache_entry_replace (cache, e, data, len, false);
+    cache->inflations++;
+    return 0;
+}
+
+/* Compress valid entry 'e' if worthwhile.  Failure is not fatal, since
+ * the entry remains usable uncompressed.
+ */
+static void cache_entry_deflate (content_cache_t *cache, struct cache_entry *e)
+{
+    void *data;
+    int len;
+    int rc;
+
+    if (e->compressed || e->incompressible)
+        return;
+    if ((rc = blobz_compress (e->data, e->len, &data, &len)) < 0) {
+        flux_log_error (cache->h, "%s", __FUNCTION__);
+        return;
+    }
+    if (rc == 0) {
+        e->incompressible = 1;
+        return;
+    }
+    cache_entry_replace (cache, e, data, len, true);
+}
+
+/* Insert a cache entry, by digest of its blobref.
  * Returns 0 on success, -1 on failure with errno set.
  * Side effect: destroys entry on failure.
  */
-static int insert_entry (content_cache_t *cache, struct cache_entry *e)
+static int insert_entry (content_cache_t *cache, struct cache_entry *e,
+                         const void *hash, int hash_len)
 {
-    if (zhash_insert (cache->entries, e->blobref, e) < 0) {
+    if (digestmap_insert (cache->entries, hash, hash_len, e) < 0) {
         cache_entry_destroy (e);
-        errno = ENOMEM;
         return -1;
     }
-    zhash_freefn (cache->entries, e->blobref, cache_entry_destroy);
     if (e->valid) {
         cache->acct_size += e->len;
         cache->acct_valid++;
+        if (e->compressed)
+            cache->acct_compressed++;
     }
     if (e->dirty)
         cache->acct_dirty++;
     return 0;
 }
 
-/* Look up a cache entry, by blobref.
+/* Look up a cache entry, by digest.
  * Returns entry on success, NULL on failure.
  * N.B. errno is not set
  */
 static struct cache_entry *lookup_entry (content_cache_t *cache,
-                                         const char *blobref)
+                                         const void *hash, int hash_len)
 {
-    return zhash_lookup (cache->entries, blobref);
+    return digestmap_lookup (cache->entries, hash, hash_len);
 }
 
 /* Remove a cache entry.
  */
 static void remove_entry (content_cache_t *cache, struct cache_entry *e)
 {
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    int hash_len;
+
+    lru_unlink (e);
     if (e->valid) {
         cache->acct_size -= e->len;
         cache->acct_valid--;
+        if (e->compressed)
+            cache->acct_compressed--;
     }
     if (e->dirty)
         cache->acct_dirty--;
-    zhash_delete (cache->entries, e->blobref);
+    hash_len = blobref_strtohash (e->blobref, hash, sizeof (hash));
+    assert (hash_len > 0); /* validated on insert */
+    digestmap_delete (cache->entries, hash, hash_len);
 }
 
 /* Load operation
@@ -263,26 +511,32 @@ static void remove_entry (content_cache_t *cache, struct cache_entry *e)
  * an error such as ENOENT.
  */
 
-static void cache_load_continuation (flux_future_t *f, void *arg)
+/* Complete a load from upstream or the backing store for entry 'e'.
+ * If 'errnum' is nonzero, the load failed and the entry is removed,
+ * otherwise it is filled with 'data' and made valid.  If 'compressed'
+ * is true, 'data' is in blobz encoding.
+ */
+static void cache_load_complete (content_cache_t *cache,
+                                 struct cache_entry *e,
+                                 int errnum,
+                                 const void *data,
+                                 int len,
+                                 bool compressed)
 {
-    content_cache_t *cache = arg;
-    struct cache_entry *e = flux_future_aux_get (f, "entry");
-    const void *data = NULL;
-    int len = 0;
-    int saved_errno;
-    int rc = -1;
-
     e->load_pending = 0;
-    if (flux_content_load_get (f, &data, &len) < 0) {
-        if (errno == ENOSYS && cache->rank == 0)
-            errno = ENOENT;
-        saved_errno = errno;
-        if (errno != ENOENT)
+    if (e->valid)       /* filled by a store while load was in progress */
+        errnum = 0;
+    if (errnum != 0) {
+        if (errnum == ENOSYS && cache->rank == 0)
+            errnum = ENOENT;
+        if (errnum != ENOENT) {
+            errno = errnum;
             flux_log_error (cache->h, "content load");
+        }
         goto done;
     }
-    if (cache_entry_fill (e, data, len) < 0) {
-        saved_errno = errno;
+    if (cache_entry_fill (e, data, len, compressed) < 0) {
+        errnum = errno;
         flux_log_error (cache->h, "content load");
         goto done;
     }
@@ -290,33 +544,170 @@ static void cache_load_continuation (flux_future_t *f, void *arg)
         e->valid = 1;
         cache->acct_valid++;
         cache->acct_size += len;
+        if (e->compressed)
+            cache->acct_compressed++;
+    }
+    lru_touch (cache, e, false);
+    if (e->load_requests && cache_entry_inflate (cache, e) < 0) {
+        errnum = errno;
+        flux_log_error (cache->h, "content load");
     }
-    e->lastused = cache->epoch;
-    rc = 0;
 done:
-    if (respond_requests_raw (&e->load_requests, cache->h,
-                                                    rc < 0 ? saved_errno : 0,
+    if (respond_requests_raw (&e->load_requests, cache->h, errnum,
                                                     e->data, e->len) < 0)
         flux_log_error (cache->h, "%s: error responding to load requests",
                         __FUNCTION__);
-    if (rc < 0)
+    batch_notify (cache, e, false, errnum);
+    if (errnum != 0 && !e->valid)
         remove_entry (cache, e);
+    else if (errnum == 0 && e->prefetch_dir) {
+        e->prefetch_dir = 0;
+        cache_prefetch_dirrefs (cache, e);
+    }
+}
+
+static void cache_load_continuation (flux_future_t *f, void *arg)
+{
+    content_cache_t *cache = arg;
+    struct cache_entry *e = flux_future_aux_get (f, "entry");
+    const void *data = NULL;
+    int len = 0;
+    int errnum = 0;
+
+    if (flux_content_load_get (f, &data, &len) < 0)
+        errnum = errno;
+    cache_load_complete (cache, e, errnum, data, len, false);
     flux_future_destroy (f);
 }
 
+/* Entries covered by an upstream batch RPC, in request order.
+ */
+struct upstream_batch {
+    int count;
+    struct cache_entry *entries[];
+};
+
+/* Pop up to 'limit' entries from 'queue' into a new upstream_batch.
+ * On allocation failure, return NULL with entries left on the queue.
+ */
+static struct upstream_batch *upstream_batch_pop (zlist_t *queue, int limit)
+{
+    struct upstream_batch *ub;
+    struct cache_entry *e;
+    int count = zlist_size (queue);
+
+    if (count > limit)
+        count = limit;
+    if (!(ub = calloc (1, sizeof (*ub) + count * sizeof (ub->entries[0])))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    while (ub->count < count && (e = zlist_pop (queue)))
+        ub->entries[ub->count++] = e;
+    return ub;
+}
+
+/* Handle response to a load-batch request sent upstream.
+ * An RPC error fails all the items.
+ */
+static void cache_load_batch_continuation (flux_future_t *f, void *arg)
+{
+    content_cache_t *cache = arg;
+    struct upstream_batch *ub = flux_future_aux_get (f, "batch");
+    const void *data;
+    int len;
+    int flags;
+    int i;
+
+    for (i = 0; i < ub->count; i++) {
+        data = NULL;
+        len = 0;
+        if (flux_content_load_batch_get_encoded (f, i, &data, &len,
+                                                 &flags) < 0)
+            cache_load_complete (cache, ub->entries[i], errno, NULL, 0, false);
+        else
+            cache_load_complete (cache, ub->entries[i], 0, data, len,
+                                 (flags & CONTENT_FLAG_COMPRESS));
+    }
+    flux_future_destroy (f);
+}
+
+/* Send one load-batch request upstream for (up to upstream_batch_limit)
+ * queued entries.  On failure, the entries are completed with an error.
+ */
+static void cache_load_batch_send (content_cache_t *cache)
+{
+    struct upstream_batch *ub;
+    const char **refs = NULL;
+    flux_future_t *f = NULL;
+    struct cache_entry *e;
+    bool ub_owned = true;
+    int flags;
+    int errnum;
+    int i;
+
+    if (!(ub = upstream_batch_pop (cache->load_queue,
+                                   default_upstream_batch_limit))) {
+        errnum = errno;
+        flux_log_error (cache->h, "%s", __FUNCTION__);
+        while ((e = zlist_pop (cache->load_queue)))
+            cache_load_complete (cache, e, errnum, NULL, 0, false);
+        return;
+    }
+    if (!(refs = calloc (ub->count, sizeof (refs[0])))) {
+        errno = ENOMEM;
+        goto error;
+    }
+    for (i = 0; i < ub->count; i++)
+        refs[i] = ub->entries[i]->blobref;
+    flags = CONTENT_FLAG_UPSTREAM;
+    if (cache->compress)
+        flags |= CONTENT_FLAG_COMPRESS;
+    if (!(f = flux_content_load_batch (cache->h, refs, ub->count, flags)))
+        goto error;
+    if (flux_future_aux_set (f, "batch", ub, free) < 0)
+        goto error;
+    ub_owned = false;
+    if (flux_future_then (f, -1., cache_load_batch_continuation, cache) < 0)
+        goto error;
+    free (refs);
+    return;
+error:
+    errnum = errno;
+    flux_log_error (cache->h, "%s", __FUNCTION__);
+    for (i = 0; i < ub->count; i++)
+        cache_load_complete (cache, ub->entries[i], errnum, NULL, 0, false);
+    if (ub_owned)
+        free (ub);
+    flux_future_destroy (f);
+    free (refs);
+}
+
+/* Loads are sent immediately to the backing store on rank 0, one blob at a
+ * time.  On other ranks they are queued and sent upstream in batches from
+ * the prep watcher, so that loads arriving in the same reactor loop
+ * iteration (e.g. a KVS walk across many leaves) share one message.
+ */
 static int cache_load (content_cache_t *cache, struct cache_entry *e)
 {
     flux_future_t *f;
     int saved_errno = 0;
-    int flags = CONTENT_FLAG_UPSTREAM;
     int rc = -1;
 
     if (e->load_pending)
         return 0;
-    if (cache->rank == 0)
-        flags = CONTENT_FLAG_CACHE_BYPASS;
-    if (!(f = flux_content_load (cache->h, e->blobref, flags))) {
-        if (errno == ENOSYS && cache->rank == 0)
+    if (cache->rank > 0) {
+        if (zlist_append (cache->load_queue, e) < 0) {
+            saved_errno = ENOMEM;
+            goto done;
+        }
+        flux_watcher_start (cache->prep_w);
+        e->load_pending = 1;
+        return 0;
+    }
+    if (!(f = flux_content_load (cache->h, e->blobref,
+                                 CONTENT_FLAG_CACHE_BYPASS))) {
+        if (errno == ENOSYS)
             errno = ENOENT;
         saved_errno = errno;
         if (errno != ENOENT)
@@ -324,7 +715,9 @@ static int cache_load (content_cache_t *cache, struct cache_entry *e)
         goto done;
     }
     if (flux_future_aux_set (f, "entry", e, NULL) < 0) {
+        saved_errno = errno;
         flux_log_error (cache->h, "content load flux_future_aux_set");
+        flux_future_destroy (f);
         goto done;
     }
     if (flux_future_then (f, -1., cache_load_continuation, cache) < 0) {
@@ -341,6 +734,44 @@ done:
     return rc;
 }
 
+/* Look up (or create) the entry for 'blobref' and start loading it
+ * if it is not valid.  Returns entry on success, NULL with errno set
+ * on failure.
+ */
+static struct cache_entry *cache_load_entry (content_cache_t *cache,
+                                             const char *blobref)
+{
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    int hash_len;
+    struct cache_entry *e;
+
+    if ((hash_len = blobref_strtohash (blobref, hash, sizeof (hash))) < 0)
+        return NULL;
+    if (!(e = lookup_entry (cache, hash, hash_len))) {
+        if (cache->rank == 0 && !cache->backing) {
+            errno = ENOENT;
+            return NULL;
+        }
+        if (!(e = cache_entry_create (blobref))
+                        || insert_entry (cache, e, hash, hash_len) < 0) {
+            flux_log_error (cache->h, "content load");
+            return NULL; /* insert destroys 'e' on failure */
+        }
+    }
+    if (!e->valid) {
+        cache->misses++;
+        if (e->load_pending)
+            cache->load_coalesced++;
+        if (cache_load (cache, e) < 0)
+            return NULL;
+    }
+    else {
+        cache->hits++;
+        lru_touch (cache, e, true);
+    }
+    return e;
+}
+
 void content_load_request (flux_t *h, flux_msg_handler_t *mh,
                            const flux_msg_t *msg, void *arg)
 {
@@ -353,6 +784,8 @@ void content_load_request (flux_t *h, flux_msg_handler_t *mh,
     int saved_errno = 0;
     int rc = -1;
 
+    cache->load_requests++;
+    cache->load_blobs++;
     if (flux_request_decode_raw (msg, NULL, (const void **)&blobref,
                                  &blobref_size) < 0) {
         saved_errno = errno;
@@ -362,23 +795,11 @@ void content_load_request (flux_t *h, flux_msg_handler_t *mh,
         saved_errno = errno = EPROTO;
         goto done;
     }
-    if (!(e = lookup_entry (cache, blobref))) {
-        if (cache->rank == 0 && !cache->backing) {
-            saved_errno = errno = ENOENT;
-            goto done;
-        }
-        if (!(e = cache_entry_create (blobref))
-                                            || insert_entry (cache, e) < 0) {
-            saved_errno = errno;
-            flux_log_error (h, "content load");
-            goto done; /* insert destroys 'e' on failure */
-        }
+    if (!(e = cache_load_entry (cache, blobref))) {
+        saved_errno = errno;
+        goto done;
     }
     if (!e->valid) {
-        if (cache_load (cache, e) < 0) {
-            saved_errno = errno;
-            goto done;
-        }
         if (defer_request (&e->load_requests, msg) < 0) {
             saved_errno = errno;
             flux_log_error (h, "content load");
@@ -386,7 +807,11 @@ void content_load_request (flux_t *h, flux_msg_handler_t *mh,
         }
         return; /* RPC continuation will respond to msg */
     }
-    e->lastused = cache->epoch;
+    if (cache_entry_inflate (cache, e) < 0) {
+        saved_errno = errno;
+        flux_log_error (h, "content load");
+        goto done;
+    }
     data = e->data;
     len = e->len;
     rc = 0;
@@ -421,28 +846,29 @@ done:
  * offload rank 0 hash entries at a slower pace.
  */
 
-static void cache_store_continuation (flux_future_t *f, void *arg)
+/* Complete a store upstream or to the backing store for entry 'e'.
+ * If 'errnum' is zero, 'blobref' is the blobref returned by the store.
+ */
+static void cache_store_complete (content_cache_t *cache,
+                                  struct cache_entry *e,
+                                  int errnum,
+                                  const char *blobref)
 {
-    content_cache_t *cache = arg;
-    struct cache_entry *e = flux_future_aux_get (f, "entry");
-    const char *blobref;
-    int saved_errno = 0;
-    int rc = -1;
-
     e->store_pending = 0;
     assert (cache->flush_batch_count > 0);
     cache->flush_batch_count--;
-    if (flux_content_store_get (f, &blobref) < 0) {
-        saved_errno = errno;
-        if (cache->rank == 0 && errno == ENOSYS)
+    if (errnum != 0) {
+        if (cache->rank == 0 && errnum == ENOSYS)
             flux_log (cache->h, LOG_DEBUG, "content store: %s",
                       "backing store service unavailable");
-        else
+        else {
+            errno = errnum;
             flux_log_error (cache->h, "content store");
+        }
         goto done;
     }
     if (strcmp (blobref, e->blobref)) {
-        saved_errno = errno = EIO;
+        errnum = EIO;
         flux_log (cache->h, LOG_ERR, "content store: wrong blobref");
         goto done;
     }
@@ -450,22 +876,24 @@ static void cache_store_continuation (flux_future_t *f, void *arg)
         cache->acct_dirty--;
         e->dirty = 0;
     }
-    rc = 0;
+    lru_update (cache, e);
 done:
-    if (respond_requests_raw (&e->store_requests, cache->h,
-                                        rc < 0 ? saved_errno : 0,
+    if (respond_requests_raw (&e->store_requests, cache->h, errnum,
                                         e->blobref, strlen (e->blobref) + 1) < 0)
         flux_log_error (cache->h, "%s: error responding to store requests",
                         __FUNCTION__);
-    flux_future_destroy (f);
+    batch_notify (cache, e, true, errnum);
+}
 
-    /* If cache has been flushed, respond to flush requests, if any.
-     * If there are still dirty entries and the number of outstanding
-     * store requests would not exceed the limit, flush more entries.
-     * Optimization: since scanning for dirty entries is a linear search,
-     * only do it when the number of outstanding store requests falls to
-     * a low water mark, here hardwired to be half of the limit.
-     */
+/* If cache has been flushed, respond to flush requests, if any.
+ * If there are still dirty entries and the number of outstanding
+ * store requests would not exceed the limit, flush more entries.
+ * Optimization: since scanning for dirty entries is a linear search,
+ * only do it when the number of outstanding store requests falls to
+ * a low water mark, here hardwired to be half of the limit.
+ */
+static void cache_store_resume (content_cache_t *cache)
+{
     if (cache->acct_dirty == 0 || (cache->rank == 0 && !cache->backing))
         flush_respond (cache);
     else if (cache->acct_dirty - cache->flush_batch_count > 0
@@ -473,29 +901,151 @@ done:
         (void)cache_flush (cache); /* resume flushing */
 }
 
+static void cache_store_continuation (flux_future_t *f, void *arg)
+{
+    content_cache_t *cache = arg;
+    struct cache_entry *e = flux_future_aux_get (f, "entry");
+    const char *blobref = NULL;
+    int errnum = 0;
+
+    if (flux_content_store_get (f, &blobref) < 0)
+        errnum = errno;
+    cache_store_complete (cache, e, errnum, blobref);
+    flux_future_destroy (f);
+    cache_store_resume (cache);
+}
+
+/* Handle response to a store-batch request sent upstream.
+ * An RPC error fails all the items.
+ */
+static void cache_store_batch_continuation (flux_future_t *f, void *arg)
+{
+    content_cache_t *cache = arg;
+    struct upstream_batch *ub = flux_future_aux_get (f, "batch");
+    const char *blobref;
+    int i;
+
+    for (i = 0; i < ub->count; i++) {
+        if (flux_content_store_batch_get (f, i, &blobref) < 0)
+            cache_store_complete (cache, ub->entries[i], errno, NULL);
+        else
+            cache_store_complete (cache, ub->entries[i], 0, blobref);
+    }
+    flux_future_destroy (f);
+    cache_store_resume (cache);
+}
+
+/* Send one store-batch request upstream for (up to upstream_batch_limit)
+ * queued entries.  On failure, the entries are completed with an error.
+ * The request is encoded here rather than with flux_content_store_batch()
+ * so that entries already held compressed are sent as is.
+ */
+static void cache_store_batch_send (content_cache_t *cache)
+{
+    struct upstream_batch *ub;
+    struct blobvec *bv = NULL;
+    const void *buf;
+    int len;
+    flux_future_t *f = NULL;
+    struct cache_entry *e;
+    bool ub_owned = true;
+    int errnum;
+    int i;
+
+    if (!(ub = upstream_batch_pop (cache->store_queue,
+                                   default_upstream_batch_limit))) {
+        errnum = errno;
+        flux_log_error (cache->h, "%s", __FUNCTION__);
+        while ((e = zlist_pop (cache->store_queue)))
+            cache_store_complete (cache, e, errnum, NULL);
+        return;
+    }
+    if (!(bv = blobvec_create ()))
+        goto error;
+    for (i = 0; i < ub->count; i++) {
+        e = ub->entries[i];
+        if (cache->compress)
+            cache_entry_deflate (cache, e);
+        if (blobvec_append_flags (bv, 0,
+                                  e->compressed ? BLOBVEC_FLAG_COMPRESSED : 0,
+                                  e->data, e->len) < 0)
+            goto error;
+    }
+    if (blobvec_encode (bv, &buf, &len) < 0)
+        goto error;
+    if (!(f = flux_rpc_raw (cache->h, "content.store-batch", buf, len,
+                            FLUX_NODEID_UPSTREAM, 0)))
+        goto error;
+    if (flux_future_aux_set (f, "batch", ub, free) < 0)
+        goto error;
+    ub_owned = false;
+    if (flux_future_then (f, -1., cache_store_batch_continuation, cache) < 0)
+        goto error;
+    blobvec_destroy (bv);
+    return;
+error:
+    errnum = errno;
+    flux_log_error (cache->h, "%s", __FUNCTION__);
+    for (i = 0; i < ub->count; i++)
+        cache_store_complete (cache, ub->entries[i], errnum, NULL);
+    if (ub_owned)
+        free (ub);
+    flux_future_destroy (f);
+    blobvec_destroy (bv);
+}
+
+/* Stores are sent immediately to the backing store on rank 0, subject
+ * to flush_batch_limit.  On other ranks they are queued and sent upstream
+ * in batches from the prep watcher, like loads.
+ */
 static int cache_store (content_cache_t *cache, struct cache_entry *e)
 {
     flux_future_t *f;
+    void *data = NULL;
+    int len;
     int saved_errno = 0;
-    int flags = CONTENT_FLAG_UPSTREAM;
     int rc = -1;
 
     assert (e->valid);
 
     if (e->store_pending)
         return 0;
-    if (cache->rank == 0) {
-        if (cache->flush_batch_count >= cache->flush_batch_limit)
-            return 0;
-        flags = CONTENT_FLAG_CACHE_BYPASS;
+    if (cache->rank > 0) {
+        if (zlist_append (cache->store_queue, e) < 0) {
+            saved_errno = ENOMEM;
+            goto done;
+        }
+        flux_watcher_start (cache->prep_w);
+        e->store_pending = 1;
+        cache->flush_batch_count++;
+        return 0;
     }
-    if (!(f = flux_content_store (cache->h, e->data, e->len, flags))) {
+    if (cache->flush_batch_count >= cache->flush_batch_limit)
+        return 0;
+    /* The backing store holds uncompressed blobs.  Decompress to a
+     * temporary buffer so the entry stays compressed in the cache.
+     */
+    if (e->compressed) {
+        if (blobz_decompress (e->data, e->len, &data, &len) < 0) {
+            saved_errno = errno;
+            flux_log_error (cache->h, "content store");
+            goto done;
+        }
+        f = flux_content_store (cache->h, data, len,
+                                CONTENT_FLAG_CACHE_BYPASS);
+    }
+    else
+        f = flux_content_store (cache->h, e->data, e->len,
+                                CONTENT_FLAG_CACHE_BYPASS);
+    if (!f) {
         saved_errno = errno;
         flux_log_error (cache->h, "content store");
         goto done;
     }
     if (flux_future_aux_set (f, "entry", e, NULL) < 0) {
+        saved_errno = errno;
         flux_log_error (cache->h, "content store: flux_future_aux_set");
+        flux_future_destroy (f);
         goto done;
     }
     if (flux_future_then (f, -1., cache_store_continuation, cache) < 0) {
@@ -508,64 +1058,89 @@ static int cache_store (content_cache_t *cache, struct cache_entry *e)
     cache->flush_batch_count++;
     rc = 0;
 done:
+    free (data);
     if (rc < 0)
         errno = saved_errno;
     return rc;
 }
 
-static void content_store_request (flux_t *h, flux_msg_handler_t *mh,
-                                   const flux_msg_t *msg, void *arg)
+/* Store blob in the cache, computing its blobref into 'blobref'.
+ * If 'compressed' is true, 'data' is in blobz encoding, and the blobref
+ * is computed over the decompressed blob.
+ * If the entry is dirty, a store is started (or queued) as needed.
+ * Returns entry on success, NULL with errno set on failure.
+ */
+static struct cache_entry *cache_store_entry (content_cache_t *cache,
+                                              const void *data,
+                                              int len,
+                                              bool compressed,
+                                              char *blobref,
+                                              int blobref_size)
 {
-    content_cache_t *cache = arg;
-    const void *data;
-    int len;
-    struct cache_entry *e = NULL;
-    char blobref[BLOBREF_MAX_STRING_SIZE];
-    int rc = -1;
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    int hash_len;
+    struct cache_entry *e;
+    void *udata = NULL;
+    int ulen = len;
+    bool reused;
 
-    if (flux_request_decode_raw (msg, NULL, &data, &len) < 0)
-        goto done;
-    if (len > cache->blob_size_limit) {
+    if (compressed && (ulen = blobz_size (data, len)) < 0)
+        return NULL;
+    if (ulen > cache->blob_size_limit) {
         errno = EFBIG;
-        goto done;
+        return NULL;
     }
-    if (blobref_hash (cache->hash_name, (uint8_t *)data, len, blobref,
-                      sizeof (blobref)) < 0)
-        goto done;
-
-    if (!(e = lookup_entry (cache, blobref))) {
+    if (compressed) {
+        if (blobz_decompress (data, len, &udata, &ulen) < 0)
+            return NULL;
+        if (blobref_hash (cache->hash_name, udata, ulen, blobref,
+                          blobref_size) < 0) {
+            free (udata);
+            return NULL;
+        }
+        free (udata);
+    }
+    else if (blobref_hash (cache->hash_name, (uint8_t *)data, len, blobref,
+                           blobref_size) < 0)
+        return NULL;
+    if ((hash_len = blobref_strtohash (blobref, hash, sizeof (hash))) < 0)
+        return NULL;
+    if (!(e = lookup_entry (cache, hash, hash_len))) {
         if (!(e = cache_entry_create (blobref)))
-            goto done;
-        if (insert_entry (cache, e) < 0)
-            goto done; /* insert destroys 'e' on failure */
+            return NULL;
+        if (insert_entry (cache, e, hash, hash_len) < 0)
+            return NULL; /* insert destroys 'e' on failure */
     }
+    reused = e->valid;
     if (!e->valid) {
-        if (cache_entry_fill (e, data, len) < 0)
-            goto done;
+        if (cache_entry_fill (e, data, len, compressed) < 0)
+            return NULL;
         if (!e->valid) {
             e->valid = 1;
             cache->acct_valid++;
             cache->acct_size += len;
+            if (e->compressed)
+                cache->acct_compressed++;
         }
+        if (e->load_requests && cache_entry_inflate (cache, e) < 0)
+            return NULL;
         if (respond_requests_raw (&e->load_requests, cache->h, 0,
                                                         e->data, e->len) < 0)
             flux_log_error (cache->h, "%s: error responding to load requests",
                             __FUNCTION__);
+        batch_notify (cache, e, false, 0);
         if (!e->dirty) {
             e->dirty = 1;
             cache->acct_dirty++;
         }
     }
     e->lastused = cache->epoch;
+    if (reused)
+        e->frequent = 1;
     if (e->dirty) {
         if (cache->rank > 0 || cache->backing) {
             if (cache_store (cache, e) < 0)
-                goto done;
-            if (cache->rank > 0) {  /* write-through */
-                if (defer_request (&e->store_requests, msg) < 0)
-                    goto done;
-                return;
-            }
+                return NULL;
         }
     } else {
         /* When a backing store module is unloaded, it will clear
@@ -577,6 +1152,32 @@ static void content_store_request (flux_t *h, flux_msg_handler_t *mh,
             cache->acct_dirty++;
         }
     }
+    lru_update (cache, e);
+    return e;
+}
+
+static void content_store_request (flux_t *h, flux_msg_handler_t *mh,
+                                   const flux_msg_t *msg, void *arg)
+{
+    content_cache_t *cache = arg;
+    const void *data;
+    int len;
+    struct cache_entry *e = NULL;
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+    int rc = -1;
+
+    cache->store_requests++;
+    cache->store_blobs++;
+    if (flux_request_decode_raw (msg, NULL, &data, &len) < 0)
+        goto done;
+    if (!(e = cache_store_entry (cache, data, len, false,
+                                 blobref, sizeof (blobref))))
+        goto done;
+    if (cache->rank > 0 && e->dirty) {  /* write-through */
+        if (defer_request (&e->store_requests, msg) < 0)
+            goto done;
+        return;
+    }
     rc = 0;
 done:
     assert (rc == 0 || errno != 0);
@@ -590,6 +1191,283 @@ done:
     }
 }
 
+/* Batch operations
+ *
+ * content.load-batch and content.store-batch carry a blobvec of blobrefs
+ * or blobs, and each item is handled as a content.load or content.store
+ * request would be.  Items that cannot complete immediately register the
+ * batch as a waiter on their cache entry, and the (single) response is
+ * sent when the last item completes.  Load errors such as ENOENT are
+ * returned per item.
+ */
+
+static void batch_destroy (struct batch_request *b)
+{
+    if (b) {
+        int saved_errno = errno;
+        int i;
+        for (i = 0; i < b->count; i++) {
+            struct batch_item *item = &b->items[i];
+            if (!item->done && item->e && item->e->batch_requests)
+                zlist_remove (item->e->batch_requests, b);
+            if (item->pinned) {
+                item->e->batch_pins--;
+                lru_update (b->cache, item->e);
+            }
+        }
+        flux_msg_destroy (b->msg);
+        free (b->items);
+        free (b);
+        errno = saved_errno;
+    }
+}
+
+static struct batch_request *batch_create (content_cache_t *cache,
+                                           const flux_msg_t *msg,
+                                           bool store, int count)
+{
+    struct batch_request *b;
+
+    if (!(b = calloc (1, sizeof (*b))))
+        goto nomem;
+    if (count > 0 && !(b->items = calloc (count, sizeof (b->items[0]))))
+        goto nomem;
+    b->cache = cache;
+    b->count = count;
+    b->pending = count;
+    b->store = store;
+    if (!(b->msg = flux_msg_copy (msg, false)))
+        goto error;
+    return b;
+nomem:
+    errno = ENOMEM;
+error:
+    batch_destroy (b);
+    return NULL;
+}
+
+/* Mark item complete.  On success, pin the entry so its data or blobref
+ * remains available for the response.
+ */
+static void batch_item_complete (struct batch_request *b,
+                                 struct batch_item *item,
+                                 struct cache_entry *e, int errnum)
+{
+    assert (!item->done);
+    item->done = 1;
+    item->errnum = errnum;
+    if (errnum == 0) {
+        item->e = e;
+        item->pinned = 1;
+        e->batch_pins++;
+        lru_update (b->cache, e);
+    }
+    else
+        item->e = NULL;
+    b->pending--;
+}
+
+/* Make batch wait for entry 'e' to become valid (load) or clean (store).
+ */
+static int batch_wait (struct batch_request *b,
+                       struct batch_item *item,
+                       struct cache_entry *e)
+{
+    if (!e->batch_requests && !(e->batch_requests = zlist_new ()))
+        goto nomem;
+    if (!zlist_exists (e->batch_requests, b)) {
+        if (zlist_append (e->batch_requests, b) < 0)
+            goto nomem;
+    }
+    item->e = e;
+    return 0;
+nomem:
+    errno = ENOMEM;
+    return -1;
+}
+
+static void batch_respond (content_cache_t *cache, struct batch_request *b)
+{
+    struct blobvec *bv;
+    const void *buf;
+    int len;
+    int i;
+
+    if (!(bv = blobvec_create ()))
+        goto error;
+    for (i = 0; i < b->count; i++) {
+        struct batch_item *item = &b->items[i];
+        int rc;
+
+        if (item->errnum != 0)
+            rc = blobvec_append (bv, item->errnum, NULL, 0);
+        else if (b->store)
+            rc = blobvec_append (bv, 0, item->e->blobref,
+                                 strlen (item->e->blobref) + 1);
+        else {
+            if (item->accept_compressed)
+                cache_entry_deflate (cache, item->e);
+            else if (cache_entry_inflate (cache, item->e) < 0)
+                goto error;
+            rc = blobvec_append_flags (bv, 0, item->e->compressed
+                                       ? BLOBVEC_FLAG_COMPRESSED : 0,
+                                       item->e->data, item->e->len);
+        }
+        if (rc < 0)
+            goto error;
+    }
+    if (blobvec_encode (bv, &buf, &len) < 0)
+        goto error;
+    if (flux_respond_raw (cache->h, b->msg, buf, len) < 0)
+        flux_log_error (cache->h, "%s: flux_respond_raw", __FUNCTION__);
+    blobvec_destroy (bv);
+    return;
+error:
+    if (flux_respond_error (cache->h, b->msg, errno, NULL) < 0)
+        flux_log_error (cache->h, "%s: flux_respond_error", __FUNCTION__);
+    blobvec_destroy (bv);
+}
+
+/* Entry 'e' has completed a load (store=false) or store (store=true).
+ * Complete the items of batches waiting on it, and respond to any batch
+ * that has no more pending items.
+ */
+static void batch_notify (content_cache_t *cache, struct cache_entry *e,
+                          bool store, int errnum)
+{
+    struct batch_request *b;
+    int i;
+
+    while (e->batch_requests) {
+        b = zlist_first (e->batch_requests);
+        while (b && b->store != store)
+            b = zlist_next (e->batch_requests);
+        if (!b)
+            break;
+        zlist_remove (e->batch_requests, b);
+        for (i = 0; i < b->count; i++) {
+            if (!b->items[i].done && b->items[i].e == e)
+                batch_item_complete (b, &b->items[i], e, errnum);
+        }
+        if (b->pending == 0) {
+            batch_respond (cache, b);
+            batch_destroy (b);
+        }
+    }
+}
+
+static void content_load_batch_request (flux_t *h, flux_msg_handler_t *mh,
+                                        const flux_msg_t *msg, void *arg)
+{
+    content_cache_t *cache = arg;
+    const void *buf;
+    int len;
+    struct blobvec *bv = NULL;
+    struct batch_request *b = NULL;
+    struct cache_entry *e;
+    const char *blobref;
+    int flags;
+    int i;
+
+    cache->load_requests++;
+    if (flux_request_decode_raw (msg, NULL, &buf, &len) < 0)
+        goto error;
+    if (!(bv = blobvec_decode (buf, len)))
+        goto error;
+    if (!(b = batch_create (cache, msg, false, blobvec_count (bv))))
+        goto error;
+    cache->load_blobs += b->count;
+    for (i = 0; i < b->count; i++) {
+        if (blobvec_get_string (bv, i, &blobref) < 0
+                        || blobvec_get_flags (bv, i, &flags) < 0)
+            goto error;
+        if ((flags & BLOBVEC_FLAG_ACCEPT_COMPRESSED))
+            b->items[i].accept_compressed = 1;
+        if (!(e = cache_load_entry (cache, blobref)))
+            batch_item_complete (b, &b->items[i], NULL, errno);
+        else if (e->valid)
+            batch_item_complete (b, &b->items[i], e, 0);
+        else if (batch_wait (b, &b->items[i], e) < 0)
+            goto error;
+    }
+    blobvec_destroy (bv);
+    if (b->pending == 0) {
+        batch_respond (cache, b);
+        batch_destroy (b);
+    }
+    return; /* entry completion will respond to msg */
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "content load-batch: flux_respond_error");
+    batch_destroy (b);
+    blobvec_destroy (bv);
+}
+
+static void content_store_batch_request (flux_t *h, flux_msg_handler_t *mh,
+                                         const flux_msg_t *msg, void *arg)
+{
+    content_cache_t *cache = arg;
+    const void *buf;
+    int len;
+    struct blobvec *bv = NULL;
+    struct batch_request *b = NULL;
+    struct cache_entry *e;
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+    const void *data;
+    int flags;
+    int i;
+
+    cache->store_requests++;
+    if (flux_request_decode_raw (msg, NULL, &buf, &len) < 0)
+        goto error;
+    if (!(bv = blobvec_decode (buf, len)))
+        goto error;
+    if (!(b = batch_create (cache, msg, true, blobvec_count (bv))))
+        goto error;
+    cache->store_blobs += b->count;
+    for (i = 0; i < b->count; i++) {
+        if (blobvec_get (bv, i, &data, &len) < 0
+                        || blobvec_get_flags (bv, i, &flags) < 0)
+            goto error;
+        if (!(e = cache_store_entry (cache, data, len,
+                                     (flags & BLOBVEC_FLAG_COMPRESSED),
+                                     blobref, sizeof (blobref))))
+            batch_item_complete (b, &b->items[i], NULL, errno);
+        else if (cache->rank > 0 && e->dirty) { /* write-through */
+            if (batch_wait (b, &b->items[i], e) < 0)
+                goto error;
+        }
+        else
+            batch_item_complete (b, &b->items[i], e, 0);
+    }
+    blobvec_destroy (bv);
+    if (b->pending == 0) {
+        batch_respond (cache, b);
+        batch_destroy (b);
+    }
+    return; /* entry completion will respond to msg */
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "content store-batch: flux_respond_error");
+    batch_destroy (b);
+    blobvec_destroy (bv);
+}
+
+/* Send batches queued for upstream (ranks > 0) once per reactor loop
+ * iteration.
+ */
+static void upstream_prep_cb (flux_reactor_t *r, flux_watcher_t *w,
+                              int revents, void *arg)
+{
+    content_cache_t *cache = arg;
+
+    while (zlist_size (cache->load_queue) > 0)
+        cache_load_batch_send (cache);
+    while (zlist_size (cache->store_queue) > 0)
+        cache_store_batch_send (cache);
+    flux_watcher_stop (w);
+}
+
 /* Backing store is enabled/disabled by modules that provide the
  * 'content.backing' service.  At module load time, the backing module
  * informs the content service of its availability, and entries are
@@ -609,7 +1487,6 @@ done:
 static int cache_flush (content_cache_t *cache)
 {
     struct cache_entry *e;
-    const char *key;
     int saved_errno = 0;
     int count = 0;
     int rc = 0;
@@ -619,7 +1496,8 @@ static int cache_flush (content_cache_t *cache)
         return 0;
 
     flux_log (cache->h, LOG_DEBUG, "content flush begin");
-    FOREACH_ZHASH (cache->entries, key, e) {
+    for (e = digestmap_first (cache->entries); e != NULL;
+                                    e = digestmap_next (cache->entries)) {
         if (!e->dirty || e->store_pending)
             continue;
         if (cache_store (cache, e) < 0) {
@@ -673,34 +1551,24 @@ done:
 };
 
 /* Forcibly drop all entries from the cache that can be dropped
- * without data loss.
- * N.B. this walks the entire cache in one go.
+ * without data loss, i.e. everything on the eviction lists.
  */
 
 static void content_dropcache_request (flux_t *h, flux_msg_handler_t *mh,
                                        const flux_msg_t *msg, void *arg)
 {
     content_cache_t *cache = arg;
-    zlist_t *keys = NULL;
-    char *key;
     struct cache_entry *e;
-    int orig_size;
+    int orig_size = digestmap_size (cache->entries);
     int saved_errno;
     int rc = -1;
+    int i;
 
     if (flux_request_decode (msg, NULL, NULL) < 0)
         goto done;
-    orig_size = zhash_size (cache->entries);
-    if (!(keys = zhash_keys (cache->entries))) {
-        errno = ENOMEM;
-        goto done;
-    }
-    while ((key = zlist_pop (keys))) {
-        e = zhash_lookup (cache->entries, key);
-        assert (e != NULL);
-        if (e->valid && !e->dirty)
+    for (i = 0; i < LRU_LIST_COUNT; i++) {
+        while ((e = cache->lru[i].head))
             remove_entry (cache, e);
-        free (key);
     }
     rc = 0;
 done:
@@ -710,11 +1578,10 @@ done:
                   flux_strerror (saved_errno));
     else
         flux_log (h, LOG_DEBUG, "content dropcache %d/%d",
-                  orig_size - (int)zhash_size (cache->entries), orig_size);
+                  orig_size - digestmap_size (cache->entries), orig_size);
     errno = saved_errno;
     if (flux_respond (h, msg, rc < 0 ? errno : 0, NULL) < 0)
         flux_log_error (h, "content dropcache");
-    zlist_destroy (&keys);
 }
 
 /* Return stats about the cache.
@@ -727,11 +1594,27 @@ static void content_stats_request (flux_t *h, flux_msg_handler_t *mh,
 
     if (flux_request_decode (msg, NULL, NULL) < 0)
         goto error;
-    if (flux_respond_pack (h, msg, "{ s:i s:i s:i s:i}",
-                           "count", zhash_size (cache->entries),
+    if (flux_respond_pack (h, msg, "{ s:i s:i s:i s:i s:I s:I s:I s:I"
+                                   " s:I s:I s:I s:i s:i s:I s:I s:i s:I }",
+                           "count", digestmap_size (cache->entries),
                            "valid", cache->acct_valid,
                            "dirty", cache->acct_dirty,
-                           "size", cache->acct_size) < 0)
+                           "size", cache->acct_size,
+                           "load-requests", (json_int_t)cache->load_requests,
+                           "load-blobs", (json_int_t)cache->load_blobs,
+                           "store-requests", (json_int_t)cache->store_requests,
+                           "store-blobs", (json_int_t)cache->store_blobs,
+                           "hits", (json_int_t)cache->hits,
+                           "misses", (json_int_t)cache->misses,
+                           "evictions", (json_int_t)cache->evictions,
+                           "recent", cache->lru[LRU_RECENT_SMALL].count
+                                   + cache->lru[LRU_RECENT_LARGE].count,
+                           "frequent", cache->lru[LRU_FREQUENT_SMALL].count
+                                   + cache->lru[LRU_FREQUENT_LARGE].count,
+                           "load-coalesced", (json_int_t)cache->load_coalesced,
+                           "prefetch", (json_int_t)cache->prefetch_blobs,
+                           "compressed", cache->acct_compressed,
+                           "inflations", (json_int_t)cache->inflations) < 0)
         flux_log_error (h, "content stats");
     return;
 error:
@@ -803,47 +1686,198 @@ done:
 /* Heartbeat drives periodic cache purge
  */
 
-static int cache_purge (content_cache_t *cache)
+/* Return the head of eviction list 'i' if it is old enough to purge,
+ * else NULL.  If 'large' is true, only entries with size of at least
+ * content.purge-large-entry are returned.  Entries linked before that
+ * attribute was changed may be on the wrong list, so move any such
+ * entries to the small list as they are encountered.
+ */
+static struct cache_entry *lru_candidate (content_cache_t *cache, int i,
+                                          bool large)
 {
-    int after_entries = zhash_size (cache->entries);
-    int after_size = cache->acct_size;
     struct cache_entry *e;
-    zlist_t *purge = NULL;
-    int rc = -1;
-    const char *key;
 
-    if (cache->acct_dirty == zhash_size (cache->entries))
-        return 0;
-
-    FOREACH_ZHASH (cache->entries, key, e) {
-        if (after_size <= cache->purge_target_size
-                        && after_entries <= cache->purge_target_entries)
-            break;
-        if (!e->valid || e->dirty)
+    while ((e = cache->lru[i].head)) {
+        if (large && e->len < cache->purge_large_entry) {
+            lru_unlink (e);
+            lru_append (&cache->lru[i & ~1], e); /* LRU_*_SMALL */
             continue;
-        if (cache->epoch - e->lastused < cache->purge_old_entry)
-            continue;
-        if (after_entries <= cache->purge_target_entries
-                    && e->len < cache->purge_large_entry)
-            continue;
-        if ((!purge && !(purge = zlist_new ()))
-                    || zlist_append (purge, e) < 0) {
-            errno = ENOMEM;
-            goto done;
         }
-        after_size -= e->len;
-        after_entries--;
+        if (cache->epoch - e->lastused < cache->purge_old_entry)
+            return NULL;
+        return e;
+    }
+    return NULL;
+}
+
+/* Return the least recently used of the candidates from lists 'a' and 'b'.
+ */
+static struct cache_entry *lru_oldest (content_cache_t *cache, int a, int b)
+{
+    struct cache_entry *ea = lru_candidate (cache, a, false);
+    struct cache_entry *eb = lru_candidate (cache, b, false);
+
+    if (!ea || (eb && eb->lastused < ea->lastused))
+        return eb;
+    return ea;
+}
+
+/* Evict entries until the cache is within its targets, or no eligible
+ * entries remain.  Recent entries are evicted before frequent ones.
+ * To reach the entry target, entries of any size are evicted in LRU order;
+ * to reach the size target, only large entries are evicted.  Ineligible
+ * entries are never visited, so the cost is proportional to the number
+ * of entries evicted.
+ */
+static void cache_purge (content_cache_t *cache)
+{
+    struct cache_entry *e;
+    int count = 0;
+
+    while (digestmap_size (cache->entries) > cache->purge_target_entries) {
+        if (!(e = lru_oldest (cache, LRU_RECENT_SMALL, LRU_RECENT_LARGE))
+            && !(e = lru_oldest (cache, LRU_FREQUENT_SMALL,
+                                        LRU_FREQUENT_LARGE)))
+            break;
+        remove_entry (cache, e);
+        count++;
+    }
+    while (cache->acct_size > cache->purge_target_size) {
+        if (!(e = lru_candidate (cache, LRU_RECENT_LARGE, true))
+            && !(e = lru_candidate (cache, LRU_FREQUENT_LARGE, true)))
+            break;
+        remove_entry (cache, e);
+        count++;
+    }
+    if (count > 0) {
+        cache->evictions += count;
+        flux_log (cache->h, LOG_DEBUG, "content purge: %d entries", count);
+    }
+}
+
+/* Prefetch
+ *
+ * When many brokers walk a new KVS root after a kvs.setroot event, each
+ * interior broker receives a burst of identical loads from its children.
+ * Concurrent loads of one entry are coalesced into a single upstream
+ * request (see cache_load()), but the requests still arrive one TBON hop
+ * at a time.  If content.prefetch is set on a rank > 0 broker, it loads
+ * the new root directory blob as soon as the setroot event arrives, then
+ * the blobs of the dirrefs it contains, so they are likely to be cached
+ * by the time leaves ask for them.  Directory blobs may be in either the
+ * JSON or binary treeobj encoding.  An hdir root's shards are part of the
+ * root directory, so dirref shards are prefetched as directories in turn.
+ * Prefetched blobs are ordinary clean entries, subject to purge.
+ */
+
+/* Start loading 'blobref' if it is not already cached or in progress.
+ * If 'dir' is true, prefetch its dirrefs once it is valid.
+ */
+static void cache_prefetch (content_cache_t *cache, const char *blobref,
+                            bool dir)
+{
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    int hash_len;
+    struct cache_entry *e;
+    bool created = false;
+
+    if ((hash_len = blobref_strtohash (blobref, hash, sizeof (hash))) < 0)
+        return;
+    if (!(e = lookup_entry (cache, hash, hash_len))) {
+        if (!(e = cache_entry_create (blobref))
+                        || insert_entry (cache, e, hash, hash_len) < 0)
+            return; /* insert destroys 'e' on failure */
+        created = true;
+    }
+    if (e->valid) {
+        if (dir)
+            cache_prefetch_dirrefs (cache, e);
+        return;
     }
-    if (purge) {
-        flux_log (cache->h, LOG_DEBUG, "content purge: %d entries",
-                  (int)zlist_size (purge));
-        while ((e = zlist_pop (purge)))
+    if (dir)
+        e->prefetch_dir = 1;
+    if (e->load_pending)
+        return;
+    if (cache_load (cache, e) < 0) {
+        if (created)
             remove_entry (cache, e);
+        return;
     }
-    rc = 0;
-done:
-    zlist_destroy (&purge);
-    return rc;
+    cache->prefetch_blobs++;
+}
+
+/* Prefetch each blob of dirref 'ref'.
+ */
+static void prefetch_dirref (content_cache_t *cache, const json_t *ref,
+                             bool dir)
+{
+    const char *blobref;
+    int count = treeobj_get_count (ref);
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if ((blobref = treeobj_get_blobref (ref, i)))
+            cache_prefetch (cache, blobref, dir);
+    }
+}
+
+/* Prefetch the dirrefs in dir or hdir 'o', following the shards of an
+ * hdir, whether inline or referenced by a dirref.
+ */
+static void prefetch_treeobj (content_cache_t *cache, json_t *o)
+{
+    if (treeobj_is_dir (o)) {
+        json_t *data = treeobj_get_data (o);
+        const char *name;
+        json_t *dirent;
+
+        json_object_foreach (data, name, dirent) {
+            if (treeobj_is_dirref (dirent))
+                prefetch_dirref (cache, dirent, false);
+        }
+    }
+    else if (treeobj_is_hdir (o)) {
+        json_t *shard;
+        int i;
+
+        for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+            if (!(shard = treeobj_hdir_get_shard (o, i)))
+                continue;
+            if (treeobj_is_dirref (shard))
+                prefetch_dirref (cache, shard, true);
+            else
+                prefetch_treeobj (cache, shard);
+        }
+    }
+}
+
+/* Entry 'e' is a valid directory blob.  Prefetch the blobs referenced
+ * by its dirrefs.  Anything unexpected is ignored.
+ */
+static void cache_prefetch_dirrefs (content_cache_t *cache,
+                                    struct cache_entry *e)
+{
+    json_t *o;
+
+    if (cache_entry_inflate (cache, e) < 0)
+        return;
+    if (!(o = treeobj_decodeb ((const char *)e->data, e->len)))
+        return;
+    prefetch_treeobj (cache, o);
+    json_decref (o);
+}
+
+static void setroot_event (flux_t *h, flux_msg_handler_t *mh,
+                           const flux_msg_t *msg, void *arg)
+{
+    content_cache_t *cache = arg;
+    const char *rootref;
+
+    if (cache->rank == 0 || !cache->prefetch)
+        return;
+    if (flux_event_unpack (msg, NULL, "{s:s}", "rootref", &rootref) < 0)
+        return; /* ignore mangled event */
+    cache_prefetch (cache, rootref, true);
 }
 
 static void heartbeat_event (flux_t *h, flux_msg_handler_t *mh,
@@ -864,11 +1898,16 @@ static const struct flux_msg_handler_spec htab[] = {
       FLUX_ROLE_USER },
     { FLUX_MSGTYPE_REQUEST, "content.store",     content_store_request,
       FLUX_ROLE_USER },
+    { FLUX_MSGTYPE_REQUEST, "content.load-batch",
+      content_load_batch_request, FLUX_ROLE_USER },
+    { FLUX_MSGTYPE_REQUEST, "content.store-batch",
+      content_store_batch_request, FLUX_ROLE_USER },
     { FLUX_MSGTYPE_REQUEST, "content.backing",   content_backing_request, 0 },
     { FLUX_MSGTYPE_REQUEST, "content.dropcache", content_dropcache_request, 0 },
     { FLUX_MSGTYPE_REQUEST, "content.stats.get", content_stats_request, 0 },
     { FLUX_MSGTYPE_REQUEST, "content.flush",     content_flush_request, 0 },
     { FLUX_MSGTYPE_EVENT,   "hb",                heartbeat_event, 0 },
+    { FLUX_MSGTYPE_EVENT,   "kvs.setroot-*",     setroot_event, 0 },
     FLUX_MSGHANDLER_TABLE_END,
 };
 
@@ -878,10 +1917,16 @@ int content_cache_set_flux (content_cache_t *cache, flux_t *h)
 
     if (flux_msg_handler_addvec (h, htab, cache, &cache->handlers) < 0)
         return -1;
+    if (!(cache->prep_w = flux_prepare_watcher_create (flux_get_reactor (h),
+                                                       upstream_prep_cb,
+                                                       cache)))
+        return -1;
     if (flux_get_rank (h, &cache->rank) < 0)
         return -1;
     if (flux_event_subscribe (h, "hb") < 0)
         return -1;
+    if (cache->rank > 0 && flux_event_subscribe (h, "kvs.setroot-") < 0)
+        return -1;
     return 0;
 }
 
@@ -911,7 +1956,7 @@ static int content_cache_getattr (const char *name, const char **val, void *arg)
     else if (!strcmp (name, "content.backing"))
         *val = cache->backing_name;
     else if (!strcmp (name, "content.acct-entries")) {
-        snprintf (s, sizeof (s), "%zd", zhash_size (cache->entries));
+        snprintf (s, sizeof (s), "%d", digestmap_size (cache->entries));
         *val = s;
     } else
         return -1;
@@ -934,6 +1979,16 @@ int content_cache_register_attrs (content_cache_t *cache, attr_t *attr)
     if (attr_add_active_uint32 (attr, "content.purge-large-entry",
                 &cache->purge_large_entry, 0) < 0)
         return -1;
+    /* Prefetch
+     */
+    if (attr_add_active_uint32 (attr, "content.prefetch",
+                &cache->prefetch, 0) < 0)
+        return -1;
+    /* Compression
+     */
+    if (attr_add_active_uint32 (attr, "content.compress",
+                &cache->compress, 0) < 0)
+        return -1;
     /* Accounting numbers
      */
     if (attr_add_active_uint32 (attr, "content.acct-size",
@@ -977,11 +2032,16 @@ void content_cache_destroy (content_cache_t *cache)
     if (cache) {
         if (cache->h) {
             (void)flux_event_unsubscribe (cache->h, "hb");
+            if (cache->rank > 0)
+                (void)flux_event_unsubscribe (cache->h, "kvs.setroot-");
             flux_msg_handler_delvec (cache->handlers);
         }
+        flux_watcher_destroy (cache->prep_w);
         if (cache->backing_name)
             free (cache->backing_name);
-        zhash_destroy (&cache->entries);
+        zlist_destroy (&cache->load_queue);
+        zlist_destroy (&cache->store_queue);
+        digestmap_destroy (cache->entries);
         message_list_destroy (&cache->flush_requests);
         free (cache);
     }
@@ -994,11 +2054,14 @@ content_cache_t *content_cache_create (void)
         errno = ENOMEM;
         return NULL;
     }
-    if (!(cache->entries = zhash_new ())) {
+    if (!(cache->entries = digestmap_create ())
+                        || !(cache->load_queue = zlist_new ())
+                        || !(cache->store_queue = zlist_new ())) {
         content_cache_destroy (cache);
         errno = ENOMEM;
         return NULL;
     }
+    digestmap_set_free_f (cache->entries, cache_entry_destroy);
     cache->rank = FLUX_NODEID_ANY;
     cache->blob_size_limit = default_blob_size_limit;
     cache->flush_batch_limit = default_flush_batch_limit;
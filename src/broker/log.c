@@ -58,7 +58,7 @@ struct sleeper {
     flux_t *h;
     flux_msg_handler_t *mh;
     flux_msg_handler_f fun;
-    flux_msg_t *msg;
+    const flux_msg_t *msg;
     void *arg;
 };
 
@@ -66,7 +66,7 @@ static void sleeper_destroy (struct sleeper *s)
 {
     if (s) {
         assert (s->magic == SLEEPER_MAGIC);
-        flux_msg_destroy (s->msg);
+        flux_msg_decref (s->msg);
         s->magic =~ SLEEPER_MAGIC;
         free (s);
     }
@@ -84,7 +84,7 @@ static struct sleeper *sleeper_create (flux_msg_handler_f fun,
     s->mh = mh;
     s->fun = fun;
     s->arg = arg;
-    if (!(s->msg = flux_msg_copy (msg, true))) {
+    if (!(s->msg = flux_msg_incref (msg))) {
         sleeper_destroy (s);
         return NULL;
     }
@@ -580,7 +580,7 @@ error:
     flux_respond (h, msg, errno, NULL);
 }
 
-static int cmp_sender (flux_msg_t *msg, const char *uuid)
+static int cmp_sender (const flux_msg_t *msg, const char *uuid)
 {
     char *sender = NULL;
     int rc = 0;
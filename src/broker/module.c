@@ -26,6 +26,7 @@
 #include <dlfcn.h>
 #include <inttypes.h>
 #include <argz.h>
+#include <poll.h>
 #include <czmq.h>
 #include <flux/core.h>
 #include <jansson.h>
@@ -38,6 +39,7 @@
 #include "src/common/libutil/xzmalloc.h"
 #include "src/common/libutil/oom.h"
 #include "src/common/libutil/iterators.h"
+#include "src/common/libutil/mpscq.h"
 
 #include "heartbeat.h"
 #include "module.h"
@@ -55,7 +57,8 @@ struct module_struct {
     int lastseen;
     heartbeat_t *heartbeat;
 
-    zsock_t *sock;          /* broker end of PAIR socket */
+    struct mpscq *to_module;    /* broker to module thread */
+    struct mpscq *to_broker;    /* module thread to broker */
     uint32_t userid;        /* creds of connection */
     uint32_t rolemask;
 
@@ -102,13 +105,125 @@ static int setup_module_profiling (module_t *p)
     return (0);
 }
 
+/* The module's handle passes flux_msg_t pointers to and from the broker
+ * thread through a pair of lock-free queues.  Since message reference
+ * counts are not atomic, each side gives up a private copy, which shares
+ * the (immutable) payload with the original.
+ */
+static int module_handle_pollfd (void *impl)
+{
+    module_t *p = impl;
+    assert (p->magic == MODULE_MAGIC);
+
+    return mpscq_get_fd (p->to_module);
+}
+
+static int module_handle_pollevents (void *impl)
+{
+    module_t *p = impl;
+    assert (p->magic == MODULE_MAGIC);
+    int revents = FLUX_POLLOUT;
+
+    if (mpscq_pending (p->to_module))
+        revents |= FLUX_POLLIN;
+    return revents;
+}
+
+static int module_handle_send (void *impl, const flux_msg_t *msg, int flags)
+{
+    module_t *p = impl;
+    assert (p->magic == MODULE_MAGIC);
+    flux_msg_t *cpy;
+
+    if (!(cpy = flux_msg_copy (msg, true)))
+        return -1;
+    if (mpscq_push (p->to_broker, cpy) < 0) {
+        flux_msg_destroy (cpy);
+        return -1;
+    }
+    return 0;
+}
+
+static flux_msg_t *module_handle_recv (void *impl, int flags)
+{
+    module_t *p = impl;
+    assert (p->magic == MODULE_MAGIC);
+    flux_msg_t *msg;
+
+    while (!(msg = mpscq_pop (p->to_module))) {
+        if ((flags & FLUX_O_NONBLOCK)) {
+            errno = EWOULDBLOCK;
+            break;
+        }
+        if (!mpscq_pending (p->to_module)) {
+            struct pollfd pfd = {
+                .fd = mpscq_get_fd (p->to_module),
+                .events = POLLIN,
+            };
+            if (poll (&pfd, 1, -1) < 0 && errno != EINTR)
+                break;
+        }
+    }
+    return msg;
+}
+
+static int module_handle_event_subscribe (void *impl, const char *topic)
+{
+    module_t *p = impl;
+    assert (p->magic == MODULE_MAGIC);
+    flux_future_t *f;
+    int rc = -1;
+
+    if (!(f = flux_rpc_pack (p->h, "cmb.sub", FLUX_NODEID_ANY, 0,
+                             "{ s:s }", "topic", topic)))
+        goto done;
+    if (flux_future_get (f, NULL) < 0)
+        goto done;
+    rc = 0;
+done:
+    flux_future_destroy (f);
+    return rc;
+}
+
+static int module_handle_event_unsubscribe (void *impl, const char *topic)
+{
+    module_t *p = impl;
+    assert (p->magic == MODULE_MAGIC);
+    flux_future_t *f;
+    int rc = -1;
+
+    if (!(f = flux_rpc_pack (p->h, "cmb.unsub", FLUX_NODEID_ANY, 0,
+                             "{ s:s }", "topic", topic)))
+        goto done;
+    if (flux_future_get (f, NULL) < 0)
+        goto done;
+    rc = 0;
+done:
+    flux_future_destroy (f);
+    return rc;
+}
+
+/* The queues belong to module_t, so there is no impl_destroy.
+ */
+static const struct flux_handle_ops module_handle_ops = {
+    .pollfd = module_handle_pollfd,
+    .pollevents = module_handle_pollevents,
+    .send = module_handle_send,
+    .recv = module_handle_recv,
+    .getopt = NULL,
+    .setopt = NULL,
+    .event_subscribe = module_handle_event_subscribe,
+    .event_unsubscribe = module_handle_event_unsubscribe,
+    .impl_destroy = NULL,
+};
+
 static void *module_thread (void *arg)
 {
     module_t *p = arg;
     assert (p->magic == MODULE_MAGIC);
     sigset_t signal_set;
     int errnum;
-    char *uri = xasprintf ("shmem://%s", zuuid_str (p->uuid));
+    int flags = getenv ("FLUX_HANDLE_TRACE") ? FLUX_O_TRACE : 0;
     char **av = NULL;
     char *rankstr = NULL;
     int ac;
@@ -119,8 +234,8 @@ static void *module_thread (void *arg)
 
     /* Connect to broker socket, enable logging, register built-in services
      */
-    if (!(p->h = flux_open (uri, 0)))
-        log_err_exit ("flux_open %s", uri);
+    if (!(p->h = flux_handle_create (p, &module_handle_ops, flags)))
+        log_err_exit ("%s: flux_handle_create", p->name);
     rankstr = xasprintf ("%"PRIu32, p->rank);
     if (flux_attr_set_cacheonly (p->h, "rank", rankstr) < 0) {
         log_err ("%s: error faking rank attribute", p->name);
@@ -166,7 +281,6 @@ static void *module_thread (void *arg)
         flux_log_error (p->h, "flux_send");
     flux_msg_destroy (msg);
 done:
-    free (uri);
     free (rankstr);
     if (av)
         free (av);
@@ -199,7 +313,7 @@ flux_msg_t *module_recvmsg (module_t *p)
 
     assert (p->magic == MODULE_MAGIC);
 
-    if (!(msg = flux_msg_recvzsock (p->sock)))
+    if (!(msg = mpscq_pop (p->to_broker)))
         goto error;
     if (flux_msg_get_type (msg, &type) < 0)
         goto error;
@@ -216,7 +330,7 @@ flux_msg_t *module_recvmsg (module_t *p)
         default:
             break;
     }
-    /* All shmem:// connections to the broker have FLUX_ROLE_OWNER
+    /* All module connections to the broker have FLUX_ROLE_OWNER
      * and are "authenticated" as the instance owner.
      * Allow modules so endowed to change the userid/rolemask on messages when
      * sending on behalf of other users.  This is necessary for connectors
@@ -251,32 +365,27 @@ int module_sendmsg (module_t *p, const flux_msg_t *msg)
         return 0;
     if (flux_msg_get_type (msg, &type) < 0)
         goto done;
+    if (!(cpy = flux_msg_copy (msg, true)))
+        goto done;
     switch (type) {
         case FLUX_MSGTYPE_REQUEST: { /* simulate DEALER socket */
             char uuid[16];
             snprintf (uuid, sizeof (uuid), "%"PRIu32, p->rank);
-            if (!(cpy = flux_msg_copy (msg, true)))
-                goto done;
             if (flux_msg_push_route (cpy, uuid) < 0)
                 goto done;
-            if (flux_msg_sendzsock (p->sock, cpy) < 0)
-                goto done;
             break;
         }
         case FLUX_MSGTYPE_RESPONSE: { /* simulate ROUTER socket */
-            if (!(cpy = flux_msg_copy (msg, true)))
-                goto done;
             if (flux_msg_pop_route (cpy, NULL) < 0)
                 goto done;
-            if (flux_msg_sendzsock (p->sock, cpy) < 0)
-                goto done;
             break;
         }
         default:
-            if (flux_msg_sendzsock (p->sock, msg) < 0)
-                goto done;
             break;
     }
+    if (mpscq_push (p->to_module, cpy) < 0)
+        goto done;
+    cpy = NULL;
     rc = 0;
 done:
     flux_msg_destroy (cpy);
@@ -325,7 +434,8 @@ static void module_destroy (module_t *p)
 
     flux_watcher_stop (p->broker_w);
     flux_watcher_destroy (p->broker_w);
-    zsock_destroy (&p->sock);
+    mpscq_destroy (p->to_module, (mpscq_free_f)flux_msg_destroy);
+    mpscq_destroy (p->to_broker, (mpscq_free_f)flux_msg_destroy);
 
     dlclose (p->dso);
     zuuid_destroy (&p->uuid);
@@ -373,6 +483,8 @@ static void module_cb (flux_reactor_t *r, flux_watcher_t *w,
 {
     module_t *p = arg;
     assert (p->magic == MODULE_MAGIC);
+    if (!mpscq_pending (p->to_broker))
+        return;
     p->lastseen = heartbeat_get_epoch (p->heartbeat);
     if (p->poller_cb)
         p->poller_cb (p, p->poller_arg);
@@ -541,16 +653,17 @@ module_t *module_add (modhash_t *mh, const char *path)
     p->broker_h = mh->broker_h;
     p->heartbeat = mh->heartbeat;
 
-    /* Broker end of PAIR socket is opened here.
+    /* Queues between broker and module threads are created here.
+     * The broker's fd watcher is level-triggered and module_cb() handles
+     * one message per reactor loop iteration, as with other sources.
      */
-    if (!(p->sock = zsock_new_pair (NULL)))
-        log_err_exit ("zsock_new_pair");
-    if (zsock_bind (p->sock, "inproc://%s", module_get_uuid (p)) < 0)
-        log_err_exit ("zsock_bind inproc://%s", module_get_uuid (p));
-    if (!(p->broker_w = flux_zmq_watcher_create (flux_get_reactor (p->broker_h),
-                                                 p->sock, FLUX_POLLIN,
-                                                 module_cb, p)))
-        log_err_exit ("flux_zmq_watcher_create");
+    if (!(p->to_module = mpscq_create ()) || !(p->to_broker = mpscq_create ()))
+        log_err_exit ("mpscq_create");
+    if (!(p->broker_w = flux_fd_watcher_create (flux_get_reactor (p->broker_h),
+                                                mpscq_get_fd (p->to_broker),
+                                                FLUX_POLLIN,
+                                                module_cb, p)))
+        log_err_exit ("flux_fd_watcher_create");
     /* Set creds for connection.
      * Since this is a point to point connection between broker threads,
      * credentials are always those of the instance owner.
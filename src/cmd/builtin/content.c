@@ -132,23 +132,76 @@ static void store_completion (flux_future_t *f, void *arg)
         flux_reactor_stop (flux_get_reactor (h));
 }
 
+static void store_batch_completion (flux_future_t *f, void *arg)
+{
+    flux_t *h = arg;
+    int count = *(int *)flux_future_aux_get (f, "count");
+    const char *blobref;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (flux_content_store_batch_get (f, i, &blobref) < 0)
+            log_err_exit ("store");
+        printf ("%s\n", blobref);
+    }
+    flux_future_destroy (f);
+    if (--spam_cur_inflight < spam_max_inflight/2)
+        flux_reactor_stop (flux_get_reactor (h));
+}
+
+/* Store 'count' spam blobs starting at sequence number 'seq' in one
+ * content.store-batch request.
+ */
+static flux_future_t *spam_store_batch (flux_t *h, int seq, int count)
+{
+    flux_future_t *f;
+    char (*data)[256];
+    const void **bufs;
+    int *lens;
+    int *countp;
+    int i;
+
+    data = xzmalloc (count * sizeof (data[0]));
+    bufs = xzmalloc (count * sizeof (bufs[0]));
+    lens = xzmalloc (count * sizeof (lens[0]));
+    for (i = 0; i < count; i++) {
+        snprintf (data[i], sizeof (data[i]), "spam-o-matic pid=%d seq=%d",
+                  getpid(), seq + i);
+        bufs[i] = data[i];
+        lens[i] = sizeof (data[i]);
+    }
+    if (!(f = flux_content_store_batch (h, bufs, lens, count, 0)))
+        log_err_exit ("flux_content_store_batch(%d)", seq);
+    countp = xzmalloc (sizeof (*countp));
+    *countp = count;
+    if (flux_future_aux_set (f, "count", countp, free) < 0)
+        log_err_exit ("flux_future_aux_set");
+    free (data);
+    free (bufs);
+    free (lens);
+    return f;
+}
+
 static int internal_content_spam (optparse_t *p, int ac, char *av[])
 {
-    int i, count;
+    int i, count, batch;
     flux_future_t *f;
     flux_t *h;
     char data[256];
     int size = 256;
+    int n = optparse_option_index (p);
 
-    if (ac != 2 && ac != 3) {
+    if (ac - n != 1 && ac - n != 2) {
         optparse_print_usage (p);
         exit (1);
     }
-    count = strtoul (av[1], NULL, 10);
-    if (ac == 3)
-        spam_max_inflight = strtoul (av[2], NULL, 10);
+    count = strtoul (av[n], NULL, 10);
+    if (ac - n == 2)
+        spam_max_inflight = strtoul (av[n + 1], NULL, 10);
     else
         spam_max_inflight = 1;
+    if ((batch = optparse_get_int (p, "batch", 1)) < 1)
+        log_msg_exit ("batch size must be >= 1");
 
     if (!(h = builtin_get_flux_handle (p)))
         log_err_exit ("flux_open");
@@ -157,13 +210,23 @@ static int internal_content_spam (optparse_t *p, int ac, char *av[])
     i = 0;
     while (i < count || spam_cur_inflight > 0) {
         while (i < count && spam_cur_inflight < spam_max_inflight) {
-            snprintf (data, size, "spam-o-matic pid=%d seq=%d", getpid(), i);
-            if (!(f = flux_content_store (h, data, size, 0)))
-                log_err_exit ("flux_content_store(%d)", i);
-            if (flux_future_then (f, -1., store_completion, h) < 0)
-                log_err_exit ("flux_future_then(%d)", i);
+            if (batch > 1) {
+                int nblobs = count - i < batch ? count - i : batch;
+                f = spam_store_batch (h, i, nblobs);
+                if (flux_future_then (f, -1., store_batch_completion, h) < 0)
+                    log_err_exit ("flux_future_then(%d)", i);
+                i += nblobs;
+            }
+            else {
+                snprintf (data, size, "spam-o-matic pid=%d seq=%d",
+                          getpid(), i);
+                if (!(f = flux_content_store (h, data, size, 0)))
+                    log_err_exit ("flux_content_store(%d)", i);
+                if (flux_future_then (f, -1., store_completion, h) < 0)
+                    log_err_exit ("flux_future_then(%d)", i);
+                i++;
+            }
             spam_cur_inflight++;
-            i++;
         }
         if (flux_reactor_run (flux_get_reactor (h), 0) < 0)
             log_err ("flux_reactor_run");
@@ -192,6 +255,12 @@ static struct optparse_option store_opts[] = {
       OPTPARSE_TABLE_END,
 };
 
+static struct optparse_option spam_opts[] = {
+    { .name = "batch",  .key = 'B',  .has_arg = 1, .arginfo = "N",
+      .usage = "Store N blobs per content.store-batch request", },
+      OPTPARSE_TABLE_END,
+};
+
 static struct optparse_subcommand content_subcmds[] = {
     { "load",
       "[OPTIONS] BLOBREF",
@@ -222,11 +291,11 @@ static struct optparse_subcommand content_subcmds[] = {
       NULL,
     },
     { "spam",
-      "N [M]",
+      "[OPTIONS] N [M]",
       "Store N random entries, keeping M requests in flight (default 1)",
       internal_content_spam,
       0,
-      NULL,
+      spam_opts,
     },
     OPTPARSE_SUBCMD_END
 };
@@ -14,11 +14,22 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
 #include <flux/core.h>
 
 #include "content.h"
 
 #include "src/common/libutil/blobref.h"
+#include "src/common/libutil/blobvec.h"
+#include "src/common/libutil/blobz.h"
+
+/* Decompressed load-batch items, indexed like the response blobvec.
+ */
+struct inflated {
+    int count;
+    void **bufs;
+    int *lens;
+};
 
 flux_future_t *flux_content_load (flux_t *h, const char *blobref, int flags)
 {
@@ -73,6 +84,241 @@ int flux_content_store_get (flux_future_t *f, const char **blobref)
     return 0;
 }
 
+/* Batched RPCs are only supported by the cache, since the backing store
+ * is always reached one blob at a time from rank 0.
+ */
+static int batch_rank (int flags, uint32_t *rank)
+{
+    if ((flags & CONTENT_FLAG_CACHE_BYPASS)) {
+        errno = EINVAL;
+        return -1;
+    }
+    *rank = FLUX_NODEID_ANY;
+    if ((flags & CONTENT_FLAG_UPSTREAM))
+        *rank = FLUX_NODEID_UPSTREAM;
+    return 0;
+}
+
+static flux_future_t *batch_rpc (flux_t *h, const char *topic,
+                                 struct blobvec *bv, uint32_t rank)
+{
+    const void *buf;
+    int len;
+
+    if (blobvec_encode (bv, &buf, &len) < 0)
+        return NULL;
+    return flux_rpc_raw (h, topic, buf, len, rank, 0);
+}
+
+static void inflated_destroy (struct inflated *inf)
+{
+    if (inf) {
+        int saved_errno = errno;
+        int i;
+        for (i = 0; i < inf->count; i++)
+            free (inf->bufs[i]);
+        free (inf->bufs);
+        free (inf->lens);
+        free (inf);
+        errno = saved_errno;
+    }
+}
+
+static struct inflated *inflated_create (int count)
+{
+    struct inflated *inf;
+
+    if (!(inf = calloc (1, sizeof (*inf))))
+        return NULL;
+    inf->count = count;
+    if (!(inf->bufs = calloc (count, sizeof (inf->bufs[0])))
+        || !(inf->lens = calloc (count, sizeof (inf->lens[0])))) {
+        inflated_destroy (inf);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return inf;
+}
+
+/* Decode the batch response once and cache it in the future.
+ */
+static struct blobvec *batch_response (flux_future_t *f)
+{
+    const char *auxkey = "flux::content_batch";
+    struct blobvec *bv;
+    const void *buf;
+    int len;
+
+    if (!(bv = flux_future_aux_get (f, auxkey))) {
+        if (flux_rpc_get_raw (f, &buf, &len) < 0)
+            return NULL;
+        if (!(bv = blobvec_decode (buf, len)))
+            return NULL;
+        if (flux_future_aux_set (f, auxkey, bv,
+                                 (flux_free_f)blobvec_destroy) < 0) {
+            blobvec_destroy (bv);
+            return NULL;
+        }
+    }
+    return bv;
+}
+
+flux_future_t *flux_content_load_batch (flux_t *h, const char **blobrefs,
+                                        int count, int flags)
+{
+    struct blobvec *bv = NULL;
+    flux_future_t *f = NULL;
+    uint32_t rank;
+    int itemflags = 0;
+    int i;
+
+    if (!h || !blobrefs || count <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (batch_rank (flags, &rank) < 0)
+        return NULL;
+    if ((flags & CONTENT_FLAG_COMPRESS))
+        itemflags = BLOBVEC_FLAG_ACCEPT_COMPRESSED;
+    if (!(bv = blobvec_create ()))
+        return NULL;
+    for (i = 0; i < count; i++) {
+        if (!blobrefs[i] || blobref_validate (blobrefs[i]) < 0) {
+            errno = EINVAL;
+            goto done;
+        }
+        if (blobvec_append_flags (bv, 0, itemflags, blobrefs[i],
+                                  strlen (blobrefs[i]) + 1) < 0)
+            goto done;
+    }
+    f = batch_rpc (h, "content.load-batch", bv, rank);
+done:
+    blobvec_destroy (bv);
+    return f;
+}
+
+int flux_content_load_batch_get_encoded (flux_future_t *f, int index,
+                                         const void **buf, int *len,
+                                         int *flags)
+{
+    struct blobvec *bv;
+    int itemflags;
+
+    if (!(bv = batch_response (f)))
+        return -1;
+    if (blobvec_get (bv, index, buf, len) < 0)
+        return -1;
+    if (blobvec_get_flags (bv, index, &itemflags) < 0)
+        return -1;
+    if (flags)
+        *flags = (itemflags & BLOBVEC_FLAG_COMPRESSED) ? CONTENT_FLAG_COMPRESS
+                                                       : 0;
+    return 0;
+}
+
+/* Decompressed copies are created on demand and cached in the future
+ * alongside the decoded response.
+ */
+int flux_content_load_batch_get (flux_future_t *f, int index,
+                                 const void **buf, int *len)
+{
+    const char *auxkey = "flux::content_batch_inflated";
+    struct inflated *inf;
+    const void *zbuf;
+    int zlen;
+    int flags;
+
+    if (flux_content_load_batch_get_encoded (f, index, &zbuf, &zlen,
+                                             &flags) < 0)
+        return -1;
+    if (!(flags & CONTENT_FLAG_COMPRESS)) {
+        if (buf)
+            *buf = zbuf;
+        if (len)
+            *len = zlen;
+        return 0;
+    }
+    if (!(inf = flux_future_aux_get (f, auxkey))) {
+        struct blobvec *bv = batch_response (f);
+        if (!(inf = inflated_create (blobvec_count (bv))))
+            return -1;
+        if (flux_future_aux_set (f, auxkey, inf,
+                                 (flux_free_f)inflated_destroy) < 0) {
+            inflated_destroy (inf);
+            return -1;
+        }
+    }
+    if (!inf->bufs[index]) {
+        if (blobz_decompress (zbuf, zlen, &inf->bufs[index],
+                              &inf->lens[index]) < 0)
+            return -1;
+    }
+    if (buf)
+        *buf = inf->bufs[index];
+    if (len)
+        *len = inf->lens[index];
+    return 0;
+}
+
+flux_future_t *flux_content_store_batch (flux_t *h, const void **bufs,
+                                         const int *lens, int count, int flags)
+{
+    struct blobvec *bv = NULL;
+    flux_future_t *f = NULL;
+    uint32_t rank;
+    int i;
+
+    if (!h || !bufs || !lens || count <= 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (batch_rank (flags, &rank) < 0)
+        return NULL;
+    if (!(bv = blobvec_create ()))
+        return NULL;
+    for (i = 0; i < count; i++) {
+        void *zbuf;
+        int zlen;
+        int rc = 0;
+
+        if ((flags & CONTENT_FLAG_COMPRESS)
+            && (rc = blobz_compress (bufs[i], lens[i], &zbuf, &zlen)) < 0)
+            goto done;
+        if (rc == 1) {
+            rc = blobvec_append_flags (bv, 0, BLOBVEC_FLAG_COMPRESSED,
+                                       zbuf, zlen);
+            free (zbuf);
+        }
+        else
+            rc = blobvec_append (bv, 0, bufs[i], lens[i]);
+        if (rc < 0)
+            goto done;
+    }
+    f = batch_rpc (h, "content.store-batch", bv, rank);
+done:
+    blobvec_destroy (bv);
+    return f;
+}
+
+int flux_content_store_batch_get (flux_future_t *f, int index,
+                                  const char **blobref)
+{
+    struct blobvec *bv;
+    const char *ref;
+
+    if (!(bv = batch_response (f)))
+        return -1;
+    if (blobvec_get_string (bv, index, &ref) < 0)
+        return -1;
+    if (blobref_validate (ref) < 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (blobref)
+        *blobref = ref;
+    return 0;
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
@@ -21,6 +21,7 @@ extern "C" {
 enum {
     CONTENT_FLAG_CACHE_BYPASS = 1,/* request direct to backing store */
     CONTENT_FLAG_UPSTREAM = 2,    /* make request of upstream TBON peer */
+    CONTENT_FLAG_COMPRESS = 4,    /* batch only: move blobs compressed */
 };
 
 /* Send request to load blob by blobref.
@@ -46,6 +47,45 @@ flux_future_t *flux_content_store (flux_t *h,
  */
 int flux_content_store_get (flux_future_t *f, const char **blobref);
 
+/* Send one request to load 'count' blobs by blobref.
+ * CONTENT_FLAG_CACHE_BYPASS is not supported (EINVAL).
+ * With CONTENT_FLAG_COMPRESS, the cache may return blobs compressed.
+ */
+flux_future_t *flux_content_load_batch (flux_t *h, const char **blobrefs,
+                                        int count, int flags);
+
+/* Get result of load batch request for the blob at 'index'.
+ * This blocks until response is received.  An error loading one blob,
+ * e.g. ENOENT, is reported for that index only.
+ * Storage for 'buf' belongs to 'f' and is valid until 'f' is destroyed.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int flux_content_load_batch_get (flux_future_t *f, int index,
+                                 const void **buf, int *len);
+
+/* Like flux_content_load_batch_get(), but if the blob was returned
+ * compressed, it is not decompressed, and 'flags' is set to
+ * CONTENT_FLAG_COMPRESS (otherwise 0).  A compressed blob has the same
+ * blobref as its uncompressed data.
+ */
+int flux_content_load_batch_get_encoded (flux_future_t *f, int index,
+                                         const void **buf, int *len,
+                                         int *flags);
+
+/* Send one request to store 'count' blobs.
+ * CONTENT_FLAG_CACHE_BYPASS is not supported (EINVAL).
+ * With CONTENT_FLAG_COMPRESS, blobs are compressed where worthwhile.
+ */
+flux_future_t *flux_content_store_batch (flux_t *h, const void **bufs,
+                                         const int *lens, int count, int flags);
+
+/* Get result of store batch request (blobref) for the blob at 'index'.
+ * Storage for 'blobref' belongs to 'f' and is valid until 'f' is destroyed.
+ * Returns 0 on success, -1 on failure with errno set.
+ */
+int flux_content_store_batch_get (flux_future_t *f, int index,
+                                  const char **blobref);
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,6 +21,15 @@
  * PROTO frame
  *
  * See also: RFC 3
+ *
+ * Internally, a message is a single allocation holding the PROTO frame
+ * and an arena holding the route, delimiter, and topic frames in their
+ * wire encoding (see flux_msg_encode()), right aligned so that routes
+ * can be pushed and popped at the front without moving anything else.
+ * The payload is held in a separate, immutable, reference counted buffer
+ * that is shared by flux_msg_copy() and handed to zeromq without copying
+ * by flux_msg_sendzsock().  Conversion to zeromq frames happens only at
+ * the socket edge, in flux_msg_sendzsock() and flux_msg_recvzsock().
  */
 
 #if HAVE_CONFIG_H
@@ -28,11 +37,13 @@
 #endif
 #include <errno.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <assert.h>
 #include <fnmatch.h>
 #include <inttypes.h>
+#include <sys/uio.h>
 #include <czmq.h>
 #include <jansson.h>
 
@@ -54,12 +65,43 @@
 #define PROTO_OFF_BIGINT    12 /* 4 bytes */
 #define PROTO_OFF_BIGINT2   16 /* 4 bytes */
 
+/* Payloads smaller than this are copied into the zeromq message on send
+ * rather than shared, as the copy is cheaper than the extra allocation
+ * and atomic reference counting that sharing entails.
+ */
+#define PAYLOAD_SHARE_MIN   512
+
+/* The refcount is atomic since zeromq may drop its reference from
+ * another thread.  'zf' is set if the data is owned by a received frame.
+ */
+struct msg_payload {
+    int refcount;
+    zframe_t *zf;
+    size_t size;
+    void *data;
+    uint8_t buf[];
+};
+
+/* Size of the header arena embedded in each message.  It holds the
+ * encoded route stack and topic, and is replaced with a larger one
+ * from the heap only if they outgrow it.
+ */
+#define HDR_INLINE_SIZE     192
+
 #define FLUX_MSG_MAGIC 0x33321eee
 struct flux_msg {
     int magic;
-    zmsg_t *zmsg;
+    int refcount;
+    uint8_t proto[PROTO_SIZE];
+    uint8_t *hdr;                   /* header arena */
+    size_t hdr_size;                /*   arena size */
+    size_t hdr_off;                 /*   encoded frames at hdr_off..hdr_size */
+    size_t route_size;              /*   encoded size of route frames */
+    int route_count;
+    struct msg_payload *payload;    /* set iff FLUX_MSGFLAG_PAYLOAD */
     json_t *json;
     struct aux_item *aux;
+    uint8_t hdr_inline[HDR_INLINE_SIZE];
 };
 
 static int proto_set_bigint (uint8_t *data, int len, uint32_t bigint);
@@ -99,7 +141,7 @@ static int proto_set_type (uint8_t *data, int len, int type)
     data[PROTO_OFF_TYPE] = type;
     return 0;
 }
-static int proto_get_type (uint8_t *data, int len, int *type)
+static int proto_get_type (const uint8_t *data, int len, int *type)
 {
     if (len < PROTO_SIZE || data[PROTO_OFF_MAGIC] != PROTO_MAGIC
                          || data[PROTO_OFF_VERSION] != PROTO_VERSION)
@@ -115,7 +157,7 @@ static int proto_set_flags (uint8_t *data, int len, uint8_t flags)
     data[PROTO_OFF_FLAGS] = flags;
     return 0;
 }
-static int proto_get_flags (uint8_t *data, int len, uint8_t *val)
+static int proto_get_flags (const uint8_t *data, int len, uint8_t *val)
 {
     if (len < PROTO_SIZE || data[PROTO_OFF_MAGIC] != PROTO_MAGIC
                          || data[PROTO_OFF_VERSION] != PROTO_VERSION)
@@ -144,7 +186,7 @@ static int proto_set_bigint (uint8_t *data, int len, uint32_t bigint)
     memcpy (&data[PROTO_OFF_BIGINT], &x, sizeof (x));
     return 0;
 }
-static int proto_get_bigint (uint8_t *data, int len, uint32_t *bigint)
+static int proto_get_bigint (const uint8_t *data, int len, uint32_t *bigint)
 {
     uint32_t x;
 
@@ -165,7 +207,7 @@ static int proto_set_bigint2 (uint8_t *data, int len, uint32_t bigint)
     memcpy (&data[PROTO_OFF_BIGINT2], &x, sizeof (x));
     return 0;
 }
-static int proto_get_bigint2 (uint8_t *data, int len, uint32_t *bigint)
+static int proto_get_bigint2 (const uint8_t *data, int len, uint32_t *bigint)
 {
     uint32_t x;
 
@@ -186,7 +228,7 @@ static int proto_set_userid (uint8_t *data, int len, uint32_t userid)
     memcpy (&data[PROTO_OFF_USERID], &x, sizeof (x));
     return 0;
 }
-static int proto_get_userid (uint8_t *data, int len, uint32_t *userid)
+static int proto_get_userid (const uint8_t *data, int len, uint32_t *userid)
 {
     uint32_t x;
 
@@ -207,7 +249,7 @@ static int proto_set_rolemask (uint8_t *data, int len, uint32_t rolemask)
     memcpy (&data[PROTO_OFF_ROLEMASK], &x, sizeof (x));
     return 0;
 }
-static int proto_get_rolemask (uint8_t *data, int len, uint32_t *rolemask)
+static int proto_get_rolemask (const uint8_t *data, int len, uint32_t *rolemask)
 {
     uint32_t x;
 
@@ -231,27 +273,210 @@ static void proto_init (uint8_t *data, int len, uint8_t flags)
 /* End manual codec
  */
 
-flux_msg_t *flux_msg_create (int type)
+static struct msg_payload *payload_create (const void *buf, size_t size)
 {
-    uint8_t proto[PROTO_SIZE];
-    flux_msg_t *msg = calloc (1, sizeof (*msg));
+    struct msg_payload *p;
 
-    if (!msg) {
+    if (!(p = malloc (sizeof (*p) + size))) {
         errno = ENOMEM;
-        goto error;
+        return NULL;
     }
-    msg->magic = FLUX_MSG_MAGIC;
-    proto_init (proto, PROTO_SIZE, 0);
-    if (proto_set_type (proto, PROTO_SIZE, type) < 0) {
-        errno = EINVAL;
-        goto error;
+    p->refcount = 1;
+    p->zf = NULL;
+    p->size = size;
+    p->data = p->buf;
+    memcpy (p->buf, buf, size);
+    return p;
+}
+
+/* Take ownership of a received frame without copying its data.
+ */
+static struct msg_payload *payload_wrap (zframe_t *zf)
+{
+    struct msg_payload *p;
+
+    if (!(p = malloc (sizeof (*p)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    p->refcount = 1;
+    p->zf = zf;
+    p->size = zframe_size (zf);
+    p->data = zframe_data (zf);
+    return p;
+}
+
+static struct msg_payload *payload_incref (struct msg_payload *p)
+{
+    __atomic_add_fetch (&p->refcount, 1, __ATOMIC_RELAXED);
+    return p;
+}
+
+static void payload_decref (struct msg_payload *p)
+{
+    if (p && __atomic_sub_fetch (&p->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+        zframe_destroy (&p->zf);
+        free (p);
+    }
+}
+
+/* zmq_free_fn for payloads shared with zeromq by payload_send().
+ */
+static void payload_free (void *data, void *hint)
+{
+    payload_decref (hint);
+}
+
+static int payload_send (struct msg_payload *p, void *handle)
+{
+    zmq_msg_t zmsg;
+
+    if (p->size < PAYLOAD_SHARE_MIN) {
+        if (zmq_msg_init_size (&zmsg, p->size) < 0)
+            return -1;
+        memcpy (zmq_msg_data (&zmsg), p->data, p->size);
+    }
+    else {
+        payload_incref (p);
+        if (zmq_msg_init_data (&zmsg, p->data, p->size,
+                               payload_free, p) < 0) {
+            payload_decref (p);
+            return -1;
+        }
+    }
+    if (zmq_msg_send (&zmsg, handle, ZMQ_SNDMORE) < 0) {
+        int saved_errno = errno;
+        zmq_msg_close (&zmsg);
+        errno = saved_errno;
+        return -1;
+    }
+    return 0;
+}
+
+/* Frames are encoded with a 1 byte size, or for sizes of 255 or more,
+ * 0xff followed by a 4 byte size in network byte order, then the data.
+ */
+static size_t frame_encode_size (size_t n)
+{
+    return (n < 0xff ? 1 : 1 + 4) + n;
+}
+
+static uint8_t *frame_put_size (uint8_t *p, size_t n)
+{
+    if (n < 0xff)
+        *p++ = (uint8_t)n;
+    else {
+        uint32_t x = htonl (n);
+        *p++ = 0xff;
+        memcpy (p, &x, sizeof (x));
+        p += sizeof (x);
+    }
+    return p;
+}
+
+static uint8_t *frame_put (uint8_t *p, const void *data, size_t n)
+{
+    p = frame_put_size (p, n);
+    memcpy (p, data, n);
+    return p + n;
+}
+
+/* Decode the frame at 'p', with 'avail' bytes remaining.
+ * Returns its encoded size, or -1 if it is truncated.
+ */
+static int frame_get (const uint8_t *p, size_t avail,
+                      const uint8_t **data, size_t *n)
+{
+    size_t hdrlen = 1;
+    uint32_t x;
+
+    if (avail < 1)
+        return -1;
+    *n = p[0];
+    if (*n == 0xff) {
+        if (avail < 1 + sizeof (x))
+            return -1;
+        memcpy (&x, p + 1, sizeof (x));
+        *n = ntohl (x);
+        hdrlen += sizeof (x);
     }
-    if (!(msg->zmsg = zmsg_new ())) {
+    if (avail - hdrlen < *n)
+        return -1;
+    *data = p + hdrlen;
+    return hdrlen + *n;
+}
+
+/* Ensure there are at least 'n' free bytes in front of the encoded
+ * header frames, moving them to a larger arena if necessary.
+ */
+static int hdr_reserve (flux_msg_t *msg, size_t n)
+{
+    size_t used = msg->hdr_size - msg->hdr_off;
+    size_t size;
+    uint8_t *hdr;
+
+    if (msg->hdr_off >= n)
+        return 0;
+    size = msg->hdr_size * 2;
+    while (size < used + n)
+        size *= 2;
+    if (!(hdr = malloc (size))) {
         errno = ENOMEM;
-        goto error;
+        return -1;
+    }
+    memcpy (hdr + size - used, msg->hdr + msg->hdr_off, used);
+    if (msg->hdr != msg->hdr_inline)
+        free (msg->hdr);
+    msg->hdr = hdr;
+    msg->hdr_off = size - used;
+    msg->hdr_size = size;
+    return 0;
+}
+
+static uint8_t *hdr_prepend (flux_msg_t *msg, size_t n)
+{
+    if (hdr_reserve (msg, n) < 0)
+        return NULL;
+    msg->hdr_off -= n;
+    return msg->hdr + msg->hdr_off;
+}
+
+/* Offset of the topic frame relative to msg->hdr_off.
+ */
+static size_t hdr_topic_off (const flux_msg_t *msg, uint8_t flags)
+{
+    if ((flags & FLUX_MSGFLAG_ROUTE))
+        return msg->route_size + 1;
+    return 0;
+}
+
+static flux_msg_t *msg_alloc (void)
+{
+    flux_msg_t *msg;
+
+    if (!(msg = malloc (sizeof (*msg)))) {
+        errno = ENOMEM;
+        return NULL;
     }
-    if (zmsg_addmem (msg->zmsg, proto, PROTO_SIZE) < 0)
+    memset (msg, 0, offsetof (struct flux_msg, hdr_inline));
+    msg->magic = FLUX_MSG_MAGIC;
+    msg->refcount = 1;
+    msg->hdr = msg->hdr_inline;
+    msg->hdr_size = msg->hdr_off = sizeof (msg->hdr_inline);
+    return msg;
+}
+
+flux_msg_t *flux_msg_create (int type)
+{
+    flux_msg_t *msg;
+
+    if (!(msg = msg_alloc ()))
+        goto error;
+    proto_init (msg->proto, PROTO_SIZE, 0);
+    if (proto_set_type (msg->proto, PROTO_SIZE, type) < 0) {
+        errno = EINVAL;
         goto error;
+    }
     return msg;
 error:
     flux_msg_destroy (msg);
@@ -260,15 +485,44 @@ error:
 
 void flux_msg_destroy (flux_msg_t *msg)
 {
+    flux_msg_decref (msg);
+}
+
+/* N.B. const attribute of msg argument is defeated internally so that
+ * a reference can be taken on a message received via a const pointer.
+ * Message reference counts are not atomic; only the payload is shared
+ * across threads.
+ */
+const flux_msg_t *flux_msg_incref (const flux_msg_t *const_msg)
+{
+    flux_msg_t *msg = (flux_msg_t *)const_msg;
+
+    if (!msg) {
+        errno = EINVAL;
+        return NULL;
+    }
+    assert (msg->magic == FLUX_MSG_MAGIC);
+    msg->refcount++;
+    return msg;
+}
+
+void flux_msg_decref (const flux_msg_t *const_msg)
+{
+    flux_msg_t *msg = (flux_msg_t *)const_msg;
+
     if (msg) {
         assert (msg->magic == FLUX_MSG_MAGIC);
-        int saved_errno = errno;
-        json_decref (msg->json);
-        zmsg_destroy (&msg->zmsg);
-        msg->magic =~ FLUX_MSG_MAGIC;
-        aux_destroy (&msg->aux);
-        free (msg);
-        errno = saved_errno;
+        if (--msg->refcount == 0) {
+            int saved_errno = errno;
+            json_decref (msg->json);
+            if (msg->hdr != msg->hdr_inline)
+                free (msg->hdr);
+            payload_decref (msg->payload);
+            msg->magic =~ FLUX_MSG_MAGIC;
+            aux_destroy (&msg->aux);
+            free (msg);
+            errno = saved_errno;
+        }
     }
 }
 
@@ -298,97 +552,97 @@ void *flux_msg_aux_get (const flux_msg_t *msg, const char *name)
 
 size_t flux_msg_encode_size (const flux_msg_t *msg)
 {
-    zframe_t *zf;
-    size_t size = 0;
+    size_t size = msg->hdr_size - msg->hdr_off;
 
-    zf = zmsg_first (msg->zmsg);
-    while (zf) {
-        size_t n = zframe_size (zf);
-        if (n < 255)
-            size += 1;
-        else
-            size += 1 + 4;
-        size += n;
-        zf = zmsg_next (msg->zmsg);
-    }
-    return size;
+    if (msg->payload)
+        size += frame_encode_size (msg->payload->size);
+    return size + frame_encode_size (PROTO_SIZE);
 }
 
-
 int flux_msg_encode (const flux_msg_t *msg, void *buf, size_t size)
 {
+    size_t hdrlen = msg->hdr_size - msg->hdr_off;
     uint8_t *p = buf;
-    zframe_t *zf;
 
-    zf = zmsg_first (msg->zmsg);
-    while (zf) {
-        size_t n = zframe_size (zf);
-        if (n < 0xff) {
-            if (size - (p - (uint8_t *)buf) < n + 1)
-                goto nospace;
-            *p++ = (uint8_t)n;
-        } else {
-            if (size - (p - (uint8_t *)buf) < n + 1 + 4)
-                goto nospace;
-            *p++ = 0xff;
-            *(uint32_t *)p = htonl (n);
-            p += 4;
-        }
-        memcpy (p, zframe_data (zf), n);
-        p += n;
-        zf = zmsg_next (msg->zmsg);
+    if (size < flux_msg_encode_size (msg)) {
+        errno = EINVAL;
+        return -1;
     }
+    memcpy (p, msg->hdr + msg->hdr_off, hdrlen);
+    p += hdrlen;
+    if (msg->payload)
+        p = frame_put (p, msg->payload->data, msg->payload->size);
+    frame_put (p, msg->proto, PROTO_SIZE);
     return 0;
-nospace:
-    errno = EINVAL;
-    return -1;
 }
 
+/* The PROTO frame is last and always PROTO_SIZE bytes, so its flags can
+ * be read before the other frames, which are then decoded in one pass.
+ */
 flux_msg_t *flux_msg_decode (const void *buf, size_t size)
 {
-    flux_msg_t *msg = calloc (1, sizeof (*msg));
-    uint8_t const *p = buf;
-    zframe_t *zf;
-    int saved_errno;
+    flux_msg_t *msg;
+    const uint8_t *p = buf;
+    const uint8_t *end;
+    const uint8_t *data;
+    size_t hdrlen, n;
+    uint8_t flags;
+    int len;
 
-    if (!msg)
-        goto nomem;
-    msg->magic = FLUX_MSG_MAGIC;
-    if (!(msg->zmsg = zmsg_new ()))
-        goto nomem;
-    while (p - (uint8_t *)buf < size) {
-        size_t n = *p++;
-        if (n == 0xff) {
-            if (size - (p - (uint8_t *)buf) < 4) {
-                saved_errno = EINVAL;
-                goto error;
-            }
-            n = ntohl (*(uint32_t *)p);
-            p += 4;
+    if (!buf || size < 1 + PROTO_SIZE) {
+        errno = EPROTO;
+        return NULL;
+    }
+    end = p + size - (1 + PROTO_SIZE);
+    if (*end != PROTO_SIZE
+                || proto_get_flags (end + 1, PROTO_SIZE, &flags) < 0) {
+        errno = EPROTO;
+        return NULL;
+    }
+    if (!(msg = msg_alloc ()))
+        return NULL;
+    memcpy (msg->proto, end + 1, PROTO_SIZE);
+    if ((flags & FLUX_MSGFLAG_ROUTE)) {
+        while ((len = frame_get (p, end - p, &data, &n)) > 0) {
+            p += len;
+            if (n == 0)
+                break;
+            msg->route_count++;
+            msg->route_size += len;
         }
-        if (size - (p - (uint8_t *)buf) < n) {
-            saved_errno = EINVAL;
+        if (len < 0 || n != 0)
+            goto eproto;
+    }
+    if ((flags & FLUX_MSGFLAG_TOPIC)) {
+        if ((len = frame_get (p, end - p, &data, &n)) < 0)
+            goto eproto;
+        p += len;
+    }
+    hdrlen = p - (const uint8_t *)buf;
+    if (hdr_reserve (msg, hdrlen) < 0)
+        goto error;
+    msg->hdr_off -= hdrlen;
+    memcpy (msg->hdr + msg->hdr_off, buf, hdrlen);
+    if ((flags & FLUX_MSGFLAG_PAYLOAD)) {
+        if ((len = frame_get (p, end - p, &data, &n)) < 0)
+            goto eproto;
+        if (!(msg->payload = payload_create (data, n)))
             goto error;
-        }
-        if (!(zf = zframe_new (p, n)))
-            goto nomem;
-        if (zmsg_append (msg->zmsg, &zf) < 0)
-            goto nomem;
-        p += n;
+        p += len;
     }
+    if (p != end)
+        goto eproto;
     return msg;
-nomem:
-    saved_errno = EINVAL;
+eproto:
+    errno = EPROTO;
 error:
     flux_msg_destroy (msg);
-    errno = saved_errno;
     return NULL;
 }
 
 int flux_msg_set_type (flux_msg_t *msg, int type)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
-    if (!zf || proto_set_type (zframe_data (zf), zframe_size (zf), type) < 0) {
+    if (proto_set_type (msg->proto, PROTO_SIZE, type) < 0) {
         errno = EINVAL;
         return -1;
     }
@@ -397,8 +651,7 @@ int flux_msg_set_type (flux_msg_t *msg, int type)
 
 int flux_msg_get_type (const flux_msg_t *msg, int *type)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), type) < 0) {
+    if (proto_get_type (msg->proto, PROTO_SIZE, type) < 0) {
         errno = EPROTO;
         return -1;
     }
@@ -407,8 +660,7 @@ int flux_msg_get_type (const flux_msg_t *msg, int *type)
 
 int flux_msg_set_flags (flux_msg_t *msg, uint8_t fl)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
-    if (!zf || proto_set_flags (zframe_data (zf), zframe_size (zf), fl) < 0) {
+    if (proto_set_flags (msg->proto, PROTO_SIZE, fl) < 0) {
         errno = EINVAL;
         return -1;
     }
@@ -417,8 +669,7 @@ int flux_msg_set_flags (flux_msg_t *msg, uint8_t fl)
 
 int flux_msg_get_flags (const flux_msg_t *msg, uint8_t *fl)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
-    if (!zf || proto_get_flags (zframe_data (zf), zframe_size (zf), fl) < 0) {
+    if (proto_get_flags (msg->proto, PROTO_SIZE, fl) < 0) {
         errno = EPROTO;
         return -1;
     }
@@ -446,9 +697,7 @@ bool flux_msg_is_private (const flux_msg_t *msg)
 
 int flux_msg_set_userid (flux_msg_t *msg, uint32_t userid)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
-    if (!zf || proto_set_userid (zframe_data (zf),
-                                 zframe_size (zf), userid) < 0) {
+    if (proto_set_userid (msg->proto, PROTO_SIZE, userid) < 0) {
         errno = EINVAL;
         return -1;
     }
@@ -457,9 +706,7 @@ int flux_msg_set_userid (flux_msg_t *msg, uint32_t userid)
 
 int flux_msg_get_userid (const flux_msg_t *msg, uint32_t *userid)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
-    if (!zf || proto_get_userid (zframe_data (zf),
-                                 zframe_size (zf), userid) < 0) {
+    if (proto_get_userid (msg->proto, PROTO_SIZE, userid) < 0) {
         errno = EPROTO;
         return -1;
     }
@@ -468,9 +715,7 @@ int flux_msg_get_userid (const flux_msg_t *msg, uint32_t *userid)
 
 int flux_msg_set_rolemask (flux_msg_t *msg, uint32_t rolemask)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
-    if (!zf || proto_set_rolemask (zframe_data (zf),
-                                   zframe_size (zf), rolemask) < 0) {
+    if (proto_set_rolemask (msg->proto, PROTO_SIZE, rolemask) < 0) {
         errno = EINVAL;
         return -1;
     }
@@ -479,9 +724,7 @@ int flux_msg_set_rolemask (flux_msg_t *msg, uint32_t rolemask)
 
 int flux_msg_get_rolemask (const flux_msg_t *msg, uint32_t *rolemask)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
-    if (!zf || proto_get_rolemask (zframe_data (zf),
-                                   zframe_size (zf), rolemask) < 0) {
+    if (proto_get_rolemask (msg->proto, PROTO_SIZE, rolemask) < 0) {
         errno = EPROTO;
         return -1;
     }
@@ -490,7 +733,6 @@ int flux_msg_get_rolemask (const flux_msg_t *msg, uint32_t *rolemask)
 
 int flux_msg_set_nodeid (flux_msg_t *msg, uint32_t nodeid, int flags)
 {
-    zframe_t *zf;
     int type;
 
     if (flags != 0 && flags != FLUX_MSGFLAG_UPSTREAM)
@@ -499,15 +741,13 @@ int flux_msg_set_nodeid (flux_msg_t *msg, uint32_t nodeid, int flags)
         goto error;
     if (flags == FLUX_MSGFLAG_UPSTREAM && nodeid == FLUX_NODEID_ANY)
         goto error;
-    if (!(zf = zmsg_last (msg->zmsg)))
-        goto error;
-    if (proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0)
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0)
         goto error;
     if (type != FLUX_MSGTYPE_REQUEST)
         goto error;
-    if (proto_set_bigint (zframe_data (zf), zframe_size (zf), nodeid) < 0)
+    if (proto_set_bigint (msg->proto, PROTO_SIZE, nodeid) < 0)
         goto error;
-    if (proto_mod_flags (zframe_data (zf), zframe_size (zf), flags, false) < 0)
+    if (proto_mod_flags (msg->proto, PROTO_SIZE, flags, false) < 0)
         goto error;
     return 0;
 error:
@@ -517,15 +757,14 @@ error:
 
 int flux_msg_get_nodeid (const flux_msg_t *msg, uint32_t *nodeid, int *flags)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
     uint8_t fl;
     uint32_t nid;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || type != FLUX_MSGTYPE_REQUEST
-            || proto_get_bigint (zframe_data (zf), zframe_size (zf), &nid) < 0
-            || proto_get_flags (zframe_data (zf), zframe_size (zf), &fl) < 0
+            || proto_get_bigint (msg->proto, PROTO_SIZE, &nid) < 0
+            || proto_get_flags (msg->proto, PROTO_SIZE, &fl) < 0
             || ((fl & FLUX_MSGFLAG_UPSTREAM) && nid == FLUX_NODEID_ANY)
             || nid == FLUX_NODEID_UPSTREAM) {
         errno = EPROTO;
@@ -538,12 +777,11 @@ int flux_msg_get_nodeid (const flux_msg_t *msg, uint32_t *nodeid, int *flags)
 
 int flux_msg_set_errnum (flux_msg_t *msg, int e)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || (type != FLUX_MSGTYPE_RESPONSE && type != FLUX_MSGTYPE_KEEPALIVE)
-            || proto_set_bigint (zframe_data (zf), zframe_size (zf), e) < 0) {
+            || proto_set_bigint (msg->proto, PROTO_SIZE, e) < 0) {
         errno = EINVAL;
         return -1;
     }
@@ -552,13 +790,12 @@ int flux_msg_set_errnum (flux_msg_t *msg, int e)
 
 int flux_msg_get_errnum (const flux_msg_t *msg, int *e)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
     uint32_t xe;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || (type != FLUX_MSGTYPE_RESPONSE && type != FLUX_MSGTYPE_KEEPALIVE)
-            || proto_get_bigint (zframe_data (zf), zframe_size (zf), &xe) < 0) {
+            || proto_get_bigint (msg->proto, PROTO_SIZE, &xe) < 0) {
         errno = EPROTO;
         return -1;
     }
@@ -568,12 +805,11 @@ int flux_msg_get_errnum (const flux_msg_t *msg, int *e)
 
 int flux_msg_set_seq (flux_msg_t *msg, uint32_t seq)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || type != FLUX_MSGTYPE_EVENT
-            || proto_set_bigint (zframe_data (zf), zframe_size (zf), seq) < 0) {
+            || proto_set_bigint (msg->proto, PROTO_SIZE, seq) < 0) {
         errno = EINVAL;
         return -1;
     }
@@ -582,12 +818,11 @@ int flux_msg_set_seq (flux_msg_t *msg, uint32_t seq)
 
 int flux_msg_get_seq (const flux_msg_t *msg, uint32_t *seq)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || type != FLUX_MSGTYPE_EVENT
-            || proto_get_bigint (zframe_data (zf), zframe_size (zf), seq) < 0) {
+            || proto_get_bigint (msg->proto, PROTO_SIZE, seq) < 0) {
         errno = EPROTO;
         return -1;
     }
@@ -596,12 +831,11 @@ int flux_msg_get_seq (const flux_msg_t *msg, uint32_t *seq)
 
 int flux_msg_set_matchtag (flux_msg_t *msg, uint32_t t)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || (type != FLUX_MSGTYPE_REQUEST && type != FLUX_MSGTYPE_RESPONSE)
-            || proto_set_bigint2 (zframe_data (zf), zframe_size (zf), t) < 0) {
+            || proto_set_bigint2 (msg->proto, PROTO_SIZE, t) < 0) {
         errno = EINVAL;
         return -1;
     }
@@ -610,12 +844,11 @@ int flux_msg_set_matchtag (flux_msg_t *msg, uint32_t t)
 
 int flux_msg_get_matchtag (const flux_msg_t *msg, uint32_t *t)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || (type != FLUX_MSGTYPE_REQUEST && type != FLUX_MSGTYPE_RESPONSE)
-            || proto_get_bigint2 (zframe_data (zf), zframe_size (zf), t) < 0) {
+            || proto_get_bigint2 (msg->proto, PROTO_SIZE, t) < 0) {
         errno = EPROTO;
         return -1;
     }
@@ -624,12 +857,11 @@ int flux_msg_get_matchtag (const flux_msg_t *msg, uint32_t *t)
 
 int flux_msg_set_status (flux_msg_t *msg, int s)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || type != FLUX_MSGTYPE_KEEPALIVE
-            || proto_set_bigint2 (zframe_data (zf), zframe_size (zf), s) < 0) {
+            || proto_set_bigint2 (msg->proto, PROTO_SIZE, s) < 0) {
         errno = EINVAL;
         return -1;
     }
@@ -638,13 +870,12 @@ int flux_msg_set_status (flux_msg_t *msg, int s)
 
 int flux_msg_get_status (const flux_msg_t *msg, int *s)
 {
-    zframe_t *zf = zmsg_last (msg->zmsg);
     int type;
     uint32_t u;
 
-    if (!zf || proto_get_type (zframe_data (zf), zframe_size (zf), &type) < 0
+    if (proto_get_type (msg->proto, PROTO_SIZE, &type) < 0
             || type != FLUX_MSGTYPE_KEEPALIVE
-            || proto_get_bigint2 (zframe_data (zf), zframe_size (zf), &u) < 0) {
+            || proto_get_bigint2 (msg->proto, PROTO_SIZE, &u) < 0) {
         errno = EPROTO;
         return -1;
     }
@@ -707,15 +938,17 @@ bool flux_msg_cmp (const flux_msg_t *msg, struct flux_match match)
 int flux_msg_enable_route (flux_msg_t *msg)
 {
     uint8_t flags;
+    uint8_t *p;
 
     if (flux_msg_get_flags (msg, &flags) < 0)
         return -1;
     if ((flags & FLUX_MSGFLAG_ROUTE))
         return 0;
-    if (zmsg_pushmem (msg->zmsg, NULL, 0) < 0) {
-        errno = ENOMEM;
+    if (!(p = hdr_prepend (msg, 1)))    /* route delimiter (empty frame) */
         return -1;
-    }
+    *p = 0;
+    msg->route_count = 0;
+    msg->route_size = 0;
     flags |= FLUX_MSGFLAG_ROUTE;
     return flux_msg_set_flags (msg, flags);
 }
@@ -723,19 +956,14 @@ int flux_msg_enable_route (flux_msg_t *msg)
 int flux_msg_clear_route (flux_msg_t *msg)
 {
     uint8_t flags;
-    zframe_t *zf;
-    int size;
 
     if (flux_msg_get_flags (msg, &flags) < 0)
         return -1;
     if (!(flags & FLUX_MSGFLAG_ROUTE))
         return 0;
-    while ((zf = zmsg_pop (msg->zmsg))) {
-        size = zframe_size (zf);
-        zframe_destroy (&zf);
-        if (size == 0)
-            break;
-    }
+    msg->hdr_off += msg->route_size + 1;
+    msg->route_count = 0;
+    msg->route_size = 0;
     flags &= ~(uint8_t)FLUX_MSGFLAG_ROUTE;
     return flux_msg_set_flags (msg, flags);
 }
@@ -743,6 +971,8 @@ int flux_msg_clear_route (flux_msg_t *msg)
 int flux_msg_push_route (flux_msg_t *msg, const char *id)
 {
     uint8_t flags;
+    size_t len, n;
+    uint8_t *p;
 
     if (flux_msg_get_flags (msg, &flags) < 0)
         return -1;
@@ -750,100 +980,100 @@ int flux_msg_push_route (flux_msg_t *msg, const char *id)
         errno = EPROTO;
         return -1;
     }
-    if (zmsg_pushstr (msg->zmsg, id) < 0) {
-        errno = ENOMEM;
+    n = strlen (id);
+    len = frame_encode_size (n);
+    if (!(p = hdr_prepend (msg, len)))
         return -1;
-    }
+    frame_put (p, id, n);
+    msg->route_count++;
+    msg->route_size += len;
     return 0;
 }
 
-int flux_msg_pop_route (flux_msg_t *msg, char **id)
+/* Get the nth route frame, where 0 is the most recently pushed.
+ * Returns its encoded size, or -1 on error with errno set.
+ */
+static int route_get_nth (const flux_msg_t *msg, int nth,
+                          const uint8_t **data, size_t *n)
 {
-    uint8_t flags;
-    zframe_t *zf;
+    const uint8_t *p = msg->hdr + msg->hdr_off;
+    size_t avail = msg->route_size;
+    int len;
 
-    if (flux_msg_get_flags (msg, &flags) < 0)
-        return -1;
-    if (!(flags & FLUX_MSGFLAG_ROUTE) || !(zf = zmsg_first (msg->zmsg))) {
-        errno = EPROTO;
-        return -1;
-    }
-    if (zframe_size (zf) > 0 && (zf = zmsg_pop (msg->zmsg))) {
-        if (id) {
-            char *s = zframe_strdup (zf);
-            if (!s) {
-                zframe_destroy (&zf);
-                errno = ENOMEM;
-                return -1;
-            }
-            *id = s;
+    for (;;) {
+        if ((len = frame_get (p, avail, data, n)) < 0) {
+            errno = EPROTO;
+            return -1;
         }
-        zframe_destroy (&zf);
-    } else {
-        if (id)
-            *id = NULL;
+        if (nth-- == 0)
+            break;
+        p += len;
+        avail -= len;
     }
-    return 0;
+    return len;
 }
 
-/* replaces flux_msg_nexthop */
-int flux_msg_get_route_last (const flux_msg_t *msg, char **id)
+/* Validate route frame 'nth' and, if 'id' is non-NULL, set it to a copy
+ * of the frame as a string, or NULL if there are no route frames.
+ */
+static int route_strdup_nth (const flux_msg_t *msg, int nth, char **id)
 {
+    const uint8_t *data;
     uint8_t flags;
-    zframe_t *zf;
+    size_t n;
     char *s = NULL;
 
     if (flux_msg_get_flags (msg, &flags) < 0)
         return -1;
-    if (!(flags & FLUX_MSGFLAG_ROUTE) || !(zf = zmsg_first (msg->zmsg))) {
+    if (!(flags & FLUX_MSGFLAG_ROUTE)) {
         errno = EPROTO;
         return -1;
     }
-    if (zframe_size (zf) > 0 && !(s = zframe_strdup (zf))) {
-        errno = ENOMEM;
-        return -1;
+    if (msg->route_count > 0) {
+        if (route_get_nth (msg, nth, &data, &n) < 0)
+            return -1;
+        if (id && !(s = strndup ((const char *)data, n))) {
+            errno = ENOMEM;
+            return -1;
+        }
     }
-    *id = s;
+    if (id)
+        *id = s;
     return 0;
 }
 
-/* replaces flux_msg_sender */
-int flux_msg_get_route_first (const flux_msg_t *msg, char **id)
+int flux_msg_pop_route (flux_msg_t *msg, char **id)
 {
-    uint8_t flags;
-    zframe_t *zf, *zf_next;
-    char *s = NULL;
+    const uint8_t *data;
+    size_t n;
+    int len;
 
-    if (flux_msg_get_flags (msg, &flags) < 0)
+    if (route_strdup_nth (msg, 0, id) < 0)
         return -1;
-    if (!(flags & FLUX_MSGFLAG_ROUTE)) {
-        errno = EPROTO;
-        return -1;
-    }
-    zf = zmsg_first (msg->zmsg);
-    while (zf && zframe_size (zf) > 0) {
-        zf_next = zmsg_next (msg->zmsg);
-        if (zf_next && zframe_size (zf_next) == 0)
-            break;
-        zf = zf_next;
+    if (msg->route_count > 0) {
+        len = route_get_nth (msg, 0, &data, &n);
+        msg->hdr_off += len;
+        msg->route_count--;
+        msg->route_size -= len;
     }
-    if (!zf) {
-        errno = EPROTO;
-        return -1;
-    }
-    if (zframe_size (zf) > 0 && !(s = zframe_strdup (zf))) {
-        errno = ENOMEM;
-        return -1;
-    }
-    *id = s;
     return 0;
 }
 
+/* replaces flux_msg_nexthop */
+int flux_msg_get_route_last (const flux_msg_t *msg, char **id)
+{
+    return route_strdup_nth (msg, 0, id);
+}
+
+/* replaces flux_msg_sender */
+int flux_msg_get_route_first (const flux_msg_t *msg, char **id)
+{
+    return route_strdup_nth (msg, msg->route_count - 1, id);
+}
+
 int flux_msg_get_route_count (const flux_msg_t *msg)
 {
     uint8_t flags;
-    zframe_t *zf;
-    int count = 0;
 
     if (flux_msg_get_flags (msg, &flags) < 0)
         return -1;
@@ -851,105 +1081,84 @@ int flux_msg_get_route_count (const flux_msg_t *msg)
         errno = EPROTO;
         return -1;
     }
-    zf = zmsg_first (msg->zmsg);
-    while (zf && zframe_size (zf) > 0) {
-        zf = zmsg_next (msg->zmsg);
-        count++;
-    }
-    return count;
+    return msg->route_count;
 }
 
 /* Get sum of size in bytes of route frames
  */
 static int flux_msg_get_route_size (const flux_msg_t *msg)
 {
-    uint8_t flags;
-    zframe_t *zf;
-    int size = 0;
+    const uint8_t *data;
+    int i, size = 0;
+    size_t n;
 
-    if (flux_msg_get_flags (msg, &flags) < 0)
+    if (flux_msg_get_route_count (msg) < 0)
         return -1;
-    if (!(flags & FLUX_MSGFLAG_ROUTE)) {
-        errno = EPROTO;
-        return -1;
-    }
-    zf = zmsg_first (msg->zmsg);
-    while (zf && zframe_size (zf) > 0) {
-        size += zframe_size (zf);
-        zf = zmsg_next (msg->zmsg);
+    for (i = 0; i < msg->route_count; i++) {
+        if (route_get_nth (msg, i, &data, &n) < 0)
+            return -1;
+        size += n;
     }
     return size;
 }
 
-static zframe_t *flux_msg_get_route_nth (const flux_msg_t *msg, int n)
-{
-    uint8_t flags;
-    zframe_t *zf;
-    int count = 0;
-
-    if (flux_msg_get_flags (msg, &flags) < 0)
-        return NULL;
-    if (!(flags & FLUX_MSGFLAG_ROUTE)) {
-        errno = EPROTO;
-        return NULL;
-    }
-    zf = zmsg_first (msg->zmsg);
-    while (zf && zframe_size (zf) > 0) {
-        if (count == n)
-            return zf;
-        zf = zmsg_next (msg->zmsg);
-        count++;
-    }
-    errno = ENOENT;
-    return NULL;
-}
-
+/* Build the route string from the first pushed (the sender) to the most
+ * recently pushed, right to left, since frames are stored in reverse order.
+ */
 char *flux_msg_get_route_string (const flux_msg_t *msg)
 {
+    const uint8_t *p, *data;
+    size_t avail, n;
     int hops, len;
-    int n;
-    zframe_t *zf;
     char *buf, *cp;
+    int i;
 
     if (msg == NULL) {
         errno = EINVAL;
         return NULL;
     }
-    if ((hops = flux_msg_get_route_count (msg)) < 0
-                    || (len = flux_msg_get_route_size (msg)) < 0) {
+    if ((hops = flux_msg_get_route_count (msg)) < 0)
         return NULL;
-    }
-    if (!(cp = buf = malloc (len + hops + 1))) {
+    if (!(cp = buf = malloc (msg->route_size + 1))) {
         errno = ENOMEM;
         return NULL;
     }
-    for (n = hops - 1; n >= 0; n--) {
-        if (cp > buf)
-            *cp++ = '!';
-        if (!(zf = flux_msg_get_route_nth (msg, n))) {
+    cp += msg->route_size;
+    *cp = '\0';
+    p = msg->hdr + msg->hdr_off;
+    avail = msg->route_size;
+    for (i = 0; i < hops; i++) {
+        if ((len = frame_get (p, avail, &data, &n)) < 0) {
             free (buf);
+            errno = EPROTO;
             return NULL;
         }
-        int cpylen = zframe_size (zf);
-        if (cpylen == 32) /* abbreviate long UUID */
-            cpylen = 5;
-        assert (cp - buf + cpylen < len + hops);
-        memcpy (cp, zframe_data (zf), cpylen);
-        cp += cpylen;
-    }
-    *cp = '\0';
+        p += len;
+        avail -= len;
+        if (n == 32) /* abbreviate long UUID */
+            n = 5;
+        if (i > 0)
+            *--cp = '!';
+        cp -= n;
+        memcpy (cp, data, n);
+    }
+    if (cp > buf)
+        memmove (buf, cp, strlen (cp) + 1);
     return buf;
 }
 
-static bool payload_overlap (const void *b, zframe_t *zf)
+static bool payload_overlap (const void *b, struct msg_payload *p)
 {
-    return ((char *)b >= (char *)zframe_data (zf)
-         && (char *)b <  (char *)zframe_data (zf) + zframe_size (zf));
+    return ((char *)b >= (char *)p->data
+         && (char *)b <  (char *)p->data + p->size);
 }
 
+/* The payload may be shared with copies of 'msg' or with zeromq, so it
+ * is never modified in place.  A new payload replaces it.
+ */
 int flux_msg_set_payload (flux_msg_t *msg, const void *buf, int size)
 {
-    zframe_t *zf;
+    struct msg_payload *p;
     uint8_t flags;
     int rc = -1;
 
@@ -965,46 +1174,29 @@ int flux_msg_set_payload (flux_msg_t *msg, const void *buf, int size)
         rc = 0;
         goto done;
     }
-    zf = zmsg_first (msg->zmsg);
-    if ((flags & FLUX_MSGFLAG_ROUTE)) {
-        while (zf && zframe_size (zf) > 0)
-            zf = zmsg_next (msg->zmsg);      /* skip route frame */
-        if (zf)
-            zf = zmsg_next (msg->zmsg);      /* skip route delim */
-    }
-    if ((flags & FLUX_MSGFLAG_TOPIC)) {
-        if (zf)
-            zf = zmsg_next (msg->zmsg);      /* skip topic frame */
-    }
-    if (!zf) {                          /* must at least have proto frame */
-        errno = EPROTO;
-        goto done;
-    }
-    /* Case #1: replace existing payload.
+    /* Case #1: add or replace payload.
      */
-    if ((flags & FLUX_MSGFLAG_PAYLOAD) && (buf != NULL && size > 0)) {
-        if (zframe_data (zf) != buf || zframe_size (zf) != size) {
-            if (payload_overlap (buf, zf)) {
+    if (buf != NULL && size > 0) {
+        if (msg->payload) {
+            if (msg->payload->data == buf && msg->payload->size == size) {
+                rc = 0;
+                goto done;
+            }
+            if (payload_overlap (buf, msg->payload)) {
                 errno = EINVAL;
                 goto done;
             }
-            zframe_reset (zf, buf, size);
         }
-    /* Case #2: add payload.
-     */
-    } else if (!(flags & FLUX_MSGFLAG_PAYLOAD) && (buf != NULL && size > 0)) {
-        zmsg_remove (msg->zmsg, zf);
-        if (zmsg_addmem (msg->zmsg, buf, size) < 0
-                                        || zmsg_append (msg->zmsg, &zf) < 0) {
-            errno = ENOMEM;
+        if (!(p = payload_create (buf, size)))
             goto done;
-        }
+        payload_decref (msg->payload);
+        msg->payload = p;
         flags |= FLUX_MSGFLAG_PAYLOAD;
-    /* Case #3: remove payload.
+    /* Case #2: remove payload.
      */
-    } else if ((flags & FLUX_MSGFLAG_PAYLOAD) && (buf == NULL || size == 0)) {
-        zmsg_remove (msg->zmsg, zf);
-        zframe_destroy (&zf);
+    } else {
+        payload_decref (msg->payload);
+        msg->payload = NULL;
         flags &= ~(uint8_t)(FLUX_MSGFLAG_PAYLOAD);
     }
     if (flux_msg_set_flags (msg, flags) < 0)
@@ -1054,34 +1246,18 @@ int flux_msg_pack (flux_msg_t *msg, const char *fmt, ...)
 
 int flux_msg_get_payload (const flux_msg_t *msg, const void **buf, int *size)
 {
-    zframe_t *zf;
     uint8_t flags;
 
     if (flux_msg_get_flags (msg, &flags) < 0)
         return -1;
-    if (!(flags & FLUX_MSGFLAG_PAYLOAD)) {
-        errno = EPROTO;
-        return -1;
-    }
-    zf = zmsg_first (msg->zmsg);
-    if ((flags & FLUX_MSGFLAG_ROUTE)) {
-        while (zf && zframe_size (zf) > 0)
-            zf = zmsg_next (msg->zmsg);
-        if (zf)
-            zf = zmsg_next (msg->zmsg);
-    }
-    if ((flags & FLUX_MSGFLAG_TOPIC)) {
-        if (zf)
-            zf = zmsg_next (msg->zmsg);
-    }
-    if (!zf) {
+    if (!(flags & FLUX_MSGFLAG_PAYLOAD) || !msg->payload) {
         errno = EPROTO;
         return -1;
     }
     if (buf)
-        *buf = zframe_data (zf);
+        *buf = msg->payload->data;
     if (size)
-        *size = zframe_size (zf);
+        *size = msg->payload->size;
     return 0;
 }
 
@@ -1173,146 +1349,96 @@ int flux_msg_unpack (const flux_msg_t *msg, const char *fmt, ...)
     return rc;
 }
 
+/* The topic frame is last in the header arena, so replacing it moves
+ * the route frames ahead of it rather than anything after.
+ */
 int flux_msg_set_topic (flux_msg_t *msg, const char *topic)
 {
-    zframe_t *zf, *zf2 = NULL;
     uint8_t flags;
-    int rc = -1;
+    size_t off, oldlen, newlen, n = 0;
+    size_t newoff;
 
     if (flux_msg_get_flags (msg, &flags) < 0)
-        goto done;
-    zf = zmsg_first (msg->zmsg);
-    if ((flags & FLUX_MSGFLAG_ROUTE)) {   /* skip over routing frames, if any */
-        while (zf && zframe_size (zf) > 0)
-            zf = zmsg_next (msg->zmsg);
-        if (zf)
-            zf = zmsg_next (msg->zmsg);
-    }
-    if (!zf) {                          /* must at least have proto frame */
-        errno = EPROTO;
-        goto done;
-    }
-    if ((flags & FLUX_MSGFLAG_TOPIC) && topic) {        /* case 1: repl topic */
-        zframe_reset (zf, topic, strlen (topic) + 1);
-    } else if (!(flags & FLUX_MSGFLAG_TOPIC) && topic) {/* case 2: add topic */
-        zmsg_remove (msg->zmsg, zf);
-        if ((flags & FLUX_MSGFLAG_PAYLOAD) && (zf2 = zmsg_next (msg->zmsg)))
-            zmsg_remove (msg->zmsg, zf2);
-        if (zmsg_addmem (msg->zmsg, topic, strlen (topic) + 1) < 0
-                                    || zmsg_append (msg->zmsg, &zf) < 0
-                                    || (zf2 && zmsg_append (msg->zmsg, &zf2) < 0)) {
-            errno = ENOMEM;
-            goto done;
-        }
+        return -1;
+    if (!(flags & FLUX_MSGFLAG_TOPIC) && !topic)
+        return 0;
+    off = hdr_topic_off (msg, flags);
+    oldlen = 0;
+    if ((flags & FLUX_MSGFLAG_TOPIC))
+        oldlen = msg->hdr_size - msg->hdr_off - off;
+    newlen = 0;
+    if (topic) {
+        n = strlen (topic) + 1;
+        newlen = frame_encode_size (n);
+    }
+    if (newlen > oldlen && hdr_reserve (msg, newlen - oldlen) < 0)
+        return -1;
+    newoff = msg->hdr_off + oldlen - newlen;
+    memmove (msg->hdr + newoff, msg->hdr + msg->hdr_off, off);
+    msg->hdr_off = newoff;
+    if (topic) {
+        frame_put (msg->hdr + msg->hdr_off + off, topic, n);
         flags |= FLUX_MSGFLAG_TOPIC;
-        if (flux_msg_set_flags (msg, flags) < 0)
-            goto done;
-    } else if ((flags & FLUX_MSGFLAG_TOPIC) && !topic) { /* case 3: del topic */
-        zmsg_remove (msg->zmsg, zf);
-        zframe_destroy (&zf);
-        flags &= ~(uint8_t)FLUX_MSGFLAG_TOPIC;
-        if (flux_msg_set_flags (msg, flags) < 0)
-            goto done;
     }
-    rc = 0;
-done:
-    return rc;
+    else
+        flags &= ~(uint8_t)FLUX_MSGFLAG_TOPIC;
+    return flux_msg_set_flags (msg, flags);
 }
 
-static int zf_topic (const flux_msg_t *msg, zframe_t **zfp)
+int flux_msg_get_topic (const flux_msg_t *msg, const char **topic)
 {
+    const uint8_t *data;
     uint8_t flags;
-    zframe_t *zf = NULL;
-    int rc = -1;
+    size_t off, n;
 
     if (flux_msg_get_flags (msg, &flags) < 0)
-        goto done;
+        return -1;
     if (!(flags & FLUX_MSGFLAG_TOPIC)) {
         errno = EPROTO;
-        goto done;
-    }
-    zf = zmsg_first (msg->zmsg);
-    if ((flags & FLUX_MSGFLAG_ROUTE)) {
-        while (zf && zframe_size (zf) > 0)
-            zf = zmsg_next (msg->zmsg);
-        if (zf)
-            zf = zmsg_next (msg->zmsg);
-    }
-    if (!zf) {
-        errno = EPROTO;
-        goto done;
+        return -1;
     }
-    *zfp = zf;
-    rc = 0;
-done:
-    return rc;
-}
-
-int flux_msg_get_topic (const flux_msg_t *msg, const char **topic)
-{
-    zframe_t *zf;
-    const char *s;
-    int rc = -1;
-
-    if (zf_topic (msg, &zf) < 0)
-        goto done;
-    s = (const char *)zframe_data (zf);
-    if (s[zframe_size (zf) - 1] != '\0') {
+    off = msg->hdr_off + hdr_topic_off (msg, flags);
+    if (frame_get (msg->hdr + off, msg->hdr_size - off, &data, &n) < 0
+                                    || n == 0 || data[n - 1] != '\0') {
         errno = EPROTO;
-        goto done;
+        return -1;
     }
-    *topic = s;
-    rc = 0;
-done:
-    return rc;
+    *topic = (const char *)data;
+    return 0;
 }
 
+/* A copy is a single allocation, unless the header frames have outgrown
+ * the inline arena.  The payload is shared, not copied.
+ */
 flux_msg_t *flux_msg_copy (const flux_msg_t *msg, bool payload)
 {
     flux_msg_t *cpy = NULL;
-    zframe_t *zf;
-    int count;
+    size_t hdrlen;
     uint8_t flags;
-    bool skip_payload = false;
 
     if (msg->magic != FLUX_MSG_MAGIC) {
         errno = EINVAL;
         goto error;
     }
-    /* Set skip_payload = true if caller set 'payload' flag false
-     * AND message contains a payload frame.
-     */
     if (flux_msg_get_flags (msg, &flags) < 0)
         goto error;
-    if (!payload && (flags & FLUX_MSGFLAG_PAYLOAD)) {
+    if (!payload)
         flags &= ~(FLUX_MSGFLAG_PAYLOAD);
-        skip_payload = true;
-    }
-    if (!(cpy = calloc (1, sizeof (*cpy))))
-        goto nomem;
-    cpy->magic = FLUX_MSG_MAGIC;
-    if (!(cpy->zmsg = zmsg_new ()))
-        goto nomem;
-
-    /* Copy frames from 'msg' to 'cpy'.
-     * 'count' indexes frames from 0 to zmsg_size (msg) - 1.
-     * The payload frame (if it exists) will be in the second to last position.
-     */
-    count = 0;
-    zf = zmsg_first (msg->zmsg);
-    while (zf) {
-        if (!skip_payload || count != zmsg_size (msg->zmsg) - 2) {
-            if (zmsg_addmem (cpy->zmsg, zframe_data (zf), zframe_size (zf)) < 0)
-                goto nomem;
-        }
-        zf = zmsg_next (msg->zmsg);
-        count++;
-    }
+    if (!(cpy = msg_alloc ()))
+        goto error;
+    memcpy (cpy->proto, msg->proto, PROTO_SIZE);
+    hdrlen = msg->hdr_size - msg->hdr_off;
+    if (hdr_reserve (cpy, hdrlen) < 0)
+        goto error;
+    cpy->hdr_off -= hdrlen;
+    memcpy (cpy->hdr + cpy->hdr_off, msg->hdr + msg->hdr_off, hdrlen);
+    cpy->route_size = msg->route_size;
+    cpy->route_count = msg->route_count;
+    if ((flags & FLUX_MSGFLAG_PAYLOAD) && msg->payload)
+        cpy->payload = payload_incref (msg->payload);
     if (flux_msg_set_flags (cpy, flags) < 0)
         goto error;
     return cpy;
-nomem:
-    errno = ENOMEM;
 error:
     flux_msg_destroy (cpy);
     return NULL;
@@ -1357,16 +1483,15 @@ void flux_msg_fprint (FILE *f, const flux_msg_t *msg)
 {
     int hops;
     int type = 0;
-    zframe_t *proto;
     const char *prefix, *topic = NULL;
+    int i;
 
     fprintf (f, "--------------------------------------\n");
     if (!msg) {
         fprintf (f, "NULL");
         return;
     }
-    if (flux_msg_get_type (msg, &type) < 0
-            || (!(proto = zmsg_last (msg->zmsg)))) {
+    if (flux_msg_get_type (msg, &type) < 0) {
         fprintf (f, "malformed message");
         return;
     }
@@ -1401,11 +1526,51 @@ void flux_msg_fprint (FILE *f, const flux_msg_t *msg)
     }
     /* Proto block
      */
-    zframe_fprint (proto, prefix, f);
+    fprintf (f, "%s[%3.3d] ", prefix, PROTO_SIZE);
+    for (i = 0; i < PROTO_SIZE; i++)
+        fprintf (f, "%02X", msg->proto[i]);
+    fprintf (f, "\n");
 }
 
 #define IOBUF_MAGIC 0xffee0012
 
+/* On a stream, a message is preceded by the iobuf magic and its encoded
+ * size.  msg_iov() describes the framed message as at most MSG_IOV_MAX
+ * iovecs that refer to the message in place, with the bytes that are not
+ * held by the message (stream header, payload frame size, proto frame)
+ * put in 'scratch'.  Sets 'sizep' to the total size.
+ */
+#define MSG_IOV_MAX         5
+#define MSG_SCRATCH_SIZE    (8 + 5 + 1 + PROTO_SIZE)
+
+static int msg_iov (const flux_msg_t *msg, uint8_t *scratch,
+                    struct iovec *iov, size_t *sizep)
+{
+    uint32_t magic = IOBUF_MAGIC;
+    uint32_t size = htonl (flux_msg_encode_size (msg));
+    uint8_t *p;
+    int n = 0;
+
+    memcpy (scratch, &magic, sizeof (magic));
+    memcpy (scratch + 4, &size, sizeof (size));
+    iov[n].iov_base = scratch;
+    iov[n++].iov_len = 8;
+    iov[n].iov_base = msg->hdr + msg->hdr_off;
+    iov[n++].iov_len = msg->hdr_size - msg->hdr_off;
+    p = scratch + 8;
+    if (msg->payload) {
+        iov[n].iov_base = p;
+        iov[n++].iov_len = frame_put_size (p, msg->payload->size) - p;
+        iov[n].iov_base = msg->payload->data;
+        iov[n++].iov_len = msg->payload->size;
+        p += iov[n - 2].iov_len;
+    }
+    iov[n].iov_base = p;
+    iov[n++].iov_len = frame_put (p, msg->proto, PROTO_SIZE) - p;
+    *sizep = ntohl (size) + 8;
+    return n;
+}
+
 void flux_msg_iobuf_init (struct flux_msg_iobuf *iobuf)
 {
     memset (iobuf, 0, sizeof (*iobuf));
@@ -1432,18 +1597,33 @@ int flux_msg_sendfd (int fd, const flux_msg_t *msg,
     if (!iobuf)
         flux_msg_iobuf_init (&local);
     if (!io->buf) {
-        io->size = flux_msg_encode_size (msg) + 8;
+        uint8_t scratch[MSG_SCRATCH_SIZE];
+        struct iovec iov[MSG_IOV_MAX];
+        size_t size;
+        ssize_t n;
+        int iovcnt;
+
+        /* Write the message in place if possible.  It need only be
+         * encoded to io->buf if the write is partial and must be resumed.
+         */
+        iovcnt = msg_iov (msg, scratch, iov, &size);
+        if ((n = writev (fd, iov, iovcnt)) == (ssize_t)size) {
+            rc = 0;
+            goto done;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            goto done;
+        io->size = size;
         if (io->size <= sizeof (io->buf_fixed))
             io->buf = io->buf_fixed;
         else if (!(io->buf = malloc (io->size))) {
             errno = ENOMEM;
             goto done;
         }
-        *(uint32_t *)&io->buf[0] = IOBUF_MAGIC;
-        *(uint32_t *)&io->buf[4] = htonl (io->size - 8);
+        memcpy (io->buf, scratch, 8);
         if (flux_msg_encode (msg, &io->buf[8], io->size - 8) < 0)
             goto done;
-        io->done = 0;
+        io->done = n > 0 ? n : 0;
     }
     do {
         rc = write (fd, io->buf + io->done, io->size - io->done);
@@ -1464,6 +1644,66 @@ done:
     return rc;
 }
 
+/* Maximum number of messages coalesced into one writev(2) call,
+ * which keeps the iovec array well under IOV_MAX.
+ */
+#define SENDFD_BATCH_MAX    64
+
+int flux_msg_sendfd_batch (int fd, const flux_msg_t *msgs[], int count,
+                           struct flux_msg_iobuf *iobuf)
+{
+    uint8_t scratch[SENDFD_BATCH_MAX][MSG_SCRATCH_SIZE];
+    struct iovec iov[SENDFD_BATCH_MAX * MSG_IOV_MAX];
+    size_t size[SENDFD_BATCH_MAX];
+    int sent = 0;
+
+    if (fd < 0 || !msgs || count < 0 || !iobuf) {
+        errno = EINVAL;
+        return -1;
+    }
+    while (sent < count) {
+        int batch = count - sent;
+        struct iovec *v = iov;
+        size_t skip = iobuf->done;
+        int iovcnt = 0;
+        ssize_t n;
+        size_t done;
+        int i;
+
+        if (batch > SENDFD_BATCH_MAX)
+            batch = SENDFD_BATCH_MAX;
+        for (i = 0; i < batch; i++)
+            iovcnt += msg_iov (msgs[sent + i], scratch[i],
+                               &iov[iovcnt], &size[i]);
+        /* Skip the part of msgs[sent] written by a previous call.
+         */
+        while (skip > 0) {
+            if (skip >= v->iov_len) {
+                skip -= v->iov_len;
+                v++;
+                iovcnt--;
+            }
+            else {
+                v->iov_base = (uint8_t *)v->iov_base + skip;
+                v->iov_len -= skip;
+                skip = 0;
+            }
+        }
+        if ((n = writev (fd, v, iovcnt)) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        done = iobuf->done + n;
+        for (i = 0; i < batch && done >= size[i]; i++) {
+            done -= size[i];
+            sent++;
+        }
+        iobuf->done = done;
+    }
+    return sent;
+}
+
 flux_msg_t *flux_msg_recvfd (int fd, struct flux_msg_iobuf *iobuf)
 {
     struct flux_msg_iobuf local;
@@ -1531,30 +1771,246 @@ done:
     return msg;
 }
 
+/* Initial size of the reader buffer.  It grows as needed to hold a
+ * larger message, and is returned to this size once drained.
+ */
+#define READER_BUFSIZE      65536
+
+struct flux_msg_reader {
+    uint8_t *buf;
+    size_t size;
+    size_t start;       /* unconsumed data is at start..end */
+    size_t end;
+};
+
+struct flux_msg_reader *flux_msg_reader_create (void)
+{
+    struct flux_msg_reader *r;
+
+    if (!(r = calloc (1, sizeof (*r))))
+        goto nomem;
+    if (!(r->buf = malloc (READER_BUFSIZE)))
+        goto nomem;
+    r->size = READER_BUFSIZE;
+    return r;
+nomem:
+    flux_msg_reader_destroy (r);
+    errno = ENOMEM;
+    return NULL;
+}
+
+void flux_msg_reader_destroy (struct flux_msg_reader *r)
+{
+    if (r) {
+        int saved_errno = errno;
+        free (r->buf);
+        free (r);
+        errno = saved_errno;
+    }
+}
+
+/* Set 'sizep' to the framed size of the message at r->start, or the
+ * size of its header if that is not yet complete.
+ * Returns 1 if the message is complete, 0 if not, or -1 if the header
+ * is invalid.
+ */
+static int reader_check (struct flux_msg_reader *r, size_t *sizep)
+{
+    size_t avail = r->end - r->start;
+    uint32_t magic, size;
+
+    *sizep = 8;
+    if (avail < 8)
+        return 0;
+    memcpy (&magic, r->buf + r->start, sizeof (magic));
+    memcpy (&size, r->buf + r->start + 4, sizeof (size));
+    if (magic != IOBUF_MAGIC)
+        return -1;
+    *sizep = ntohl (size) + 8;
+    return avail >= *sizep ? 1 : 0;
+}
+
+/* Ensure there is room for 'size' bytes at r->start, moving unconsumed
+ * data to the front of the buffer, or growing it, if necessary.
+ */
+static int reader_reserve (struct flux_msg_reader *r, size_t size)
+{
+    if (r->start + size <= r->size)
+        return 0;
+    if (r->start > 0) {
+        memmove (r->buf, r->buf + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->start = 0;
+    }
+    if (size > r->size) {
+        uint8_t *buf;
+        if (!(buf = realloc (r->buf, size))) {
+            errno = ENOMEM;
+            return -1;
+        }
+        r->buf = buf;
+        r->size = size;
+    }
+    return 0;
+}
+
+flux_msg_t *flux_msg_reader_recv (struct flux_msg_reader *r, int fd)
+{
+    flux_msg_t *msg;
+    size_t size;
+    ssize_t n;
+    int rc;
+
+    if (!r || fd < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    while ((rc = reader_check (r, &size)) == 0) {
+        if (reader_reserve (r, size) < 0)
+            return NULL;
+        if ((n = read (fd, r->buf + r->end, r->size - r->end)) < 0)
+            return NULL;
+        if (n == 0) {
+            errno = EPROTO;
+            return NULL;
+        }
+        r->end += n;
+    }
+    if (rc < 0) {
+        errno = EPROTO;
+        return NULL;
+    }
+    msg = flux_msg_decode (r->buf + r->start + 8, size - 8);
+    r->start += size;
+    if (r->start == r->end) {
+        r->start = r->end = 0;
+        if (r->size > READER_BUFSIZE) {
+            uint8_t *buf;
+            if ((buf = realloc (r->buf, READER_BUFSIZE))) {
+                r->buf = buf;
+                r->size = READER_BUFSIZE;
+            }
+        }
+    }
+    return msg;
+}
+
+bool flux_msg_reader_pending (struct flux_msg_reader *r)
+{
+    size_t size;
+
+    /* An invalid header is reported as pending so that the error is
+     * returned by the next flux_msg_reader_recv().
+     */
+    return r && reader_check (r, &size) != 0;
+}
+
 int flux_msg_sendzsock (void *sock, const flux_msg_t *msg)
 {
-    int rc = -1;
+    const uint8_t *p, *data;
+    size_t avail, n;
+    void *handle;
+    int len;
 
-    if (!sock || !msg || !zmsg_is (msg->zmsg)) {
+    if (!sock || !msg || msg->magic != FLUX_MSG_MAGIC) {
         errno = EINVAL;
-        goto done;
+        return -1;
     }
+    handle = zsock_resolve (sock);
+    p = msg->hdr + msg->hdr_off;
+    avail = msg->hdr_size - msg->hdr_off;
+    while (avail > 0) {
+        if ((len = frame_get (p, avail, &data, &n)) < 0) {
+            errno = EPROTO;
+            return -1;
+        }
+        if (zmq_send (handle, data, n, ZMQ_SNDMORE) < 0)
+            return -1;
+        p += len;
+        avail -= len;
+    }
+    if (msg->payload && payload_send (msg->payload, handle) < 0)
+        return -1;
+    if (zmq_send (handle, msg->proto, PROTO_SIZE, 0) < 0)
+        return -1;
+    return 0;
+}
 
-    void *handle = zsock_resolve (sock);
-    int flags = ZFRAME_REUSE | ZFRAME_MORE;
-    zframe_t *zf = zmsg_first (msg->zmsg);
-    size_t count = 0;
+/* Convert a received zmsg to a message, taking the payload frame, if any,
+ * without copying.
+ */
+static flux_msg_t *msg_from_zmsg (zmsg_t *zmsg)
+{
+    flux_msg_t *msg = NULL;
+    zframe_t *proto, *zf, *payload = NULL;
+    size_t hdrlen = 0;
+    int nframes = 0;
+    bool delim = false;
+    uint8_t flags;
+    uint8_t *p;
+    int i;
 
-    while (zf) {
-        if (++count == zmsg_size (msg->zmsg))
-            flags &= ~ZFRAME_MORE;
-        if (zframe_send (&zf, handle, flags) < 0)
-            goto done;
-        zf = zmsg_next (msg->zmsg);
+    if (!(proto = zmsg_last (zmsg))
+            || zframe_size (proto) != PROTO_SIZE
+            || proto_get_flags (zframe_data (proto), PROTO_SIZE, &flags) < 0)
+        goto eproto;
+    if (!(msg = msg_alloc ()))
+        return NULL;
+    memcpy (msg->proto, zframe_data (proto), PROTO_SIZE);
+    zf = zmsg_first (zmsg);
+    if ((flags & FLUX_MSGFLAG_ROUTE)) {
+        while (zf && zf != proto && !delim) {
+            size_t len = frame_encode_size (zframe_size (zf));
+            if (zframe_size (zf) == 0)
+                delim = true;
+            else {
+                msg->route_count++;
+                msg->route_size += len;
+            }
+            hdrlen += len;
+            nframes++;
+            zf = zmsg_next (zmsg);
+        }
+        if (!delim)
+            goto eproto;
     }
-    rc = 0;
-done:
-    return rc;
+    if ((flags & FLUX_MSGFLAG_TOPIC)) {
+        if (!zf || zf == proto)
+            goto eproto;
+        hdrlen += frame_encode_size (zframe_size (zf));
+        nframes++;
+        zf = zmsg_next (zmsg);
+    }
+    if ((flags & FLUX_MSGFLAG_PAYLOAD)) {
+        if (!zf || zf == proto)
+            goto eproto;
+        payload = zf;
+        zf = zmsg_next (zmsg);
+    }
+    if (zf != proto)
+        goto eproto;
+    if (hdr_reserve (msg, hdrlen) < 0)
+        goto error;
+    msg->hdr_off -= hdrlen;
+    p = msg->hdr + msg->hdr_off;
+    zf = zmsg_first (zmsg);
+    for (i = 0; i < nframes; i++) {
+        p = frame_put (p, zframe_data (zf), zframe_size (zf));
+        zf = zmsg_next (zmsg);
+    }
+    if (payload) {
+        zmsg_remove (zmsg, payload);
+        if (!(msg->payload = payload_wrap (payload))) {
+            zframe_destroy (&payload);
+            goto error;
+        }
+    }
+    return msg;
+eproto:
+    errno = EPROTO;
+error:
+    flux_msg_destroy (msg);
+    return NULL;
 }
 
 flux_msg_t *flux_msg_recvzsock (void *sock)
@@ -1564,19 +2020,25 @@ flux_msg_t *flux_msg_recvzsock (void *sock)
 
     if (!(zmsg = zmsg_recv (sock)))
         return NULL;
-    if (!(msg = calloc (1, sizeof (*msg)))) {
-        zmsg_destroy (&zmsg);
-        errno = ENOMEM;
-        return NULL;
-    }
-    msg->magic = FLUX_MSG_MAGIC;
-    msg->zmsg = zmsg;
+    msg = msg_from_zmsg (zmsg);
+    zmsg_destroy (&zmsg);
     return msg;
 }
 
 int flux_msg_frames (const flux_msg_t *msg)
 {
-    return zmsg_size (msg->zmsg);
+    uint8_t flags;
+    int n = 1;
+
+    if (flux_msg_get_flags (msg, &flags) < 0)
+        return -1;
+    if ((flags & FLUX_MSGFLAG_ROUTE))
+        n += msg->route_count + 1;
+    if ((flags & FLUX_MSGFLAG_TOPIC))
+        n++;
+    if ((flags & FLUX_MSGFLAG_PAYLOAD))
+        n++;
+    return n;
 }
 
 /*
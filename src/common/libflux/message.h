@@ -82,6 +82,14 @@ struct flux_msg_iobuf {
 flux_msg_t *flux_msg_create (int type);
 void flux_msg_destroy (flux_msg_t *msg);
 
+/* Take/drop a reference on 'msg', which is destroyed when the last
+ * reference is dropped.  flux_msg_destroy() is equivalent to
+ * flux_msg_decref().  Use instead of flux_msg_copy() to retain a message
+ * that will not be modified.  flux_msg_incref() returns 'msg'.
+ */
+const flux_msg_t *flux_msg_incref (const flux_msg_t *msg);
+void flux_msg_decref (const flux_msg_t *msg);
+
 /* Access auxiliary data members in Flux message.
  * These are for convenience only - they are not sent over the wire.
  */
@@ -90,6 +98,8 @@ int flux_msg_aux_set (const flux_msg_t *msg, const char *name,
 void *flux_msg_aux_get (const flux_msg_t *msg, const char *name);
 
 /* Duplicate msg, omitting payload if 'payload' is false.
+ * The copy shares the payload of 'msg' rather than copying it, so this is
+ * inexpensive regardless of payload size.
  */
 flux_msg_t *flux_msg_copy (const flux_msg_t *msg, bool payload);
 
@@ -122,6 +132,33 @@ int flux_msg_sendfd (int fd, const flux_msg_t *msg,
  */
 flux_msg_t *flux_msg_recvfd (int fd, struct flux_msg_iobuf *iobuf);
 
+/* Send 'count' messages to file descriptor, as flux_msg_sendfd() would,
+ * coalescing them into as few writev(2) calls as possible.  Messages are
+ * written in place, without first encoding them to a buffer.
+ * If the descriptor would block, the number of bytes of the first unsent
+ * message already written is kept in 'iobuf', and that message must be
+ * passed first on the next call.  Do not mix with flux_msg_sendfd() on
+ * the same iobuf.
+ * Returns the number of messages sent, which is less than 'count' only
+ * if the descriptor would block, or -1 on failure with errno set.
+ */
+int flux_msg_sendfd_batch (int fd, const flux_msg_t *msgs[], int count,
+                           struct flux_msg_iobuf *iobuf);
+
+/* Buffered receive of messages sent with flux_msg_sendfd().  Each read(2)
+ * takes as much as is available, so a burst of messages is received with
+ * one system call rather than two per message.
+ * flux_msg_reader_recv() returns a message on success, or NULL with errno
+ * set, e.g. EAGAIN/EWOULDBLOCK if the descriptor is nonblocking and no
+ * complete message has arrived, or EPROTO on EOF or malformed input.
+ * flux_msg_reader_pending() returns true if flux_msg_reader_recv() can
+ * return without reading, i.e. the descriptor need not become readable.
+ */
+struct flux_msg_reader *flux_msg_reader_create (void);
+void flux_msg_reader_destroy (struct flux_msg_reader *r);
+flux_msg_t *flux_msg_reader_recv (struct flux_msg_reader *r, int fd);
+bool flux_msg_reader_pending (struct flux_msg_reader *r);
+
 /* Send message to zeromq socket.
  * Returns 0 on success, -1 on failure with errno set.
  */
@@ -157,6 +194,7 @@ bool flux_msg_is_private (const flux_msg_t *msg);
 
 /* Get/set/compare message topic string.
  * set adds/deletes/replaces topic frame as needed.
+ * The topic returned by get remains valid until 'msg' is modified.
  */
 int flux_msg_set_topic (flux_msg_t *msg, const char *topic);
 int flux_msg_get_topic (const flux_msg_t *msg, const char **topic);
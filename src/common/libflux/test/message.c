@@ -14,6 +14,7 @@
 #include <czmq.h>
 #include <errno.h>
 #include <stdio.h>
+#include <sys/socket.h>
 #include <jansson.h>
 
 #include "src/common/libflux/message.h"
@@ -523,6 +524,132 @@ void check_encode (void)
     flux_msg_destroy (msg2);
 }
 
+void check_encode_payload (void)
+{
+    flux_msg_t *msg, *msg2;
+    char pay[1024];
+    const void *buf;
+    void *ebuf;
+    size_t size;
+    const char *topic;
+    char *s;
+    int len;
+
+    memset (pay, 7, sizeof (pay));
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_REQUEST))
+            || flux_msg_enable_route (msg) < 0
+            || flux_msg_push_route (msg, "id1") < 0
+            || flux_msg_set_payload (msg, pay, sizeof (pay)) < 0
+            || flux_msg_set_topic (msg, "foo.bar") < 0)
+        BAIL_OUT ("could not create test message");
+    size = flux_msg_encode_size (msg);
+    if (!(ebuf = malloc (size)))
+        BAIL_OUT ("out of memory");
+    errno = 0;
+    ok (flux_msg_encode (msg, ebuf, size - 1) < 0 && errno == EINVAL,
+        "flux_msg_encode with payload fails with EINVAL on short buffer");
+    ok (flux_msg_encode (msg, ebuf, size) == 0,
+        "flux_msg_encode with routes, topic, and payload works");
+    ok ((msg2 = flux_msg_decode (ebuf, size)) != NULL,
+        "flux_msg_decode works");
+    free (ebuf);
+    ok (flux_msg_frames (msg2) == 5,
+        "decoded message has 5 frames");
+    ok (flux_msg_get_topic (msg2, &topic) == 0 && !strcmp (topic, "foo.bar"),
+        "decoded expected topic string");
+    s = NULL;
+    ok (flux_msg_get_route_first (msg2, &s) == 0 && s && !strcmp (s, "id1"),
+        "decoded expected route");
+    free (s);
+    ok (flux_msg_get_payload (msg2, &buf, &len) == 0
+        && len == sizeof (pay) && memcmp (buf, pay, len) == 0,
+        "decoded expected payload");
+
+    flux_msg_destroy (msg);
+    flux_msg_destroy (msg2);
+}
+
+/* Push enough routes and a long enough topic to outgrow the space
+ * reserved for header frames in a message.
+ */
+void check_header_grow (void)
+{
+    flux_msg_t *msg, *cpy, *msg2;
+    char id[33];
+    char topic[1024];
+    const char *s;
+    char *route;
+    void *buf;
+    size_t size;
+    int i, ok_routes;
+
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_REQUEST))
+            || flux_msg_set_topic (msg, "foo") < 0
+            || flux_msg_enable_route (msg) < 0)
+        BAIL_OUT ("could not create test message");
+    ok_routes = 1;
+    for (i = 0; i < 64; i++) {
+        snprintf (id, sizeof (id), "%032d", i);
+        if (flux_msg_push_route (msg, id) < 0)
+            ok_routes = 0;
+    }
+    ok (ok_routes && flux_msg_get_route_count (msg) == 64,
+        "pushed 64 32-byte routes");
+    ok (flux_msg_get_topic (msg, &s) == 0 && !strcmp (s, "foo"),
+        "topic is intact");
+    route = NULL;
+    ok (flux_msg_get_route_first (msg, &route) == 0 && route
+        && !strcmp (route, "00000000000000000000000000000000"),
+        "flux_msg_get_route_first returns first pushed route");
+    free (route);
+    route = NULL;
+    ok (flux_msg_get_route_last (msg, &route) == 0 && route
+        && !strcmp (route, "00000000000000000000000000000063"),
+        "flux_msg_get_route_last returns last pushed route");
+    free (route);
+
+    memset (topic, 't', sizeof (topic) - 1);
+    topic[sizeof (topic) - 1] = '\0';
+    ok (flux_msg_set_topic (msg, topic) == 0
+        && flux_msg_get_topic (msg, &s) == 0 && !strcmp (s, topic),
+        "replaced topic with a long one");
+    ok ((cpy = flux_msg_copy (msg, true)) != NULL
+        && flux_msg_get_route_count (cpy) == 64
+        && flux_msg_get_topic (cpy, &s) == 0 && !strcmp (s, topic),
+        "flux_msg_copy copies routes and topic");
+    ok (flux_msg_set_topic (cpy, "bar") == 0
+        && flux_msg_get_topic (cpy, &s) == 0 && !strcmp (s, "bar")
+        && flux_msg_get_route_count (cpy) == 64,
+        "replaced topic of copy with a short one, routes intact");
+    flux_msg_destroy (cpy);
+
+    size = flux_msg_encode_size (msg);
+    if (!(buf = malloc (size)))
+        BAIL_OUT ("out of memory");
+    ok (flux_msg_encode (msg, buf, size) == 0
+        && (msg2 = flux_msg_decode (buf, size)) != NULL
+        && flux_msg_get_route_count (msg2) == 64
+        && flux_msg_get_topic (msg2, &s) == 0 && !strcmp (s, topic),
+        "encode/decode preserves routes and long topic");
+    flux_msg_destroy (msg2);
+
+    errno = 0;
+    ok (flux_msg_decode (buf, size - 1) == NULL && errno == EPROTO,
+        "flux_msg_decode fails with EPROTO on truncated message");
+    ((uint8_t *)buf)[size - 20] ^= 0xff; /* PROTO_MAGIC */
+    errno = 0;
+    ok (flux_msg_decode (buf, size) == NULL && errno == EPROTO,
+        "flux_msg_decode fails with EPROTO on bad proto magic");
+    free (buf);
+
+    ok (flux_msg_clear_route (msg) == 0
+        && flux_msg_get_route_count (msg) < 0
+        && flux_msg_frames (msg) == 2
+        && flux_msg_get_topic (msg, &s) == 0 && !strcmp (s, topic),
+        "flux_msg_clear_route leaves topic intact");
+    flux_msg_destroy (msg);
+}
+
 /* Send a small message over a blocking pipe.
  * We assume that there's enough buffer to do this in one go.
  */
@@ -556,6 +683,172 @@ void check_sendfd (void)
     close (pfd[0]);
 }
 
+/* Create a message with sequence number 'seq' in its matchtag,
+ * and a payload of 'size' bytes filled with the low byte of 'seq'.
+ */
+static flux_msg_t *create_seq_msg (int seq, int size)
+{
+    flux_msg_t *msg;
+    char *buf = NULL;
+
+    if (size > 0) {
+        if (!(buf = malloc (size)))
+            BAIL_OUT ("out of memory");
+        memset (buf, seq & 0xff, size);
+    }
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_RESPONSE))
+            || flux_msg_set_topic (msg, "foo.bar") < 0
+            || flux_msg_set_matchtag (msg, seq) < 0
+            || (size > 0 && flux_msg_set_payload (msg, buf, size) < 0))
+        BAIL_OUT ("could not create test message");
+    free (buf);
+    return msg;
+}
+
+static bool check_seq_msg (const flux_msg_t *msg, int seq, int size)
+{
+    uint32_t matchtag;
+    const char *buf;
+    int len = 0;
+    int i;
+
+    if (flux_msg_get_matchtag (msg, &matchtag) < 0 || matchtag != seq)
+        return false;
+    if (size == 0)
+        return !flux_msg_has_payload (msg);
+    if (flux_msg_get_payload (msg, (const void **)&buf, &len) < 0
+                                                        || len != size)
+        return false;
+    for (i = 0; i < len; i++) {
+        if (buf[i] != (char)(seq & 0xff))
+            return false;
+    }
+    return true;
+}
+
+/* Send messages of mixed sizes over a nonblocking socketpair with
+ * flux_msg_sendfd_batch(), enough to fill the socket buffer so that
+ * partial writes must be resumed, while receiving them with a reader.
+ */
+void check_sendfd_batch (void)
+{
+    const int count = 256;
+    int sizes[] = { 0, 16, 300, 4096, 100000 };
+    int nsizes = sizeof (sizes) / sizeof (sizes[0]);
+    const flux_msg_t *msgs[count];
+    struct flux_msg_iobuf iobuf;
+    struct flux_msg_reader *r;
+    int sv[2];
+    int sent = 0, received = 0;
+    int blocked = 0, errors = 0;
+    int i, n;
+
+    ok (socketpair (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) == 0,
+        "got nonblocking socketpair");
+    ok ((r = flux_msg_reader_create ()) != NULL,
+        "flux_msg_reader_create works");
+    for (i = 0; i < count; i++)
+        msgs[i] = create_seq_msg (i, sizes[i % nsizes]);
+    flux_msg_iobuf_init (&iobuf);
+
+    ok (flux_msg_sendfd_batch (sv[1], msgs, 0, &iobuf) == 0,
+        "flux_msg_sendfd_batch count=0 sends nothing");
+    errno = 0;
+    ok (flux_msg_sendfd_batch (-1, msgs, 1, &iobuf) < 0 && errno == EINVAL,
+        "flux_msg_sendfd_batch fd=-1 fails with EINVAL");
+    errno = 0;
+    ok (flux_msg_reader_recv (r, sv[0]) == NULL && errno == EAGAIN,
+        "flux_msg_reader_recv fails with EAGAIN on empty socket");
+
+    while (received < count) {
+        flux_msg_t *msg;
+        if (sent < count) {
+            if ((n = flux_msg_sendfd_batch (sv[1], &msgs[sent], count - sent,
+                                            &iobuf)) < 0)
+                BAIL_OUT ("flux_msg_sendfd_batch failed");
+            sent += n;
+            if (sent < count)
+                blocked++;
+        }
+        while ((msg = flux_msg_reader_recv (r, sv[0]))) {
+            if (!check_seq_msg (msg, received, sizes[received % nsizes]))
+                errors++;
+            received++;
+            flux_msg_destroy (msg);
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            BAIL_OUT ("flux_msg_reader_recv failed");
+    }
+    ok (blocked > 0,
+        "flux_msg_sendfd_batch returned short count when socket was full");
+    ok (received == count && errors == 0,
+        "flux_msg_reader_recv received %d messages intact and in order",
+        count);
+    ok (flux_msg_reader_pending (r) == false,
+        "flux_msg_reader_pending is false once drained");
+
+    for (i = 0; i < count; i++)
+        flux_msg_destroy ((flux_msg_t *)msgs[i]);
+    flux_msg_reader_destroy (r);
+    close (sv[1]);
+    close (sv[0]);
+}
+
+/* Check that a burst of messages sent with flux_msg_sendfd() is taken in
+ * one read by a reader, and that EOF and bad input are reported.
+ */
+void check_reader (void)
+{
+    struct flux_msg_reader *r;
+    flux_msg_t *msg;
+    uint32_t bad = 0xdeadbeef;
+    int sv[2];
+    int i;
+
+    ok (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) == 0,
+        "got blocking socketpair");
+    ok ((r = flux_msg_reader_create ()) != NULL,
+        "flux_msg_reader_create works");
+    for (i = 0; i < 3; i++) {
+        msg = create_seq_msg (i, 64);
+        if (flux_msg_sendfd (sv[1], msg, NULL) < 0)
+            BAIL_OUT ("flux_msg_sendfd failed");
+        flux_msg_destroy (msg);
+    }
+    ok ((msg = flux_msg_reader_recv (r, sv[0])) != NULL
+        && check_seq_msg (msg, 0, 64),
+        "flux_msg_reader_recv received first message");
+    flux_msg_destroy (msg);
+    ok (flux_msg_reader_pending (r) == true,
+        "flux_msg_reader_pending is true with remaining messages buffered");
+    ok ((msg = flux_msg_reader_recv (r, sv[0])) != NULL
+        && check_seq_msg (msg, 1, 64),
+        "flux_msg_reader_recv received second message");
+    flux_msg_destroy (msg);
+    ok ((msg = flux_msg_reader_recv (r, sv[0])) != NULL
+        && check_seq_msg (msg, 2, 64),
+        "flux_msg_reader_recv received third message");
+    flux_msg_destroy (msg);
+    ok (flux_msg_reader_pending (r) == false,
+        "flux_msg_reader_pending is false once drained");
+
+    ok (write (sv[1], &bad, sizeof (bad)) == sizeof (bad)
+        && write (sv[1], &bad, sizeof (bad)) == sizeof (bad),
+        "wrote bad header");
+    ok (flux_msg_reader_recv (r, sv[0]) == NULL && errno == EPROTO,
+        "flux_msg_reader_recv fails with EPROTO on bad header");
+    flux_msg_reader_destroy (r);
+
+    ok ((r = flux_msg_reader_create ()) != NULL,
+        "flux_msg_reader_create works");
+    close (sv[1]);
+    errno = 0;
+    ok (flux_msg_reader_recv (r, sv[0]) == NULL && errno == EPROTO,
+        "flux_msg_reader_recv fails with EPROTO on EOF");
+    flux_msg_reader_destroy (r);
+    close (sv[0]);
+}
+
 void check_sendzsock (void)
 {
     zsock_t *zsock[2] = { NULL, NULL };
@@ -602,6 +895,82 @@ void check_sendzsock (void)
     zsock_destroy (&zsock[1]);
 }
 
+/* A payload large enough to be shared with zeromq rather than copied
+ * must survive destruction of the sent message and its copies.
+ */
+void check_sendzsock_payload (void)
+{
+    zsock_t *zsock[2] = { NULL, NULL };
+    flux_msg_t *msg, *cpy, *msg2;
+    const char *uri = "inproc://test-payload";
+    const int paylen = 65536;
+    char *pay;
+    const char *topic;
+    const void *buf;
+    char *s;
+    int len;
+    int i;
+
+    if (!(zsock[0] = zsock_new_pair (NULL))
+            || zsock_bind (zsock[0], "%s", uri) < 0
+            || !(zsock[1] = zsock_new_pair (uri)))
+        BAIL_OUT ("could not create inproc socket pair");
+    if (!(pay = malloc (paylen)))
+        BAIL_OUT ("out of memory");
+    for (i = 0; i < paylen; i++)
+        pay[i] = i & 0xff;
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_EVENT))
+            || flux_msg_set_topic (msg, "foo.bar") < 0
+            || flux_msg_set_payload (msg, pay, paylen) < 0)
+        BAIL_OUT ("could not create test message");
+
+    ok ((cpy = flux_msg_copy (msg, true)) != NULL
+        && flux_msg_enable_route (cpy) == 0
+        && flux_msg_push_route (cpy, "child") == 0,
+        "copied message and pushed a route");
+    ok (flux_msg_sendzsock (zsock[1], cpy) == 0,
+        "flux_msg_sendzsock of copy works");
+    ok (flux_msg_sendzsock (zsock[1], msg) == 0,
+        "flux_msg_sendzsock of original works");
+    flux_msg_destroy (cpy);
+    flux_msg_destroy (msg);
+
+    ok ((msg2 = flux_msg_recvzsock (zsock[0])) != NULL,
+        "flux_msg_recvzsock works after sent messages are destroyed");
+    s = NULL;
+    ok (flux_msg_get_route_first (msg2, &s) == 0 && s
+        && !strcmp (s, "child")
+        && flux_msg_get_topic (msg2, &topic) == 0
+        && !strcmp (topic, "foo.bar"),
+        "received copy has expected route and topic");
+    free (s);
+    ok (flux_msg_get_payload (msg2, &buf, &len) == 0
+        && len == paylen && memcmp (buf, pay, len) == 0,
+        "received copy has expected payload");
+    flux_msg_destroy (msg2);
+
+    ok ((msg2 = flux_msg_recvzsock (zsock[0])) != NULL
+        && flux_msg_get_route_count (msg2) < 0
+        && flux_msg_get_payload (msg2, &buf, &len) == 0
+        && len == paylen && memcmp (buf, pay, len) == 0,
+        "received original with expected payload and no routes");
+
+    /* Forward the received message, which now owns the payload frame.
+     */
+    ok (flux_msg_sendzsock (zsock[1], msg2) == 0,
+        "flux_msg_sendzsock of received message works");
+    flux_msg_destroy (msg2);
+    ok ((msg2 = flux_msg_recvzsock (zsock[0])) != NULL
+        && flux_msg_get_payload (msg2, &buf, &len) == 0
+        && len == paylen && memcmp (buf, pay, len) == 0,
+        "forwarded message has expected payload");
+    flux_msg_destroy (msg2);
+
+    free (pay);
+    zsock_destroy (&zsock[0]);
+    zsock_destroy (&zsock[1]);
+}
+
 void *myfree_arg = NULL;
 void myfree (void *arg)
 {
@@ -686,6 +1055,75 @@ void check_copy (void)
     flux_msg_destroy (msg);
 }
 
+void check_copy_payload (void)
+{
+    flux_msg_t *msg, *cpy;
+    const char pay[] = "abcdefghijklmnopqrstuvwxyz";
+    const char pay2[] = "0123456789";
+    const void *buf, *cpybuf;
+    int len, cpylen;
+
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_EVENT))
+            || flux_msg_set_topic (msg, "foo") < 0
+            || flux_msg_set_payload (msg, pay, sizeof (pay)) < 0)
+        BAIL_OUT ("could not create test message");
+    ok ((cpy = flux_msg_copy (msg, true)) != NULL,
+        "flux_msg_copy works");
+    ok (flux_msg_get_payload (msg, &buf, &len) == 0
+        && flux_msg_get_payload (cpy, &cpybuf, &cpylen) == 0
+        && buf == cpybuf && len == cpylen,
+        "copy shares payload with original");
+    ok (flux_msg_set_payload (cpy, pay2, sizeof (pay2)) == 0,
+        "flux_msg_set_payload on copy works");
+    ok (flux_msg_get_payload (msg, &buf, &len) == 0
+        && len == sizeof (pay) && memcmp (buf, pay, len) == 0,
+        "original payload is unchanged");
+    ok (flux_msg_get_payload (cpy, &cpybuf, &cpylen) == 0
+        && cpylen == sizeof (pay2) && memcmp (cpybuf, pay2, cpylen) == 0,
+        "copy has new payload");
+    ok (flux_msg_set_payload (cpy, NULL, 0) == 0
+        && !flux_msg_has_payload (cpy)
+        && flux_msg_has_payload (msg),
+        "removing payload from copy leaves original payload intact");
+    flux_msg_destroy (cpy);
+
+    ok ((cpy = flux_msg_copy (msg, true)) != NULL,
+        "flux_msg_copy works again");
+    flux_msg_destroy (msg);
+    ok (flux_msg_get_payload (cpy, &cpybuf, &cpylen) == 0
+        && cpylen == sizeof (pay) && memcmp (cpybuf, pay, cpylen) == 0,
+        "copy retains payload after original is destroyed");
+    flux_msg_destroy (cpy);
+}
+
+void check_refcount (void)
+{
+    flux_msg_t *msg;
+    const flux_msg_t *p;
+    const char *topic;
+
+    errno = 0;
+    ok (flux_msg_incref (NULL) == NULL && errno == EINVAL,
+        "flux_msg_incref msg=NULL fails with EINVAL");
+    lives_ok ({flux_msg_decref (NULL);},
+        "flux_msg_decref msg=NULL doesn't crash");
+
+    if (!(msg = flux_msg_create (FLUX_MSGTYPE_EVENT))
+            || flux_msg_set_topic (msg, "foo") < 0
+            || flux_msg_aux_set (msg, "test", "data", myfree) < 0)
+        BAIL_OUT ("could not create test message");
+    myfree_arg = NULL;
+    ok ((p = flux_msg_incref (msg)) == msg,
+        "flux_msg_incref returns message");
+    flux_msg_destroy (msg);
+    ok (myfree_arg == NULL
+        && flux_msg_get_topic (p, &topic) == 0 && !strcmp (topic, "foo"),
+        "message survives flux_msg_destroy with extra reference");
+    flux_msg_decref (p);
+    ok (myfree_arg != NULL,
+        "flux_msg_decref of last reference destroyed message");
+}
+
 void check_print (void)
 {
     flux_msg_t *msg;
@@ -760,12 +1198,19 @@ int main (int argc, char *argv[])
     check_security ();
     check_aux ();
     check_copy ();
+    check_copy_payload ();
+    check_refcount ();
 
     check_cmp ();
 
     check_encode ();
+    check_encode_payload ();
+    check_header_grow ();
     check_sendfd ();
+    check_sendfd_batch ();
+    check_reader ();
     check_sendzsock ();
+    check_sendzsock_payload ();
 
     check_params ();
 
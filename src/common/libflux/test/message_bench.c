@@ -0,0 +1,379 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* Compare flux_msg_copy(), which shares the payload, with a deep copy
+ * (as flux_msg_copy() previously made) in the broker's hot paths:
+ * - event fanout: copy, push child route, send, as overlay_mcast_child()
+ * - local routing: copy, push/pop route, send, as module_sendmsg()
+ * Messages are sent and received over an inproc socket pair.
+ *
+ * Then time per-hop header manipulation and wire encode/decode of a
+ * routed request in memory, without a socket.
+ *
+ * Finally, compare sending a burst of responses over a unix domain socket
+ * one message per system call, as flux_msg_sendfd()/flux_msg_recvfd() do,
+ * with flux_msg_sendfd_batch() and a flux_msg_reader.
+ *
+ * Usage: test_message_bench.t [iterations]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <czmq.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libflux/message.h"
+#include "src/common/libutil/monotime.h"
+
+typedef flux_msg_t *(*copy_f)(const flux_msg_t *msg);
+
+static zsock_t *tx;
+static zsock_t *rx;
+
+static flux_msg_t *copy_shared (const flux_msg_t *msg)
+{
+    return flux_msg_copy (msg, true);
+}
+
+static flux_msg_t *copy_deep (const flux_msg_t *msg)
+{
+    flux_msg_t *cpy;
+    const void *buf;
+    int len;
+
+    if (!(cpy = flux_msg_copy (msg, false)))
+        return NULL;
+    if (flux_msg_get_payload (msg, &buf, &len) == 0
+                    && flux_msg_set_payload (cpy, buf, len) < 0) {
+        flux_msg_destroy (cpy);
+        return NULL;
+    }
+    return cpy;
+}
+
+static void report (const char *name, const char *op, int size,
+                    int count, double ms)
+{
+    diag ("%-6s %-7s %8d bytes: %d in %.1fms (%.0f ns/msg)",
+          name, op, size, count, ms, ms * 1E6 / count);
+}
+
+static flux_msg_t *create_msg (int type, int size)
+{
+    flux_msg_t *msg;
+    char *buf;
+
+    if (!(buf = malloc (size)))
+        BAIL_OUT ("out of memory");
+    memset (buf, 'x', size);
+    if (!(msg = flux_msg_create (type))
+            || flux_msg_set_topic (msg, "bench.topic") < 0
+            || flux_msg_set_payload (msg, buf, size) < 0)
+        BAIL_OUT ("could not create test message");
+    free (buf);
+    return msg;
+}
+
+/* Returns 0 if 'msg' has a 'size' byte payload.  Destroys 'msg'.
+ */
+static int recv_check_msg (flux_msg_t *msg, int size)
+{
+    int len = -1;
+
+    (void)flux_msg_get_payload (msg, NULL, &len);
+    flux_msg_destroy (msg);
+    return len == size ? 0 : -1;
+}
+
+/* Returns 0 if a message was received intact with 'size' byte payload.
+ */
+static int recv_check (int size)
+{
+    flux_msg_t *msg;
+
+    if (!(msg = flux_msg_recvzsock (rx)))
+        return -1;
+    return recv_check_msg (msg, size);
+}
+
+static int bench_fanout (const char *name, copy_f copy, int size,
+                         int children, int iter)
+{
+    flux_msg_t *msg = create_msg (FLUX_MSGTYPE_EVENT, size);
+    struct timespec t0;
+    int errors = 0;
+    char uuid[16];
+    int i, j;
+
+    monotime (&t0);
+    for (i = 0; i < iter; i++) {
+        for (j = 0; j < children; j++) {
+            flux_msg_t *cpy;
+            snprintf (uuid, sizeof (uuid), "%d", j);
+            if (!(cpy = copy (msg))
+                    || flux_msg_enable_route (cpy) < 0
+                    || flux_msg_push_route (cpy, uuid) < 0
+                    || flux_msg_sendzsock (tx, cpy) < 0)
+                errors++;
+            flux_msg_destroy (cpy);
+            if (recv_check (size) < 0)
+                errors++;
+        }
+    }
+    report (name, "fanout", size, iter * children, monotime_since (t0));
+    flux_msg_destroy (msg);
+    return errors;
+}
+
+/* Route a request up through 'hops' local hops then back down,
+ * copying and pushing (popping) a route at each, as module_sendmsg() does.
+ */
+static int bench_route (const char *name, copy_f copy, int size,
+                        int hops, int iter)
+{
+    flux_msg_t *msg = create_msg (FLUX_MSGTYPE_REQUEST, size);
+    struct timespec t0;
+    int errors = 0;
+    char uuid[16];
+    int i, j;
+
+    if (flux_msg_enable_route (msg) < 0)
+        BAIL_OUT ("flux_msg_enable_route failed");
+    monotime (&t0);
+    for (i = 0; i < iter; i++) {
+        flux_msg_t *m = (flux_msg_t *)flux_msg_incref (msg);
+        for (j = 0; j < 2 * hops; j++) {
+            flux_msg_t *cpy;
+            int rc;
+            snprintf (uuid, sizeof (uuid), "%d", j);
+            if (!(cpy = copy (m)))
+                BAIL_OUT ("copy failed");
+            if (j < hops)
+                rc = flux_msg_push_route (cpy, uuid);
+            else
+                rc = flux_msg_pop_route (cpy, NULL);
+            if (rc < 0 || flux_msg_sendzsock (tx, cpy) < 0)
+                errors++;
+            flux_msg_destroy (cpy);
+            flux_msg_destroy (m);
+            if (!(m = flux_msg_recvzsock (rx)))
+                BAIL_OUT ("flux_msg_recvzsock failed");
+        }
+        if (flux_msg_get_route_count (m) != 0)
+            errors++;
+        flux_msg_destroy (m);
+    }
+    report (name, "route", size, iter * hops * 2, monotime_since (t0));
+    flux_msg_destroy (msg);
+    return errors;
+}
+
+/* Per hop work on a routed request: copy, push a route, look up the
+ * topic, matchtag and sender, then pop the route as a response would.
+ */
+static int bench_hop (int size, int hops, int count)
+{
+    flux_msg_t *msg = create_msg (FLUX_MSGTYPE_REQUEST, size);
+    struct timespec t0;
+    int errors = 0;
+    char uuid[16];
+    int i;
+
+    if (flux_msg_enable_route (msg) < 0)
+        BAIL_OUT ("flux_msg_enable_route failed");
+    for (i = 0; i < hops - 1; i++) {
+        snprintf (uuid, sizeof (uuid), "%d", i);
+        if (flux_msg_push_route (msg, uuid) < 0)
+            BAIL_OUT ("flux_msg_push_route failed");
+    }
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        flux_msg_t *cpy;
+        const char *topic;
+        uint32_t matchtag;
+        char *sender;
+
+        if (!(cpy = flux_msg_copy (msg, true))
+                || flux_msg_push_route (cpy, "hop") < 0
+                || flux_msg_get_topic (cpy, &topic) < 0
+                || flux_msg_get_matchtag (cpy, &matchtag) < 0
+                || flux_msg_get_route_first (cpy, &sender) < 0
+                || flux_msg_get_route_count (cpy) != hops
+                || flux_msg_pop_route (cpy, NULL) < 0)
+            errors++;
+        else
+            free (sender);
+        flux_msg_destroy (cpy);
+    }
+    report ("hop", "header", size, count, monotime_since (t0));
+    flux_msg_destroy (msg);
+    return errors;
+}
+
+static int bench_codec (int size, int hops, int count)
+{
+    flux_msg_t *msg = create_msg (FLUX_MSGTYPE_REQUEST, size);
+    struct timespec t0;
+    int errors = 0;
+    char uuid[16];
+    size_t len;
+    void *buf;
+    int i;
+
+    if (flux_msg_enable_route (msg) < 0)
+        BAIL_OUT ("flux_msg_enable_route failed");
+    for (i = 0; i < hops; i++) {
+        snprintf (uuid, sizeof (uuid), "%d", i);
+        if (flux_msg_push_route (msg, uuid) < 0)
+            BAIL_OUT ("flux_msg_push_route failed");
+    }
+    len = flux_msg_encode_size (msg);
+    if (!(buf = malloc (len)))
+        BAIL_OUT ("out of memory");
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        flux_msg_t *msg2;
+
+        if (flux_msg_encode (msg, buf, len) < 0
+                || !(msg2 = flux_msg_decode (buf, len)))
+            errors++;
+        else {
+            if (flux_msg_get_route_count (msg2) != hops)
+                errors++;
+            flux_msg_destroy (msg2);
+        }
+    }
+    report ("codec", "roundtrip", size, count, monotime_since (t0));
+    free (buf);
+    flux_msg_destroy (msg);
+    return errors;
+}
+
+/* Send 'burst' messages from sv[1] to sv[0], alternating between
+ * sending as much as the socket accepts and receiving what has arrived.
+ */
+static int bench_stream (const char *name, bool batch, int size,
+                         int burst, int iter)
+{
+    flux_msg_t *msg = create_msg (FLUX_MSGTYPE_RESPONSE, size);
+    const flux_msg_t *msgs[burst];
+    struct flux_msg_iobuf outbuf, inbuf;
+    struct flux_msg_reader *r;
+    struct timespec t0;
+    int errors = 0;
+    int sv[2];
+    int i, n;
+
+    if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, sv) < 0)
+        BAIL_OUT ("socketpair failed");
+    if (!(r = flux_msg_reader_create ()))
+        BAIL_OUT ("flux_msg_reader_create failed");
+    for (i = 0; i < burst; i++)
+        msgs[i] = msg;
+    flux_msg_iobuf_init (&outbuf);
+    flux_msg_iobuf_init (&inbuf);
+    monotime (&t0);
+    for (i = 0; i < iter; i++) {
+        int sent = 0, received = 0;
+        while (received < burst) {
+            flux_msg_t *msg2;
+            if (batch) {
+                if ((n = flux_msg_sendfd_batch (sv[1], &msgs[sent],
+                                                burst - sent, &outbuf)) < 0)
+                    BAIL_OUT ("flux_msg_sendfd_batch failed");
+                sent += n;
+            }
+            else {
+                while (sent < burst
+                        && flux_msg_sendfd (sv[1], msg, &outbuf) == 0)
+                    sent++;
+            }
+            while ((msg2 = batch ? flux_msg_reader_recv (r, sv[0])
+                                 : flux_msg_recvfd (sv[0], &inbuf))) {
+                if (recv_check_msg (msg2, size) < 0)
+                    errors++;
+                received++;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                BAIL_OUT ("receive failed");
+        }
+    }
+    report (name, "stream", size, iter * burst, monotime_since (t0));
+    flux_msg_iobuf_clean (&outbuf);
+    flux_msg_iobuf_clean (&inbuf);
+    flux_msg_reader_destroy (r);
+    close (sv[0]);
+    close (sv[1]);
+    flux_msg_destroy (msg);
+    return errors;
+}
+
+int main (int argc, char *argv[])
+{
+    int iter = 20;
+    int sizes[] = { 64, 4096, 1048576 };
+    int children = 64;
+    int hops = 4;
+    int burst = 1000;
+    int i;
+
+    plan (NO_PLAN);
+
+    if (argc > 1)
+        iter = strtoul (argv[1], NULL, 10);
+    if (iter <= 0)
+        BAIL_OUT ("invalid iterations");
+    if (!(rx = zsock_new_pair (NULL))
+            || zsock_bind (rx, "inproc://bench") < 0
+            || !(tx = zsock_new_pair ("inproc://bench")))
+        BAIL_OUT ("could not create inproc socket pair");
+
+    for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++) {
+        ok (bench_fanout ("deep", copy_deep, sizes[i], children, iter) == 0,
+            "deep copy: %d byte event fanned out to %d children",
+            sizes[i], children);
+        ok (bench_fanout ("shared", copy_shared, sizes[i], children, iter) == 0,
+            "shared copy: %d byte event fanned out to %d children",
+            sizes[i], children);
+    }
+    for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++) {
+        ok (bench_route ("deep", copy_deep, sizes[i], hops, iter) == 0,
+            "deep copy: %d byte request routed over %d hops and back",
+            sizes[i], hops);
+        ok (bench_route ("shared", copy_shared, sizes[i], hops, iter) == 0,
+            "shared copy: %d byte request routed over %d hops and back",
+            sizes[i], hops);
+    }
+
+    ok (bench_hop (64, hops, iter * 10000) == 0,
+        "per hop header manipulation of request with %d routes", hops);
+    ok (bench_codec (64, hops, iter * 10000) == 0,
+        "encode/decode of request with %d routes", hops);
+
+    for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]) - 1; i++) {
+        ok (bench_stream ("single", false, sizes[i], burst, iter * 10) == 0,
+            "one per syscall: burst of %d %d byte responses over socket",
+            burst, sizes[i]);
+        ok (bench_stream ("batch", true, sizes[i], burst, iter * 10) == 0,
+            "batched: burst of %d %d byte responses over socket",
+            burst, sizes[i]);
+    }
+
+    zsock_destroy (&tx);
+    zsock_destroy (&rx);
+    done_testing ();
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
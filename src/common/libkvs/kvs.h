@@ -37,7 +37,9 @@ enum kvs_op {
     FLUX_KVS_TREEOBJ = 16,
     FLUX_KVS_APPEND = 32,
     FLUX_KVS_WATCH_FULL = 64,
-    FLUX_KVS_WATCH_UNIQ = 128
+    FLUX_KVS_WATCH_UNIQ = 128,
+    FLUX_KVS_READDIR_RECURSIVE = 256,
+    FLUX_KVS_WATCH_APPEND = 512
 };
 
 typedef struct flux_kvs_namespace_itr flux_kvs_namespace_itr_t;
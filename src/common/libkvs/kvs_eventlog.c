@@ -133,6 +133,27 @@ static bool event_validate (const char *tok, size_t toklen)
     return true;
 }
 
+/* Validate event 'tok' and append a copy of it to 'eventlog'.
+ */
+static int eventlog_append_tok (struct flux_kvs_eventlog *eventlog,
+                                const char *tok, size_t toklen)
+{
+    char *cpy;
+
+    if (!event_validate (tok, toklen)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(cpy = strndup (tok, toklen)))
+        return -1;
+    if (zlist_append (eventlog->events, cpy) < 0) {
+        free (cpy);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
 int flux_kvs_eventlog_update (struct flux_kvs_eventlog *eventlog,
                               const char *s)
 {
@@ -152,16 +173,8 @@ int flux_kvs_eventlog_update (struct flux_kvs_eventlog *eventlog,
             event = zlist_next (eventlog->events);
         }
         else {
-            char *cpy;
-            if (!event_validate (tok, toklen))
-                goto error_inval;
-            if (!(cpy = strndup (tok, toklen)))
+            if (eventlog_append_tok (eventlog, tok, toklen) < 0)
                 goto error;
-            if (zlist_append (eventlog->events, cpy) < 0) {
-                free (cpy);
-                errno = ENOMEM;
-                goto error;
-            }
         }
     }
     if (*input != '\0')
@@ -173,6 +186,29 @@ error:
     return -1;
 }
 
+int flux_kvs_eventlog_update_append (struct flux_kvs_eventlog *eventlog,
+                                     const char *s)
+{
+    const char *input;
+    const char *tok;
+    size_t toklen;
+
+    if (!eventlog || !s) {
+        errno = EINVAL;
+        return -1;
+    }
+    input = s;
+    while (eventlog_parse_next (&input, &tok, &toklen)) {
+        if (eventlog_append_tok (eventlog, tok, toklen) < 0)
+            return -1;
+    }
+    if (*input != '\0') {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
 struct flux_kvs_eventlog *flux_kvs_eventlog_decode (const char *s)
 {
     struct flux_kvs_eventlog *eventlog;
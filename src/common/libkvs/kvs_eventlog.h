@@ -40,6 +40,12 @@ struct flux_kvs_eventlog *flux_kvs_eventlog_decode (const char *s);
 int flux_kvs_eventlog_update (struct flux_kvs_eventlog *eventlog,
                               const char *s);
 
+/* Update an eventlog with encoded events 's' that were appended since
+ * the last update, as returned by a FLUX_KVS_WATCH_APPEND lookup.
+ */
+int flux_kvs_eventlog_update_append (struct flux_kvs_eventlog *eventlog,
+                                     const char *s);
+
 /* Append an encoded event to eventlog.
  */
 int flux_kvs_eventlog_append (struct flux_kvs_eventlog *eventlog,
@@ -14,6 +14,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <jansson.h>
 #include <czmq.h>
 #include <flux/core.h>
@@ -27,6 +28,7 @@ struct lookup_ctx {
     char *key;
     char *atref;
     int flags;
+    char *dirkey;      // key of current FLUX_KVS_READDIR_RECURSIVE response
 
     json_t *treeobj;
     char *treeobj_str; // json_dumps of tree object returned from lookup
@@ -40,13 +42,15 @@ struct lookup_ctx {
 static const char *auxkey = "flux::lookup_ctx";
 
 #define FLUX_KVS_WATCH_FLAGS (FLUX_KVS_WATCH_FULL \
-                              | FLUX_KVS_WATCH_UNIQ)
+                              | FLUX_KVS_WATCH_UNIQ \
+                              | FLUX_KVS_WATCH_APPEND)
 
 static void free_ctx (struct lookup_ctx *ctx)
 {
     if (ctx) {
         free (ctx->key);
         free (ctx->atref);
+        free (ctx->dirkey);
         json_decref (ctx->treeobj);
         free (ctx->treeobj_str);
         free (ctx->val_data);
@@ -86,10 +90,28 @@ static int validate_lookup_flags (int flags, bool watch_ok)
      */
     if ((flags & FLUX_KVS_WAITCREATE) && !watch_ok)
         return -1;
+    /* FLUX_KVS_WATCH_APPEND responses carry only appended data, so
+     * they can't be compared with previous values, and only apply to
+     * values.
+     */
+    if ((flags & FLUX_KVS_WATCH_APPEND)
+        && (flags & (FLUX_KVS_WATCH_FULL
+                     | FLUX_KVS_WATCH_UNIQ
+                     | FLUX_KVS_READDIR
+                     | FLUX_KVS_READLINK
+                     | FLUX_KVS_TREEOBJ)))
+        return -1;
 
     flags &= ~FLUX_KVS_WATCH;
     flags &= ~(FLUX_KVS_WATCH_FLAGS);
 
+    /* FLUX_KVS_READDIR_RECURSIVE responses are streamed by the kvs
+     * module, and cannot be combined with kvs-watch flags.
+     */
+    if ((flags & FLUX_KVS_READDIR_RECURSIVE)
+        && (flags & (FLUX_KVS_WATCH | FLUX_KVS_WAITCREATE)))
+        return -1;
+
     flags &= ~FLUX_KVS_WAITCREATE;
 
     switch (flags) {
@@ -97,6 +119,8 @@ static int validate_lookup_flags (int flags, bool watch_ok)
         case FLUX_KVS_TREEOBJ:
         case FLUX_KVS_READDIR:
         case FLUX_KVS_READDIR | FLUX_KVS_TREEOBJ:
+        case FLUX_KVS_READDIR | FLUX_KVS_READDIR_RECURSIVE:
+        case FLUX_KVS_READDIR | FLUX_KVS_READDIR_RECURSIVE | FLUX_KVS_TREEOBJ:
         case FLUX_KVS_READLINK:
             return 0;
         default:
@@ -193,6 +217,58 @@ flux_future_t *flux_kvs_lookupat (flux_t *h, int flags, const char *key,
     return f;
 }
 
+flux_future_t *flux_kvs_lookup_subtree (flux_t *h, int flags, const char *key,
+                                        int maxdepth, const char *pattern)
+{
+    struct lookup_ctx *ctx;
+    flux_future_t *f;
+    const char *namespace;
+    json_t *o = NULL;
+
+    flags |= FLUX_KVS_READDIR | FLUX_KVS_READDIR_RECURSIVE;
+    if (!h || !key || strlen (key) == 0
+        || validate_lookup_flags (flags, false) < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(namespace = flux_kvs_get_namespace (h)))
+        return NULL;
+    if (!(o = json_pack ("{s:s s:s s:i s:i}",
+                         "key", key,
+                         "namespace", namespace,
+                         "flags", flags,
+                         "maxdepth", maxdepth < 0 ? -1 : maxdepth)))
+        goto nomem;
+    if (pattern) {
+        json_t *p = json_string (pattern);
+        if (!p || json_object_set_new (o, "pattern", p) < 0) {
+            json_decref (p);
+            goto nomem;
+        }
+    }
+    if (!(ctx = alloc_ctx (h, flags, key))) {
+        json_decref (o);
+        return NULL;
+    }
+    if (!(f = flux_rpc_pack (h, "kvs.lookup", FLUX_NODEID_ANY, 0, "O", o))) {
+        free_ctx (ctx);
+        json_decref (o);
+        return NULL;
+    }
+    if (flux_future_aux_set (f, auxkey, ctx, (flux_free_f)free_ctx) < 0) {
+        free_ctx (ctx);
+        flux_future_destroy (f);
+        json_decref (o);
+        return NULL;
+    }
+    json_decref (o);
+    return f;
+nomem:
+    json_decref (o);
+    errno = ENOMEM;
+    return NULL;
+}
+
 static int decode_treeobj (flux_future_t *f, json_t **treeobj)
 {
     json_t *obj;
@@ -223,12 +299,8 @@ static struct lookup_ctx *get_lookup_ctx (flux_future_t *f)
  * changed (e.g. future has been reset and another response has arrived),
  * invalidate the cached results.
  */
-static int parse_response (flux_future_t *f, struct lookup_ctx *ctx)
+static void ctx_set_treeobj (struct lookup_ctx *ctx, json_t *treeobj2)
 {
-    json_t *treeobj2;
-
-    if (decode_treeobj (f, &treeobj2) < 0)
-        return -1;
     if (!ctx->treeobj || !json_equal (ctx->treeobj, treeobj2)) {
         json_decref (ctx->treeobj);
         ctx->treeobj = json_incref (treeobj2);
@@ -250,17 +322,53 @@ static int parse_response (flux_future_t *f, struct lookup_ctx *ctx)
             ctx->dir = NULL;
         }
     }
+}
+
+/* A FLUX_KVS_READDIR_RECURSIVE response also names the directory it
+ * holds.  Two directories may have identical content, so a change of
+ * key alone invalidates the cached kvsdir.
+ */
+static int parse_dirkey (flux_future_t *f, struct lookup_ctx *ctx)
+{
+    const char *key;
+    char *cpy;
+
+    if (flux_rpc_get_unpack (f, "{s:s}", "key", &key) < 0)
+        return -1;
+    if (!ctx->dirkey || strcmp (ctx->dirkey, key) != 0) {
+        if (!(cpy = strdup (key))) {
+            errno = ENOMEM;
+            return -1;
+        }
+        free (ctx->dirkey);
+        ctx->dirkey = cpy;
+        if (ctx->dir) {
+            flux_kvsdir_destroy (ctx->dir);
+            ctx->dir = NULL;
+        }
+    }
     return 0;
 }
 
-int flux_kvs_lookup_get (flux_future_t *f, const char **value)
+static int parse_response (flux_future_t *f, struct lookup_ctx *ctx)
 {
-    struct lookup_ctx *ctx;
+    json_t *treeobj2;
 
-    if (!(ctx = get_lookup_ctx (f)))
+    if (decode_treeobj (f, &treeobj2) < 0)
         return -1;
-    if (parse_response (f, ctx) < 0)
+    if ((ctx->flags & FLUX_KVS_READDIR_RECURSIVE)
+        && parse_dirkey (f, ctx) < 0)
         return -1;
+    ctx_set_treeobj (ctx, treeobj2);
+    return 0;
+}
+
+/* The ctx_get_* functions interpret the treeobj in 'ctx', caching
+ * decoded results in 'ctx'.  They are shared by the single and multi
+ * key lookup accessors.
+ */
+static int ctx_decode_val (struct lookup_ctx *ctx)
+{
     if (!ctx->val_valid) {
         if (treeobj_decode_val (ctx->treeobj, &ctx->val_data,
                                               &ctx->val_len) < 0)
@@ -268,44 +376,34 @@ int flux_kvs_lookup_get (flux_future_t *f, const char **value)
         ctx->val_valid = true;
         // N.B. val_data includes xtra 0 byte term not reflected in val_len
     }
+    return 0;
+}
+
+static int ctx_get (struct lookup_ctx *ctx, const char **value)
+{
+    if (ctx_decode_val (ctx) < 0)
+        return -1;
     if (value)
         *value = ctx->val_data;
     return 0;
 }
 
-int flux_kvs_lookup_get_treeobj (flux_future_t *f, const char **treeobj)
+static int ctx_get_treeobj (struct lookup_ctx *ctx, const char **treeobj)
 {
-    struct lookup_ctx *ctx;
-
-    if (!(ctx = get_lookup_ctx (f)))
-        return -1;
-    if (parse_response (f, ctx) < 0)
-        return -1;
     if (!ctx->treeobj_str) {
         if (!(ctx->treeobj_str = treeobj_encode (ctx->treeobj)))
             return -1;
     }
     if (treeobj)
-        *treeobj= ctx->treeobj_str;
+        *treeobj = ctx->treeobj_str;
     return 0;
 }
 
-int flux_kvs_lookup_get_unpack (flux_future_t *f, const char *fmt, ...)
+static int ctx_vget_unpack (struct lookup_ctx *ctx, const char *fmt,
+                            va_list ap)
 {
-    struct lookup_ctx *ctx;
-    va_list ap;
-    int rc;
-
-    if (!(ctx = get_lookup_ctx (f)))
+    if (ctx_decode_val (ctx) < 0)
         return -1;
-    if (parse_response (f, ctx) < 0)
-        return -1;
-    if (!ctx->val_valid) {
-        if (treeobj_decode_val (ctx->treeobj, &ctx->val_data,
-                                              &ctx->val_len) < 0)
-            return -1;
-        ctx->val_valid = true;
-    }
     if (!ctx->val_obj) {
         if (!(ctx->val_obj = json_loadb (ctx->val_data, ctx->val_len,
                                          JSON_DECODE_ANY, NULL))) {
@@ -313,28 +411,17 @@ int flux_kvs_lookup_get_unpack (flux_future_t *f, const char *fmt, ...)
             return -1;
         }
     }
-    va_start (ap, fmt);
-    if ((rc = json_vunpack_ex (ctx->val_obj, NULL, 0, fmt, ap) < 0))
+    if (json_vunpack_ex (ctx->val_obj, NULL, 0, fmt, ap) < 0) {
         errno = EINVAL;
-    va_end (ap);
-
-    return rc;
+        return -1;
+    }
+    return 0;
 }
 
-int flux_kvs_lookup_get_raw (flux_future_t *f, const void **data, int *len)
+static int ctx_get_raw (struct lookup_ctx *ctx, const void **data, int *len)
 {
-    struct lookup_ctx *ctx;
-
-    if (!(ctx = get_lookup_ctx (f)))
-        return -1;
-    if (parse_response (f, ctx) < 0)
+    if (ctx_decode_val (ctx) < 0)
         return -1;
-    if (!ctx->val_valid) {
-        if (treeobj_decode_val (ctx->treeobj, &ctx->val_data,
-                                              &ctx->val_len) < 0)
-            return -1;
-        ctx->val_valid = true;
-    }
     if (data)
         *data = ctx->val_data;
     if (len)
@@ -342,17 +429,13 @@ int flux_kvs_lookup_get_raw (flux_future_t *f, const void **data, int *len)
     return 0;
 }
 
-int flux_kvs_lookup_get_dir (flux_future_t *f, const flux_kvsdir_t **dirp)
+static int ctx_get_dir (struct lookup_ctx *ctx, const flux_kvsdir_t **dirp)
 {
-    struct lookup_ctx *ctx;
-
-    if (!(ctx = get_lookup_ctx (f)))
-        return -1;
-    if (parse_response (f, ctx) < 0)
-        return -1;
     if (!ctx->dir) {
         if (!(ctx->dir = kvsdir_create_fromobj (ctx->h, ctx->atref,
-                                                ctx->key, ctx->treeobj)))
+                                                ctx->dirkey ? ctx->dirkey
+                                                            : ctx->key,
+                                                ctx->treeobj)))
             return -1;
     }
     if (dirp)
@@ -360,16 +443,11 @@ int flux_kvs_lookup_get_dir (flux_future_t *f, const flux_kvsdir_t **dirp)
     return 0;
 }
 
-int flux_kvs_lookup_get_symlink (flux_future_t *f, const char **target)
+static int ctx_get_symlink (struct lookup_ctx *ctx, const char **target)
 {
-    struct lookup_ctx *ctx;
     json_t *str;
     const char *s;
 
-    if (!(ctx = get_lookup_ctx (f)))
-        return -1;
-    if (parse_response (f, ctx) < 0)
-        return -1;
     if (!treeobj_is_symlink (ctx->treeobj)) {
         errno = EINVAL;
         return -1;
@@ -384,12 +462,89 @@ int flux_kvs_lookup_get_symlink (flux_future_t *f, const char **target)
     return 0;
 }
 
+int flux_kvs_lookup_get (flux_future_t *f, const char **value)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_lookup_ctx (f)))
+        return -1;
+    if (parse_response (f, ctx) < 0)
+        return -1;
+    return ctx_get (ctx, value);
+}
+
+int flux_kvs_lookup_get_treeobj (flux_future_t *f, const char **treeobj)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_lookup_ctx (f)))
+        return -1;
+    if (parse_response (f, ctx) < 0)
+        return -1;
+    return ctx_get_treeobj (ctx, treeobj);
+}
+
+int flux_kvs_lookup_get_unpack (flux_future_t *f, const char *fmt, ...)
+{
+    struct lookup_ctx *ctx;
+    va_list ap;
+    int rc;
+
+    if (!(ctx = get_lookup_ctx (f)))
+        return -1;
+    if (parse_response (f, ctx) < 0)
+        return -1;
+    va_start (ap, fmt);
+    rc = ctx_vget_unpack (ctx, fmt, ap);
+    va_end (ap);
+
+    return rc;
+}
+
+int flux_kvs_lookup_get_raw (flux_future_t *f, const void **data, int *len)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_lookup_ctx (f)))
+        return -1;
+    if (parse_response (f, ctx) < 0)
+        return -1;
+    return ctx_get_raw (ctx, data, len);
+}
+
+int flux_kvs_lookup_get_dir (flux_future_t *f, const flux_kvsdir_t **dirp)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_lookup_ctx (f)))
+        return -1;
+    if (parse_response (f, ctx) < 0)
+        return -1;
+    return ctx_get_dir (ctx, dirp);
+}
+
+int flux_kvs_lookup_get_symlink (flux_future_t *f, const char **target)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_lookup_ctx (f)))
+        return -1;
+    if (parse_response (f, ctx) < 0)
+        return -1;
+    return ctx_get_symlink (ctx, target);
+}
+
 const char *flux_kvs_lookup_get_key (flux_future_t *f)
 {
     struct lookup_ctx *ctx;
 
     if (!(ctx = get_lookup_ctx (f)))
         return NULL;
+    if ((ctx->flags & FLUX_KVS_READDIR_RECURSIVE)) {
+        if (parse_response (f, ctx) < 0)
+            return NULL;
+        return ctx->dirkey;
+    }
     return ctx->key;
 }
 
@@ -420,6 +575,230 @@ int flux_kvs_lookup_cancel (flux_future_t *f)
     return 0;
 }
 
+/* Multi-key lookup.  Each key has its own lookup_ctx for caching
+ * decoded results, and the response carries one result per key.
+ */
+
+struct lookup_multi_ctx {
+    int count;
+    struct lookup_ctx **ctx;
+};
+
+static const char *multi_auxkey = "flux::lookup_multi_ctx";
+
+static void free_multi_ctx (struct lookup_multi_ctx *mctx)
+{
+    if (mctx) {
+        int i;
+        if (mctx->ctx) {
+            for (i = 0; i < mctx->count; i++)
+                free_ctx (mctx->ctx[i]);
+            free (mctx->ctx);
+        }
+        free (mctx);
+    }
+}
+
+static struct lookup_multi_ctx *alloc_multi_ctx (flux_t *h, int flags,
+                                                 const char **keys,
+                                                 int count)
+{
+    struct lookup_multi_ctx *mctx;
+    int i;
+
+    if (!(mctx = calloc (1, sizeof (*mctx)))
+        || !(mctx->ctx = calloc (count, sizeof (mctx->ctx[0])))) {
+        free (mctx);
+        errno = ENOMEM;
+        return NULL;
+    }
+    mctx->count = count;
+    for (i = 0; i < count; i++) {
+        if (!(mctx->ctx[i] = alloc_ctx (h, flags, keys[i]))) {
+            free_multi_ctx (mctx);
+            return NULL;
+        }
+    }
+    return mctx;
+}
+
+flux_future_t *flux_kvs_lookup_multi (flux_t *h, int flags,
+                                      const char **keys, int count)
+{
+    struct lookup_multi_ctx *mctx;
+    flux_future_t *f;
+    const char *namespace;
+    json_t *array = NULL;
+    int i;
+
+    /* N.B. FLUX_KVS_WATCH is not valid for multi-key lookups.
+     */
+    if (!h || !keys || count <= 0
+        || validate_lookup_flags (flags, false) < 0
+        || (flags & FLUX_KVS_READDIR_RECURSIVE)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(array = json_array ()))
+        goto nomem;
+    for (i = 0; i < count; i++) {
+        json_t *o;
+        if (!keys[i] || strlen (keys[i]) == 0) {
+            json_decref (array);
+            errno = EINVAL;
+            return NULL;
+        }
+        if (!(o = json_string (keys[i]))
+            || json_array_append_new (array, o) < 0) {
+            json_decref (o);
+            goto nomem;
+        }
+    }
+    if (!(namespace = flux_kvs_get_namespace (h))) {
+        json_decref (array);
+        return NULL;
+    }
+    if (!(mctx = alloc_multi_ctx (h, flags, keys, count))) {
+        json_decref (array);
+        return NULL;
+    }
+    if (!(f = flux_rpc_pack (h, "kvs.lookup-multi", FLUX_NODEID_ANY, 0,
+                             "{s:O s:s s:i}",
+                             "keys", array,
+                             "namespace", namespace,
+                             "flags", flags))) {
+        free_multi_ctx (mctx);
+        json_decref (array);
+        return NULL;
+    }
+    json_decref (array);
+    if (flux_future_aux_set (f, multi_auxkey, mctx,
+                             (flux_free_f)free_multi_ctx) < 0) {
+        free_multi_ctx (mctx);
+        flux_future_destroy (f);
+        return NULL;
+    }
+    return f;
+nomem:
+    json_decref (array);
+    errno = ENOMEM;
+    return NULL;
+}
+
+/* Parse the result for key 'index' from the multi-key lookup response.
+ * If the lookup of that key failed, fail with its errno.
+ */
+static struct lookup_ctx *get_multi_lookup_ctx (flux_future_t *f, int index)
+{
+    struct lookup_multi_ctx *mctx;
+    json_t *vals, *entry, *treeobj;
+    int errnum;
+
+    if (!(mctx = flux_future_aux_get (f, multi_auxkey))
+        || index < 0
+        || index >= mctx->count) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (flux_rpc_get_unpack (f, "{s:o}", "vals", &vals) < 0)
+        return NULL;
+    if (!json_is_array (vals)
+        || json_array_size (vals) != mctx->count
+        || !(entry = json_array_get (vals, index))) {
+        errno = EPROTO;
+        return NULL;
+    }
+    if (json_unpack (entry, "{s:i}", "errno", &errnum) == 0) {
+        errno = errnum;
+        return NULL;
+    }
+    if (json_unpack (entry, "{s:o}", "val", &treeobj) < 0
+        || treeobj_validate (treeobj) < 0) {
+        errno = EPROTO;
+        return NULL;
+    }
+    ctx_set_treeobj (mctx->ctx[index], treeobj);
+    return mctx->ctx[index];
+}
+
+int flux_kvs_lookup_multi_get (flux_future_t *f, int index,
+                               const char **value)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_multi_lookup_ctx (f, index)))
+        return -1;
+    return ctx_get (ctx, value);
+}
+
+int flux_kvs_lookup_multi_get_unpack (flux_future_t *f, int index,
+                                      const char *fmt, ...)
+{
+    struct lookup_ctx *ctx;
+    va_list ap;
+    int rc;
+
+    if (!(ctx = get_multi_lookup_ctx (f, index)))
+        return -1;
+    va_start (ap, fmt);
+    rc = ctx_vget_unpack (ctx, fmt, ap);
+    va_end (ap);
+    return rc;
+}
+
+int flux_kvs_lookup_multi_get_raw (flux_future_t *f, int index,
+                                   const void **data, int *len)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_multi_lookup_ctx (f, index)))
+        return -1;
+    return ctx_get_raw (ctx, data, len);
+}
+
+int flux_kvs_lookup_multi_get_treeobj (flux_future_t *f, int index,
+                                       const char **treeobj)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_multi_lookup_ctx (f, index)))
+        return -1;
+    return ctx_get_treeobj (ctx, treeobj);
+}
+
+int flux_kvs_lookup_multi_get_dir (flux_future_t *f, int index,
+                                   const flux_kvsdir_t **dir)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_multi_lookup_ctx (f, index)))
+        return -1;
+    return ctx_get_dir (ctx, dir);
+}
+
+int flux_kvs_lookup_multi_get_symlink (flux_future_t *f, int index,
+                                       const char **target)
+{
+    struct lookup_ctx *ctx;
+
+    if (!(ctx = get_multi_lookup_ctx (f, index)))
+        return -1;
+    return ctx_get_symlink (ctx, target);
+}
+
+const char *flux_kvs_lookup_multi_get_key (flux_future_t *f, int index)
+{
+    struct lookup_multi_ctx *mctx;
+
+    if (!(mctx = flux_future_aux_get (f, multi_auxkey))
+        || index < 0
+        || index >= mctx->count) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return mctx->ctx[index]->key;
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
@@ -19,6 +19,20 @@ flux_future_t *flux_kvs_lookup (flux_t *h, int flags, const char *key);
 flux_future_t *flux_kvs_lookupat (flux_t *h, int flags, const char *key,
                                   const char *treeobj);
 
+/* Fetch the subtree rooted at directory 'key' in one request.  The
+ * future is fulfilled once per directory, starting with 'key', down to
+ * 'maxdepth' levels below 'key' (< 0 for unlimited).  A directory
+ * always arrives before its subdirectories.  Each directory holds its
+ * subdirectories as references, and its other entries with values
+ * resolved (unless FLUX_KVS_TREEOBJ is set).  If 'pattern' is non-NULL, non-directory
+ * entries whose names do not match the fnmatch(3) glob are omitted.
+ * Use flux_kvs_lookup_get_dir() and flux_kvs_lookup_get_key() to access
+ * each response, and flux_future_reset() to advance to the next one.
+ * The stream ends with an ENODATA error.
+ */
+flux_future_t *flux_kvs_lookup_subtree (flux_t *h, int flags, const char *key,
+                                        int maxdepth, const char *pattern);
+
 int flux_kvs_lookup_get (flux_future_t *f, const char **value);
 int flux_kvs_lookup_get_unpack (flux_future_t *f, const char *fmt, ...);
 int flux_kvs_lookup_get_raw (flux_future_t *f, const void **data, int *len);
@@ -28,6 +42,30 @@ int flux_kvs_lookup_get_symlink (flux_future_t *f, const char **target);
 
 const char *flux_kvs_lookup_get_key (flux_future_t *f);
 
+/* Look up 'count' keys in one request.  All keys are resolved against
+ * the same root snapshot.  Results are accessed by the index of the key
+ * in 'keys'.  An accessor fails with the errno of its key's lookup,
+ * e.g. ENOENT, without affecting other keys.  FLUX_KVS_WATCH and
+ * FLUX_KVS_WAITCREATE are not supported.
+ */
+flux_future_t *flux_kvs_lookup_multi (flux_t *h, int flags,
+                                      const char **keys, int count);
+
+int flux_kvs_lookup_multi_get (flux_future_t *f, int index,
+                               const char **value);
+int flux_kvs_lookup_multi_get_unpack (flux_future_t *f, int index,
+                                      const char *fmt, ...);
+int flux_kvs_lookup_multi_get_raw (flux_future_t *f, int index,
+                                   const void **data, int *len);
+int flux_kvs_lookup_multi_get_treeobj (flux_future_t *f, int index,
+                                       const char **treeobj);
+int flux_kvs_lookup_multi_get_dir (flux_future_t *f, int index,
+                                   const flux_kvsdir_t **dir);
+int flux_kvs_lookup_multi_get_symlink (flux_future_t *f, int index,
+                                       const char **target);
+
+const char *flux_kvs_lookup_multi_get_key (flux_future_t *f, int index);
+
 /* Cancel a FLUX_KVS_WATCH "stream".
  * Once the cancel request is processed, an ENODATA error response is sent,
  * thus the user should continue to reset and consume responses until an
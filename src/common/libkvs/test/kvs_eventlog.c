@@ -108,6 +108,7 @@ void basic (void)
     const char *test1 = "42.123 foo\n44.0 bar quick brown fox\n";
     const char *test2 = "42.123 foo\n44.0 bar quick brown fox\n50 meep\n";
     const char *test3 = "999.2 duh baz\n";
+    const char *test4 = "1000 a\n1001 b\n";
     struct flux_kvs_eventlog *log;
     char *s;
 
@@ -146,6 +147,18 @@ void basic (void)
     basic_check (log, false, false, 999.2, "duh", "baz");
     basic_check (log, false, true, 0, NULL, NULL);
 
+    /* update with appended events and iterate */
+    ok (flux_kvs_eventlog_update_append (log, test4) == 0,
+        "flux_kvs_eventlog_update_append works adding 2 entries");
+
+    basic_check (log, false, false, 1000, "a", "");
+    basic_check (log, false, false, 1001, "b", "");
+    basic_check (log, false, true, 0, NULL, NULL);
+
+    ok (flux_kvs_eventlog_update_append (log, "") == 0,
+        "flux_kvs_eventlog_update_append s=\"\" works");
+    basic_check (log, false, true, 0, NULL, NULL);
+
     flux_kvs_eventlog_destroy (log);
 }
 
@@ -188,6 +201,14 @@ void bad_input (void)
     errno = 0;
     ok (flux_kvs_eventlog_append (log, NULL) < 0 && errno == EINVAL,
         "flux_kvs_eventlog_append event=NULL fails with EINVAL");
+    errno = 0;
+    ok (flux_kvs_eventlog_update_append (NULL, "0 foo\n") < 0
+        && errno == EINVAL,
+        "flux_kvs_eventlog_update_append log=NULL fails with EINVAL");
+    errno = 0;
+    ok (flux_kvs_eventlog_update_append (log, "1 foo") < 0
+        && errno == EINVAL,
+        "flux_kvs_eventlog_update_append fails on unterminated event");
 
     /* first/next */
     ok (flux_kvs_eventlog_first (NULL) == NULL,
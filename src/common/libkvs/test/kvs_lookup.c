@@ -33,6 +33,27 @@ void errors (void)
     ok (flux_kvs_lookupat (NULL, 0, NULL, NULL) == NULL && errno == EINVAL,
         "flux_kvs_lookupat fails on bad input");
 
+    errno = 0;
+    ok (flux_kvs_lookup_subtree (NULL, 0, NULL, -1, NULL) == NULL
+        && errno == EINVAL,
+        "flux_kvs_lookup_subtree fails on bad input");
+
+    errno = 0;
+    ok (flux_kvs_lookup_subtree (NULL, FLUX_KVS_WATCH, "a", -1, NULL) == NULL
+        && errno == EINVAL,
+        "flux_kvs_lookup_subtree fails with FLUX_KVS_WATCH");
+
+    errno = 0;
+    ok (flux_kvs_lookup (NULL, FLUX_KVS_WATCH_APPEND, "a") == NULL
+        && errno == EINVAL,
+        "flux_kvs_lookup fails with FLUX_KVS_WATCH_APPEND w/o FLUX_KVS_WATCH");
+
+    errno = 0;
+    ok (flux_kvs_lookup (NULL, FLUX_KVS_WATCH | FLUX_KVS_WATCH_APPEND
+                               | FLUX_KVS_WATCH_FULL, "a") == NULL
+        && errno == EINVAL,
+        "flux_kvs_lookup fails with FLUX_KVS_WATCH_APPEND and WATCH_FULL");
+
     errno = 0;
     ok (flux_kvs_lookup_get (NULL, NULL) < 0 && errno == EINVAL,
         "flux_kvs_lookup_get fails on bad input");
@@ -67,12 +88,58 @@ void errors (void)
     flux_future_destroy (f);
 }
 
+void multi_errors (void)
+{
+    flux_future_t *f;
+    const char *keys[] = { "a", "" };
+
+    errno = 0;
+    ok (flux_kvs_lookup_multi (NULL, 0, NULL, 0) == NULL && errno == EINVAL,
+        "flux_kvs_lookup_multi fails on bad input");
+
+    errno = 0;
+    ok (flux_kvs_lookup_multi (NULL, 0, keys, 1) == NULL && errno == EINVAL,
+        "flux_kvs_lookup_multi h=NULL fails with EINVAL");
+
+    errno = 0;
+    ok (flux_kvs_lookup_multi_get (NULL, 0, NULL) < 0 && errno == EINVAL,
+        "flux_kvs_lookup_multi_get fails on bad input");
+
+    errno = 0;
+    ok (flux_kvs_lookup_multi_get_unpack (NULL, 0, NULL) < 0
+        && errno == EINVAL,
+        "flux_kvs_lookup_multi_get_unpack fails on bad input");
+
+    errno = 0;
+    ok (flux_kvs_lookup_multi_get_raw (NULL, 0, NULL, NULL) < 0
+        && errno == EINVAL,
+        "flux_kvs_lookup_multi_get_raw fails on bad input");
+
+    errno = 0;
+    ok (flux_kvs_lookup_multi_get_key (NULL, 0) == NULL && errno == EINVAL,
+        "flux_kvs_lookup_multi_get_key future=NULL fails with EINVAL");
+
+    if (!(f = flux_future_create (NULL, NULL)))
+        BAIL_OUT ("flux_future_create failed");
+
+    errno = 0;
+    ok (flux_kvs_lookup_multi_get_key (f, 0) == NULL && errno == EINVAL,
+        "flux_kvs_lookup_multi_get_key future=(wrong type) fails with EINVAL");
+
+    errno = 0;
+    ok (flux_kvs_lookup_multi_get (f, 0, NULL) < 0 && errno == EINVAL,
+        "flux_kvs_lookup_multi_get future=(wrong type) fails with EINVAL");
+
+    flux_future_destroy (f);
+}
+
 int main (int argc, char *argv[])
 {
 
     plan (NO_PLAN);
 
     errors ();
+    multi_errors ();
 
     done_testing();
     return (0);
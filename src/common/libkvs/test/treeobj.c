@@ -752,6 +752,279 @@ void test_corner_cases (void)
     json_decref (symlink);
 }
 
+void test_hdir (void)
+{
+    json_t *dir, *hdir, *shard, *dirref, *val;
+    const json_t *result;
+    char name[64];
+    int i, index, errors;
+
+    if (!(dir = create_large_dir ()))
+        BAIL_OUT ("can't continue without large dir");
+
+    errno = 0;
+    ok (treeobj_create_hdir (-1) == NULL && errno == EINVAL,
+        "treeobj_create_hdir depth=-1 fails with EINVAL");
+    errno = 0;
+    ok (treeobj_create_hdir (TREEOBJ_HDIR_MAX_DEPTH + 1) == NULL
+        && errno == EINVAL,
+        "treeobj_create_hdir depth > max fails with EINVAL");
+    ok ((hdir = treeobj_create_hdir (0)) != NULL,
+        "treeobj_create_hdir works");
+    ok (treeobj_is_hdir (hdir) && !treeobj_is_dir (hdir),
+        "treeobj_is_hdir returns true, treeobj_is_dir returns false");
+    ok (treeobj_validate (hdir) == 0,
+        "treeobj_validate likes empty hdir");
+    ok (treeobj_get_count (hdir) == 0,
+        "treeobj_get_count of empty hdir returns 0");
+    ok (treeobj_hdir_get_depth (hdir) == 0,
+        "treeobj_hdir_get_depth returns 0");
+    errno = 0;
+    ok (treeobj_hdir_get_shard (hdir, 0) == NULL && errno == ENOENT,
+        "treeobj_hdir_get_shard of empty slot fails with ENOENT");
+    errno = 0;
+    ok (treeobj_hdir_get_shard (hdir, TREEOBJ_HDIR_FANOUT) == NULL
+        && errno == EINVAL,
+        "treeobj_hdir_get_shard of out of range slot fails with EINVAL");
+    errno = 0;
+    ok (treeobj_get_entry (hdir, "foo") == NULL && errno == ENOENT,
+        "treeobj_get_entry on empty hdir fails with ENOENT");
+
+    if (!(val = treeobj_create_val ("foo", 4)))
+        BAIL_OUT ("can't continue without test value");
+    ok (treeobj_insert_entry (hdir, "foo", val) == 0,
+        "treeobj_insert_entry on hdir works");
+    index = treeobj_hdir_index (hdir, "foo");
+    ok (index >= 0 && index < TREEOBJ_HDIR_FANOUT
+        && (shard = treeobj_hdir_get_shard (hdir, index)) != NULL
+        && treeobj_is_dir (shard)
+        && treeobj_get_entry (shard, "foo") == val,
+        "entry was inserted into shard selected by treeobj_hdir_index");
+    ok (treeobj_get_entry (hdir, "foo") == val,
+        "treeobj_get_entry on hdir finds entry");
+    ok ((result = treeobj_peek_entry (hdir, "foo")) == val,
+        "treeobj_peek_entry on hdir finds entry");
+    ok (treeobj_get_count (hdir) == 1,
+        "treeobj_get_count of hdir counts one shard");
+    ok (treeobj_validate (hdir) == 0,
+        "treeobj_validate likes hdir with inline dir shard");
+    ok (treeobj_delete_entry (hdir, "foo") == 0
+        && treeobj_get_entry (hdir, "foo") == NULL,
+        "treeobj_delete_entry on hdir works");
+    errno = 0;
+    ok (treeobj_delete_entry (hdir, "foo") < 0 && errno == ENOENT,
+        "treeobj_delete_entry on hdir of missing entry fails with ENOENT");
+
+    if (!(dirref = treeobj_create_dirref (blobrefs[0])))
+        BAIL_OUT ("can't continue without test dirref");
+    ok (treeobj_hdir_set_shard (hdir, index, dirref) == 0,
+        "treeobj_hdir_set_shard dirref works");
+    ok (treeobj_validate (hdir) == 0,
+        "treeobj_validate likes hdir with dirref shard");
+    errno = 0;
+    ok (treeobj_get_entry (hdir, "foo") == NULL && errno == EAGAIN,
+        "treeobj_get_entry through dirref shard fails with EAGAIN");
+    errno = 0;
+    ok (treeobj_insert_entry (hdir, "foo", val) < 0 && errno == EAGAIN,
+        "treeobj_insert_entry through dirref shard fails with EAGAIN");
+    errno = 0;
+    ok (treeobj_hdir_set_shard (hdir, index, val) < 0 && errno == EINVAL,
+        "treeobj_hdir_set_shard of val fails with EINVAL");
+    ok (treeobj_hdir_set_shard (hdir, index, NULL) == 0
+        && treeobj_get_count (hdir) == 0,
+        "treeobj_hdir_set_shard NULL empties slot");
+    json_decref (dirref);
+    json_decref (hdir);
+
+    errno = 0;
+    ok (treeobj_hdir_split (val, 0) == NULL && errno == EINVAL,
+        "treeobj_hdir_split of non-dir fails with EINVAL");
+    json_decref (val);
+    ok ((hdir = treeobj_hdir_split (dir, 1)) != NULL
+        && treeobj_hdir_get_depth (hdir) == 1,
+        "treeobj_hdir_split of large dir works");
+    ok (treeobj_validate (hdir) == 0,
+        "treeobj_validate likes split hdir");
+    ok (treeobj_get_count (hdir) == TREEOBJ_HDIR_FANOUT,
+        "%d entries were spread over all shards", large_dir_entries);
+    errors = 0;
+    for (i = 0; i < large_dir_entries; i++) {
+        snprintf (name, sizeof (name), "entry-%.10d", i);
+        if (treeobj_get_entry (hdir, name) != treeobj_get_entry (dir, name))
+            errors++;
+    }
+    ok (errors == 0,
+        "treeobj_get_entry finds all entries in split hdir");
+    diag ("shard 0 has %d entries",
+          treeobj_get_count (treeobj_hdir_get_shard (hdir, 0)));
+
+    json_decref (hdir);
+    json_decref (dir);
+}
+
+/* Encode 'obj' to binary, decode it, and check the result is equal.
+ */
+bool binary_roundtrip (json_t *obj)
+{
+    void *buf;
+    int len;
+    json_t *cpy;
+    bool result;
+
+    if (treeobj_encode_binary (obj, &buf, &len) < 0)
+        return false;
+    result = treeobj_is_binary (buf, len)
+             && (cpy = treeobj_decode_binary (buf, len)) != NULL
+             && json_equal (obj, cpy);
+    if (result)
+        json_decref (cpy);
+    free (buf);
+    return result;
+}
+
+void test_binary (void)
+{
+    json_t *val, *valref, *dirref, *symlink, *dir, *dir2, *dir3, *hdir, *cpy;
+    const char data[] = { 'a', '\0', 'b', '\xff' };
+    void *buf, *buf2;
+    int len, len2;
+    char *json;
+    int i;
+
+    val = treeobj_create_val (data, sizeof (data));
+    valref = treeobj_create_valref (blobrefs[0]);
+    dirref = treeobj_create_dirref (blobrefs[1]);
+    symlink = treeobj_create_symlink ("a.b.c");
+    if (!val || !valref || !dirref || !symlink
+        || treeobj_append_blobref (valref, blobrefs[2]) < 0)
+        BAIL_OUT ("can't continue without test values");
+
+    ok (binary_roundtrip (val),
+        "binary round trip works on val with embedded NUL");
+    ok (treeobj_encode_binary (val, &buf, &len) == 0
+        && len == 3 + 2 + sizeof (data),
+        "binary val holds raw data, not base64");
+    free (buf);
+    cpy = treeobj_create_val (NULL, 0);
+    ok (binary_roundtrip (cpy),
+        "binary round trip works on zero length val");
+    json_decref (cpy);
+    ok (binary_roundtrip (valref),
+        "binary round trip works on valref with two blobrefs");
+    ok (binary_roundtrip (dirref),
+        "binary round trip works on dirref");
+    ok (binary_roundtrip (symlink),
+        "binary round trip works on symlink");
+
+    if (!(dir = treeobj_create_dir ()) || !(dir2 = treeobj_create_dir ()))
+        BAIL_OUT ("can't continue without test dirs");
+    ok (binary_roundtrip (dir),
+        "binary round trip works on empty dir");
+    treeobj_insert_entry (dir, "val", val);
+    treeobj_insert_entry (dir, "valref", valref);
+    treeobj_insert_entry (dir, "dirref", dirref);
+    treeobj_insert_entry (dir, "symlink", symlink);
+    treeobj_insert_entry (dir2, "symlink", symlink);
+    treeobj_insert_entry (dir2, "dirref", dirref);
+    treeobj_insert_entry (dir2, "valref", valref);
+    treeobj_insert_entry (dir2, "val", val);
+    treeobj_insert_entry (dir, "subdir", dir2);
+    ok (binary_roundtrip (dir),
+        "binary round trip works on dir with all types");
+
+    /* dir2 has the same entries as dir3, inserted in reverse order */
+    if (!(dir3 = treeobj_create_dir ()))
+        BAIL_OUT ("can't continue without test dirs");
+    treeobj_insert_entry (dir3, "val", val);
+    treeobj_insert_entry (dir3, "valref", valref);
+    treeobj_insert_entry (dir3, "dirref", dirref);
+    treeobj_insert_entry (dir3, "symlink", symlink);
+    ok (treeobj_encode_binary (dir2, &buf, &len) == 0
+        && treeobj_encode_binary (dir3, &buf2, &len2) == 0
+        && len == len2 && memcmp (buf, buf2, len) == 0,
+        "binary encoding is canonical");
+    free (buf2);
+    free (buf);
+    json_decref (dir3);
+
+    ok (treeobj_encode_binary (dir, &buf, &len) == 0
+        && (cpy = treeobj_decodeb (buf, len)) != NULL
+        && json_equal (cpy, dir),
+        "treeobj_decodeb accepts binary encoding");
+    json_decref (cpy);
+    free (buf);
+    json = treeobj_encode (dir);
+    ok (json != NULL && !treeobj_is_binary (json, strlen (json)),
+        "treeobj_is_binary is false for JSON encoding");
+    free (json);
+
+    json_decref (dir);
+    if (!(dir = create_large_dir ()))
+        BAIL_OUT ("can't continue without large dir");
+    ok (binary_roundtrip (dir),
+        "binary round trip works on large dir");
+    json = treeobj_encode (dir);
+    ok (treeobj_encode_binary (dir, &buf, &len) == 0
+        && len < strlen (json),
+        "binary encoding of large dir is smaller than JSON");
+    diag ("json %d bytes, binary %d bytes", (int)strlen (json), len);
+    free (json);
+
+    errno = 0;
+    ok (treeobj_decode_binary (buf, len - 1) == NULL && errno == EPROTO,
+        "treeobj_decode_binary fails on truncated input with EPROTO");
+    ((char *)buf)[2]++;
+    errno = 0;
+    ok (treeobj_decode_binary (buf, len) == NULL && errno == EPROTO,
+        "treeobj_decode_binary fails on wrong version with EPROTO");
+    free (buf);
+
+    if (!(hdir = treeobj_hdir_split (dir, 0)))
+        BAIL_OUT ("can't continue without test hdir");
+    treeobj_hdir_set_shard (hdir, 0, dirref);
+    treeobj_hdir_set_shard (hdir, 1, NULL);
+    ok (binary_roundtrip (hdir),
+        "binary round trip works on hdir");
+    json_decref (hdir);
+
+    /* dir with names out of order: { "b":symlink, "a":symlink } */
+    {
+        unsigned char bad[] = { 0, 'T', 1, 3, 2,
+                                1, 'b', 5, 1, 'x',
+                                1, 'a', 5, 1, 'x' };
+        errno = 0;
+        ok (treeobj_decode_binary (bad, sizeof (bad)) == NULL
+            && errno == EPROTO,
+            "treeobj_decode_binary rejects non-canonical dir");
+        bad[6] = 'a';
+        bad[11] = 'b';
+        ok ((cpy = treeobj_decode_binary (bad, sizeof (bad))) != NULL
+            && treeobj_get_count (cpy) == 2,
+            "treeobj_decode_binary accepts canonical dir");
+        json_decref (cpy);
+        for (i = 0; i < sizeof (bad); i++) {
+            if ((cpy = treeobj_decode_binary (bad, i)))
+                break;
+        }
+        ok (i == sizeof (bad),
+            "treeobj_decode_binary rejects all truncations");
+    }
+
+    errno = 0;
+    ok (treeobj_encode_binary (NULL, &buf, &len) < 0 && errno == EINVAL,
+        "treeobj_encode_binary obj=NULL fails with EINVAL");
+    errno = 0;
+    ok (treeobj_decode_binary ("{}", 2) == NULL && errno == EPROTO,
+        "treeobj_decode_binary of JSON fails with EPROTO");
+
+    json_decref (dir);
+    json_decref (dir2);
+    json_decref (val);
+    json_decref (valref);
+    json_decref (dirref);
+    json_decref (symlink);
+}
+
 int main(int argc, char** argv)
 {
     plan (NO_PLAN);
@@ -761,12 +1034,14 @@ int main(int argc, char** argv)
     test_dirref ();
     test_dir ();
     test_dir_peek ();
+    test_hdir ();
     test_copy ();
     test_deep_copy ();
     test_symlink ();
     test_corner_cases ();
 
     test_codec ();
+    test_binary ();
 
     done_testing();
 }
@@ -14,6 +14,9 @@
 #include "config.h"
 #endif
 #include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <string.h>
 #include <assert.h>
 #include <sodium.h>
@@ -24,6 +27,8 @@
 
 static const int treeobj_version = 1;
 
+static const int hdir_bits = 6; /* log2 (TREEOBJ_HDIR_FANOUT) */
+
 static int treeobj_unpack (json_t *obj, const char **typep, json_t **datap)
 {
     json_t *data;
@@ -69,6 +74,52 @@ static int treeobj_peek (const json_t *obj, const char **typep,
     return 0;
 }
 
+/* Unpack hdir data.  'shards' is owned by 'obj'.
+ */
+static int hdir_peek (const json_t *obj, int *depthp, json_t **shardsp)
+{
+    const char *type;
+    const json_t *data;
+    json_t *shards;
+    int depth;
+
+    if (treeobj_peek (obj, &type, &data) < 0
+            || strcmp (type, "hdir") != 0
+            || json_unpack ((json_t *)data, "{s:i s:o !}",
+                                            "depth", &depth,
+                                            "shards", &shards) < 0
+            || depth < 0 || depth > TREEOBJ_HDIR_MAX_DEPTH
+            || !json_is_array (shards)
+            || json_array_size (shards) != TREEOBJ_HDIR_FANOUT) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (depthp)
+        *depthp = depth;
+    if (shardsp)
+        *shardsp = shards;
+    return 0;
+}
+
+/* 64-bit FNV-1a hash of 'name'.
+ */
+static uint64_t hdir_hash (const char *name)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int hdir_index (const char *name, int depth)
+{
+    return (hdir_hash (name) >> (hdir_bits * depth))
+           & (TREEOBJ_HDIR_FANOUT - 1);
+}
+
 int treeobj_validate (const json_t *obj)
 {
     const json_t *o;
@@ -101,6 +152,22 @@ int treeobj_validate (const json_t *obj)
                 goto inval;
         }
     }
+    else if (!strcmp (type, "hdir")) {
+        json_t *shards;
+        size_t index;
+        if (hdir_peek (obj, NULL, &shards) < 0)
+            goto inval;
+        json_array_foreach (shards, index, o) {
+            if (json_is_null (o))
+                continue;
+            if (treeobj_validate (o) < 0)
+                goto inval;
+            if (!treeobj_is_dirref (o)
+                    && !treeobj_is_dir (o)
+                    && !treeobj_is_hdir (o))
+                goto inval;
+        }
+    }
     else if (!strcmp (type, "symlink")) {
         if (!json_is_string (data))
             goto inval;
@@ -156,6 +223,12 @@ bool treeobj_is_dirref (const json_t *obj)
     return type && !strcmp (type, "dirref");
 }
 
+bool treeobj_is_hdir (const json_t *obj)
+{
+    const char *type = treeobj_get_type (obj);
+    return type && !strcmp (type, "hdir");
+}
+
 json_t *treeobj_get_data (json_t *obj)
 {
     json_t *data;
@@ -236,6 +309,18 @@ int treeobj_get_count (const json_t *obj)
     else if (!strcmp (type, "dir")) {
         count = json_object_size (data);
     }
+    else if (!strcmp (type, "hdir")) {
+        json_t *shards;
+        json_t *o;
+        size_t index;
+        if (hdir_peek (obj, NULL, &shards) < 0)
+            return -1;
+        count = 0;
+        json_array_foreach (shards, index, o) {
+            if (!json_is_null (o))
+                count++;
+        }
+    }
     else if (!strcmp (type, "symlink") || !strcmp (type, "val")) {
         count = 1;
     } else {
@@ -246,11 +331,114 @@ done:
     return count;
 }
 
+int treeobj_hdir_get_depth (const json_t *obj)
+{
+    int depth;
+
+    if (hdir_peek (obj, &depth, NULL) < 0)
+        return -1;
+    return depth;
+}
+
+int treeobj_hdir_index (const json_t *obj, const char *name)
+{
+    int depth;
+
+    if (!name || hdir_peek (obj, &depth, NULL) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return hdir_index (name, depth);
+}
+
+json_t *treeobj_hdir_get_shard (json_t *obj, int index)
+{
+    json_t *shards;
+    json_t *shard;
+
+    if (hdir_peek (obj, NULL, &shards) < 0
+            || index < 0 || index >= TREEOBJ_HDIR_FANOUT) {
+        errno = EINVAL;
+        return NULL;
+    }
+    shard = json_array_get (shards, index);
+    if (!shard || json_is_null (shard)) {
+        errno = ENOENT;
+        return NULL;
+    }
+    return shard;
+}
+
+int treeobj_hdir_set_shard (json_t *obj, int index, json_t *shard)
+{
+    json_t *shards;
+    int rc;
+
+    if (hdir_peek (obj, NULL, &shards) < 0
+            || index < 0 || index >= TREEOBJ_HDIR_FANOUT
+            || (shard && !treeobj_is_dirref (shard)
+                      && !treeobj_is_dir (shard)
+                      && !treeobj_is_hdir (shard))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (shard)
+        rc = json_array_set (shards, index, shard);
+    else
+        rc = json_array_set_new (shards, index, json_null ());
+    if (rc < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+/* Find the dir that holds (or would hold) 'name' in hdir 'obj', following
+ * in-memory shards.  If 'create' is true, an empty slot on the path is
+ * filled with a new dir.  Returns dir (owned by 'obj'), or NULL with
+ * errno = ENOENT (empty slot), EAGAIN (shard not loaded), or EINVAL.
+ */
+static json_t *hdir_find_dir (json_t *obj, const char *name, bool create)
+{
+    json_t *shard;
+    int index;
+
+    while (treeobj_is_hdir (obj)) {
+        if ((index = treeobj_hdir_index (obj, name)) < 0)
+            return NULL;
+        if (!(shard = treeobj_hdir_get_shard (obj, index))) {
+            if (!create || errno != ENOENT)
+                return NULL;
+            if (!(shard = treeobj_create_dir ()))
+                return NULL;
+            if (treeobj_hdir_set_shard (obj, index, shard) < 0) {
+                json_decref (shard);
+                return NULL;
+            }
+            json_decref (shard); /* 'obj' holds a reference */
+        }
+        else if (treeobj_is_dirref (shard)) {
+            errno = EAGAIN;
+            return NULL;
+        }
+        obj = shard;
+    }
+    if (!treeobj_is_dir (obj)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return obj;
+}
+
 json_t *treeobj_get_entry (json_t *obj, const char *name)
 {
     const char *type;
     json_t *data, *obj2;
 
+    if (treeobj_is_hdir (obj)) {
+        if (!name || !(obj = hdir_find_dir (obj, name, false)))
+            return NULL;
+    }
     if (treeobj_unpack (obj, &type, &data) < 0
             || strcmp (type, "dir") != 0) {
         errno = EINVAL;
@@ -268,6 +456,10 @@ int treeobj_delete_entry (json_t *obj, const char *name)
     const char *type;
     json_t *data;
 
+    if (treeobj_is_hdir (obj)) {
+        if (!name || !(obj = hdir_find_dir (obj, name, false)))
+            return -1;
+    }
     if (treeobj_unpack (obj, &type, &data) < 0
             || strcmp (type, "dir") != 0) {
         errno = EINVAL;
@@ -285,6 +477,10 @@ int treeobj_insert_entry (json_t *obj, const char *name, json_t *obj2)
     const char *type;
     json_t *data;
 
+    if (treeobj_is_hdir (obj) && name && obj2) {
+        if (!(obj = hdir_find_dir (obj, name, true)))
+            return -1;
+    }
     if (!name || !obj2 || treeobj_unpack (obj, &type, &data) < 0
             || strcmp (type, "dir") != 0
             || treeobj_validate (obj2) < 0) {
@@ -303,6 +499,12 @@ const json_t *treeobj_peek_entry (const json_t *obj, const char *name)
     const char *type;
     const json_t *data, *obj2;
 
+    /* N.B. hdir_find_dir() does not modify 'obj' when create is false.
+     */
+    if (treeobj_is_hdir (obj)) {
+        if (!name || !(obj = hdir_find_dir ((json_t *)obj, name, false)))
+            return NULL;
+    }
     if (treeobj_peek (obj, &type, &data) < 0
             || strcmp (type, "dir") != 0) {
         errno = EINVAL;
@@ -420,6 +622,75 @@ json_t *treeobj_create_dir (void)
     return obj;
 }
 
+json_t *treeobj_create_hdir (int depth)
+{
+    json_t *obj;
+    json_t *shards;
+    int i;
+
+    if (depth < 0 || depth > TREEOBJ_HDIR_MAX_DEPTH) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(shards = json_array ()))
+        goto nomem;
+    for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+        if (json_array_append_new (shards, json_null ()) < 0) {
+            json_decref (shards);
+            goto nomem;
+        }
+    }
+    if (!(obj = json_pack ("{s:i s:s s:{s:i s:o}}", "ver", treeobj_version,
+                                                   "type", "hdir",
+                                                   "data",
+                                                     "depth", depth,
+                                                     "shards", shards)))
+        goto nomem;
+    return obj;
+nomem:
+    errno = ENOMEM;
+    return NULL;
+}
+
+json_t *treeobj_hdir_split (json_t *obj, int depth)
+{
+    const char *type;
+    json_t *data;
+    json_t *hdir;
+    json_t *shard;
+    json_t *o;
+    const char *name;
+    int index;
+
+    if (treeobj_unpack (obj, &type, &data) < 0 || strcmp (type, "dir") != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(hdir = treeobj_create_hdir (depth)))
+        return NULL;
+    json_object_foreach (data, name, o) {
+        index = hdir_index (name, depth);
+        if (!(shard = treeobj_hdir_get_shard (hdir, index))) {
+            if (!(shard = treeobj_create_dir ()))
+                goto error;
+            if (treeobj_hdir_set_shard (hdir, index, shard) < 0) {
+                json_decref (shard);
+                goto error;
+            }
+            json_decref (shard);
+        }
+        /* entries were validated as part of 'obj' */
+        if (json_object_set (treeobj_get_data (shard), name, o) < 0) {
+            errno = ENOMEM;
+            goto error;
+        }
+    }
+    return hdir;
+error:
+    json_decref (hdir);
+    return NULL;
+}
+
 json_t *treeobj_create_symlink (const char *target)
 {
     json_t *obj;
@@ -542,6 +813,9 @@ json_t *treeobj_decode (const char *buf)
 json_t *treeobj_decodeb (const char *buf, size_t buflen)
 {
     json_t *obj = NULL;
+
+    if (treeobj_is_binary (buf, buflen))
+        return treeobj_decode_binary (buf, buflen);
     if (!(obj = json_loadb (buf, buflen, 0, NULL))
             || treeobj_validate (obj) < 0) {
         errno = EPROTO;
@@ -558,6 +832,479 @@ char *treeobj_encode (const json_t *obj)
     return json_dumps (obj, JSON_COMPACT|JSON_SORT_KEYS);
 }
 
+/* Binary encoding (see treeobj.h).
+ *
+ *   blob   := 0x00 'T' version:u8 node
+ *   node   := type:u8 payload
+ *   val     (1): str              raw data
+ *   valref  (2): uint n, n * str  blobrefs
+ *   dir     (3): uint n, n * (str name, node), names in strcmp order
+ *   dirref  (4): uint n, n * str  blobrefs
+ *   symlink (5): str              target
+ *   hdir    (6): uint depth, TREEOBJ_HDIR_FANOUT * (0x00 | node)
+ *   str    := uint len, len bytes
+ *   uint   := unsigned LEB128, shortest form
+ */
+#define BINARY_MAGIC0       0x00
+#define BINARY_MAGIC1       'T'
+#define BINARY_VERSION      1
+#define BINARY_HEADER_SIZE  3
+
+enum {
+    BINARY_NULL = 0,
+    BINARY_VAL = 1,
+    BINARY_VALREF = 2,
+    BINARY_DIR = 3,
+    BINARY_DIRREF = 4,
+    BINARY_SYMLINK = 5,
+    BINARY_HDIR = 6,
+};
+
+struct wbuf {
+    unsigned char *data;
+    size_t len;
+    size_t size;
+};
+
+static int wbuf_reserve (struct wbuf *wb, size_t n)
+{
+    if (wb->len + n > wb->size) {
+        size_t size = wb->size ? wb->size : 256;
+        unsigned char *data;
+
+        while (wb->len + n > size)
+            size *= 2;
+        if (!(data = realloc (wb->data, size))) {
+            errno = ENOMEM;
+            return -1;
+        }
+        wb->data = data;
+        wb->size = size;
+    }
+    return 0;
+}
+
+static int wbuf_put (struct wbuf *wb, const void *data, size_t len)
+{
+    if (wbuf_reserve (wb, len) < 0)
+        return -1;
+    if (len > 0)
+        memcpy (wb->data + wb->len, data, len);
+    wb->len += len;
+    return 0;
+}
+
+static int wbuf_put_byte (struct wbuf *wb, unsigned char c)
+{
+    return wbuf_put (wb, &c, 1);
+}
+
+static int wbuf_put_uint (struct wbuf *wb, uint64_t n)
+{
+    unsigned char buf[10];
+    int len = 0;
+
+    do {
+        buf[len] = n & 0x7f;
+        n >>= 7;
+        if (n)
+            buf[len] |= 0x80;
+        len++;
+    } while (n);
+    return wbuf_put (wb, buf, len);
+}
+
+static int wbuf_put_str (struct wbuf *wb, const void *data, size_t len)
+{
+    if (wbuf_put_uint (wb, len) < 0 || wbuf_put (wb, data, len) < 0)
+        return -1;
+    return 0;
+}
+
+static int wbuf_put_blobrefs (struct wbuf *wb, const json_t *data)
+{
+    size_t index;
+    json_t *o;
+    const char *s;
+
+    if (wbuf_put_uint (wb, json_array_size (data)) < 0)
+        return -1;
+    json_array_foreach (data, index, o) {
+        if (!(s = json_string_value (o))) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (wbuf_put_str (wb, s, strlen (s)) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int cmp_name (const void *a, const void *b)
+{
+    return strcmp (*(const char **)a, *(const char **)b);
+}
+
+static int encode_node (struct wbuf *wb, const json_t *obj);
+
+static int encode_dir (struct wbuf *wb, const json_t *data)
+{
+    const char **names;
+    const char *name;
+    json_t *o;
+    size_t count = json_object_size (data);
+    size_t i = 0;
+    int rc = -1;
+
+    if (!(names = malloc ((count ? count : 1) * sizeof (names[0])))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    json_object_foreach ((json_t *)data, name, o)
+        names[i++] = name;
+    qsort (names, count, sizeof (names[0]), cmp_name);
+    if (wbuf_put_uint (wb, count) < 0)
+        goto done;
+    for (i = 0; i < count; i++) {
+        if (wbuf_put_str (wb, names[i], strlen (names[i])) < 0
+            || encode_node (wb, json_object_get (data, names[i])) < 0)
+            goto done;
+    }
+    rc = 0;
+done:
+    free (names);
+    return rc;
+}
+
+static int encode_node (struct wbuf *wb, const json_t *obj)
+{
+    const char *type;
+    const json_t *data;
+
+    if (treeobj_peek (obj, &type, &data) < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!strcmp (type, "val")) {
+        void *val;
+        int len;
+        int rc;
+
+        if (treeobj_decode_val (obj, &val, &len) < 0)
+            return -1;
+        rc = 0;
+        if (wbuf_put_byte (wb, BINARY_VAL) < 0
+            || wbuf_put_str (wb, val, len) < 0)
+            rc = -1;
+        free (val);
+        return rc;
+    }
+    else if (!strcmp (type, "valref") || !strcmp (type, "dirref")) {
+        if (wbuf_put_byte (wb, !strcmp (type, "valref") ? BINARY_VALREF
+                                                         : BINARY_DIRREF) < 0
+            || wbuf_put_blobrefs (wb, data) < 0)
+            return -1;
+    }
+    else if (!strcmp (type, "dir")) {
+        if (wbuf_put_byte (wb, BINARY_DIR) < 0 || encode_dir (wb, data) < 0)
+            return -1;
+    }
+    else if (!strcmp (type, "symlink")) {
+        const char *target = json_string_value (data);
+
+        if (!target) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (wbuf_put_byte (wb, BINARY_SYMLINK) < 0
+            || wbuf_put_str (wb, target, strlen (target)) < 0)
+            return -1;
+    }
+    else if (!strcmp (type, "hdir")) {
+        json_t *shards;
+        json_t *o;
+        size_t index;
+        int depth;
+
+        if (hdir_peek (obj, &depth, &shards) < 0)
+            return -1;
+        if (wbuf_put_byte (wb, BINARY_HDIR) < 0
+            || wbuf_put_uint (wb, depth) < 0)
+            return -1;
+        json_array_foreach (shards, index, o) {
+            if (json_is_null (o)) {
+                if (wbuf_put_byte (wb, BINARY_NULL) < 0)
+                    return -1;
+            }
+            else if (encode_node (wb, o) < 0)
+                return -1;
+        }
+    }
+    else {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+int treeobj_encode_binary (const json_t *obj, void **buf, int *len)
+{
+    struct wbuf wb = { NULL, 0, 0 };
+    unsigned char header[] = { BINARY_MAGIC0, BINARY_MAGIC1, BINARY_VERSION };
+    int save_errno;
+
+    if (!obj || !buf || !len) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (wbuf_put (&wb, header, sizeof (header)) < 0
+        || encode_node (&wb, obj) < 0)
+        goto error;
+    if (wb.len > INT_MAX) {
+        errno = EOVERFLOW;
+        goto error;
+    }
+    *buf = wb.data;
+    *len = wb.len;
+    return 0;
+error:
+    save_errno = errno;
+    free (wb.data);
+    errno = save_errno;
+    return -1;
+}
+
+struct rbuf {
+    const unsigned char *data;
+    size_t len;
+};
+
+static int rbuf_get_byte (struct rbuf *rb, int *c)
+{
+    if (rb->len < 1)
+        return -1;
+    *c = *rb->data++;
+    rb->len--;
+    return 0;
+}
+
+static int rbuf_get_uint (struct rbuf *rb, size_t *np)
+{
+    uint64_t n = 0;
+    int shift = 0;
+    int c;
+
+    do {
+        if (shift > 56 || rbuf_get_byte (rb, &c) < 0)
+            return -1;
+        n |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    if (c == 0 && shift > 7) /* not shortest form */
+        return -1;
+    if (n > SIZE_MAX)
+        return -1;
+    *np = n;
+    return 0;
+}
+
+static int rbuf_get_str (struct rbuf *rb, const void **data, size_t *len)
+{
+    size_t n;
+
+    if (rbuf_get_uint (rb, &n) < 0 || n > rb->len)
+        return -1;
+    *data = rb->data;
+    *len = n;
+    rb->data += n;
+    rb->len -= n;
+    return 0;
+}
+
+/* Return a NUL-terminated copy of the next str (caller must free).
+ */
+static char *rbuf_get_cstr (struct rbuf *rb)
+{
+    const void *data;
+    size_t len;
+    char *s;
+
+    if (rbuf_get_str (rb, &data, &len) < 0 || memchr (data, '\0', len))
+        return NULL;
+    if (!(s = malloc (len + 1)))
+        return NULL;
+    memcpy (s, data, len);
+    s[len] = '\0';
+    return s;
+}
+
+static json_t *decode_blobrefs (struct rbuf *rb, json_t *obj)
+{
+    size_t count;
+    size_t i;
+    char *s;
+
+    if (rbuf_get_uint (rb, &count) < 0)
+        goto error;
+    for (i = 0; i < count; i++) {
+        if (!(s = rbuf_get_cstr (rb)))
+            goto error;
+        if (treeobj_append_blobref (obj, s) < 0) {
+            free (s);
+            goto error;
+        }
+        free (s);
+    }
+    return obj;
+error:
+    json_decref (obj);
+    return NULL;
+}
+
+static json_t *decode_node (struct rbuf *rb, int depth);
+
+static json_t *decode_dir (struct rbuf *rb, int depth)
+{
+    json_t *dir;
+    json_t *data;
+    json_t *o;
+    char *name;
+    char *prev = NULL;
+    size_t count;
+    size_t i;
+
+    if (!(dir = treeobj_create_dir ()))
+        return NULL;
+    data = treeobj_get_data (dir);
+    if (rbuf_get_uint (rb, &count) < 0)
+        goto error;
+    for (i = 0; i < count; i++) {
+        if (!(name = rbuf_get_cstr (rb)))
+            goto error;
+        /* names must be strictly ordered, or the encoding isn't canonical */
+        if (prev && strcmp (prev, name) >= 0) {
+            free (name);
+            goto error;
+        }
+        free (prev);
+        prev = name;
+        if (!(o = decode_node (rb, depth + 1)))
+            goto error;
+        if (json_object_set_new (data, name, o) < 0) {
+            json_decref (o);
+            goto error;
+        }
+    }
+    free (prev);
+    return dir;
+error:
+    free (prev);
+    json_decref (dir);
+    return NULL;
+}
+
+static json_t *decode_hdir (struct rbuf *rb, int depth)
+{
+    json_t *hdir = NULL;
+    json_t *shard;
+    size_t hdepth;
+    int i, c;
+
+    if (rbuf_get_uint (rb, &hdepth) < 0
+        || hdepth > TREEOBJ_HDIR_MAX_DEPTH
+        || !(hdir = treeobj_create_hdir (hdepth)))
+        goto error;
+    for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+        if (rb->len < 1)
+            goto error;
+        if (rb->data[0] == BINARY_NULL) {
+            (void)rbuf_get_byte (rb, &c);
+            continue;
+        }
+        if (!(shard = decode_node (rb, depth + 1)))
+            goto error;
+        if (treeobj_hdir_set_shard (hdir, i, shard) < 0) {
+            json_decref (shard);
+            goto error;
+        }
+        json_decref (shard);
+    }
+    return hdir;
+error:
+    json_decref (hdir);
+    return NULL;
+}
+
+/* 'depth' limits recursion on malicious input.
+ */
+static json_t *decode_node (struct rbuf *rb, int depth)
+{
+    const void *data;
+    size_t len;
+    char *s;
+    json_t *obj;
+    int type;
+
+    if (depth > 1024 || rbuf_get_byte (rb, &type) < 0)
+        return NULL;
+    switch (type) {
+        case BINARY_VAL:
+            if (rbuf_get_str (rb, &data, &len) < 0 || len > INT_MAX)
+                return NULL;
+            return treeobj_create_val (data, len);
+        case BINARY_VALREF:
+            if (!(obj = treeobj_create_valref (NULL)))
+                return NULL;
+            return decode_blobrefs (rb, obj);
+        case BINARY_DIRREF:
+            if (!(obj = treeobj_create_dirref (NULL)))
+                return NULL;
+            return decode_blobrefs (rb, obj);
+        case BINARY_DIR:
+            return decode_dir (rb, depth);
+        case BINARY_SYMLINK:
+            if (!(s = rbuf_get_cstr (rb)))
+                return NULL;
+            obj = treeobj_create_symlink (s);
+            free (s);
+            return obj;
+        case BINARY_HDIR:
+            return decode_hdir (rb, depth);
+        default:
+            return NULL;
+    }
+}
+
+bool treeobj_is_binary (const void *buf, size_t buflen)
+{
+    const unsigned char *p = buf;
+
+    return (p && buflen >= BINARY_HEADER_SIZE
+              && p[0] == BINARY_MAGIC0
+              && p[1] == BINARY_MAGIC1);
+}
+
+json_t *treeobj_decode_binary (const void *buf, size_t buflen)
+{
+    struct rbuf rb;
+    json_t *obj = NULL;
+
+    if (!treeobj_is_binary (buf, buflen)
+        || ((const unsigned char *)buf)[2] != BINARY_VERSION)
+        goto eproto;
+    rb.data = (const unsigned char *)buf + BINARY_HEADER_SIZE;
+    rb.len = buflen - BINARY_HEADER_SIZE;
+    if (!(obj = decode_node (&rb, 0))
+        || rb.len != 0
+        || treeobj_validate (obj) < 0)
+        goto eproto;
+    return obj;
+eproto:
+    json_decref (obj);
+    errno = EPROTO;
+    return NULL;
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
@@ -16,6 +16,16 @@
 
 /* See RFC 11 */
 
+/* An hdir is a large directory split into a hash array mapped trie.
+ * Its data is an object { "depth":i, "shards":[...] } where "shards" is
+ * an array of TREEOBJ_HDIR_FANOUT slots.  Each directory entry belongs to
+ * the slot selected by bits of a hash of its name, taken at 'depth'.
+ * A slot is null (no entries), a dirref to a stored shard, or (in memory
+ * only) a dir or hdir.  Shards are dirs, or hdirs of depth + 1.
+ */
+#define TREEOBJ_HDIR_FANOUT     64
+#define TREEOBJ_HDIR_MAX_DEPTH  10
+
 /* Create a treeobj
  * valref, dirref: if blobref is NULL, treeobj_append_blobref()
  * must be called before object is valid.
@@ -27,6 +37,7 @@ json_t *treeobj_create_val (const void *data, int len);
 json_t *treeobj_create_valref (const char *blobref);
 json_t *treeobj_create_dir (void);
 json_t *treeobj_create_dirref (const char *blobref);
+json_t *treeobj_create_hdir (int depth);
 
 /* Validate treeobj, recursively.
  * Return 0 if valid, -1 with errno = EINVAL if invalid.
@@ -44,6 +55,7 @@ bool treeobj_is_val (const json_t *obj);
 bool treeobj_is_valref (const json_t *obj);
 bool treeobj_is_dir (const json_t *obj);
 bool treeobj_is_dirref (const json_t *obj);
+bool treeobj_is_hdir (const json_t *obj);
 
 /* get type-specific value.
  * For dirref/valref, this is an array of blobrefs.
@@ -69,6 +81,7 @@ int treeobj_decode_val (const json_t *obj, void **data, int *len);
 /* get type-specific count.
  * For dirref/valref, this is the number of blobrefs.
  * For directory, this is number of entries
+ * For hdir, this is the number of non-empty slots.
  * For symlink or val, this is 1.
  * Return count on success, -1 on error with errno = EINVAL.
  */
@@ -78,6 +91,9 @@ int treeobj_get_count (const json_t *obj);
  * Get returns JSON object (owned by 'obj', do not destory), NULL on error.
  * insert takes a reference on 'obj2' (caller retains ownership).
  * insert/delete return 0 on success, -1 on error with errno set.
+ * On an hdir, these follow in-memory shards to the one holding 'name',
+ * creating it on insert.  If that shard has not been loaded (is a dirref),
+ * they fail with errno = EAGAIN.
  */
 json_t *treeobj_get_entry (json_t *obj, const char *name);
 int treeobj_insert_entry (json_t *obj, const char *name, json_t *obj2);
@@ -89,6 +105,24 @@ int treeobj_delete_entry (json_t *obj, const char *name);
  */
 const json_t *treeobj_peek_entry (const json_t *obj, const char *name);
 
+/* hdir accessors.
+ * treeobj_hdir_index() returns the slot index of 'name' in 'obj'.
+ * treeobj_hdir_get_shard() returns the slot at 'index' (owned by 'obj'),
+ * or NULL with errno = ENOENT if it is empty.
+ * treeobj_hdir_set_shard() takes a reference on 'shard', or empties the
+ * slot if 'shard' is NULL.
+ * Return -1 or NULL on error with errno set.
+ */
+int treeobj_hdir_get_depth (const json_t *obj);
+int treeobj_hdir_index (const json_t *obj, const char *name);
+json_t *treeobj_hdir_get_shard (json_t *obj, int index);
+int treeobj_hdir_set_shard (json_t *obj, int index, json_t *shard);
+
+/* Create an hdir at 'depth' holding the entries of dir 'obj', with
+ * shards as in-memory dirs.  Entries are shared with 'obj', not copied.
+ */
+json_t *treeobj_hdir_split (json_t *obj, int depth);
+
 /* Shallow copy a treeobj
  * Note that this is not a shallow copy on the json object, but is a
  * shallow copy on the data within a tree object.  For example, for a
@@ -124,6 +158,19 @@ json_t *treeobj_decode (const char *buf);
 json_t *treeobj_decodeb (const char *buf, size_t buflen);
 char *treeobj_encode (const json_t *obj);
 
+/* Convert a treeobj to/from a compact binary encoding, an alternative
+ * to JSON for tree objects stored in the content store.  Like the JSON
+ * encoding (compact, sorted keys), it is canonical, so equal treeobjs
+ * always hash to the same blobref.  val data is stored as raw bytes.
+ * Binary blobs begin with a NUL byte, so treeobj_is_binary() can tell them
+ * from JSON, and treeobj_decodeb() accepts either encoding.
+ * The buffer returned by treeobj_encode_binary must be destroyed with free().
+ * Return -1 or NULL on error with errno set (EPROTO on malformed input).
+ */
+int treeobj_encode_binary (const json_t *obj, void **buf, int *len);
+json_t *treeobj_decode_binary (const void *buf, size_t buflen);
+bool treeobj_is_binary (const void *buf, size_t buflen);
+
 #endif /* !_FLUX_KVS_TREEOBJ_H */
 
 /*
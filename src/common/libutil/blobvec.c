@@ -0,0 +1,243 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "blobvec.h"
+
+#define ITEM_HEADER_SIZE    12
+
+struct blobvec_item {
+    int errnum;
+    int flags;
+    int offset;             /* offset of data in buffer */
+    int len;
+};
+
+struct blobvec {
+    uint8_t *buf;           /* encode buffer (owned) */
+    int buf_size;
+    int buf_len;
+    const uint8_t *base;    /* buffer items are relative to */
+    struct blobvec_item *items;
+    int items_size;
+    int count;
+};
+
+void blobvec_destroy (struct blobvec *bv)
+{
+    if (bv) {
+        int saved_errno = errno;
+        free (bv->buf);
+        free (bv->items);
+        free (bv);
+        errno = saved_errno;
+    }
+}
+
+struct blobvec *blobvec_create (void)
+{
+    struct blobvec *bv;
+
+    if (!(bv = calloc (1, sizeof (*bv)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return bv;
+}
+
+static int grow_items (struct blobvec *bv)
+{
+    if (bv->count == bv->items_size) {
+        int new_size = bv->items_size ? bv->items_size * 2 : 16;
+        struct blobvec_item *new_items;
+
+        if (!(new_items = realloc (bv->items, new_size * sizeof (*new_items)))) {
+            errno = ENOMEM;
+            return -1;
+        }
+        bv->items = new_items;
+        bv->items_size = new_size;
+    }
+    return 0;
+}
+
+static int grow_buf (struct blobvec *bv, int need)
+{
+    if (bv->buf_len + need > bv->buf_size) {
+        int new_size = bv->buf_size ? bv->buf_size : 4096;
+        uint8_t *new_buf;
+
+        while (new_size < bv->buf_len + need)
+            new_size *= 2;
+        if (!(new_buf = realloc (bv->buf, new_size))) {
+            errno = ENOMEM;
+            return -1;
+        }
+        bv->buf = new_buf;
+        bv->buf_size = new_size;
+    }
+    return 0;
+}
+
+int blobvec_append_flags (struct blobvec *bv, int errnum, int flags,
+                          const void *data, int len)
+{
+    uint32_t nerrnum, nflags, nlen;
+
+    if (!bv || (errnum == 0 && (len < 0 || (len > 0 && !data)))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (errnum != 0)
+        len = 0;
+    if (grow_items (bv) < 0 || grow_buf (bv, ITEM_HEADER_SIZE + len) < 0)
+        return -1;
+    nerrnum = htonl (errnum);
+    nflags = htonl (flags);
+    nlen = htonl (len);
+    memcpy (bv->buf + bv->buf_len, &nerrnum, 4);
+    memcpy (bv->buf + bv->buf_len + 4, &nflags, 4);
+    memcpy (bv->buf + bv->buf_len + 8, &nlen, 4);
+    bv->buf_len += ITEM_HEADER_SIZE;
+    if (len > 0)
+        memcpy (bv->buf + bv->buf_len, data, len);
+    bv->items[bv->count].errnum = errnum;
+    bv->items[bv->count].flags = flags;
+    bv->items[bv->count].offset = bv->buf_len;
+    bv->items[bv->count].len = len;
+    bv->count++;
+    bv->buf_len += len;
+    bv->base = bv->buf;
+    return 0;
+}
+
+int blobvec_append (struct blobvec *bv, int errnum, const void *data, int len)
+{
+    return blobvec_append_flags (bv, errnum, 0, data, len);
+}
+
+struct blobvec *blobvec_decode (const void *buf, int len)
+{
+    struct blobvec *bv;
+    const uint8_t *p = buf;
+    int offset = 0;
+
+    if (len < 0 || (len > 0 && !buf)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(bv = blobvec_create ()))
+        return NULL;
+    bv->base = p;
+    while (offset < len) {
+        uint32_t nerrnum, nflags, nlen;
+        int item_len;
+
+        if (len - offset < ITEM_HEADER_SIZE)
+            goto eproto;
+        memcpy (&nerrnum, p + offset, 4);
+        memcpy (&nflags, p + offset + 4, 4);
+        memcpy (&nlen, p + offset + 8, 4);
+        offset += ITEM_HEADER_SIZE;
+        item_len = ntohl (nlen);
+        if (item_len < 0 || item_len > len - offset)
+            goto eproto;
+        if (grow_items (bv) < 0)
+            goto error;
+        bv->items[bv->count].errnum = ntohl (nerrnum);
+        bv->items[bv->count].flags = ntohl (nflags);
+        bv->items[bv->count].offset = offset;
+        bv->items[bv->count].len = item_len;
+        bv->count++;
+        offset += item_len;
+    }
+    return bv;
+eproto:
+    errno = EPROTO;
+error:
+    blobvec_destroy (bv);
+    return NULL;
+}
+
+int blobvec_count (struct blobvec *bv)
+{
+    return bv ? bv->count : 0;
+}
+
+int blobvec_get (struct blobvec *bv, int index, const void **data, int *len)
+{
+    struct blobvec_item *item;
+
+    if (!bv || index < 0 || index >= bv->count) {
+        errno = EINVAL;
+        return -1;
+    }
+    item = &bv->items[index];
+    if (item->errnum != 0) {
+        errno = item->errnum;
+        return -1;
+    }
+    if (data)
+        *data = item->len > 0 ? bv->base + item->offset : NULL;
+    if (len)
+        *len = item->len;
+    return 0;
+}
+
+int blobvec_get_flags (struct blobvec *bv, int index, int *flags)
+{
+    if (!bv || index < 0 || index >= bv->count) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (flags)
+        *flags = bv->items[index].flags;
+    return 0;
+}
+
+int blobvec_get_string (struct blobvec *bv, int index, const char **s)
+{
+    const char *data;
+    int len;
+
+    if (blobvec_get (bv, index, (const void **)&data, &len) < 0)
+        return -1;
+    if (len == 0 || data[len - 1] != '\0') {
+        errno = EPROTO;
+        return -1;
+    }
+    if (s)
+        *s = data;
+    return 0;
+}
+
+int blobvec_encode (struct blobvec *bv, const void **buf, int *len)
+{
+    if (!bv || (bv->count > 0 && bv->base != bv->buf)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (buf)
+        *buf = bv->buf;
+    if (len)
+        *len = bv->buf_len;
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
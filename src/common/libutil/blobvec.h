@@ -0,0 +1,82 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _UTIL_BLOBVEC_H
+#define _UTIL_BLOBVEC_H
+
+/* blobvec - encode/decode a vector of blobs in one buffer
+ *
+ * Used as the payload of the batched content.load-batch and
+ * content.store-batch RPCs.  Each item is encoded as
+ *
+ *   [errnum:4][flags:4][len:4][data:len]
+ *
+ * with integers in network byte order.  A nonzero errnum indicates the
+ * item failed, in which case len is zero.  Blobrefs are encoded as
+ * NULL-terminated strings, with len including the terminator.
+ */
+
+#include <stdint.h>
+
+/* Item flags used by the content protocol.
+ * COMPRESSED: item data is a blob in blobz encoding.
+ * ACCEPT_COMPRESSED: (load request blobref) the response item may be
+ *   compressed.
+ */
+enum {
+    BLOBVEC_FLAG_COMPRESSED = 1,
+    BLOBVEC_FLAG_ACCEPT_COMPRESSED = 2,
+};
+
+struct blobvec;
+
+/* Create an empty blobvec for encoding.
+ */
+struct blobvec *blobvec_create (void);
+
+/* Decode 'buf' into a blobvec.  Item data points into 'buf', so the
+ * blobvec must not outlive it.  Returns NULL with errno = EPROTO if
+ * 'buf' is not a valid encoding.
+ */
+struct blobvec *blobvec_decode (const void *buf, int len);
+
+void blobvec_destroy (struct blobvec *bv);
+
+/* Append an item.  Data is copied into the encode buffer.
+ * If errnum is nonzero, data and len are ignored.
+ */
+int blobvec_append (struct blobvec *bv, int errnum, const void *data, int len);
+int blobvec_append_flags (struct blobvec *bv, int errnum, int flags,
+                          const void *data, int len);
+
+/* Get the number of items.
+ */
+int blobvec_count (struct blobvec *bv);
+
+/* Get item at 'index'.  If the item was encoded with a nonzero errnum,
+ * return -1 with errno set to that value.  Blobref items may be fetched
+ * with blobvec_get_string(), which verifies NULL termination.
+ */
+int blobvec_get (struct blobvec *bv, int index, const void **data, int *len);
+int blobvec_get_string (struct blobvec *bv, int index, const char **s);
+
+/* Get flags of item at 'index'.  Flags are available for failed items too.
+ */
+int blobvec_get_flags (struct blobvec *bv, int index, int *flags);
+
+/* Get the encoded buffer (for blobvec_create() only).
+ */
+int blobvec_encode (struct blobvec *bv, const void **buf, int *len);
+
+#endif /* !_UTIL_BLOBVEC_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
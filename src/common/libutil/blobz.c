@@ -0,0 +1,104 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <lz4.h>
+
+#include "blobz.h"
+
+#define HEADER_SIZE     4
+
+int blobz_compress (const void *data, int len, void **zdata, int *zlen)
+{
+    uint32_t nsize;
+    char *buf;
+    int bound;
+    int r;
+
+    if (len < 0 || (len > 0 && !data) || !zdata || !zlen) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (len < BLOBZ_MIN_SIZE)
+        return 0;
+    bound = LZ4_compressBound (len);
+    if (bound <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(buf = malloc (HEADER_SIZE + bound))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    r = LZ4_compress_default (data, buf + HEADER_SIZE, len, bound);
+    if (r <= 0 || HEADER_SIZE + r >= len) {
+        free (buf);
+        return 0;
+    }
+    nsize = htonl (len);
+    memcpy (buf, &nsize, HEADER_SIZE);
+    *zdata = buf;
+    *zlen = HEADER_SIZE + r;
+    return 1;
+}
+
+int blobz_size (const void *zdata, int zlen)
+{
+    uint32_t nsize;
+    int size;
+
+    if (zlen < HEADER_SIZE || !zdata)
+        goto eproto;
+    memcpy (&nsize, zdata, HEADER_SIZE);
+    size = ntohl (nsize);
+    if (size < 0)
+        goto eproto;
+    return size;
+eproto:
+    errno = EPROTO;
+    return -1;
+}
+
+int blobz_decompress (const void *zdata, int zlen, void **data, int *len)
+{
+    int size;
+    char *buf;
+
+    if (!data || !len) {
+        errno = EINVAL;
+        return -1;
+    }
+    if ((size = blobz_size (zdata, zlen)) < 0)
+        return -1;
+    if (!(buf = malloc (size + 1))) { // +1 so size=0 is not NULL
+        errno = ENOMEM;
+        return -1;
+    }
+    if (LZ4_decompress_safe ((const char *)zdata + HEADER_SIZE, buf,
+                             zlen - HEADER_SIZE, size) != size) {
+        free (buf);
+        errno = EPROTO;
+        return -1;
+    }
+    *data = buf;
+    *len = size;
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
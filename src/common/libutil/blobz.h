@@ -0,0 +1,49 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _UTIL_BLOBZ_H
+#define _UTIL_BLOBZ_H
+
+/* blobz - compressed encoding of a content blob
+ *
+ * Used to move blobs over the content protocol and hold them in caches
+ * in compressed form.  The encoding is
+ *
+ *   [size:4][lz4 block]
+ *
+ * where size is the uncompressed size, in network byte order.  The blobref
+ * of a compressed blob is always that of its uncompressed data.
+ */
+
+/* Blobs smaller than this are not worth compressing.
+ */
+#define BLOBZ_MIN_SIZE  256
+
+/* Compress 'data' into a newly allocated buffer, returned in 'zdata'.
+ * Returns 1 on success, 0 if the blob is too small or compression would
+ * not make it smaller (zdata is not set), or -1 on error with errno set.
+ */
+int blobz_compress (const void *data, int len, void **zdata, int *zlen);
+
+/* Decompress 'zdata' into a newly allocated buffer, returned in 'data'.
+ * Returns 0 on success, -1 on error with errno set (EPROTO if 'zdata'
+ * is not a valid encoding).
+ */
+int blobz_decompress (const void *zdata, int zlen, void **data, int *len);
+
+/* Return the uncompressed size of 'zdata', or -1 with errno = EPROTO.
+ */
+int blobz_size (const void *zdata, int zlen);
+
+#endif /* !_UTIL_BLOBZ_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,284 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "blobref.h"
+#include "digestmap.h"
+
+#define MIN_CAPACITY    16
+
+struct slot {
+    void *item;                     /* NULL if slot is empty */
+    uint8_t len;
+    uint8_t digest[BLOBREF_MAX_DIGEST_SIZE];
+};
+
+struct digestmap {
+    struct slot *slots;
+    uint32_t capacity;              /* always a power of 2 */
+    uint32_t count;
+    uint32_t cursor;
+    digestmap_free_f freefn;
+};
+
+/* Digests are already uniformly distributed, so use the leading bytes
+ * directly.  Short keys (only expected in tests) are mixed with FNV-1a.
+ */
+static uint32_t digest_hash (const uint8_t *digest, int len)
+{
+    uint32_t h;
+
+    if (len >= sizeof (h)) {
+        memcpy (&h, digest, sizeof (h));
+    }
+    else {
+        int i;
+        h = 2166136261U;
+        for (i = 0; i < len; i++) {
+            h ^= digest[i];
+            h *= 16777619U;
+        }
+    }
+    return h;
+}
+
+static bool slot_match (const struct slot *s, const void *digest, int len)
+{
+    return (s->len == len && !memcmp (s->digest, digest, len));
+}
+
+static uint32_t slot_home (struct digestmap *m, const struct slot *s)
+{
+    return digest_hash (s->digest, s->len) & (m->capacity - 1);
+}
+
+/* Find the slot containing 'digest', or the empty slot where it would
+ * be inserted.
+ */
+static struct slot *find_slot (struct digestmap *m, const void *digest,
+                               int len)
+{
+    uint32_t mask = m->capacity - 1;
+    uint32_t i = digest_hash (digest, len) & mask;
+
+    while (m->slots[i].item && !slot_match (&m->slots[i], digest, len))
+        i = (i + 1) & mask;
+    return &m->slots[i];
+}
+
+static int resize (struct digestmap *m, uint32_t capacity)
+{
+    struct slot *old = m->slots;
+    uint32_t old_capacity = m->capacity;
+    uint32_t i;
+
+    if (!(m->slots = calloc (capacity, sizeof (m->slots[0])))) {
+        m->slots = old;
+        errno = ENOMEM;
+        return -1;
+    }
+    m->capacity = capacity;
+    for (i = 0; i < old_capacity; i++) {
+        if (old[i].item)
+            *find_slot (m, old[i].digest, old[i].len) = old[i];
+    }
+    free (old);
+    return 0;
+}
+
+struct digestmap *digestmap_create (void)
+{
+    struct digestmap *m;
+
+    if (!(m = calloc (1, sizeof (*m))))
+        goto nomem;
+    if (!(m->slots = calloc (MIN_CAPACITY, sizeof (m->slots[0]))))
+        goto nomem;
+    m->capacity = MIN_CAPACITY;
+    return m;
+nomem:
+    digestmap_destroy (m);
+    errno = ENOMEM;
+    return NULL;
+}
+
+void digestmap_destroy (struct digestmap *m)
+{
+    if (m) {
+        int saved_errno = errno;
+        uint32_t i;
+        if (m->freefn && m->slots) {
+            for (i = 0; i < m->capacity; i++) {
+                if (m->slots[i].item)
+                    m->freefn (m->slots[i].item);
+            }
+        }
+        free (m->slots);
+        free (m);
+        errno = saved_errno;
+    }
+}
+
+void digestmap_set_free_f (struct digestmap *m, digestmap_free_f fn)
+{
+    if (m)
+        m->freefn = fn;
+}
+
+int digestmap_size (struct digestmap *m)
+{
+    return m ? m->count : 0;
+}
+
+int digestmap_insert (struct digestmap *m, const void *digest, int len,
+                      void *item)
+{
+    struct slot *s;
+
+    if (!m || !digest || len <= 0 || len > BLOBREF_MAX_DIGEST_SIZE || !item) {
+        errno = EINVAL;
+        return -1;
+    }
+    /* Keep load factor at or below 0.75
+     */
+    if ((m->count + 1) * 4 > m->capacity * 3) {
+        if (resize (m, m->capacity * 2) < 0)
+            return -1;
+    }
+    s = find_slot (m, digest, len);
+    if (s->item) {
+        errno = EEXIST;
+        return -1;
+    }
+    s->item = item;
+    s->len = len;
+    memcpy (s->digest, digest, len);
+    m->count++;
+    return 0;
+}
+
+void *digestmap_lookup (struct digestmap *m, const void *digest, int len)
+{
+    if (!m || !digest || len <= 0 || len > BLOBREF_MAX_DIGEST_SIZE)
+        return NULL;
+    return find_slot (m, digest, len)->item;
+}
+
+/* Empty slot 'i' by shifting later members of its probe run back,
+ * so lookups never need tombstones.  A member at 'j' may fill the hole
+ * at 'i' unless its home slot lies cyclically within (i, j].
+ */
+static void remove_slot (struct digestmap *m, uint32_t i)
+{
+    uint32_t mask = m->capacity - 1;
+    uint32_t j = i;
+    uint32_t k;
+
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!m->slots[j].item)
+            break;
+        k = slot_home (m, &m->slots[j]);
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+        m->slots[i] = m->slots[j];
+        i = j;
+    }
+    m->slots[i].item = NULL;
+    m->count--;
+}
+
+int digestmap_delete (struct digestmap *m, const void *digest, int len)
+{
+    struct slot *s;
+    void *item;
+
+    if (!m || !digest || len <= 0 || len > BLOBREF_MAX_DIGEST_SIZE)
+        goto noent;
+    s = find_slot (m, digest, len);
+    if (!(item = s->item))
+        goto noent;
+    remove_slot (m, s - m->slots);
+    if (m->freefn)
+        m->freefn (item);
+    return 0;
+noent:
+    errno = ENOENT;
+    return -1;
+}
+
+/* Start the scan just past an empty slot (the load factor guarantees
+ * one exists).  Since no probe run wraps across it, remove_slot() only
+ * moves items that have not yet been visited back into the current slot,
+ * which is then tested again.
+ */
+int digestmap_delete_if (struct digestmap *m, digestmap_test_f fn, void *arg)
+{
+    uint32_t mask;
+    uint32_t start = 0;
+    uint32_t n = 1;
+    int count = 0;
+
+    if (!m || !fn || m->count == 0)
+        return 0;
+    mask = m->capacity - 1;
+    while (m->slots[start].item)
+        start++;
+    while (n < m->capacity) {
+        uint32_t i = (start + n) & mask;
+        void *item = m->slots[i].item;
+
+        if (item && fn (item, arg)) {
+            remove_slot (m, i);
+            if (m->freefn)
+                m->freefn (item);
+            count++;
+        }
+        else
+            n++;
+    }
+    return count;
+}
+
+static void *next_item (struct digestmap *m)
+{
+    while (m->cursor < m->capacity) {
+        void *item = m->slots[m->cursor++].item;
+        if (item)
+            return item;
+    }
+    return NULL;
+}
+
+void *digestmap_first (struct digestmap *m)
+{
+    if (!m)
+        return NULL;
+    m->cursor = 0;
+    return next_item (m);
+}
+
+void *digestmap_next (struct digestmap *m)
+{
+    if (!m)
+        return NULL;
+    return next_item (m);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,76 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _UTIL_DIGESTMAP_H
+#define _UTIL_DIGESTMAP_H
+
+/* digestmap - hash table keyed by raw hash digest
+ *
+ * Maps a digest of up to BLOBREF_MAX_DIGEST_SIZE bytes, e.g. as returned
+ * by blobref_strtohash(), to an item pointer.  Keys are copied into the
+ * table, which uses open addressing with linear probing, so there is no
+ * per-item allocation and a lookup touches one contiguous run of slots.
+ * Since digests are uniformly distributed, the digest itself is used as
+ * the hash value.
+ *
+ * Items are not owned by the table unless a free function is set.
+ */
+
+#include <stdbool.h>
+
+struct digestmap;
+
+typedef void (*digestmap_free_f)(void *item);
+typedef bool (*digestmap_test_f)(void *item, void *arg);
+
+struct digestmap *digestmap_create (void);
+void digestmap_destroy (struct digestmap *m);
+
+/* Set a function to be called on items when they are deleted, or when
+ * the table is destroyed.
+ */
+void digestmap_set_free_f (struct digestmap *m, digestmap_free_f fn);
+
+/* Return the number of items in the table.
+ */
+int digestmap_size (struct digestmap *m);
+
+/* Insert 'item' under 'digest' of 'len' bytes.  'item' may not be NULL.
+ * Returns 0 on success, -1 on failure with errno set.
+ * EEXIST if digest is already present.
+ */
+int digestmap_insert (struct digestmap *m, const void *digest, int len,
+                      void *item);
+
+/* Look up item by digest.  Returns NULL if not found (errno not set).
+ */
+void *digestmap_lookup (struct digestmap *m, const void *digest, int len);
+
+/* Delete item by digest, calling the free function if set.
+ * Returns 0 on success, -1 with errno = ENOENT if not found.
+ */
+int digestmap_delete (struct digestmap *m, const void *digest, int len);
+
+/* Delete every item for which fn (item, arg) returns true.
+ * Each item is tested exactly once.  'fn' must not modify the table.
+ * Returns the number of items deleted.
+ */
+int digestmap_delete_if (struct digestmap *m, digestmap_test_f fn, void *arg);
+
+/* Iterate over items.  The table must not be modified during iteration.
+ */
+void *digestmap_first (struct digestmap *m);
+void *digestmap_next (struct digestmap *m);
+
+#endif /* !_UTIL_DIGESTMAP_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
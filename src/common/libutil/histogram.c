@@ -0,0 +1,71 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <math.h>
+
+#include "histogram.h"
+
+void histogram_push (histogram_t *hist, double x)
+{
+    int i = 0;
+
+    if (x > 1) {
+        int exp;
+        double frac = frexp (x, &exp);
+        /* x = frac * 2^exp with frac in [0.5, 1), so x <= 2^exp,
+         * and x == 2^(exp-1) belongs in bucket exp-1.
+         */
+        i = (frac == 0.5) ? exp - 1 : exp;
+        if (i >= HISTOGRAM_BUCKETS)
+            i = HISTOGRAM_BUCKETS - 1;
+    }
+    hist->count[i]++;
+    hist->n++;
+}
+
+int histogram_count (histogram_t *hist)
+{
+    return hist->n;
+}
+
+int histogram_bucket_count (histogram_t *hist, int i)
+{
+    if (i < 0 || i >= HISTOGRAM_BUCKETS)
+        return 0;
+    return hist->count[i];
+}
+
+double histogram_bucket_max (int i)
+{
+    return ldexp (1., i);
+}
+
+double histogram_percentile (histogram_t *hist, double p)
+{
+    double rank = p * hist->n / 100.;
+    int sum = 0;
+    int i;
+
+    if (hist->n == 0)
+        return 0;
+    for (i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+        sum += hist->count[i];
+        if (sum >= rank)
+            break;
+    }
+    return histogram_bucket_max (i);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,44 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _UTIL_HISTOGRAM_H
+#define _UTIL_HISTOGRAM_H
+
+/* Histogram with power of two bucket boundaries.  Bucket 0 counts
+ * values <= 1, and bucket i counts values in (2^(i-1), 2^i].  Values
+ * beyond the last bucket are counted in it.  Initialize with memset 0.
+ */
+#define HISTOGRAM_BUCKETS 32
+
+typedef struct {
+    int count[HISTOGRAM_BUCKETS];
+    int n;
+} histogram_t;
+
+void histogram_push (histogram_t *hist, double x);
+int histogram_count (histogram_t *hist);
+
+/* Return the count of values in bucket 'i', or 0 if 'i' is out of range.
+ */
+int histogram_bucket_count (histogram_t *hist, int i);
+
+/* Return the upper bound of bucket 'i', i.e. 2^i.
+ */
+double histogram_bucket_max (int i);
+
+/* Return the upper bound of the bucket containing the p-th percentile
+ * (0 < p <= 100) of pushed values, or 0 if no values have been pushed.
+ */
+double histogram_percentile (histogram_t *hist, double p);
+
+#endif /* !_UTIL_HISTOGRAM_H */
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
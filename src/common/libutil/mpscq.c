@@ -0,0 +1,156 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* A linked list with a stub node, after Dmitry Vyukov's MPSC
+ * queue.  Producers swap themselves into 'head' with one atomic exchange,
+ * then link the previous node to the new one.  The consumer follows
+ * 'next' pointers from 'tail', which always points to a node whose item
+ * has already been taken (initially the stub), and frees it when moving on.
+ *
+ * 'count' is incremented by producers after linking and decremented by
+ * the consumer after popping, so only the producer whose increment takes
+ * it from zero signals the eventfd.  It may go briefly negative if the
+ * consumer pops an item before its producer has counted it.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+#include "mpscq.h"
+
+struct node {
+    struct node *next;
+    void *item;
+};
+
+struct mpscq {
+    struct node *head;      /* producers */
+    long count;
+    struct node *tail;      /* consumer */
+    int efd;
+};
+
+static struct node *node_create (void *item)
+{
+    struct node *n;
+
+    if (!(n = malloc (sizeof (*n)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    n->next = NULL;
+    n->item = item;
+    return n;
+}
+
+struct mpscq *mpscq_create (void)
+{
+    struct mpscq *q;
+
+    if (!(q = calloc (1, sizeof (*q)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    q->efd = -1;
+    if (!(q->tail = node_create (NULL)))
+        goto error;
+    q->head = q->tail;
+    if ((q->efd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        goto error;
+    return q;
+error:
+    mpscq_destroy (q, NULL);
+    return NULL;
+}
+
+void mpscq_destroy (struct mpscq *q, mpscq_free_f free_fn)
+{
+    if (q) {
+        int saved_errno = errno;
+        void *item;
+
+        if (q->tail) {
+            while ((item = mpscq_pop (q))) {
+                if (free_fn)
+                    free_fn (item);
+            }
+            free (q->tail);
+        }
+        if (q->efd >= 0)
+            (void)close (q->efd);
+        free (q);
+        errno = saved_errno;
+    }
+}
+
+int mpscq_push (struct mpscq *q, void *item)
+{
+    struct node *n;
+    struct node *prev;
+
+    if (!q || !item) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(n = node_create (item)))
+        return -1;
+    prev = __atomic_exchange_n (&q->head, n, __ATOMIC_ACQ_REL);
+    __atomic_store_n (&prev->next, n, __ATOMIC_RELEASE);
+    if (__atomic_fetch_add (&q->count, 1, __ATOMIC_SEQ_CST) == 0) {
+        uint64_t val = 1;
+        (void)write (q->efd, &val, sizeof (val));
+    }
+    return 0;
+}
+
+void *mpscq_pop (struct mpscq *q)
+{
+    struct node *tail = q->tail;
+    struct node *next = __atomic_load_n (&tail->next, __ATOMIC_ACQUIRE);
+    void *item;
+
+    if (!next) {
+        errno = EAGAIN;
+        return NULL;
+    }
+    item = next->item;
+    next->item = NULL;
+    q->tail = next;
+    free (tail);
+    __atomic_sub_fetch (&q->count, 1, __ATOMIC_SEQ_CST);
+    return item;
+}
+
+/* Reset the eventfd before the final check so that a push racing with
+ * this call is either counted here, or signals after the reset.
+ */
+bool mpscq_pending (struct mpscq *q)
+{
+    if (__atomic_load_n (&q->count, __ATOMIC_SEQ_CST) > 0)
+        return true;
+    uint64_t val;
+    (void)read (q->efd, &val, sizeof (val));
+    return __atomic_load_n (&q->count, __ATOMIC_SEQ_CST) > 0;
+}
+
+int mpscq_get_fd (struct mpscq *q)
+{
+    return q->efd;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,64 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _UTIL_MPSCQ_H
+#define _UTIL_MPSCQ_H 1
+
+#include <stdbool.h>
+
+/*
+ *  mpscq: lock-free, multiple producer, single consumer queue of pointers
+ *  for passing items between threads of one process.
+ *
+ *  The consumer may sleep by polling mpscq_get_fd(), which becomes
+ *  readable when an item is pushed onto an empty queue.  Once the consumer
+ *  has found the queue empty with mpscq_pending(), the fd remains quiet
+ *  until the next push, so a busy queue costs no system calls.
+ */
+
+typedef void (*mpscq_free_f)(void *item);
+
+struct mpscq;
+
+/*  Create a queue.  Returns queue on success, NULL with errno set on error.
+ */
+struct mpscq *mpscq_create (void);
+
+/*  Destroy the queue, calling 'free_fn' (if non-NULL) on items remaining.
+ */
+void mpscq_destroy (struct mpscq *q, mpscq_free_f free_fn);
+
+/*  Producer (any thread): append 'item', which must not be NULL.
+ *  Returns 0 on success, -1 with errno = EINVAL or ENOMEM on error.
+ */
+int mpscq_push (struct mpscq *q, void *item);
+
+/*  Consumer: remove the oldest item.
+ *  Returns item, or NULL with errno = EAGAIN if none is available.
+ */
+void *mpscq_pop (struct mpscq *q);
+
+/*  Consumer: return true if items are queued.  If the queue is empty,
+ *  the fd is reset so that it becomes readable on the next push.
+ *  N.B. a push that is still in progress in another thread may cause a
+ *  brief interval where this returns true but mpscq_pop() fails.
+ */
+bool mpscq_pending (struct mpscq *q);
+
+/*  Consumer: return an fd that is readable when mpscq_pending() should
+ *  be called.
+ */
+int mpscq_get_fd (struct mpscq *q);
+
+#endif /* !_UTIL_MPSCQ_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,428 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* Memory layout: a control block, then 'capacity' bytes of records.
+ *
+ * The producer owns 'tail' and the consumer owns 'head', which are free
+ * running byte counts, each on its own cache line.  A record is an 8 byte
+ * header followed by its data, padded to a multiple of 8 bytes, and never
+ * wraps: if it does not fit before the end of the ring, a padding record
+ * fills the remainder and the record starts at the beginning.
+ *
+ * The waiting flags implement sleep/wakeup without lost wakeups: the
+ * sleeper sets its flag and then re-checks the ring, while the peer
+ * updates the ring and then checks the flag, with a full barrier between
+ * each store and load, so at least one of them sees the other's store.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "shmring.h"
+
+#define SHMRING_MAGIC       0x53484d52  /* "SHMR" */
+#define CACHELINE_SIZE      64
+
+#define CAPACITY_MIN        4096
+#define CAPACITY_MAX        (1UL << 30)
+
+struct shmring_ctl {
+    uint32_t magic;
+    uint32_t capacity;
+    uint8_t pad0[CACHELINE_SIZE - 8];
+    uint64_t tail;                  /* written by producer */
+    uint32_t producer_waiting;
+    uint8_t pad1[CACHELINE_SIZE - 12];
+    uint64_t head;                  /* written by consumer */
+    uint32_t consumer_waiting;
+    uint8_t pad2[CACHELINE_SIZE - 12];
+};
+
+struct rec {
+    uint32_t size;
+    uint32_t flags;
+};
+
+#define REC_MORE            1       /* fragment, more follow */
+#define REC_PAD             2       /* padding to end of ring */
+
+#define REC_TOTAL(size)     ((sizeof (struct rec) + (size) + 7) & ~(size_t)7)
+
+struct shmring {
+    struct shmring_ctl *ctl;
+    uint8_t *data;
+    size_t capacity;
+
+    /* producer */
+    uint64_t tail;
+    size_t resv_size;
+    size_t resv_total;              /* 0 if nothing is reserved */
+    size_t resv_pad;
+    uint32_t resv_flags;
+
+    /* consumer */
+    uint64_t head;
+    size_t peek_total;              /* advance on consume, if nonzero */
+    uint8_t *rbuf;                  /* fragment reassembly */
+    size_t rbuf_size;
+    size_t rbuf_len;
+    size_t rbuf_limit;
+    bool rbuf_ready;
+};
+
+static bool valid_capacity (size_t capacity)
+{
+    return capacity >= CAPACITY_MIN && capacity <= CAPACITY_MAX
+                                    && (capacity & (capacity - 1)) == 0;
+}
+
+size_t shmring_memsize (size_t capacity)
+{
+    return sizeof (struct shmring_ctl) + capacity;
+}
+
+int shmring_init (void *mem, size_t capacity)
+{
+    struct shmring_ctl *ctl = mem;
+
+    if (!mem || !valid_capacity (capacity)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset (ctl, 0, sizeof (*ctl));
+    ctl->magic = SHMRING_MAGIC;
+    ctl->capacity = capacity;
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    return 0;
+}
+
+struct shmring *shmring_attach (void *mem, size_t size, size_t capacity)
+{
+    struct shmring_ctl *ctl = mem;
+    struct shmring *r;
+
+    if (!mem || size < sizeof (*ctl)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (capacity == 0)
+        capacity = ctl->capacity;
+    if (!valid_capacity (capacity)
+                || ctl->magic != SHMRING_MAGIC
+                || ctl->capacity != capacity
+                || shmring_memsize (capacity) > size) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(r = calloc (1, sizeof (*r)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    r->ctl = ctl;
+    r->data = (uint8_t *)mem + sizeof (*ctl);
+    r->capacity = capacity;
+    r->rbuf_limit = SHMRING_RECORD_LIMIT;
+    r->head = __atomic_load_n (&ctl->head, __ATOMIC_ACQUIRE);
+    r->tail = __atomic_load_n (&ctl->tail, __ATOMIC_ACQUIRE);
+    if (r->tail - r->head > capacity) {
+        shmring_detach (r);
+        errno = EINVAL;
+        return NULL;
+    }
+    return r;
+}
+
+void shmring_detach (struct shmring *r)
+{
+    if (r) {
+        int saved_errno = errno;
+        free (r->rbuf);
+        free (r);
+        errno = saved_errno;
+    }
+}
+
+size_t shmring_record_max (struct shmring *r)
+{
+    return r->capacity / 4;
+}
+
+/* Compute the space needed to add a record of 'total' bytes at the tail,
+ * and the padding that precedes it, if any.
+ * Returns 0 if it fits, -1 with errno set if not.
+ */
+static int producer_fit (struct shmring *r, size_t total, size_t *padp)
+{
+    uint64_t head = __atomic_load_n (&r->ctl->head, __ATOMIC_ACQUIRE);
+    size_t used = r->tail - head;
+    size_t to_end = r->capacity - (r->tail & (r->capacity - 1));
+    size_t pad = total > to_end ? to_end : 0;
+
+    if (used > r->capacity) {
+        errno = EPROTO;
+        return -1;
+    }
+    if (r->capacity - used < pad + total) {
+        errno = EAGAIN;
+        return -1;
+    }
+    *padp = pad;
+    return 0;
+}
+
+static void *reserve (struct shmring *r, size_t size, uint32_t flags)
+{
+    size_t total = REC_TOTAL (size);
+    size_t pad;
+
+    if (size > shmring_record_max (r)) {
+        errno = EMSGSIZE;
+        return NULL;
+    }
+    if (producer_fit (r, total, &pad) < 0)
+        return NULL;
+    r->resv_size = size;
+    r->resv_total = total;
+    r->resv_pad = pad;
+    r->resv_flags = flags;
+    if (pad)
+        return r->data + sizeof (struct rec);
+    return r->data + (r->tail & (r->capacity - 1)) + sizeof (struct rec);
+}
+
+void *shmring_reserve (struct shmring *r, size_t size)
+{
+    if (!r) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return reserve (r, size, 0);
+}
+
+void shmring_commit (struct shmring *r)
+{
+    size_t off;
+    struct rec *rec;
+
+    if (!r || r->resv_total == 0)
+        return;
+    off = r->tail & (r->capacity - 1);
+    if (r->resv_pad) {
+        rec = (struct rec *)(r->data + off);
+        rec->size = r->resv_pad - sizeof (*rec);
+        rec->flags = REC_PAD;
+        off = 0;
+    }
+    rec = (struct rec *)(r->data + off);
+    rec->size = r->resv_size;
+    rec->flags = r->resv_flags;
+    r->tail += r->resv_pad + r->resv_total;
+    __atomic_store_n (&r->ctl->tail, r->tail, __ATOMIC_RELEASE);
+    r->resv_total = 0;
+}
+
+int shmring_write (struct shmring *r, const void *buf, size_t size,
+                   size_t *offset)
+{
+    if (!r || (!buf && size > 0) || !offset || *offset > size) {
+        errno = EINVAL;
+        return -1;
+    }
+    do {
+        size_t n = size - *offset;
+        uint32_t flags = 0;
+        void *p;
+
+        if (n > shmring_record_max (r)) {
+            n = shmring_record_max (r);
+            flags = REC_MORE;
+        }
+        if (!(p = reserve (r, n, flags)))
+            return -1;
+        memcpy (p, (const uint8_t *)buf + *offset, n);
+        shmring_commit (r);
+        *offset += n;
+    } while (*offset < size);
+    return 0;
+}
+
+/* Find the record at the head, skipping padding.  The header is copied
+ * out of shared memory once, then validated.
+ */
+static void *consumer_next (struct shmring *r, struct rec *rec, size_t *totalp)
+{
+    for (;;) {
+        uint64_t tail = __atomic_load_n (&r->ctl->tail, __ATOMIC_ACQUIRE);
+        size_t avail = tail - r->head;
+        size_t off = r->head & (r->capacity - 1);
+        size_t to_end = r->capacity - off;
+        size_t total;
+
+        if (avail == 0) {
+            errno = EAGAIN;
+            return NULL;
+        }
+        if (avail > r->capacity || avail < sizeof (*rec))
+            goto eproto;
+        memcpy (rec, r->data + off, sizeof (*rec));
+        if ((rec->flags & REC_PAD)) {
+            if ((size_t)rec->size + sizeof (*rec) != to_end || avail < to_end)
+                goto eproto;
+            r->head += to_end;
+            continue;
+        }
+        total = REC_TOTAL ((size_t)rec->size);
+        if (total > to_end || total > avail)
+            goto eproto;
+        *totalp = total;
+        return r->data + off + sizeof (*rec);
+    }
+eproto:
+    errno = EPROTO;
+    return NULL;
+}
+
+static int rbuf_append (struct shmring *r, const void *data, size_t size)
+{
+    if (r->rbuf_len > r->rbuf_limit || size > r->rbuf_limit - r->rbuf_len) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (r->rbuf_len + size > r->rbuf_size) {
+        size_t newsize = r->rbuf_size ? r->rbuf_size : shmring_record_max (r);
+        uint8_t *newbuf;
+
+        while (newsize < r->rbuf_len + size)
+            newsize *= 2;
+        if (newsize > r->rbuf_limit)
+            newsize = r->rbuf_limit;
+        if (!(newbuf = realloc (r->rbuf, newsize))) {
+            errno = ENOMEM;
+            return -1;
+        }
+        r->rbuf = newbuf;
+        r->rbuf_size = newsize;
+    }
+    memcpy (r->rbuf + r->rbuf_len, data, size);
+    r->rbuf_len += size;
+    return 0;
+}
+
+const void *shmring_peek (struct shmring *r, size_t *size)
+{
+    struct rec rec;
+    size_t total;
+    void *p;
+
+    if (!r || !size) {
+        errno = EINVAL;
+        return NULL;
+    }
+    for (;;) {
+        if (r->rbuf_ready) {
+            *size = r->rbuf_len;
+            return r->rbuf;
+        }
+        if (!(p = consumer_next (r, &rec, &total)))
+            return NULL;
+        if (!(rec.flags & REC_MORE) && r->rbuf_len == 0) {
+            r->peek_total = total;
+            *size = rec.size;
+            return p;
+        }
+        /* Fragments are consumed as they are reassembled, so that the
+         * producer can continue.
+         */
+        if (rbuf_append (r, p, rec.size) < 0)
+            return NULL;
+        r->head += total;
+        __atomic_store_n (&r->ctl->head, r->head, __ATOMIC_RELEASE);
+        if (!(rec.flags & REC_MORE))
+            r->rbuf_ready = true;
+    }
+}
+
+void shmring_set_record_limit (struct shmring *r, size_t limit)
+{
+    if (r)
+        r->rbuf_limit = limit;
+}
+
+void shmring_consume (struct shmring *r)
+{
+    if (!r)
+        return;
+    if (r->rbuf_ready) {
+        r->rbuf_ready = false;
+        r->rbuf_len = 0;
+    }
+    else if (r->peek_total) {
+        r->head += r->peek_total;
+        r->peek_total = 0;
+        __atomic_store_n (&r->ctl->head, r->head, __ATOMIC_RELEASE);
+    }
+}
+
+bool shmring_wait_readable (struct shmring *r)
+{
+    uint64_t tail;
+
+    if (r->rbuf_ready)
+        return false;
+    __atomic_store_n (&r->ctl->consumer_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    tail = __atomic_load_n (&r->ctl->tail, __ATOMIC_ACQUIRE);
+    if (tail != r->head) {
+        __atomic_store_n (&r->ctl->consumer_waiting, 0, __ATOMIC_RELAXED);
+        return false;
+    }
+    return true;
+}
+
+bool shmring_wait_writable (struct shmring *r, size_t size)
+{
+    size_t pad;
+
+    if (size > shmring_record_max (r))
+        size = shmring_record_max (r);
+    __atomic_store_n (&r->ctl->producer_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    if (producer_fit (r, REC_TOTAL (size), &pad) < 0 && errno == EAGAIN)
+        return true;
+    __atomic_store_n (&r->ctl->producer_waiting, 0, __ATOMIC_RELAXED);
+    return false;
+}
+
+static bool wake (uint32_t *waiting)
+{
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    if (__atomic_load_n (waiting, __ATOMIC_RELAXED) == 0)
+        return false;
+    return __atomic_exchange_n (waiting, 0, __ATOMIC_RELAXED) != 0;
+}
+
+bool shmring_wake_consumer (struct shmring *r)
+{
+    return wake (&r->ctl->consumer_waiting);
+}
+
+bool shmring_wake_producer (struct shmring *r)
+{
+    return wake (&r->ctl->producer_waiting);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
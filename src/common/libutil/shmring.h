@@ -0,0 +1,115 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _UTIL_SHMRING_H
+#define _UTIL_SHMRING_H 1
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ *  shmring: lock-free, single producer, single consumer ring of
+ *  variable size records, in memory that may be shared between processes.
+ *
+ *  Each side keeps its own position privately and only reads the other's
+ *  from shared memory, which is validated, so a misbehaving peer cannot
+ *  cause the other side to access memory outside the ring.
+ *
+ *  Neither side blocks.  To sleep, a side announces it is waiting with
+ *  shmring_wait_readable() or shmring_wait_writable(), and the peer learns
+ *  from shmring_wake_consumer() or shmring_wake_producer() that it must
+ *  be woken, e.g. by writing to an eventfd the sleeper is polling.
+ */
+
+struct shmring;
+
+/*  Return the size of memory needed for a ring with 'capacity' bytes of
+ *  record space.  'capacity' must be a power of two, at least 4096.
+ */
+size_t shmring_memsize (size_t capacity);
+
+/*  Initialize a ring at 'mem', which must be shmring_memsize (capacity)
+ *  bytes and aligned to a cache line.
+ *  Returns 0 on success, -1 with errno = EINVAL on error.
+ */
+int shmring_init (void *mem, size_t capacity);
+
+/*  Access the ring at 'mem' of 'size' bytes, as initialized with
+ *  shmring_init() (by either side).  If 'capacity' is nonzero, the ring
+ *  must have that capacity, otherwise it is read from shared memory.
+ *  Returns handle on success, NULL with errno set on error.
+ */
+struct shmring *shmring_attach (void *mem, size_t size, size_t capacity);
+void shmring_detach (struct shmring *r);
+
+/*  Producer: reserve contiguous space for a record of 'size' bytes,
+ *  which must not exceed shmring_record_max().  Fill it, then make it
+ *  visible to the consumer with shmring_commit().
+ *  Returns pointer to record, or NULL with errno = EAGAIN if the ring is
+ *  too full, EMSGSIZE if 'size' is too large, or EPROTO if the consumer
+ *  has corrupted the ring.
+ */
+void *shmring_reserve (struct shmring *r, size_t size);
+void shmring_commit (struct shmring *r);
+size_t shmring_record_max (struct shmring *r);
+
+/*  Producer: write 'size' bytes from 'buf' as one record of any size,
+ *  which is split into fragments no larger than shmring_record_max().
+ *  If the ring fills up, fails with errno = EAGAIN, with '*offset'
+ *  updated to record what has been written.  Call again with the same
+ *  arguments to continue.  '*offset' must be zero initially.
+ *  Returns 0 once the record is written, -1 with errno set on error.
+ */
+int shmring_write (struct shmring *r, const void *buf, size_t size,
+                   size_t *offset);
+
+/*  Consumer: return the next record and set 'size' to its length.
+ *  A fragmented record is reassembled into a private buffer.
+ *  The record remains valid until shmring_consume().
+ *  Returns NULL with errno = EAGAIN if no complete record is available,
+ *  EPROTO if the producer has corrupted the ring, EMSGSIZE if the record
+ *  exceeds the reassembly limit, or ENOMEM.
+ */
+const void *shmring_peek (struct shmring *r, size_t *size);
+void shmring_consume (struct shmring *r);
+
+/*  Consumer: limit the size of a record reassembled from fragments, so
+ *  that a producer cannot make the consumer allocate without bound.
+ *  shmring_peek() fails with errno = EMSGSIZE on a larger record.
+ *  The default limit is SHMRING_RECORD_LIMIT.
+ */
+#define SHMRING_RECORD_LIMIT (1UL << 30)
+void shmring_set_record_limit (struct shmring *r, size_t limit);
+
+/*  Consumer: announce intent to sleep until the ring is readable.
+ *  Returns true if the ring is still empty, so the caller may sleep,
+ *  false if a record has arrived.
+ */
+bool shmring_wait_readable (struct shmring *r);
+
+/*  Producer: announce intent to sleep until a record of 'size' bytes
+ *  can be reserved.  Returns true if the caller may sleep.
+ */
+bool shmring_wait_writable (struct shmring *r, size_t size);
+
+/*  Producer, after shmring_commit() or shmring_write(), including one
+ *  that failed with EAGAIN: return true if the consumer is waiting and
+ *  must be woken.  Consumer, after shmring_consume() or shmring_peek(),
+ *  which consumes fragments as it reassembles them: return true if the
+ *  producer is waiting for space and must be woken.
+ */
+bool shmring_wake_consumer (struct shmring *r);
+bool shmring_wake_producer (struct shmring *r);
+
+#endif /* !_UTIL_SHMRING_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,105 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#include <string.h>
+#include <errno.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libutil/blobvec.h"
+
+int main (int argc, char *argv[])
+{
+    struct blobvec *bv, *dv;
+    const void *buf;
+    int len;
+    const void *data;
+    int data_len;
+    const char *s;
+    int flags;
+    char big[8192];
+
+    plan (NO_PLAN);
+
+    memset (big, 'x', sizeof (big));
+
+    ok ((bv = blobvec_create ()) != NULL,
+        "blobvec_create works");
+    ok (blobvec_count (bv) == 0,
+        "blobvec_count returns 0 on empty blobvec");
+    ok (blobvec_encode (bv, &buf, &len) == 0 && len == 0,
+        "blobvec_encode of empty blobvec has zero length");
+
+    ok (blobvec_append (bv, 0, "sha1-abc", 9) == 0,
+        "blobvec_append string works");
+    ok (blobvec_append (bv, ENOENT, NULL, 0) == 0,
+        "blobvec_append errnum=ENOENT works");
+    ok (blobvec_append (bv, 0, NULL, 0) == 0,
+        "blobvec_append empty blob works");
+    ok (blobvec_append_flags (bv, 0, BLOBVEC_FLAG_COMPRESSED,
+                              big, sizeof (big)) == 0,
+        "blobvec_append_flags 8K blob works (forces buffer growth)");
+    ok (blobvec_count (bv) == 4,
+        "blobvec_count returns 4");
+    ok (blobvec_encode (bv, &buf, &len) == 0
+        && len == 4*12 + 9 + sizeof (big),
+        "blobvec_encode returns expected length");
+
+    ok ((dv = blobvec_decode (buf, len)) != NULL,
+        "blobvec_decode works");
+    ok (blobvec_count (dv) == 4,
+        "decoded blobvec has 4 items");
+    ok (blobvec_get_string (dv, 0, &s) == 0 && !strcmp (s, "sha1-abc"),
+        "blobvec_get_string 0 returns original string");
+    errno = 0;
+    ok (blobvec_get (dv, 1, &data, &data_len) < 0 && errno == ENOENT,
+        "blobvec_get 1 fails with encoded errno");
+    ok (blobvec_get (dv, 2, &data, &data_len) == 0
+        && data == NULL && data_len == 0,
+        "blobvec_get 2 returns empty blob");
+    errno = 0;
+    ok (blobvec_get_string (dv, 2, &s) < 0 && errno == EPROTO,
+        "blobvec_get_string 2 fails with EPROTO");
+    ok (blobvec_get (dv, 3, &data, &data_len) == 0
+        && data_len == sizeof (big) && !memcmp (data, big, sizeof (big)),
+        "blobvec_get 3 returns 8K blob");
+    ok (blobvec_get_flags (dv, 3, &flags) == 0
+        && flags == BLOBVEC_FLAG_COMPRESSED,
+        "blobvec_get_flags 3 returns encoded flags");
+    ok (blobvec_get_flags (dv, 0, &flags) == 0 && flags == 0,
+        "blobvec_get_flags 0 returns 0 for item appended without flags");
+    errno = 0;
+    ok (blobvec_get_flags (dv, 4, &flags) < 0 && errno == EINVAL,
+        "blobvec_get_flags out of range fails with EINVAL");
+    errno = 0;
+    ok (blobvec_get (dv, 4, &data, &data_len) < 0 && errno == EINVAL,
+        "blobvec_get out of range fails with EINVAL");
+    errno = 0;
+    ok (blobvec_encode (dv, &buf, &len) < 0 && errno == EINVAL,
+        "blobvec_encode on decoded blobvec fails with EINVAL");
+    blobvec_destroy (dv);
+
+    errno = 0;
+    ok (blobvec_decode (buf, 7) == NULL && errno == EPROTO,
+        "blobvec_decode fails with EPROTO on truncated header");
+    errno = 0;
+    ok (blobvec_decode (buf, 16) == NULL && errno == EPROTO,
+        "blobvec_decode fails with EPROTO on truncated data");
+    errno = 0;
+    ok (blobvec_append (bv, 0, NULL, 1) < 0 && errno == EINVAL,
+        "blobvec_append data=NULL len=1 fails with EINVAL");
+    blobvec_destroy (bv);
+
+    done_testing ();
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
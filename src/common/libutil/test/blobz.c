@@ -0,0 +1,112 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libutil/blobz.h"
+
+void test_roundtrip (void)
+{
+    char data[8192];
+    void *zdata, *udata;
+    int zlen, ulen;
+    int i;
+
+    for (i = 0; i < sizeof (data); i++)
+        data[i] = "flux"[i % 4];
+
+    ok (blobz_compress (data, sizeof (data), &zdata, &zlen) == 1,
+        "blobz_compress of compressible 8K blob works");
+    ok (zlen < sizeof (data),
+        "compressed size %d is smaller than %d", zlen, (int)sizeof (data));
+    ok (blobz_size (zdata, zlen) == sizeof (data),
+        "blobz_size returns uncompressed size");
+    ok (blobz_decompress (zdata, zlen, &udata, &ulen) == 0,
+        "blobz_decompress works");
+    ok (ulen == sizeof (data) && memcmp (udata, data, ulen) == 0,
+        "decompressed data matches original");
+    free (udata);
+
+    errno = 0;
+    ok (blobz_decompress (zdata, zlen - 1, &udata, &ulen) < 0
+        && errno == EPROTO,
+        "blobz_decompress of truncated encoding fails with EPROTO");
+    ((char *)zdata)[3]++;
+    errno = 0;
+    ok (blobz_decompress (zdata, zlen, &udata, &ulen) < 0
+        && errno == EPROTO,
+        "blobz_decompress with wrong size header fails with EPROTO");
+    free (zdata);
+}
+
+void test_skip (void)
+{
+    char small[BLOBZ_MIN_SIZE - 1];
+    char noise[4096];
+    void *zdata = NULL;
+    int zlen;
+    unsigned int seed = 42;
+    int i;
+
+    memset (small, 0, sizeof (small));
+    ok (blobz_compress (small, sizeof (small), &zdata, &zlen) == 0
+        && zdata == NULL,
+        "blobz_compress skips blob smaller than BLOBZ_MIN_SIZE");
+
+    for (i = 0; i < sizeof (noise); i++)
+        noise[i] = rand_r (&seed);
+    ok (blobz_compress (noise, sizeof (noise), &zdata, &zlen) == 0
+        && zdata == NULL,
+        "blobz_compress skips incompressible blob");
+}
+
+void test_inval (void)
+{
+    char buf[512];
+    void *p;
+    int len;
+
+    memset (buf, 0, sizeof (buf));
+    errno = 0;
+    ok (blobz_compress (NULL, sizeof (buf), &p, &len) < 0 && errno == EINVAL,
+        "blobz_compress data=NULL fails with EINVAL");
+    errno = 0;
+    ok (blobz_compress (buf, sizeof (buf), NULL, &len) < 0 && errno == EINVAL,
+        "blobz_compress zdata=NULL fails with EINVAL");
+    errno = 0;
+    ok (blobz_decompress (buf, sizeof (buf), NULL, &len) < 0
+        && errno == EINVAL,
+        "blobz_decompress data=NULL fails with EINVAL");
+    errno = 0;
+    ok (blobz_size (buf, 3) < 0 && errno == EPROTO,
+        "blobz_size of short buffer fails with EPROTO");
+    errno = 0;
+    ok (blobz_decompress (buf, 3, &p, &len) < 0 && errno == EPROTO,
+        "blobz_decompress of short buffer fails with EPROTO");
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    test_roundtrip ();
+    test_skip ();
+    test_inval ();
+
+    done_testing ();
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,210 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libutil/blobref.h"
+#include "src/common/libutil/digestmap.h"
+
+struct item {
+    uint8_t digest[BLOBREF_MAX_DIGEST_SIZE];
+    int len;
+    int n;
+};
+
+static int freed;
+
+static void item_free (void *arg)
+{
+    freed++;
+    free (arg);
+}
+
+static bool item_is_odd (void *arg, void *unused)
+{
+    struct item *item = arg;
+    return (item->n % 2 == 1);
+}
+
+static struct item *item_create (int n, const char *hashtype)
+{
+    struct item *item;
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+
+    if (!(item = calloc (1, sizeof (*item)))
+        || blobref_hash (hashtype, &n, sizeof (n), blobref,
+                         sizeof (blobref)) < 0
+        || (item->len = blobref_strtohash (blobref, item->digest,
+                                           sizeof (item->digest))) < 0)
+        BAIL_OUT ("could not create test item");
+    item->n = n;
+    return item;
+}
+
+void test_basic (void)
+{
+    struct digestmap *m;
+    struct item *a, *b;
+    uint8_t short_key[3] = { 1, 2, 3 };
+
+    ok ((m = digestmap_create ()) != NULL,
+        "digestmap_create works");
+    ok (digestmap_size (m) == 0,
+        "digestmap_size is 0 on empty map");
+    ok (digestmap_first (m) == NULL,
+        "digestmap_first returns NULL on empty map");
+
+    a = item_create (1, "sha1");
+    b = item_create (1, "sha256");
+    ok (digestmap_insert (m, a->digest, a->len, a) == 0,
+        "digestmap_insert sha1 digest works");
+    ok (digestmap_insert (m, b->digest, b->len, b) == 0,
+        "digestmap_insert sha256 digest works");
+    ok (digestmap_size (m) == 2,
+        "digestmap_size is 2");
+    errno = 0;
+    ok (digestmap_insert (m, a->digest, a->len, a) < 0 && errno == EEXIST,
+        "digestmap_insert of duplicate fails with EEXIST");
+    ok (digestmap_lookup (m, a->digest, a->len) == a,
+        "digestmap_lookup finds sha1 item");
+    ok (digestmap_lookup (m, b->digest, b->len) == b,
+        "digestmap_lookup finds sha256 item");
+    ok (digestmap_lookup (m, b->digest, a->len) == NULL,
+        "digestmap_lookup with matching prefix but wrong length fails");
+    ok (digestmap_insert (m, short_key, sizeof (short_key), a) == 0
+        && digestmap_lookup (m, short_key, sizeof (short_key)) == a,
+        "short keys work");
+    ok (digestmap_delete (m, short_key, sizeof (short_key)) == 0,
+        "digestmap_delete short key works");
+
+    ok (digestmap_delete (m, a->digest, a->len) == 0,
+        "digestmap_delete works");
+    ok (digestmap_lookup (m, a->digest, a->len) == NULL,
+        "digestmap_lookup fails after delete");
+    errno = 0;
+    ok (digestmap_delete (m, a->digest, a->len) < 0 && errno == ENOENT,
+        "digestmap_delete of missing item fails with ENOENT");
+    ok (digestmap_first (m) == b && digestmap_next (m) == NULL,
+        "iteration returns remaining item");
+
+    errno = 0;
+    ok (digestmap_insert (m, NULL, 20, a) < 0 && errno == EINVAL,
+        "digestmap_insert digest=NULL fails with EINVAL");
+    errno = 0;
+    ok (digestmap_insert (m, a->digest, BLOBREF_MAX_DIGEST_SIZE + 1, a) < 0
+        && errno == EINVAL,
+        "digestmap_insert with oversized digest fails with EINVAL");
+    errno = 0;
+    ok (digestmap_insert (m, a->digest, a->len, NULL) < 0 && errno == EINVAL,
+        "digestmap_insert item=NULL fails with EINVAL");
+
+    free (a);
+    free (b);
+    digestmap_destroy (m);
+}
+
+void test_many (void)
+{
+    struct digestmap *m;
+    struct item **items;
+    const int count = 10000;
+    int i, n, errors, deleted;
+    struct item *item;
+
+    if (!(m = digestmap_create ()))
+        BAIL_OUT ("digestmap_create failed");
+    digestmap_set_free_f (m, item_free);
+    if (!(items = calloc (count, sizeof (items[0]))))
+        BAIL_OUT ("out of memory");
+
+    errors = 0;
+    for (i = 0; i < count; i++) {
+        items[i] = item_create (i, "sha1");
+        if (digestmap_insert (m, items[i]->digest, items[i]->len,
+                              items[i]) < 0)
+            errors++;
+    }
+    ok (errors == 0 && digestmap_size (m) == count,
+        "inserted %d items (forces growth)", count);
+
+    errors = 0;
+    for (i = 0; i < count; i++) {
+        if (digestmap_lookup (m, items[i]->digest, items[i]->len) != items[i])
+            errors++;
+    }
+    ok (errors == 0,
+        "all items found by lookup");
+
+    n = 0;
+    for (item = digestmap_first (m); item; item = digestmap_next (m))
+        n++;
+    ok (n == count,
+        "iteration visits all items");
+
+    /* Delete every third item to exercise backward shift deletion.
+     */
+    errors = 0;
+    for (i = 0; i < count; i += 3) {
+        if (digestmap_delete (m, items[i]->digest, items[i]->len) < 0)
+            errors++;
+        items[i] = NULL;
+    }
+    ok (errors == 0 && freed == (count + 2) / 3,
+        "deleted every third item, calling free function");
+    errors = 0;
+    for (i = 0; i < count; i++) {
+        if (items[i] && digestmap_lookup (m, items[i]->digest,
+                                          items[i]->len) != items[i])
+            errors++;
+    }
+    ok (errors == 0,
+        "remaining items are still found after deletes");
+
+    n = digestmap_size (m);
+    freed = 0;
+    deleted = digestmap_delete_if (m, item_is_odd, NULL);
+    ok (deleted == freed && deleted > 0,
+        "digestmap_delete_if deleted %d odd items", deleted);
+    errors = 0;
+    for (i = 0; i < count; i++) {
+        if (i % 2 == 1)
+            items[i] = NULL; /* freed */
+        if (items[i] && digestmap_lookup (m, items[i]->digest,
+                                          items[i]->len) != items[i])
+            errors++;
+    }
+    ok (errors == 0 && digestmap_size (m) == n - freed,
+        "only even items remain after digestmap_delete_if");
+
+    freed = 0;
+    n = digestmap_size (m);
+    digestmap_destroy (m);
+    ok (freed == n,
+        "digestmap_destroy frees remaining items");
+    free (items);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    test_basic ();
+    test_many ();
+
+    done_testing ();
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,142 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* Compare a zhash_t keyed by blobref string (as previously used by the
+ * content and KVS caches) with a digestmap keyed by raw digest.
+ * Lookups start from a blobref string in both cases, so the digestmap
+ * timings include blobref_strtohash().
+ *
+ * Usage: test_digestmap_bench.t [count]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <czmq.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libutil/blobref.h"
+#include "src/common/libutil/digestmap.h"
+#include "src/common/libutil/monotime.h"
+
+struct entry {
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+};
+
+static void report (const char *name, const char *op, int count, double ms)
+{
+    diag ("%-9s %-7s %d in %.1fms (%.0f ns/op)",
+          name, op, count, ms, ms * 1E6 / count);
+}
+
+static int bench_zhash (struct entry *entries, int count)
+{
+    zhash_t *zh;
+    struct timespec t0;
+    int errors = 0;
+    int i;
+
+    if (!(zh = zhash_new ()))
+        BAIL_OUT ("zhash_new failed");
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        if (zhash_insert (zh, entries[i].blobref, &entries[i]) < 0)
+            errors++;
+    }
+    report ("zhash", "insert", count, monotime_since (t0));
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        if (zhash_lookup (zh, entries[i].blobref) != &entries[i])
+            errors++;
+    }
+    report ("zhash", "lookup", count, monotime_since (t0));
+    monotime (&t0);
+    for (i = 0; i < count; i++)
+        zhash_delete (zh, entries[i].blobref);
+    report ("zhash", "delete", count, monotime_since (t0));
+    if (zhash_size (zh) != 0)
+        errors++;
+    zhash_destroy (&zh);
+    return errors;
+}
+
+static int bench_digestmap (struct entry *entries, int count)
+{
+    struct digestmap *m;
+    struct timespec t0;
+    uint8_t digest[BLOBREF_MAX_DIGEST_SIZE];
+    int len;
+    int errors = 0;
+    int i;
+
+    if (!(m = digestmap_create ()))
+        BAIL_OUT ("digestmap_create failed");
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        if ((len = blobref_strtohash (entries[i].blobref, digest,
+                                      sizeof (digest))) < 0
+            || digestmap_insert (m, digest, len, &entries[i]) < 0)
+            errors++;
+    }
+    report ("digestmap", "insert", count, monotime_since (t0));
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        if ((len = blobref_strtohash (entries[i].blobref, digest,
+                                      sizeof (digest))) < 0
+            || digestmap_lookup (m, digest, len) != &entries[i])
+            errors++;
+    }
+    report ("digestmap", "lookup", count, monotime_since (t0));
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        if ((len = blobref_strtohash (entries[i].blobref, digest,
+                                      sizeof (digest))) < 0
+            || digestmap_delete (m, digest, len) < 0)
+            errors++;
+    }
+    report ("digestmap", "delete", count, monotime_since (t0));
+    if (digestmap_size (m) != 0)
+        errors++;
+    digestmap_destroy (m);
+    return errors;
+}
+
+int main (int argc, char *argv[])
+{
+    int count = 100000;
+    struct entry *entries;
+    int i;
+
+    plan (NO_PLAN);
+
+    if (argc > 1)
+        count = strtoul (argv[1], NULL, 10);
+    if (count <= 0)
+        BAIL_OUT ("invalid count");
+    if (!(entries = calloc (count, sizeof (entries[0]))))
+        BAIL_OUT ("out of memory");
+    for (i = 0; i < count; i++) {
+        if (blobref_hash ("sha1", &i, sizeof (i), entries[i].blobref,
+                          sizeof (entries[i].blobref)) < 0)
+            BAIL_OUT ("blobref_hash failed");
+    }
+
+    ok (bench_zhash (entries, count) == 0,
+        "zhash: %d sha1 blobrefs inserted, found, and deleted", count);
+    ok (bench_digestmap (entries, count) == 0,
+        "digestmap: %d sha1 blobrefs inserted, found, and deleted", count);
+
+    free (entries);
+    done_testing ();
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,74 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#include <string.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libutil/histogram.h"
+
+int main (int argc, char *argv[])
+{
+    histogram_t hist;
+    int i;
+
+    plan (NO_PLAN);
+
+    memset (&hist, 0, sizeof (hist));
+    ok (histogram_count (&hist) == 0,
+        "histogram_count is 0 initially");
+    ok (histogram_percentile (&hist, 50) == 0,
+        "histogram_percentile of empty histogram is 0");
+
+    histogram_push (&hist, 0);
+    histogram_push (&hist, 0.5);
+    histogram_push (&hist, 1);
+    ok (histogram_bucket_count (&hist, 0) == 3,
+        "values <= 1 are counted in bucket 0");
+
+    histogram_push (&hist, 2);
+    ok (histogram_bucket_count (&hist, 1) == 1,
+        "2 is counted in bucket 1");
+    histogram_push (&hist, 3);
+    histogram_push (&hist, 4);
+    ok (histogram_bucket_count (&hist, 2) == 2,
+        "3 and 4 are counted in bucket 2");
+    histogram_push (&hist, 4.5);
+    ok (histogram_bucket_count (&hist, 3) == 1,
+        "4.5 is counted in bucket 3");
+    histogram_push (&hist, 1E30);
+    ok (histogram_bucket_count (&hist, HISTOGRAM_BUCKETS - 1) == 1,
+        "huge value is counted in last bucket");
+    ok (histogram_count (&hist) == 8,
+        "histogram_count is 8");
+
+    ok (histogram_bucket_count (&hist, -1) == 0
+        && histogram_bucket_count (&hist, HISTOGRAM_BUCKETS) == 0,
+        "histogram_bucket_count returns 0 for out of range bucket");
+    ok (histogram_bucket_max (0) == 1
+        && histogram_bucket_max (1) == 2
+        && histogram_bucket_max (10) == 1024,
+        "histogram_bucket_max works");
+
+    memset (&hist, 0, sizeof (hist));
+    for (i = 1; i <= 100; i++)
+        histogram_push (&hist, i);
+    ok (histogram_percentile (&hist, 50) == 64,
+        "histogram_percentile 50 of 1..100 is 64");
+    ok (histogram_percentile (&hist, 100) == 128,
+        "histogram_percentile 100 of 1..100 is 128");
+    ok (histogram_percentile (&hist, 1) == 1,
+        "histogram_percentile 1 of 1..100 is 1");
+
+    done_testing ();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,215 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libutil/mpscq.h"
+
+static bool fd_readable (int fd)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    return poll (&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+static int free_count;
+
+static void count_free (void *item)
+{
+    free_count++;
+    free (item);
+}
+
+void check_basic (void)
+{
+    struct mpscq *q;
+    int a = 1, b = 2, c = 3;
+    int fd;
+
+    ok ((q = mpscq_create ()) != NULL,
+        "mpscq_create works");
+    if (!q)
+        BAIL_OUT ("mpscq_create failed");
+    fd = mpscq_get_fd (q);
+    ok (fd >= 0,
+        "mpscq_get_fd returns valid fd");
+    ok (mpscq_pending (q) == false,
+        "mpscq_pending returns false on empty queue");
+    ok (mpscq_pop (q) == NULL && errno == EAGAIN,
+        "mpscq_pop fails with EAGAIN on empty queue");
+    ok (!fd_readable (fd),
+        "fd is not readable on empty queue");
+
+    errno = 0;
+    ok (mpscq_push (q, NULL) < 0 && errno == EINVAL,
+        "mpscq_push item=NULL fails with EINVAL");
+    errno = 0;
+    ok (mpscq_push (NULL, &a) < 0 && errno == EINVAL,
+        "mpscq_push q=NULL fails with EINVAL");
+
+    ok (mpscq_push (q, &a) == 0,
+        "mpscq_push works");
+    ok (fd_readable (fd),
+        "fd is readable after push to empty queue");
+    ok (mpscq_push (q, &b) == 0 && mpscq_push (q, &c) == 0,
+        "mpscq_push works twice more");
+    ok (mpscq_pending (q) == true,
+        "mpscq_pending returns true");
+    ok (mpscq_pop (q) == &a && mpscq_pop (q) == &b && mpscq_pop (q) == &c,
+        "mpscq_pop returns items in order");
+    ok (fd_readable (fd),
+        "fd is still readable until the queue is found empty");
+    ok (mpscq_pending (q) == false,
+        "mpscq_pending returns false on drained queue");
+    ok (!fd_readable (fd),
+        "fd is no longer readable");
+
+    ok (mpscq_push (q, &a) == 0 && fd_readable (fd),
+        "fd is readable after next push");
+    ok (mpscq_pop (q) == &a && mpscq_pending (q) == false,
+        "item can be popped and queue is empty");
+
+    mpscq_destroy (q, NULL);
+}
+
+void check_destroy (void)
+{
+    struct mpscq *q;
+    int i;
+
+    if (!(q = mpscq_create ()))
+        BAIL_OUT ("mpscq_create failed");
+    for (i = 0; i < 3; i++) {
+        int *item = malloc (sizeof (*item));
+        if (!item || mpscq_push (q, item) < 0)
+            BAIL_OUT ("mpscq_push failed");
+    }
+    free_count = 0;
+    mpscq_destroy (q, count_free);
+    ok (free_count == 3,
+        "mpscq_destroy called free function on remaining items");
+
+    lives_ok ({mpscq_destroy (NULL, NULL);},
+        "mpscq_destroy q=NULL doesn't crash");
+}
+
+/* Several producer threads, consumer sleeps in poll(2) on the fd.
+ */
+#define PRODUCERS       4
+#define PER_PRODUCER    100000
+
+struct producer_ctx {
+    struct mpscq *q;
+    int id;
+    int errors;
+};
+
+struct item {
+    int id;
+    int seq;
+};
+
+static void *producer (void *arg)
+{
+    struct producer_ctx *ctx = arg;
+    int i;
+
+    for (i = 0; i < PER_PRODUCER; i++) {
+        struct item *item = malloc (sizeof (*item));
+        if (!item) {
+            ctx->errors++;
+            break;
+        }
+        item->id = ctx->id;
+        item->seq = i;
+        if (mpscq_push (ctx->q, item) < 0) {
+            free (item);
+            ctx->errors++;
+            break;
+        }
+    }
+    return NULL;
+}
+
+void check_threads (void)
+{
+    struct mpscq *q;
+    struct producer_ctx ctx[PRODUCERS];
+    pthread_t t[PRODUCERS];
+    int next[PRODUCERS] = { 0 };
+    int total = 0;
+    int order_errors = 0;
+    int errors = 0;
+    int i;
+
+    if (!(q = mpscq_create ()))
+        BAIL_OUT ("mpscq_create failed");
+    for (i = 0; i < PRODUCERS; i++) {
+        ctx[i].q = q;
+        ctx[i].id = i;
+        ctx[i].errors = 0;
+        if (pthread_create (&t[i], NULL, producer, &ctx[i]) != 0)
+            BAIL_OUT ("pthread_create failed");
+    }
+    while (total < PRODUCERS * PER_PRODUCER) {
+        struct item *item;
+
+        if (!(item = mpscq_pop (q))) {
+            if (!mpscq_pending (q)) {
+                struct pollfd pfd = { .fd = mpscq_get_fd (q),
+                                      .events = POLLIN };
+                (void)poll (&pfd, 1, -1);
+            }
+            continue;
+        }
+        if (item->id < 0 || item->id >= PRODUCERS)
+            BAIL_OUT ("corrupt item");
+        if (item->seq != next[item->id]++)
+            order_errors++;
+        free (item);
+        total++;
+    }
+    for (i = 0; i < PRODUCERS; i++) {
+        if (pthread_join (t[i], NULL) != 0)
+            BAIL_OUT ("pthread_join failed");
+        errors += ctx[i].errors;
+    }
+    ok (errors == 0 && total == PRODUCERS * PER_PRODUCER,
+        "%d producers passed %d items to consumer sleeping on fd",
+        PRODUCERS, total);
+    ok (order_errors == 0,
+        "items from each producer were received in order");
+    ok (mpscq_pending (q) == false && !fd_readable (mpscq_get_fd (q)),
+        "queue is empty and fd is quiet");
+
+    mpscq_destroy (q, NULL);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    check_basic ();
+    check_destroy ();
+    check_threads ();
+
+    done_testing ();
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,441 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/common/libutil/shmring.h"
+
+#define CAPACITY 4096
+
+static void *map_ring (size_t capacity)
+{
+    void *mem;
+
+    mem = mmap (NULL, shmring_memsize (capacity), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        BAIL_OUT ("mmap failed");
+    if (shmring_init (mem, capacity) < 0)
+        BAIL_OUT ("shmring_init failed");
+    return mem;
+}
+
+static void fill (void *buf, size_t size, int seed)
+{
+    size_t i;
+    for (i = 0; i < size; i++)
+        ((uint8_t *)buf)[i] = (uint8_t)(seed + i);
+}
+
+static bool check (const void *buf, size_t size, int seed)
+{
+    size_t i;
+    for (i = 0; i < size; i++) {
+        if (((const uint8_t *)buf)[i] != (uint8_t)(seed + i))
+            return false;
+    }
+    return true;
+}
+
+void check_init (void)
+{
+    static uint64_t mem64[1024];
+    char *mem = (char *)mem64;
+    struct shmring *r;
+
+    errno = 0;
+    ok (shmring_init (mem, 1000) < 0 && errno == EINVAL,
+        "shmring_init fails with EINVAL on non power of two capacity");
+    errno = 0;
+    ok (shmring_init (mem, 2048) < 0 && errno == EINVAL,
+        "shmring_init fails with EINVAL on tiny capacity");
+    ok (shmring_init (mem, CAPACITY) == 0,
+        "shmring_init works");
+    errno = 0;
+    ok (shmring_attach (mem, sizeof (mem64), 2 * CAPACITY) == NULL
+        && errno == EINVAL,
+        "shmring_attach fails with EINVAL on capacity mismatch");
+    errno = 0;
+    ok (shmring_attach (mem, 100, 0) == NULL && errno == EINVAL,
+        "shmring_attach fails with EINVAL on short memory");
+    ok ((r = shmring_attach (mem, sizeof (mem64), 0)) != NULL,
+        "shmring_attach works with capacity from shared memory");
+    ok (shmring_record_max (r) == CAPACITY / 4,
+        "shmring_record_max is capacity / 4");
+    shmring_detach (r);
+    mem[0] ^= 0xff;
+    errno = 0;
+    ok (shmring_attach (mem, sizeof (mem64), 0) == NULL && errno == EINVAL,
+        "shmring_attach fails with EINVAL on bad magic");
+}
+
+void check_basic (void)
+{
+    void *mem = map_ring (CAPACITY);
+    struct shmring *tx, *rx;
+    const void *rec;
+    size_t size;
+    void *p;
+    int i, n;
+
+    if (!(tx = shmring_attach (mem, shmring_memsize (CAPACITY), CAPACITY))
+        || !(rx = shmring_attach (mem, shmring_memsize (CAPACITY), 0)))
+        BAIL_OUT ("shmring_attach failed");
+
+    errno = 0;
+    ok (shmring_peek (rx, &size) == NULL && errno == EAGAIN,
+        "shmring_peek on empty ring fails with EAGAIN");
+    errno = 0;
+    ok (shmring_reserve (tx, CAPACITY / 4 + 1) == NULL && errno == EMSGSIZE,
+        "shmring_reserve > record_max fails with EMSGSIZE");
+
+    ok ((p = shmring_reserve (tx, 0)) != NULL,
+        "shmring_reserve of empty record works");
+    shmring_commit (tx);
+    ok ((rec = shmring_peek (rx, &size)) != NULL && size == 0,
+        "shmring_peek returned empty record");
+    shmring_consume (rx);
+
+    /* Push enough records through to wrap many times.
+     */
+    for (i = 0; i < 1000; i++) {
+        size = (i * 37) % (CAPACITY / 4);
+        if (!(p = shmring_reserve (tx, size)))
+            break;
+        fill (p, size, i);
+        shmring_commit (tx);
+        if (!(rec = shmring_peek (rx, &size))
+            || size != (i * 37) % (CAPACITY / 4)
+            || !check (rec, size, i))
+            break;
+        shmring_consume (rx);
+    }
+    ok (i == 1000,
+        "1000 records of varying size passed through the ring");
+
+    /* Fill the ring, then drain it.
+     */
+    n = 0;
+    while ((p = shmring_reserve (tx, 100))) {
+        fill (p, 100, n++);
+        shmring_commit (tx);
+    }
+    ok (p == NULL && errno == EAGAIN && n > 0,
+        "shmring_reserve on full ring fails with EAGAIN after %d records", n);
+    ok (shmring_wait_writable (tx, 100) == true,
+        "shmring_wait_writable says producer may sleep");
+    ok ((rec = shmring_peek (rx, &size)) != NULL && size == 100
+        && check (rec, 100, 0),
+        "shmring_peek returned first record");
+    shmring_consume (rx);
+    ok (shmring_wake_producer (rx) == true,
+        "shmring_wake_producer says producer must be woken");
+    ok (shmring_wake_producer (rx) == false,
+        "shmring_wake_producer only says so once");
+    ok (shmring_wait_writable (tx, 100) == false,
+        "shmring_wait_writable says producer may not sleep after consume");
+    for (i = 1; i < n; i++) {
+        if (!(rec = shmring_peek (rx, &size)) || size != 100
+            || !check (rec, size, i))
+            break;
+        shmring_consume (rx);
+    }
+    ok (i == n,
+        "remaining records were received in order");
+
+    ok (shmring_wait_readable (rx) == true,
+        "shmring_wait_readable on empty ring says consumer may sleep");
+    ok (shmring_wake_consumer (tx) == true,
+        "shmring_wake_consumer says consumer must be woken");
+    ok (shmring_wake_consumer (tx) == false,
+        "shmring_wake_consumer only says so once");
+    if (!(p = shmring_reserve (tx, 8)))
+        BAIL_OUT ("shmring_reserve failed");
+    shmring_commit (tx);
+    ok (shmring_wait_readable (rx) == false,
+        "shmring_wait_readable on non-empty ring says consumer may not sleep");
+    ok (shmring_wake_consumer (tx) == false,
+        "shmring_wake_consumer then says consumer need not be woken");
+
+    shmring_detach (tx);
+    shmring_detach (rx);
+    munmap (mem, shmring_memsize (CAPACITY));
+}
+
+void check_fragment (void)
+{
+    void *mem = map_ring (CAPACITY);
+    struct shmring *tx, *rx;
+    size_t bigsize = CAPACITY * 10 + 3;
+    char *big;
+    const void *rec;
+    size_t offset = 0;
+    size_t size;
+    int rc;
+    int eagain = 0;
+    int partial = 0;
+    int count = 0;
+
+    if (!(tx = shmring_attach (mem, shmring_memsize (CAPACITY), 0))
+        || !(rx = shmring_attach (mem, shmring_memsize (CAPACITY), 0)))
+        BAIL_OUT ("shmring_attach failed");
+    if (!(big = malloc (bigsize)))
+        BAIL_OUT ("out of memory");
+    fill (big, bigsize, 42);
+
+    while ((rc = shmring_write (tx, big, bigsize, &offset)) < 0
+                                                    && errno == EAGAIN) {
+        eagain++;
+        errno = 0;
+        if (shmring_peek (rx, &size) == NULL && errno == EAGAIN)
+            partial++;
+    }
+    ok (rc == 0 && offset == bigsize && eagain > 0,
+        "shmring_write of %zu byte record resumed after EAGAIN %d times",
+        bigsize, eagain);
+    ok (partial == eagain,
+        "shmring_peek of partial record failed with EAGAIN each time");
+    ok ((rec = shmring_peek (rx, &size)) != NULL && size == bigsize
+        && check (rec, size, 42),
+        "shmring_peek returned reassembled record");
+    ok (shmring_peek (rx, &size) == rec,
+        "shmring_peek again returns the same record");
+    shmring_consume (rx);
+
+    offset = 0;
+    ok (shmring_write (tx, "hello", 6, &offset) == 0 && offset == 6,
+        "shmring_write of small record works");
+    ok ((rec = shmring_peek (rx, &size)) != NULL && size == 6
+        && !strcmp (rec, "hello"),
+        "shmring_peek returned small record");
+    shmring_consume (rx);
+
+    offset = 0;
+    while (shmring_write (tx, big, CAPACITY / 2, &offset) == 0) {
+        offset = 0;
+        count++;
+    }
+    ok (errno == EAGAIN && count > 0,
+        "shmring_write filled ring with %d fragmented records", count);
+    while ((rec = shmring_peek (rx, &size)) && size == CAPACITY / 2
+                                            && check (rec, size, 42)) {
+        shmring_consume (rx);
+        count--;
+    }
+    ok (count == 0 && errno == EAGAIN,
+        "all fragmented records were received");
+
+    /* A record larger than the reassembly limit is refused as soon as
+     * the fragments received so far exceed it.
+     */
+    shmring_set_record_limit (rx, CAPACITY);
+    offset = 0;
+    while ((rc = shmring_write (tx, big, CAPACITY * 2, &offset)) < 0
+                                                    && errno == EAGAIN) {
+        if (shmring_peek (rx, &size) == NULL && errno != EAGAIN)
+            break;
+    }
+    ok (rc < 0 && errno == EMSGSIZE,
+        "shmring_peek of record over reassembly limit fails with EMSGSIZE");
+
+    free (big);
+    shmring_detach (tx);
+    shmring_detach (rx);
+    munmap (mem, shmring_memsize (CAPACITY));
+}
+
+/* Corrupt the shared state the way a misbehaving peer might.
+ */
+void check_corrupt (void)
+{
+    void *mem = map_ring (CAPACITY);
+    uint64_t *tail = (uint64_t *)((char *)mem + 64);
+    uint64_t *head = (uint64_t *)((char *)mem + 128);
+    uint32_t *data = (uint32_t *)((char *)mem + 192);
+    struct shmring *tx, *rx;
+    size_t size;
+    uint64_t saved;
+    void *p;
+
+    if (!(tx = shmring_attach (mem, shmring_memsize (CAPACITY), 0))
+        || !(rx = shmring_attach (mem, shmring_memsize (CAPACITY), 0)))
+        BAIL_OUT ("shmring_attach failed");
+
+    saved = *tail;
+    *tail = saved + CAPACITY + 8;
+    errno = 0;
+    ok (shmring_peek (rx, &size) == NULL && errno == EPROTO,
+        "shmring_peek fails with EPROTO when tail is beyond capacity");
+    *tail = saved + 4;
+    errno = 0;
+    ok (shmring_peek (rx, &size) == NULL && errno == EPROTO,
+        "shmring_peek fails with EPROTO on partial record header");
+    *tail = saved;
+
+    if (!(p = shmring_reserve (tx, 16)))
+        BAIL_OUT ("shmring_reserve failed");
+    shmring_commit (tx);
+    data[0] = CAPACITY;
+    errno = 0;
+    ok (shmring_peek (rx, &size) == NULL && errno == EPROTO,
+        "shmring_peek fails with EPROTO on oversized record length");
+    data[0] = 16;
+    data[1] = 2;
+    errno = 0;
+    ok (shmring_peek (rx, &size) == NULL && errno == EPROTO,
+        "shmring_peek fails with EPROTO on misplaced padding");
+    data[1] = 0;
+    ok (shmring_peek (rx, &size) != NULL && size == 16,
+        "shmring_peek works once record is restored");
+
+    saved = *head;
+    *head = *tail + 8;
+    errno = 0;
+    ok (shmring_reserve (tx, 16) == NULL && errno == EPROTO,
+        "shmring_reserve fails with EPROTO when head is ahead of tail");
+    *head = saved;
+
+    shmring_detach (tx);
+    shmring_detach (rx);
+    munmap (mem, shmring_memsize (CAPACITY));
+}
+
+/* Producer and consumer threads that sleep in poll(2) on eventfds.
+ */
+#define THREAD_COUNT 100000
+
+struct thread_ctx {
+    struct shmring *r;
+    int efd_producer;
+    int efd_consumer;
+    int errors;
+};
+
+static void sleep_on (int efd)
+{
+    struct pollfd pfd = { .fd = efd, .events = POLLIN };
+    uint64_t val;
+
+    (void)poll (&pfd, 1, -1);
+    (void)read (efd, &val, sizeof (val));
+}
+
+static void wake (int efd)
+{
+    uint64_t val = 1;
+    if (write (efd, &val, sizeof (val)) < 0)
+        BAIL_OUT ("eventfd write failed");
+}
+
+static void *producer (void *arg)
+{
+    struct thread_ctx *ctx = arg;
+    char buf[CAPACITY];
+    int i;
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        size_t size = i % 7 == 0 ? sizeof (buf) : (size_t)(i % 200);
+        size_t offset = 0;
+
+        fill (buf, size, i);
+        while (shmring_write (ctx->r, buf, size, &offset) < 0) {
+            if (errno != EAGAIN) {
+                ctx->errors++;
+                return NULL;
+            }
+            /* fragments may already be in the ring */
+            if (shmring_wake_consumer (ctx->r))
+                wake (ctx->efd_consumer);
+            if (shmring_wait_writable (ctx->r, size - offset))
+                sleep_on (ctx->efd_producer);
+        }
+        if (shmring_wake_consumer (ctx->r))
+            wake (ctx->efd_consumer);
+    }
+    return NULL;
+}
+
+void check_threads (void)
+{
+    void *mem = map_ring (CAPACITY);
+    struct thread_ctx ctx = { .errors = 0 };
+    struct shmring *rx;
+    pthread_t t;
+    const void *rec;
+    size_t size;
+    int i;
+
+    if (!(ctx.r = shmring_attach (mem, shmring_memsize (CAPACITY), 0))
+        || !(rx = shmring_attach (mem, shmring_memsize (CAPACITY), 0)))
+        BAIL_OUT ("shmring_attach failed");
+    if ((ctx.efd_producer = eventfd (0, EFD_NONBLOCK)) < 0
+        || (ctx.efd_consumer = eventfd (0, EFD_NONBLOCK)) < 0)
+        BAIL_OUT ("eventfd failed");
+    if (pthread_create (&t, NULL, producer, &ctx) != 0)
+        BAIL_OUT ("pthread_create failed");
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        while (!(rec = shmring_peek (rx, &size))) {
+            if (errno != EAGAIN)
+                break;
+            if (shmring_wake_producer (rx))
+                wake (ctx.efd_producer);
+            if (shmring_wait_readable (rx))
+                sleep_on (ctx.efd_consumer);
+        }
+        if (!rec || size != (i % 7 == 0 ? CAPACITY : (size_t)(i % 200))
+                 || !check (rec, size, i))
+            break;
+        shmring_consume (rx);
+        if (shmring_wake_producer (rx))
+            wake (ctx.efd_producer);
+    }
+    if (pthread_join (t, NULL) != 0)
+        BAIL_OUT ("pthread_join failed");
+    ok (i == THREAD_COUNT && ctx.errors == 0,
+        "%d records passed between threads sleeping on eventfds",
+        THREAD_COUNT);
+
+    close (ctx.efd_producer);
+    close (ctx.efd_consumer);
+    shmring_detach (ctx.r);
+    shmring_detach (rx);
+    munmap (mem, shmring_memsize (CAPACITY));
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    check_init ();
+    check_basic ();
+    check_fragment ();
+    check_corrupt ();
+    check_threads ();
+
+    done_testing ();
+    return (0);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
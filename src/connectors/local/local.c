@@ -33,7 +33,7 @@ typedef struct {
     int fd;
     int fd_nonblock;
     struct flux_msg_iobuf outbuf;
-    struct flux_msg_iobuf inbuf;
+    struct flux_msg_reader *reader;
     uint32_t testing_userid;
     uint32_t testing_rolemask;
     flux_t *h;
@@ -75,6 +75,11 @@ static int op_pollevents (void *impl)
             revents |= FLUX_POLLERR;
             break;
     }
+    /* Messages may be buffered by the reader without the socket
+     * remaining readable.
+     */
+    if (flux_msg_reader_pending (c->reader))
+        revents |= FLUX_POLLIN;
     return revents;
 }
 
@@ -129,7 +134,7 @@ static flux_msg_t *op_recv (void *impl, int flags)
 
     if (set_nonblock (c, (flags & FLUX_O_NONBLOCK)) < 0)
         return NULL;
-    return flux_msg_recvfd (c->fd, &c->inbuf);
+    return flux_msg_reader_recv (c->reader, c->fd);
 }
 
 static int op_event (void *impl, const char *topic, const char *msg_topic)
@@ -198,7 +203,7 @@ static void op_fini (void *impl)
     assert (c->magic == CTX_MAGIC);
 
     flux_msg_iobuf_clean (&c->outbuf);
-    flux_msg_iobuf_clean (&c->inbuf);
+    flux_msg_reader_destroy (c->reader);
     if (c->fd >= 0)
         (void)close (c->fd);
     c->magic = ~CTX_MAGIC;
@@ -285,7 +290,8 @@ flux_t *connector_init (const char *path, int flags)
         goto error;
     }
     flux_msg_iobuf_init (&c->outbuf);
-    flux_msg_iobuf_init (&c->inbuf);
+    if (!(c->reader = flux_msg_reader_create ()))
+        goto error;
     if (!(c->h = flux_handle_create (c, &handle_ops, flags)))
         goto error;
     return c->h;
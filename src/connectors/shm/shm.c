@@ -0,0 +1,560 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* shm connector - connect to connector-local as local:// does, then
+ * exchange messages through shared memory rings instead of the socket.
+ *
+ * The broker creates a memfd holding two rings, client to broker
+ * followed by broker to client, and two eventfds, one written by each
+ * side to wake the other.  They are passed back on the socket in response
+ * to a local.shm request, after which the socket carries no messages, but
+ * remains open so that either side sees the other disconnect.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <unistd.h>
+#include <flux/core.h>
+
+#include "src/common/libutil/log.h"
+#include "src/common/libutil/macros.h"
+#include "src/common/libutil/shmring.h"
+
+#define CTX_MAGIC   0xf434aaac
+typedef struct {
+    int magic;
+    int fd;                 /* socket, open only to detect disconnect */
+    void *mem;
+    size_t memsize;
+    struct shmring *tx;     /* client to broker */
+    struct shmring *rx;     /* broker to client */
+    int efd;                /* written by broker to wake us */
+    int peer_efd;           /* written by us to wake broker */
+    int pollfd;             /* epoll set of efd and fd */
+    uint32_t testing_userid;
+    uint32_t testing_rolemask;
+    flux_t *h;
+} shm_ctx_t;
+
+static const struct flux_handle_ops handle_ops;
+
+static void efd_signal (int fd)
+{
+    uint64_t val = 1;
+    (void)write (fd, &val, sizeof (val));
+}
+
+/* Block until the broker writes our eventfd.
+ * Since the broker sends nothing more on the socket, if it becomes
+ * readable, the broker has disconnected.
+ */
+static int wait_efd (shm_ctx_t *c)
+{
+    struct pollfd pfd[2] = {
+        { .fd = c->efd, .events = POLLIN, .revents = 0 },
+        { .fd = c->fd, .events = POLLIN, .revents = 0 },
+    };
+    uint64_t val;
+
+    if (poll (pfd, 2, -1) < 0)
+        return -1;
+    if (pfd[1].revents) {
+        errno = ECONNRESET;
+        return -1;
+    }
+    (void)read (c->efd, &val, sizeof (val));
+    return 0;
+}
+
+static void wake_broker_consumer (shm_ctx_t *c)
+{
+    if (shmring_wake_consumer (c->tx))
+        efd_signal (c->peer_efd);
+}
+
+static void wake_broker_producer (shm_ctx_t *c)
+{
+    if (shmring_wake_producer (c->rx))
+        efd_signal (c->peer_efd);
+}
+
+/* The pollfd only signals that pollevents may have changed.  Readiness
+ * is determined from the rings, announcing that we are waiting where they
+ * are not ready, so the broker writes our eventfd when that changes.
+ */
+static int op_pollevents (void *impl)
+{
+    shm_ctx_t *c = impl;
+    struct epoll_event ev[2];
+    uint64_t val;
+    int revents = 0;
+    int n, i;
+
+    if ((n = epoll_wait (c->pollfd, ev, 2, 0)) < 0)
+        return FLUX_POLLERR;
+    for (i = 0; i < n; i++) {
+        if (ev[i].data.fd == c->efd)
+            (void)read (c->efd, &val, sizeof (val));
+        else
+            revents |= FLUX_POLLERR;
+    }
+    if (!shmring_wait_readable (c->rx))
+        revents |= FLUX_POLLIN;
+    if (!shmring_wait_writable (c->tx, shmring_record_max (c->tx)))
+        revents |= FLUX_POLLOUT;
+    return revents;
+}
+
+static int op_pollfd (void *impl)
+{
+    shm_ctx_t *c = impl;
+    return c->pollfd;
+}
+
+/* Wait for room for 'size' bytes in the ring, unless it has appeared
+ * since the failed reservation.
+ */
+static int wait_writable (shm_ctx_t *c, size_t size)
+{
+    if (shmring_wait_writable (c->tx, size))
+        return wait_efd (c);
+    return 0;
+}
+
+/* A message that does not fit in one record is written in fragments.
+ * Once the first is written, the rest must follow even if FLUX_O_NONBLOCK.
+ */
+static int send_fragmented (shm_ctx_t *c, const flux_msg_t *msg,
+                            size_t size, int flags)
+{
+    size_t offset = 0;
+    void *buf;
+    int rc = -1;
+
+    if (!(buf = malloc (size))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (flux_msg_encode (msg, buf, size) < 0)
+        goto done;
+    while (shmring_write (c->tx, buf, size, &offset) < 0) {
+        if (errno != EAGAIN)
+            goto done;
+        if (offset == 0 && (flags & FLUX_O_NONBLOCK))
+            goto done;
+        wake_broker_consumer (c);
+        if (wait_writable (c, size - offset) < 0)
+            goto done;
+    }
+    rc = 0;
+done:
+    free (buf);
+    return rc;
+}
+
+static int send_normal (shm_ctx_t *c, const flux_msg_t *msg, int flags)
+{
+    size_t size = flux_msg_encode_size (msg);
+    void *p;
+
+    if (size > shmring_record_max (c->tx)) {
+        if (send_fragmented (c, msg, size, flags) < 0)
+            return -1;
+    }
+    else {
+        while (!(p = shmring_reserve (c->tx, size))) {
+            if (errno != EAGAIN || (flags & FLUX_O_NONBLOCK))
+                return -1;
+            if (wait_writable (c, size) < 0)
+                return -1;
+        }
+        if (flux_msg_encode (msg, p, size) < 0)
+            return -1;
+        shmring_commit (c->tx);
+    }
+    wake_broker_consumer (c);
+    return 0;
+}
+
+static int send_testing (shm_ctx_t *c, const flux_msg_t *msg, int flags)
+{
+    flux_msg_t *cpy;
+    int rc = -1;
+
+    if (!(cpy = flux_msg_copy (msg, true)))
+        goto done;
+    if (flux_msg_set_userid (cpy, c->testing_userid) < 0)
+        goto done;
+    if (flux_msg_set_rolemask (cpy, c->testing_rolemask) < 0)
+        goto done;
+    rc = send_normal (c, cpy, flags);
+done:
+    flux_msg_destroy (cpy);
+    return rc;
+}
+
+static int op_send (void *impl, const flux_msg_t *msg, int flags)
+{
+    shm_ctx_t *c = impl;
+    assert (c->magic == CTX_MAGIC);
+    if (c->testing_userid != FLUX_USERID_UNKNOWN
+                                || c->testing_rolemask != FLUX_ROLE_NONE)
+        return send_testing (c, msg, flags);
+    else
+        return send_normal (c, msg, flags);
+}
+
+static flux_msg_t *op_recv (void *impl, int flags)
+{
+    shm_ctx_t *c = impl;
+    const void *rec;
+    size_t size;
+    flux_msg_t *msg;
+    int saved_errno;
+
+    assert (c->magic == CTX_MAGIC);
+
+    while (!(rec = shmring_peek (c->rx, &size))) {
+        if (errno != EAGAIN)
+            return NULL;
+        wake_broker_producer (c); // peek may have consumed fragments
+        if ((flags & FLUX_O_NONBLOCK)) {
+            errno = EAGAIN;
+            return NULL;
+        }
+        if (shmring_wait_readable (c->rx) && wait_efd (c) < 0)
+            return NULL;
+    }
+    msg = flux_msg_decode (rec, size);
+    saved_errno = errno;
+    shmring_consume (c->rx);
+    wake_broker_producer (c);
+    errno = saved_errno;
+    return msg;
+}
+
+static int op_event (void *impl, const char *topic, const char *msg_topic)
+{
+    shm_ctx_t *c = impl;
+    flux_future_t *f;
+    int rc = -1;
+
+    assert (c->magic == CTX_MAGIC);
+
+    if (!(f = flux_rpc_pack (c->h, msg_topic, FLUX_NODEID_ANY, 0,
+                             "{s:s}", "topic", topic)))
+        goto done;
+    if (flux_future_get (f, NULL) < 0)
+        goto done;
+    rc = 0;
+done:
+    flux_future_destroy (f);
+    return rc;
+}
+
+static int op_event_subscribe (void *impl, const char *topic)
+{
+    return op_event (impl, topic, "local.sub");
+}
+
+static int op_event_unsubscribe (void *impl, const char *topic)
+{
+    return op_event (impl, topic, "local.unsub");
+}
+
+static int op_setopt (void *impl, const char *option,
+                      const void *val, size_t size)
+{
+    shm_ctx_t *ctx = impl;
+    assert (ctx->magic == CTX_MAGIC);
+    size_t val_size;
+    int rc = -1;
+
+    if (option && !strcmp (option, FLUX_OPT_TESTING_USERID)) {
+        val_size = sizeof (ctx->testing_userid);
+        if (size != val_size) {
+            errno = EINVAL;
+            goto done;
+        }
+        memcpy (&ctx->testing_userid, val, val_size);
+    } else if (option && !strcmp (option, FLUX_OPT_TESTING_ROLEMASK)) {
+        val_size = sizeof (ctx->testing_rolemask);
+        if (size != val_size) {
+            errno = EINVAL;
+            goto done;
+        }
+        memcpy (&ctx->testing_rolemask, val, val_size);
+    } else {
+        errno = EINVAL;
+        goto done;
+    }
+    rc = 0;
+done:
+    return rc;
+}
+
+static void op_fini (void *impl)
+{
+    shm_ctx_t *c = impl;
+    assert (c->magic == CTX_MAGIC);
+
+    shmring_detach (c->tx);
+    shmring_detach (c->rx);
+    if (c->mem)
+        (void)munmap (c->mem, c->memsize);
+    if (c->pollfd >= 0)
+        (void)close (c->pollfd);
+    if (c->efd >= 0)
+        (void)close (c->efd);
+    if (c->peer_efd >= 0)
+        (void)close (c->peer_efd);
+    if (c->fd >= 0)
+        (void)close (c->fd);
+    c->magic = ~CTX_MAGIC;
+    free (c);
+}
+
+static int env_getint (char *name, int dflt)
+{
+    char *s = getenv (name);
+    return s ? strtol (s, NULL, 10) : dflt;
+}
+
+/* Connect socket `fd` to unix domain socket `file` and fail after `retries`
+ *  attempts with exponential retry backoff starting at 16ms.
+ * Return 0 on success, or -1 on failure.
+ */
+static int connect_sock_with_retry (int fd, const char *file, int retries)
+{
+    int count = 0;
+    struct sockaddr_un addr;
+    useconds_t s = 8 * 1000;
+    int maxdelay = 2000000;
+    do {
+        memset (&addr, 0, sizeof (struct sockaddr_un));
+        addr.sun_family = AF_UNIX;
+        if (strncpy (addr.sun_path, file, sizeof (addr.sun_path) - 1) < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (connect (fd, (struct sockaddr *)&addr, sizeof (addr)) == 0)
+            return 0;
+        if (s < maxdelay)
+            s = 2*s < maxdelay ? 2*s : maxdelay;
+    } while ((++count <= retries) && (usleep (s) == 0));
+    return -1;
+}
+
+/* Receive the memfd, broker eventfd, and client eventfd, attached to
+ * a single byte.
+ */
+static int recv_fds (int fd, int fds[3])
+{
+    char byte;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE (3 * sizeof (int))];
+    } control;
+    struct msghdr mh;
+    struct cmsghdr *cmsg;
+    ssize_t n;
+
+    memset (&mh, 0, sizeof (mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof (control.buf);
+    if ((n = recvmsg (fd, &mh, MSG_CMSG_CLOEXEC)) < 0)
+        return -1;
+    if (n == 0) {
+        errno = ECONNRESET;
+        return -1;
+    }
+    cmsg = CMSG_FIRSTHDR (&mh);
+    if (!cmsg || (mh.msg_flags & MSG_CTRUNC)
+              || cmsg->cmsg_level != SOL_SOCKET
+              || cmsg->cmsg_type != SCM_RIGHTS
+              || cmsg->cmsg_len != CMSG_LEN (3 * sizeof (int))) {
+        errno = EPROTO;
+        return -1;
+    }
+    memcpy (fds, CMSG_DATA (cmsg), 3 * sizeof (int));
+    return 0;
+}
+
+static int pollfd_add (int pollfd, int fd)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    return epoll_ctl (pollfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/* Ask connector-local to switch this connection to shared memory,
+ * then map the rings and set up the pollfd.
+ */
+static int shm_attach (shm_ctx_t *c)
+{
+    struct flux_msg_iobuf iobuf;
+    flux_msg_t *msg = NULL;
+    flux_msg_t *rmsg = NULL;
+    int fds[3] = { -1, -1, -1 };
+    int capacity;
+    size_t ringsize;
+    struct stat sb;
+    int i;
+    int rc = -1;
+
+    if (!(msg = flux_request_encode ("local.shm", NULL)))
+        goto done;
+    flux_msg_iobuf_init (&iobuf);
+    if (flux_msg_sendfd (c->fd, msg, &iobuf) < 0) {
+        flux_msg_iobuf_clean (&iobuf);
+        goto done;
+    }
+    flux_msg_iobuf_init (&iobuf);
+    if (!(rmsg = flux_msg_recvfd (c->fd, &iobuf))) {
+        flux_msg_iobuf_clean (&iobuf);
+        goto done;
+    }
+    if (flux_response_decode (rmsg, NULL, NULL) < 0)
+        goto done;
+    if (flux_msg_unpack (rmsg, "{s:i}", "capacity", &capacity) < 0)
+        goto done;
+    if (recv_fds (c->fd, fds) < 0)
+        goto done;
+    ringsize = shmring_memsize (capacity);
+    if (fstat (fds[0], &sb) < 0)
+        goto done;
+    if (capacity <= 0 || (size_t)sb.st_size < 2 * ringsize) {
+        errno = EPROTO;
+        goto done;
+    }
+    c->memsize = 2 * ringsize;
+    c->mem = mmap (NULL, c->memsize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fds[0], 0);
+    if (c->mem == MAP_FAILED) {
+        c->mem = NULL;
+        goto done;
+    }
+    if (!(c->tx = shmring_attach (c->mem, ringsize, capacity))
+        || !(c->rx = shmring_attach ((char *)c->mem + ringsize, ringsize,
+                                     capacity)))
+        goto done;
+    c->peer_efd = fds[1];
+    c->efd = fds[2];
+    fds[1] = fds[2] = -1;
+    if ((c->pollfd = epoll_create1 (EPOLL_CLOEXEC)) < 0)
+        goto done;
+    if (pollfd_add (c->pollfd, c->efd) < 0 || pollfd_add (c->pollfd, c->fd) < 0)
+        goto done;
+    rc = 0;
+done:
+    for (i = 0; i < 3; i++) {
+        if (fds[i] >= 0) {
+            int saved_errno = errno;
+            (void)close (fds[i]);
+            errno = saved_errno;
+        }
+    }
+    flux_msg_destroy (msg);
+    flux_msg_destroy (rmsg);
+    return rc;
+}
+
+/* Path is interpreted as the directory containing the unix domain socket.
+ */
+flux_t *connector_init (const char *path, int flags)
+{
+    shm_ctx_t *c = NULL;
+    char sockfile [SIZEOF_FIELD (struct sockaddr_un, sun_path)];
+    int n;
+    int retries = env_getint ("FLUX_LOCAL_CONNECTOR_RETRY_COUNT", 5);
+
+    if (!path) {
+        errno = EINVAL;
+        goto error;
+    }
+    n = snprintf (sockfile, sizeof (sockfile), "%s/local", path);
+    if (n >= sizeof (sockfile)) {
+        errno = EINVAL;
+        goto error;
+    }
+    if (!(c = malloc (sizeof (*c)))) {
+        errno = ENOMEM;
+        goto error;
+    }
+    memset (c, 0, sizeof (*c));
+    c->magic = CTX_MAGIC;
+    c->efd = c->peer_efd = c->pollfd = -1;
+
+    c->testing_userid = FLUX_USERID_UNKNOWN;
+    c->testing_rolemask = FLUX_ROLE_NONE;
+
+    c->fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (c->fd < 0)
+        goto error;
+    if (connect_sock_with_retry (c->fd, sockfile, retries) < 0)
+        goto error;
+    /* read 1 byte indicating success or failure of auth */
+    unsigned char e;
+    int rc;
+    rc = read (c->fd, &e, 1);
+    if (rc < 0)
+        goto error;
+    if (rc == 0) {
+        errno = ECONNRESET;
+        goto error;
+    }
+    if (e != 0) {
+        errno = e;
+        goto error;
+    }
+    if (shm_attach (c) < 0)
+        goto error;
+    if (!(c->h = flux_handle_create (c, &handle_ops, flags)))
+        goto error;
+    return c->h;
+error:
+    if (c) {
+        int saved_errno = errno;
+        op_fini (c);
+        errno = saved_errno;
+    }
+    return NULL;
+}
+
+static const struct flux_handle_ops handle_ops = {
+    .pollfd = op_pollfd,
+    .pollevents = op_pollevents,
+    .send = op_send,
+    .recv = op_recv,
+    .event_subscribe = op_event_subscribe,
+    .event_unsubscribe = op_event_unsubscribe,
+    .setopt = op_setopt,
+    .getopt = NULL,
+    .impl_destroy = op_fini,
+};
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -24,6 +24,9 @@
 #include <stdbool.h>
 #include <sys/un.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
 #include <ctype.h>
 #include <czmq.h>
 #include <inttypes.h>
@@ -32,6 +35,7 @@
 #include "src/common/libutil/cleanup.h"
 #include "src/common/libutil/iterators.h"
 #include "src/common/libutil/fdutils.h"
+#include "src/common/libutil/shmring.h"
 
 enum {
     DEBUG_AUTHFAIL_ONESHOT = 1, /* force auth to fail one time */
@@ -51,6 +55,7 @@ typedef struct {
     uid_t instance_owner;
     zhash_t *subscriptions;
     zhash_t *services;
+    size_t shm_msg_limit;
 } mod_local_ctx_t;
 
 typedef void (*unsubscribe_f)(void *handle, const char *topic);
@@ -62,13 +67,41 @@ typedef struct {
     void *handle;
 } subscription_t;
 
+/* Shared memory transport, requested by the client with local.shm once
+ * connected.  Messages are then exchanged through a pair of rings in a
+ * memfd mapping, client to server followed by server to client, and each
+ * side is woken by the other writing to its eventfd.  The socket remains
+ * open only to detect disconnect.  Messages from the client are limited
+ * to content.blob-size-limit plus CLIENT_SHM_MSG_SLACK bytes for headers,
+ * so that a client cannot grow the broker's reassembly buffer without bound.
+ */
+#define CLIENT_SHM_CAPACITY (1024*1024)
+#define CLIENT_SHM_BATCH    256
+#define CLIENT_SHM_MSG_SLACK (1024*1024)
+
+struct client_shm {
+    void *mem;
+    size_t memsize;
+    struct shmring *rx;     /* client to server */
+    struct shmring *tx;     /* server to client */
+    int efd;                /* written by client to wake server */
+    int peer_efd;           /* written by server to wake client */
+    flux_watcher_t *w;
+    void *rxbuf;            /* private copy of record being decoded */
+    size_t rxbuf_size;
+    void *txbuf;            /* message being written in fragments */
+    size_t txbuf_size;
+    size_t txbuf_offset;
+};
+
 typedef struct {
     int fd;
     flux_watcher_t *inw;
     flux_watcher_t *outw;
-    struct flux_msg_iobuf inbuf;
+    struct flux_msg_reader *reader;
     struct flux_msg_iobuf outbuf;
     zlist_t *outqueue;  /* queue of outbound flux_msg_t */
+    struct client_shm *shm;
     mod_local_ctx_t *ctx;
     zhash_t *disconnect_notify;
     zhash_t *subscriptions;
@@ -95,6 +128,9 @@ static void client_read_cb (flux_reactor_t *r, flux_watcher_t *w,
                             int revents, void *arg);
 static void client_write_cb (flux_reactor_t *r, flux_watcher_t *w,
                             int revents, void *arg);
+static void client_shm_cb (flux_reactor_t *r, flux_watcher_t *w,
+                           int revents, void *arg);
+static int client_shm_send_try (client_t *c);
 
 static void freectx (void *arg)
 {
@@ -132,6 +168,7 @@ static mod_local_ctx_t *getctx (flux_t *h)
             goto error;
         }
         ctx->instance_owner = geteuid ();
+        ctx->shm_msg_limit = SHMRING_RECORD_LIMIT;
         if (flux_aux_set (h, "flux::local_connector", ctx, freectx) < 0)
             goto error;
     }
@@ -238,8 +275,9 @@ static client_t * client_create (mod_local_ctx_t *ctx, int fd)
     c->disconnect_notify = zhash_new ();
     c->subscriptions = zhash_new ();
     c->outqueue = zlist_new ();
+    c->reader = flux_msg_reader_create ();
     if (!c->uuid || !c->disconnect_notify || !c->subscriptions
-                                          || !c->outqueue) {
+                                          || !c->outqueue || !c->reader) {
         errno = ENOMEM;
         goto error;
     }
@@ -253,7 +291,6 @@ static client_t * client_create (mod_local_ctx_t *ctx, int fd)
                                             client_write_cb, c)))
         goto error;
     flux_watcher_start (c->inw);
-    flux_msg_iobuf_init (&c->inbuf);
     flux_msg_iobuf_init (&c->outbuf);
     if (send_auth_response (fd, 0) < 0)
         goto error_noresponse;
@@ -268,25 +305,206 @@ error_noresponse:
     return NULL;
 }
 
+/* Send as much of the outqueue as the client will accept, coalescing
+ * up to CLIENT_SEND_BATCH messages per write.  If the client is not ready,
+ * the remainder is sent from client_write_cb() when it becomes writable.
+ */
+#define CLIENT_SEND_BATCH   64
+
 static int client_send_try (client_t *c)
 {
-    flux_msg_t *msg = zlist_head (c->outqueue);
+    const flux_msg_t *msgs[CLIENT_SEND_BATCH];
+    flux_msg_t *msg;
+    int count, n, i;
+
+    if (c->shm)
+        return client_shm_send_try (c);
+    do {
+        count = 0;
+        msg = zlist_first (c->outqueue);
+        while (msg && count < CLIENT_SEND_BATCH) {
+            msgs[count++] = msg;
+            msg = zlist_next (c->outqueue);
+        }
+        if ((n = flux_msg_sendfd_batch (c->fd, msgs, count, &c->outbuf)) < 0)
+            return -1;
+        for (i = 0; i < n; i++) {
+            msg = zlist_pop (c->outqueue);
+            flux_msg_destroy (msg);
+        }
+    } while (n == CLIENT_SEND_BATCH);
+    if (zlist_size (c->outqueue) > 0) {
+        //flux_log (c->ctx->h, LOG_DEBUG, "send: client not ready");
+        flux_watcher_start (c->outw);
+    }
+    return 0;
+}
+
+static void efd_signal (int fd)
+{
+    uint64_t val = 1;
+    (void)write (fd, &val, sizeof (val));
+}
+
+static void client_shm_destroy (struct client_shm *shm)
+{
+    if (shm) {
+        int saved_errno = errno;
+        flux_watcher_stop (shm->w);
+        flux_watcher_destroy (shm->w);
+        shmring_detach (shm->rx);
+        shmring_detach (shm->tx);
+        if (shm->mem)
+            (void)munmap (shm->mem, shm->memsize);
+        if (shm->efd >= 0)
+            (void)close (shm->efd);
+        if (shm->peer_efd >= 0)
+            (void)close (shm->peer_efd);
+        free (shm->rxbuf);
+        free (shm->txbuf);
+        free (shm);
+        errno = saved_errno;
+    }
+}
+
+#if HAVE_MEMFD_CREATE
+/* Create the shared mapping and eventfds.  The memfd is sealed so that
+ * the client cannot resize it out from under the broker's mapping.
+ * The memfd is returned in 'memfdp' to be passed to the client.
+ */
+static struct client_shm *client_shm_create (client_t *c, int *memfdp)
+{
+    size_t ringsize = shmring_memsize (CLIENT_SHM_CAPACITY);
+    struct client_shm *shm;
+    int memfd = -1;
+
+    if (!(shm = calloc (1, sizeof (*shm)))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    shm->efd = shm->peer_efd = -1;
+    shm->memsize = 2 * ringsize;
+    if ((memfd = memfd_create ("flux-local-shm",
+                               MFD_CLOEXEC | MFD_ALLOW_SEALING)) < 0)
+        goto error;
+    if (ftruncate (memfd, shm->memsize) < 0)
+        goto error;
+    if (fcntl (memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+                                                 | F_SEAL_SEAL) < 0)
+        goto error;
+    shm->mem = mmap (NULL, shm->memsize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, memfd, 0);
+    if (shm->mem == MAP_FAILED) {
+        shm->mem = NULL;
+        goto error;
+    }
+    if (shmring_init (shm->mem, CLIENT_SHM_CAPACITY) < 0
+        || shmring_init ((char *)shm->mem + ringsize, CLIENT_SHM_CAPACITY) < 0)
+        goto error;
+    if (!(shm->rx = shmring_attach (shm->mem, ringsize, CLIENT_SHM_CAPACITY))
+        || !(shm->tx = shmring_attach ((char *)shm->mem + ringsize, ringsize,
+                                       CLIENT_SHM_CAPACITY)))
+        goto error;
+    shmring_set_record_limit (shm->rx, c->ctx->shm_msg_limit);
+    if ((shm->efd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0
+        || (shm->peer_efd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        goto error;
+    if (!(shm->w = flux_fd_watcher_create (c->ctx->reactor, shm->efd,
+                                           FLUX_POLLIN, client_shm_cb, c)))
+        goto error;
+    *memfdp = memfd;
+    return shm;
+error:
+    if (memfd >= 0) {
+        int saved_errno = errno;
+        (void)close (memfd);
+        errno = saved_errno;
+    }
+    client_shm_destroy (shm);
+    return NULL;
+}
+#else
+static struct client_shm *client_shm_create (client_t *c, int *memfdp)
+{
+    errno = ENOSYS;
+    return NULL;
+}
+#endif
+
+/* Write 'msg' to the server to client ring, in place if it fits in one
+ * record, otherwise from an encoded copy in fragments.
+ * Returns 0 on success, -1 with errno = EAGAIN if the ring is full.
+ */
+static int client_shm_send (struct client_shm *shm, const flux_msg_t *msg)
+{
+    if (!shm->txbuf) {
+        size_t size = flux_msg_encode_size (msg);
+        void *p;
 
-    if (msg) {
-        if (flux_msg_sendfd (c->fd, msg, &c->outbuf) < 0) {
-            if (errno != EWOULDBLOCK && errno != EAGAIN)
+        if (size <= shmring_record_max (shm->tx)) {
+            if (!(p = shmring_reserve (shm->tx, size)))
+                return -1;
+            if (flux_msg_encode (msg, p, size) < 0)
                 return -1;
-            //flux_log (c->ctx->h, LOG_DEBUG, "send: client not ready");
-            flux_watcher_start (c->outw);
-            errno = 0;
-        } else {
+            shmring_commit (shm->tx);
+            return 0;
+        }
+        if (!(shm->txbuf = malloc (size))) {
+            errno = ENOMEM;
+            return -1;
+        }
+        if (flux_msg_encode (msg, shm->txbuf, size) < 0) {
+            free (shm->txbuf);
+            shm->txbuf = NULL;
+            return -1;
+        }
+        shm->txbuf_size = size;
+        shm->txbuf_offset = 0;
+    }
+    if (shmring_write (shm->tx, shm->txbuf, shm->txbuf_size,
+                       &shm->txbuf_offset) < 0)
+        return -1;
+    free (shm->txbuf);
+    shm->txbuf = NULL;
+    return 0;
+}
+
+/* Write as much of the outqueue to the ring as fits.  If the ring fills,
+ * the client wakes client_shm_cb() once it has made room.
+ */
+static int client_shm_send_try (client_t *c)
+{
+    struct client_shm *shm = c->shm;
+    flux_msg_t *msg;
+    size_t size;
+
+    for (;;) {
+        while ((msg = zlist_first (c->outqueue))) {
+            if (client_shm_send (shm, msg) < 0) {
+                if (errno != EAGAIN)
+                    return -1;
+                break;
+            }
             msg = zlist_pop (c->outqueue);
             flux_msg_destroy (msg);
         }
+        if (shmring_wake_consumer (shm->tx))
+            efd_signal (shm->peer_efd);
+        if (!msg)
+            break;
+        if (shm->txbuf)
+            size = shm->txbuf_size - shm->txbuf_offset;
+        else
+            size = flux_msg_encode_size (msg);
+        if (shmring_wait_writable (shm->tx, size))
+            break;
     }
     return 0;
 }
 
+/* If a backlog is already waiting for the client to become writable,
+ * just add to it, so that it is sent with the backlog in one write.
+ */
 static int client_send_nocopy (client_t *c, flux_msg_t **msg)
 {
     if (zlist_append (c->outqueue, *msg) < 0) {
@@ -294,6 +512,8 @@ static int client_send_nocopy (client_t *c, flux_msg_t **msg)
         return -1;
     }
     *msg = NULL;
+    if (zlist_size (c->outqueue) > 1)
+        return 0;
     return client_send_try (c);
 }
 
@@ -898,7 +1118,8 @@ static void client_destroy (client_t *c)
 
         flux_watcher_stop (c->inw);
         flux_watcher_destroy (c->inw);
-        flux_msg_iobuf_clean (&c->inbuf);
+        flux_msg_reader_destroy (c->reader);
+        client_shm_destroy (c->shm);
 
         if (c->fd != -1)
             close (c->fd);
@@ -969,43 +1190,113 @@ done:
     return true;
 }
 
-static void client_read_cb (flux_reactor_t *r, flux_watcher_t *w,
-                            int revents, void *arg)
+/* Send the memfd and eventfds to the client, attached to a single byte.
+ */
+static int send_fds (int fd, int fds[3])
+{
+    char byte = 0;
+    struct iovec iov = { .iov_base = &byte, .iov_len = 1 };
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE (3 * sizeof (int))];
+    } control;
+    struct msghdr mh;
+    struct cmsghdr *cmsg;
+
+    memset (&control, 0, sizeof (control));
+    memset (&mh, 0, sizeof (mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof (control.buf);
+    cmsg = CMSG_FIRSTHDR (&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN (3 * sizeof (int));
+    memcpy (CMSG_DATA (cmsg), fds, 3 * sizeof (int));
+    if (sendmsg (fd, &mh, 0) != 1)
+        return -1;
+    return 0;
+}
+
+/* Client 'c' has sent a local.shm request.  The response is written
+ * directly to the socket, followed on success by one byte carrying the
+ * memfd, the server eventfd, and the client eventfd.  Thereafter, the
+ * socket carries no messages.
+ * Returns -1 if the client should be disconnected.
+ */
+static int shm_request (client_t *c, const flux_msg_t *msg)
 {
-    client_t *c = arg;
     flux_t *h = c->ctx->h;
-    flux_msg_t *msg = NULL;
-    int type;
-    uint32_t userid, rolemask;
+    struct client_shm *shm = NULL;
+    struct flux_msg_iobuf iobuf;
+    flux_msg_t *rmsg = NULL;
+    uint32_t matchtag;
+    int memfd = -1;
+    int rc = -1;
 
-    if (revents & FLUX_POLLERR)
-        goto error_disconnect;
-    if (!(revents & FLUX_POLLIN))
-        return;
-    /* EPROTO, ECONNRESET are normal disconnect errors
-     * EWOULDBLOCK, EAGAIN stores state in c->inbuf for continuation
+    /* Nothing may be queued ahead of the response on the socket.
      */
-    //flux_log (h, LOG_DEBUG, "recv: client ready");
-    if (!(msg = flux_msg_recvfd (c->fd, &c->inbuf))) {
-        if (errno == EWOULDBLOCK || errno == EAGAIN) {
-            //flux_log (h, LOG_DEBUG, "recv: client not ready");
-            return;
-        }
-        if (errno != ECONNRESET && errno != EPROTO)
-            flux_log_error (h, "flux_msg_recvfd");
-        goto error_disconnect;
+    if (c->shm || zlist_size (c->outqueue) > 0) {
+        errno = EBUSY;
+        goto error_respond;
+    }
+    if (!(shm = client_shm_create (c, &memfd)))
+        goto error_respond;
+    /* The ring is empty, so the client must wake us for the first message.
+     */
+    (void)shmring_wait_readable (shm->rx);
+    if (!(rmsg = flux_response_encode ("local.shm", NULL))
+        || flux_msg_pack (rmsg, "{s:i}", "capacity", CLIENT_SHM_CAPACITY) < 0
+        || flux_msg_get_matchtag (msg, &matchtag) < 0
+        || flux_msg_set_matchtag (rmsg, matchtag) < 0
+        || flux_msg_set_rolemask (rmsg, FLUX_ROLE_OWNER) < 0)
+        goto error_respond;
+    flux_msg_iobuf_init (&iobuf);
+    if (flux_msg_sendfd (c->fd, rmsg, &iobuf) < 0
+        || send_fds (c->fd, (int[]){ memfd, shm->efd, shm->peer_efd }) < 0) {
+        flux_log_error (h, "%s: error sending response", __FUNCTION__);
+        flux_msg_iobuf_clean (&iobuf);
+        goto done;
     }
+    flux_watcher_start (shm->w);
+    c->shm = shm;
+    shm = NULL;
+    rc = 0;
+    goto done;
+error_respond:
+    if (client_respond (c, msg, errno) < 0)
+        flux_log_error (h, "%s: client_respond", __FUNCTION__);
+    rc = 0;
+done:
+    if (memfd >= 0)
+        (void)close (memfd);
+    client_shm_destroy (shm);
+    flux_msg_destroy (rmsg);
+    return rc;
+}
+
+/* Handle message 'msg' received from client 'c'.
+ * Returns -1 if the client should be disconnected, otherwise 0.
+ */
+static int client_recv_msg (client_t *c, flux_msg_t *msg)
+{
+    flux_t *h = c->ctx->h;
+    int type;
+    const char *topic;
+    uint32_t userid, rolemask;
+
     if (flux_msg_get_type (msg, &type) < 0) {
         flux_log_error (h, "flux_msg_get_type");
-        goto error;
+        return 0;
     }
     if (flux_msg_get_userid (msg, &userid) < 0) {
         flux_log_error (h, "flux_msg_get_userid");
-        goto error;
+        return 0;
     }
     if (flux_msg_get_rolemask (msg, &rolemask) < 0) {
         flux_log_error (h, "flux_msg_get_rolemask");
-        goto error;
+        return 0;
     }
     if (rolemask == FLUX_ROLE_NONE)
         rolemask = c->rolemask;
@@ -1021,36 +1312,39 @@ static void client_read_cb (flux_reactor_t *r, flux_watcher_t *w,
                 if (flux_respond (h, msg, EPERM, NULL) < 0)
                     flux_log_error (h, "error sending EPERM response");
             } /* else drop */
-            goto done;
+            return 0;
         }
     }
     if (flux_msg_set_userid (msg, userid) < 0) {
         flux_log_error (h, "flux_msg_set_userid");
-        goto error_disconnect;
+        return -1;
     }
     if (flux_msg_set_rolemask (msg, rolemask) < 0) {
         flux_log_error (h, "flux_msg_set_rolemask");
-        goto error_disconnect;
+        return -1;
     }
     switch (type) {
         case FLUX_MSGTYPE_REQUEST:
+            if (flux_msg_get_topic (msg, &topic) == 0
+                                        && !strcmp (topic, "local.shm"))
+                return shm_request (c, msg);
             if (!internal_request (c, msg)) {
                 /* insert disconnect notifier before forwarding request */
                 if (c->disconnect_notify && disconnect_update (c, msg) < 0) {
                     flux_log_error (h, "disconnect_update");
-                    goto error;
+                    return 0;
                 }
                 if (flux_msg_enable_route (msg) < 0) {
                     flux_log_error (h, "flux_msg_enable_route");
-                    goto error;
+                    return 0;
                 }
                 if (flux_msg_push_route (msg, zuuid_str (c->uuid)) < 0) {
                     flux_log_error (h, "flux_msg_push_route");
-                    goto error;
+                    return 0;
                 }
                 if (flux_send (h, msg, 0) < 0) {
                     flux_log_error (h, "%s: flux_send", __FUNCTION__);
-                    goto error;
+                    return 0;
                 }
             }
             break;
@@ -1058,22 +1352,121 @@ static void client_read_cb (flux_reactor_t *r, flux_watcher_t *w,
         case FLUX_MSGTYPE_RESPONSE:
             if (flux_send (h, msg, 0) < 0) {
                 flux_log_error (h, "%s: flux_send", __FUNCTION__);
-                goto error;
+                return 0;
             }
             break;
         default:
             flux_log (h, LOG_ERR, "drop unexpected %s",
                       flux_msg_typestr (type));
-            goto error;
+            return 0;
+    }
+    return 0;
+}
+
+static void client_read_cb (flux_reactor_t *r, flux_watcher_t *w,
+                            int revents, void *arg)
+{
+    client_t *c = arg;
+    flux_t *h = c->ctx->h;
+    flux_msg_t *msg;
+    int rc;
+
+    if (revents & FLUX_POLLERR)
+        goto error_disconnect;
+    if (!(revents & FLUX_POLLIN))
+        return;
+    /* EPROTO, ECONNRESET are normal disconnect errors
+     * EWOULDBLOCK, EAGAIN stores state in c->reader for continuation
+     * Handle all messages that are complete after one read, since the
+     * socket will not become readable again for those already buffered.
+     */
+    //flux_log (h, LOG_DEBUG, "recv: client ready");
+    do {
+        if (!(msg = flux_msg_reader_recv (c->reader, c->fd))) {
+            if (errno == EWOULDBLOCK || errno == EAGAIN) {
+                //flux_log (h, LOG_DEBUG, "recv: client not ready");
+                return;
+            }
+            if (errno != ECONNRESET && errno != EPROTO)
+                flux_log_error (h, "flux_msg_reader_recv");
+            goto error_disconnect;
+        }
+        rc = client_recv_msg (c, msg);
+        flux_msg_destroy (msg);
+        if (rc < 0)
+            goto error_disconnect;
+    } while (flux_msg_reader_pending (c->reader));
+    return;
+error_disconnect:
+    zlist_remove (c->ctx->clients, c);
+    client_destroy (c);
+}
+
+/* The client has written to the ring or made room in it.
+ * Handle at most CLIENT_SHM_BATCH messages before returning to the
+ * reactor, as client_read_cb() is limited by what one read returns.
+ */
+static void client_shm_cb (flux_reactor_t *r, flux_watcher_t *w,
+                           int revents, void *arg)
+{
+    client_t *c = arg;
+    struct client_shm *shm = c->shm;
+    flux_t *h = c->ctx->h;
+    uint64_t val;
+    const void *rec;
+    size_t size;
+    flux_msg_t *msg;
+    int count = 0;
+    int rc;
+
+    if (read (shm->efd, &val, sizeof (val)) < 0 && errno != EAGAIN) {
+        flux_log_error (h, "%s: read eventfd", __FUNCTION__);
+        goto error_disconnect;
+    }
+    while (count++ < CLIENT_SHM_BATCH) {
+        if (!(rec = shmring_peek (shm->rx, &size))) {
+            if (errno == EAGAIN)
+                break;
+            flux_log_error (h, "%s: shmring_peek", __FUNCTION__);
+            goto error_disconnect;
+        }
+        /* Decode from a private copy, since the client could modify
+         * the record while it is being decoded.
+         */
+        if (size > shm->rxbuf_size) {
+            void *p;
+            if (!(p = realloc (shm->rxbuf, size))) {
+                flux_log_error (h, "%s: realloc", __FUNCTION__);
+                goto error_disconnect;
+            }
+            shm->rxbuf = p;
+            shm->rxbuf_size = size;
+        }
+        memcpy (shm->rxbuf, rec, size);
+        shmring_consume (shm->rx);
+        if (!(msg = flux_msg_decode (shm->rxbuf, size))) {
+            flux_log_error (h, "%s: flux_msg_decode", __FUNCTION__);
+            goto error_disconnect;
+        }
+        rc = client_recv_msg (c, msg);
+        flux_msg_destroy (msg);
+        if (rc < 0)
+            goto error_disconnect;
+    }
+    if (shmring_wake_producer (shm->rx))
+        efd_signal (shm->peer_efd);
+    /* If messages remain, wake again after other watchers have run.
+     */
+    if (count > CLIENT_SHM_BATCH || !shmring_wait_readable (shm->rx))
+        efd_signal (shm->efd);
+    if (zlist_size (c->outqueue) > 0 && client_shm_send_try (c) < 0) {
+        flux_log_error (h, "%s: client_shm_send_try", __FUNCTION__);
+        goto error_disconnect;
     }
-done:
-    flux_msg_destroy (msg);
     return;
 error_disconnect:
     zlist_remove (c->ctx->clients, c);
     client_destroy (c);
-error:
-    flux_msg_destroy (msg);
 }
 
 /* Determine if message can be routed to client.
@@ -1258,6 +1651,7 @@ int mod_main (flux_t *h, int argc, char **argv)
     mod_local_ctx_t *ctx = getctx (h);
     char sockpath[PATH_MAX + 1];
     const char *local_uri = NULL;
+    const char *blob_limit;
     char *tmpdir;
     flux_msg_handler_t **handlers = NULL;
     int rc = -1;
@@ -1274,6 +1668,9 @@ int mod_main (flux_t *h, int argc, char **argv)
     }
     tmpdir += strlen ("local://");
     snprintf (sockpath, sizeof (sockpath), "%s/local", tmpdir);
+    if ((blob_limit = flux_attr_get (h, "content.blob-size-limit")))
+        ctx->shm_msg_limit = strtoul (blob_limit, NULL, 10)
+                             + CLIENT_SHM_MSG_SLACK;
 
     /* Create listen socket and watcher to handle new connections
      */
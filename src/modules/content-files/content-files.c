@@ -0,0 +1,850 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* content-files.c - content addressable storage in append-only files
+ *
+ * Blobs are appended to segment files of at most 'segment_size' bytes.
+ * Each record is a fixed header followed by the hash digest and the blob:
+ *
+ *   [magic:4][size:4][hash:hash_len][data:size]
+ *
+ * with integers in network byte order.  An in-memory index maps blobref
+ * to (segment, offset, size).  It is rebuilt at load time by scanning
+ * the segments; the digest of each record in the last (active) segment
+ * is verified, and a torn record at its tail is truncated.
+ *
+ * Segments are mmapped read-only for their maximum size, so loads are
+ * answered directly from the mapping, and appends made with write(2)
+ * are visible through it without remapping.  A blob too large for a
+ * segment gets a segment of its own, sized to fit.
+ *
+ * Content is never deleted, so dead records only arise from duplicates
+ * or torn records left by an unclean shutdown.  Sealed segments whose
+ * dead fraction exceeds 'compact_threshold' are compacted from an idle
+ * watcher, a few records per iteration, by copying their live records
+ * to the active segment and unlinking them.  The watcher runs at load
+ * time, and again whenever a segment is sealed, since the active segment
+ * may hold dead records recovered at load time.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+#include <czmq.h>
+#include <jansson.h>
+#include <flux/core.h>
+
+#include "src/common/libutil/blobref.h"
+#include "src/common/libutil/cleanup.h"
+#include "src/common/libutil/log.h"
+#include "src/common/libutil/monotime.h"
+
+#define RECORD_MAGIC        0x666c7843  /* "flxC" */
+#define RECORD_HEADER_SIZE  8
+
+const size_t default_segment_size = 64*1024*1024;
+const size_t min_segment_size = 4096;
+const double default_compact_threshold = 0.5;
+const int compact_batch_size = 64;  /* records per idle callback */
+
+#define DUMP_BATCH_SIZE 256         /* blobs per content.store-batch */
+const int dump_window = 8;          /* max outstanding store-batch RPCs */
+
+struct segment {
+    int id;
+    int fd;
+    uint8_t *map;
+    size_t map_size;
+    size_t size;            /* bytes written */
+    size_t live;            /* bytes in live records */
+};
+
+struct entry {
+    struct segment *seg;
+    uint32_t offset;        /* offset of record header */
+    uint32_t size;          /* blob size */
+};
+
+typedef struct {
+    flux_t *h;
+    char *dir;
+    const char *hashfun;
+    int hash_len;
+    uint32_t blob_size_limit;
+    size_t segment_size;
+    double compact_threshold;
+    zhash_t *index;         /* blobref => struct entry */
+    zlist_t *segments;      /* ordered by id; tail is active */
+    struct segment *active;
+    int next_id;
+    struct segment *compact_seg;
+    size_t compact_off;
+    flux_watcher_t *compact_w;
+    bool broker_shutdown;
+} files_ctx_t;
+
+static size_t record_size (files_ctx_t *ctx, uint32_t size)
+{
+    return RECORD_HEADER_SIZE + ctx->hash_len + size;
+}
+
+static void segment_destroy (struct segment *seg)
+{
+    if (seg) {
+        int saved_errno = errno;
+        if (seg->map != MAP_FAILED && seg->map != NULL)
+            (void)munmap (seg->map, seg->map_size);
+        if (seg->fd >= 0)
+            (void)close (seg->fd);
+        free (seg);
+        errno = saved_errno;
+    }
+}
+
+static char *segment_path (files_ctx_t *ctx, int id)
+{
+    char *path;
+    if (asprintf (&path, "%s/%08d.seg", ctx->dir, id) < 0)
+        return NULL;
+    return path;
+}
+
+/* Open (creating if needed) segment 'id' and map it, for at least
+ * 'min_size' bytes.
+ */
+static struct segment *segment_open (files_ctx_t *ctx, int id,
+                                     size_t min_size)
+{
+    struct segment *seg;
+    struct stat sb;
+    char *path;
+
+    if (!(seg = calloc (1, sizeof (*seg))))
+        return NULL;
+    seg->id = id;
+    seg->fd = -1;
+    if (!(path = segment_path (ctx, id)))
+        goto error;
+    seg->fd = open (path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    free (path);
+    if (seg->fd < 0 || fstat (seg->fd, &sb) < 0)
+        goto error;
+    seg->size = sb.st_size;
+    seg->map_size = seg->size > ctx->segment_size ? seg->size
+                                                  : ctx->segment_size;
+    if (seg->map_size < min_size)
+        seg->map_size = min_size;
+    seg->map = mmap (NULL, seg->map_size, PROT_READ, MAP_SHARED, seg->fd, 0);
+    if (seg->map == MAP_FAILED)
+        goto error;
+    return seg;
+error:
+    segment_destroy (seg);
+    return NULL;
+}
+
+static int segment_unlink (files_ctx_t *ctx, struct segment *seg)
+{
+    char *path;
+    int rc;
+
+    if (!(path = segment_path (ctx, seg->id)))
+        return -1;
+    rc = unlink (path);
+    free (path);
+    return rc;
+}
+
+static void freectx (void *arg)
+{
+    files_ctx_t *ctx = arg;
+    if (ctx) {
+        int saved_errno = errno;
+        struct segment *seg;
+        flux_watcher_destroy (ctx->compact_w);
+        zhash_destroy (&ctx->index);
+        if (ctx->segments) {
+            while ((seg = zlist_pop (ctx->segments)))
+                segment_destroy (seg);
+            zlist_destroy (&ctx->segments);
+        }
+        free (ctx->dir);
+        free (ctx);
+        errno = saved_errno;
+    }
+}
+
+static int index_insert (files_ctx_t *ctx, const char *blobref,
+                         struct segment *seg, uint32_t offset, uint32_t size)
+{
+    struct entry *e;
+
+    if (!(e = calloc (1, sizeof (*e))))
+        return -1;
+    e->seg = seg;
+    e->offset = offset;
+    e->size = size;
+    if (zhash_insert (ctx->index, blobref, e) < 0) {
+        free (e);
+        errno = EEXIST;
+        return -1;
+    }
+    zhash_freefn (ctx->index, blobref, free);
+    seg->live += record_size (ctx, size);
+    return 0;
+}
+
+/* Decode the record at 'offset' in 'seg', returning a pointer to the
+ * digest and setting 'size'.  Returns NULL if the record is incomplete
+ * or invalid.
+ */
+static const uint8_t *record_decode (files_ctx_t *ctx, struct segment *seg,
+                                     size_t offset, uint32_t *size)
+{
+    uint32_t magic, nsize;
+
+    if (seg->size - offset < RECORD_HEADER_SIZE + ctx->hash_len)
+        return NULL;
+    memcpy (&magic, seg->map + offset, 4);
+    memcpy (&nsize, seg->map + offset + 4, 4);
+    if (ntohl (magic) != RECORD_MAGIC)
+        return NULL;
+    *size = ntohl (nsize);
+    if (*size > seg->size - offset - RECORD_HEADER_SIZE - ctx->hash_len)
+        return NULL;
+    return seg->map + offset + RECORD_HEADER_SIZE;
+}
+
+/* Add records in 'seg' to the index.  If 'verify' is true, check each
+ * record's digest against its data and truncate the segment at the
+ * first bad record.
+ */
+static int segment_scan (files_ctx_t *ctx, struct segment *seg, bool verify)
+{
+    size_t offset = 0;
+    const uint8_t *hash;
+    uint32_t size;
+
+    while (offset < seg->size) {
+        char blobref[BLOBREF_MAX_STRING_SIZE];
+
+        if (!(hash = record_decode (ctx, seg, offset, &size)))
+            break;
+        if (verify) {
+            char actual[BLOBREF_MAX_STRING_SIZE];
+            if (blobref_hash (ctx->hashfun, (uint8_t *)hash + ctx->hash_len,
+                              size, actual, sizeof (actual)) < 0)
+                return -1;
+            if (blobref_hashtostr (ctx->hashfun, hash, ctx->hash_len,
+                                   blobref, sizeof (blobref)) < 0)
+                return -1;
+            if (strcmp (actual, blobref) != 0)
+                break;
+        }
+        else if (blobref_hashtostr (ctx->hashfun, hash, ctx->hash_len,
+                                    blobref, sizeof (blobref)) < 0)
+            return -1;
+        if (index_insert (ctx, blobref, seg, offset, size) < 0
+                                                    && errno != EEXIST)
+            return -1;
+        offset += record_size (ctx, size);
+    }
+    if (offset < seg->size) {
+        flux_log (ctx->h, LOG_ERR, "segment %d: bad record at offset %zu",
+                  seg->id, offset);
+        if (verify) {
+            if (ftruncate (seg->fd, offset) < 0)
+                return -1;
+            flux_log (ctx->h, LOG_INFO, "segment %d: truncated %zu bytes",
+                      seg->id, seg->size - offset);
+            seg->size = offset;
+        }
+    }
+    return 0;
+}
+
+static int segment_id_cmp (const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Open existing segments in id order and rebuild the index.
+ * Appends resume in the last segment.
+ */
+static int segments_recover (files_ctx_t *ctx)
+{
+    DIR *dir;
+    struct dirent *d;
+    int *ids = NULL;
+    int count = 0;
+    int i;
+    int rc = -1;
+
+    if (!(dir = opendir (ctx->dir)))
+        return -1;
+    while ((d = readdir (dir))) {
+        int id;
+        char suffix[8];
+        int *new_ids;
+
+        if (sscanf (d->d_name, "%d.%7s", &id, suffix) != 2
+                                        || strcmp (suffix, "seg") != 0)
+            continue;
+        if (!(new_ids = realloc (ids, (count + 1) * sizeof (ids[0]))))
+            goto done;
+        ids = new_ids;
+        ids[count++] = id;
+    }
+    qsort (ids, count, sizeof (ids[0]), segment_id_cmp);
+    for (i = 0; i < count; i++) {
+        struct segment *seg;
+
+        if (!(seg = segment_open (ctx, ids[i], 0)))
+            goto done;
+        if (zlist_append (ctx->segments, seg) < 0) {
+            segment_destroy (seg);
+            errno = ENOMEM;
+            goto done;
+        }
+        if (segment_scan (ctx, seg, i == count - 1) < 0)
+            goto done;
+        ctx->next_id = seg->id + 1;
+        ctx->active = seg;
+    }
+    rc = 0;
+done:
+    free (ids);
+    closedir (dir);
+    return rc;
+}
+
+static bool compact_wanted (files_ctx_t *ctx, struct segment *seg)
+{
+    return seg != ctx->active
+        && (seg->size == 0
+            || seg->size - seg->live > seg->size * ctx->compact_threshold);
+}
+
+/* Seal the active segment and start a new one with room for at least
+ * 'min_size' bytes.  Restart compaction if the sealed segment needs it.
+ */
+static int segment_roll (files_ctx_t *ctx, size_t min_size)
+{
+    struct segment *seg;
+    struct segment *sealed = ctx->active;
+
+    if (!(seg = segment_open (ctx, ctx->next_id, min_size)))
+        return -1;
+    if (zlist_append (ctx->segments, seg) < 0) {
+        segment_destroy (seg);
+        errno = ENOMEM;
+        return -1;
+    }
+    ctx->next_id++;
+    ctx->active = seg;
+    if (sealed && ctx->compact_w && compact_wanted (ctx, sealed))
+        flux_watcher_start (ctx->compact_w);
+    return 0;
+}
+
+/* Append a record to the active segment, rolling to a new one if full.
+ */
+static int record_append (files_ctx_t *ctx, const uint8_t *hash,
+                          const void *data, uint32_t size,
+                          struct segment **segp, uint32_t *offsetp)
+{
+    uint32_t hdr[2] = { htonl (RECORD_MAGIC), htonl (size) };
+    struct iovec iov[3];
+    size_t len = record_size (ctx, size);
+    ssize_t n;
+
+    if (!ctx->active || ctx->active->size + len > ctx->active->map_size) {
+        if (segment_roll (ctx, len) < 0)
+            return -1;
+    }
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = sizeof (hdr);
+    iov[1].iov_base = (void *)hash;
+    iov[1].iov_len = ctx->hash_len;
+    iov[2].iov_base = (void *)data;
+    iov[2].iov_len = size;
+    if ((n = writev (ctx->active->fd, iov, 3)) != len) {
+        int saved_errno = n < 0 ? errno : EIO;
+        (void)ftruncate (ctx->active->fd, ctx->active->size);
+        errno = saved_errno;
+        return -1;
+    }
+    *segp = ctx->active;
+    *offsetp = ctx->active->size;
+    ctx->active->size += len;
+    return 0;
+}
+
+static files_ctx_t *getctx (flux_t *h)
+{
+    files_ctx_t *ctx = flux_aux_get (h, "flux::content-files");
+    const char *dir;
+    const char *tmp;
+    bool cleanup = false;
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+
+    if (!ctx) {
+        if (!(ctx = calloc (1, sizeof (*ctx))))
+            goto error;
+        ctx->h = h;
+        ctx->segment_size = default_segment_size;
+        ctx->compact_threshold = default_compact_threshold;
+        if (!(ctx->index = zhash_new ()) || !(ctx->segments = zlist_new ())) {
+            errno = ENOMEM;
+            goto error;
+        }
+        if (!(ctx->hashfun = flux_attr_get (h, "content.hash"))) {
+            flux_log_error (h, "content.hash");
+            goto error;
+        }
+        if (blobref_hash (ctx->hashfun, (uint8_t *)"", 0, blobref,
+                          sizeof (blobref)) < 0
+                || (ctx->hash_len = blobref_strtohash (blobref, hash,
+                                                       sizeof (hash))) < 0) {
+            flux_log_error (h, "content.hash=%s", ctx->hashfun);
+            goto error;
+        }
+        if (!(tmp = flux_attr_get (h, "content.blob-size-limit"))) {
+            flux_log_error (h, "content.blob-size-limit");
+            goto error;
+        }
+        ctx->blob_size_limit = strtoul (tmp, NULL, 10);
+
+        if (!(dir = flux_attr_get (h, "persist-directory"))) {
+            if (!(dir = flux_attr_get (h, "broker.rundir"))) {
+                flux_log_error (h, "broker.rundir");
+                goto error;
+            }
+            cleanup = true;
+        }
+        if (asprintf (&ctx->dir, "%s/content-files", dir) < 0)
+            goto error;
+        if (mkdir (ctx->dir, 0755) < 0 && errno != EEXIST) {
+            flux_log_error (h, "mkdir %s", ctx->dir);
+            goto error;
+        }
+        if (cleanup)
+            cleanup_push_string (cleanup_directory_recursive, ctx->dir);
+        if (flux_aux_set (h, "flux::content-files", ctx, freectx) < 0)
+            goto error;
+    }
+    return ctx;
+error:
+    freectx (ctx);
+    return NULL;
+}
+
+void load_cb (flux_t *h, flux_msg_handler_t *mh,
+              const flux_msg_t *msg, void *arg)
+{
+    files_ctx_t *ctx = arg;
+    const char *blobref;
+    int blobref_size;
+    struct entry *e;
+
+    if (flux_request_decode_raw (msg, NULL, (const void **)&blobref,
+                                 &blobref_size) < 0) {
+        flux_log_error (h, "load: request decode failed");
+        goto error;
+    }
+    if (!blobref || blobref[blobref_size - 1] != '\0') {
+        errno = EPROTO;
+        flux_log_error (h, "load: malformed blobref");
+        goto error;
+    }
+    if (!(e = zhash_lookup (ctx->index, blobref))) {
+        errno = ENOENT;
+        goto error;
+    }
+    if (flux_respond_raw (h, msg, e->seg->map + e->offset
+                                  + RECORD_HEADER_SIZE + ctx->hash_len,
+                          e->size) < 0)
+        flux_log_error (h, "load: flux_respond_raw");
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "load: flux_respond_error");
+}
+
+void store_cb (flux_t *h, flux_msg_handler_t *mh,
+               const flux_msg_t *msg, void *arg)
+{
+    files_ctx_t *ctx = arg;
+    const void *data;
+    int size;
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    struct segment *seg;
+    uint32_t offset;
+
+    if (flux_request_decode_raw (msg, NULL, &data, &size) < 0) {
+        flux_log_error (h, "store: request decode failed");
+        goto error;
+    }
+    if (size > ctx->blob_size_limit) {
+        errno = EFBIG;
+        goto error;
+    }
+    if (blobref_hash (ctx->hashfun, (uint8_t *)data, size, blobref,
+                      sizeof (blobref)) < 0)
+        goto error;
+    if (!zhash_lookup (ctx->index, blobref)) {
+        if (blobref_strtohash (blobref, hash, sizeof (hash)) < 0)
+            goto error;
+        if (record_append (ctx, hash, data, size, &seg, &offset) < 0) {
+            flux_log_error (h, "store: append to segment");
+            goto error;
+        }
+        if (index_insert (ctx, blobref, seg, offset, size) < 0)
+            goto error;
+    }
+    if (flux_respond_raw (h, msg, blobref, strlen (blobref) + 1) < 0)
+        flux_log_error (h, "store: flux_respond_raw");
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "store: flux_respond_error");
+}
+
+void stats_cb (flux_t *h, flux_msg_handler_t *mh,
+               const flux_msg_t *msg, void *arg)
+{
+    files_ctx_t *ctx = arg;
+    struct segment *seg;
+    json_int_t bytes = 0;
+    json_int_t live = 0;
+
+    seg = zlist_first (ctx->segments);
+    while (seg) {
+        bytes += seg->size;
+        live += seg->live;
+        seg = zlist_next (ctx->segments);
+    }
+    if (flux_respond_pack (h, msg, "{ s:i s:i s:I s:I }",
+                           "objects", (int)zhash_size (ctx->index),
+                           "segments", (int)zlist_size (ctx->segments),
+                           "bytes", bytes,
+                           "live-bytes", live) < 0)
+        flux_log_error (h, "stats: flux_respond_pack");
+}
+
+/* Copy up to compact_batch_size live records from the segment being
+ * compacted to the active segment.  Returns true when it is finished.
+ */
+static bool compact_batch (files_ctx_t *ctx, struct segment *seg)
+{
+    int count = 0;
+
+    while (ctx->compact_off < seg->size && count++ < compact_batch_size) {
+        char blobref[BLOBREF_MAX_STRING_SIZE];
+        const uint8_t *hash;
+        uint32_t size;
+        struct entry *e;
+        struct segment *newseg;
+        uint32_t offset;
+
+        if (!(hash = record_decode (ctx, seg, ctx->compact_off, &size)))
+            return true;
+        if (blobref_hashtostr (ctx->hashfun, hash, ctx->hash_len,
+                               blobref, sizeof (blobref)) < 0)
+            return true;
+        e = zhash_lookup (ctx->index, blobref);
+        if (e && e->seg == seg && e->offset == ctx->compact_off) {
+            if (record_append (ctx, hash, hash + ctx->hash_len, size,
+                               &newseg, &offset) < 0)
+                return true;
+            seg->live -= record_size (ctx, size);
+            newseg->live += record_size (ctx, size);
+            e->seg = newseg;
+            e->offset = offset;
+        }
+        ctx->compact_off += record_size (ctx, size);
+    }
+    return ctx->compact_off >= seg->size;
+}
+
+static void compact_cb (flux_reactor_t *r, flux_watcher_t *w,
+                        int revents, void *arg)
+{
+    files_ctx_t *ctx = arg;
+    struct segment *seg;
+
+    if (!ctx->compact_seg) {
+        seg = zlist_first (ctx->segments);
+        while (seg && !compact_wanted (ctx, seg))
+            seg = zlist_next (ctx->segments);
+        if (!seg) {
+            flux_watcher_stop (ctx->compact_w);
+            return;
+        }
+        ctx->compact_seg = seg;
+        ctx->compact_off = 0;
+    }
+    seg = ctx->compact_seg;
+    if (!compact_batch (ctx, seg))
+        return;
+    if (seg->live > 0) {
+        flux_log (ctx->h, LOG_ERR, "compact: segment %d: giving up", seg->id);
+        ctx->compact_threshold = 1.; // don't retry
+    }
+    else {
+        zlist_remove (ctx->segments, seg);
+        if (segment_unlink (ctx, seg) < 0)
+            flux_log_error (ctx->h, "compact: unlink segment %d", seg->id);
+        flux_log (ctx->h, LOG_DEBUG, "compact: segment %d removed", seg->id);
+        segment_destroy (seg);
+    }
+    ctx->compact_seg = NULL;
+}
+
+int register_backing_store (flux_t *h, bool value, const char *name)
+{
+    flux_future_t *f;
+    int saved_errno = 0;
+    int rc = -1;
+
+    if (!(f = flux_rpc_pack (h, "content.backing", FLUX_NODEID_ANY, 0,
+                             "{ s:b s:s }",
+                             "backing", value,
+                             "name", name)))
+        goto done;
+    if (flux_future_get (f, NULL) < 0)
+        goto done;
+    rc = 0;
+done:
+    saved_errno = errno;
+    flux_future_destroy (f);
+    errno = saved_errno;
+    return rc;
+}
+
+int register_content_backing_service (flux_t *h)
+{
+    int rc, saved_errno;
+    flux_future_t *f;
+    if (!(f = flux_service_register (h, "content-backing")))
+        return -1;
+    rc = flux_future_get (f, NULL);
+    saved_errno = errno;
+    flux_future_destroy (f);
+    errno = saved_errno;
+    return rc;
+}
+
+/* Intercept broker shutdown event.  If broker is shutting down,
+ * avoid transferring data back to the content cache at unload time.
+ */
+void broker_shutdown_cb (flux_t *h, flux_msg_handler_t *mh,
+                         const flux_msg_t *msg, void *arg)
+{
+    files_ctx_t *ctx = arg;
+    ctx->broker_shutdown = true;
+    flux_log (h, LOG_DEBUG, "broker shutdown in progress");
+}
+
+/* Wait for the oldest outstanding store-batch RPC in 'pending'
+ * and return the number of blobs successfully stored.
+ */
+struct dump_req {
+    flux_future_t *f;
+    int count;
+};
+
+static int dump_wait_one (files_ctx_t *ctx, zlist_t *pending, int *errors)
+{
+    struct dump_req *req;
+    int count = 0;
+    int i;
+
+    if (!(req = zlist_pop (pending)))
+        return 0;
+    for (i = 0; i < req->count; i++) {
+        if (flux_content_store_batch_get (req->f, i, NULL) < 0) {
+            if ((*errors)++ == 0)
+                flux_log_error (ctx->h, "shutdown: store");
+        }
+        else
+            count++;
+    }
+    flux_future_destroy (req->f);
+    free (req);
+    return count;
+}
+
+/* Manage shutdown of this module.
+ * Tell content cache to disable backing store,
+ * then write everything back to it before exiting.
+ * Blobs are sent directly from the segment mappings in batches,
+ * keeping up to 'dump_window' batches in flight.
+ */
+void shutdown_cb (flux_t *h, flux_msg_handler_t *mh,
+                  const flux_msg_t *msg, void *arg)
+{
+    files_ctx_t *ctx = arg;
+    zlist_t *pending = NULL;
+    const void *bufs[DUMP_BATCH_SIZE];
+    int lens[DUMP_BATCH_SIZE];
+    int n = 0;
+    struct entry *e;
+    int count = 0;
+    int errors = 0;
+    struct timespec t0;
+    double elapsed;
+
+    flux_log (h, LOG_DEBUG, "shutdown: begin");
+    if (register_backing_store (h, false, "content-files") < 0) {
+        flux_log_error (h, "shutdown: unregistering backing store");
+        goto done;
+    }
+    if (ctx->broker_shutdown) {
+        flux_log (h, LOG_DEBUG, "shutdown: instance is terminating, don't reload to cache");
+        goto done;
+    }
+    if (!(pending = zlist_new ())) {
+        flux_log (h, LOG_ERR, "shutdown: out of memory");
+        goto done;
+    }
+    monotime (&t0);
+    e = zhash_first (ctx->index);
+    while (e || n > 0) {
+        if (e) {
+            bufs[n] = e->seg->map + e->offset
+                                  + RECORD_HEADER_SIZE + ctx->hash_len;
+            lens[n++] = e->size;
+            e = zhash_next (ctx->index);
+        }
+        if (n == DUMP_BATCH_SIZE || (!e && n > 0)) {
+            struct dump_req *req;
+            if (!(req = calloc (1, sizeof (*req)))
+                || !(req->f = flux_content_store_batch (h, bufs, lens, n, 0))
+                || zlist_append (pending, req) < 0) {
+                flux_log_error (h, "shutdown: store");
+                if (req)
+                    flux_future_destroy (req->f);
+                free (req);
+                errors += n;
+            }
+            else
+                req->count = n;
+            n = 0;
+            while (zlist_size (pending) >= dump_window)
+                count += dump_wait_one (ctx, pending, &errors);
+        }
+    }
+    while (zlist_size (pending) > 0)
+        count += dump_wait_one (ctx, pending, &errors);
+    elapsed = monotime_since (t0) / 1000.;
+    flux_log (h, LOG_INFO, "shutdown: %d entries returned to cache in %.1fs"
+              " (%.0f entries/s)%s", count, elapsed,
+              elapsed > 0 ? count / elapsed : 0,
+              errors > 0 ? ", some entries failed" : "");
+done:
+    zlist_destroy (&pending);
+    flux_reactor_stop (flux_get_reactor (h));
+}
+
+static int process_args (files_ctx_t *ctx, int ac, char **av)
+{
+    int i;
+
+    for (i = 0; i < ac; i++) {
+        if (strncmp (av[i], "segment-size=", 13) == 0)
+            ctx->segment_size = strtoul (av[i]+13, NULL, 10);
+        else if (strncmp (av[i], "compact-threshold=", 18) == 0)
+            ctx->compact_threshold = strtod (av[i]+18, NULL);
+        else {
+            flux_log (ctx->h, LOG_ERR, "Unknown option `%s'", av[i]);
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    if (ctx->segment_size < min_segment_size
+                                    || ctx->segment_size > UINT32_MAX) {
+        flux_log (ctx->h, LOG_ERR, "segment-size must be %zu to %u",
+                  min_segment_size, UINT32_MAX);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+static const struct flux_msg_handler_spec htab[] = {
+    { FLUX_MSGTYPE_REQUEST, "content-backing.load",    load_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-backing.store",   store_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-files.stats.get", stats_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-files.shutdown",  shutdown_cb, 0, },
+    { FLUX_MSGTYPE_EVENT,   "shutdown",                broker_shutdown_cb, 0 },
+    FLUX_MSGHANDLER_TABLE_END,
+};
+
+int mod_main (flux_t *h, int argc, char **argv)
+{
+    flux_msg_handler_t **handlers = NULL;
+    files_ctx_t *ctx = getctx (h);
+    if (!ctx)
+        goto done;
+    if (process_args (ctx, argc, argv) < 0)
+        goto done;
+    if (segments_recover (ctx) < 0) {
+        flux_log_error (h, "recovering segments in %s", ctx->dir);
+        goto done;
+    }
+    flux_log (h, LOG_DEBUG, "recovered %d objects from %d segments",
+              (int)zhash_size (ctx->index),
+              (int)zlist_size (ctx->segments));
+    if (!(ctx->compact_w = flux_idle_watcher_create (flux_get_reactor (h),
+                                                     compact_cb, ctx))) {
+        flux_log_error (h, "flux_idle_watcher_create");
+        goto done;
+    }
+    flux_watcher_start (ctx->compact_w);
+    if (flux_event_subscribe (h, "shutdown") < 0) {
+        flux_log_error (h, "flux_event_subscribe");
+        goto done;
+    }
+    if (flux_msg_handler_addvec (h, htab, ctx, &handlers) < 0) {
+        flux_log_error (h, "flux_msg_handler_addvec");
+        goto done;
+    }
+    if (register_backing_store (h, true, "content-files") < 0) {
+        flux_log_error (h, "registering backing store");
+        goto done;
+    }
+    if (register_content_backing_service (h) < 0) {
+        flux_log_error (h, "service.add: content-backing");
+        goto done;
+    }
+    if (flux_reactor_run (flux_get_reactor (h), 0) < 0) {
+        flux_log_error (h, "flux_reactor_run");
+        goto done;
+    }
+done:
+    flux_msg_handler_delvec (handlers);
+    return 0;
+}
+
+MOD_NAME ("content-files");
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -13,6 +13,9 @@
 #if HAVE_CONFIG_H
 #include "config.h"
 #endif
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
 #include <sqlite3.h>
 #include <czmq.h>
 #include <lz4.h>
@@ -21,36 +24,153 @@
 #include "src/common/libutil/blobref.h"
 #include "src/common/libutil/cleanup.h"
 #include "src/common/libutil/log.h"
+#include "src/common/libutil/monotime.h"
 
 const size_t lzo_buf_chunksize = 1024*1024;
 const size_t compression_threshold = 256; /* compress blobs >= this size */
+const double default_group_commit_window = 0.01; /* seconds */
 
-const char *sql_create_table = "CREATE TABLE if not exists objects("
-                               "  hash CHAR(20) PRIMARY KEY,"
+#define DUMP_BATCH_SIZE 256         /* blobs per content.store-batch */
+const size_t dump_batch_bytes = 16*1024*1024; /* bytes per store-batch */
+const int dump_window = 8;          /* max outstanding store-batch RPCs */
+const double dump_progress_interval = 5.; /* seconds between log messages */
+
+/* Schema version 2 keys objects by binary digest and splits them by
+ * stored (possibly compressed) size.  Blobs up to small_blob_limit
+ * bytes live in a WITHOUT ROWID table, so the row is stored in the
+ * primary key B-tree itself and a lookup touches one B-tree.  Larger
+ * blobs live in an ordinary rowid table where their payload spills to
+ * overflow pages without diluting the small table.
+ *
+ * Version 1 (user_version 0) used a single 'objects' table keyed by
+ * CHAR(20) text.  If found, its rows are migrated in the background
+ * while lookups fall through to it.
+ *
+ * The 'checkpt' table holds small named values, such as the KVS root
+ * checkpoint, that must survive a restart.  It is created on demand in
+ * either schema version, so does not change the version number.
+ */
+const int schema_version = 2;
+const int small_blob_limit = 256;
+const int migrate_batch_size = 256;
+
+const char *sql_create_small = "CREATE TABLE if not exists objects_small("
+                               "  hash BLOB PRIMARY KEY,"
+                               "  size INT,"
+                               "  object BLOB"
+                               ") WITHOUT ROWID;";
+const char *sql_create_large = "CREATE TABLE if not exists objects_large("
+                               "  hash BLOB PRIMARY KEY,"
                                "  size INT,"
                                "  object BLOB"
                                ");";
-const char *sql_load = "SELECT object,size FROM objects"
-                       "  WHERE hash = ?1 LIMIT 1";
-const char *sql_store = "INSERT INTO objects (hash,size,object) "
-                        "  values (?1, ?2, ?3)";
-const char *sql_dump = "SELECT object,size FROM objects";
+const char *sql_create_checkpt = "CREATE TABLE if not exists checkpt("
+                                 "  key TEXT PRIMARY KEY,"
+                                 "  value TEXT"
+                                 ");";
+const char *sql_checkpt_get = "SELECT value FROM checkpt WHERE key = ?1";
+const char *sql_checkpt_put = "REPLACE INTO checkpt (key,value) "
+                              "  values (?1, ?2)";
+const char *sql_load = "SELECT object,size FROM objects_small"
+                       "  WHERE hash = ?1"
+                       " UNION ALL "
+                       "SELECT object,size FROM objects_large"
+                       "  WHERE hash = ?1"
+                       " LIMIT 1";
+const char *sql_load_legacy = "SELECT object,size FROM objects_small"
+                       "  WHERE hash = ?1"
+                       " UNION ALL "
+                       "SELECT object,size FROM objects_large"
+                       "  WHERE hash = ?1"
+                       " UNION ALL "
+                       "SELECT object,size FROM objects"
+                       "  WHERE hash = CAST(?1 AS TEXT)"
+                       " LIMIT 1";
+const char *sql_store_small = "INSERT INTO objects_small (hash,size,object) "
+                              "  values (?1, ?2, ?3)";
+const char *sql_store_large = "INSERT INTO objects_large (hash,size,object) "
+                              "  values (?1, ?2, ?3)";
+const char *sql_dump = "SELECT object,size FROM objects_small"
+                       " UNION ALL "
+                       "SELECT object,size FROM objects_large";
+const char *sql_dump_legacy = "SELECT object,size FROM objects_small"
+                       " UNION ALL "
+                       "SELECT object,size FROM objects_large"
+                       " UNION ALL "
+                       "SELECT object,size FROM objects AS o"
+                       "  WHERE NOT EXISTS (SELECT 1 FROM objects_small"
+                       "    WHERE hash = CAST(o.hash AS BLOB))"
+                       "  AND NOT EXISTS (SELECT 1 FROM objects_large"
+                       "    WHERE hash = CAST(o.hash AS BLOB))";
+const char *sql_hash_len = "SELECT length(hash) FROM objects_small"
+                           " UNION ALL "
+                           "SELECT length(hash) FROM objects_large"
+                           " LIMIT 1";
+const char *sql_legacy_exists = "SELECT 1 FROM sqlite_master"
+                                "  WHERE type = 'table' AND name = 'objects'";
+const char *sql_migrate_small = "INSERT OR IGNORE INTO objects_small "
+                                "  SELECT CAST(hash AS BLOB),size,object"
+                                "  FROM objects WHERE rowid IN"
+                                "  (SELECT rowid FROM objects"
+                                "   ORDER BY rowid LIMIT ?1)"
+                                "  AND length(object) <= ?2";
+const char *sql_migrate_large = "INSERT OR IGNORE INTO objects_large "
+                                "  SELECT CAST(hash AS BLOB),size,object"
+                                "  FROM objects WHERE rowid IN"
+                                "  (SELECT rowid FROM objects"
+                                "   ORDER BY rowid LIMIT ?1)"
+                                "  AND length(object) > ?2";
+const char *sql_migrate_delete = "DELETE FROM objects WHERE rowid IN"
+                                 "  (SELECT rowid FROM objects"
+                                 "   ORDER BY rowid LIMIT ?1)";
+
+struct workpool;
 
 typedef struct {
     char *dbdir;
     char *dbfile;
     sqlite3 *db;
     sqlite3_stmt *load_stmt;
-    sqlite3_stmt *store_stmt;
+    sqlite3_stmt *store_small_stmt;
+    sqlite3_stmt *store_large_stmt;
     sqlite3_stmt *dump_stmt;
+    sqlite3_stmt *checkpt_get_stmt;
+    sqlite3_stmt *checkpt_put_stmt;
+    bool migrating;             /* legacy 'objects' table is present */
+    flux_watcher_t *migrate_w;
+    sqlite3_stmt *migrate_stmt[3];
+    int migrate_count;
     flux_t *h;
     bool broker_shutdown;
     const char *hashfun;
     uint32_t blob_size_limit;
     size_t lzo_bufsize;
     void *lzo_buf;
+    int workers;                /* worker threads (0 = off) */
+    int group_commit;           /* max stores per transaction (0 = off) */
+    double group_commit_window;
+    bool txn_active;
+    zlist_t *txn_pending;       /* store requests awaiting COMMIT */
+    flux_watcher_t *txn_timer;
+    struct workpool *pool;      /* NULL unless workers=N was specified */
 } sqlite_ctx_t;
 
+/* A blob prepared for insertion.
+ */
+struct blob {
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    int hash_len;
+    const void *data;           /* possibly compressed */
+    int size;
+    int uncompressed_size;      /* -1 if not compressed */
+};
+
+struct store_pending {
+    flux_msg_t *msg;
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+};
+
 static void log_sqlite_error (sqlite_ctx_t *ctx, const char *fmt, ...)
 {
     const char *sq_errmsg = sqlite3_errmsg (ctx->db);
@@ -68,30 +188,56 @@ static void log_sqlite_error (sqlite_ctx_t *ctx, const char *fmt, ...)
     flux_log (ctx->h, LOG_ERR, "%s: %s(%d)", buf, sq_errmsg, sq_errcode);
 }
 
-static void set_errno_from_sqlite_error (sqlite_ctx_t *ctx)
+static int errno_from_sqlite (sqlite3 *db)
 {
-    switch (sqlite3_errcode (ctx->db)) {
+    switch (sqlite3_errcode (db)) {
         case SQLITE_IOERR:      /* os io error */
-            errno = EIO;
-            break;
+            return EIO;
         case SQLITE_NOMEM:      /* cannot allocate memory */
-            errno = ENOMEM;
-            break;
+            return ENOMEM;
         case SQLITE_ABORT:      /* statment is not authorized */
         case SQLITE_PERM:       /* access mode for new db cannot be provided */
         case SQLITE_READONLY:   /* attempt to alter data with no permission */
-            errno = EPERM;
-            break;
+            return EPERM;
         case SQLITE_TOOBIG:     /* blob too large */
-            errno = EFBIG;
-            break;
+            return EFBIG;
         case SQLITE_FULL:       /* file system full */
-            errno = ENOSPC;
-            break;
+            return ENOSPC;
         default:
-            errno = EINVAL;
-            break;
+            return EINVAL;
+    }
+}
+
+static void set_errno_from_sqlite_error (sqlite_ctx_t *ctx)
+{
+    errno = errno_from_sqlite (ctx->db);
+}
+
+static void workpool_destroy (struct workpool *pool);
+
+static void store_pending_destroy (struct store_pending *sp)
+{
+    if (sp) {
+        int saved_errno = errno;
+        flux_msg_destroy (sp->msg);
+        free (sp);
+        errno = saved_errno;
+    }
+}
+
+static struct store_pending *store_pending_create (const flux_msg_t *msg,
+                                                   const char *blobref)
+{
+    struct store_pending *sp;
+
+    if (!(sp = calloc (1, sizeof (*sp))))
+        return NULL;
+    if (!(sp->msg = flux_msg_copy (msg, false))) {
+        store_pending_destroy (sp);
+        return NULL;
     }
+    strncpy (sp->blobref, blobref, sizeof (sp->blobref) - 1);
+    return sp;
 }
 
 static void freectx (void *arg)
@@ -99,12 +245,32 @@ static void freectx (void *arg)
     sqlite_ctx_t *ctx = arg;
     if (ctx) {
         int saved_errno = errno;
-        if (ctx->store_stmt)
-            sqlite3_finalize (ctx->store_stmt);
+        int i;
+        workpool_destroy (ctx->pool);
+        if (ctx->txn_pending) {
+            struct store_pending *sp;
+            while ((sp = zlist_pop (ctx->txn_pending)))
+                store_pending_destroy (sp);
+            zlist_destroy (&ctx->txn_pending);
+        }
+        flux_watcher_destroy (ctx->txn_timer);
+        flux_watcher_destroy (ctx->migrate_w);
+        for (i = 0; i < 3; i++) {
+            if (ctx->migrate_stmt[i])
+                sqlite3_finalize (ctx->migrate_stmt[i]);
+        }
+        if (ctx->store_small_stmt)
+            sqlite3_finalize (ctx->store_small_stmt);
+        if (ctx->store_large_stmt)
+            sqlite3_finalize (ctx->store_large_stmt);
         if (ctx->load_stmt)
             sqlite3_finalize (ctx->load_stmt);
         if (ctx->dump_stmt)
             sqlite3_finalize (ctx->dump_stmt);
+        if (ctx->checkpt_get_stmt)
+            sqlite3_finalize (ctx->checkpt_get_stmt);
+        if (ctx->checkpt_put_stmt)
+            sqlite3_finalize (ctx->checkpt_put_stmt);
         if (ctx->db)
             sqlite3_close (ctx->db);
         free (ctx->dbfile);
@@ -115,6 +281,111 @@ static void freectx (void *arg)
     }
 }
 
+/* Get the digest length of the configured hash function.
+ */
+static int hash_len_configured (sqlite_ctx_t *ctx)
+{
+    char blobref[BLOBREF_MAX_STRING_SIZE];
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+
+    if (blobref_hash (ctx->hashfun, (uint8_t *)"", 0, blobref,
+                      sizeof (blobref)) < 0)
+        return -1;
+    return blobref_strtohash (blobref, hash, sizeof (hash));
+}
+
+/* Step a statement that returns a single integer, or no rows (-> 0).
+ */
+static int exec_int (sqlite_ctx_t *ctx, const char *sql, int *value)
+{
+    sqlite3_stmt *stmt;
+    int rc;
+
+    if (sqlite3_prepare_v2 (ctx->db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+    *value = 0;
+    if ((rc = sqlite3_step (stmt)) == SQLITE_ROW)
+        *value = sqlite3_column_int (stmt, 0);
+    sqlite3_finalize (stmt);
+    return (rc == SQLITE_ROW || rc == SQLITE_DONE) ? 0 : -1;
+}
+
+static int schema_init (sqlite_ctx_t *ctx)
+{
+    int version, legacy, hash_len, expected_len;
+    char sql[64];
+
+    if (exec_int (ctx, "PRAGMA user_version", &version) < 0
+            || exec_int (ctx, sql_legacy_exists, &legacy) < 0) {
+        log_sqlite_error (ctx, "reading schema version");
+        goto error_sqlite;
+    }
+    if (version > schema_version) {
+        flux_log (ctx->h, LOG_ERR, "unknown schema version %d", version);
+        errno = EINVAL;
+        return -1;
+    }
+    if (sqlite3_exec (ctx->db, sql_create_small,
+                                        NULL, NULL, NULL) != SQLITE_OK
+            || sqlite3_exec (ctx->db, sql_create_large,
+                                        NULL, NULL, NULL) != SQLITE_OK
+            || sqlite3_exec (ctx->db, sql_create_checkpt,
+                                        NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "creating tables");
+        goto error_sqlite;
+    }
+    snprintf (sql, sizeof (sql), "PRAGMA user_version=%d", schema_version);
+    if (sqlite3_exec (ctx->db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "setting schema version");
+        goto error_sqlite;
+    }
+    if ((expected_len = hash_len_configured (ctx)) < 0)
+        return -1;
+    if (exec_int (ctx, sql_hash_len, &hash_len) < 0) {
+        log_sqlite_error (ctx, "reading key size");
+        goto error_sqlite;
+    }
+    if (hash_len != 0 && hash_len != expected_len) {
+        flux_log (ctx->h, LOG_ERR, "database keys are %d bytes, %s is %d",
+                  hash_len, ctx->hashfun, expected_len);
+        errno = EINVAL;
+        return -1;
+    }
+    ctx->migrating = legacy ? true : false;
+    return 0;
+error_sqlite:
+    set_errno_from_sqlite_error (ctx);
+    return -1;
+}
+
+/* (Re-)prepare statements whose text depends on whether a migration
+ * is in progress.
+ */
+static int prepare_lookup_stmts (sqlite_ctx_t *ctx)
+{
+    if (ctx->load_stmt)
+        sqlite3_finalize (ctx->load_stmt);
+    if (ctx->dump_stmt)
+        sqlite3_finalize (ctx->dump_stmt);
+    ctx->load_stmt = ctx->dump_stmt = NULL;
+    if (sqlite3_prepare_v2 (ctx->db,
+                            ctx->migrating ? sql_load_legacy : sql_load,
+                            -1, &ctx->load_stmt, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "preparing load stmt");
+        goto error_sqlite;
+    }
+    if (sqlite3_prepare_v2 (ctx->db,
+                            ctx->migrating ? sql_dump_legacy : sql_dump,
+                            -1, &ctx->dump_stmt, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "preparing dump stmt");
+        goto error_sqlite;
+    }
+    return 0;
+error_sqlite:
+    set_errno_from_sqlite_error (ctx);
+    return -1;
+}
+
 static sqlite_ctx_t *getctx (flux_t *h)
 {
     sqlite_ctx_t *ctx = (sqlite_ctx_t *)flux_aux_get (h, "flux::content-sqlite");
@@ -129,6 +400,11 @@ static sqlite_ctx_t *getctx (flux_t *h)
             goto error;
         ctx->lzo_bufsize = lzo_buf_chunksize;
         ctx->h = h;
+        ctx->group_commit_window = default_group_commit_window;
+        if (!(ctx->txn_pending = zlist_new ())) {
+            errno = ENOMEM;
+            goto error;
+        }
         if (!(ctx->hashfun = flux_attr_get (h, "content.hash"))) {
             flux_log_error (h, "content.hash");
             goto error;
@@ -170,24 +446,22 @@ static sqlite_ctx_t *getctx (flux_t *h)
             log_sqlite_error (ctx, "setting sqlite pragmas");
             goto error_sqlite;
         }
-        if (sqlite3_exec (ctx->db, sql_create_table,
-                                            NULL, NULL, NULL) != SQLITE_OK) {
-            log_sqlite_error (ctx, "creating table");
-            goto error_sqlite;
-        }
-        if (sqlite3_prepare_v2 (ctx->db, sql_load, -1, &ctx->load_stmt,
-                                            NULL) != SQLITE_OK) {
-            log_sqlite_error (ctx, "preparing load stmt");
-            goto error_sqlite;
-        }
-        if (sqlite3_prepare_v2 (ctx->db, sql_store, -1, &ctx->store_stmt,
-                                            NULL) != SQLITE_OK) {
+        if (schema_init (ctx) < 0)
+            goto error;
+        if (prepare_lookup_stmts (ctx) < 0)
+            goto error;
+        if (sqlite3_prepare_v2 (ctx->db, sql_store_small, -1,
+                                &ctx->store_small_stmt, NULL) != SQLITE_OK
+                || sqlite3_prepare_v2 (ctx->db, sql_store_large, -1,
+                                &ctx->store_large_stmt, NULL) != SQLITE_OK) {
             log_sqlite_error (ctx, "preparing store stmt");
             goto error_sqlite;
         }
-        if (sqlite3_prepare_v2 (ctx->db, sql_dump, -1, &ctx->dump_stmt,
-                                            NULL) != SQLITE_OK) {
-            log_sqlite_error (ctx, "preparing dump stmt");
+        if (sqlite3_prepare_v2 (ctx->db, sql_checkpt_get, -1,
+                                &ctx->checkpt_get_stmt, NULL) != SQLITE_OK
+                || sqlite3_prepare_v2 (ctx->db, sql_checkpt_put, -1,
+                                &ctx->checkpt_put_stmt, NULL) != SQLITE_OK) {
+            log_sqlite_error (ctx, "preparing checkpt stmt");
             goto error_sqlite;
         }
         if (flux_aux_set (h, "flux::content-sqlite", ctx, freectx) < 0)
@@ -201,166 +475,152 @@ error:
     return NULL;
 }
 
-int grow_lzo_buf (sqlite_ctx_t *ctx, size_t size)
+static int grow_buf (void **buf, size_t *bufsize, size_t size)
 {
-    size_t newsize = ctx->lzo_bufsize;
+    size_t newsize = *bufsize;
     void *newbuf;
+
+    if (newsize == 0)
+        newsize = size;
     while (newsize < size)
         newsize += lzo_buf_chunksize;
-    if (!(newbuf = realloc (ctx->lzo_buf, newsize))) {
+    if (!(newbuf = realloc (*buf, newsize))) {
         errno = ENOMEM;
         return -1;
     }
-    ctx->lzo_bufsize = newsize;
-    ctx->lzo_buf = newbuf;
+    *bufsize = newsize;
+    *buf = newbuf;
     return 0;
 }
 
-void load_cb (flux_t *h, flux_msg_handler_t *mh,
-              const flux_msg_t *msg, void *arg)
+int grow_lzo_buf (sqlite_ctx_t *ctx, size_t size)
 {
-    sqlite_ctx_t *ctx = arg;
-    const char *blobref = "-";
-    int blobref_size;
-    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
-    int hash_len;
-    const void *data = NULL;
-    int size = 0;
+    return grow_buf (&ctx->lzo_buf, &ctx->lzo_bufsize, size);
+}
+
+/* Look up 'hash' using 'stmt', decompressing into '*buf' if necessary.
+ * On success, '*datap' points either into '*buf' or into column memory
+ * of 'stmt', which remains valid until the statement is reset.
+ * This may run on a worker thread, so instead of logging, '*errstr' is
+ * set on failures worth logging.
+ */
+static int load_blob (sqlite3_stmt *stmt, const uint8_t *hash, int hash_len,
+                      void **buf, size_t *bufsize,
+                      const void **datap, int *sizep, const char **errstr)
+{
+    const void *data;
+    int size;
     int uncompressed_size;
-    int rc = -1;
-    int old_state;
-    //delay cancellation to ensure lock-correctness in sqlite
-    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
 
-    if (flux_request_decode_raw (msg, NULL, (const void **)&blobref,
-                                 &blobref_size) < 0) {
-        flux_log_error (h, "load: request decode failed");
-        goto done;
-    }
-    if (!blobref || blobref[blobref_size - 1] != '\0') {
-        errno = EPROTO;
-        flux_log_error (h, "load: malformed blobref");
-        goto done;
-    }
-    if ((hash_len = blobref_strtohash (blobref, hash, sizeof (hash))) < 0) {
-        errno = ENOENT;
-        flux_log_error (h, "load: unexpected foreign blobref");
-        goto done;
-    }
-    if (sqlite3_bind_text (ctx->load_stmt, 1, (char *)hash, hash_len,
+    if (sqlite3_bind_blob (stmt, 1, hash, hash_len,
                                               SQLITE_STATIC) != SQLITE_OK) {
-        log_sqlite_error (ctx, "load: binding key");
-        set_errno_from_sqlite_error (ctx);
-        goto done;
+        *errstr = "load: binding key";
+        errno = errno_from_sqlite (sqlite3_db_handle (stmt));
+        return -1;
     }
-    if (sqlite3_step (ctx->load_stmt) != SQLITE_ROW) {
-        //log_sqlite_error (ctx, "load: executing stmt");
+    if (sqlite3_step (stmt) != SQLITE_ROW) {
         errno = ENOENT;
-        goto done;
+        return -1;
     }
-    size = sqlite3_column_bytes (ctx->load_stmt, 0);
-    if (sqlite3_column_type (ctx->load_stmt, 0) != SQLITE_BLOB && size > 0) {
-        flux_log (h, LOG_ERR, "load: selected value is not a blob");
+    size = sqlite3_column_bytes (stmt, 0);
+    if (sqlite3_column_type (stmt, 0) != SQLITE_BLOB && size > 0) {
+        *errstr = "load: selected value is not a blob";
         errno = EINVAL;
-        goto done;
+        return -1;
     }
-    data = sqlite3_column_blob (ctx->load_stmt, 0);
-    if (sqlite3_column_type (ctx->load_stmt, 1) != SQLITE_INTEGER) {
-        flux_log (h, LOG_ERR, "load: selected value is not an integer");
+    data = sqlite3_column_blob (stmt, 0);
+    if (sqlite3_column_type (stmt, 1) != SQLITE_INTEGER) {
+        *errstr = "load: selected value is not an integer";
         errno = EINVAL;
-        goto done;
+        return -1;
     }
-    uncompressed_size = sqlite3_column_int (ctx->load_stmt, 1);
+    uncompressed_size = sqlite3_column_int (stmt, 1);
     if (uncompressed_size != -1) {
-        if (ctx->lzo_bufsize < uncompressed_size
-                                && grow_lzo_buf (ctx, uncompressed_size) < 0)
-            goto done;
-        int r = LZ4_decompress_safe (data, ctx->lzo_buf, size, uncompressed_size);
+        if (*bufsize < uncompressed_size
+                        && grow_buf (buf, bufsize, uncompressed_size) < 0)
+            return -1;
+        int r = LZ4_decompress_safe (data, *buf, size, uncompressed_size);
         if (r < 0) {
             errno = EINVAL;
-            goto done;
+            return -1;
         }
         if (r != uncompressed_size) {
-            flux_log (h, LOG_ERR, "load: blob size mismatch");
+            *errstr = "load: blob size mismatch";
             errno = EINVAL;
-            goto done;
+            return -1;
         }
-        data = ctx->lzo_buf;
+        data = *buf;
         size = uncompressed_size;
     }
-    rc = 0;
-done:
-    if (rc < 0) {
-        if (flux_respond_error (h, msg, errno, NULL) < 0)
-            flux_log_error (h, "load: flux_respond_error");
-    }
-    else {
-        if (flux_respond_raw (h, msg, data, size) < 0)
-            flux_log_error (h, "load: flux_respond_raw");
-    }
-    (void )sqlite3_reset (ctx->load_stmt);
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+    *datap = data;
+    *sizep = size;
+    return 0;
 }
 
-void store_cb (flux_t *h, flux_msg_handler_t *mh,
-               const flux_msg_t *msg, void *arg)
+/* Hash and, if large enough, compress 'data' into '*buf', filling in
+ * 'blob' for store_insert().  This may run on a worker thread.
+ */
+static int store_prepare (sqlite_ctx_t *ctx, const void *data, int size,
+                          void **buf, size_t *bufsize, struct blob *blob)
 {
-    sqlite_ctx_t *ctx = arg;
-    const void *data;
-    int size, hash_len;
-    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
-    char blobref[BLOBREF_MAX_STRING_SIZE] = "-";
-    int uncompressed_size = -1;
-    int rc = -1;
-    int old_state;
-    //delay cancellation to ensure lock-correctness in sqlite
-    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
-
-    if (flux_request_decode_raw (msg, NULL, &data, &size) < 0) {
-        flux_log_error (h, "store: request decode failed");
-        goto done;
-    }
     if (size > ctx->blob_size_limit) {
         errno = EFBIG;
-        goto done;
+        return -1;
     }
-    if (blobref_hash (ctx->hashfun, (uint8_t *)data, size, blobref,
-                      sizeof (blobref)) < 0)
-        goto done;
-    if ((hash_len = blobref_strtohash (blobref, hash, sizeof (hash))) < 0)
-        goto done;
+    if (blobref_hash (ctx->hashfun, (uint8_t *)data, size, blob->blobref,
+                      sizeof (blob->blobref)) < 0)
+        return -1;
+    if ((blob->hash_len = blobref_strtohash (blob->blobref, blob->hash,
+                                             sizeof (blob->hash))) < 0)
+        return -1;
+    blob->uncompressed_size = -1;
     if (size >= compression_threshold) {
         int r;
         int out_len = LZ4_compressBound(size);
-        if (ctx->lzo_bufsize < out_len && grow_lzo_buf (ctx, out_len) < 0)
-            goto done;
-        r = LZ4_compress_default (data, ctx->lzo_buf, size, out_len);
+        if (*bufsize < out_len && grow_buf (buf, bufsize, out_len) < 0)
+            return -1;
+        r = LZ4_compress_default (data, *buf, size, out_len);
         if (r == 0) {
             errno = EINVAL;
-            goto done;
+            return -1;
         }
-        uncompressed_size = size;
+        blob->uncompressed_size = size;
         size = r;
-        data = ctx->lzo_buf;
+        data = *buf;
     }
-    if (sqlite3_bind_text (ctx->store_stmt, 1, (char *)hash, hash_len,
-                           SQLITE_STATIC) != SQLITE_OK) {
+    blob->data = data;
+    blob->size = size;
+    return 0;
+}
+
+/* Insert a prepared blob.  Inserting a blob that is already present
+ * is not an error.
+ */
+static int store_insert (sqlite_ctx_t *ctx, struct blob *blob)
+{
+    sqlite3_stmt *stmt = blob->size <= small_blob_limit
+                         ? ctx->store_small_stmt : ctx->store_large_stmt;
+    int rc = -1;
+
+    if (sqlite3_bind_blob (stmt, 1, blob->hash,
+                           blob->hash_len, SQLITE_STATIC) != SQLITE_OK) {
         log_sqlite_error (ctx, "store: binding key");
         set_errno_from_sqlite_error (ctx);
         goto done;
     }
-    if (sqlite3_bind_int (ctx->store_stmt, 2, uncompressed_size) != SQLITE_OK) {
+    if (sqlite3_bind_int (stmt, 2,
+                          blob->uncompressed_size) != SQLITE_OK) {
         log_sqlite_error (ctx, "store: binding size");
         set_errno_from_sqlite_error (ctx);
         goto done;
     }
-    if (sqlite3_bind_blob (ctx->store_stmt, 3,
-                           data, size, SQLITE_STATIC) != SQLITE_OK) {
+    if (sqlite3_bind_blob (stmt, 3, blob->data, blob->size,
+                           SQLITE_STATIC) != SQLITE_OK) {
         log_sqlite_error (ctx, "store: binding data");
         set_errno_from_sqlite_error (ctx);
         goto done;
     }
-    if (sqlite3_step (ctx->store_stmt) != SQLITE_DONE
+    if (sqlite3_step (stmt) != SQLITE_DONE
                     && sqlite3_errcode (ctx->db) != SQLITE_CONSTRAINT) {
         log_sqlite_error (ctx, "store: executing stmt");
         set_errno_from_sqlite_error (ctx);
@@ -368,142 +628,1081 @@ void store_cb (flux_t *h, flux_msg_handler_t *mh,
     }
     rc = 0;
 done:
-    if (rc < 0) {
-        if (flux_respond_error (h, msg, errno, NULL) < 0)
-            flux_log_error (h, "store: flux_respond_error");
-    }
-    else {
-        if (flux_respond_raw (h, msg, blobref, strlen (blobref) + 1) < 0)
-            flux_log_error (h, "store: flux_respond_raw");
-    }
-    (void) sqlite3_reset (ctx->store_stmt);
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+    (void) sqlite3_reset (stmt);
+    return rc;
 }
 
-int register_backing_store (flux_t *h, bool value, const char *name)
+/* Group commit:  stores are gathered into one explicit transaction,
+ * which is committed when 'group_commit' stores are pending or
+ * 'group_commit_window' seconds after it was opened, whichever comes
+ * first.  Responses are withheld until the COMMIT succeeds, so a
+ * store response still means the blob has been committed, as it does
+ * without group commit.
+ */
+static int txn_begin (sqlite_ctx_t *ctx)
 {
-    flux_future_t *f;
-    int saved_errno = 0;
-    int rc = -1;
-
-    if (!(f = flux_rpc_pack (h, "content.backing", FLUX_NODEID_ANY, 0,
-                             "{ s:b s:s }",
-                             "backing", value,
-                             "name", name)))
-        goto done;
-    if (flux_future_get (f, NULL) < 0)
-        goto done;
-    rc = 0;
-done:
-    saved_errno = errno;
-    flux_future_destroy (f);
-    errno = saved_errno;
-    return rc;
+    if (ctx->txn_active)
+        return 0;
+    if (sqlite3_exec (ctx->db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "store: begin transaction");
+        set_errno_from_sqlite_error (ctx);
+        return -1;
+    }
+    ctx->txn_active = true;
+    flux_timer_watcher_reset (ctx->txn_timer, ctx->group_commit_window, 0.);
+    flux_watcher_start (ctx->txn_timer);
+    /* Migration batches run in their own transactions, so pause the
+     * migrate idle watcher until COMMIT rather than letting it spin.
+     */
+    if (ctx->migrate_w)
+        flux_watcher_stop (ctx->migrate_w);
+    return 0;
 }
 
-int register_content_backing_service (flux_t *h)
+static void txn_commit (sqlite_ctx_t *ctx)
 {
-    int rc, saved_errno;
-    flux_future_t *f;
-    if (!(f = flux_service_register (h, "content-backing")))
-        return -1;
-    rc = flux_future_get (f, NULL);
-    saved_errno = errno;
-    flux_future_destroy (f);
-    errno = saved_errno;
-    return rc;
+    struct store_pending *sp;
+    int errnum = 0;
+
+    if (!ctx->txn_active)
+        return;
+    flux_watcher_stop (ctx->txn_timer);
+    ctx->txn_active = false;
+    if (sqlite3_exec (ctx->db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "store: commit transaction");
+        set_errno_from_sqlite_error (ctx);
+        errnum = errno;
+        (void)sqlite3_exec (ctx->db, "ROLLBACK", NULL, NULL, NULL);
+    }
+    if (ctx->migrate_stmt[0]) // migration in progress
+        flux_watcher_start (ctx->migrate_w);
+    while ((sp = zlist_pop (ctx->txn_pending))) {
+        if (errnum) {
+            if (flux_respond_error (ctx->h, sp->msg, errnum, NULL) < 0)
+                flux_log_error (ctx->h, "store: flux_respond_error");
+        }
+        else {
+            if (flux_respond_raw (ctx->h, sp->msg, sp->blobref,
+                                  strlen (sp->blobref) + 1) < 0)
+                flux_log_error (ctx->h, "store: flux_respond_raw");
+        }
+        store_pending_destroy (sp);
+    }
 }
 
-/* Intercept broker shutdown event.  If broker is shutting down,
- * avoid transferring data back to the content cache at unload time.
- */
-void broker_shutdown_cb (flux_t *h, flux_msg_handler_t *mh,
-                         const flux_msg_t *msg, void *arg)
+static void txn_timer_cb (flux_reactor_t *r, flux_watcher_t *w,
+                          int revents, void *arg)
 {
     sqlite_ctx_t *ctx = arg;
-    ctx->broker_shutdown = true;
-    flux_log (h, LOG_DEBUG, "broker shutdown in progress");
+    int old_state;
+    //delay cancellation to ensure lock-correctness in sqlite
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+    txn_commit (ctx);
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
 }
 
-/* Manage shutdown of this module.
- * Tell content cache to disable backing store,
- * then write everything back to it before exiting.
+/* Queue the response to 'msg' until the open transaction commits.
  */
-void shutdown_cb (flux_t *h, flux_msg_handler_t *mh,
-                  const flux_msg_t *msg, void *arg)
+static int txn_store_defer (sqlite_ctx_t *ctx, const flux_msg_t *msg,
+                            const char *blobref)
 {
-    sqlite_ctx_t *ctx = arg;
-    flux_future_t *f;
-    int count = 0;
-    int old_state;
+    struct store_pending *sp;
 
-    flux_log (h, LOG_DEBUG, "shutdown: begin");
-    if (register_backing_store (h, false, "content-sqlite") < 0) {
-        flux_log_error (h, "shutdown: unregistering backing store");
-        goto done;
+    if (!(sp = store_pending_create (msg, blobref)))
+        return -1;
+    if (zlist_append (ctx->txn_pending, sp) < 0) {
+        store_pending_destroy (sp);
+        errno = ENOMEM;
+        return -1;
     }
-    if (ctx->broker_shutdown) {
-        flux_log (h, LOG_DEBUG, "shutdown: instance is terminating, don't reload to cache");
+    if (zlist_size (ctx->txn_pending) >= ctx->group_commit)
+        txn_commit (ctx);
+    return 0;
+}
+/* Insert a prepared blob and respond to 'msg', or in group commit mode,
+ * defer the response until the transaction commits.
+ */
+static void store_complete (sqlite_ctx_t *ctx, const flux_msg_t *msg,
+                            struct blob *blob)
+{
+    if (ctx->group_commit > 0) {
+        if (txn_begin (ctx) < 0
+                || store_insert (ctx, blob) < 0
+                || txn_store_defer (ctx, msg, blob->blobref) < 0)
+            goto error;
+        return;
+    }
+    if (store_insert (ctx, blob) < 0)
+        goto error;
+    if (flux_respond_raw (ctx->h, msg, blob->blobref,
+                          strlen (blob->blobref) + 1) < 0)
+        flux_log_error (ctx->h, "store: flux_respond_raw");
+    return;
+error:
+    if (flux_respond_error (ctx->h, msg, errno, NULL) < 0)
+        flux_log_error (ctx->h, "store: flux_respond_error");
+}
+
+/* Worker pool:  with workers=N, compression, decompression, and sqlite
+ * reads run on N threads, each with its own read-only connection and
+ * load statement.  Finished work is handed back to the reactor thread
+ * through the 'done' list and an eventfd.  The 'done' list is linked
+ * through the work itself, so handing work back cannot fail and every
+ * request gets a response.  Responses are sent, and
+ * INSERTs performed on the main connection, from the reactor thread only.
+ */
+enum {
+    WORK_LOAD,
+    WORK_STORE,
+};
+
+struct work {
+    int type;
+    flux_msg_t *msg;
+    struct blob blob;
+    void *buf;              /* (de)compressed data, owned */
+    size_t bufsize;
+    int errnum;
+    const char *errstr;
+    struct work *next;      /* link in workpool 'done' list */
+};
+
+struct worker {
+    pthread_t t;
+    bool started;
+    sqlite3 *db;
+    sqlite3_stmt *load_stmt;
+    struct workpool *pool;
+};
+
+struct workpool {
+    sqlite_ctx_t *ctx;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* signaled when 'queue' is non-empty */
+    pthread_cond_t idle;    /* signaled when all work has been handed back */
+    zlist_t *queue;         /* work waiting for a worker */
+    struct work *done;      /* work waiting for the reactor (head) */
+    struct work *done_tail;
+    int busy;               /* work in progress on workers */
+    bool shutdown;
+    int fd;                 /* eventfd, signaled when 'done' becomes non-empty */
+    flux_watcher_t *w;
+    int count;
+    struct worker *workers;
+};
+
+static void work_destroy (struct work *work)
+{
+    if (work) {
+        int saved_errno = errno;
+        flux_msg_destroy (work->msg);
+        free (work->buf);
+        free (work);
+        errno = saved_errno;
+    }
+}
+
+static struct work *work_create (int type, const flux_msg_t *msg)
+{
+    struct work *work;
+
+    if (!(work = calloc (1, sizeof (*work))))
+        return NULL;
+    work->type = type;
+    if (!(work->msg = flux_msg_copy (msg, type == WORK_STORE))) {
+        work_destroy (work);
+        return NULL;
+    }
+    return work;
+}
+
+static void work_load (struct worker *w, struct work *work)
+{
+    const void *data;
+    int size;
+
+    if (load_blob (w->load_stmt, work->blob.hash, work->blob.hash_len,
+                   &work->buf, &work->bufsize,
+                   &data, &size, &work->errstr) < 0) {
+        work->errnum = errno;
         goto done;
     }
+    if (data != work->buf && size > 0) {
+        if (work->bufsize < size
+                    && grow_buf (&work->buf, &work->bufsize, size) < 0) {
+            work->errnum = errno;
+            goto done;
+        }
+        memcpy (work->buf, data, size);
+    }
+    work->blob.data = work->buf;
+    work->blob.size = size;
+done:
+    (void)sqlite3_reset (w->load_stmt);
+}
+
+static void work_store (sqlite_ctx_t *ctx, struct work *work)
+{
+    const void *data;
+    int size;
+
+    if (flux_request_decode_raw (work->msg, NULL, &data, &size) < 0
+            || store_prepare (ctx, data, size, &work->buf, &work->bufsize,
+                              &work->blob) < 0)
+        work->errnum = errno;
+}
+
+static void *worker_thread (void *arg)
+{
+    struct worker *w = arg;
+    struct workpool *pool = w->pool;
+    struct work *work;
+    uint64_t one = 1;
+    bool signal;
+
+    for (;;) {
+        pthread_mutex_lock (&pool->lock);
+        while (!pool->shutdown && zlist_size (pool->queue) == 0)
+            pthread_cond_wait (&pool->cond, &pool->lock);
+        if (pool->shutdown) {
+            pthread_mutex_unlock (&pool->lock);
+            break;
+        }
+        work = zlist_pop (pool->queue);
+        pool->busy++;
+        pthread_mutex_unlock (&pool->lock);
+
+        if (work->type == WORK_LOAD)
+            work_load (w, work);
+        else
+            work_store (pool->ctx, work);
+
+        pthread_mutex_lock (&pool->lock);
+        signal = (pool->done == NULL);
+        if (pool->done_tail)
+            pool->done_tail->next = work;
+        else
+            pool->done = work;
+        pool->done_tail = work;
+        pool->busy--;
+        if (pool->busy == 0 && zlist_size (pool->queue) == 0)
+            pthread_cond_broadcast (&pool->idle);
+        pthread_mutex_unlock (&pool->lock);
+        if (signal)
+            (void)write (pool->fd, &one, sizeof (one));
+    }
+    return NULL;
+}
+
+static void workpool_respond (struct workpool *pool, struct work *work)
+{
+    flux_t *h = pool->ctx->h;
+
+    if (work->errnum != 0) {
+        if (work->errstr) {
+            errno = work->errnum;
+            flux_log_error (h, "%s", work->errstr);
+        }
+        if (flux_respond_error (h, work->msg, work->errnum, NULL) < 0)
+            flux_log_error (h, "%s: flux_respond_error",
+                            work->type == WORK_LOAD ? "load" : "store");
+    }
+    else if (work->type == WORK_LOAD) {
+        if (flux_respond_raw (h, work->msg, work->blob.data,
+                                            work->blob.size) < 0)
+            flux_log_error (h, "load: flux_respond_raw");
+    }
+    else
+        store_complete (pool->ctx, work->msg, &work->blob);
+}
+
+static void workpool_process_done (struct workpool *pool)
+{
+    struct work *work;
+
+    for (;;) {
+        pthread_mutex_lock (&pool->lock);
+        if ((work = pool->done)) {
+            if (!(pool->done = work->next))
+                pool->done_tail = NULL;
+            work->next = NULL;
+        }
+        pthread_mutex_unlock (&pool->lock);
+        if (!work)
+            break;
+        workpool_respond (pool, work);
+        work_destroy (work);
+    }
+}
+
+static void workpool_done_cb (flux_reactor_t *r, flux_watcher_t *w,
+                              int revents, void *arg)
+{
+    struct workpool *pool = arg;
+    uint64_t val;
+    int old_state;
+
+    if (read (pool->fd, &val, sizeof (val)) < 0 && errno != EAGAIN) {
+        flux_log_error (pool->ctx->h, "workpool: read");
+        return;
+    }
     //delay cancellation to ensure lock-correctness in sqlite
     pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+    workpool_process_done (pool);
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+}
+
+static int workpool_submit (struct workpool *pool, struct work *work)
+{
+    int rc = 0;
+
+    pthread_mutex_lock (&pool->lock);
+    if (zlist_append (pool->queue, work) < 0) {
+        errno = ENOMEM;
+        rc = -1;
+    }
+    else
+        pthread_cond_signal (&pool->cond);
+    pthread_mutex_unlock (&pool->lock);
+    return rc;
+}
+
+/* Wait for all submitted work to be handed back, then respond to it.
+ */
+static void workpool_drain (struct workpool *pool)
+{
+    pthread_mutex_lock (&pool->lock);
+    while (pool->busy > 0 || zlist_size (pool->queue) > 0)
+        pthread_cond_wait (&pool->idle, &pool->lock);
+    pthread_mutex_unlock (&pool->lock);
+    workpool_process_done (pool);
+}
+
+static void workpool_destroy (struct workpool *pool)
+{
+    if (pool) {
+        int saved_errno = errno;
+        struct work *work;
+        int i;
+
+        pthread_mutex_lock (&pool->lock);
+        pool->shutdown = true;
+        pthread_cond_broadcast (&pool->cond);
+        pthread_mutex_unlock (&pool->lock);
+        for (i = 0; i < pool->count; i++) {
+            struct worker *w = &pool->workers[i];
+            if (w->started)
+                (void)pthread_join (w->t, NULL);
+            if (w->load_stmt)
+                sqlite3_finalize (w->load_stmt);
+            if (w->db)
+                sqlite3_close (w->db);
+        }
+        free (pool->workers);
+        if (pool->queue) {
+            while ((work = zlist_pop (pool->queue)))
+                work_destroy (work);
+            zlist_destroy (&pool->queue);
+        }
+        while ((work = pool->done)) {
+            pool->done = work->next;
+            work_destroy (work);
+        }
+        flux_watcher_destroy (pool->w);
+        if (pool->fd >= 0)
+            close (pool->fd);
+        pthread_cond_destroy (&pool->idle);
+        pthread_cond_destroy (&pool->cond);
+        pthread_mutex_destroy (&pool->lock);
+        free (pool);
+        errno = saved_errno;
+    }
+}
+
+/* Prepare the worker's load statement.  The worker must be idle.
+ */
+static int worker_prepare (struct worker *w, sqlite_ctx_t *ctx)
+{
+    if (w->load_stmt)
+        sqlite3_finalize (w->load_stmt);
+    w->load_stmt = NULL;
+    if (sqlite3_prepare_v2 (w->db,
+                            ctx->migrating ? sql_load_legacy : sql_load,
+                            -1, &w->load_stmt, NULL) != SQLITE_OK)
+        return -1;
+    return 0;
+}
+
+static int worker_init (struct workpool *pool, struct worker *w)
+{
+    sqlite_ctx_t *ctx = pool->ctx;
+    int e;
+
+    w->pool = pool;
+    if (sqlite3_open_v2 (ctx->dbfile, &w->db,
+                         SQLITE_OPEN_READONLY, NULL) != SQLITE_OK
+            || sqlite3_busy_timeout (w->db, 1000) != SQLITE_OK
+            || worker_prepare (w, ctx) < 0) {
+        flux_log (ctx->h, LOG_ERR, "workpool: opening %s: %s", ctx->dbfile,
+                  w->db ? sqlite3_errmsg (w->db) : "out of memory");
+        errno = w->db ? errno_from_sqlite (w->db) : ENOMEM;
+        return -1;
+    }
+    if ((e = pthread_create (&w->t, NULL, worker_thread, w)) != 0) {
+        errno = e;
+        flux_log_error (ctx->h, "workpool: pthread_create");
+        return -1;
+    }
+    w->started = true;
+    return 0;
+}
+
+/* Worker connections read concurrently with the main connection, which
+ * requires a write-ahead log and normal (shared) locking.  Exclusive
+ * locking must be relinquished before entering WAL mode, otherwise the
+ * WAL index is kept in private heap memory.
+ */
+static struct workpool *workpool_create (sqlite_ctx_t *ctx, int count)
+{
+    struct workpool *pool;
+    int i;
+
+    if (sqlite3_exec (ctx->db, "PRAGMA locking_mode=NORMAL",
+                                        NULL, NULL, NULL) != SQLITE_OK
+            || sqlite3_exec (ctx->db, "SELECT count(*) FROM sqlite_master",
+                                        NULL, NULL, NULL) != SQLITE_OK
+            || sqlite3_exec (ctx->db, "PRAGMA journal_mode=WAL",
+                                        NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "setting sqlite workpool pragmas");
+        set_errno_from_sqlite_error (ctx);
+        return NULL;
+    }
+    if (!(pool = calloc (1, sizeof (*pool))))
+        return NULL;
+    pool->ctx = ctx;
+    pool->fd = -1;
+    pthread_mutex_init (&pool->lock, NULL);
+    pthread_cond_init (&pool->cond, NULL);
+    pthread_cond_init (&pool->idle, NULL);
+    if (!(pool->queue = zlist_new ())) {
+        errno = ENOMEM;
+        goto error;
+    }
+    if ((pool->fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        goto error;
+    if (!(pool->w = flux_fd_watcher_create (flux_get_reactor (ctx->h),
+                                            pool->fd, FLUX_POLLIN,
+                                            workpool_done_cb, pool)))
+        goto error;
+    flux_watcher_start (pool->w);
+    if (!(pool->workers = calloc (count, sizeof (pool->workers[0]))))
+        goto error;
+    pool->count = count;
+    for (i = 0; i < count; i++) {
+        if (worker_init (pool, &pool->workers[i]) < 0)
+            goto error;
+    }
+    flux_log (ctx->h, LOG_DEBUG, "workpool: %d workers", count);
+    return pool;
+error:
+    workpool_destroy (pool);
+    return NULL;
+}
+
+/* Online migration from schema version 1.  Rows are moved in batches
+ * of migrate_batch_size from an idle watcher, one transaction per batch,
+ * so requests are serviced between batches.  Each batch copies and
+ * deletes its rows in one transaction, but a blob stored while migration
+ * is in progress goes to the new tables even if the legacy table also
+ * holds it, so a blob may be found in both.  Lookups include the legacy
+ * table in the same statement and take the first match, and the dump
+ * skips legacy rows that are also in the new tables.
+ */
+static int migrate_batch (sqlite_ctx_t *ctx, int *moved)
+{
+    int i;
+
+    if (sqlite3_exec (ctx->db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "migrate: begin transaction");
+        return -1;
+    }
+    for (i = 0; i < 3; i++) {
+        sqlite3_stmt *stmt = ctx->migrate_stmt[i];
+        int rc;
+
+        if (sqlite3_bind_int (stmt, 1, migrate_batch_size) != SQLITE_OK
+                || (i < 2 && sqlite3_bind_int (stmt, 2,
+                                               small_blob_limit) != SQLITE_OK)) {
+            log_sqlite_error (ctx, "migrate: binding batch size");
+            goto error;
+        }
+        rc = sqlite3_step (stmt);
+        (void)sqlite3_reset (stmt);
+        if (rc != SQLITE_DONE) {
+            log_sqlite_error (ctx, "migrate: executing stmt");
+            goto error;
+        }
+    }
+    *moved = sqlite3_changes (ctx->db);
+    if (sqlite3_exec (ctx->db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "migrate: commit transaction");
+        goto error;
+    }
+    return 0;
+error:
+    (void)sqlite3_exec (ctx->db, "ROLLBACK", NULL, NULL, NULL);
+    return -1;
+}
+
+static void migrate_stop (sqlite_ctx_t *ctx)
+{
+    int i;
+
+    flux_watcher_stop (ctx->migrate_w);
+    for (i = 0; i < 3; i++) {
+        if (ctx->migrate_stmt[i])
+            sqlite3_finalize (ctx->migrate_stmt[i]);
+        ctx->migrate_stmt[i] = NULL;
+    }
+}
+
+/* Drop the (now empty) legacy table, and re-prepare lookup statements
+ * without it.  Workers are drained first so their statements are idle.
+ */
+static int migrate_finish (sqlite_ctx_t *ctx)
+{
+    int i;
+
+    if (ctx->pool)
+        workpool_drain (ctx->pool);
+    if (sqlite3_exec (ctx->db, "DROP TABLE objects",
+                                        NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "migrate: dropping legacy table");
+        set_errno_from_sqlite_error (ctx);
+        return -1;
+    }
+    ctx->migrating = false;
+    if (prepare_lookup_stmts (ctx) < 0)
+        return -1;
+    if (ctx->pool) {
+        for (i = 0; i < ctx->pool->count; i++) {
+            if (worker_prepare (&ctx->pool->workers[i], ctx) < 0) {
+                flux_log (ctx->h, LOG_ERR, "migrate: preparing worker stmt");
+                errno = EINVAL;
+                return -1;
+            }
+        }
+    }
+    flux_log (ctx->h, LOG_INFO, "migrate: %d objects moved to schema v%d",
+              ctx->migrate_count, schema_version);
+    return 0;
+}
+
+static void migrate_cb (flux_reactor_t *r, flux_watcher_t *w,
+                        int revents, void *arg)
+{
+    sqlite_ctx_t *ctx = arg;
+    int moved;
+    int old_state;
+
+    if (ctx->txn_active)
+        return; // paused by txn_begin(), restarted by txn_commit()
+    //delay cancellation to ensure lock-correctness in sqlite
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+    if (migrate_batch (ctx, &moved) < 0) {
+        flux_log (ctx->h, LOG_ERR, "migrate: aborted, legacy table retained");
+        migrate_stop (ctx);
+        goto done;
+    }
+    ctx->migrate_count += moved;
+    if (moved == 0) {
+        migrate_stop (ctx);
+        if (migrate_finish (ctx) < 0)
+            flux_log_error (ctx->h, "migrate: finish");
+    }
+done:
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+}
+
+static int migrate_start (sqlite_ctx_t *ctx)
+{
+    const char *sql[3] = {
+        sql_migrate_small,
+        sql_migrate_large,
+        sql_migrate_delete,
+    };
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (sqlite3_prepare_v2 (ctx->db, sql[i], -1, &ctx->migrate_stmt[i],
+                                NULL) != SQLITE_OK) {
+            log_sqlite_error (ctx, "preparing migrate stmt");
+            set_errno_from_sqlite_error (ctx);
+            return -1;
+        }
+    }
+    if (!(ctx->migrate_w = flux_idle_watcher_create (flux_get_reactor (ctx->h),
+                                                     migrate_cb, ctx)))
+        return -1;
+    flux_watcher_start (ctx->migrate_w);
+    flux_log (ctx->h, LOG_INFO, "migrate: upgrading to schema v%d",
+              schema_version);
+    return 0;
+}
+
+void load_cb (flux_t *h, flux_msg_handler_t *mh,
+              const flux_msg_t *msg, void *arg)
+{
+    sqlite_ctx_t *ctx = arg;
+    const char *blobref = "-";
+    int blobref_size;
+    uint8_t hash[BLOBREF_MAX_DIGEST_SIZE];
+    int hash_len;
+    const void *data = NULL;
+    int size = 0;
+    const char *errstr = NULL;
+    struct work *work;
+    int rc = -1;
+    int old_state;
+    //delay cancellation to ensure lock-correctness in sqlite
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+
+    if (flux_request_decode_raw (msg, NULL, (const void **)&blobref,
+                                 &blobref_size) < 0) {
+        flux_log_error (h, "load: request decode failed");
+        goto done;
+    }
+    if (!blobref || blobref[blobref_size - 1] != '\0') {
+        errno = EPROTO;
+        flux_log_error (h, "load: malformed blobref");
+        goto done;
+    }
+    if ((hash_len = blobref_strtohash (blobref, hash, sizeof (hash))) < 0) {
+        errno = ENOENT;
+        flux_log_error (h, "load: unexpected foreign blobref");
+        goto done;
+    }
+    if (ctx->pool) {
+        if (!(work = work_create (WORK_LOAD, msg)))
+            goto done;
+        memcpy (work->blob.hash, hash, hash_len);
+        work->blob.hash_len = hash_len;
+        if (workpool_submit (ctx->pool, work) < 0) {
+            work_destroy (work);
+            goto done;
+        }
+        goto out;
+    }
+    if (load_blob (ctx->load_stmt, hash, hash_len,
+                   &ctx->lzo_buf, &ctx->lzo_bufsize,
+                   &data, &size, &errstr) < 0) {
+        if (errstr)
+            flux_log_error (h, "%s", errstr);
+        goto done;
+    }
+    rc = 0;
+done:
+    if (rc < 0) {
+        if (flux_respond_error (h, msg, errno, NULL) < 0)
+            flux_log_error (h, "load: flux_respond_error");
+    }
+    else {
+        if (flux_respond_raw (h, msg, data, size) < 0)
+            flux_log_error (h, "load: flux_respond_raw");
+    }
+    (void )sqlite3_reset (ctx->load_stmt);
+out:
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+}
+
+void store_cb (flux_t *h, flux_msg_handler_t *mh,
+               const flux_msg_t *msg, void *arg)
+{
+    sqlite_ctx_t *ctx = arg;
+    const void *data;
+    int size;
+    struct blob blob;
+    struct work *work;
+    int old_state;
+    //delay cancellation to ensure lock-correctness in sqlite
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+
+    if (flux_request_decode_raw (msg, NULL, &data, &size) < 0) {
+        flux_log_error (h, "store: request decode failed");
+        goto error;
+    }
+    if (ctx->pool) {
+        if (!(work = work_create (WORK_STORE, msg)))
+            goto error;
+        if (workpool_submit (ctx->pool, work) < 0) {
+            work_destroy (work);
+            goto error;
+        }
+    }
+    else {
+        if (store_prepare (ctx, data, size,
+                           &ctx->lzo_buf, &ctx->lzo_bufsize, &blob) < 0)
+            goto error;
+        store_complete (ctx, msg, &blob);
+    }
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+    return;
+error:
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "store: flux_respond_error");
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+}
+
+void checkpoint_get_cb (flux_t *h, flux_msg_handler_t *mh,
+                        const flux_msg_t *msg, void *arg)
+{
+    sqlite_ctx_t *ctx = arg;
+    const char *key;
+    const char *value;
+    int old_state;
+    //delay cancellation to ensure lock-correctness in sqlite
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+
+    if (flux_request_unpack (msg, NULL, "{s:s}", "key", &key) < 0) {
+        flux_log_error (h, "checkpoint-get: request decode failed");
+        goto error;
+    }
+    if (sqlite3_bind_text (ctx->checkpt_get_stmt, 1, key, -1,
+                           SQLITE_STATIC) != SQLITE_OK) {
+        log_sqlite_error (ctx, "checkpoint-get: binding key");
+        set_errno_from_sqlite_error (ctx);
+        goto error;
+    }
+    if (sqlite3_step (ctx->checkpt_get_stmt) != SQLITE_ROW
+            || !(value = (const char *)sqlite3_column_text (
+                                        ctx->checkpt_get_stmt, 0))) {
+        errno = ENOENT;
+        goto error;
+    }
+    if (flux_respond_pack (h, msg, "{s:s}", "value", value) < 0)
+        flux_log_error (h, "checkpoint-get: flux_respond_pack");
+    (void )sqlite3_reset (ctx->checkpt_get_stmt);
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+    return;
+error:
+    (void )sqlite3_reset (ctx->checkpt_get_stmt);
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "checkpoint-get: flux_respond_error");
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+}
+
+/* A checkpoint must not be ordered ahead of the stores it refers to,
+ * so any open group commit transaction is committed first.
+ */
+void checkpoint_put_cb (flux_t *h, flux_msg_handler_t *mh,
+                        const flux_msg_t *msg, void *arg)
+{
+    sqlite_ctx_t *ctx = arg;
+    const char *key;
+    const char *value;
+    int old_state;
+    //delay cancellation to ensure lock-correctness in sqlite
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+
+    if (flux_request_unpack (msg, NULL, "{s:s s:s}",
+                             "key", &key,
+                             "value", &value) < 0) {
+        flux_log_error (h, "checkpoint-put: request decode failed");
+        goto error;
+    }
+    txn_commit (ctx);
+    if (sqlite3_bind_text (ctx->checkpt_put_stmt, 1, key, -1,
+                           SQLITE_STATIC) != SQLITE_OK
+            || sqlite3_bind_text (ctx->checkpt_put_stmt, 2, value, -1,
+                                  SQLITE_STATIC) != SQLITE_OK) {
+        log_sqlite_error (ctx, "checkpoint-put: binding key/value");
+        set_errno_from_sqlite_error (ctx);
+        goto error;
+    }
+    if (sqlite3_step (ctx->checkpt_put_stmt) != SQLITE_DONE) {
+        log_sqlite_error (ctx, "checkpoint-put: executing stmt");
+        set_errno_from_sqlite_error (ctx);
+        goto error;
+    }
+    (void )sqlite3_reset (ctx->checkpt_put_stmt);
+    if (flux_respond (h, msg, 0, NULL) < 0)
+        flux_log_error (h, "checkpoint-put: flux_respond");
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+    return;
+error:
+    (void )sqlite3_reset (ctx->checkpt_put_stmt);
+    if (flux_respond_error (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "checkpoint-put: flux_respond_error");
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
+}
+
+int register_backing_store (flux_t *h, bool value, const char *name)
+{
+    flux_future_t *f;
+    int saved_errno = 0;
+    int rc = -1;
+
+    if (!(f = flux_rpc_pack (h, "content.backing", FLUX_NODEID_ANY, 0,
+                             "{ s:b s:s }",
+                             "backing", value,
+                             "name", name)))
+        goto done;
+    if (flux_future_get (f, NULL) < 0)
+        goto done;
+    rc = 0;
+done:
+    saved_errno = errno;
+    flux_future_destroy (f);
+    errno = saved_errno;
+    return rc;
+}
+
+int register_content_backing_service (flux_t *h)
+{
+    int rc, saved_errno;
+    flux_future_t *f;
+    if (!(f = flux_service_register (h, "content-backing")))
+        return -1;
+    rc = flux_future_get (f, NULL);
+    saved_errno = errno;
+    flux_future_destroy (f);
+    errno = saved_errno;
+    return rc;
+}
+
+/* Intercept broker shutdown event.  If broker is shutting down,
+ * avoid transferring data back to the content cache at unload time.
+ */
+void broker_shutdown_cb (flux_t *h, flux_msg_handler_t *mh,
+                         const flux_msg_t *msg, void *arg)
+{
+    sqlite_ctx_t *ctx = arg;
+    ctx->broker_shutdown = true;
+    flux_log (h, LOG_DEBUG, "broker shutdown in progress");
+}
+
+/* Dump state for returning content to the cache at unload.
+ * Blobs are decompressed into 'arena' and sent in batches of up to
+ * DUMP_BATCH_SIZE blobs or 'dump_batch_bytes' bytes (a larger blob is
+ * sent alone) with content.store-batch.  Up to 'dump_window' batches
+ * are kept in flight, so decompression of the next batch overlaps the
+ * cache's handling of earlier ones.  A row that cannot be decoded is
+ * logged and counted as an error, and the dump continues.
+ */
+struct dump_req {
+    flux_future_t *f;
+    int count;
+};
+
+struct dump {
+    sqlite_ctx_t *ctx;
+    zlist_t *pending;               /* struct dump_req, oldest first */
+    void *arena;
+    size_t arena_size;
+    size_t arena_len;
+    size_t offsets[DUMP_BATCH_SIZE];
+    int lens[DUMP_BATCH_SIZE];
+    int count;
+    int returned;                   /* blobs acknowledged by the cache */
+    int errors;
+    double bytes;
+    struct timespec t0;
+    double last_progress;
+};
+
+static void dump_progress (struct dump *d, bool final)
+{
+    double elapsed = monotime_since (d->t0) / 1000.;
+
+    if (!final && elapsed - d->last_progress < dump_progress_interval)
+        return;
+    d->last_progress = elapsed;
+    flux_log (d->ctx->h, LOG_INFO,
+              "shutdown: %s%d entries returned to cache in %.1fs"
+              " (%.0f entries/s, %.1f MB/s)%s",
+              final ? "" : "progress: ",
+              d->returned,
+              elapsed,
+              elapsed > 0 ? d->returned / elapsed : 0,
+              elapsed > 0 ? d->bytes / elapsed / (1024*1024) : 0,
+              d->errors > 0 && final ? ", some entries failed" : "");
+}
+
+/* Wait for the oldest outstanding batch and tally the results.
+ */
+static void dump_wait_one (struct dump *d)
+{
+    struct dump_req *req;
+    int i;
+
+    if (!(req = zlist_pop (d->pending)))
+        return;
+    for (i = 0; i < req->count; i++) {
+        if (flux_content_store_batch_get (req->f, i, NULL) < 0) {
+            if (d->errors++ == 0)
+                flux_log_error (d->ctx->h, "shutdown: store");
+        }
+        else
+            d->returned++;
+    }
+    flux_future_destroy (req->f);
+    free (req);
+    dump_progress (d, false);
+}
+
+static int dump_flush (struct dump *d)
+{
+    const void *bufs[DUMP_BATCH_SIZE];
+    struct dump_req *req;
+    int i;
+
+    if (d->count == 0)
+        return 0;
+    for (i = 0; i < d->count; i++)
+        bufs[i] = (char *)d->arena + d->offsets[i];
+    if (!(req = calloc (1, sizeof (*req))))
+        return -1;
+    req->count = d->count;
+    if (!(req->f = flux_content_store_batch (d->ctx->h, bufs, d->lens,
+                                             d->count, 0))
+            || zlist_append (d->pending, req) < 0) {
+        flux_log_error (d->ctx->h, "shutdown: store");
+        flux_future_destroy (req->f);
+        free (req);
+        d->errors += d->count;
+        d->count = 0;
+        d->arena_len = 0;
+        return -1;
+    }
+    d->count = 0;
+    d->arena_len = 0;
+    while (zlist_size (d->pending) >= dump_window)
+        dump_wait_one (d);
+    return 0;
+}
+
+/* Reserve 'size' bytes in the arena for the next blob in the batch.
+ */
+static void *dump_reserve (struct dump *d, int size)
+{
+    size_t need = d->arena_len + size + 1; // never NULL, even if size=0
+
+    if (d->arena_size < need
+            && grow_buf (&d->arena, &d->arena_size, need) < 0)
+        return NULL;
+    d->offsets[d->count] = d->arena_len;
+    d->lens[d->count] = size;
+    return (char *)d->arena + d->arena_len;
+}
+
+static void dump_commit (struct dump *d, int size)
+{
+    d->arena_len += size;
+    d->bytes += size;
+    d->count++;
+}
+
+/* Step through dump_stmt, decompressing each blob into the arena.
+ */
+static int dump_all (struct dump *d)
+{
+    sqlite_ctx_t *ctx = d->ctx;
+    flux_t *h = ctx->h;
+
     while (sqlite3_step (ctx->dump_stmt) == SQLITE_ROW) {
-        const char *blobref;
-        int blobref_size;
         const void *data = NULL;
+        void *dst;
         int uncompressed_size;
         int size = sqlite3_column_bytes (ctx->dump_stmt, 0);
         if (sqlite3_column_type (ctx->dump_stmt, 0) != SQLITE_BLOB
                                                             && size > 0) {
             flux_log (h, LOG_ERR, "shutdown: encountered non-blob value");
+            d->errors++;
             continue;
         }
         data = sqlite3_column_blob (ctx->dump_stmt, 0);
         if (sqlite3_column_type (ctx->dump_stmt, 1) != SQLITE_INTEGER) {
             flux_log (h, LOG_ERR, "shutdown: selected value is not an integer");
-            errno = EINVAL;
-            goto done;
+            d->errors++;
+            continue;
         }
         uncompressed_size = sqlite3_column_int (ctx->dump_stmt, 1);
+        if (uncompressed_size < -1) {
+            flux_log (h, LOG_ERR, "shutdown: invalid blob size %d",
+                      uncompressed_size);
+            d->errors++;
+            continue;
+        }
+        if (d->count > 0 && d->arena_len + (uncompressed_size != -1
+                                            ? uncompressed_size : size)
+                                                    > dump_batch_bytes)
+            (void)dump_flush (d);
         if (uncompressed_size != -1) {
-            if (ctx->lzo_bufsize < uncompressed_size
-                            && grow_lzo_buf (ctx, uncompressed_size) < 0)
-                goto done;
-            int r = LZ4_decompress_safe (data, ctx->lzo_buf, size, uncompressed_size);
-            if (r < 0) {
-                errno = EINVAL;
-                goto done;
-            }
+            if (!(dst = dump_reserve (d, uncompressed_size)))
+                return -1;
+            int r = LZ4_decompress_safe (data, dst, size, uncompressed_size);
             if (r != uncompressed_size) {
-                flux_log (h, LOG_ERR, "shutdown: blob size mismatch");
-                errno = EINVAL;
-                goto done;
+                flux_log (h, LOG_ERR, "shutdown: %s",
+                          r < 0 ? "blob decompression failed"
+                                : "blob size mismatch");
+                d->errors++;
+                continue;
             }
-            data = ctx->lzo_buf;
             size = uncompressed_size;
         }
-        if (!(f = flux_rpc_raw (h, "content.store", data, size,
-                                                        FLUX_NODEID_ANY, 0))) {
-            flux_log_error (h, "shutdown: store");
-            continue;
-        }
-        if (flux_rpc_get_raw (f, (const void **)&blobref, &blobref_size) < 0) {
-            flux_log_error (h, "shutdown: store");
-            flux_future_destroy (f);
-            continue;
-        }
-        if (!blobref || blobref[blobref_size - 1] != '\0') {
-            flux_log (h, LOG_ERR, "shutdown: store returned malformed blobref");
-            flux_future_destroy (f);
-            continue;
+        else {
+            if (!(dst = dump_reserve (d, size)))
+                return -1;
+            if (size > 0)
+                memcpy (dst, data, size);
         }
-        flux_future_destroy (f);
-        count++;
+        dump_commit (d, size);
+        if (d->count == DUMP_BATCH_SIZE)
+            (void)dump_flush (d);
+    }
+    (void)dump_flush (d);
+    return 0;
+}
+
+/* Manage shutdown of this module.
+ * Tell content cache to disable backing store,
+ * then write everything back to it before exiting.
+ */
+void shutdown_cb (flux_t *h, flux_msg_handler_t *mh,
+                  const flux_msg_t *msg, void *arg)
+{
+    sqlite_ctx_t *ctx = arg;
+    struct dump d = { .ctx = ctx };
+    int old_state;
+
+    flux_log (h, LOG_DEBUG, "shutdown: begin");
+    //delay cancellation to ensure lock-correctness in sqlite
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+    if (ctx->pool)
+        workpool_drain (ctx->pool);
+    txn_commit (ctx);
+    if (register_backing_store (h, false, "content-sqlite") < 0) {
+        flux_log_error (h, "shutdown: unregistering backing store");
+        goto done;
     }
+    if (ctx->broker_shutdown) {
+        flux_log (h, LOG_DEBUG, "shutdown: instance is terminating, don't reload to cache");
+        goto done;
+    }
+    if (!(d.pending = zlist_new ())) {
+        flux_log (h, LOG_ERR, "shutdown: out of memory");
+        goto done;
+    }
+    monotime (&d.t0);
+    if (dump_all (&d) < 0)
+        flux_log_error (h, "shutdown: dump");
+    while (zlist_size (d.pending) > 0)
+        dump_wait_one (&d);
     (void )sqlite3_reset (ctx->dump_stmt);
-    flux_log (h, LOG_DEBUG, "shutdown: %d entries returned to cache", count);
+    dump_progress (&d, true);
 done:
+    zlist_destroy (&d.pending);
+    free (d.arena);
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_state);
     flux_reactor_stop (flux_get_reactor (h));
 }
@@ -511,17 +1710,80 @@ done:
 static const struct flux_msg_handler_spec htab[] = {
     { FLUX_MSGTYPE_REQUEST, "content-backing.load",    load_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-backing.store",   store_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-backing.checkpoint-get",
+                            checkpoint_get_cb, 0 },
+    { FLUX_MSGTYPE_REQUEST, "content-backing.checkpoint-put",
+                            checkpoint_put_cb, 0 },
     { FLUX_MSGTYPE_REQUEST, "content-sqlite.shutdown", shutdown_cb, 0, },
     { FLUX_MSGTYPE_EVENT,   "shutdown",                broker_shutdown_cb, 0 },
     FLUX_MSGHANDLER_TABLE_END,
 };
 
+static int process_args (sqlite_ctx_t *ctx, int ac, char **av)
+{
+    int i;
+
+    for (i = 0; i < ac; i++) {
+        if (strncmp (av[i], "group-commit=", 13) == 0)
+            ctx->group_commit = strtoul (av[i]+13, NULL, 10);
+        else if (strncmp (av[i], "group-commit-window=", 20) == 0)
+            ctx->group_commit_window = strtod (av[i]+20, NULL);
+        else if (strncmp (av[i], "workers=", 8) == 0)
+            ctx->workers = strtoul (av[i]+8, NULL, 10);
+        else {
+            flux_log (ctx->h, LOG_ERR, "Unknown option `%s'", av[i]);
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Group commit relies on a write-ahead log so that each COMMIT costs
+ * one sequential append rather than a rollback journal rewrite.
+ * The synchronous setting made in getctx() is left alone.  Without a
+ * worker pool the connection is still in locking_mode=EXCLUSIVE, so the
+ * WAL index is kept in heap memory; workpool_create() has already
+ * switched to NORMAL locking otherwise, and the index is shared memory.
+ */
+static int group_commit_init (sqlite_ctx_t *ctx)
+{
+    if (sqlite3_exec (ctx->db, "PRAGMA journal_mode=WAL",
+                                        NULL, NULL, NULL) != SQLITE_OK) {
+        log_sqlite_error (ctx, "setting sqlite WAL pragmas");
+        set_errno_from_sqlite_error (ctx);
+        return -1;
+    }
+    if (!(ctx->txn_timer = flux_timer_watcher_create (flux_get_reactor (ctx->h),
+                                                      0., 0.,
+                                                      txn_timer_cb, ctx)))
+        return -1;
+    flux_log (ctx->h, LOG_DEBUG, "group commit: count=%d window=%.3fs",
+              ctx->group_commit, ctx->group_commit_window);
+    return 0;
+}
+
 int mod_main (flux_t *h, int argc, char **argv)
 {
     flux_msg_handler_t **handlers = NULL;
     sqlite_ctx_t *ctx = getctx (h);
     if (!ctx)
         goto done;
+    if (process_args (ctx, argc, argv) < 0)
+        goto done;
+    if (ctx->workers > 0 && !(ctx->pool = workpool_create (ctx,
+                                                           ctx->workers))) {
+        flux_log_error (h, "initializing worker pool");
+        goto done;
+    }
+    if (ctx->group_commit > 0 && group_commit_init (ctx) < 0) {
+        flux_log_error (h, "initializing group commit");
+        goto done;
+    }
+    if (ctx->migrating && migrate_start (ctx) < 0) {
+        flux_log_error (h, "starting schema migration");
+        goto done;
+    }
     if (flux_event_subscribe (h, "shutdown") < 0) {
         flux_log_error (h, "flux_event_subscribe");
         goto done;
@@ -543,6 +1805,11 @@ int mod_main (flux_t *h, int argc, char **argv)
         goto done;
     }
 done:
+    if (ctx) {
+        if (ctx->pool)
+            workpool_drain (ctx->pool);
+        txn_commit (ctx);
+    }
     flux_msg_handler_delvec (handlers);
     return 0;
 }
@@ -27,8 +27,11 @@
 #include "config.h"
 #endif
 #include <stdlib.h>
+#include <string.h>
+#include <jansson.h>
 
 #include "src/common/libjob/job.h"
+#include "src/common/libkvs/treeobj.h"
 #include "src/common/libutil/fluid.h"
 
 #include "job.h"
@@ -166,26 +169,52 @@ error:
     return -1;
 }
 
-static flux_future_t *lookup_job_attr (flux_t *h, const char *jobdir,
-                                       const char *name)
+/* Decode value of entry 'name' in job directory 'dir'.
+ * Caller must free returned value.
+ */
+static char *job_attr (json_t *dir, const char *name)
 {
-    char key[80];
+    json_t *o;
+    void *data;
+    int len;
 
-    if (snprintf (key, sizeof (key), "%s.%s", jobdir, name) >= sizeof (key)) {
+    if (!(o = treeobj_get_entry (dir, name))
+        || treeobj_decode_val (o, &data, &len) < 0)
+        return NULL;
+    if (!data) {
         errno = EINVAL;
         return NULL;
     }
-    return flux_kvs_lookup (h, 0, key);
+    return data; // N.B. data is NULL terminated
+}
+
+static int job_attr_int (json_t *dir, const char *name, int *value)
+{
+    char *s;
+    json_t *o;
+    int rc = -1;
+
+    if (!(s = job_attr (dir, name)))
+        return -1;
+    if (!(o = json_loads (s, JSON_DECODE_ANY, NULL))
+        || json_unpack (o, "i", value) < 0) {
+        errno = EINVAL;
+        goto done;
+    }
+    rc = 0;
+done:
+    json_decref (o);
+    free (s);
+    return rc;
 }
 
-static int depthfirst_map_one (flux_t *h, const char *key, int dirskip,
-                               active_map_f cb, void *arg)
+static int map_one (const char *key, int dirskip, json_t *dir,
+                    active_map_f cb, void *arg)
 {
     flux_jobid_t id;
-    flux_future_t *f = NULL;
-    uint32_t userid;
+    int userid;
     int priority;
-    const char *eventlog;
+    char *eventlog;
     struct job *job;
     double t_submit;
     int flags;
@@ -196,100 +225,72 @@ static int depthfirst_map_one (flux_t *h, const char *key, int dirskip,
     }
     if (fluid_decode (key + dirskip + 1, &id, FLUID_STRING_DOTHEX) < 0)
         return -1;
-    /* userid */
-    if (!(f = lookup_job_attr (h, key, "userid")))
-        goto error;
-    if (flux_kvs_lookup_get_unpack (f, "i", &userid) < 0)
-        goto error_future;
-    flux_future_destroy (f);
-
-    /* priority */
-    if (!(f = lookup_job_attr (h, key, "priority")))
-        goto error;
-    if (flux_kvs_lookup_get_unpack (f, "i", &priority) < 0)
-        goto error_future;
-    flux_future_destroy (f);
-
+    if (job_attr_int (dir, "userid", &userid) < 0)
+        return -1;
+    if (job_attr_int (dir, "priority", &priority) < 0)
+        return -1;
     /* t_submit, inactive (via eventlog) */
-    if (!(f = lookup_job_attr (h, key, "eventlog")))
-        goto error;
-    if (flux_kvs_lookup_get (f, &eventlog) < 0)
-        goto error_future;
-    if (decode_eventlog (eventlog, &t_submit, &flags) < 0)
-        goto error_future;
-    flux_future_destroy (f);
+    if (!(eventlog = job_attr (dir, "eventlog")))
+        return -1;
+    if (decode_eventlog (eventlog, &t_submit, &flags) < 0) {
+        free (eventlog);
+        return -1;
+    }
+    free (eventlog);
 
     /* make callback */
     if (!(job = job_create (id, priority, userid, t_submit, flags)))
-        goto error;
+        return -1;
     if (cb (job, arg) < 0) {
         job_decref (job);
-        goto error;
+        return -1;
     }
     job_decref (job);
     return 1;
-error_future:
-    flux_future_destroy (f);
-error:
-    return -1;
 }
 
-static int depthfirst_map (flux_t *h, const char *key,
-                           int dirskip, active_map_f cb, void *arg)
+/* Fetch the active job directory with one streaming lookup.  Job
+ * directories are FLUID_STRING_DOTHEX encoded, so are four levels
+ * below 'dirname', and the KVS is asked not to descend below them.
+ */
+int active_map (flux_t *h, active_map_f cb, void *arg)
 {
+    const char *dirname = "job.active";
+    int dirskip = strlen (dirname);
     flux_future_t *f;
-    const flux_kvsdir_t *dir;
-    flux_kvsitr_t *itr;
-    const char *name;
-    int path_level;
+    const char *key;
+    const char *s;
+    json_t *dir;
     int count = 0;
     int rc = -1;
 
-    path_level = count_char (key + dirskip, '.');
-    if (!(f = flux_kvs_lookup (h, FLUX_KVS_READDIR, key)))
+    if (!(f = flux_kvs_lookup_subtree (h, 0, dirname, 4, NULL)))
         return -1;
-    if (flux_kvs_lookup_get_dir (f, &dir) < 0) {
-        if (errno == ENOENT && path_level == 0)
-            rc = 0;
-        goto done;
-    }
-    if (!(itr = flux_kvsitr_create (dir)))
-        goto done;
-    while ((name = flux_kvsitr_next (itr))) {
-        char *nkey;
-        int n;
-        if (!flux_kvsdir_isdir (dir, name))
-            continue;
-        if (!(nkey = flux_kvsdir_key_at (dir, name)))
-            goto done_destroyitr;
-        if (path_level == 3) // orig 'key' = .A.B.C, thus 'nkey' is complete
-            n = depthfirst_map_one (h, nkey, dirskip, cb, arg);
-        else
-            n = depthfirst_map (h, nkey, dirskip, cb, arg);
-        if (n < 0) {
-            int saved_errno = errno;
-            free (nkey);
-            errno = saved_errno;
-            goto done_destroyitr;
+    while (flux_kvs_lookup_get_treeobj (f, &s) == 0) {
+        if (!(key = flux_kvs_lookup_get_key (f)))
+            goto done;
+        if (count_char (key + dirskip, '.') == 4) {
+            int n;
+
+            if (!(dir = treeobj_decode (s)))
+                goto done;
+            n = map_one (key, dirskip, dir, cb, arg);
+            json_decref (dir);
+            if (n < 0)
+                goto done;
+            count += n;
         }
-        count += n;
-        free (nkey);
+        flux_future_reset (f);
     }
-    rc = count;
-done_destroyitr:
-    flux_kvsitr_destroy (itr);
+    /* ENODATA ends the stream.  ENOENT means no active jobs.
+     */
+    if (errno == ENODATA || (errno == ENOENT && count == 0))
+        rc = count;
 done:
     flux_future_destroy (f);
     return rc;
 }
 
-int active_map (flux_t *h, active_map_f cb, void *arg)
-{
-    const char *dirname = "job.active";
-
-    return depthfirst_map (h, dirname, strlen (dirname), cb, arg);
-}
-
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
@@ -21,6 +21,36 @@
 #include "src/common/libkvs/kvs_util_private.h"
 #include "src/common/libutil/blobref.h"
 
+/* Lookup flags that affect the value returned by the kvs.
+ * Watchers whose flags differ only outside of this mask may share lookups.
+ */
+#define LOOKUP_FLAGS (FLUX_KVS_READDIR | FLUX_KVS_READLINK | FLUX_KVS_TREEOBJ)
+
+/* One kvs.lookup-plus RPC.  After a root change, a lookup is shared by
+ * all watchers of the changed key with the same creds and lookup flags.
+ * Each watcher holding the lookup in its w->lookups list holds a reference,
+ * as does the subscription while the lookup may still be shared.
+ */
+struct lookup {
+    flux_future_t *f;           // lookup future
+    int refcount;
+    int flags;                  // kvs_lookup flags
+    uint32_t rolemask;          // request cred
+    uint32_t userid;            // request cred
+    int append_offset;          // FLUX_KVS_WATCH_APPEND offset, or -1
+    zlist_t *watchers;          // watchers with this lookup in w->lookups
+};
+
+/* Watchers of one key in a namespace.
+ */
+struct subscription {
+    char *key;                  // normalized key, hash key for ns->subscriptions
+    zlist_t *watchers;          // watchers of this key
+    int rootseq;                // root sequence number of 'lookups'
+    zlist_t *lookups;           // shared lookups sent for 'rootseq'
+    int visit_rootseq;          // last root sequence number visited
+};
+
 /* State for one watcher */
 struct watcher {
     flux_msg_t *request;        // request message
@@ -36,9 +66,13 @@ struct watcher {
     int initial_rootseq;        // initial rootseq returned by initial rpc
     char *key;                  // lookup key
     int flags;                  // kvs_lookup flags
-    zlist_t *lookups;           // list of futures, in commit order
+    zlist_t *lookups;           // list of struct lookup, in commit order
+    int append_offset;          // blobs already sent, FLUX_KVS_WATCH_APPEND
+    bool append_pending;        // root changed during FLUX_KVS_WATCH_APPEND
+                                //  lookup, look up again when it completes
 
     struct namespace *ns;       // back pointer for removal
+    struct subscription *sub;   // back pointer for removal
     json_t *prev;               // previous watch value for KVS_WATCH_FULL
 };
 
@@ -63,6 +97,8 @@ struct namespace {
     int errnum;                 // if non-zero, error pending for all watchers
     struct watch_ctx *ctx;      // back-pointer to watch_ctx
     zlist_t *watchers;          // list of watchers of this namespace
+    zhash_t *subscriptions;     // key => struct subscription
+    zlist_t *full_watchers;     // watchers with FLUX_KVS_WATCH_FULL
     char *setroot_topic;        // topic string for setroot subscription
     bool setroot_subscribed;    // setroot subscription active
     char *created_topic;        // topic string for kvs.namespace-created
@@ -78,8 +114,93 @@ struct watch_ctx {
     flux_t *h;
     flux_msg_handler_t **handlers;
     zhash_t *namespaces;        // hash of monitored namespaces
+    int lookups;                // count of lookup RPCs sent
 };
 
+static void lookup_decref (struct lookup *l)
+{
+    if (l && --l->refcount == 0) {
+        int saved_errno = errno;
+        flux_future_destroy (l->f);
+        zlist_destroy (&l->watchers);
+        free (l);
+        errno = saved_errno;
+    }
+}
+
+static struct lookup *lookup_incref (struct lookup *l)
+{
+    if (l)
+        l->refcount++;
+    return l;
+}
+
+static struct lookup *lookup_create (flux_future_t *f, int flags,
+                                     uint32_t rolemask, uint32_t userid,
+                                     int append_offset)
+{
+    struct lookup *l;
+
+    if (!(l = calloc (1, sizeof (*l))))
+        return NULL;
+    if (!(l->watchers = zlist_new ())) {
+        free (l);
+        errno = ENOMEM;
+        return NULL;
+    }
+    l->f = f;
+    l->flags = flags;
+    l->rolemask = rolemask;
+    l->userid = userid;
+    l->append_offset = append_offset;
+    l->refcount = 1;
+    return l;
+}
+
+static void subscription_clear_lookups (struct subscription *sub)
+{
+    struct lookup *l;
+
+    while ((l = zlist_pop (sub->lookups)))
+        lookup_decref (l);
+}
+
+static void subscription_destroy (struct subscription *sub)
+{
+    if (sub) {
+        int saved_errno = errno;
+        if (sub->lookups) {
+            subscription_clear_lookups (sub);
+            zlist_destroy (&sub->lookups);
+        }
+        zlist_destroy (&sub->watchers);
+        free (sub->key);
+        free (sub);
+        errno = saved_errno;
+    }
+}
+
+static struct subscription *subscription_create (const char *key)
+{
+    struct subscription *sub;
+
+    if (!(sub = calloc (1, sizeof (*sub))))
+        return NULL;
+    if (!(sub->key = strdup (key)))
+        goto error;
+    if (!(sub->watchers = zlist_new ())
+        || !(sub->lookups = zlist_new ()))
+        goto error_nomem;
+    sub->rootseq = -1;
+    sub->visit_rootseq = -1;
+    return sub;
+error_nomem:
+    errno = ENOMEM;
+error:
+    subscription_destroy (sub);
+    return NULL;
+}
+
 static void watcher_destroy (struct watcher *w)
 {
     if (w) {
@@ -87,9 +208,11 @@ static void watcher_destroy (struct watcher *w)
         flux_msg_destroy (w->request);
         free (w->key);
         if (w->lookups) {
-            flux_future_t *f;
-            while ((f = zlist_pop (w->lookups)))
-                flux_future_destroy (f);
+            struct lookup *l;
+            while ((l = zlist_pop (w->lookups))) {
+                zlist_remove (l->watchers, w);
+                lookup_decref (l);
+            }
             zlist_destroy (&w->lookups);
         }
         json_decref (w->prev);
@@ -163,6 +286,10 @@ static void namespace_destroy (struct namespace *ns)
                 watcher_destroy (w);
             zlist_destroy (&ns->watchers);
         }
+        /* N.B. destroy subscriptions after watchers, since watchers hold
+         * pointers to them */
+        zhash_destroy (&ns->subscriptions);
+        zlist_destroy (&ns->full_watchers);
         if (ns->setroot_subscribed)
             (void)flux_event_unsubscribe (ns->ctx->h, ns->setroot_topic);
         if (ns->created_subscribed)
@@ -185,7 +312,9 @@ static struct namespace *namespace_create (struct watch_ctx *ctx,
     struct namespace *ns = calloc (1, sizeof (*ns));
     if (!ns)
         return NULL;
-    if (!(ns->watchers = zlist_new ()))
+    if (!(ns->watchers = zlist_new ())
+        || !(ns->subscriptions = zhash_new ())
+        || !(ns->full_watchers = zlist_new ()))
         goto error;
     if (!(ns->name = strdup (namespace)))
         goto error;
@@ -227,27 +356,59 @@ static int check_authorization (struct namespace *ns,
     return -1;
 }
 
-/* Helper for watcher_respond - is key a member of array?
- * N.B. array 'a' can be NULL
+/* Remove watcher 'w' from ns->watchers and from the subscription
+ * table, destroying its subscription if it has no more watchers.
  */
-static bool array_match (json_t *a, const char *key)
+static void namespace_unsubscribe (struct namespace *ns, struct watcher *w)
 {
-    size_t index;
-    json_t *value;
+    zlist_remove (ns->watchers, w);
+    zlist_remove (ns->full_watchers, w);
+    if (w->sub) {
+        zlist_remove (w->sub->watchers, w);
+        if (zlist_size (w->sub->watchers) == 0)
+            zhash_delete (ns->subscriptions, w->sub->key);
+        w->sub = NULL;
+    }
+}
+
+/* Add watcher 'w' to ns->watchers and to the subscription for its key,
+ * creating the subscription if necessary.
+ */
+static int namespace_subscribe (struct namespace *ns, struct watcher *w)
+{
+    struct subscription *sub;
 
-    json_array_foreach (a, index, value) {
-        const char *s = json_string_value (value);
-        if (s && !strcmp (s, key))
-            return true;
+    if (!(sub = zhash_lookup (ns->subscriptions, w->key))) {
+        if (!(sub = subscription_create (w->key)))
+            return -1;
+        if (zhash_insert (ns->subscriptions, w->key, sub) < 0) {
+            subscription_destroy (sub);
+            errno = EEXIST;
+            return -1;
+        }
+        zhash_freefn (ns->subscriptions, w->key,
+                      (zhash_free_fn *)subscription_destroy);
     }
-    return false;
+    w->sub = sub;
+    if (zlist_append (sub->watchers, w) < 0)
+        goto nomem;
+    if ((w->flags & FLUX_KVS_WATCH_FULL)
+        && zlist_append (ns->full_watchers, w) < 0)
+        goto nomem;
+    if (zlist_append (ns->watchers, w) < 0)
+        goto nomem;
+    return 0;
+nomem:
+    namespace_unsubscribe (ns, w);
+    errno = ENOMEM;
+    return -1;
 }
 
 static void watcher_cleanup (struct namespace *ns, struct watcher *w)
 {
     /* wait for all in flight lookups to complete before destroying watcher */
     if (zlist_size (w->lookups) == 0) {
-        zlist_remove (ns->watchers, w);
+        namespace_unsubscribe (ns, w);
         watcher_destroy (w);
     }
     /* if ns->getrootf, destroy when getroot_continuation completes */
@@ -337,6 +498,7 @@ static void handle_lookup_response (flux_future_t *f,
     flux_t *h = flux_future_get_flux (f);
     int errnum;
     int root_seq;
+    int blobcount;
     json_t *val;
 
     if (flux_future_aux_get (f, "initial")) {
@@ -380,6 +542,13 @@ static void handle_lookup_response (flux_future_t *f,
             goto error;
         }
 
+        if ((w->flags & FLUX_KVS_WATCH_APPEND)) {
+            if (flux_rpc_get_unpack (f, "{ s:i }",
+                                     "blobcount", &blobcount) < 0)
+                goto error;
+            w->append_offset = blobcount;
+        }
+
         if (handle_initial_response (h, w, val, root_seq) < 0)
             goto error;
     }
@@ -403,6 +572,18 @@ static void handle_lookup_response (flux_future_t *f,
         if (root_seq < w->initial_rootseq)
             return;
 
+        /* FLUX_KVS_WATCH_APPEND: val holds only the data appended
+         * after w->append_offset.  Nothing to send if nothing new.
+         */
+        if ((w->flags & FLUX_KVS_WATCH_APPEND)) {
+            if (flux_rpc_get_unpack (f, "{ s:i }",
+                                     "blobcount", &blobcount) < 0)
+                goto error;
+            if (blobcount == w->append_offset)
+                return;
+            w->append_offset = blobcount;
+        }
+
         if (!w->mute) {
             if ((w->flags & FLUX_KVS_WATCH_FULL)
                 || (w->flags & FLUX_KVS_WATCH_UNIQ)) {
@@ -424,20 +605,24 @@ error:
     w->finished = true;
 }
 
-/* One lookup has completed.
- * Pop ready futures off w->lookups and send responses, until
- * the list is empty, or a non-ready future is encountered.
+static int process_lookup_response (struct namespace *ns, struct watcher *w);
+
+/* Pop ready lookups off w->lookups and send responses, until
+ * the list is empty, or a non-ready lookup is encountered.
+ * A FLUX_KVS_WATCH_APPEND lookup deferred by watcher_respond() is sent
+ * once the list is empty, since its offset is only known then.
  */
-static void lookup_continuation (flux_future_t *f, void *arg)
+static void watcher_process_lookups (struct watcher *w)
 {
-    struct watcher *w = arg;
     struct namespace *ns = w->ns;
+    struct lookup *l;
 
-    while ((f = zlist_first (w->lookups)) && flux_future_is_ready (f)) {
-        f = zlist_pop (w->lookups);
+    while ((l = zlist_first (w->lookups)) && flux_future_is_ready (l->f)) {
+        l = zlist_pop (w->lookups);
+        zlist_remove (l->watchers, w);
         if (!w->finished)
-            handle_lookup_response (f, w);
-        flux_future_destroy (f);
+            handle_lookup_response (l->f, w);
+        lookup_decref (l);
         /* if WAITCREATE and !WATCH, then we only care about sending
          * one response and being done.  We can use the responded flag
          * to indicate that condition.
@@ -447,10 +632,50 @@ static void lookup_continuation (flux_future_t *f, void *arg)
             && !(w->flags & FLUX_KVS_WATCH))
             w->finished = true;
     }
+    if (w->append_pending
+        && !w->finished
+        && zlist_size (w->lookups) == 0) {
+        w->append_pending = false;
+        if (process_lookup_response (ns, w) < 0) {
+            if (!w->mute) {
+                if (flux_respond_error (ns->ctx->h, w->request, errno,
+                                        NULL) < 0)
+                    flux_log_error (ns->ctx->h, "%s: flux_respond_error",
+                                    __FUNCTION__);
+            }
+            w->finished = true;
+        }
+    }
     if (w->finished)
         watcher_cleanup (ns, w);
 }
 
+/* One lookup has completed.
+ * Process lookups of every watcher sharing it.
+ * N.B. watcher_process_lookups() may destroy the watcher, the lookup,
+ * and if the last watcher is destroyed, the namespace.  Since a watcher
+ * can only destroy itself, iterate over a duplicate of l->watchers and
+ * don't touch 'l' afterwards.
+ */
+static void lookup_continuation (flux_future_t *f, void *arg)
+{
+    struct lookup *l = arg;
+    zlist_t *watchers;
+    struct watcher *w;
+
+    if (!(watchers = zlist_dup (l->watchers))) {
+        flux_log_error (flux_future_get_flux (f), "%s: zlist_dup",
+                        __FUNCTION__);
+        return;
+    }
+    w = zlist_first (watchers);
+    while (w) {
+        watcher_process_lookups (w);
+        w = zlist_next (watchers);
+    }
+    zlist_destroy (&watchers);
+}
+
 /* Like flux_kvs_lookupat() except:
  * - targets kvs.lookup-plus, so root_ref & root_seq are available in
  *   response
@@ -466,31 +691,34 @@ static flux_future_t *lookupat (flux_t *h,
                                 const char *namespace)
 {
     flux_msg_t *msg;
+    json_t *req = NULL;
     json_t *o = NULL;
     flux_future_t *f;
     int saved_errno;
 
     if (!(msg = flux_request_encode ("kvs.lookup-plus", NULL)))
         return NULL;
-    if (!w->initial_rpc_sent) {
-        if (flux_msg_pack (msg, "{s:s s:s s:i}",
+    if (!(req = json_pack ("{s:s s:s s:i}",
                            "key", w->key,
                            "namespace", namespace,
-                           "flags", w->flags) < 0)
-            goto error;
-    }
-    else {
+                           "flags", w->flags)))
+        goto nomem;
+    if (w->initial_rpc_sent) {
         if (!(o = treeobj_create_dirref (blobref)))
             goto error;
-        if (flux_msg_pack (msg, "{s:s s:s s:i s:i s:O}",
-                           "key", w->key,
-                           "namespace", namespace,
-                           "flags", w->flags,
-                           "rootseq", root_seq,
-                           "rootdir", o) < 0)
-            goto error;
+        if (json_object_set (req, "rootdir", o) < 0
+            || json_object_set_new (req, "rootseq",
+                                    json_integer (root_seq)) < 0)
+            goto nomem;
     }
-    /* N.B. Since this module is authenticated to the shmem:// connector
+    /* FLUX_KVS_WATCH_APPEND - only request data not yet sent */
+    if ((w->flags & FLUX_KVS_WATCH_APPEND)
+        && json_object_set_new (req, "append_offset",
+                                json_integer (w->append_offset)) < 0)
+        goto nomem;
+    if (flux_msg_pack (msg, "O", req) < 0)
+        goto error;
+    /* N.B. Since this module is authenticated to the broker
      * with FLUX_ROLE_OWNER, we are allowed to switch the message credentials
      * in this request message, and not be overridden at the connector,
      * as would be the case if we were not sufficiently privileged.
@@ -510,35 +738,113 @@ static flux_future_t *lookupat (flux_t *h,
         }
     }
     w->initial_rpc_sent = true;
+    w->ns->ctx->lookups++;
     flux_msg_destroy (msg);
+    json_decref (req);
     json_decref (o);
     return f;
+nomem:
+    errno = ENOMEM;
 error:
     saved_errno = errno;
+    json_decref (req);
     json_decref (o);
     flux_msg_destroy (msg);
     errno = saved_errno;
     return NULL;
 }
 
+/* Return the append offset that a lookup for 'w' would be sent with,
+ * or -1 if 'w' is not a FLUX_KVS_WATCH_APPEND watcher.
+ */
+static int watcher_append_offset (struct watcher *w)
+{
+    return (w->flags & FLUX_KVS_WATCH_APPEND) ? w->append_offset : -1;
+}
+
+/* Find a lookup of the current root already sent on behalf of another
+ * watcher of the same key, with the same creds and lookup flags.
+ * Lookups of older roots are dropped from the subscription.  A lookup
+ * that has already been fulfilled is not shared, since its continuation
+ * will not run again.
+ */
+static struct lookup *subscription_find_lookup (struct subscription *sub,
+                                                int rootseq,
+                                                struct watcher *w)
+{
+    struct lookup *l;
+
+    if (sub->rootseq != rootseq) {
+        subscription_clear_lookups (sub);
+        sub->rootseq = rootseq;
+        return NULL;
+    }
+    l = zlist_first (sub->lookups);
+    while (l) {
+        if (!flux_future_is_ready (l->f)
+            && (l->flags & LOOKUP_FLAGS) == (w->flags & LOOKUP_FLAGS)
+            && l->append_offset == watcher_append_offset (w)
+            && l->rolemask == w->rolemask
+            && l->userid == w->userid)
+            return l;
+        l = zlist_next (sub->lookups);
+    }
+    return NULL;
+}
+
+/* Send a lookup of the current root, or join one already sent.
+ * The initial lookup of a watcher is never shared, since it is made
+ * against whatever root the kvs has when the request arrives.
+ */
 static int process_lookup_response (struct namespace *ns, struct watcher *w)
 {
+    struct lookup *l = NULL;
     flux_future_t *f;
-    if (!(f = lookupat (ns->ctx->h,
-                        w,
-                        ns->commit->rootref,
-                        ns->commit->rootseq,
-                        ns->name))) {
-        flux_log_error (ns->ctx->h, "%s: lookupat", __FUNCTION__);
-        return -1;
+    bool initial = !w->initial_rpc_sent;
+
+    if (!initial)
+        l = subscription_find_lookup (w->sub, ns->commit->rootseq, w);
+    if (l)
+        lookup_incref (l);
+    else {
+        if (!(f = lookupat (ns->ctx->h,
+                            w,
+                            ns->commit->rootref,
+                            ns->commit->rootseq,
+                            ns->name))) {
+            flux_log_error (ns->ctx->h, "%s: lookupat", __FUNCTION__);
+            return -1;
+        }
+        if (!(l = lookup_create (f,
+                                 w->flags,
+                                 w->rolemask,
+                                 w->userid,
+                                 watcher_append_offset (w)))) {
+            flux_future_destroy (f);
+            return -1;
+        }
+        if (flux_future_then (f, -1., lookup_continuation, l) < 0) {
+            lookup_decref (l);
+            return -1;
+        }
+        if (!initial) {
+            if (zlist_append (w->sub->lookups, lookup_incref (l)) < 0) {
+                lookup_decref (l);
+                lookup_decref (l);
+                errno = ENOMEM;
+                return -1;
+            }
+        }
     }
-    if (zlist_append (w->lookups, f) < 0) {
-        flux_future_destroy (f);
+    if (zlist_append (w->lookups, l) < 0) {
+        lookup_decref (l);
         errno = ENOMEM;
         return -1;
     }
-    if (flux_future_then (f, -1., lookup_continuation, w) < 0) {
-        flux_future_destroy (f);
+    if (zlist_append (l->watchers, w) < 0) {
+        zlist_remove (w->lookups, l);
+        lookup_decref (l);
+        errno = ENOMEM;
         return -1;
     }
     w->rootseq = ns->commit->rootseq;
@@ -546,10 +852,12 @@ static int process_lookup_response (struct namespace *ns, struct watcher *w)
 }
 
 /* Respond to watcher request, if appropriate.
+ * 'changed' is true if the current commit changed the watched key.
  * De-list and destroy watcher from namespace on error.
  * De-hash and destroy namespace if watchers list becomes empty.
  */
-static void watcher_respond (struct namespace *ns, struct watcher *w)
+static void watcher_respond (struct namespace *ns, struct watcher *w,
+                             bool changed)
 {
     /* If this watcher is already done, we should ignore namespace
      * remove, setroot, cancel, etc.  that leads us here.  Just goto
@@ -604,11 +912,25 @@ static void watcher_respond (struct namespace *ns, struct watcher *w)
      *
      * Note on FLUX_KVS_WATCH_FULL: A lookup / comparison is done on every
      * change.
+     *
+     * Lookups after the initial one are shared by watchers of the same
+     * key, see process_lookup_response().
+     *
+     * Note on FLUX_KVS_WATCH_APPEND: A lookup requests only the data
+     * appended after the blobs already sent, which is not known until
+     * any lookup in flight completes.  Only one lookup is in flight at a
+     * time, and changes in the meantime are covered by one lookup of
+     * the latest root, sent by watcher_process_lookups().
      */
     if (w->rootseq == -1
         || (w->flags & FLUX_KVS_WATCH_FULL)
-        || array_match (ns->commit->keys, w->key)) {
-        if (process_lookup_response (ns, w) < 0)
+        || changed) {
+        if ((w->flags & FLUX_KVS_WATCH_APPEND)
+            && zlist_size (w->lookups) > 0) {
+            w->append_pending = true;
+            w->rootseq = ns->commit->rootseq;
+        }
+        else if (process_lookup_response (ns, w) < 0)
             goto error_respond;
     }
     return;
@@ -635,7 +957,7 @@ static void watcher_respond_ns (struct namespace *ns)
     if ((l = zlist_dup (ns->watchers))) {
         w = zlist_first (l);
         while (w) {
-            watcher_respond (ns, w);
+            watcher_respond (ns, w, false);
             w = zlist_next (l);
         }
         zlist_destroy (&l);
@@ -644,6 +966,60 @@ static void watcher_respond_ns (struct namespace *ns)
         flux_log_error (ns->ctx->h, "%s: zlist_dup", __FUNCTION__);
 }
 
+/* Respond to watchers affected by the current commit: watchers of keys
+ * in commit->keys, found through ns->subscriptions, and watchers with
+ * FLUX_KVS_WATCH_FULL.  Other watchers are not visited.
+ * N.B. as in watcher_respond_ns(), a temporary list is built since
+ * watcher_respond() may destroy watchers, subscriptions, and the namespace.
+ * Each watcher appears on the list once, so the namespace can only be
+ * destroyed on the last call.
+ */
+static void watcher_respond_commit (struct namespace *ns)
+{
+    zlist_t *l;
+    struct watcher *w;
+    struct subscription *sub;
+    size_t index;
+    json_t *value;
+    int rootseq = ns->commit->rootseq;
+
+    if (!(l = zlist_new ())) {
+        flux_log_error (ns->ctx->h, "%s: zlist_new", __FUNCTION__);
+        return;
+    }
+    json_array_foreach (ns->commit->keys, index, value) {
+        const char *key = json_string_value (value);
+        if (!key
+            || !(sub = zhash_lookup (ns->subscriptions, key))
+            || sub->visit_rootseq == rootseq)
+            continue;
+        sub->visit_rootseq = rootseq;
+        w = zlist_first (sub->watchers);
+        while (w) {
+            if (!(w->flags & FLUX_KVS_WATCH_FULL)
+                && zlist_append (l, w) < 0)
+                goto nomem;
+            w = zlist_next (sub->watchers);
+        }
+    }
+    w = zlist_first (ns->full_watchers);
+    while (w) {
+        if (zlist_append (l, w) < 0)
+            goto nomem;
+        w = zlist_next (ns->full_watchers);
+    }
+    w = zlist_first (l);
+    while (w) {
+        watcher_respond (ns, w, true);
+        w = zlist_next (l);
+    }
+    zlist_destroy (&l);
+    return;
+nomem:
+    flux_log (ns->ctx->h, LOG_ERR, "%s: out of memory", __FUNCTION__);
+    zlist_destroy (&l);
+}
+
 /* Cancel watcher 'w' if it matches (sender, matchtag).
  * matchtag=FLUX_MATCHTAG_NONE matches any matchtag.
  * If 'mute' is true, suppress response (e.g. for disconnect handling).
@@ -663,7 +1039,7 @@ static void watcher_cancel (struct namespace *ns, struct watcher *w,
     if (!strcmp (sender, s)) {
         w->cancelled = true;
         w->mute = mute;
-        watcher_respond (ns, w);
+        watcher_respond (ns, w, false);
     }
     free (s);
 }
@@ -787,6 +1163,7 @@ static void setroot_cb (flux_t *h, flux_msg_handler_t *mh,
     int owner;
     json_t *keys;
     struct commit *commit;
+    bool first;
 
     if (flux_event_unpack (msg, NULL, "{s:s s:i s:s s:i s:o}",
                            "namespace", &namespace,
@@ -800,6 +1177,7 @@ static void setroot_cb (flux_t *h, flux_msg_handler_t *mh,
     if (!(ns = zhash_lookup (ctx->namespaces, namespace))
             || (ns->commit && rootseq <= ns->commit->rootseq))
         return;
+    first = (ns->commit == NULL);
     if (!(commit = commit_create (rootref, rootseq, keys))) {
         flux_log_error (h, "%s: error creating commit", __FUNCTION__);
         ns->errnum = errno;
@@ -810,7 +1188,13 @@ static void setroot_cb (flux_t *h, flux_msg_handler_t *mh,
     if (ns->owner == FLUX_USERID_UNKNOWN)
         ns->owner = owner;
 done:
-    watcher_respond_ns (ns);
+    /* Until the namespace has a commit, watchers are waiting for their
+     * initial lookup, and pending errors go to all watchers.
+     */
+    if (first || ns->errnum != 0 || ns->fatal_errnum != 0)
+        watcher_respond_ns (ns);
+    else
+        watcher_respond_commit (ns);
 }
 
 /* kvs.getroot response for initial namespace creation
@@ -923,13 +1307,12 @@ static void lookup_cb (flux_t *h, flux_msg_handler_t *mh,
     if (!(w = watcher_create (msg, key_suffix ? key_suffix : key, flags)))
         goto error;
     w->ns = ns;
-    if (zlist_append (ns->watchers, w) < 0) {
+    if (namespace_subscribe (ns, w) < 0) {
         watcher_destroy (w);
-        errno = ENOMEM;
         goto error;
     }
     if (ns->commit)
-        watcher_respond (ns, w);
+        watcher_respond (ns, w, false);
     free (ns_prefix);
     free (key_suffix);
     return;
@@ -1001,13 +1384,14 @@ static void stats_cb (flux_t *h, flux_msg_handler_t *mh,
         goto nomem;
     ns = zhash_first (ctx->namespaces);
     while (ns) {
-        json_t *o = json_pack ("{s:i s:i s:s s:i}",
+        json_t *o = json_pack ("{s:i s:i s:s s:i s:i}",
                                "owner", (int)ns->owner,
                                "rootseq", ns->commit ? ns->commit->rootseq
                                                      : -1,
                                "rootref", ns->commit ? ns->commit->rootref
                                                      : "(null)",
-                               "watchers", (int)zlist_size (ns->watchers));
+                               "watchers", (int)zlist_size (ns->watchers),
+                               "keys", (int)zhash_size (ns->subscriptions));
         if (!o)
             goto nomem;
         if (json_object_set_new (stats, ns->name, o) < 0) {
@@ -1017,9 +1401,10 @@ static void stats_cb (flux_t *h, flux_msg_handler_t *mh,
         watchers += zlist_size (ns->watchers);
         ns = zhash_next (ctx->namespaces);
     }
-    if (flux_respond_pack (h, msg, "{s:i s:i s:O}",
+    if (flux_respond_pack (h, msg, "{s:i s:i s:i s:O}",
                            "watchers", watchers,
                            "namespace-count", (int)zhash_size (ctx->namespaces),
+                           "lookups", ctx->lookups,
                            "namespaces", stats) < 0)
         flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
     json_decref (stats);
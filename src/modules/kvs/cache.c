@@ -28,9 +28,11 @@
 
 #include "src/common/libkvs/treeobj.h"
 #include "src/common/libutil/blobref.h"
+#include "src/common/libutil/blobz.h"
+#include "src/common/libutil/digestmap.h"
+#include "src/common/libutil/sha256.h"
 #include "src/common/libutil/tstat.h"
 #include "src/common/libutil/log.h"
-#include "src/common/libutil/iterators.h"
 #include "src/common/libkvs/kvs_util_private.h"
 
 #include "waitqueue.h"
@@ -47,14 +49,59 @@ struct cache_entry {
                              * set, don't use data == NULL as test, as
                              * zero length data can be valid */
     bool dirty;
+    bool compressed;        /* data is in blobz encoding */
     int errnum;
     char *blobref;
+    struct cache *cache;    /* set once inserted */
 };
 
 struct cache {
-    zhashx_t *zhx;
+    struct digestmap *map;  /* entries by digest of blobref */
+    pthread_mutex_t lock;
+    bool parallel;          /* inside cache_parallel_begin/end */
+    zlist_t *deferred;      /* entries with waitlist_valid to run at end */
 };
 
+struct expire_args {
+    int current_epoch;
+    int thresh;
+};
+
+/* Entries that have been inserted in a cache are protected by the
+ * cache lock, since they may be shared by threads working on different
+ * namespaces.  An entry not yet inserted is private to its creator.
+ */
+static void entry_lock (struct cache_entry *entry)
+{
+    if (entry->cache)
+        pthread_mutex_lock (&entry->cache->lock);
+}
+
+static void entry_unlock (struct cache_entry *entry)
+{
+    if (entry->cache)
+        pthread_mutex_unlock (&entry->cache->lock);
+}
+
+/* Compute the index key for 'ref' into 'key', returning its length.
+ * Blobrefs are indexed by their raw digest.  Any other string (e.g. an
+ * invalid reference) is indexed by the SHA-256 digest of the string.
+ */
+static int cache_key (const char *ref, uint8_t *key)
+{
+    int len;
+
+    if ((len = blobref_strtohash (ref, key, BLOBREF_MAX_DIGEST_SIZE)) < 0) {
+        SHA256_CTX ctx;
+
+        sha256_init (&ctx);
+        sha256_update (&ctx, (const BYTE *)ref, strlen (ref));
+        sha256_final (&ctx, key);
+        len = SHA256_BLOCK_SIZE;
+    }
+    return len;
+}
+
 struct cache_entry *cache_entry_create (const char *ref)
 {
     struct cache_entry *entry;
@@ -80,12 +127,26 @@ struct cache_entry *cache_entry_create (const char *ref)
 
 bool cache_entry_get_valid (struct cache_entry *entry)
 {
-    return (entry && entry->valid);
+    bool valid = false;
+
+    if (entry) {
+        entry_lock (entry);
+        valid = entry->valid;
+        entry_unlock (entry);
+    }
+    return valid;
 }
 
 bool cache_entry_get_dirty (struct cache_entry *entry)
 {
-    return (entry && entry->valid && entry->dirty);
+    bool dirty = false;
+
+    if (entry) {
+        entry_lock (entry);
+        dirty = entry->valid && entry->dirty;
+        entry_unlock (entry);
+    }
+    return dirty;
 }
 
 int cache_entry_set_dirty (struct cache_entry *entry, bool val)
@@ -93,8 +154,11 @@ int cache_entry_set_dirty (struct cache_entry *entry, bool val)
     if (entry && entry->valid) {
         if ((val && entry->dirty) || (!val && !entry->dirty))
             ; /* no-op */
-        else if (val && !entry->dirty)
+        else if (val && !entry->dirty) {
+            entry_lock (entry);
             entry->dirty = true;
+            entry_unlock (entry);
+        }
         else if (!val && entry->dirty) {
             entry->dirty = false;
             if (entry->waitlist_notdirty) {
@@ -113,10 +177,12 @@ int cache_entry_set_dirty (struct cache_entry *entry, bool val)
 int cache_entry_clear_dirty (struct cache_entry *entry)
 {
     if (entry && entry->valid) {
+        entry_lock (entry);
         if (entry->dirty
             && (!entry->waitlist_notdirty
                 || !wait_queue_length (entry->waitlist_notdirty)))
             entry->dirty = false;
+        entry_unlock (entry);
         return 0;
     }
     return -1;
@@ -137,57 +203,133 @@ int cache_entry_force_clear_dirty (struct cache_entry *entry)
     return -1;
 }
 
+/* Decompress entry data in place, if compressed.
+ */
+static int cache_entry_inflate (struct cache_entry *entry)
+{
+    void *data;
+    int len;
+
+    if (!entry->compressed)
+        return 0;
+    if (blobz_decompress (entry->data, entry->len, &data, &len) < 0)
+        return -1;
+    free (entry->data);
+    entry->data = data;
+    entry->len = len;
+    entry->compressed = false;
+    return 0;
+}
+
 int cache_entry_get_raw (struct cache_entry *entry, const void **data,
                          int *len)
 {
-    if (!entry || !entry->valid)
+    int rc = -1;
+
+    if (!entry)
         return -1;
+    entry_lock (entry);
+    if (!entry->valid || cache_entry_inflate (entry) < 0)
+        goto done;
     if (data)
         (*data) = entry->data;
     if (len)
         (*len) = entry->len;
-    return 0;
+    rc = 0;
+done:
+    entry_unlock (entry);
+    return rc;
 }
 
-int cache_entry_set_raw (struct cache_entry *entry, const void *data, int len)
+static int set_raw (struct cache_entry *entry, const void *data, int len,
+                    bool compressed)
 {
     void *cpy = NULL;
+    bool runqueue = false;
 
     if (!entry || (data && len <= 0) || (!data && len)) {
         errno = EINVAL;
         return -1;
     }
+    entry_lock (entry);
     /* It should be a no-op if the entry is already set.
      * However, as a sanity check, make sure proposed and existing values match.
      */
     if (entry->valid) {
-        if (len != entry->len || memcmp (data, entry->data, len) != 0) {
-            errno = EBADE;
-            return -1;
+        void *udata = NULL;
+        int rc = -1;
+
+        if (cache_entry_inflate (entry) < 0)
+            goto done;
+        if (compressed) {
+            if (blobz_decompress (data, len, &udata, &len) < 0)
+                goto done;
+            data = udata;
         }
-        return 0;
+        if (len != entry->len || memcmp (data, entry->data, len) != 0)
+            errno = EBADE;
+        else
+            rc = 0;
+        free (udata);
+done:
+        entry_unlock (entry);
+        return rc;
     }
     if (len > 0) {
-        if (!(cpy = malloc (len)))
+        if (!(cpy = malloc (len))) {
+            entry_unlock (entry);
             return -1;
+        }
         memcpy (cpy, data, len);
     }
     entry->data = cpy;
     entry->len = len;
+    entry->compressed = compressed;
     entry->valid = true;
+    /* Waiters may only be run on the thread that owns the reactor, so
+     * inside a parallel section they are deferred to cache_parallel_end().
+     */
     if (entry->waitlist_valid) {
-        if (wait_runqueue (entry->waitlist_valid) < 0)
-            goto reset_invalid;
+        if (entry->cache && entry->cache->parallel) {
+            if (zlist_append (entry->cache->deferred, entry) < 0) {
+                errno = ENOMEM;
+                goto reset_invalid;
+            }
+        }
+        else
+            runqueue = true;
+    }
+    entry_unlock (entry);
+    if (runqueue && wait_runqueue (entry->waitlist_valid) < 0) {
+        entry_lock (entry);
+        goto reset_invalid;
     }
     return 0;
 reset_invalid:
     free (entry->data);
     entry->data = NULL;
     entry->len = 0;
+    entry->compressed = false;
     entry->valid = false;
+    entry_unlock (entry);
     return -1;
 }
 
+int cache_entry_set_raw (struct cache_entry *entry, const void *data, int len)
+{
+    return set_raw (entry, data, len, false);
+}
+
+int cache_entry_set_raw_compressed (struct cache_entry *entry,
+                                    const void *data, int len)
+{
+    if (!data) {
+        errno = EINVAL;
+        return -1;
+    }
+    return set_raw (entry, data, len, true);
+}
+
 static void set_wait_errnum (wait_t *w, void *arg)
 {
     int *errnum = arg;
@@ -236,13 +378,23 @@ int cache_entry_set_errnum_on_notdirty (struct cache_entry *entry, int errnum)
 
 const json_t *cache_entry_get_treeobj (struct cache_entry *entry)
 {
-    if (!entry || !entry->valid || !entry->data)
+    const json_t *o = NULL;
+
+    if (!entry)
         return NULL;
+    entry_lock (entry);
+    if (!entry->valid || !entry->data)
+        goto done;
     if (!entry->o) {
+        if (cache_entry_inflate (entry) < 0)
+            goto done;
         if (!(entry->o = treeobj_decodeb (entry->data, entry->len)))
-            return NULL;
+            goto done;
     }
-    return entry->o;
+    o = entry->o;
+done:
+    entry_unlock (entry);
+    return o;
 }
 
 void cache_entry_destroy (void *arg)
@@ -289,42 +441,156 @@ int cache_entry_wait_valid (struct cache_entry *entry, wait_t *wait)
 struct cache_entry *cache_lookup (struct cache *cache, const char *ref,
                                   int current_epoch)
 {
-    struct cache_entry *entry = zhashx_lookup (cache->zhx, ref);
+    uint8_t key[BLOBREF_MAX_DIGEST_SIZE];
+    int len = cache_key (ref, key);
+    struct cache_entry *entry;
+
+    pthread_mutex_lock (&cache->lock);
+    entry = digestmap_lookup (cache->map, key, len);
     if (entry && current_epoch > entry->lastuse_epoch)
         entry->lastuse_epoch = current_epoch;
+    pthread_mutex_unlock (&cache->lock);
     return entry;
 }
 
 int cache_insert (struct cache *cache, struct cache_entry *entry)
 {
+    uint8_t key[BLOBREF_MAX_DIGEST_SIZE];
+    int len;
     int rc;
 
     if (cache && entry) {
-        rc = zhashx_insert (cache->zhx, entry->blobref, entry);
+        len = cache_key (entry->blobref, key);
+        pthread_mutex_lock (&cache->lock);
+        rc = digestmap_insert (cache->map, key, len, entry);
         assert (rc == 0);
+        entry->cache = cache;
+        pthread_mutex_unlock (&cache->lock);
     }
     return 0;
 }
 
+int cache_store (struct cache *cache, const char *ref, const void *data,
+                 int len, int current_epoch, struct cache_entry **entryp)
+{
+    uint8_t key[BLOBREF_MAX_DIGEST_SIZE];
+    int keylen = cache_key (ref, key);
+    struct cache_entry *entry;
+    bool created = false;
+    int rc = -1;
+
+    if (!cache || !entryp || (data && len <= 0) || (!data && len)) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock (&cache->lock);
+    if (!(entry = digestmap_lookup (cache->map, key, keylen))) {
+        if (!(entry = cache_entry_create (ref)))
+            goto done;
+        if (digestmap_insert (cache->map, key, keylen, entry) < 0) {
+            cache_entry_destroy (entry);
+            goto done;
+        }
+        entry->cache = cache;
+        created = true;
+    }
+    if (current_epoch > entry->lastuse_epoch)
+        entry->lastuse_epoch = current_epoch;
+    if (entry->valid) {
+        rc = 0;
+        goto done;
+    }
+    if (len > 0) {
+        if (!(entry->data = malloc (len))) {
+            errno = ENOMEM;
+            goto error;
+        }
+        memcpy (entry->data, data, len);
+    }
+    entry->len = len;
+    entry->valid = true;
+    entry->dirty = true;
+    if (entry->waitlist_valid) {
+        if (!cache->parallel)
+            goto run_waiters;
+        if (zlist_append (cache->deferred, entry) < 0) {
+            errno = ENOMEM;
+            goto error;
+        }
+    }
+    rc = 1;
+done:
+    pthread_mutex_unlock (&cache->lock);
+    if (rc >= 0)
+        *entryp = entry;
+    return rc;
+run_waiters:
+    pthread_mutex_unlock (&cache->lock);
+    if (wait_runqueue (entry->waitlist_valid) < 0) {
+        pthread_mutex_lock (&cache->lock);
+        goto error;
+    }
+    *entryp = entry;
+    return 1;
+error:
+    free (entry->data);
+    entry->data = NULL;
+    entry->len = 0;
+    entry->valid = false;
+    entry->dirty = false;
+    if (created)
+        digestmap_delete (cache->map, key, keylen);
+    pthread_mutex_unlock (&cache->lock);
+    return -1;
+}
+
 int cache_remove_entry (struct cache *cache, const char *ref)
 {
-    struct cache_entry *entry = zhashx_lookup (cache->zhx, ref);
+    uint8_t key[BLOBREF_MAX_DIGEST_SIZE];
+    int len = cache_key (ref, key);
+    struct cache_entry *entry;
+    int rc = 0;
 
+    pthread_mutex_lock (&cache->lock);
+    entry = digestmap_lookup (cache->map, key, len);
     if (entry
         && !entry->dirty
         && (!entry->waitlist_notdirty
             || !wait_queue_length (entry->waitlist_notdirty))
         && (!entry->waitlist_valid
             || !wait_queue_length (entry->waitlist_valid))) {
-        zhashx_delete (cache->zhx, ref);
-        return 1;
+        digestmap_delete (cache->map, key, len);
+        rc = 1;
     }
-    return 0;
+    pthread_mutex_unlock (&cache->lock);
+    return rc;
+}
+
+void cache_parallel_begin (struct cache *cache)
+{
+    pthread_mutex_lock (&cache->lock);
+    cache->parallel = true;
+    pthread_mutex_unlock (&cache->lock);
+}
+
+int cache_parallel_end (struct cache *cache)
+{
+    struct cache_entry *entry;
+    int rc = 0;
+
+    pthread_mutex_lock (&cache->lock);
+    cache->parallel = false;
+    pthread_mutex_unlock (&cache->lock);
+    while ((entry = zlist_pop (cache->deferred))) {
+        if (wait_runqueue (entry->waitlist_valid) < 0)
+            rc = -1;
+    }
+    return rc;
 }
 
 int cache_count_entries (struct cache *cache)
 {
-    return zhashx_size (cache->zhx);
+    return digestmap_size (cache->map);
 }
 
 static int cache_entry_age (struct cache_entry *entry, int current_epoch)
@@ -336,45 +602,38 @@ static int cache_entry_age (struct cache_entry *entry, int current_epoch)
     return current_epoch - entry->lastuse_epoch;
 }
 
-int cache_expire_entries (struct cache *cache, int current_epoch, int thresh)
+static bool cache_entry_expired (void *item, void *arg)
 {
-    zlistx_t *keys;
-    char *ref;
-    struct cache_entry *entry;
-    int count = 0;
+    struct cache_entry *entry = item;
+    struct expire_args *args = arg;
 
-    /* Do not use zhashx_first()/zhashx_next() or FOREACH_ZHASHX, as
-     * zhashx_delete() call below modifies hash */
-    if (!(keys = zhashx_keys (cache->zhx))) {
-        errno = ENOMEM;
-        return -1;
-    }
-    ref = zlistx_first (keys);
-    while (ref) {
-        if ((entry = zhashx_lookup (cache->zhx, ref))
-            && !cache_entry_get_dirty (entry)
+    return (!cache_entry_get_dirty (entry)
             && cache_entry_get_valid (entry)
-            && (thresh == 0
-                || cache_entry_age (entry, current_epoch) > thresh)) {
-                zhashx_delete (cache->zhx, ref);
-                count++;
-        }
-        ref = zlistx_next (keys);
-    }
-    zlistx_destroy (&keys);
-    return count;
+            && (args->thresh == 0
+                || cache_entry_age (entry, args->current_epoch)
+                                                        > args->thresh));
+}
+
+int cache_expire_entries (struct cache *cache, int current_epoch, int thresh)
+{
+    struct expire_args args = {
+        .current_epoch = current_epoch,
+        .thresh = thresh,
+    };
+
+    return digestmap_delete_if (cache->map, cache_entry_expired, &args);
 }
 
 int cache_get_stats (struct cache *cache, tstat_t *ts, int *sizep,
                      int *incompletep, int *dirtyp)
 {
     struct cache_entry *entry;
-    const char *key;
     int size = 0;
     int incomplete = 0;
     int dirty = 0;
 
-    FOREACH_ZHASHX (cache->zhx, key, entry) {
+    for (entry = digestmap_first (cache->map); entry != NULL;
+                                    entry = digestmap_next (cache->map)) {
         if (cache_entry_get_valid (entry)) {
             int obj_size = 0;
 
@@ -399,12 +658,12 @@ int cache_get_stats (struct cache *cache, tstat_t *ts, int *sizep,
 
 int cache_wait_destroy_msg (struct cache *cache, wait_test_msg_f cb, void *arg)
 {
-    const char *key;
     struct cache_entry *entry;
     int n, count = 0;
     int rc = -1;
 
-    FOREACH_ZHASHX (cache->zhx, key, entry) {
+    for (entry = digestmap_first (cache->map); entry != NULL;
+                                    entry = digestmap_next (cache->map)) {
         if (entry->waitlist_valid) {
             if ((n = wait_destroy_msg (entry->waitlist_valid, cb, arg)) < 0)
                 goto done;
@@ -426,13 +685,6 @@ const char *cache_entry_get_blobref (struct cache_entry *entry)
     return entry ? entry->blobref : NULL;
 }
 
-static void cache_entry_destroy_wrapper (void **arg)
-{
-    struct cache_entry **entry = (struct cache_entry **)arg;
-    if (entry)
-        cache_entry_destroy (*entry);
-}
-
 struct cache *cache_create (void)
 {
     struct cache *cache = calloc (1, sizeof (*cache));
@@ -440,22 +692,24 @@ struct cache *cache_create (void)
         errno = ENOMEM;
         return NULL;
     }
-    if (!(cache->zhx = zhashx_new ())) {
+    if (!(cache->map = digestmap_create ())
+        || !(cache->deferred = zlist_new ())) {
+        digestmap_destroy (cache->map);
         free (cache);
         errno = ENOMEM;
         return NULL;
     }
-    /* do not duplicate hash keys, use blobrefs stored in cache entry */
-    zhashx_set_key_destructor (cache->zhx, NULL);
-    zhashx_set_key_duplicator (cache->zhx, NULL);
-    zhashx_set_destructor (cache->zhx, cache_entry_destroy_wrapper);
+    digestmap_set_free_f (cache->map, cache_entry_destroy);
+    pthread_mutex_init (&cache->lock, NULL);
     return cache;
 }
 
 void cache_destroy (struct cache *cache)
 {
     if (cache) {
-        zhashx_destroy (&cache->zhx);
+        digestmap_destroy (cache->map);
+        zlist_destroy (&cache->deferred);
+        pthread_mutex_destroy (&cache->lock);
         free (cache);
     }
 }
@@ -76,12 +76,18 @@ int cache_entry_force_clear_dirty (struct cache_entry *entry);
  * Generally speaking, a cache entry can only be set once.  An attempt
  * to set new data in a cache entry will silently succeed.
  *
+ * cache_entry_set_raw_compressed() sets data in blobz encoding, as
+ * returned by a compressed content load.  It is kept compressed until
+ * first accessed, when it is decompressed in place.
+ *
  * cache_entry_set_raw() & cache_entry_clear_data()
  * return -1 on error, 0 on success
  */
 int cache_entry_get_raw (struct cache_entry *entry, const void **data,
                          int *len);
 int cache_entry_set_raw (struct cache_entry *entry, const void *data, int len);
+int cache_entry_set_raw_compressed (struct cache_entry *entry,
+                                    const void *data, int len);
 
 const json_t *cache_entry_get_treeobj (struct cache_entry *entry);
 
@@ -120,6 +126,16 @@ struct cache_entry *cache_lookup (struct cache *cache,
  */
 int cache_insert (struct cache *cache, struct cache_entry *entry);
 
+/* Look up or create the entry for 'ref' and, unless it is already
+ * valid, set its raw data to a copy of 'data' and mark it dirty, all
+ * under the cache lock so that concurrent stores of the same object
+ * cannot both claim it.  The entry is returned in 'entryp'.
+ * Returns -1 on error, 0 if the entry was already valid, 1 if the
+ * entry is newly dirty and should be flushed to the content store.
+ */
+int cache_store (struct cache *cache, const char *ref, const void *data,
+                 int len, int current_epoch, struct cache_entry **entryp);
+
 /* Remove a cache_entry from the cache.  Will not be removed if dirty
  * or there are any waiters of any sort.
  * Returns 1 on removed, 0 if not
@@ -142,6 +158,20 @@ int cache_expire_entries (struct cache *cache, int current_epoch, int thresh);
 int cache_get_stats (struct cache *cache, tstat_t *ts, int *size,
                      int *incomplete, int *dirty);
 
+/* Bracket a section in which threads other than the reactor thread
+ * call cache_lookup(), cache_store(), cache_remove_entry() and the
+ * cache_entry accessors concurrently.  The cache and its inserted
+ * entries are always protected by a lock, but wait queues are not
+ * thread safe, so waiters made runnable by the section are deferred
+ * and run by cache_parallel_end() on the calling thread.  The calling
+ * thread must not use the cache while the section is active, and
+ * cache_expire_entries(), cache_get_stats() and cache_wait_destroy_msg()
+ * must not be called during it.
+ * cache_parallel_end() returns -1 if any deferred wait queue failed.
+ */
+void cache_parallel_begin (struct cache *cache);
+int cache_parallel_end (struct cache *cache);
+
 /* Destroy wait_t's on the waitqueue_t of any cache entry
  * if they meet match criteria.
  */
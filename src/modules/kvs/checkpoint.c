@@ -0,0 +1,290 @@
+/************************************************************\
+ * Copyright 2018 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <czmq.h>
+#include <jansson.h>
+
+#include "src/common/libkvs/treeobj.h"
+#include "src/common/libutil/blobref.h"
+
+#include "cache.h"
+#include "checkpoint.h"
+
+/* Image format, all integers 32 bits in network byte order:
+ *   magic version count
+ *   count * (len data[len])
+ */
+#define IMAGE_MAGIC     0x4b565349  /* "KVSI" */
+#define IMAGE_VERSION   1
+#define IMAGE_HDRSIZE   ((int)(3 * sizeof (uint32_t)))
+
+#define CHECKPOINT_VERSION 1
+
+char *checkpoint_encode (const char *rootref, int seq, const char *imageref)
+{
+    json_t *o;
+    char *s;
+
+    if (!rootref || seq < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(o = json_pack ("{s:i s:s s:i s:s}",
+                         "version", CHECKPOINT_VERSION,
+                         "rootref", rootref,
+                         "sequence", seq,
+                         "imageref", imageref ? imageref : ""))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (!(s = json_dumps (o, JSON_COMPACT)))
+        errno = ENOMEM;
+    json_decref (o);
+    return s;
+}
+
+int checkpoint_decode (const char *s, char *rootref, int rootref_len,
+                       int *seq, char *imageref, int imageref_len)
+{
+    json_t *o;
+    int version;
+    const char *rref;
+    const char *iref = "";
+    int rc = -1;
+
+    if (!s || !rootref || !seq || !imageref) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(o = json_loads (s, 0, NULL))
+            || json_unpack (o, "{s:i s:s s:i s?s}",
+                            "version", &version,
+                            "rootref", &rref,
+                            "sequence", seq,
+                            "imageref", &iref) < 0
+            || version != CHECKPOINT_VERSION
+            || *seq < 0) {
+        errno = EPROTO;
+        goto done;
+    }
+    if (strlen (rref) >= rootref_len || strlen (iref) >= imageref_len) {
+        errno = EINVAL;
+        goto done;
+    }
+    strcpy (rootref, rref);
+    strcpy (imageref, iref);
+    rc = 0;
+done:
+    json_decref (o);
+    return rc;
+}
+
+static void put_uint32 (uint8_t *p, uint32_t val)
+{
+    val = htonl (val);
+    memcpy (p, &val, sizeof (val));
+}
+
+static uint32_t get_uint32 (const uint8_t *p)
+{
+    uint32_t val;
+    memcpy (&val, p, sizeof (val));
+    return ntohl (val);
+}
+
+/* Queue the blobrefs of the directories that 'dir' refers to.
+ */
+static int queue_subdirs (const json_t *dir, zlist_t *queue, zhash_t *seen)
+{
+    const char *ref;
+    const char *name;
+    json_t *entry;
+    json_t *data;
+    int i;
+
+    if (treeobj_is_hdir (dir)) {
+        for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+            json_t *shard = treeobj_hdir_get_shard ((json_t *)dir, i);
+            if (!shard || !treeobj_is_dirref (shard))
+                continue;
+            if (!(ref = treeobj_get_blobref (shard, 0)))
+                return -1;
+            if (zhash_insert (seen, ref, (void *)ref) == 0
+                                    && zlist_append (queue, (void *)ref) < 0)
+                goto nomem;
+        }
+        return 0;
+    }
+    if (!(data = treeobj_get_data ((json_t *)dir)))
+        return -1;
+    json_object_foreach (data, name, entry) {
+        if (!treeobj_is_dirref (entry))
+            continue;
+        if (!(ref = treeobj_get_blobref (entry, 0)))
+            return -1;
+        if (zhash_insert (seen, ref, (void *)ref) == 0
+                                && zlist_append (queue, (void *)ref) < 0)
+            goto nomem;
+    }
+    return 0;
+nomem:
+    errno = ENOMEM;
+    return -1;
+}
+
+int checkpoint_image_pack (struct cache *cache, const char *rootref,
+                           int maxsize, void **bufp, int *lenp)
+{
+    zlist_t *queue = NULL;
+    zhash_t *seen = NULL;
+    uint8_t *buf = NULL;
+    int bufsize, len;
+    const char *ref;
+    int count = 0;
+    int saved_errno;
+
+    if (!cache || !rootref || maxsize < IMAGE_HDRSIZE || !bufp || !lenp) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(queue = zlist_new ()) || !(seen = zhash_new ())) {
+        errno = ENOMEM;
+        goto error;
+    }
+    bufsize = IMAGE_HDRSIZE + 4096;
+    if (bufsize > maxsize)
+        bufsize = maxsize;
+    if (!(buf = malloc (bufsize)))
+        goto error;
+    len = IMAGE_HDRSIZE;
+
+    /* Queued blobrefs are borrowed from treeobjs held by the cache,
+     * which cannot be expired during this synchronous walk.
+     */
+    if (zhash_insert (seen, rootref, (void *)rootref) < 0
+                        || zlist_append (queue, (void *)rootref) < 0) {
+        errno = ENOMEM;
+        goto error;
+    }
+    while ((ref = zlist_pop (queue))) {
+        struct cache_entry *entry;
+        const json_t *dir;
+        const void *data;
+        int size;
+
+        if (!(entry = cache_lookup (cache, ref, 0))
+                || !cache_entry_get_valid (entry)
+                || cache_entry_get_raw (entry, &data, &size) < 0
+                || !(dir = cache_entry_get_treeobj (entry))
+                || (!treeobj_is_dir (dir) && !treeobj_is_hdir (dir)))
+            continue;
+        if (len + sizeof (uint32_t) + size > maxsize)
+            break;
+        if (len + sizeof (uint32_t) + size > bufsize) {
+            int newsize = bufsize;
+            void *newbuf;
+            while (len + sizeof (uint32_t) + size > newsize)
+                newsize *= 2;
+            if (newsize > maxsize)
+                newsize = maxsize;
+            if (!(newbuf = realloc (buf, newsize)))
+                goto error;
+            buf = newbuf;
+            bufsize = newsize;
+        }
+        put_uint32 (buf + len, size);
+        memcpy (buf + len + sizeof (uint32_t), data, size);
+        len += sizeof (uint32_t) + size;
+        count++;
+        if (queue_subdirs (dir, queue, seen) < 0)
+            goto error;
+    }
+    put_uint32 (buf, IMAGE_MAGIC);
+    put_uint32 (buf + sizeof (uint32_t), IMAGE_VERSION);
+    put_uint32 (buf + 2 * sizeof (uint32_t), count);
+    zlist_destroy (&queue);
+    zhash_destroy (&seen);
+    *bufp = buf;
+    *lenp = len;
+    return count;
+error:
+    saved_errno = errno;
+    zlist_destroy (&queue);
+    zhash_destroy (&seen);
+    free (buf);
+    errno = saved_errno;
+    return -1;
+}
+
+int checkpoint_image_unpack (struct cache *cache, const char *hash_name,
+                             const void *buf, int len, int current_epoch)
+{
+    const uint8_t *p = buf;
+    uint32_t count, i;
+    int inserted = 0;
+
+    if (!cache || !hash_name || (!buf && len > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (len < IMAGE_HDRSIZE
+            || get_uint32 (p) != IMAGE_MAGIC
+            || get_uint32 (p + sizeof (uint32_t)) != IMAGE_VERSION)
+        goto eproto;
+    count = get_uint32 (p + 2 * sizeof (uint32_t));
+    p += IMAGE_HDRSIZE;
+    len -= IMAGE_HDRSIZE;
+    for (i = 0; i < count; i++) {
+        char ref[BLOBREF_MAX_STRING_SIZE];
+        struct cache_entry *entry;
+        uint32_t size;
+
+        if (len < sizeof (uint32_t))
+            goto eproto;
+        size = get_uint32 (p);
+        p += sizeof (uint32_t);
+        len -= sizeof (uint32_t);
+        if (size == 0 || size > len)
+            goto eproto;
+        if (blobref_hash (hash_name, (uint8_t *)p, size,
+                          ref, sizeof (ref)) < 0)
+            return -1;
+        if (!cache_lookup (cache, ref, current_epoch)) {
+            if (!(entry = cache_entry_create (ref)))
+                return -1;
+            if (cache_entry_set_raw (entry, p, size) < 0
+                    || cache_insert (cache, entry) < 0) {
+                cache_entry_destroy (entry);
+                return -1;
+            }
+            inserted++;
+        }
+        p += size;
+        len -= size;
+    }
+    if (len != 0)
+        goto eproto;
+    return inserted;
+eproto:
+    errno = EPROTO;
+    return -1;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
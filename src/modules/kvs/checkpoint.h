@@ -0,0 +1,57 @@
+/************************************************************\
+ * Copyright 2018 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _FLUX_KVS_CHECKPOINT_H
+#define _FLUX_KVS_CHECKPOINT_H
+
+#include "cache.h"
+
+/* A checkpoint records the primary namespace (rootref, seq) so that a
+ * restarted KVS can resume from it rather than from an empty root.  It
+ * is kept by the content backing store under a fixed key, and refers
+ * to an optional image blob of directories that were hot when it was
+ * taken, which is used to prime the cache on restart.
+ */
+
+/* Encode/decode a checkpoint value.
+ * checkpoint_encode() returns a string that the caller must free,
+ * or NULL on error.  'imageref' may be NULL if there is no image.
+ * checkpoint_decode() copies the refs into the caller's buffers and
+ * sets 'imageref' to an empty string if there is no image.
+ * Returns -1 with errno = EINVAL or EPROTO on error, 0 on success.
+ */
+char *checkpoint_encode (const char *rootref, int seq, const char *imageref);
+int checkpoint_decode (const char *s, char *rootref, int rootref_len,
+                       int *seq, char *imageref, int imageref_len);
+
+/* Pack the raw data of directories reachable from 'rootref' into an
+ * image, breadth first, following only directories that are valid in
+ * 'cache' (nothing is loaded), stopping before the image exceeds
+ * 'maxsize' bytes.  Entry last-use times are not updated.
+ * Returns the number of directories packed, or -1 on error.
+ * On success, caller must free 'buf'.
+ */
+int checkpoint_image_pack (struct cache *cache, const char *rootref,
+                           int maxsize, void **buf, int *len);
+
+/* Insert the directories in image 'buf' into 'cache', skipping those
+ * already present.  Each blobref is recomputed with 'hash_name', so a
+ * damaged image cannot poison the cache.
+ * Returns the number of entries inserted, or -1 with errno = EPROTO
+ * if the image is malformed.
+ */
+int checkpoint_image_unpack (struct cache *cache, const char *hash_name,
+                             const void *buf, int len, int current_epoch);
+
+#endif /* !_FLUX_KVS_CHECKPOINT_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
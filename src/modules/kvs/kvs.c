@@ -26,6 +26,7 @@
 
 #include "src/common/libutil/blobref.h"
 #include "src/common/libutil/monotime.h"
+#include "src/common/libutil/histogram.h"
 #include "src/common/libutil/tstat.h"
 #include "src/common/libkvs/treeobj.h"
 #include "src/common/libkvs/kvs_txn_private.h"
@@ -38,6 +39,8 @@
 #include "treq.h"
 #include "kvstxn.h"
 #include "kvsroot.h"
+#include "workpool.h"
+#include "checkpoint.h"
 
 /* Expire cache_entry after 'max_lastuse_age' heartbeats.
  */
@@ -54,6 +57,21 @@ const int max_namespace_age = 1000;
  */
 const bool event_includes_rootdir = true;
 
+/* Maximum number of blobs in one content.load-batch or content.store-batch
+ * request.
+ */
+const int content_batch_max = 256;
+
+/* Checkpoint the primary namespace root every 'checkpoint_period'
+ * heartbeats (if it has changed) and at module unload, along with up to
+ * 'checkpoint_image_size' bytes of cached directories to prime the
+ * cache of the next instance.  The checkpoint is kept by the content
+ * backing store under 'checkpoint_key'.
+ */
+const int default_checkpoint_period = 15;
+const int default_checkpoint_image_size = 1048576;
+const char *checkpoint_key = "kvs-primary";
+
 typedef struct {
     struct cache *cache;    /* blobref => cache_entry */
     kvsroot_mgr_t *krm;
@@ -68,6 +86,31 @@ typedef struct {
     bool events_init;            /* flag */
     const char *hash_name;
     unsigned int seq;           /* for commit transactions */
+    int content_batch;          /* use batched content load/store RPCs */
+    int content_compress;       /* move batched blobs compressed */
+    bool treeobj_binary;        /* store treeobjs in binary encoding */
+    zlist_t *load_batch;        /* blobrefs awaiting content.load-batch */
+    zlist_t *store_batch;       /* blobrefs awaiting content.store-batch */
+    flux_watcher_t *content_prep_w;
+    int commit_workers;         /* threads for parallel commits (0 = off) */
+    struct workpool *commit_pool;
+    int parallel_batches;       /* for kvs.stats.get, etc. */
+    int parallel_txns;
+    double merge_delay;         /* max merge window, seconds (0 = off) */
+    int merge_batch;            /* max merge window target batch size */
+    flux_watcher_t *merge_timer_w;
+    histogram_t merge_size;     /* for kvs.stats.get, etc. */
+    histogram_t commit_latency; /* usec */
+    int checkpoint_period;      /* heartbeats (0 = off) */
+    int checkpoint_image_size;  /* bytes */
+    int checkpoint_epoch;       /* epoch of last checkpoint attempt */
+    int checkpoint_seq;         /* root seq of last checkpoint (-1 = none) */
+    flux_future_t *checkpoint_f;
+    int checkpoint_pending_seq;
+    char checkpoint_rootref[BLOBREF_MAX_STRING_SIZE];
+    char checkpoint_imageref[BLOBREF_MAX_STRING_SIZE];
+    int checkpoints;            /* for kvs.stats.get, etc. */
+    int checkpoint_primed;
 } kvs_ctx_t;
 
 struct kvs_cb_data {
@@ -76,15 +119,58 @@ struct kvs_cb_data {
     wait_t *wait;
     int errnum;
     bool ready;
+    double delay;
     char *sender;
+    zlist_t *ready_list;
 };
 
 static void transaction_prep_cb (flux_reactor_t *r, flux_watcher_t *w,
                                  int revents, void *arg);
 static void transaction_check_cb (flux_reactor_t *r, flux_watcher_t *w,
                                   int revents, void *arg);
+static void merge_timer_cb (flux_reactor_t *r, flux_watcher_t *w,
+                            int revents, void *arg);
+static void content_prep_cb (flux_reactor_t *r, flux_watcher_t *w,
+                             int revents, void *arg);
 static void start_root_remove (kvs_ctx_t *ctx, const char *namespace);
 
+/* Encode treeobj 'o' for the content store, in the encoding selected
+ * by the kvs.treeobj-encoding broker attribute.  Caller must free 'data'.
+ */
+static int encode_treeobj (kvs_ctx_t *ctx, const json_t *o,
+                           void **data, int *len)
+{
+    char *s;
+
+    if (ctx->treeobj_binary)
+        return treeobj_encode_binary (o, data, len);
+    if (!(s = treeobj_encode (o)))
+        return -1;
+    *data = s;
+    *len = strlen (s);
+    return 0;
+}
+
+static struct kvsroot *create_root (kvs_ctx_t *ctx, const char *namespace,
+                                    uint32_t owner, int flags)
+{
+    struct kvsroot *root;
+
+    if (!(root = kvsroot_mgr_create_root (ctx->krm,
+                                          ctx->cache,
+                                          ctx->hash_name,
+                                          namespace,
+                                          owner,
+                                          flags)))
+        return NULL;
+    kvstxn_mgr_set_binary_treeobj (root->ktm, ctx->treeobj_binary);
+    kvstxn_mgr_set_threaded (root->ktm, ctx->commit_pool != NULL);
+    if (ctx->transaction_merge)
+        kvstxn_mgr_set_merge_window (root->ktm, ctx->merge_delay,
+                                     ctx->merge_batch);
+    return root;
+}
+
 /*
  * kvs_ctx_t functions
  */
@@ -92,11 +178,27 @@ static void freectx (void *arg)
 {
     kvs_ctx_t *ctx = arg;
     if (ctx) {
+        workpool_destroy (ctx->commit_pool);
+        flux_future_destroy (ctx->checkpoint_f);
         cache_destroy (ctx->cache);
         kvsroot_mgr_destroy (ctx->krm);
         flux_watcher_destroy (ctx->prep_w);
         flux_watcher_destroy (ctx->check_w);
         flux_watcher_destroy (ctx->idle_w);
+        flux_watcher_destroy (ctx->merge_timer_w);
+        flux_watcher_destroy (ctx->content_prep_w);
+        if (ctx->load_batch) {
+            char *ref;
+            while ((ref = zlist_pop (ctx->load_batch)))
+                free (ref);
+            zlist_destroy (&ctx->load_batch);
+        }
+        if (ctx->store_batch) {
+            char *ref;
+            while ((ref = zlist_pop (ctx->store_batch)))
+                free (ref);
+            zlist_destroy (&ctx->store_batch);
+        }
         free (ctx);
     }
 }
@@ -105,6 +207,7 @@ static kvs_ctx_t *getctx (flux_t *h)
 {
     kvs_ctx_t *ctx = (kvs_ctx_t *)flux_aux_get (h, "kvssrv");
     flux_reactor_t *r;
+    const char *encoding;
     int saved_errno;
 
     if (!ctx) {
@@ -121,6 +224,16 @@ static kvs_ctx_t *getctx (flux_t *h)
             flux_log_error (h, "content.hash");
             goto error;
         }
+        if ((encoding = flux_attr_get (h, "kvs.treeobj-encoding"))) {
+            if (!strcmp (encoding, "binary"))
+                ctx->treeobj_binary = true;
+            else if (strcmp (encoding, "json") != 0) {
+                saved_errno = EINVAL;
+                flux_log (h, LOG_ERR, "kvs.treeobj-encoding: unknown "
+                          "encoding '%s'", encoding);
+                goto error;
+            }
+        }
         ctx->cache = cache_create ();
         if (!ctx->cache) {
             saved_errno = ENOMEM;
@@ -151,10 +264,33 @@ static kvs_ctx_t *getctx (flux_t *h)
                 saved_errno = errno;
                 goto error;
             }
+            ctx->merge_timer_w = flux_timer_watcher_create (r, 0., 0.,
+                                                            merge_timer_cb,
+                                                            ctx);
+            if (!ctx->merge_timer_w) {
+                saved_errno = errno;
+                goto error;
+            }
             flux_watcher_start (ctx->prep_w);
             flux_watcher_start (ctx->check_w);
         }
+        if (!(ctx->load_batch = zlist_new ())
+                            || !(ctx->store_batch = zlist_new ())) {
+            saved_errno = ENOMEM;
+            goto error;
+        }
+        ctx->content_prep_w = flux_prepare_watcher_create (r, content_prep_cb,
+                                                           ctx);
+        if (!ctx->content_prep_w) {
+            saved_errno = errno;
+            goto error;
+        }
         ctx->transaction_merge = 1;
+        ctx->merge_batch = 64;
+        ctx->content_batch = 1;
+        ctx->checkpoint_period = default_checkpoint_period;
+        ctx->checkpoint_image_size = default_checkpoint_image_size;
+        ctx->checkpoint_seq = -1;
         if (flux_aux_set (h, "kvssrv", ctx, freectx) < 0) {
             saved_errno = errno;
             goto error;
@@ -364,12 +500,7 @@ static void getroot_completion (flux_future_t *f, void *arg)
      * response.  Not relevant if namespace in process of being removed. */
     if (!(root = kvsroot_mgr_lookup_root (ctx->krm, namespace))) {
 
-        if (!(root = kvsroot_mgr_create_root (ctx->krm,
-                                              ctx->cache,
-                                              ctx->hash_name,
-                                              namespace,
-                                              owner,
-                                              flags))) {
+        if (!(root = create_root (ctx, namespace, owner, flags))) {
             flux_log_error (ctx->h, "%s: kvsroot_mgr_create_root", __FUNCTION__);
             goto error;
         }
@@ -555,16 +686,16 @@ static void content_load_cache_entry_error (kvs_ctx_t *ctx,
         flux_log (ctx->h, LOG_ERR, "%s: cache_remove_entry", __FUNCTION__);
 }
 
-static void content_load_completion (flux_future_t *f, void *arg)
+/* Complete a content load of 'blobref'.  If 'errnum' is nonzero the
+ * load failed, otherwise 'data' is the loaded blob, in blobz encoding
+ * if 'compressed' is true.
+ */
+static void content_load_complete (kvs_ctx_t *ctx, const char *blobref,
+                                   int errnum, const void *data, int size,
+                                   bool compressed)
 {
-    kvs_ctx_t *ctx = arg;
-    const void *data;
-    int size;
-    const char *blobref;
     struct cache_entry *entry;
 
-    blobref = flux_future_aux_get (f, "ref");
-
     /* should be impossible for lookup to fail, cache entry created
      * earlier, and cache_expire_entries() could not have removed it
      * b/c it is not yet valid.  But check and log incase there is
@@ -572,30 +703,142 @@ static void content_load_completion (flux_future_t *f, void *arg)
      */
     if (!(entry = cache_lookup (ctx->cache, blobref, ctx->epoch))) {
         flux_log (ctx->h, LOG_ERR, "%s: cache_lookup", __FUNCTION__);
-        goto done;
+        return;
     }
 
-    if (flux_content_load_get (f, &data, &size) < 0) {
-        flux_log_error (ctx->h, "%s: flux_content_load_get", __FUNCTION__);
-        content_load_cache_entry_error (ctx, entry, errno, blobref);
-        goto done;
+    if (errnum != 0) {
+        errno = errnum;
+        flux_log_error (ctx->h, "%s: content load", __FUNCTION__);
+        content_load_cache_entry_error (ctx, entry, errnum, blobref);
+        return;
     }
 
     /* If cache_entry_set_raw() fails, it's a pretty terrible error
      * case, where we've loaded an object from the content store, but
      * can't put it in the cache.
      */
+    if (compressed) {
+        if (cache_entry_set_raw_compressed (entry, data, size) < 0) {
+            flux_log_error (ctx->h, "%s: cache_entry_set_raw_compressed",
+                            __FUNCTION__);
+            content_load_cache_entry_error (ctx, entry, errno, blobref);
+        }
+        return;
+    }
     if (cache_entry_set_raw (entry, data, size) < 0) {
         flux_log_error (ctx->h, "%s: cache_entry_set_raw", __FUNCTION__);
         content_load_cache_entry_error (ctx, entry, errno, blobref);
-        goto done;
+        return;
     }
+}
 
-done:
+static void content_load_completion (flux_future_t *f, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+    const void *data = NULL;
+    int size = 0;
+    int errnum = 0;
+
+    if (flux_content_load_get (f, &data, &size) < 0)
+        errnum = errno;
+    content_load_complete (ctx, flux_future_aux_get (f, "ref"),
+                           errnum, data, size, false);
+    flux_future_destroy (f);
+}
+
+/* Blobrefs covered by a content.load-batch request, in request order.
+ */
+struct load_batch {
+    int count;
+    char *refs[];
+};
+
+static void load_batch_destroy (struct load_batch *lb)
+{
+    if (lb) {
+        int i;
+        for (i = 0; i < lb->count; i++)
+            free (lb->refs[i]);
+        free (lb);
+    }
+}
+
+static void content_load_batch_completion (flux_future_t *f, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+    struct load_batch *lb = flux_future_aux_get (f, "refs");
+    const void *data;
+    int size;
+    int flags;
+    int i;
+
+    for (i = 0; i < lb->count; i++) {
+        data = NULL;
+        size = 0;
+        if (flux_content_load_batch_get_encoded (f, i, &data, &size,
+                                                 &flags) < 0)
+            content_load_complete (ctx, lb->refs[i], errno, NULL, 0, false);
+        else
+            content_load_complete (ctx, lb->refs[i], 0, data, size,
+                                   (flags & CONTENT_FLAG_COMPRESS));
+    }
+    flux_future_destroy (f);
+}
+
+/* Send up to content_batch_max queued loads in one content.load-batch
+ * request.  On failure, the queued loads are failed.
+ */
+static void content_load_batch_send (kvs_ctx_t *ctx)
+{
+    struct load_batch *lb;
+    flux_future_t *f = NULL;
+    int count = zlist_size (ctx->load_batch);
+    bool lb_owned = true;
+    char *ref;
+    int errnum;
+    int i;
+
+    if (count > content_batch_max)
+        count = content_batch_max;
+    if (!(lb = calloc (1, sizeof (*lb) + count * sizeof (lb->refs[0])))) {
+        errnum = ENOMEM;
+        while ((ref = zlist_pop (ctx->load_batch))) {
+            content_load_complete (ctx, ref, errnum, NULL, 0, false);
+            free (ref);
+        }
+        return;
+    }
+    while (lb->count < count && (ref = zlist_pop (ctx->load_batch)))
+        lb->refs[lb->count++] = ref;
+    if (!(f = flux_content_load_batch (ctx->h, (const char **)lb->refs,
+                                       lb->count, ctx->content_compress
+                                       ? CONTENT_FLAG_COMPRESS : 0))) {
+        flux_log_error (ctx->h, "%s: flux_content_load_batch", __FUNCTION__);
+        goto error;
+    }
+    if (flux_future_aux_set (f, "refs", lb,
+                             (flux_free_f)load_batch_destroy) < 0) {
+        flux_log_error (ctx->h, "%s: flux_future_aux_set", __FUNCTION__);
+        goto error;
+    }
+    lb_owned = false;
+    if (flux_future_then (f, -1., content_load_batch_completion, ctx) < 0) {
+        flux_log_error (ctx->h, "%s: flux_future_then", __FUNCTION__);
+        goto error;
+    }
+    return;
+error:
+    errnum = errno;
+    for (i = 0; i < lb->count; i++)
+        content_load_complete (ctx, lb->refs[i], errnum, NULL, 0, false);
+    if (lb_owned)
+        load_batch_destroy (lb);
     flux_future_destroy (f);
 }
 
 /* Send content load request and setup contination to handle response.
+ * If batching is enabled, the blobref is queued and sent in a
+ * content.load-batch request from content_prep_cb().
  */
 static int content_load_request_send (kvs_ctx_t *ctx, const char *ref)
 {
@@ -603,14 +846,22 @@ static int content_load_request_send (kvs_ctx_t *ctx, const char *ref)
     char *refcpy;
     int saved_errno;
 
+    if (ctx->content_batch) {
+        if (!(refcpy = strdup (ref)))
+            goto nomem;
+        if (zlist_append (ctx->load_batch, refcpy) < 0) {
+            free (refcpy);
+            goto nomem;
+        }
+        flux_watcher_start (ctx->content_prep_w);
+        return 0;
+    }
     if (!(f = flux_content_load (ctx->h, ref, 0))) {
         flux_log_error (ctx->h, "%s: flux_content_load", __FUNCTION__);
         goto error;
     }
-    if (!(refcpy = strdup (ref))) {
-        errno = ENOMEM;
-        goto error;
-    }
+    if (!(refcpy = strdup (ref)))
+        goto nomem;
     if (flux_future_aux_set (f, "ref", refcpy, free) < 0) {
         flux_log_error (ctx->h, "%s: flux_future_aux_set", __FUNCTION__);
         free (refcpy);
@@ -621,6 +872,8 @@ static int content_load_request_send (kvs_ctx_t *ctx, const char *ref)
         goto error;
     }
     return 0;
+nomem:
+    errno = ENOMEM;
 error:
     saved_errno = errno;
     flux_future_destroy (f);
@@ -696,18 +949,19 @@ static int load (kvs_ctx_t *ctx, const char *ref, wait_t *wait, bool *stall)
  * store/write
  */
 
-static void content_store_completion (flux_future_t *f, void *arg)
+/* Complete a content store of cache entry 'cache_blobref'.  If 'errnum'
+ * is nonzero the store failed, otherwise 'blobref' is the blobref
+ * returned by the content store.
+ */
+static void content_store_complete (kvs_ctx_t *ctx, const char *cache_blobref,
+                                    int errnum, const char *blobref)
 {
-    kvs_ctx_t *ctx = arg;
     struct cache_entry *entry;
-    const char *cache_blobref, *blobref;
     int ret;
 
-    cache_blobref = flux_future_aux_get (f, "cache_blobref");
-    assert (cache_blobref);
-
-    if (flux_content_store_get (f, &blobref) < 0) {
-        flux_log_error (ctx->h, "%s: flux_content_store_get", __FUNCTION__);
+    if (errnum != 0) {
+        errno = errnum;
+        flux_log_error (ctx->h, "%s: content store", __FUNCTION__);
         goto error;
     }
 
@@ -745,13 +999,9 @@ static void content_store_completion (flux_future_t *f, void *arg)
                         __FUNCTION__);
         goto error;
     }
-
-    flux_future_destroy (f);
     return;
 
 error:
-    flux_future_destroy (f);
-
     /* failure on store, inform all waiters, must destroy entry
      * afterwards, as future loads/stores may believe content is ok.
      * cache_remove_entry() will not work if a waiter is still there.
@@ -787,12 +1037,183 @@ error:
         flux_log (ctx->h, LOG_ERR, "%s: cache_remove_entry", __FUNCTION__);
 }
 
-static int content_store_request_send (kvs_ctx_t *ctx, const char *blobref,
-                                       const void *data, int len)
+static void content_store_completion (flux_future_t *f, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+    const char *cache_blobref, *blobref = NULL;
+    int errnum = 0;
+
+    cache_blobref = flux_future_aux_get (f, "cache_blobref");
+    assert (cache_blobref);
+
+    if (flux_content_store_get (f, &blobref) < 0)
+        errnum = errno;
+    content_store_complete (ctx, cache_blobref, errnum, blobref);
+    flux_future_destroy (f);
+}
+
+/* Blobrefs of dirty cache entries covered by a content.store-batch
+ * request, in request order.
+ */
+struct store_batch {
+    int count;
+    char *refs[];
+};
+
+static void store_batch_destroy (struct store_batch *sb)
+{
+    if (sb) {
+        int i;
+        for (i = 0; i < sb->count; i++)
+            free (sb->refs[i]);
+        free (sb);
+    }
+}
+
+static void content_store_batch_completion (flux_future_t *f, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+    struct store_batch *sb = flux_future_aux_get (f, "cache_blobrefs");
+    const char *blobref;
+    int i;
+
+    for (i = 0; i < sb->count; i++) {
+        if (flux_content_store_batch_get (f, i, &blobref) < 0)
+            content_store_complete (ctx, sb->refs[i], errno, NULL);
+        else
+            content_store_complete (ctx, sb->refs[i], 0, blobref);
+    }
+    flux_future_destroy (f);
+}
+
+/* Send up to content_batch_max queued dirty cache entries in one
+ * content.store-batch request.  Entries are looked up again here since
+ * a transaction error may have removed them after they were queued.
+ * On failure, the queued stores are failed.
+ */
+static void content_store_batch_send (kvs_ctx_t *ctx)
+{
+    struct store_batch *sb = NULL;
+    const void **bufs = NULL;
+    int *lens = NULL;
+    flux_future_t *f = NULL;
+    int count = zlist_size (ctx->store_batch);
+    struct cache_entry *entry;
+    bool sb_owned = true;
+    char *ref;
+    int errnum;
+    int i;
+
+    if (count > content_batch_max)
+        count = content_batch_max;
+    if (!(sb = calloc (1, sizeof (*sb) + count * sizeof (sb->refs[0])))
+            || !(bufs = calloc (count, sizeof (bufs[0])))
+            || !(lens = calloc (count, sizeof (lens[0])))) {
+        errnum = ENOMEM;
+        while ((ref = zlist_pop (ctx->store_batch))) {
+            content_store_complete (ctx, ref, errnum, NULL);
+            free (ref);
+        }
+        goto done;
+    }
+    while (count-- > 0 && (ref = zlist_pop (ctx->store_batch))) {
+        if (!(entry = cache_lookup (ctx->cache, ref, ctx->epoch))
+                                    || !cache_entry_get_dirty (entry)) {
+            free (ref);
+            continue;
+        }
+        if (cache_entry_get_raw (entry, &bufs[sb->count],
+                                 &lens[sb->count]) < 0) {
+            content_store_complete (ctx, ref, errno, NULL);
+            free (ref);
+            continue;
+        }
+        sb->refs[sb->count++] = ref;
+    }
+    if (sb->count == 0)
+        goto done;
+    if (!(f = flux_content_store_batch (ctx->h, bufs, lens, sb->count,
+                                        ctx->content_compress
+                                        ? CONTENT_FLAG_COMPRESS : 0))) {
+        flux_log_error (ctx->h, "%s: flux_content_store_batch", __FUNCTION__);
+        goto error;
+    }
+    if (flux_future_aux_set (f, "cache_blobrefs", sb,
+                             (flux_free_f)store_batch_destroy) < 0) {
+        flux_log_error (ctx->h, "%s: flux_future_aux_set", __FUNCTION__);
+        goto error;
+    }
+    sb_owned = false;
+    if (flux_future_then (f, -1., content_store_batch_completion, ctx) < 0) {
+        flux_log_error (ctx->h, "%s: flux_future_then", __FUNCTION__);
+        goto error;
+    }
+    free (bufs);
+    free (lens);
+    return;
+error:
+    errnum = errno;
+    for (i = 0; i < sb->count; i++)
+        content_store_complete (ctx, sb->refs[i], errnum, NULL);
+    flux_future_destroy (f);
+done:
+    if (sb_owned)
+        store_batch_destroy (sb);
+    free (bufs);
+    free (lens);
+}
+
+/* Send queued content load and store requests in batches just before the
+ * reactor blocks, so that all the refs needed by a lookup or transaction
+ * (and by any others processed in the same loop iteration) travel in as
+ * few messages as possible.
+ */
+static void content_prep_cb (flux_reactor_t *r, flux_watcher_t *w,
+                             int revents, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+
+    while (zlist_size (ctx->load_batch) > 0)
+        content_load_batch_send (ctx);
+    while (zlist_size (ctx->store_batch) > 0)
+        content_store_batch_send (ctx);
+    flux_watcher_stop (w);
+}
+
+/* Send content store request for dirty cache entry.  If batching is
+ * enabled, the entry is queued and sent in a content.store-batch request
+ * from content_prep_cb().
+ */
+static int content_store_request_send (kvs_ctx_t *ctx,
+                                       struct cache_entry *entry)
 {
     flux_future_t *f;
+    const char *blobref;
+    const void *data;
+    int len = 0;
     int saved_errno, rc = -1;
 
+    /* must be true, otherwise we didn't insert entry in cache */
+    blobref = cache_entry_get_blobref (entry);
+    assert (blobref);
+
+    if (ctx->content_batch) {
+        char *refcpy;
+        if (!(refcpy = strdup (blobref))) {
+            errno = ENOMEM;
+            goto error;
+        }
+        if (zlist_append (ctx->store_batch, refcpy) < 0) {
+            free (refcpy);
+            errno = ENOMEM;
+            goto error;
+        }
+        flux_watcher_start (ctx->content_prep_w);
+        return 0;
+    }
+    if (cache_entry_get_raw (entry, &data, &len) < 0)
+        goto error;
+
     if (!(f = flux_content_store (ctx->h, data, len, 0)))
         goto error;
     if (flux_future_aux_set (f, "cache_blobref", (void *)blobref, NULL) < 0) {
@@ -834,27 +1255,10 @@ static int kvstxn_load_cb (kvstxn_t *kt, const char *ref, void *data)
 static int kvstxn_cache_cb (kvstxn_t *kt, struct cache_entry *entry, void *data)
 {
     struct kvs_cb_data *cbd = data;
-    const char *blobref;
-    const void *storedata;
-    int storedatalen = 0;
 
     assert (cache_entry_get_dirty (entry));
 
-    if (cache_entry_get_raw (entry, &storedata, &storedatalen) < 0) {
-        flux_log_error (cbd->ctx->h, "%s: cache_entry_get_raw",
-                        __FUNCTION__);
-        kvstxn_cleanup_dirty_cache_entry (kt, entry);
-        return -1;
-    }
-
-    /* must be true, otherwise we didn't insert entry in cache */
-    blobref = cache_entry_get_blobref (entry);
-    assert (blobref);
-
-    if (content_store_request_send (cbd->ctx,
-                                    blobref,
-                                    storedata,
-                                    storedatalen) < 0) {
+    if (content_store_request_send (cbd->ctx, entry) < 0) {
         cbd->errnum = errno;
         flux_log_error (cbd->ctx->h, "%s: content_store_request_send",
                         __FUNCTION__);
@@ -996,20 +1400,14 @@ static void kvstxn_wait_error_cb (wait_t *w, int errnum, void *arg)
     kvstxn_set_aux_errnum (kt, errnum);
 }
 
-/* Write all the ops for a particular commit/fence request (rank 0
- * only).  The setroot event will cause responses to be sent to the
- * transaction requests and clean up the treq_t state.  This
- * function is idempotent.
+/* Return the root of transaction 'kt' and, in 'errnum', any error that
+ * ends the transaction before it is processed.
  */
-static void kvstxn_apply (kvstxn_t *kt)
+static struct kvsroot *kvstxn_apply_root (kvs_ctx_t *ctx, kvstxn_t *kt,
+                                          int *errnum)
 {
-    kvs_ctx_t *ctx = kvstxn_get_aux (kt);
     const char *namespace;
-    struct kvsroot *root = NULL;
-    wait_t *wait = NULL;
-    int errnum = 0;
-    kvstxn_process_t ret;
-    bool fallback = false;
+    struct kvsroot *root;
 
     namespace = kvstxn_get_namespace (kt);
     assert (namespace);
@@ -1028,16 +1426,29 @@ static void kvstxn_apply (kvstxn_t *kt)
     if (root->remove) {
         flux_log (ctx->h, LOG_DEBUG, "%s: namespace %s removed", __FUNCTION__,
                   namespace);
-        errnum = ENOTSUP;
-        goto done;
+        *errnum = ENOTSUP;
     }
+    else
+        *errnum = kvstxn_get_aux_errnum (kt);
+    return root;
+}
+
+static void kvstxn_apply (kvstxn_t *kt);
+
+/* Act on the result 'ret' of kvstxn_process(), or on 'errnum' if the
+ * transaction failed before it could be processed.
+ */
+static void kvstxn_apply_result (kvstxn_t *kt, struct kvsroot *root,
+                                 int errnum, kvstxn_process_t ret)
+{
+    kvs_ctx_t *ctx = kvstxn_get_aux (kt);
+    wait_t *wait = NULL;
+    bool fallback = false;
 
-    if ((errnum = kvstxn_get_aux_errnum (kt)))
+    if (errnum)
         goto done;
 
-    if ((ret = kvstxn_process (kt,
-                               ctx->epoch,
-                               root->ref)) == KVSTXN_PROCESS_ERROR) {
+    if (ret == KVSTXN_PROCESS_ERROR) {
         errnum = kvstxn_get_errnum (kt);
         goto done;
     }
@@ -1120,6 +1531,8 @@ done:
         }
         setroot (ctx, root, kvstxn_get_newroot_ref (kt), root->seq + 1);
         setroot_event_send (ctx, root, names, kvstxn_get_keys (kt));
+        histogram_push (&ctx->merge_size, count);
+        histogram_push (&ctx->commit_latency, kvstxn_get_age (kt) * 1E6);
     } else {
         fallback = kvstxn_fallback_mergeable (kt);
 
@@ -1145,6 +1558,94 @@ stall:
     return;
 }
 
+/* Write all the ops for a particular commit/fence request (rank 0
+ * only).  The setroot event will cause responses to be sent to the
+ * transaction requests and clean up the treq_t state.  This
+ * function is idempotent.
+ */
+static void kvstxn_apply (kvstxn_t *kt)
+{
+    kvs_ctx_t *ctx = kvstxn_get_aux (kt);
+    struct kvsroot *root;
+    kvstxn_process_t ret = KVSTXN_PROCESS_ERROR;
+    int errnum;
+
+    root = kvstxn_apply_root (ctx, kt, &errnum);
+    if (errnum == 0)
+        ret = kvstxn_process (kt, ctx->epoch, root->ref);
+    kvstxn_apply_result (kt, root, errnum, ret);
+}
+
+/* A transaction being processed on the commit pool.
+ */
+struct parallel_txn {
+    kvstxn_t *kt;
+    struct kvsroot *root;
+    kvstxn_process_t ret;
+};
+
+static void parallel_txn_process (void *item, void *arg)
+{
+    struct parallel_txn *pt = item;
+    kvs_ctx_t *ctx = arg;
+
+    pt->ret = kvstxn_process (pt->kt, ctx->epoch, pt->root->ref);
+}
+
+/* Process the ready transactions in 'ready', each from a different
+ * namespace, on the commit pool.  Namespaces are independent, so only
+ * the cache is shared, and it is put in parallel mode for the duration.
+ * Waiting on RPCs, sending events, and updating roots happens afterwards
+ * in kvstxn_apply_result() on this thread.
+ */
+static void kvstxn_apply_parallel (kvs_ctx_t *ctx, zlist_t *ready)
+{
+    int count = zlist_size (ready);
+    struct parallel_txn *txns;
+    void **items;
+    kvstxn_t *kt;
+    int errnum;
+    int i, n = 0;
+
+    if (!(txns = calloc (count, sizeof (*txns)))
+        || !(items = calloc (count, sizeof (*items)))) {
+        free (txns);
+        goto serial;
+    }
+    while ((kt = zlist_pop (ready))) {
+        struct kvsroot *root = kvstxn_apply_root (ctx, kt, &errnum);
+        if (errnum) {
+            kvstxn_apply_result (kt, root, errnum, KVSTXN_PROCESS_ERROR);
+            continue;
+        }
+        txns[n].kt = kt;
+        txns[n].root = root;
+        items[n] = &txns[n];
+        n++;
+    }
+    cache_parallel_begin (ctx->cache);
+    if (workpool_run (ctx->commit_pool, parallel_txn_process,
+                      items, n, ctx) < 0) {
+        for (i = 0; i < n; i++)
+            txns[i].ret = kvstxn_process (txns[i].kt, ctx->epoch,
+                                          txns[i].root->ref);
+    }
+    if (cache_parallel_end (ctx->cache) < 0)
+        flux_log_error (ctx->h, "%s: cache_parallel_end", __FUNCTION__);
+    for (i = 0; i < n; i++)
+        kvstxn_apply_result (txns[i].kt, txns[i].root, 0, txns[i].ret);
+    if (n > 1) {
+        ctx->parallel_batches++;
+        ctx->parallel_txns += n;
+    }
+    free (txns);
+    free (items);
+    return;
+serial:
+    while ((kt = zlist_pop (ready)))
+        kvstxn_apply (kt);
+}
+
 /*
  * pre/check event callbacks
  */
@@ -1152,8 +1653,15 @@ stall:
 static int kvstxn_prep_root_cb (struct kvsroot *root, void *arg)
 {
     struct kvs_cb_data *cbd = arg;
+    double delay;
 
     if (kvstxn_mgr_transaction_ready (root->ktm)) {
+        /* held in merge window, wake up when it closes */
+        if ((delay = kvstxn_mgr_merge_delay (root->ktm)) > 0) {
+            if (cbd->delay == 0 || delay < cbd->delay)
+                cbd->delay = delay;
+            return 0;
+        }
         cbd->ready = true;
         return 1;
     }
@@ -1174,6 +1682,17 @@ static void transaction_prep_cb (flux_reactor_t *r, flux_watcher_t *w,
 
     if (cbd.ready)
         flux_watcher_start (ctx->idle_w);
+    else if (cbd.delay > 0) {
+        flux_timer_watcher_reset (ctx->merge_timer_w, cbd.delay, 0.);
+        flux_watcher_start (ctx->merge_timer_w);
+    }
+}
+
+/* Nothing to do, the check watcher runs after the loop wakes up.
+ */
+static void merge_timer_cb (flux_reactor_t *r, flux_watcher_t *w,
+                            int revents, void *arg)
+{
 }
 
 static int kvstxn_check_root_cb (struct kvsroot *root, void *arg)
@@ -1181,6 +1700,9 @@ static int kvstxn_check_root_cb (struct kvsroot *root, void *arg)
     struct kvs_cb_data *cbd = arg;
     kvstxn_t *kt;
 
+    if (kvstxn_mgr_merge_delay (root->ktm) > 0)
+        return 0;
+
     if ((kt = kvstxn_mgr_get_ready_transaction (root->ktm))) {
         if (cbd->ctx->transaction_merge) {
             /* if merge fails, set errnum in txn_t, let
@@ -1200,7 +1722,8 @@ static int kvstxn_check_root_cb (struct kvsroot *root, void *arg)
          * we want to process and clear all lingering ready
          * transactions in this kvstxn manager
          */
-        kvstxn_apply (kt);
+        if (!cbd->ready_list || zlist_append (cbd->ready_list, kt) < 0)
+            kvstxn_apply (kt);
     }
 
     return 0;
@@ -1213,10 +1736,23 @@ static void transaction_check_cb (flux_reactor_t *r, flux_watcher_t *w,
     struct kvs_cb_data cbd = { .ctx = ctx, .ready = false };
 
     flux_watcher_stop (ctx->idle_w);
+    flux_watcher_stop (ctx->merge_timer_w);
+
+    /* With a commit pool, gather one ready transaction per namespace
+     * and apply them together.
+     */
+    if (ctx->commit_pool)
+        cbd.ready_list = zlist_new ();
 
-    if (kvsroot_mgr_iter_roots (ctx->krm, kvstxn_check_root_cb, &cbd) < 0) {
+    if (kvsroot_mgr_iter_roots (ctx->krm, kvstxn_check_root_cb, &cbd) < 0)
         flux_log_error (ctx->h, "%s: kvsroot_mgr_iter_roots", __FUNCTION__);
-        return;
+
+    if (cbd.ready_list) {
+        if (zlist_size (cbd.ready_list) > 1)
+            kvstxn_apply_parallel (ctx, cbd.ready_list);
+        else if (zlist_size (cbd.ready_list) == 1)
+            kvstxn_apply (zlist_pop (cbd.ready_list));
+        zlist_destroy (&cbd.ready_list);
     }
 }
 
@@ -1269,6 +1805,189 @@ static void dropcache_event_cb (flux_t *h, flux_msg_handler_t *mh,
                   expcount, size);
 }
 
+/*
+ * checkpoint
+ */
+
+/* Pack the hot directories of 'root' into an image and store it.
+ * The root is remembered so that the checkpoint refers to the root
+ * as it was when the image was taken.
+ */
+static flux_future_t *checkpoint_image_store (kvs_ctx_t *ctx,
+                                              struct kvsroot *root)
+{
+    flux_future_t *f;
+    void *buf;
+    int len;
+
+    if (checkpoint_image_pack (ctx->cache, root->ref,
+                               ctx->checkpoint_image_size,
+                               &buf, &len) < 0) {
+        flux_log_error (ctx->h, "%s: checkpoint_image_pack", __FUNCTION__);
+        return NULL;
+    }
+    strcpy (ctx->checkpoint_rootref, root->ref);
+    ctx->checkpoint_pending_seq = root->seq;
+    f = flux_content_store (ctx->h, buf, len, 0);
+    free (buf);
+    return f;
+}
+
+/* The checkpoint must not refer to blobs that have not yet reached the
+ * backing store, so the content cache is flushed before it is written.
+ */
+static flux_future_t *checkpoint_flush (kvs_ctx_t *ctx, flux_future_t *f)
+{
+    const char *imageref;
+
+    if (flux_content_store_get (f, &imageref) < 0)
+        return NULL;
+    strcpy (ctx->checkpoint_imageref, imageref);
+    return flux_rpc (ctx->h, "content.flush", NULL, FLUX_NODEID_ANY, 0);
+}
+
+static flux_future_t *checkpoint_put (kvs_ctx_t *ctx, flux_future_t *f)
+{
+    flux_future_t *f2;
+    char *value;
+
+    if (flux_future_get (f, NULL) < 0)
+        return NULL;
+    if (!(value = checkpoint_encode (ctx->checkpoint_rootref,
+                                     ctx->checkpoint_pending_seq,
+                                     ctx->checkpoint_imageref)))
+        return NULL;
+    f2 = flux_rpc_pack (ctx->h, "content-backing.checkpoint-put",
+                        FLUX_NODEID_ANY, 0,
+                        "{ s:s s:s }",
+                        "key", checkpoint_key,
+                        "value", value);
+    free (value);
+    return f2;
+}
+
+static void checkpoint_flush_continuation (flux_future_t *f, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+    flux_future_t *f2;
+
+    if (!(f2 = checkpoint_flush (ctx, f)))
+        goto error;
+    if (flux_future_continue (f, f2) < 0) {
+        flux_future_destroy (f2);
+        goto error;
+    }
+    goto done;
+error:
+    flux_future_continue_error (f, errno);
+done:
+    flux_future_destroy (f);
+}
+
+static void checkpoint_put_continuation (flux_future_t *f, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+    flux_future_t *f2;
+
+    if (!(f2 = checkpoint_put (ctx, f)))
+        goto error;
+    if (flux_future_continue (f, f2) < 0) {
+        flux_future_destroy (f2);
+        goto error;
+    }
+    goto done;
+error:
+    flux_future_continue_error (f, errno);
+done:
+    flux_future_destroy (f);
+}
+
+static void checkpoint_completion (flux_future_t *f, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+
+    if (flux_future_get (f, NULL) < 0) {
+        /* ENOSYS: there is no backing store to checkpoint to */
+        flux_log (ctx->h, errno == ENOSYS ? LOG_DEBUG : LOG_ERR,
+                  "checkpoint: %s", flux_strerror (errno));
+    }
+    else {
+        ctx->checkpoint_seq = ctx->checkpoint_pending_seq;
+        ctx->checkpoints++;
+    }
+    flux_future_destroy (f);
+    ctx->checkpoint_f = NULL;
+}
+
+/* Start an asynchronous checkpoint of the primary namespace, unless one
+ * is in progress or the root has not changed since the last one.
+ */
+static void checkpoint_start (kvs_ctx_t *ctx)
+{
+    struct kvsroot *root;
+    flux_future_t *f, *f2;
+
+    if (ctx->checkpoint_f)
+        return;
+    if (!(root = kvsroot_mgr_lookup_root_safe (ctx->krm,
+                                               KVS_PRIMARY_NAMESPACE))
+            || root->seq == ctx->checkpoint_seq)
+        return;
+    if (!(f = checkpoint_image_store (ctx, root)))
+        goto error;
+    if (!(f2 = flux_future_and_then (f, checkpoint_flush_continuation, ctx))) {
+        flux_future_destroy (f);
+        goto error;
+    }
+    f = f2;
+    if (!(f2 = flux_future_and_then (f, checkpoint_put_continuation, ctx))) {
+        flux_future_destroy (f);
+        goto error;
+    }
+    if (flux_future_then (f2, -1., checkpoint_completion, ctx) < 0) {
+        flux_future_destroy (f2);
+        goto error;
+    }
+    ctx->checkpoint_f = f2;
+    return;
+error:
+    flux_log_error (ctx->h, "%s", __FUNCTION__);
+}
+
+/* Synchronously checkpoint the primary namespace at module unload.
+ * An asynchronous checkpoint that is still in progress is abandoned.
+ */
+static void checkpoint_final (kvs_ctx_t *ctx)
+{
+    struct kvsroot *root;
+    flux_future_t *f = NULL;
+    flux_future_t *f2 = NULL;
+    flux_future_t *f3 = NULL;
+
+    flux_future_destroy (ctx->checkpoint_f);
+    ctx->checkpoint_f = NULL;
+    if (!(root = kvsroot_mgr_lookup_root_safe (ctx->krm,
+                                               KVS_PRIMARY_NAMESPACE))
+            || root->seq == ctx->checkpoint_seq)
+        return;
+    if (!(f = checkpoint_image_store (ctx, root))
+            || !(f2 = checkpoint_flush (ctx, f))
+            || !(f3 = checkpoint_put (ctx, f2))
+            || flux_future_get (f3, NULL) < 0) {
+        flux_log (ctx->h, errno == ENOSYS ? LOG_DEBUG : LOG_ERR,
+                  "checkpoint: %s", flux_strerror (errno));
+        goto done;
+    }
+    ctx->checkpoint_seq = ctx->checkpoint_pending_seq;
+    ctx->checkpoints++;
+    flux_log (ctx->h, LOG_DEBUG, "checkpoint: seq=%d %s",
+              ctx->checkpoint_seq, ctx->checkpoint_rootref);
+done:
+    flux_future_destroy (f);
+    flux_future_destroy (f2);
+    flux_future_destroy (f3);
+}
+
 static int heartbeat_root_cb (struct kvsroot *root, void *arg)
 {
     kvs_ctx_t *ctx = arg;
@@ -1332,6 +2051,13 @@ static void heartbeat_cb (flux_t *h, flux_msg_handler_t *mh,
     if (kvsroot_mgr_iter_roots (ctx->krm, heartbeat_root_cb, ctx) < 0)
         flux_log_error (ctx->h, "%s: kvsroot_mgr_iter_roots", __FUNCTION__);
 
+    /* checkpoint before expiring, so the image captures the hot set */
+    if (ctx->rank == 0 && ctx->checkpoint_period > 0
+        && ctx->epoch - ctx->checkpoint_epoch >= ctx->checkpoint_period) {
+        ctx->checkpoint_epoch = ctx->epoch;
+        checkpoint_start (ctx);
+    }
+
     if (cache_expire_entries (ctx->cache, ctx->epoch, max_lastuse_age) < 0)
         flux_log_error (ctx->h, "%s: cache_expire_entries", __FUNCTION__);
 }
@@ -1357,9 +2083,34 @@ static void lookup_wait_error_cb (wait_t *w, int errnum, void *arg)
     lookup_set_aux_errnum (lh, errnum);
 }
 
+/* Send a response for each directory resolved so far by a
+ * FLUX_KVS_READDIR_RECURSIVE lookup.
+ */
+static int lookup_subtree_respond (flux_t *h, const flux_msg_t *msg,
+                                   lookup_t *lh)
+{
+    json_t *dir;
+    char *key;
+    int rc;
+
+    while ((dir = lookup_next_subtree (lh, &key))) {
+        rc = flux_respond_pack (h, msg, "{ s:s s:O }",
+                                "key", key,
+                                "val", dir);
+        free (key);
+        json_decref (dir);
+        if (rc < 0) {
+            flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
+            return -1;
+        }
+    }
+    return 0;
+}
+
 static lookup_t *lookup_common (flux_t *h, flux_msg_handler_t *mh,
                                 const flux_msg_t *msg, void *arg,
                                 flux_msg_handler_f replay_cb,
+                                bool subtree_ok,
                                 bool *stall)
 {
     kvs_ctx_t *ctx = arg;
@@ -1380,6 +2131,7 @@ static lookup_t *lookup_common (flux_t *h, flux_msg_handler_t *mh,
     if (!lh) {
         uint32_t rolemask, userid;
         int root_seq = -1;
+        int append_offset;
 
         if (flux_request_unpack (msg, NULL, "{ s:s s:s s:i }",
                                  "key", &key,
@@ -1397,6 +2149,11 @@ static lookup_t *lookup_common (flux_t *h, flux_msg_handler_t *mh,
         (void)flux_request_unpack (msg, NULL, "{ s:i }",
                                    "rootseq", &root_seq);
 
+        if ((flags & FLUX_KVS_READDIR_RECURSIVE) && !subtree_ok) {
+            errno = EPROTO;
+            goto done;
+        }
+
         /* If root dirent was specified, lookup corresponding
          * 'root' directory.  Otherwise, use the current root.
          */
@@ -1424,6 +2181,25 @@ static lookup_t *lookup_common (flux_t *h, flux_msg_handler_t *mh,
                                   flags,
                                   h)))
             goto done;
+
+        if ((flags & FLUX_KVS_READDIR_RECURSIVE)) {
+            int maxdepth = -1;
+            const char *pattern = NULL;
+
+            /* maxdepth and pattern are optional */
+            (void)flux_request_unpack (msg, NULL, "{ s:i }",
+                                       "maxdepth", &maxdepth);
+            (void)flux_request_unpack (msg, NULL, "{ s:s }",
+                                       "pattern", &pattern);
+            if (lookup_set_subtree (lh, maxdepth, pattern) < 0)
+                goto done;
+        }
+
+        /* append_offset is optional, see FLUX_KVS_WATCH_APPEND */
+        if (!flux_request_unpack (msg, NULL, "{ s:i }",
+                                  "append_offset", &append_offset)
+            && lookup_set_append_offset (lh, append_offset) < 0)
+            goto done;
     }
     else {
         int err;
@@ -1440,6 +2216,12 @@ static lookup_t *lookup_common (flux_t *h, flux_msg_handler_t *mh,
 
     lret = lookup (lh);
 
+    /* FLUX_KVS_READDIR_RECURSIVE directories are streamed back as
+     * they are resolved, even if the lookup stalls.
+     */
+    if (subtree_ok && lookup_subtree_respond (h, msg, lh) < 0)
+        goto done;
+
     if (lret == LOOKUP_PROCESS_ERROR) {
         errno = lookup_get_errnum (lh);
         goto done;
@@ -1515,10 +2297,11 @@ static void lookup_request_cb (flux_t *h, flux_msg_handler_t *mh,
     lookup_t *lh = NULL;
     json_t *val = NULL;
     bool stall = false;
+    int flags;
     int rc = -1;
 
     if (!(lh = lookup_common (h, mh, msg, arg, lookup_request_cb,
-                              &stall))) {
+                              true, &stall))) {
         if (stall)
             goto stall;
         goto done;
@@ -1529,6 +2312,14 @@ static void lookup_request_cb (flux_t *h, flux_msg_handler_t *mh,
         goto done;
     }
 
+    /* end of FLUX_KVS_READDIR_RECURSIVE stream */
+    if (flux_request_unpack (msg, NULL, "{ s:i }", "flags", &flags) < 0)
+        goto done;
+    if ((flags & FLUX_KVS_READDIR_RECURSIVE)) {
+        errno = ENODATA;
+        goto done;
+    }
+
     if (flux_respond_pack (h, msg, "{ s:O }",
                            "val", val) < 0) {
         flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
@@ -1560,11 +2351,12 @@ static void lookup_plus_request_cb (flux_t *h, flux_msg_handler_t *mh,
     json_t *val = NULL;
     const char *root_ref = NULL;
     int root_seq = 0;
+    int blobcount;
     bool stall = false;
     int rc = -1;
 
     if (!(lh = lookup_common (h, mh, msg, arg, lookup_plus_request_cb,
-                              &stall))) {
+                              false, &stall))) {
         if (stall)
             goto stall;
         goto done;
@@ -1580,10 +2372,21 @@ static void lookup_plus_request_cb (flux_t *h, flux_msg_handler_t *mh,
         goto done;
     }
 
-    if (flux_respond_pack (h, msg, "{ s:O s:i s:s }",
-                           "val", val,
-                           "rootseq", root_seq,
-                           "rootref", root_ref) < 0) {
+    /* blobcount is returned if an append offset was requested */
+    if ((blobcount = lookup_get_blobcount (lh)) >= 0) {
+        if (flux_respond_pack (h, msg, "{ s:O s:i s:s s:i }",
+                               "val", val,
+                               "rootseq", root_seq,
+                               "rootref", root_ref,
+                               "blobcount", blobcount) < 0) {
+            flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
+            goto done;
+        }
+    }
+    else if (flux_respond_pack (h, msg, "{ s:O s:i s:s }",
+                                "val", val,
+                                "rootseq", root_seq,
+                                "rootref", root_ref) < 0) {
         flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
         goto done;
     }
@@ -1610,6 +2413,366 @@ stall:
     json_decref (val);
 }
 
+/* State of a kvs.lookup-multi request, carried across stalls in the
+ * message aux container.  Identical keys share one lookup_t, and every
+ * lookup resolves against the same root snapshot.
+ */
+struct lookup_multi {
+    char *root_ref;
+    int root_seq;
+    int nkeys;
+    int *index;             /* key => unique lookup, or -errnum */
+    int count;              /* number of unique lookups */
+    lookup_t **lh;
+    lookup_process_t *lret;
+    int aux_errnum;         /* error in prior load() */
+};
+
+static void lookup_multi_destroy (struct lookup_multi *lm)
+{
+    if (lm) {
+        int saved_errno = errno;
+        int i;
+        for (i = 0; i < lm->count; i++)
+            lookup_destroy (lm->lh[i]);
+        free (lm->lh);
+        free (lm->lret);
+        free (lm->index);
+        free (lm->root_ref);
+        free (lm);
+        errno = saved_errno;
+    }
+}
+
+static struct lookup_multi *lookup_multi_create (kvs_ctx_t *ctx,
+                                                 const char *namespace,
+                                                 const char *root_ref,
+                                                 int root_seq,
+                                                 json_t *keys,
+                                                 int flags,
+                                                 uint32_t rolemask,
+                                                 uint32_t userid)
+{
+    struct lookup_multi *lm;
+    zhash_t *uniq = NULL;
+    size_t nkeys = json_array_size (keys);
+    size_t i;
+    json_t *o;
+    int saved_errno;
+
+    if (!(lm = calloc (1, sizeof (*lm)))
+        || !(lm->root_ref = strdup (root_ref))
+        || !(lm->index = calloc (nkeys, sizeof (lm->index[0])))
+        || !(lm->lh = calloc (nkeys, sizeof (lm->lh[0])))
+        || !(lm->lret = calloc (nkeys, sizeof (lm->lret[0])))
+        || !(uniq = zhash_new ())) {
+        saved_errno = ENOMEM;
+        goto error;
+    }
+    lm->root_seq = root_seq;
+    lm->nkeys = nkeys;
+    json_array_foreach (keys, i, o) {
+        const char *key = json_string_value (o);
+        char *norm;
+        int *ip;
+
+        if (!key || strlen (key) == 0) {
+            saved_errno = EPROTO;
+            goto error;
+        }
+        if (!(norm = kvs_util_normalize_key (key, NULL))) {
+            saved_errno = errno;
+            goto error;
+        }
+        if ((ip = zhash_lookup (uniq, norm))) {
+            lm->index[i] = *ip;
+            free (norm);
+            continue;
+        }
+        if (!(lm->lh[lm->count] = lookup_create (ctx->cache,
+                                                 ctx->krm,
+                                                 ctx->epoch,
+                                                 namespace,
+                                                 lm->root_ref,
+                                                 lm->root_seq,
+                                                 key,
+                                                 rolemask,
+                                                 userid,
+                                                 flags,
+                                                 ctx->h))) {
+            /* e.g. key prefixed with a different namespace */
+            lm->index[i] = -errno;
+        }
+        else {
+            lm->index[i] = lm->count++;
+            if (zhash_insert (uniq, norm, &lm->index[i]) < 0) {
+                free (norm);
+                saved_errno = ENOMEM;
+                goto error;
+            }
+        }
+        free (norm);
+    }
+    zhash_destroy (&uniq);
+    return lm;
+error:
+    zhash_destroy (&uniq);
+    lookup_multi_destroy (lm);
+    errno = saved_errno;
+    return NULL;
+}
+
+/* Missing refs of all stalled lookups are loaded in one pass.  Keys that
+ * share a directory path need the same refs, so each ref is loaded and
+ * waited on only once per round.
+ */
+struct lookup_multi_load {
+    kvs_ctx_t *ctx;
+    wait_t *wait;
+    zhash_t *refs;
+    int errnum;
+};
+
+static int lookup_multi_load_cb (lookup_t *lh, const char *ref, void *data)
+{
+    struct lookup_multi_load *lml = data;
+    bool stall;
+
+    if (zhash_lookup (lml->refs, ref))
+        return 0;
+    if (load (lml->ctx, ref, lml->wait, &stall) < 0) {
+        lml->errnum = errno;
+        flux_log_error (lml->ctx->h, "%s: load", __FUNCTION__);
+        return -1;
+    }
+    /* if not stalling, logic issue within code */
+    assert (stall);
+    if (zhash_insert (lml->refs, ref, lml) < 0) {
+        lml->errnum = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+static void lookup_multi_wait_error_cb (wait_t *w, int errnum, void *arg)
+{
+    struct lookup_multi *lm = arg;
+    lm->aux_errnum = errnum;
+}
+
+/* Run every unfinished lookup in 'lm'.  If any need content that is not
+ * yet cached, load it and arrange for 'msg' to be replayed once it
+ * arrives.  Returns 0 with (*stall) set appropriately, or -1 on error.
+ * An error after loads have been queued stalls, and is reported when
+ * 'msg' is replayed.
+ */
+static int lookup_multi_process (kvs_ctx_t *ctx, flux_msg_handler_t *mh,
+                                 const flux_msg_t *msg,
+                                 flux_msg_handler_f replay_cb,
+                                 struct lookup_multi *lm, bool *stall)
+{
+    struct lookup_multi_load lml = { .ctx = ctx };
+    int saved_errno;
+    int i;
+
+    (*stall) = false;
+    for (i = 0; i < lm->count; i++) {
+        if (lm->lret[i] == LOOKUP_PROCESS_FINISHED
+            || lm->lret[i] == LOOKUP_PROCESS_ERROR)
+            continue;
+        lm->lret[i] = lookup (lm->lh[i]);
+        if (lm->lret[i] == LOOKUP_PROCESS_LOAD_MISSING_NAMESPACE) {
+            /* all lookups start at an explicit root_ref */
+            lm->lret[i] = LOOKUP_PROCESS_ERROR;
+            errno = ENOTSUP;
+            goto error;
+        }
+        if (lm->lret[i] != LOOKUP_PROCESS_LOAD_MISSING_REFS)
+            continue;
+        if (!lml.wait) {
+            if (!(lml.wait = wait_create_msg_handler (ctx->h, mh, msg, ctx,
+                                                      replay_cb))
+                || wait_set_error_cb (lml.wait,
+                                      lookup_multi_wait_error_cb,
+                                      lm) < 0
+                || !(lml.refs = zhash_new ()))
+                goto error;
+            /* do not destroy lookup_multi on message destruction, we
+             * manage it in here */
+            if (wait_msg_aux_set (lml.wait, "lookup_multi", lm, NULL) < 0)
+                goto error;
+        }
+        if (lookup_iter_missing_refs (lm->lh[i],
+                                      lookup_multi_load_cb,
+                                      &lml) < 0) {
+            errno = lml.errnum;
+            goto error;
+        }
+    }
+    zhash_destroy (&lml.refs);
+    /* the wait queues own the wait once loads are queued on it */
+    if (lml.wait && wait_get_usecount (lml.wait) > 0) {
+        (*stall) = true;
+        return 0;
+    }
+    wait_destroy (lml.wait);
+    return 0;
+error:
+    saved_errno = errno;
+    zhash_destroy (&lml.refs);
+    /* rpcs already in flight, stall for them to complete and report
+     * the error on replay */
+    if (lml.wait && wait_get_usecount (lml.wait) > 0) {
+        (void)wait_aux_set_errnum (lml.wait, saved_errno);
+        (*stall) = true;
+        return 0;
+    }
+    wait_destroy (lml.wait);
+    errno = saved_errno;
+    return -1;
+}
+
+static int lookup_multi_respond (flux_t *h, const flux_msg_t *msg,
+                                 struct lookup_multi *lm)
+{
+    json_t *vals;
+    json_t *o;
+    int i;
+
+    if (!(vals = json_array ()))
+        goto nomem;
+    for (i = 0; i < lm->nkeys; i++) {
+        int errnum = 0;
+        json_t *val = NULL;
+
+        if (lm->index[i] < 0)
+            errnum = -lm->index[i];
+        else if (lm->lret[lm->index[i]] == LOOKUP_PROCESS_ERROR)
+            errnum = lookup_get_errnum (lm->lh[lm->index[i]]);
+        else if (!(val = lookup_get_value (lm->lh[lm->index[i]])))
+            errnum = ENOENT;
+        if (val)
+            o = json_pack ("{ s:o }", "val", val);
+        else
+            o = json_pack ("{ s:i }", "errno", errnum);
+        if (!o || json_array_append_new (vals, o) < 0) {
+            json_decref (o);
+            goto nomem;
+        }
+    }
+    if (flux_respond_pack (h, msg, "{ s:s s:i s:o }",
+                           "rootref", lm->root_ref,
+                           "rootseq", lm->root_seq,
+                           "vals", vals) < 0) {
+        flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
+        return -1;
+    }
+    return 0;
+nomem:
+    json_decref (vals);
+    errno = ENOMEM;
+    return -1;
+}
+
+/* Look up several keys in one request.  All keys are resolved against
+ * one root snapshot, and each key succeeds or fails independently.
+ */
+static void lookup_multi_request_cb (flux_t *h, flux_msg_handler_t *mh,
+                                     const flux_msg_t *msg, void *arg)
+{
+    kvs_ctx_t *ctx = arg;
+    struct lookup_multi *lm;
+    bool stall = false;
+    int i;
+
+    /* if lookup_multi exists in msg as aux data, is a replay */
+    if (!(lm = flux_msg_aux_get (msg, "lookup_multi"))) {
+        const char *namespace;
+        json_t *keys;
+        int flags;
+        json_t *root_dirent = NULL;
+        const char *root_ref;
+        int root_seq = -1;
+        uint32_t rolemask, userid;
+
+        if (flux_request_unpack (msg, NULL, "{ s:o s:s s:i }",
+                                 "keys", &keys,
+                                 "namespace", &namespace,
+                                 "flags", &flags) < 0) {
+            flux_log_error (h, "%s: flux_request_unpack", __FUNCTION__);
+            goto error;
+        }
+        if (!json_is_array (keys) || json_array_size (keys) == 0
+            || (flags & FLUX_KVS_READDIR_RECURSIVE)) {
+            errno = EPROTO;
+            goto error;
+        }
+
+        /* rootdir is optional */
+        (void)flux_request_unpack (msg, NULL, "{ s:o }",
+                                   "rootdir", &root_dirent);
+
+        /* If root dirent was specified, lookup corresponding
+         * 'root' directory.  Otherwise, use the current root.
+         */
+        if (root_dirent) {
+            if (treeobj_validate (root_dirent) < 0
+                || !treeobj_is_dirref (root_dirent)
+                || !(root_ref = treeobj_get_blobref (root_dirent, 0))) {
+                errno = EINVAL;
+                goto error;
+            }
+        }
+        else {
+            struct kvsroot *root;
+
+            if (!(root = getroot (ctx, namespace, mh, msg, NULL,
+                                  lookup_multi_request_cb, &stall))) {
+                if (stall)
+                    return;
+                goto error;
+            }
+            root_ref = root->ref;
+            root_seq = root->seq;
+        }
+
+        if (get_msg_cred (ctx, msg, &rolemask, &userid) < 0)
+            goto error;
+
+        if (!(lm = lookup_multi_create (ctx, namespace, root_ref, root_seq,
+                                        keys, flags, rolemask, userid)))
+            goto error;
+    }
+    else {
+        int ret;
+
+        /* error in prior load(), waited for in flight rpcs to complete */
+        if (lm->aux_errnum) {
+            errno = lm->aux_errnum;
+            goto error;
+        }
+        for (i = 0; i < lm->count; i++) {
+            ret = lookup_set_current_epoch (lm->lh[i], ctx->epoch);
+            assert (ret == 0);
+        }
+    }
+
+    if (lookup_multi_process (ctx, mh, msg, lookup_multi_request_cb,
+                              lm, &stall) < 0)
+        goto error;
+    if (stall)
+        return;
+
+    if (lookup_multi_respond (h, msg, lm) < 0)
+        goto error;
+    lookup_multi_destroy (lm);
+    return;
+error:
+    if (flux_respond (h, msg, errno, NULL) < 0)
+        flux_log_error (h, "%s: flux_respond", __FUNCTION__);
+    lookup_multi_destroy (lm);
+}
+
 
 static void watch_request_cb (flux_t *h, flux_msg_handler_t *mh,
                               const flux_msg_t *msg, void *arg)
@@ -2454,15 +3617,15 @@ static void prime_cache_with_rootdir (kvs_ctx_t *ctx, json_t *rootdir)
     void *data = NULL;
     int len;
 
-    if (treeobj_validate (rootdir) < 0 || !treeobj_is_dir (rootdir)) {
+    if (treeobj_validate (rootdir) < 0
+        || (!treeobj_is_dir (rootdir) && !treeobj_is_hdir (rootdir))) {
         flux_log (ctx->h, LOG_ERR, "%s: invalid rootdir", __FUNCTION__);
         goto done;
     }
-    if (!(data = treeobj_encode (rootdir))) {
+    if (encode_treeobj (ctx, rootdir, &data, &len) < 0) {
         flux_log_error (ctx->h, "%s: treeobj_encode", __FUNCTION__);
         goto done;
     }
-    len = strlen (data);
     if (blobref_hash (ctx->hash_name, data, len, ref, sizeof (ref)) < 0) {
         flux_log_error (ctx->h, "%s: blobref_hash", __FUNCTION__);
         goto done;
@@ -2602,15 +3765,19 @@ static int stats_get_root_cb (struct kvsroot *root, void *arg)
     json_t *nsstats = arg;
     json_t *s;
 
-    if (!(s = json_pack ("{ s:i s:i s:i s:i s:i }",
+    if (!(s = json_pack ("{ s:i s:i s:i s:i s:i s:i s:i }",
                          "#watchers",
                          wait_queue_length (root->watchlist),
                          "#no-op stores",
                          kvstxn_mgr_get_noop_stores (root->ktm),
+                         "#reused dirs",
+                         kvstxn_mgr_get_reused_dirs (root->ktm),
                          "#transactions",
                          treq_mgr_transactions_count (root->trm),
                          "#readytransactions",
                          kvstxn_mgr_ready_transaction_count (root->ktm),
+                         "merge target",
+                         kvstxn_mgr_merge_target (root->ktm),
                          "store revision", root->seq))) {
         errno = ENOMEM;
         return -1;
@@ -2620,6 +3787,44 @@ static int stats_get_root_cb (struct kvsroot *root, void *arg)
     return 0;
 }
 
+/* Encode histogram as an object with count, percentiles and a
+ * "buckets" object mapping each non-empty bucket's upper bound to its
+ * count.
+ */
+static json_t *histogram_stats (histogram_t *hist)
+{
+    json_t *buckets;
+    json_t *o;
+    char key[32];
+    int i, n;
+
+    if (!(buckets = json_object ()))
+        goto nomem;
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if ((n = histogram_bucket_count (hist, i)) > 0) {
+            json_t *count;
+            snprintf (key, sizeof (key), "%.0f", histogram_bucket_max (i));
+            if (!(count = json_integer (n))
+                || json_object_set_new (buckets, key, count) < 0) {
+                json_decref (count);
+                json_decref (buckets);
+                goto nomem;
+            }
+        }
+    }
+    if (!(o = json_pack ("{ s:i s:f s:f s:f s:o }",
+                         "count", histogram_count (hist),
+                         "p50", histogram_percentile (hist, 50),
+                         "p90", histogram_percentile (hist, 90),
+                         "p99", histogram_percentile (hist, 99),
+                         "buckets", buckets)))
+        goto nomem;
+    return o;
+nomem:
+    errno = ENOMEM;
+    return NULL;
+}
+
 static void stats_get_cb (flux_t *h, flux_msg_handler_t *mh,
                           const flux_msg_t *msg, void *arg)
 {
@@ -2627,6 +3832,10 @@ static void stats_get_cb (flux_t *h, flux_msg_handler_t *mh,
     json_t *tstats = NULL;
     json_t *cstats = NULL;
     json_t *nsstats = NULL;
+    json_t *commitstats = NULL;
+    json_t *msstats = NULL;
+    json_t *lstats = NULL;
+    json_t *cpstats = NULL;
     tstat_t ts = { .min = 0.0, .max = 0.0, .M = 0.0, .S = 0.0, .newM = 0.0,
                    .newS = 0.0, .n = 0 };
     int size = 0, incomplete = 0, dirty = 0;
@@ -2676,11 +3885,13 @@ static void stats_get_cb (flux_t *h, flux_msg_handler_t *mh,
     else {
         json_t *s;
 
-        if (!(s = json_pack ("{ s:i s:i s:i s:i s:i }",
+        if (!(s = json_pack ("{ s:i s:i s:i s:i s:i s:i s:i }",
                              "#watchers", 0,
                              "#no-op stores", 0,
+                             "#reused dirs", 0,
                              "#transactions", 0,
                              "#readytransactions", 0,
+                             "merge target", 0,
                              "store revision", 0))) {
             errno = ENOMEM;
             goto done;
@@ -2689,10 +3900,38 @@ static void stats_get_cb (flux_t *h, flux_msg_handler_t *mh,
         json_object_set_new (nsstats, KVS_PRIMARY_NAMESPACE, s);
     }
 
+    if (!(msstats = histogram_stats (&ctx->merge_size))
+        || !(lstats = histogram_stats (&ctx->commit_latency)))
+        goto done;
+
+    if (!(commitstats = json_pack ("{ s:i s:i s:i s:f s:i s:O s:O }",
+                                   "workers", ctx->commit_workers,
+                                   "#parallel batches", ctx->parallel_batches,
+                                   "#parallel transactions",
+                                   ctx->parallel_txns,
+                                   "merge delay (ms)", ctx->merge_delay * 1E3,
+                                   "merge batch", ctx->merge_batch,
+                                   "merge size", msstats,
+                                   "latency (usec)", lstats))) {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    if (!(cpstats = json_pack ("{ s:i s:i s:i s:i }",
+                               "period", ctx->checkpoint_period,
+                               "#checkpoints", ctx->checkpoints,
+                               "sequence", ctx->checkpoint_seq,
+                               "#primed", ctx->checkpoint_primed))) {
+        errno = ENOMEM;
+        goto done;
+    }
+
     if (flux_respond_pack (h, msg,
-                           "{ s:O s:O }",
+                           "{ s:O s:O s:O s:O }",
                            "cache", cstats,
-                           "namespace", nsstats) < 0) {
+                           "namespace", nsstats,
+                           "commit", commitstats,
+                           "checkpoint", cpstats) < 0) {
         flux_log_error (h, "%s: flux_respond_pack", __FUNCTION__);
         goto done;
     }
@@ -2706,17 +3945,26 @@ static void stats_get_cb (flux_t *h, flux_msg_handler_t *mh,
     json_decref (tstats);
     json_decref (cstats);
     json_decref (nsstats);
+    json_decref (commitstats);
+    json_decref (msstats);
+    json_decref (lstats);
+    json_decref (cpstats);
 }
 
 static int stats_clear_root_cb (struct kvsroot *root, void *arg)
 {
     kvstxn_mgr_clear_noop_stores (root->ktm);
+    kvstxn_mgr_clear_reused_dirs (root->ktm);
     return 0;
 }
 
 static void stats_clear (kvs_ctx_t *ctx)
 {
     ctx->faults = 0;
+    ctx->parallel_batches = 0;
+    ctx->parallel_txns = 0;
+    memset (&ctx->merge_size, 0, sizeof (ctx->merge_size));
+    memset (&ctx->commit_latency, 0, sizeof (ctx->commit_latency));
 
     if (kvsroot_mgr_iter_roots (ctx->krm, stats_clear_root_cb, NULL) < 0)
         flux_log_error (ctx->h, "%s: kvsroot_mgr_iter_roots", __FUNCTION__);
@@ -2760,12 +4008,7 @@ static int namespace_create (kvs_ctx_t *ctx, const char *namespace,
         return -1;
     }
 
-    if (!(root = kvsroot_mgr_create_root (ctx->krm,
-                                          ctx->cache,
-                                          ctx->hash_name,
-                                          namespace,
-                                          owner,
-                                          flags))) {
+    if (!(root = create_root (ctx, namespace, owner, flags))) {
         flux_log_error (ctx->h, "%s: kvsroot_mgr_create_root", __FUNCTION__);
         return -1;
     }
@@ -2775,11 +4018,10 @@ static int namespace_create (kvs_ctx_t *ctx, const char *namespace,
         goto cleanup;
     }
 
-    if (!(data = treeobj_encode (rootdir))) {
+    if (encode_treeobj (ctx, rootdir, &data, &len) < 0) {
         flux_log_error (ctx->h, "%s: treeobj_encode", __FUNCTION__);
         goto cleanup;
     }
-    len = strlen (data);
 
     if (blobref_hash (ctx->hash_name, data, len, ref, sizeof (ref)) < 0) {
         flux_log_error (ctx->h, "%s: blobref_hash", __FUNCTION__);
@@ -3084,6 +4326,8 @@ static const struct flux_msg_handler_spec htab[] = {
                             lookup_request_cb, FLUX_ROLE_USER },
     { FLUX_MSGTYPE_REQUEST, "kvs.lookup-plus",
                             lookup_plus_request_cb, FLUX_ROLE_USER },
+    { FLUX_MSGTYPE_REQUEST, "kvs.lookup-multi",
+                            lookup_multi_request_cb, FLUX_ROLE_USER },
     { FLUX_MSGTYPE_REQUEST, "kvs.watch",
                             watch_request_cb, FLUX_ROLE_USER },
     { FLUX_MSGTYPE_REQUEST, "kvs.commit",
@@ -3110,6 +4354,20 @@ static void process_args (kvs_ctx_t *ctx, int ac, char **av)
     for (i = 0; i < ac; i++) {
         if (strncmp (av[i], "transaction-merge=", 13) == 0)
             ctx->transaction_merge = strtoul (av[i]+13, NULL, 10);
+        else if (strncmp (av[i], "content-batch=", 14) == 0)
+            ctx->content_batch = strtoul (av[i]+14, NULL, 10);
+        else if (strncmp (av[i], "content-compress=", 17) == 0)
+            ctx->content_compress = strtoul (av[i]+17, NULL, 10);
+        else if (strncmp (av[i], "commit-workers=", 15) == 0)
+            ctx->commit_workers = strtoul (av[i]+15, NULL, 10);
+        else if (strncmp (av[i], "merge-delay=", 12) == 0)
+            ctx->merge_delay = strtod (av[i]+12, NULL) * 1E-3;
+        else if (strncmp (av[i], "merge-batch=", 12) == 0)
+            ctx->merge_batch = strtoul (av[i]+12, NULL, 10);
+        else if (strncmp (av[i], "checkpoint-period=", 18) == 0)
+            ctx->checkpoint_period = strtoul (av[i]+18, NULL, 10);
+        else if (strncmp (av[i], "checkpoint-image-size=", 22) == 0)
+            ctx->checkpoint_image_size = strtoul (av[i]+22, NULL, 10);
         else
             flux_log (ctx->h, LOG_ERR, "Unknown option `%s'", av[i]);
     }
@@ -3132,9 +4390,8 @@ static int store_initial_rootdir (kvs_ctx_t *ctx, char *ref, int ref_len)
         flux_log_error (ctx->h, "%s: treeobj_create_dir", __FUNCTION__);
         goto error;
     }
-    if (!(data = treeobj_encode (rootdir)))
+    if (encode_treeobj (ctx, rootdir, &data, &len) < 0)
         goto error;
-    len = strlen (data);
     if (blobref_hash (ctx->hash_name, data, len, ref, ref_len) < 0) {
         flux_log_error (ctx->h, "%s: blobref_hash", __FUNCTION__);
         goto error;
@@ -3187,6 +4444,77 @@ error:
     return -1;
 }
 
+/* Load the primary namespace root from the checkpoint left in the
+ * content backing store by a previous instance, and prime the local
+ * cache with the directories in its image.  The root object itself is
+ * loaded synchronously to verify that the checkpoint is usable.
+ * Returns -1 if there is no usable checkpoint, 0 on success.
+ */
+static int load_checkpoint (kvs_ctx_t *ctx, char *ref, int ref_len, int *seq)
+{
+    char imageref[BLOBREF_MAX_STRING_SIZE];
+    struct cache_entry *entry;
+    flux_future_t *f;
+    const char *value;
+    const void *data;
+    int len;
+    int rc = -1;
+
+    if (!(f = flux_rpc_pack (ctx->h, "content-backing.checkpoint-get",
+                             FLUX_NODEID_ANY, 0,
+                             "{ s:s }",
+                             "key", checkpoint_key))
+            || flux_rpc_get_unpack (f, "{ s:s }", "value", &value) < 0) {
+        if (errno != ENOENT && errno != ENOSYS)
+            flux_log_error (ctx->h, "%s: checkpoint-get", __FUNCTION__);
+        goto done;
+    }
+    if (checkpoint_decode (value, ref, ref_len, seq,
+                           imageref, sizeof (imageref)) < 0) {
+        flux_log_error (ctx->h, "%s: checkpoint_decode", __FUNCTION__);
+        goto done;
+    }
+    flux_future_destroy (f);
+    f = NULL;
+    if (strlen (imageref) > 0) {
+        int count;
+
+        if (!(f = flux_content_load (ctx->h, imageref, 0))
+                || flux_content_load_get (f, &data, &len) < 0
+                || (count = checkpoint_image_unpack (ctx->cache,
+                                                     ctx->hash_name,
+                                                     data, len,
+                                                     ctx->epoch)) < 0)
+            flux_log_error (ctx->h, "%s: priming cache from %s",
+                            __FUNCTION__, imageref);
+        else
+            ctx->checkpoint_primed = count;
+        flux_future_destroy (f);
+        f = NULL;
+    }
+    if (!cache_lookup (ctx->cache, ref, ctx->epoch)) {
+        if (!(f = flux_content_load (ctx->h, ref, 0))
+                || flux_content_load_get (f, &data, &len) < 0) {
+            flux_log_error (ctx->h, "%s: loading root %s", __FUNCTION__, ref);
+            goto done;
+        }
+        if (!(entry = cache_entry_create (ref))
+                || cache_entry_set_raw (entry, data, len) < 0
+                || cache_insert (ctx->cache, entry) < 0) {
+            flux_log_error (ctx->h, "%s: caching root", __FUNCTION__);
+            cache_entry_destroy (entry);
+            goto done;
+        }
+    }
+    ctx->checkpoint_seq = *seq;
+    flux_log (ctx->h, LOG_INFO, "restored checkpoint seq=%d %s "
+              "(%d directories primed)", *seq, ref, ctx->checkpoint_primed);
+    rc = 0;
+done:
+    flux_future_destroy (f);
+    return rc;
+}
+
 int mod_main (flux_t *h, int argc, char **argv)
 {
     kvs_ctx_t *ctx = getctx (h);
@@ -3198,14 +4526,24 @@ int mod_main (flux_t *h, int argc, char **argv)
         goto done;
     }
     process_args (ctx, argc, argv);
+    if (ctx->rank == 0 && ctx->commit_workers > 0) {
+        if (!(ctx->commit_pool = workpool_create (ctx->commit_workers))) {
+            flux_log_error (h, "workpool_create");
+            goto done;
+        }
+    }
     if (ctx->rank == 0) {
         struct kvsroot *root;
         char rootref[BLOBREF_MAX_STRING_SIZE];
+        int rootseq = 0;
         uint32_t owner = geteuid ();
 
-        if (store_initial_rootdir (ctx, rootref, sizeof (rootref)) < 0) {
-            flux_log_error (h, "storing initial root object");
-            goto done;
+        if (load_checkpoint (ctx, rootref, sizeof (rootref), &rootseq) < 0) {
+            rootseq = 0;
+            if (store_initial_rootdir (ctx, rootref, sizeof (rootref)) < 0) {
+                flux_log_error (h, "storing initial root object");
+                goto done;
+            }
         }
 
         /* primary namespace must always be there and not marked
@@ -3214,18 +4552,14 @@ int mod_main (flux_t *h, int argc, char **argv)
         if (!(root = kvsroot_mgr_lookup_root_safe (ctx->krm,
                                                    KVS_PRIMARY_NAMESPACE))) {
 
-            if (!(root = kvsroot_mgr_create_root (ctx->krm,
-                                                  ctx->cache,
-                                                  ctx->hash_name,
-                                                  KVS_PRIMARY_NAMESPACE,
-                                                  owner,
-                                                  0))) {
+            if (!(root = create_root (ctx, KVS_PRIMARY_NAMESPACE,
+                                      owner, 0))) {
                 flux_log_error (h, "kvsroot_mgr_create_root");
                 goto done;
             }
         }
 
-        setroot (ctx, root, rootref, 0);
+        setroot (ctx, root, rootref, rootseq);
 
         if (event_subscribe (ctx, KVS_PRIMARY_NAMESPACE) < 0) {
             flux_log_error (h, "event_subscribe");
@@ -3240,6 +4574,8 @@ int mod_main (flux_t *h, int argc, char **argv)
         flux_log_error (h, "flux_reactor_run");
         goto done;
     }
+    if (ctx->rank == 0 && ctx->checkpoint_period > 0)
+        checkpoint_final (ctx);
     rc = 0;
 done:
     flux_msg_handler_delvec (handlers);
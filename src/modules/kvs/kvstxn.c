@@ -17,7 +17,9 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <czmq.h>
 #include <flux/core.h>
 #include <jansson.h>
@@ -25,6 +27,7 @@
 
 #include "src/common/libutil/macros.h"
 #include "src/common/libutil/blobref.h"
+#include "src/common/libutil/monotime.h"
 #include "src/common/libkvs/treeobj.h"
 #include "src/common/libkvs/kvs_txn_private.h"
 #include "src/common/libkvs/kvs_util_private.h"
@@ -39,7 +42,14 @@ struct kvstxn_mgr {
     struct cache *cache;
     const char *namespace;
     const char *hash_name;
+    bool binary_treeobj;        /* store treeobjs in binary encoding */
+    bool threaded;              /* kvstxn_process() may run on any thread */
     int noop_stores;            /* for kvs.stats.get, etc.*/
+    int reused_dirs;            /* for kvs.stats.get, etc.*/
+    double merge_delay_max;     /* merge window, seconds (0 = off) */
+    int merge_batch_max;
+    double interarrival;        /* moving average, seconds */
+    struct timespec last_arrival;
     zlist_t *ready;
     flux_t *h;
     void *aux;
@@ -57,6 +67,8 @@ struct kvstxn {
     char newroot[BLOBREF_MAX_STRING_SIZE];
     zlist_t *missing_refs_list;
     zlist_t *dirty_cache_entries_list;
+    zhash_t *cow;      /* unmodified dir copies in rootcpy => struct cow_dir */
+    struct timespec t_ready;    /* when (first transaction) became ready */
     int internal_flags;
     kvstxn_mgr_t *ktm;
     enum {
@@ -69,6 +81,37 @@ struct kvstxn {
     } state;
 };
 
+/* kvstxn_process() may run on a worker thread, for transactions in
+ * different namespaces at once.  Serialize use of the handle for logging.
+ */
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void kvstxn_log (kvstxn_t *kt, int level, const char *fmt, ...)
+{
+    int saved_errno = errno;
+    va_list ap;
+
+    va_start (ap, fmt);
+    pthread_mutex_lock (&log_lock);
+    flux_vlog (kt->ktm->h, level, fmt, ap);
+    pthread_mutex_unlock (&log_lock);
+    va_end (ap);
+    errno = saved_errno;
+}
+
+static void kvstxn_log_error (kvstxn_t *kt, const char *fmt, ...)
+{
+    int saved_errno = errno;
+    va_list ap;
+
+    va_start (ap, fmt);
+    pthread_mutex_lock (&log_lock);
+    flux_log_verror (kt->ktm->h, fmt, ap);
+    pthread_mutex_unlock (&log_lock);
+    va_end (ap);
+    errno = saved_errno;
+}
+
 static void kvstxn_destroy (kvstxn_t *kt)
 {
     if (kt) {
@@ -80,6 +123,7 @@ static void kvstxn_destroy (kvstxn_t *kt)
             zlist_destroy (&kt->missing_refs_list);
         if (kt->dirty_cache_entries_list)
             zlist_destroy (&kt->dirty_cache_entries_list);
+        zhash_destroy (&kt->cow);
         free (kt);
     }
 }
@@ -125,8 +169,13 @@ static kvstxn_t *kvstxn_create (kvstxn_mgr_t *ktm,
         saved_errno = ENOMEM;
         goto error;
     }
+    if (!(kt->cow = zhash_new ())) {
+        saved_errno = ENOMEM;
+        goto error;
+    }
     kt->ktm = ktm;
     kt->state = KVSTXN_STATE_INIT;
+    monotime (&kt->t_ready);
     return kt;
  error:
     kvstxn_destroy (kt);
@@ -172,6 +221,11 @@ int kvstxn_get_flags (kvstxn_t *kt)
     return kt->flags;
 }
 
+double kvstxn_get_age (kvstxn_t *kt)
+{
+    return monotime_since (kt->t_ready) * 1E-3;
+}
+
 const char *kvstxn_get_namespace (kvstxn_t *kt)
 {
     return kt->ktm->namespace;
@@ -243,6 +297,111 @@ static void cleanup_dirty_cache_list (kvstxn_t *kt)
         kvstxn_cleanup_dirty_cache_entry (kt, entry);
 }
 
+/* Directories are copied from the cache into rootcpy only when a key
+ * path passes through them, and the copy shares its entries with the
+ * cached original rather than copying them.  No shared entry is modified
+ * in place; changed entries are replaced in the copy.
+ *
+ * Jansson reference counts are only atomic in jansson >= 2.11 built
+ * with atomic builtins.  Without them, a transaction that may be
+ * processed concurrently with others (see kvstxn_mgr_set_threaded())
+ * makes deep copies instead, since the cached original may be shared
+ * with another namespace.
+ */
+#if JSON_HAVE_ATOMIC_BUILTINS
+static const bool atomic_refcount = true;
+#else
+static const bool atomic_refcount = false;
+#endif
+
+static json_t *kvstxn_dir_copy (kvstxn_t *kt, const json_t *dir)
+{
+    if (kt->ktm->threaded && !atomic_refcount)
+        return treeobj_deep_copy (dir);
+    return treeobj_copy ((json_t *)dir);
+}
+
+/* A directory copy in rootcpy that is unmodified, so its original
+ * blobref (and the serialized object in the cache) can be reused when
+ * the transaction is unrolled instead of encoding and hashing it again.
+ * A reference is held on 'dir' so that its address is not reused while
+ * it is in the kt->cow table.
+ */
+struct cow_dir {
+    json_t *dir;
+    char ref[BLOBREF_MAX_STRING_SIZE];
+};
+
+static void cow_dir_destroy (void *arg)
+{
+    struct cow_dir *cd = arg;
+    if (cd) {
+        json_decref (cd->dir);
+        free (cd);
+    }
+}
+
+static void cow_key (const json_t *dir, char *key, int len)
+{
+    snprintf (key, len, "%p", (void *)dir);
+}
+
+/* Register 'dir' as an unmodified copy of the directory stored at 'ref'.
+ */
+static int cow_register (kvstxn_t *kt, json_t *dir, const char *ref)
+{
+    struct cow_dir *cd;
+    char key[32];
+
+    if (strlen (ref) >= sizeof (cd->ref)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!(cd = calloc (1, sizeof (*cd)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    cd->dir = json_incref (dir);
+    strcpy (cd->ref, ref);
+    cow_key (dir, key, sizeof (key));
+    if (zhash_insert (kt->cow, key, cd) < 0) {
+        cow_dir_destroy (cd);
+        errno = EEXIST;
+        return -1;
+    }
+    zhash_freefn (kt->cow, key, cow_dir_destroy);
+    return 0;
+}
+
+/* Return the original blobref of 'dir' if it is an unmodified copy,
+ * else NULL.
+ */
+static const char *cow_lookup (kvstxn_t *kt, const json_t *dir)
+{
+    struct cow_dir *cd;
+    char key[32];
+
+    cow_key (dir, key, sizeof (key));
+    if ((cd = zhash_lookup (kt->cow, key)))
+        return cd->ref;
+    return NULL;
+}
+
+/* Mark every directory in 'path' as modified.
+ */
+static void cow_modified (kvstxn_t *kt, zlist_t *path)
+{
+    json_t *dir;
+    char key[32];
+
+    dir = zlist_first (path);
+    while (dir) {
+        cow_key (dir, key, sizeof (key));
+        zhash_delete (kt->cow, key);
+        dir = zlist_next (path);
+    }
+}
+
 /* Store object 'o' under key 'ref' in local cache.
  * Object reference is still owned by the caller.
  * 'is_raw' indicates this data is a json string w/ base64 value and
@@ -267,7 +426,7 @@ static int store_cache (kvstxn_t *kt, int current_epoch, json_t *o,
         len = BASE64_DECODE_SIZE (xlen);
         if (len > 0) {
             if (!(data = malloc (len))) {
-                flux_log_error (kt->ktm->h, "malloc");
+                kvstxn_log_error (kt, "malloc");
                 goto error;
             }
             if (sodium_base642bin ((unsigned char *)data, len, xdata, xlen,
@@ -278,48 +437,35 @@ static int store_cache (kvstxn_t *kt, int current_epoch, json_t *o,
             }
         }
     }
+    else if (kt->ktm->binary_treeobj) {
+        int blen;
+
+        if (treeobj_validate (o) < 0
+            || treeobj_encode_binary (o, (void **)&data, &blen) < 0) {
+            kvstxn_log_error (kt, "%s: treeobj_encode_binary",
+                              __FUNCTION__);
+            goto error;
+        }
+        len = blen;
+    }
     else {
         if (treeobj_validate (o) < 0 || !(data = treeobj_encode (o))) {
-            flux_log_error (kt->ktm->h, "%s: treeobj_encode", __FUNCTION__);
+            kvstxn_log_error (kt, "%s: treeobj_encode", __FUNCTION__);
             goto error;
         }
         len = strlen (data);
     }
     if (blobref_hash (kt->ktm->hash_name, data, len, ref, ref_len) < 0) {
-        flux_log_error (kt->ktm->h, "%s: blobref_hash", __FUNCTION__);
+        kvstxn_log_error (kt, "%s: blobref_hash", __FUNCTION__);
         goto error;
     }
-    if (!(entry = cache_lookup (kt->ktm->cache, ref, current_epoch))) {
-        if (!(entry = cache_entry_create (ref))) {
-            flux_log_error (kt->ktm->h, "%s: cache_entry_create", __FUNCTION__);
-            goto error;
-        }
-        if (cache_insert (kt->ktm->cache, entry) < 0) {
-            cache_entry_destroy (entry);
-            flux_log_error (kt->ktm->h, "%s: cache_insert", __FUNCTION__);
-            goto error;
-        }
+    if ((rc = cache_store (kt->ktm->cache, ref, data, len,
+                           current_epoch, &entry)) < 0) {
+        kvstxn_log_error (kt, "%s: cache_store", __FUNCTION__);
+        goto error;
     }
-    if (cache_entry_get_valid (entry)) {
+    if (rc == 0)
         kt->ktm->noop_stores++;
-        rc = 0;
-    }
-    else {
-        if (cache_entry_set_raw (entry, data, len) < 0) {
-            int ret;
-            ret = cache_remove_entry (kt->ktm->cache, ref);
-            assert (ret == 1);
-            goto error;
-        }
-        if (cache_entry_set_dirty (entry, true) < 0) {
-            flux_log_error (kt->ktm->h, "%s: cache_entry_set_dirty",__FUNCTION__);
-            int ret;
-            ret = cache_remove_entry (kt->ktm->cache, ref);
-            assert (ret == 1);
-            goto error;
-        }
-        rc = 1;
-    }
     *entryp = entry;
     free (data);
     return rc;
@@ -331,16 +477,91 @@ static int store_cache (kvstxn_t *kt, int current_epoch, json_t *o,
     return -1;
 }
 
+/* Directories with more entries than this are split into an hdir
+ * when stored, so that a change to one entry rewrites only the small
+ * shards on its path rather than the whole directory.
+ */
+static const int hdir_split_size = 256;
+
+/* Store treeobj 'o', returning its blobref in 'ref'.
+ * Return 0 on success, -1 on error
+ */
+static int kvstxn_store_treeobj (kvstxn_t *kt, int current_epoch, json_t *o,
+                                 char *ref, int ref_len)
+{
+    struct cache_entry *entry;
+    int ret;
+
+    if ((ret = store_cache (kt, current_epoch, o,
+                            false, ref, ref_len, &entry)) < 0)
+        return -1;
+    if (ret) {
+        if (zlist_push (kt->dirty_cache_entries_list, entry) < 0) {
+            kvstxn_cleanup_dirty_cache_entry (kt, entry);
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static json_t *kvstxn_unroll (kvstxn_t *kt, int current_epoch, json_t *obj,
+                              int depth);
+
+/* Store modified hdir shards, converting them to DIRREFs.
+ * Shards left empty are removed.
+ * Return 0 on success, -1 on error
+ */
+static int kvstxn_unroll_hdir (kvstxn_t *kt, int current_epoch, json_t *hdir)
+{
+    char ref[BLOBREF_MAX_STRING_SIZE];
+    json_t *shard;
+    json_t *ktmp;
+    int depth;
+    int i;
+
+    if ((depth = treeobj_hdir_get_depth (hdir)) < 0)
+        return -1;
+
+    for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+        if (!(shard = treeobj_hdir_get_shard (hdir, i))
+            || treeobj_is_dirref (shard))
+            continue;
+        if (treeobj_is_dir (shard) && treeobj_get_count (shard) == 0) {
+            if (treeobj_hdir_set_shard (hdir, i, NULL) < 0)
+                return -1;
+            continue;
+        }
+        if (!(ktmp = kvstxn_unroll (kt, current_epoch, shard, depth + 1)))
+            return -1;
+        if (kvstxn_store_treeobj (kt, current_epoch, ktmp,
+                                  ref, sizeof (ref)) < 0) {
+            json_decref (ktmp);
+            return -1;
+        }
+        json_decref (ktmp);
+        if (!(ktmp = treeobj_create_dirref (ref)))
+            return -1;
+        if (treeobj_hdir_set_shard (hdir, i, ktmp) < 0) {
+            json_decref (ktmp);
+            return -1;
+        }
+        json_decref (ktmp);
+    }
+    return 0;
+}
+
 /* Store DIRVAL objects, converting them to DIRREFs.
  * Store (large) FILEVAL objects, converting them to FILEREFs.
  * Return 0 on success, -1 on error
  */
-static int kvstxn_unroll (kvstxn_t *kt, int current_epoch, json_t *dir)
+static int kvstxn_unroll_dir (kvstxn_t *kt, int current_epoch, json_t *dir)
 {
     json_t *dir_entry;
     json_t *dir_data;
     json_t *ktmp;
     char ref[BLOBREF_MAX_STRING_SIZE];
+    const char *cow_ref;
     int ret;
     struct cache_entry *entry;
     void *iter;
@@ -357,19 +578,27 @@ static int kvstxn_unroll (kvstxn_t *kt, int current_epoch, json_t *dir)
      */
     while (iter) {
         dir_entry = json_object_iter_value (iter);
-        if (treeobj_is_dir (dir_entry)) {
-            if (kvstxn_unroll (kt, current_epoch, dir_entry) < 0) /* depth first */
+        if ((cow_ref = cow_lookup (kt, dir_entry))) {
+            /* unmodified, reuse stored object */
+            if (!(ktmp = treeobj_create_dirref (cow_ref)))
                 return -1;
-            if ((ret = store_cache (kt, current_epoch, dir_entry,
-                                    false, ref, sizeof (ref), &entry)) < 0)
+            if (json_object_iter_set_new (dir, iter, ktmp) < 0) {
+                json_decref (ktmp);
+                errno = ENOMEM;
                 return -1;
-            if (ret) {
-                if (zlist_push (kt->dirty_cache_entries_list, entry) < 0) {
-                    kvstxn_cleanup_dirty_cache_entry (kt, entry);
-                    errno = ENOMEM;
-                    return -1;
-                }
             }
+            kt->ktm->reused_dirs++;
+        }
+        else if (treeobj_is_dir (dir_entry) || treeobj_is_hdir (dir_entry)) {
+            /* depth first */
+            if (!(ktmp = kvstxn_unroll (kt, current_epoch, dir_entry, 0)))
+                return -1;
+            if (kvstxn_store_treeobj (kt, current_epoch, ktmp,
+                                      ref, sizeof (ref)) < 0) {
+                json_decref (ktmp);
+                return -1;
+            }
+            json_decref (ktmp);
             if (!(ktmp = treeobj_create_dirref (ref)))
                 return -1;
             if (json_object_iter_set_new (dir, iter, ktmp) < 0) {
@@ -413,6 +642,36 @@ static int kvstxn_unroll (kvstxn_t *kt, int current_epoch, json_t *dir)
     return 0;
 }
 
+/* Unroll dir or hdir 'obj' so it is ready to be stored.  A dir that has
+ * grown past hdir_split_size is split into an hdir at 'depth'.
+ * Shards of an hdir that shrink are not merged back.
+ * Returns a new reference to the object to store, or NULL on error.
+ */
+static json_t *kvstxn_unroll (kvstxn_t *kt, int current_epoch, json_t *obj,
+                              int depth)
+{
+    json_t *hdir;
+
+    if (treeobj_is_hdir (obj)) {
+        if (kvstxn_unroll_hdir (kt, current_epoch, obj) < 0)
+            return NULL;
+        return json_incref (obj);
+    }
+    if (treeobj_get_count (obj) > hdir_split_size
+        && depth <= TREEOBJ_HDIR_MAX_DEPTH) {
+        if (!(hdir = treeobj_hdir_split (obj, depth)))
+            return NULL;
+        if (kvstxn_unroll_hdir (kt, current_epoch, hdir) < 0) {
+            json_decref (hdir);
+            return NULL;
+        }
+        return hdir;
+    }
+    if (kvstxn_unroll_dir (kt, current_epoch, obj) < 0)
+        return NULL;
+    return json_incref (obj);
+}
+
 static int kvstxn_val_data_to_cache (kvstxn_t *kt, int current_epoch,
                                      json_t *val, char *ref, int ref_len)
 {
@@ -530,14 +789,15 @@ static int kvstxn_append (kvstxn_t *kt, int current_epoch, json_t *dirent,
         return -1;
     }
     else if (treeobj_is_dir (entry)
+             || treeobj_is_hdir (entry)
              || treeobj_is_dirref (entry)) {
         errno = EISDIR;
         return -1;
     }
     else {
         char *s = json_dumps (entry, JSON_ENCODE_ANY);
-        flux_log (kt->ktm->h, LOG_ERR, "%s: corrupt treeobj: %p, %s",
-                  __FUNCTION__, entry, s);
+        kvstxn_log (kt, LOG_ERR, "%s: corrupt treeobj: %p, %s",
+                    __FUNCTION__, entry, s);
         free (s);
         errno = ENOTRECOVERABLE;
         return -1;
@@ -570,6 +830,59 @@ static int check_cross_namespace (kvstxn_t *kt,
     return 0;
 }
 
+/* If 'dir' is an hdir, replace any DIRREF shards on the path to 'name'
+ * with copies of the stored shards, so that treeobj_get_entry() and
+ * friends can reach the entry.  If a shard is not yet in cache, set
+ * 'missing_ref' and return success (stall).
+ * Return 0 on success, -1 on error
+ */
+static int kvstxn_hdir_expand (kvstxn_t *kt, int current_epoch,
+                               json_t *dir, const char *name,
+                               const char **missing_ref)
+{
+    struct cache_entry *entry;
+    const json_t *shardtmp;
+    json_t *shard;
+    const char *ref;
+    int index;
+
+    while (treeobj_is_hdir (dir)) {
+        if ((index = treeobj_hdir_index (dir, name)) < 0)
+            return -1;
+        if (!(shard = treeobj_hdir_get_shard (dir, index))) {
+            if (errno == ENOENT) /* empty slot, insert will create it */
+                return 0;
+            return -1;
+        }
+        if (treeobj_is_dirref (shard)) {
+            if (treeobj_get_count (shard) != 1
+                || !(ref = treeobj_get_blobref (shard, 0))) {
+                errno = ENOTRECOVERABLE;
+                return -1;
+            }
+            if (!(entry = cache_lookup (kt->ktm->cache, ref, current_epoch))
+                || !cache_entry_get_valid (entry)) {
+                *missing_ref = ref;
+                return 0; /* stall */
+            }
+            if (!(shardtmp = cache_entry_get_treeobj (entry))) {
+                errno = ENOTRECOVERABLE;
+                return -1;
+            }
+            /* do not corrupt store by modifying orig. */
+            if (!(shard = kvstxn_dir_copy (kt, shardtmp)))
+                return -1;
+            if (treeobj_hdir_set_shard (dir, index, shard) < 0) {
+                json_decref (shard);
+                return -1;
+            }
+            json_decref (shard);
+        }
+        dir = shard;
+    }
+    return 0;
+}
+
 /* link (key, dirent) into directory 'dir'.
  */
 static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
@@ -581,6 +894,7 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
     char *next, *name;
     json_t *dir = rootdir;
     json_t *subdir = NULL, *dir_entry;
+    zlist_t *path = NULL;
     int saved_errno, rc = -1;
     char *key_suffix = NULL;
 
@@ -603,6 +917,12 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
         goto done;
     }
 
+    /* directories walked, marked modified if the key is changed */
+    if (!(path = zlist_new ())) {
+        saved_errno = ENOMEM;
+        goto done;
+    }
+
     /* This is the first part of a key with multiple path components.
      * Make sure that it is a treeobj dir, then recurse on the
      * remaining path components.
@@ -610,11 +930,24 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
     while ((next = strchr (name, '.'))) {
         *next++ = '\0';
 
-        if (!treeobj_is_dir (dir)) {
+        if (!treeobj_is_dir (dir) && !treeobj_is_hdir (dir)) {
             saved_errno = ENOTRECOVERABLE;
             goto done;
         }
 
+        if (zlist_append (path, dir) < 0) {
+            saved_errno = ENOMEM;
+            goto done;
+        }
+
+        if (kvstxn_hdir_expand (kt, current_epoch, dir, name,
+                                missing_ref) < 0) {
+            saved_errno = errno;
+            goto done;
+        }
+        if (*missing_ref)
+            goto success; /* stall */
+
         if (!(dir_entry = treeobj_get_entry (dir, name))) {
             if (json_is_null (dirent)) /* key deletion - it doesn't exist so return */
                 goto success;
@@ -628,7 +961,9 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
                 goto done;
             }
             json_decref (subdir);
-        } else if (treeobj_is_dir (dir_entry)) {
+            cow_modified (kt, path);
+        } else if (treeobj_is_dir (dir_entry)
+                   || treeobj_is_hdir (dir_entry)) {
             subdir = dir_entry;
         } else if (treeobj_is_dirref (dir_entry)) {
             struct cache_entry *entry;
@@ -642,8 +977,8 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
             }
 
             if (refcount != 1) {
-                flux_log (kt->ktm->h, LOG_ERR, "invalid dirref count: %d",
-                          refcount);
+                kvstxn_log (kt, LOG_ERR, "invalid dirref count: %d",
+                            refcount);
                 saved_errno = ENOTRECOVERABLE;
                 goto done;
             }
@@ -665,12 +1000,13 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
             }
 
             /* do not corrupt store by modifying orig. */
-            if (!(subdir = treeobj_deep_copy (subdirktmp))) {
+            if (!(subdir = kvstxn_dir_copy (kt, subdirktmp))) {
                 saved_errno = errno;
                 goto done;
             }
 
-            if (treeobj_insert_entry (dir, name, subdir) < 0) {
+            if (treeobj_insert_entry (dir, name, subdir) < 0
+                || cow_register (kt, subdir, ref) < 0) {
                 saved_errno = errno;
                 json_decref (subdir);
                 goto done;
@@ -732,6 +1068,7 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
                 goto done;
             }
             json_decref (subdir);
+            cow_modified (kt, path);
         }
         name = next;
         dir = subdir;
@@ -739,6 +1076,16 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
     /* This is the final path component of the key.  Add/modify/delete
      * it in the directory.
      */
+    if (kvstxn_hdir_expand (kt, current_epoch, dir, name, missing_ref) < 0) {
+        saved_errno = errno;
+        goto done;
+    }
+    if (*missing_ref)
+        goto success; /* stall */
+    if (zlist_append (path, dir) < 0) {
+        saved_errno = ENOMEM;
+        goto done;
+    }
     if (!json_is_null (dirent)) {
         if (flags & FLUX_KVS_APPEND) {
             if (kvstxn_append (kt, current_epoch, dirent, dir, name) < 0) {
@@ -753,6 +1100,7 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
                 goto done;
             }
         }
+        cow_modified (kt, path);
     }
     else {
         if (treeobj_delete_entry (dir, name) < 0) {
@@ -762,10 +1110,13 @@ static int kvstxn_link_dirent (kvstxn_t *kt, int current_epoch,
                 goto done;
             }
         }
+        else
+            cow_modified (kt, path);
     }
  success:
     rc = 0;
  done:
+    zlist_destroy (&path);
     free (key_suffix);
     free (cpy);
     if (rc < 0)
@@ -899,7 +1250,8 @@ kvstxn_process_t kvstxn_process (kvstxn_t *kt,
             return KVSTXN_PROCESS_ERROR;
         }
 
-        if (!(kt->rootcpy = treeobj_deep_copy (rootdir))) {
+        if (!(kt->rootcpy = kvstxn_dir_copy (kt, rootdir))
+            || cow_register (kt, kt->rootcpy, rootdir_ref) < 0) {
             kt->errnum = errno;
             return KVSTXN_PROCESS_ERROR;
         }
@@ -979,22 +1331,39 @@ kvstxn_process_t kvstxn_process (kvstxn_t *kt,
          * proceed until they are completed.
          */
         struct cache_entry *entry;
+        const char *cow_ref;
+        json_t *newroot;
         int sret;
 
-        if (kvstxn_unroll (kt, current_epoch, kt->rootcpy) < 0)
-            kt->errnum = errno;
-        else if ((sret = store_cache (kt,
-                                      current_epoch,
-                                      kt->rootcpy,
-                                      false,
-                                      kt->newroot,
-                                      sizeof (kt->newroot),
-                                      &entry)) < 0)
-            kt->errnum = errno;
-        else if (sret
-                 && zlist_push (kt->dirty_cache_entries_list, entry) < 0) {
-            kvstxn_cleanup_dirty_cache_entry (kt, entry);
-            kt->errnum = ENOMEM;
+        if ((cow_ref = cow_lookup (kt, kt->rootcpy))) {
+            /* no changes, reuse the current root */
+            strcpy (kt->newroot, cow_ref);
+            kt->ktm->reused_dirs++;
+        }
+        else {
+            /* root copy is replaced if it was split into an hdir */
+            if ((newroot = kvstxn_unroll (kt, current_epoch,
+                                          kt->rootcpy, 0))) {
+                json_decref (kt->rootcpy);
+                kt->rootcpy = newroot;
+            }
+
+            if (!newroot)
+                kt->errnum = errno;
+            else if ((sret = store_cache (kt,
+                                          current_epoch,
+                                          kt->rootcpy,
+                                          false,
+                                          kt->newroot,
+                                          sizeof (kt->newroot),
+                                          &entry)) < 0)
+                kt->errnum = errno;
+            else if (sret
+                     && zlist_push (kt->dirty_cache_entries_list,
+                                    entry) < 0) {
+                kvstxn_cleanup_dirty_cache_entry (kt, entry);
+                kt->errnum = ENOMEM;
+            }
         }
 
         if (kt->errnum) {
@@ -1006,6 +1375,7 @@ kvstxn_process_t kvstxn_process (kvstxn_t *kt,
          * rootcpy anymore.  But we may still need to stall user.
          */
         kt->state = KVSTXN_STATE_PRE_FINISHED;
+        zhash_purge (kt->cow);
         json_decref (kt->rootcpy);
         kt->rootcpy = NULL;
 
@@ -1029,7 +1399,7 @@ kvstxn_process_t kvstxn_process (kvstxn_t *kt,
     case KVSTXN_STATE_FINISHED:
         break;
     default:
-        flux_log (kt->ktm->h, LOG_ERR, "invalid kvstxn state: %d", kt->state);
+        kvstxn_log (kt, LOG_ERR, "invalid kvstxn state: %d", kt->state);
         kt->errnum = ENOTRECOVERABLE;
         return KVSTXN_PROCESS_ERROR;
     }
@@ -1147,6 +1517,23 @@ void kvstxn_mgr_destroy (kvstxn_mgr_t *ktm)
     }
 }
 
+/* Track the average time between transactions becoming ready, for
+ * sizing the merge window.  Intervals are capped at the maximum merge
+ * delay, so one long idle period does not hide a burst that follows.
+ */
+static void update_interarrival (kvstxn_mgr_t *ktm, kvstxn_t *kt)
+{
+    if (ktm->merge_delay_max <= 0)
+        return;
+    if (monotime_isset (ktm->last_arrival)) {
+        double t = monotime_since (ktm->last_arrival) * 1E-3;
+        if (t > ktm->merge_delay_max)
+            t = ktm->merge_delay_max;
+        ktm->interarrival += (t - ktm->interarrival) / 8;
+    }
+    ktm->last_arrival = kt->t_ready;
+}
+
 int kvstxn_mgr_add_transaction (kvstxn_mgr_t *ktm,
                                 const char *name,
                                 json_t *ops,
@@ -1172,6 +1559,7 @@ int kvstxn_mgr_add_transaction (kvstxn_mgr_t *ktm,
     }
     zlist_freefn (ktm->ready, kt, (zlist_free_fn *)kvstxn_destroy, true);
 
+    update_interarrival (ktm, kt);
     return 0;
 }
 
@@ -1221,6 +1609,16 @@ void kvstxn_mgr_remove_transaction (kvstxn_mgr_t *ktm, kvstxn_t *kt,
     }
 }
 
+void kvstxn_mgr_set_binary_treeobj (kvstxn_mgr_t *ktm, bool enable)
+{
+    ktm->binary_treeobj = enable;
+}
+
+void kvstxn_mgr_set_threaded (kvstxn_mgr_t *ktm, bool enable)
+{
+    ktm->threaded = enable;
+}
+
 int kvstxn_mgr_get_noop_stores (kvstxn_mgr_t *ktm)
 {
     return ktm->noop_stores;
@@ -1231,6 +1629,67 @@ void kvstxn_mgr_clear_noop_stores (kvstxn_mgr_t *ktm)
     ktm->noop_stores = 0;
 }
 
+void kvstxn_mgr_set_merge_window (kvstxn_mgr_t *ktm, double max_delay,
+                                  int max_batch)
+{
+    ktm->merge_delay_max = max_delay > 0 ? max_delay : 0;
+    ktm->merge_batch_max = max_batch > 1 ? max_batch : 1;
+    ktm->interarrival = ktm->merge_delay_max;
+    memset (&ktm->last_arrival, 0, sizeof (ktm->last_arrival));
+}
+
+int kvstxn_mgr_merge_target (kvstxn_mgr_t *ktm)
+{
+    double target;
+
+    if (ktm->merge_delay_max <= 0 || ktm->merge_batch_max <= 1)
+        return 1;
+    if (ktm->interarrival <= 0)
+        return ktm->merge_batch_max;
+    /* transactions expected to arrive within the maximum delay */
+    target = ktm->merge_delay_max / ktm->interarrival;
+    if (target < 1)
+        return 1;
+    if (target > ktm->merge_batch_max)
+        return ktm->merge_batch_max;
+    return (int)target;
+}
+
+double kvstxn_mgr_merge_delay (kvstxn_mgr_t *ktm)
+{
+    kvstxn_t *kt;
+    int target;
+    double window, age;
+
+    if (!(kt = zlist_first (ktm->ready))
+        || kt->blocked
+        || kt->state != KVSTXN_STATE_INIT
+        || kt->errnum != 0
+        || kt->aux_errnum != 0
+        || (kt->flags & FLUX_KVS_NO_MERGE)
+        || (kt->internal_flags & (KVSTXN_MERGED | KVSTXN_MERGE_COMPONENT)))
+        return 0;
+    if ((target = kvstxn_mgr_merge_target (ktm)) <= 1
+        || zlist_size (ktm->ready) >= target)
+        return 0;
+    window = target * ktm->interarrival;
+    if (window > ktm->merge_delay_max)
+        window = ktm->merge_delay_max;
+    if ((age = kvstxn_get_age (kt)) >= window)
+        return 0;
+    return window - age;
+}
+
+int kvstxn_mgr_get_reused_dirs (kvstxn_mgr_t *ktm)
+{
+    return ktm->reused_dirs;
+}
+
+void kvstxn_mgr_clear_reused_dirs (kvstxn_mgr_t *ktm)
+{
+    ktm->reused_dirs = 0;
+}
+
 int kvstxn_mgr_ready_transaction_count (kvstxn_mgr_t *ktm)
 {
     return zlist_size (ktm->ready);
@@ -1297,6 +1756,8 @@ static kvstxn_t *kvstxn_create_empty (kvstxn_mgr_t *ktm, int flags)
         goto error_enomem;
     if (!(ktnew->dirty_cache_entries_list = zlist_new ()))
         goto error_enomem;
+    if (!(ktnew->cow = zhash_new ()))
+        goto error_enomem;
     ktnew->flags = flags;
     ktnew->ktm = ktm;
     ktnew->state = KVSTXN_STATE_INIT;
@@ -1372,6 +1833,9 @@ int kvstxn_mgr_merge_ready_transactions (kvstxn_mgr_t *ktm)
     /* if count is zero, checks at beginning of function are invalid */
     assert (count);
 
+    /* latency of the merged kvstxn is that of its oldest member */
+    new->t_ready = first->t_ready;
+
     if (zlist_push (ktm->ready, new) < 0) {
         kvstxn_destroy (new);
         return -1;
@@ -60,6 +60,11 @@ json_t *kvstxn_get_ops (kvstxn_t *kt);
 json_t *kvstxn_get_names (kvstxn_t *kt);
 int kvstxn_get_flags (kvstxn_t *kt);
 
+/* returns seconds since the transaction became ready, or for a merged
+ * transaction, since its oldest member did.
+ */
+double kvstxn_get_age (kvstxn_t *kt);
+
 /* returns namespace passed into kvstxn_mgr_create() */
 const char *kvstxn_get_namespace (kvstxn_t *kt);
 
@@ -175,9 +180,49 @@ kvstxn_t *kvstxn_mgr_get_ready_transaction (kvstxn_mgr_t *ktm);
 void kvstxn_mgr_remove_transaction (kvstxn_mgr_t *ktm, kvstxn_t *kt,
                                     bool fallback);
 
+/* Store tree objects in the binary encoding (see treeobj.h) rather
+ * than JSON.  Default is JSON.
+ */
+void kvstxn_mgr_set_binary_treeobj (kvstxn_mgr_t *ktm, bool enable);
+
+/* Transactions of this manager may be processed on a thread other than
+ * the one that created it, concurrently with those of other managers
+ * sharing the cache.  Default is false.
+ */
+void kvstxn_mgr_set_threaded (kvstxn_mgr_t *ktm, bool enable);
+
+/* Adaptive merge window.  Rather than merging only the transactions
+ * that happen to be ready when the head of the ready queue is processed,
+ * the head may be held for up to 'max_delay' seconds while more arrive.
+ * The target batch size is the number of transactions expected to
+ * arrive within 'max_delay' at the recent arrival rate, capped at
+ * 'max_batch'.  At low rates the target is 1 and nothing is held.
+ * A 'max_delay' of 0 (the default) disables the window.
+ */
+void kvstxn_mgr_set_merge_window (kvstxn_mgr_t *ktm, double max_delay,
+                                  int max_batch);
+
+/* Return the current target batch size.
+ */
+int kvstxn_mgr_merge_target (kvstxn_mgr_t *ktm);
+
+/* Return the number of seconds the ready transaction should be held
+ * before it is processed, or 0 if it should be processed now.  Only an
+ * unprocessed, mergeable transaction at the head of the queue is held,
+ * and only until the target batch size is reached.
+ */
+double kvstxn_mgr_merge_delay (kvstxn_mgr_t *ktm);
+
 int kvstxn_mgr_get_noop_stores (kvstxn_mgr_t *ktm);
 void kvstxn_mgr_clear_noop_stores (kvstxn_mgr_t *ktm);
 
+/* Count of directories (including the root) that were walked but not
+ * modified by a transaction, so their stored object was reused rather
+ * than encoded and hashed again.
+ */
+int kvstxn_mgr_get_reused_dirs (kvstxn_mgr_t *ktm);
+void kvstxn_mgr_clear_reused_dirs (kvstxn_mgr_t *ktm);
+
 /* return count of ready transactions */
 int kvstxn_mgr_ready_transaction_count (kvstxn_mgr_t *ktm);
 
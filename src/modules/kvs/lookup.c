@@ -18,6 +18,7 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <fnmatch.h>
 #include <czmq.h>
 #include <flux/core.h>
 #include <jansson.h>
@@ -45,6 +46,16 @@ typedef struct {
     zlist_t *pathcomps;
 } walk_level_t;
 
+/* A directory found by a FLUX_KVS_READDIR_RECURSIVE lookup.  While
+ * pending, 'obj' is the dirent naming the directory.  Once ready, it is
+ * the dir to return to the caller.
+ */
+struct subtree_dir {
+    char *key;
+    json_t *obj;
+    int depth;
+};
+
 struct lookup {
     /* inputs from user */
     struct cache *cache;
@@ -76,6 +87,20 @@ struct lookup {
     const json_t *valref_missing_refs;
     const char *missing_ref;
 
+    /* if non-empty, iterate on these refs instead (hdir readdir) */
+    json_t *hdir_missing_refs;
+
+    /* FLUX_KVS_WATCH_APPEND */
+    int append_offset;          /* first blob to return, or -1 if unset */
+    int blobcount;              /* number of blobs in value */
+
+    /* FLUX_KVS_READDIR_RECURSIVE */
+    int subtree_maxdepth;       /* < 0 for unlimited */
+    char *subtree_pattern;      /* fnmatch(3) filter, or NULL */
+    zlist_t *subtree_pending;   /* struct subtree_dir to resolve */
+    zlist_t *subtree_ready;     /* struct subtree_dir to return */
+    json_t *subtree_missing_refs; /* set of refs, as object keys */
+
     /* for namespace callback */
 
     char *missing_namespace;
@@ -93,10 +118,51 @@ struct lookup {
         LOOKUP_STATE_WALK_INIT,
         LOOKUP_STATE_WALK,
         LOOKUP_STATE_VALUE,
+        LOOKUP_STATE_SUBTREE,
         LOOKUP_STATE_FINISHED,
     } state;
 };
 
+static void subtree_dir_destroy (struct subtree_dir *sd)
+{
+    if (sd) {
+        int saved_errno = errno;
+        free (sd->key);
+        json_decref (sd->obj);
+        free (sd);
+        errno = saved_errno;
+    }
+}
+
+/* Create a subtree_dir for entry 'name' of dir 'parent'.  The key of
+ * the root directory is ".", which is not a prefix of its children.
+ */
+static struct subtree_dir *subtree_dir_create (const char *parent,
+                                               const char *name,
+                                               json_t *obj,
+                                               int depth)
+{
+    struct subtree_dir *sd;
+    int rc;
+
+    if (!(sd = calloc (1, sizeof (*sd))))
+        return NULL;
+    if (!name)
+        rc = asprintf (&sd->key, "%s", parent);
+    else if (!strcmp (parent, "."))
+        rc = asprintf (&sd->key, "%s", name);
+    else
+        rc = asprintf (&sd->key, "%s.%s", parent, name);
+    if (rc < 0) {
+        free (sd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    sd->obj = json_incref (obj);
+    sd->depth = depth;
+    return sd;
+}
+
 static bool last_pathcomp (zlist_t *pathcomps, const void *data)
 {
     return (zlist_tail (pathcomps) == data);
@@ -359,6 +425,157 @@ cleanup:
     return ret;
 }
 
+/* Descend the shards of hdir 'dir' to the dir that would hold 'name'.
+ * On success, '*dirp' is set to that dir, or NULL if its slot is empty.
+ */
+static lookup_process_t hdir_descend (lookup_t *lh,
+                                      const json_t *dir,
+                                      const char *name,
+                                      const json_t **dirp)
+{
+    struct cache_entry *entry;
+    const json_t *shard;
+    const char *refstr;
+    int index;
+
+    while (treeobj_is_hdir (dir)) {
+        if ((index = treeobj_hdir_index (dir, name)) < 0) {
+            lh->errnum = errno;
+            return LOOKUP_PROCESS_ERROR;
+        }
+        if (!(shard = treeobj_hdir_get_shard ((json_t *)dir, index))) {
+            if (errno != ENOENT) {
+                lh->errnum = errno;
+                return LOOKUP_PROCESS_ERROR;
+            }
+            (*dirp) = NULL;
+            return LOOKUP_PROCESS_FINISHED;
+        }
+        if (treeobj_is_dirref (shard)) {
+            if (treeobj_get_count (shard) != 1
+                || !(refstr = treeobj_get_blobref (shard, 0))) {
+                lh->errnum = ENOTRECOVERABLE;
+                return LOOKUP_PROCESS_ERROR;
+            }
+            if (!(entry = cache_lookup (lh->cache, refstr, lh->current_epoch))
+                || !cache_entry_get_valid (entry)) {
+                lh->missing_ref = refstr;
+                return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+            }
+            if (!(shard = cache_entry_get_treeobj (entry))) {
+                flux_log (lh->h, LOG_ERR, "hdir shard points to non-treeobj");
+                lh->errnum = ENOTRECOVERABLE;
+                return LOOKUP_PROCESS_ERROR;
+            }
+        }
+        dir = shard;
+    }
+    if (!treeobj_is_dir (dir)) {
+        lh->errnum = ENOTRECOVERABLE;
+        return LOOKUP_PROCESS_ERROR;
+    }
+    (*dirp) = dir;
+    return LOOKUP_PROCESS_FINISHED;
+}
+
+/* Copy the entries of hdir 'hdir' into dir 'dir'.  Shards that are
+ * not in cache are appended to the 'missing' array.
+ * Return 0 on success, -1 on error with errno set.
+ */
+static int hdir_flatten (lookup_t *lh, const json_t *hdir, json_t *dir,
+                         json_t *missing)
+{
+    struct cache_entry *entry;
+    const json_t *shard;
+    const char *refstr;
+    const char *name;
+    json_t *dir_data;
+    json_t *o, *cpy;
+    int i;
+
+    dir_data = treeobj_get_data (dir);
+    for (i = 0; i < TREEOBJ_HDIR_FANOUT; i++) {
+        if (!(shard = treeobj_hdir_get_shard ((json_t *)hdir, i))) {
+            if (errno != ENOENT)
+                return -1;
+            continue;
+        }
+        if (treeobj_is_dirref (shard)) {
+            if (treeobj_get_count (shard) != 1
+                || !(refstr = treeobj_get_blobref (shard, 0))) {
+                errno = ENOTRECOVERABLE;
+                return -1;
+            }
+            if (!(entry = cache_lookup (lh->cache, refstr, lh->current_epoch))
+                || !cache_entry_get_valid (entry)) {
+                if (json_array_append_new (missing,
+                                           json_string (refstr)) < 0) {
+                    errno = ENOMEM;
+                    return -1;
+                }
+                continue;
+            }
+            if (!(shard = cache_entry_get_treeobj (entry))) {
+                errno = ENOTRECOVERABLE;
+                return -1;
+            }
+        }
+        if (treeobj_is_hdir (shard)) {
+            if (hdir_flatten (lh, shard, dir, missing) < 0)
+                return -1;
+        }
+        else if (treeobj_is_dir (shard)) {
+            json_object_foreach (treeobj_get_data ((json_t *)shard), name, o) {
+                if (!(cpy = treeobj_deep_copy (o)))
+                    return -1;
+                if (json_object_set_new (dir_data, name, cpy) < 0) {
+                    json_decref (cpy);
+                    errno = ENOMEM;
+                    return -1;
+                }
+            }
+        }
+        else {
+            errno = ENOTRECOVERABLE;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Set lh->val to a dir holding all entries of hdir 'hdir'.  All missing
+ * shards are requested at once, via lh->hdir_missing_refs.
+ */
+static lookup_process_t readdir_hdir (lookup_t *lh, const json_t *hdir)
+{
+    json_t *dir;
+
+    if (!lh->hdir_missing_refs) {
+        if (!(lh->hdir_missing_refs = json_array ())) {
+            lh->errnum = ENOMEM;
+            return LOOKUP_PROCESS_ERROR;
+        }
+    }
+    else
+        json_array_clear (lh->hdir_missing_refs);
+
+    if (!(dir = treeobj_create_dir ())) {
+        lh->errnum = errno;
+        return LOOKUP_PROCESS_ERROR;
+    }
+    if (hdir_flatten (lh, hdir, dir, lh->hdir_missing_refs) < 0) {
+        lh->errnum = errno;
+        json_decref (dir);
+        return LOOKUP_PROCESS_ERROR;
+    }
+    if (json_array_size (lh->hdir_missing_refs) > 0) {
+        json_decref (dir);
+        return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+    }
+    lh->val = dir;
+    return LOOKUP_PROCESS_FINISHED;
+}
+
 /* Get dirent of the requested path starting at the given root.
  *
  * Return true on success or error, error code is returned in ep and
@@ -419,7 +636,7 @@ static lookup_process_t walk (lookup_t *lh)
                     lh->errnum = ENOTRECOVERABLE;
                 goto error;
             }
-            if (!treeobj_is_dir (dir)) {
+            if (!treeobj_is_dir (dir) && !treeobj_is_hdir (dir)) {
                 /* dirref pointed to non-dir error, special case when
                  * root_dirent is bad, is EINVAL from user.
                  */
@@ -450,6 +667,22 @@ static lookup_process_t walk (lookup_t *lh)
             }
         }
 
+        /* Large directories are sharded, find the shard holding
+         * path component.
+         */
+
+        if (treeobj_is_hdir (dir)) {
+            lookup_process_t hret;
+
+            hret = hdir_descend (lh, dir, pathcomp, &dir);
+            if (hret == LOOKUP_PROCESS_ERROR)
+                goto error;
+            else if (hret == LOOKUP_PROCESS_LOAD_MISSING_REFS)
+                return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+            if (!dir) /* empty shard, entry does not exist */
+                goto done;
+        }
+
         /* Get directory reference of path component from directory */
 
         if (!(dirent_tmp = treeobj_peek_entry (dir, pathcomp))) {
@@ -608,12 +841,29 @@ lookup_t *lookup_create (struct cache *cache,
     lh->valref_missing_refs = NULL;
     lh->missing_ref = NULL;
     lh->errnum = 0;
+    lh->append_offset = -1;
+    lh->blobcount = -1;
 
     if (!(lh->levels = zlist_new ())) {
         saved_errno = ENOMEM;
         goto cleanup;
     }
 
+    if ((flags & FLUX_KVS_READDIR_RECURSIVE)) {
+        if (!(flags & FLUX_KVS_READDIR)
+            || (flags & FLUX_KVS_READLINK)) {
+            saved_errno = EINVAL;
+            goto cleanup;
+        }
+        lh->subtree_maxdepth = -1;
+        if (!(lh->subtree_pending = zlist_new ())
+            || !(lh->subtree_ready = zlist_new ())
+            || !(lh->subtree_missing_refs = json_object ())) {
+            saved_errno = ENOMEM;
+            goto cleanup;
+        }
+    }
+
     lh->wdirent = NULL;
     lh->state = LOOKUP_STATE_INIT;
 
@@ -634,6 +884,21 @@ void lookup_destroy (lookup_t *lh)
         free (lh->root_ref);
         free (lh->path);
         json_decref (lh->val);
+        json_decref (lh->hdir_missing_refs);
+        free (lh->subtree_pattern);
+        if (lh->subtree_pending) {
+            struct subtree_dir *sd;
+            while ((sd = zlist_pop (lh->subtree_pending)))
+                subtree_dir_destroy (sd);
+            zlist_destroy (&lh->subtree_pending);
+        }
+        if (lh->subtree_ready) {
+            struct subtree_dir *sd;
+            while ((sd = zlist_pop (lh->subtree_ready)))
+                subtree_dir_destroy (sd);
+            zlist_destroy (&lh->subtree_ready);
+        }
+        json_decref (lh->subtree_missing_refs);
         free (lh->missing_namespace);
         zlist_destroy (&lh->levels);
         free (lh);
@@ -648,7 +913,8 @@ int lookup_get_errnum (lookup_t *lh)
         if (lh->state == LOOKUP_STATE_CHECK_NAMESPACE
             || lh->state == LOOKUP_STATE_CHECK_ROOT
             || lh->state == LOOKUP_STATE_WALK
-            || lh->state == LOOKUP_STATE_VALUE)
+            || lh->state == LOOKUP_STATE_VALUE
+            || lh->state == LOOKUP_STATE_SUBTREE)
             return EAGAIN;
     }
     return EINVAL;
@@ -684,8 +950,27 @@ int lookup_iter_missing_refs (lookup_t *lh, lookup_ref_f cb, void *data)
     if (lh
         && (lh->state == LOOKUP_STATE_CHECK_ROOT
             || lh->state == LOOKUP_STATE_WALK
-            || lh->state == LOOKUP_STATE_VALUE)) {
-        if (lh->valref_missing_refs) {
+            || lh->state == LOOKUP_STATE_VALUE
+            || lh->state == LOOKUP_STATE_SUBTREE)) {
+        if (lh->state == LOOKUP_STATE_SUBTREE) {
+            const char *ref;
+            json_t *o;
+
+            json_object_foreach (lh->subtree_missing_refs, ref, o) {
+                if (cb (lh, ref, data) < 0)
+                    return -1;
+            }
+        }
+        else if (json_array_size (lh->hdir_missing_refs) > 0) {
+            size_t index;
+            json_t *o;
+
+            json_array_foreach (lh->hdir_missing_refs, index, o) {
+                if (cb (lh, json_string_value (o), data) < 0)
+                    return -1;
+            }
+        }
+        else if (lh->valref_missing_refs) {
             int refcount, i;
 
             if (!treeobj_is_valref (lh->valref_missing_refs)) {
@@ -696,7 +981,10 @@ int lookup_iter_missing_refs (lookup_t *lh, lookup_ref_f cb, void *data)
             refcount = treeobj_get_count (lh->valref_missing_refs);
             assert (refcount > 0);
 
-            for (i = 0; i < refcount; i++) {
+            /* blobs before the append offset are not needed */
+            for (i = lh->append_offset > 0 ? lh->append_offset : 0;
+                 i < refcount;
+                 i++) {
                 struct cache_entry *entry;
                 const char *ref;
 
@@ -771,6 +1059,71 @@ int lookup_set_current_epoch (lookup_t *lh, int epoch)
     return -1;
 }
 
+int lookup_set_subtree (lookup_t *lh, int maxdepth, const char *pattern)
+{
+    if (!lh
+        || !(lh->flags & FLUX_KVS_READDIR_RECURSIVE)
+        || lh->state != LOOKUP_STATE_INIT) {
+        errno = EINVAL;
+        return -1;
+    }
+    free (lh->subtree_pattern);
+    lh->subtree_pattern = NULL;
+    if (pattern && !(lh->subtree_pattern = strdup (pattern))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    lh->subtree_maxdepth = maxdepth;
+    return 0;
+}
+
+int lookup_set_append_offset (lookup_t *lh, int offset)
+{
+    if (!lh
+        || offset < 0
+        || (lh->flags & (FLUX_KVS_READDIR
+                         | FLUX_KVS_READLINK
+                         | FLUX_KVS_TREEOBJ))
+        || lh->state != LOOKUP_STATE_INIT) {
+        errno = EINVAL;
+        return -1;
+    }
+    lh->append_offset = offset;
+    return 0;
+}
+
+int lookup_get_blobcount (lookup_t *lh)
+{
+    if (!lh
+        || lh->append_offset < 0
+        || lh->state != LOOKUP_STATE_FINISHED
+        || lh->errnum != 0
+        || lh->blobcount < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return lh->blobcount;
+}
+
+json_t *lookup_next_subtree (lookup_t *lh, char **key)
+{
+    struct subtree_dir *sd;
+    json_t *dir;
+
+    if (!lh || !key || !lh->subtree_ready) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(sd = zlist_pop (lh->subtree_ready))) {
+        errno = ENOENT;
+        return NULL;
+    }
+    (*key) = sd->key;
+    dir = sd->obj;
+    free (sd);
+    return dir;
+}
+
 static int namespace_still_valid (lookup_t *lh)
 {
     struct kvsroot *root;
@@ -800,14 +1153,15 @@ static int namespace_still_valid (lookup_t *lh)
 
 /* return 0 on success, -1 on failure.  On success, stall should be
  * checked */
-static int get_single_blobref_valref_value (lookup_t *lh, bool *stall)
+static int get_single_blobref_valref_value (lookup_t *lh, int index,
+                                            bool *stall)
 {
     struct cache_entry *entry;
     const char *reftmp;
     const void *valdata;
     int len;
 
-    if (!(reftmp = treeobj_get_blobref (lh->wdirent, 0))) {
+    if (!(reftmp = treeobj_get_blobref (lh->wdirent, index))) {
         lh->errnum = errno;
         return -1;
     }
@@ -830,8 +1184,9 @@ static int get_single_blobref_valref_value (lookup_t *lh, bool *stall)
     return 0;
 }
 
-static int get_multi_blobref_valref_length (lookup_t *lh, int refcount,
-                                            int *total_len, bool *stall)
+static int get_multi_blobref_valref_length (lookup_t *lh, int start,
+                                            int refcount, int *total_len,
+                                            bool *stall)
 {
     struct cache_entry *entry;
     const char *reftmp;
@@ -839,7 +1194,7 @@ static int get_multi_blobref_valref_length (lookup_t *lh, int refcount,
     int len;
     int i;
 
-    for (i = 0; i < refcount; i++) {
+    for (i = start; i < refcount; i++) {
         if (!(reftmp = treeobj_get_blobref (lh->wdirent, i))) {
             lh->errnum = errno;
             return -1;
@@ -870,8 +1225,8 @@ static int get_multi_blobref_valref_length (lookup_t *lh, int refcount,
     return 0;
 }
 
-static char *get_multi_blobref_valref_data (lookup_t *lh, int refcount,
-                                            int total_len)
+static char *get_multi_blobref_valref_data (lookup_t *lh, int start,
+                                            int refcount, int total_len)
 {
     struct cache_entry *entry;
     const char *reftmp;
@@ -886,7 +1241,7 @@ static char *get_multi_blobref_valref_data (lookup_t *lh, int refcount,
         return NULL;
     }
 
-    for (i = 0; i < refcount; i++) {
+    for (i = start; i < refcount; i++) {
         int ret;
 
         /* this function should only be called if all cache entries
@@ -910,16 +1265,18 @@ static char *get_multi_blobref_valref_data (lookup_t *lh, int refcount,
     return valbuf;
 }
 
-/* return 0 on success, -1 on failure.  On success, stall should be
+/* Concatenate blobs 'start' through 'refcount' - 1.
+ * return 0 on success, -1 on failure.  On success, stall should be
  * check */
-static int get_multi_blobref_valref_value (lookup_t *lh, int refcount,
-                                           bool *stall)
+static int get_multi_blobref_valref_value (lookup_t *lh, int start,
+                                           int refcount, bool *stall)
 {
     char *valbuf = NULL;
     int total_len = 0;
     int rc = -1;
 
-    if (get_multi_blobref_valref_length (lh, refcount, &total_len, stall) < 0)
+    if (get_multi_blobref_valref_length (lh, start, refcount, &total_len,
+                                         stall) < 0)
         goto done;
 
     if ((*stall) == true) {
@@ -927,7 +1284,8 @@ static int get_multi_blobref_valref_value (lookup_t *lh, int refcount,
         goto done;
     }
 
-    if (!(valbuf = get_multi_blobref_valref_data (lh, refcount, total_len)))
+    if (!(valbuf = get_multi_blobref_valref_data (lh, start, refcount,
+                                                  total_len)))
         goto done;
 
     if (!(lh->val = treeobj_create_val (valbuf, total_len))) {
@@ -942,6 +1300,270 @@ done:
     return rc;
 }
 
+static int subtree_add_missing (lookup_t *lh, const char *ref)
+{
+    if (json_object_set_new (lh->subtree_missing_refs, ref, json_true ()) < 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+/* Resolve 'valref' to a val.  If any of its blobs are not in cache,
+ * add them to lh->subtree_missing_refs and set '*valp' to NULL.
+ * Return 0 on success, -1 on error with errno set.
+ */
+static int subtree_get_value (lookup_t *lh, const json_t *valref,
+                              json_t **valp)
+{
+    struct cache_entry *entry;
+    const char *ref;
+    const void *data;
+    char *buf;
+    int refcount, len, i;
+    int total = 0;
+    bool missing = false;
+
+    if ((refcount = treeobj_get_count (valref)) <= 0) {
+        errno = ENOTRECOVERABLE;
+        return -1;
+    }
+    for (i = 0; i < refcount; i++) {
+        if (!(ref = treeobj_get_blobref (valref, i)))
+            return -1;
+        if (!(entry = cache_lookup (lh->cache, ref, lh->current_epoch))
+            || !cache_entry_get_valid (entry)) {
+            if (subtree_add_missing (lh, ref) < 0)
+                return -1;
+            missing = true;
+            continue;
+        }
+        if (cache_entry_get_raw (entry, NULL, &len) < 0) {
+            errno = ENOTRECOVERABLE;
+            return -1;
+        }
+        if (len > (INT_MAX - total)) {
+            errno = EOVERFLOW;
+            return -1;
+        }
+        total += len;
+    }
+    if (missing) {
+        (*valp) = NULL;
+        return 0;
+    }
+    if (!(buf = malloc (total + 1)))
+        return -1;
+    total = 0;
+    for (i = 0; i < refcount; i++) {
+        ref = treeobj_get_blobref (valref, i);
+        entry = cache_lookup (lh->cache, ref, lh->current_epoch);
+        if (cache_entry_get_raw (entry, &data, &len) < 0) {
+            free (buf);
+            errno = ENOTRECOVERABLE;
+            return -1;
+        }
+        memcpy (buf + total, data, len);
+        total += len;
+    }
+    (*valp) = treeobj_create_val (buf, total);
+    free (buf);
+    return (*valp) ? 0 : -1;
+}
+
+/* Build the dir to return for 'sd': subdirectories are left as dirrefs,
+ * and are queued for their own turn unless beyond the depth limit.
+ * Entries that do not match the filter are dropped, and valrefs are
+ * replaced by vals unless FLUX_KVS_TREEOBJ was requested.  If anything
+ * is missing from cache, set '*stall' and leave 'sd' unchanged.
+ * Return 0 on success, -1 on error with errno set.
+ */
+static int subtree_resolve (lookup_t *lh, struct subtree_dir *sd, bool *stall)
+{
+    const json_t *obj = sd->obj;
+    json_t *tmp = NULL;
+    json_t *dir = NULL;
+    zlist_t *children = NULL;
+    struct subtree_dir *child;
+    const char *name;
+    json_t *o;
+    bool missing = false;
+    int saved_errno;
+
+    (*stall) = false;
+    if (treeobj_is_dirref (obj)) {
+        struct cache_entry *entry;
+        const char *ref;
+
+        if (treeobj_get_count (obj) != 1
+            || !(ref = treeobj_get_blobref (obj, 0))) {
+            errno = ENOTRECOVERABLE;
+            return -1;
+        }
+        if (!(entry = cache_lookup (lh->cache, ref, lh->current_epoch))
+            || !cache_entry_get_valid (entry)) {
+            if (subtree_add_missing (lh, ref) < 0)
+                return -1;
+            (*stall) = true;
+            return 0;
+        }
+        if (!(obj = cache_entry_get_treeobj (entry))) {
+            flux_log (lh->h, LOG_ERR, "dirref points to non-treeobj");
+            errno = ENOTRECOVERABLE;
+            return -1;
+        }
+    }
+    if (treeobj_is_hdir (obj)) {
+        json_t *shards;
+        size_t index;
+
+        if (!(tmp = treeobj_create_dir ()))
+            goto error;
+        if (!(shards = json_array ())) {
+            errno = ENOMEM;
+            goto error;
+        }
+        if (hdir_flatten (lh, obj, tmp, shards) < 0) {
+            json_decref (shards);
+            goto error;
+        }
+        json_array_foreach (shards, index, o) {
+            if (subtree_add_missing (lh, json_string_value (o)) < 0) {
+                json_decref (shards);
+                goto error;
+            }
+            missing = true;
+        }
+        json_decref (shards);
+        if (missing)
+            goto stall;
+        obj = tmp;
+    }
+    else if (!treeobj_is_dir (obj)) {
+        errno = ENOTDIR;
+        return -1;
+    }
+
+    if (!(dir = treeobj_create_dir ()))
+        goto error;
+    if (!(children = zlist_new ())) {
+        errno = ENOMEM;
+        goto error;
+    }
+    json_object_foreach (treeobj_get_data ((json_t *)obj), name, o) {
+        json_t *cpy;
+
+        if (treeobj_is_dirref (o) || treeobj_is_dir (o)) {
+            if (lh->subtree_maxdepth < 0
+                || sd->depth < lh->subtree_maxdepth) {
+                if (!(child = subtree_dir_create (sd->key, name, o,
+                                                  sd->depth + 1)))
+                    goto error;
+                if (zlist_append (children, child) < 0) {
+                    subtree_dir_destroy (child);
+                    errno = ENOMEM;
+                    goto error;
+                }
+            }
+            cpy = treeobj_deep_copy (o);
+        }
+        else if (lh->subtree_pattern
+                 && fnmatch (lh->subtree_pattern, name, 0) != 0)
+            continue;
+        else if (treeobj_is_valref (o) && !(lh->flags & FLUX_KVS_TREEOBJ)) {
+            if (subtree_get_value (lh, o, &cpy) < 0)
+                goto error;
+            if (!cpy) {
+                missing = true;
+                continue;
+            }
+        }
+        else
+            cpy = treeobj_deep_copy (o);
+        if (!cpy)
+            goto error;
+        if (treeobj_insert_entry (dir, name, cpy) < 0) {
+            json_decref (cpy);
+            goto error;
+        }
+        json_decref (cpy);
+    }
+    if (missing)
+        goto stall;
+
+    while ((child = zlist_pop (children))) {
+        if (zlist_append (lh->subtree_pending, child) < 0) {
+            subtree_dir_destroy (child);
+            errno = ENOMEM;
+            goto error;
+        }
+    }
+    json_decref (sd->obj);
+    sd->obj = dir;
+    zlist_destroy (&children);
+    json_decref (tmp);
+    return 0;
+stall:
+    (*stall) = true;
+    if (children) {
+        while ((child = zlist_pop (children)))
+            subtree_dir_destroy (child);
+        zlist_destroy (&children);
+    }
+    json_decref (dir);
+    json_decref (tmp);
+    return 0;
+error:
+    saved_errno = errno;
+    if (children) {
+        while ((child = zlist_pop (children)))
+            subtree_dir_destroy (child);
+        zlist_destroy (&children);
+    }
+    json_decref (dir);
+    json_decref (tmp);
+    errno = saved_errno;
+    return -1;
+}
+
+/* Resolve as many pending directories as the cache allows, moving them
+ * to lh->subtree_ready.  Directories are resolved breadth first.
+ */
+static lookup_process_t subtree_process (lookup_t *lh)
+{
+    struct subtree_dir *sd;
+    zlist_t *stalled;
+    bool stall;
+
+    json_object_clear (lh->subtree_missing_refs);
+    if (!(stalled = zlist_new ())) {
+        lh->errnum = ENOMEM;
+        return LOOKUP_PROCESS_ERROR;
+    }
+    while ((sd = zlist_pop (lh->subtree_pending))) {
+        if (subtree_resolve (lh, sd, &stall) < 0) {
+            lh->errnum = errno;
+            subtree_dir_destroy (sd);
+            goto error;
+        }
+        if (zlist_append (stall ? stalled : lh->subtree_ready, sd) < 0) {
+            lh->errnum = ENOMEM;
+            subtree_dir_destroy (sd);
+            goto error;
+        }
+    }
+    zlist_destroy (&lh->subtree_pending);
+    lh->subtree_pending = stalled;
+    if (zlist_size (stalled) > 0)
+        return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+    return LOOKUP_PROCESS_FINISHED;
+error:
+    while ((sd = zlist_pop (stalled)))
+        subtree_dir_destroy (sd);
+    zlist_destroy (&stalled);
+    return LOOKUP_PROCESS_ERROR;
+}
+
 lookup_process_t lookup (lookup_t *lh)
 {
     const json_t *valtmp = NULL;
@@ -1036,6 +1658,14 @@ lookup_process_t lookup (lookup_t *lh)
                         lh->errnum = EINVAL;
                         goto error;
                     }
+                    if (treeobj_is_hdir (valtmp)) {
+                        lookup_process_t hret = readdir_hdir (lh, valtmp);
+                        if (hret == LOOKUP_PROCESS_ERROR)
+                            goto error;
+                        else if (hret == LOOKUP_PROCESS_LOAD_MISSING_REFS)
+                            return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+                        goto done;
+                    }
                     if (!treeobj_is_dir (valtmp)) {
                         /* root_ref points to not dir */
                         lh->errnum = ENOTRECOVERABLE;
@@ -1134,6 +1764,14 @@ lookup_process_t lookup (lookup_t *lh)
                     lh->errnum = ENOTRECOVERABLE;
                     goto error;
                 }
+                if (treeobj_is_hdir (valtmp)) {
+                    lookup_process_t hret = readdir_hdir (lh, valtmp);
+                    if (hret == LOOKUP_PROCESS_ERROR)
+                        goto error;
+                    else if (hret == LOOKUP_PROCESS_LOAD_MISSING_REFS)
+                        return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+                    break;
+                }
                 if (!treeobj_is_dir (valtmp)) {
                     /* dirref points to not dir */
                     lh->errnum = ENOTRECOVERABLE;
@@ -1145,6 +1783,7 @@ lookup_process_t lookup (lookup_t *lh)
                 }
             } else if (treeobj_is_valref (lh->wdirent)) {
                 bool stall;
+                int start;
 
                 if ((lh->flags & FLUX_KVS_READLINK)) {
                     lh->errnum = EINVAL;
@@ -1164,20 +1803,39 @@ lookup_process_t lookup (lookup_t *lh)
                     lh->errnum = ENOTRECOVERABLE;
                     goto error;
                 }
-                if (refcount == 1) {
-                    if (get_single_blobref_valref_value (lh, &stall) < 0)
+                /* FLUX_KVS_WATCH_APPEND - return only blobs appended
+                 * after the offset.  If the value has fewer blobs than
+                 * the offset, it was overwritten rather than appended.
+                 */
+                start = lh->append_offset > 0 ? lh->append_offset : 0;
+                if (start > refcount) {
+                    lh->errnum = EINVAL;
+                    goto error;
+                }
+                if (start == refcount) {
+                    if (!(lh->val = treeobj_create_val (NULL, 0))) {
+                        lh->errnum = errno;
+                        goto error;
+                    }
+                }
+                else if (refcount - start == 1) {
+                    if (get_single_blobref_valref_value (lh,
+                                                         start,
+                                                         &stall) < 0)
                         goto error;
                     if (stall)
                         return LOOKUP_PROCESS_LOAD_MISSING_REFS;
                 }
                 else {
                     if (get_multi_blobref_valref_value (lh,
+                                                        start,
                                                         refcount,
                                                         &stall) < 0)
                         goto error;
                     if (stall)
                         return LOOKUP_PROCESS_LOAD_MISSING_REFS;
                 }
+                lh->blobcount = refcount;
             } else if (treeobj_is_dir (lh->wdirent)) {
                 if ((lh->flags & FLUX_KVS_READLINK)) {
                     lh->errnum = EINVAL;
@@ -1200,10 +1858,22 @@ lookup_process_t lookup (lookup_t *lh)
                     lh->errnum = ENOTDIR;
                     goto error;
                 }
-                if (!(lh->val = treeobj_deep_copy (lh->wdirent))) {
+                /* FLUX_KVS_WATCH_APPEND - an append converts a val to
+                 * a valref, with the val as its first blob.
+                 */
+                if (lh->append_offset > 1) {
+                    lh->errnum = EINVAL;
+                    goto error;
+                }
+                if (lh->append_offset == 1)
+                    lh->val = treeobj_create_val (NULL, 0);
+                else
+                    lh->val = treeobj_deep_copy (lh->wdirent);
+                if (!lh->val) {
                     lh->errnum = errno;
                     goto error;
                 }
+                lh->blobcount = 1;
             } else if (treeobj_is_symlink (lh->wdirent)) {
                 /* this should be "impossible" */
                 if (!(lh->flags & FLUX_KVS_READLINK)) {
@@ -1228,6 +1898,12 @@ lookup_process_t lookup (lookup_t *lh)
             }
             /* val now contains the requested object (copied) */
             break;
+        case LOOKUP_STATE_SUBTREE:
+            if (is_replay) {
+                if (namespace_still_valid (lh) < 0)
+                    goto error;
+            }
+            goto subtree;
         case LOOKUP_STATE_FINISHED:
             break;
         default:
@@ -1238,6 +1914,39 @@ lookup_process_t lookup (lookup_t *lh)
     }
 
 done:
+    /* With FLUX_KVS_READDIR_RECURSIVE, lh->val is the top directory.
+     * Walk the subtree below it, handing each directory to the caller
+     * via lookup_next_subtree() as soon as it is resolved.
+     */
+    if ((lh->flags & FLUX_KVS_READDIR_RECURSIVE)
+        && lh->state != LOOKUP_STATE_FINISHED
+        && lh->val) {
+        struct subtree_dir *sd;
+
+        if (!(sd = subtree_dir_create (lh->path, NULL, lh->val, 0))) {
+            lh->errnum = errno;
+            goto error;
+        }
+        if (zlist_append (lh->subtree_pending, sd) < 0) {
+            subtree_dir_destroy (sd);
+            lh->errnum = ENOMEM;
+            goto error;
+        }
+        lh->state = LOOKUP_STATE_SUBTREE;
+        goto subtree;
+    }
+    lh->state = LOOKUP_STATE_FINISHED;
+    return LOOKUP_PROCESS_FINISHED;
+
+subtree:
+    {
+        lookup_process_t sret = subtree_process (lh);
+
+        if (sret == LOOKUP_PROCESS_ERROR)
+            goto error;
+        else if (sret == LOOKUP_PROCESS_LOAD_MISSING_REFS)
+            return LOOKUP_PROCESS_LOAD_MISSING_REFS;
+    }
     lh->state = LOOKUP_STATE_FINISHED;
     return LOOKUP_PROCESS_FINISHED;
 
@@ -110,6 +110,36 @@ int lookup_get_root_seq (lookup_t *lh);
  * be new */
 int lookup_set_current_epoch (lookup_t *lh, int epoch);
 
+/* Limit a FLUX_KVS_READDIR_RECURSIVE lookup to 'maxdepth' levels below
+ * the requested directory (< 0 for unlimited), and drop non-directory
+ * entries whose names do not match fnmatch(3) 'pattern' (NULL for all).
+ * Must be called before the first call to lookup().
+ */
+int lookup_set_subtree (lookup_t *lh, int maxdepth, const char *pattern);
+
+/* For FLUX_KVS_WATCH_APPEND, return only the data appended to the value
+ * after its first 'offset' blobs.  A val counts as one blob.  The lookup
+ * fails with EINVAL if the value has fewer than 'offset' blobs.  Must be
+ * called before the first call to lookup().
+ */
+int lookup_set_append_offset (lookup_t *lh, int offset);
+
+/* Get the number of blobs in the value, to be used as the append offset
+ * of the next lookup.  Only valid after a successful value lookup with
+ * an append offset set.
+ */
+int lookup_get_blobcount (lookup_t *lh);
+
+/* Get the next directory resolved by a FLUX_KVS_READDIR_RECURSIVE
+ * lookup.  Directories become available as lookup() makes progress,
+ * including when it stalls, so the caller should drain them after
+ * every call to lookup().  The requested directory comes first.  The
+ * directory's key is assigned to 'key', which the caller must free.
+ * The json object returned gives a reference to the caller.
+ * Returns NULL with errno set to ENOENT if no directory is ready.
+ */
+json_t *lookup_next_subtree (lookup_t *lh, char **key);
+
 /* Lookup the key path in the KVS cache starting at root.
  *
  * Returns LOOKUP_PROCESS_ERROR on error,
@@ -16,6 +16,7 @@
 
 #include "src/common/libkvs/treeobj.h"
 #include "src/common/libutil/tstat.h"
+#include "src/common/libutil/blobz.h"
 #include "src/common/libtap/tap.h"
 #include "src/modules/kvs/waitqueue.h"
 #include "src/modules/kvs/cache.h"
@@ -254,6 +255,66 @@ void cache_entry_raw_tests (void)
     free (data);
 }
 
+void cache_entry_raw_compressed_tests (void)
+{
+    struct cache_entry *e;
+    json_t *o;
+    char *s;
+    void *zdata;
+    int zlen;
+    const char *datatmp;
+    int len;
+    char other[] = "not the same data";
+
+    /* a directory large enough to be worth compressing */
+    if (!(o = treeobj_create_dir ()))
+        BAIL_OUT ("treeobj_create_dir failed");
+    for (len = 0; len < 64; len++) {
+        char name[16];
+        json_t *val = treeobj_create_val ("value", 5);
+        snprintf (name, sizeof (name), "key%d", len);
+        if (!val || treeobj_insert_entry (o, name, val) < 0)
+            BAIL_OUT ("treeobj_insert_entry failed");
+        json_decref (val);
+    }
+    if (!(s = treeobj_encode (o)))
+        BAIL_OUT ("treeobj_encode failed");
+    if (blobz_compress (s, strlen (s), &zdata, &zlen) != 1)
+        BAIL_OUT ("blobz_compress failed");
+
+    ok ((e = cache_entry_create ("a-reference")) != NULL,
+        "cache_entry_create works");
+    ok (cache_entry_set_raw_compressed (e, NULL, 0) < 0 && errno == EINVAL,
+        "cache_entry_set_raw_compressed data=NULL fails with EINVAL");
+    ok (cache_entry_set_raw_compressed (e, zdata, zlen) == 0,
+        "cache_entry_set_raw_compressed works");
+    ok (cache_entry_get_valid (e) == true,
+        "cache entry now valid");
+    ok (cache_entry_set_raw (e, s, strlen (s)) == 0,
+        "cache_entry_set_raw of uncompressed data, silent success");
+    ok (cache_entry_set_raw (e, other, strlen (other)) < 0 && errno == EBADE,
+        "cache_entry_set_raw of different data fails with EBADE");
+    ok (cache_entry_get_raw (e, (const void **)&datatmp, &len) == 0
+        && len == strlen (s) && memcmp (datatmp, s, len) == 0,
+        "cache_entry_get_raw returns decompressed data");
+    cache_entry_destroy (e);
+
+    ok ((e = cache_entry_create ("a-reference")) != NULL,
+        "cache_entry_create works");
+    ok (cache_entry_set_raw_compressed (e, zdata, zlen) == 0,
+        "cache_entry_set_raw_compressed works");
+    ok (cache_entry_get_treeobj (e) != NULL
+        && json_equal ((json_t *)cache_entry_get_treeobj (e), o),
+        "cache_entry_get_treeobj decodes compressed data");
+    ok (cache_entry_set_raw_compressed (e, zdata, zlen) == 0,
+        "cache_entry_set_raw_compressed again, silent success");
+    cache_entry_destroy (e);
+
+    free (zdata);
+    free (s);
+    json_decref (o);
+}
+
 void cache_entry_raw_and_treeobj_tests (void)
 {
     struct cache_entry *e;
@@ -664,6 +725,80 @@ void cache_expiration_tests (void)
     cache_destroy (cache);
 }
 
+void cache_store_tests (void)
+{
+    struct cache *cache;
+    struct cache_entry *e1, *e2;
+    const void *data;
+    int len;
+
+    ok ((cache = cache_create ()) != NULL,
+        "cache_create works");
+
+    ok (cache_store (cache, "sha1-abc", "data", 4, 1, &e1) == 1,
+        "cache_store of new ref returns 1");
+    ok (cache_count_entries (cache) == 1,
+        "cache contains 1 entry");
+    ok (cache_entry_get_valid (e1) == true,
+        "stored entry is valid");
+    ok (cache_entry_get_dirty (e1) == true,
+        "stored entry is dirty");
+    ok (cache_entry_get_raw (e1, &data, &len) == 0
+        && len == 4 && memcmp (data, "data", 4) == 0,
+        "stored entry has raw data");
+    ok (cache_store (cache, "sha1-abc", "data", 4, 2, &e2) == 0,
+        "cache_store of valid ref returns 0");
+    ok (e1 == e2,
+        "cache_store returned same entry");
+    ok (cache_store (cache, "sha1-abc", NULL, 4, 2, &e2) < 0
+        && errno == EINVAL,
+        "cache_store fails with EINVAL on bad input");
+
+    ok (cache_remove_entry (cache, "sha1-abc") == 0,
+        "cache_remove_entry does not remove dirty entry");
+    ok (cache_entry_set_dirty (e1, false) == 0,
+        "cache_entry_set_dirty false works");
+    ok (cache_remove_entry (cache, "sha1-abc") == 1,
+        "cache_remove_entry removes clean entry");
+
+    cache_destroy (cache);
+}
+
+void cache_parallel_tests (void)
+{
+    struct cache *cache;
+    struct cache_entry *e1, *e2;
+    wait_t *w;
+    int count = 0;
+
+    ok ((cache = cache_create ()) != NULL,
+        "cache_create works");
+    ok ((e1 = cache_entry_create ("sha1-abc")) != NULL,
+        "cache_entry_create works");
+    ok (cache_insert (cache, e1) == 0,
+        "cache_insert works");
+    ok ((w = wait_create (wait_cb, &count)) != NULL,
+        "wait_create works");
+    ok (cache_entry_wait_valid (e1, w) == 0,
+        "cache_entry_wait_valid works");
+
+    cache_parallel_begin (cache);
+    ok (cache_store (cache, "sha1-abc", "data", 4, 1, &e2) == 1
+        && e1 == e2,
+        "cache_store in parallel section fills invalid entry");
+    ok (count == 0,
+        "waiter is not run inside parallel section");
+    ok (cache_parallel_end (cache) == 0,
+        "cache_parallel_end works");
+    ok (count == 1,
+        "waiter is run by cache_parallel_end");
+
+    ok (cache_parallel_end (cache) == 0,
+        "cache_parallel_end with nothing deferred works");
+
+    cache_destroy (cache);
+}
+
 int main (int argc, char *argv[])
 {
     plan (NO_PLAN);
@@ -671,11 +806,14 @@ int main (int argc, char *argv[])
     cache_tests ();
     cache_entry_basic_tests ();
     cache_entry_raw_tests ();
+    cache_entry_raw_compressed_tests ();
     cache_entry_raw_and_treeobj_tests ();
     waiter_tests ();
     cache_expiration_tests ();
     cache_blobref_tests ();
     cache_remove_entry_tests ();
+    cache_store_tests ();
+    cache_parallel_tests ();
 
     done_testing ();
     return (0);
@@ -0,0 +1,199 @@
+/************************************************************\
+ * Copyright 2018 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <jansson.h>
+
+#include "src/common/libkvs/treeobj.h"
+#include "src/common/libutil/blobref.h"
+#include "src/common/libtap/tap.h"
+#include "src/modules/kvs/waitqueue.h"
+#include "src/modules/kvs/cache.h"
+#include "src/modules/kvs/checkpoint.h"
+
+/* Store treeobj 'o' in 'cache' and return its blobref in 'ref'.
+ * Steals the reference on 'o'.
+ */
+static void cache_insert_treeobj (struct cache *cache, json_t *o,
+                                  char *ref, int ref_len)
+{
+    struct cache_entry *entry;
+    char *s;
+
+    if (!(s = treeobj_encode (o)))
+        BAIL_OUT ("treeobj_encode failed");
+    if (blobref_hash ("sha1", (uint8_t *)s, strlen (s), ref, ref_len) < 0)
+        BAIL_OUT ("blobref_hash failed");
+    if (!(entry = cache_entry_create (ref))
+            || cache_entry_set_raw (entry, s, strlen (s)) < 0
+            || cache_insert (cache, entry) < 0)
+        BAIL_OUT ("could not insert cache entry");
+    free (s);
+    json_decref (o);
+}
+
+static bool cache_has_valid (struct cache *cache, const char *ref)
+{
+    struct cache_entry *entry = cache_lookup (cache, ref, 0);
+    return entry && cache_entry_get_valid (entry);
+}
+
+void checkpoint_encode_tests (void)
+{
+    char rootref[BLOBREF_MAX_STRING_SIZE];
+    char imageref[BLOBREF_MAX_STRING_SIZE];
+    char small[8];
+    int seq;
+    char *s;
+
+    ok (checkpoint_encode (NULL, 1, NULL) == NULL && errno == EINVAL,
+        "checkpoint_encode fails with EINVAL on NULL rootref");
+    ok (checkpoint_encode ("sha1-abc", -1, NULL) == NULL && errno == EINVAL,
+        "checkpoint_encode fails with EINVAL on negative seq");
+
+    ok ((s = checkpoint_encode ("sha1-abc", 42, "sha1-def")) != NULL,
+        "checkpoint_encode works");
+    ok (checkpoint_decode (s, rootref, sizeof (rootref), &seq,
+                           imageref, sizeof (imageref)) == 0,
+        "checkpoint_decode works");
+    ok (!strcmp (rootref, "sha1-abc") && seq == 42
+        && !strcmp (imageref, "sha1-def"),
+        "checkpoint_decode returned encoded values");
+    errno = 0;
+    ok (checkpoint_decode (s, small, sizeof (small), &seq,
+                           imageref, sizeof (imageref)) < 0
+        && errno == EINVAL,
+        "checkpoint_decode fails with EINVAL on short buffer");
+    free (s);
+
+    ok ((s = checkpoint_encode ("sha1-abc", 0, NULL)) != NULL,
+        "checkpoint_encode works with no image");
+    ok (checkpoint_decode (s, rootref, sizeof (rootref), &seq,
+                           imageref, sizeof (imageref)) == 0
+        && seq == 0 && strlen (imageref) == 0,
+        "checkpoint_decode returned empty imageref");
+    free (s);
+
+    errno = 0;
+    ok (checkpoint_decode ("{\"version\":1}", rootref, sizeof (rootref),
+                           &seq, imageref, sizeof (imageref)) < 0
+        && errno == EPROTO,
+        "checkpoint_decode fails with EPROTO on missing rootref");
+    errno = 0;
+    ok (checkpoint_decode ("{\"version\":2,\"rootref\":\"sha1-abc\","
+                           "\"sequence\":1}",
+                           rootref, sizeof (rootref),
+                           &seq, imageref, sizeof (imageref)) < 0
+        && errno == EPROTO,
+        "checkpoint_decode fails with EPROTO on unknown version");
+    errno = 0;
+    ok (checkpoint_decode ("not json", rootref, sizeof (rootref),
+                           &seq, imageref, sizeof (imageref)) < 0
+        && errno == EPROTO,
+        "checkpoint_decode fails with EPROTO on bad JSON");
+}
+
+void checkpoint_image_tests (void)
+{
+    struct cache *cache, *cache2;
+    char rootref[BLOBREF_MAX_STRING_SIZE];
+    char dir1ref[BLOBREF_MAX_STRING_SIZE];
+    char dir2ref[BLOBREF_MAX_STRING_SIZE];
+    const char *missingref = "sha1-f1d2d2f924e986ac86fdf7b36c94bcdf32beec15";
+    json_t *dir;
+    void *buf;
+    int len;
+
+    if (!(cache = cache_create ()) || !(cache2 = cache_create ()))
+        BAIL_OUT ("cache_create failed");
+
+    /* root
+     *   val = "foo"
+     *   dir1 -> { dir2 -> { val = "bar" } }
+     *   dir3 -> (not in cache)
+     */
+    dir = treeobj_create_dir ();
+    treeobj_insert_entry (dir, "val", treeobj_create_val ("bar", 3));
+    cache_insert_treeobj (cache, dir, dir2ref, sizeof (dir2ref));
+
+    dir = treeobj_create_dir ();
+    treeobj_insert_entry (dir, "dir2", treeobj_create_dirref (dir2ref));
+    cache_insert_treeobj (cache, dir, dir1ref, sizeof (dir1ref));
+
+    dir = treeobj_create_dir ();
+    treeobj_insert_entry (dir, "val", treeobj_create_val ("foo", 3));
+    treeobj_insert_entry (dir, "dir1", treeobj_create_dirref (dir1ref));
+    treeobj_insert_entry (dir, "dir3", treeobj_create_dirref (missingref));
+    cache_insert_treeobj (cache, dir, rootref, sizeof (rootref));
+
+    ok (checkpoint_image_pack (NULL, rootref, 4096, &buf, &len) < 0
+        && errno == EINVAL,
+        "checkpoint_image_pack fails with EINVAL on NULL cache");
+    ok (checkpoint_image_pack (cache, rootref, 0, &buf, &len) < 0
+        && errno == EINVAL,
+        "checkpoint_image_pack fails with EINVAL on tiny maxsize");
+
+    ok (checkpoint_image_pack (cache, rootref, 4096, &buf, &len) == 3,
+        "checkpoint_image_pack packed 3 cached directories");
+    ok (checkpoint_image_unpack (cache2, "sha1", buf, len, 1) == 3,
+        "checkpoint_image_unpack inserted 3 entries");
+    ok (cache_has_valid (cache2, rootref)
+        && cache_has_valid (cache2, dir1ref)
+        && cache_has_valid (cache2, dir2ref),
+        "root, dir1, and dir2 are valid in new cache");
+    ok (checkpoint_image_unpack (cache2, "sha1", buf, len, 1) == 0,
+        "checkpoint_image_unpack skips entries already cached");
+
+    ((uint8_t *)buf)[0] ^= 0xff;
+    errno = 0;
+    ok (checkpoint_image_unpack (cache2, "sha1", buf, len, 1) < 0
+        && errno == EPROTO,
+        "checkpoint_image_unpack fails with EPROTO on bad magic");
+    ((uint8_t *)buf)[0] ^= 0xff;
+    errno = 0;
+    ok (checkpoint_image_unpack (cache2, "sha1", buf, len - 1, 1) < 0
+        && errno == EPROTO,
+        "checkpoint_image_unpack fails with EPROTO on truncated image");
+    free (buf);
+
+    ok (checkpoint_image_pack (cache, rootref, 12, &buf, &len) == 0
+        && len == 12,
+        "checkpoint_image_pack stops at maxsize");
+    ok (checkpoint_image_unpack (cache2, "sha1", buf, len, 1) == 0,
+        "checkpoint_image_unpack accepts an empty image");
+    free (buf);
+
+    ok (checkpoint_image_pack (cache, dir2ref, 4096, &buf, &len) == 1,
+        "checkpoint_image_pack of leaf directory packed 1 directory");
+    free (buf);
+
+    cache_destroy (cache);
+    cache_destroy (cache2);
+}
+
+int main (int argc, char *argv[])
+{
+    plan (NO_PLAN);
+
+    checkpoint_encode_tests ();
+    checkpoint_image_tests ();
+
+    done_testing ();
+    return (0);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
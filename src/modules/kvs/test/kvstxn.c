@@ -410,6 +410,85 @@ void clear_ready_kvstxns (kvstxn_mgr_t *ktm)
         kvstxn_mgr_remove_transaction (ktm, kt, false);
 }
 
+void kvstxn_mgr_merge_window_tests (void)
+{
+    struct cache *cache;
+    json_t *ops = NULL;
+    kvstxn_mgr_t *ktm;
+    kvstxn_t *kt;
+    char rootref[BLOBREF_MAX_STRING_SIZE];
+    char name[64];
+    double delay;
+    int i;
+
+    cache = create_cache_with_empty_rootdir (rootref, sizeof (rootref));
+
+    ok ((ktm = kvstxn_mgr_create (cache,
+                                  KVS_PRIMARY_NAMESPACE,
+                                  "sha1",
+                                  NULL,
+                                  &test_global)) != NULL,
+        "kvstxn_mgr_create works");
+
+    ok (kvstxn_mgr_merge_target (ktm) == 1,
+        "kvstxn_mgr_merge_target is 1 with no merge window");
+
+    create_ready_kvstxn (ktm, "transaction1", "key1", "1", 0, 0);
+
+    ok (kvstxn_mgr_merge_delay (ktm) == 0,
+        "kvstxn_mgr_merge_delay is 0 with no merge window");
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL
+        && kvstxn_get_age (kt) >= 0,
+        "kvstxn_get_age works");
+
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    kvstxn_mgr_set_merge_window (ktm, 60., 16);
+
+    ok (kvstxn_mgr_merge_target (ktm) == 1,
+        "kvstxn_mgr_merge_target is initially 1 with merge window");
+
+    /* a burst of transactions grows the target batch size */
+    ops = json_array ();
+    ops_append (ops, "key1", "1", 0);
+    for (i = 0; i < 40; i++) {
+        snprintf (name, sizeof (name), "burst%d", i);
+        if (kvstxn_mgr_add_transaction (ktm, name, ops, 0) < 0)
+            break;
+    }
+    json_decref (ops);
+    ok (i == 40,
+        "kvstxn_mgr_add_transaction added 40 transactions");
+
+    ok (kvstxn_mgr_merge_target (ktm) == 16,
+        "kvstxn_mgr_merge_target grew to the max batch size");
+
+    ok (kvstxn_mgr_merge_delay (ktm) == 0,
+        "kvstxn_mgr_merge_delay is 0 when target batch size is ready");
+
+    for (i = 0; i < 35; i++) {
+        if (!(kt = kvstxn_mgr_get_ready_transaction (ktm)))
+            break;
+        kvstxn_mgr_remove_transaction (ktm, kt, false);
+    }
+    ok (kvstxn_mgr_ready_transaction_count (ktm) == 5,
+        "removed 35 transactions");
+
+    delay = kvstxn_mgr_merge_delay (ktm);
+    ok (delay > 0 && delay <= 60.,
+        "kvstxn_mgr_merge_delay holds transactions below target batch size");
+
+    kvstxn_mgr_set_merge_window (ktm, 0, 16);
+
+    ok (kvstxn_mgr_merge_delay (ktm) == 0
+        && kvstxn_mgr_merge_target (ktm) == 1,
+        "merge window can be disabled");
+
+    kvstxn_mgr_destroy (ktm);
+    cache_destroy (cache);
+}
+
 void kvstxn_mgr_merge_tests (void)
 {
     struct cache *cache;
@@ -2729,6 +2808,129 @@ void kvstxn_process_giant_dir (void)
     json_decref (root);
 }
 
+/* Commit enough keys to one directory that it is split into an hdir,
+ * then verify that a single key update only rewrites one shard.
+ */
+void kvstxn_process_sharded_dir (void)
+{
+    struct cache *cache;
+    struct cache_entry *entry;
+    kvsroot_mgr_t *krm;
+    kvstxn_mgr_t *ktm;
+    kvstxn_t *kt;
+    lookup_t *lh;
+    json_t *ops, *o;
+    const json_t *root, *dirref, *dir;
+    char rootref[BLOBREF_MAX_STRING_SIZE];
+    char dirroot[BLOBREF_MAX_STRING_SIZE];
+    char key[64], val[64];
+    const char *newroot, *ref;
+    int count, i;
+
+    cache = create_cache_with_empty_rootdir (rootref, sizeof (rootref));
+
+    ok ((krm = kvsroot_mgr_create (NULL, NULL)) != NULL,
+        "kvsroot_mgr_create works");
+
+    setup_kvsroot (krm, KVS_PRIMARY_NAMESPACE, cache, rootref);
+
+    ok ((ktm = kvstxn_mgr_create (cache,
+                                  KVS_PRIMARY_NAMESPACE,
+                                  "sha1",
+                                  NULL,
+                                  &test_global)) != NULL,
+        "kvstxn_mgr_create works");
+
+    ops = json_array ();
+    for (i = 0; i < 1000; i++) {
+        snprintf (key, sizeof (key), "dir.key%d", i);
+        snprintf (val, sizeof (val), "%d", i);
+        ops_append (ops, key, val, 0);
+    }
+    ok (kvstxn_mgr_add_transaction (ktm, "transaction1", ops, 0) == 0,
+        "kvstxn_mgr_add_transaction works with 1000 keys");
+    json_decref (ops);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+    ok (kvstxn_process (kt, 1, rootref) == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES,
+        "kvstxn_process returns KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES");
+    count = 0;
+    ok (kvstxn_iter_dirty_cache_entries (kt, cache_count_dirty_cb, &count) == 0,
+        "kvstxn_iter_dirty_cache_entries works for dirty cache entries");
+    ok (count > 3,
+        "dir was stored as %d objects", count);
+    ok (kvstxn_process (kt, 1, rootref) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+    ok ((newroot = kvstxn_get_newroot_ref (kt)) != NULL,
+        "kvstxn_get_newroot_ref returns != NULL when processing complete");
+
+    ok ((entry = cache_lookup (cache, newroot, 1)) != NULL
+        && (root = cache_entry_get_treeobj (entry)) != NULL
+        && (dirref = treeobj_peek_entry (root, "dir")) != NULL
+        && treeobj_is_dirref (dirref)
+        && (ref = treeobj_get_blobref (dirref, 0)) != NULL
+        && (entry = cache_lookup (cache, ref, 1)) != NULL
+        && (dir = cache_entry_get_treeobj (entry)) != NULL
+        && treeobj_is_hdir (dir),
+        "dir was stored as an hdir");
+
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key0", "0");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key500", "500");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key999", "999");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.nokey", NULL);
+
+    ok ((lh = lookup_create (cache,
+                             krm,
+                             1,
+                             KVS_PRIMARY_NAMESPACE,
+                             newroot,
+                             0,
+                             "dir",
+                             FLUX_ROLE_OWNER,
+                             0,
+                             FLUX_KVS_READDIR,
+                             NULL)) != NULL,
+        "lookup_create dir works");
+    ok (lookup (lh) == LOOKUP_PROCESS_FINISHED,
+        "lookup found result");
+    ok ((o = lookup_get_value (lh)) != NULL
+        && treeobj_is_dir (o)
+        && treeobj_get_count (o) == 1000,
+        "readdir of hdir returns dir with all 1000 entries");
+    json_decref (o);
+    lookup_destroy (lh);
+
+    /* newroot is invalid after kvstxn is removed */
+    strcpy (dirroot, newroot);
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    create_ready_kvstxn (ktm, "transaction2", "dir.key500", "foo", 0, 0);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+    ok (kvstxn_process (kt, 1, dirroot) == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES,
+        "kvstxn_process returns KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES");
+    count = 0;
+    ok (kvstxn_iter_dirty_cache_entries (kt, cache_count_dirty_cb, &count) == 0,
+        "kvstxn_iter_dirty_cache_entries works for dirty cache entries");
+    ok (count == 3,
+        "single key update stored only root, hdir, and one shard");
+    ok (kvstxn_process (kt, 1, dirroot) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+    ok ((newroot = kvstxn_get_newroot_ref (kt)) != NULL,
+        "kvstxn_get_newroot_ref returns != NULL when processing complete");
+
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key500", "foo");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "dir.key501", "501");
+
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    kvstxn_mgr_destroy (ktm);
+    kvsroot_mgr_destroy (krm);
+    cache_destroy (cache);
+}
+
 void kvstxn_process_append (void)
 {
     struct cache *cache;
@@ -3120,6 +3322,166 @@ void kvstxn_process_fallback_merge (void)
     cache_destroy (cache);
 }
 
+void kvstxn_process_cow_reuse (void)
+{
+    struct cache *cache;
+    struct cache_entry *entry;
+    kvsroot_mgr_t *krm;
+    kvstxn_mgr_t *ktm;
+    kvstxn_t *kt;
+    json_t *root;
+    json_t *dira;
+    json_t *dirb;
+    json_t *ops;
+    const json_t *newrootdir;
+    json_t *o;
+    const char *ref;
+    char root_ref[BLOBREF_MAX_STRING_SIZE];
+    char dira_ref[BLOBREF_MAX_STRING_SIZE];
+    char dirb_ref[BLOBREF_MAX_STRING_SIZE];
+    const char *newroot;
+
+    ok ((cache = cache_create ()) != NULL,
+        "cache_create works");
+    ok ((krm = kvsroot_mgr_create (NULL, NULL)) != NULL,
+        "kvsroot_mgr_create works");
+
+    /* This root is
+     *
+     * root_ref
+     * "a" : dirref to dira_ref
+     * "b" : dirref to dirb_ref
+     *
+     * dira_ref
+     * "x" : val w/ "1"
+     *
+     * dirb_ref
+     * "y" : val w/ "2"
+     *
+     */
+
+    dira = treeobj_create_dir ();
+    _treeobj_insert_entry_val (dira, "x", "1", 1);
+
+    ok (treeobj_hash ("sha1", dira, dira_ref, sizeof (dira_ref)) == 0,
+        "treeobj_hash worked");
+
+    (void)cache_insert (cache, create_cache_entry_treeobj (dira_ref, dira));
+
+    dirb = treeobj_create_dir ();
+    _treeobj_insert_entry_val (dirb, "y", "2", 1);
+
+    ok (treeobj_hash ("sha1", dirb, dirb_ref, sizeof (dirb_ref)) == 0,
+        "treeobj_hash worked");
+
+    (void)cache_insert (cache, create_cache_entry_treeobj (dirb_ref, dirb));
+
+    root = treeobj_create_dir ();
+    _treeobj_insert_entry_dirref (root, "a", dira_ref);
+    _treeobj_insert_entry_dirref (root, "b", dirb_ref);
+
+    ok (treeobj_hash ("sha1", root, root_ref, sizeof (root_ref)) == 0,
+        "treeobj_hash worked");
+
+    (void)cache_insert (cache, create_cache_entry_treeobj (root_ref, root));
+
+    setup_kvsroot (krm, KVS_PRIMARY_NAMESPACE, cache, root_ref);
+
+    ok ((ktm = kvstxn_mgr_create (cache,
+                                  KVS_PRIMARY_NAMESPACE,
+                                  "sha1",
+                                  NULL,
+                                  &test_global)) != NULL,
+        "kvstxn_mgr_create works");
+
+    ok (kvstxn_mgr_get_reused_dirs (ktm) == 0,
+        "kvstxn_mgr_get_reused_dirs returns 0 initially");
+
+    /* delete of a nonexistent key walks "a" but changes nothing, so
+     * the current root is reused as is.
+     */
+    create_ready_kvstxn (ktm, "transaction1", "a.noexist", NULL, 0, 0);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+
+    ok (kvstxn_process (kt, 1, root_ref) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+
+    ok ((newroot = kvstxn_get_newroot_ref (kt)) != NULL,
+        "kvstxn_get_newroot_ref returns != NULL when processing complete");
+
+    ok (strcmp (newroot, root_ref) == 0,
+        "unmodified root is reused");
+
+    ok (kvstxn_mgr_get_reused_dirs (ktm) == 1,
+        "kvstxn_mgr_get_reused_dirs returns 1");
+
+    kvstxn_mgr_remove_transaction (ktm, kt, false);
+
+    /* change "a", walk "b" without changing it */
+    kvstxn_mgr_clear_reused_dirs (ktm);
+
+    ops = json_array ();
+    ops_append (ops, "a.x", "3", 0);
+    ops_append (ops, "b.noexist", NULL, 0);
+
+    ok (kvstxn_mgr_add_transaction (ktm, "transaction2", ops, 0) == 0,
+        "kvstxn_mgr_add_transaction works");
+
+    json_decref (ops);
+
+    ok ((kt = kvstxn_mgr_get_ready_transaction (ktm)) != NULL,
+        "kvstxn_mgr_get_ready_transaction returns ready kvstxn");
+
+    ok (kvstxn_process (kt, 1, root_ref) == KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES,
+        "kvstxn_process returns KVSTXN_PROCESS_DIRTY_CACHE_ENTRIES");
+
+    ok (kvstxn_iter_dirty_cache_entries (kt, cache_noop_cb, NULL) == 0,
+        "kvstxn_iter_dirty_cache_entries works for dirty cache entries");
+
+    ok (kvstxn_process (kt, 1, root_ref) == KVSTXN_PROCESS_FINISHED,
+        "kvstxn_process returns KVSTXN_PROCESS_FINISHED");
+
+    ok ((newroot = kvstxn_get_newroot_ref (kt)) != NULL,
+        "kvstxn_get_newroot_ref returns != NULL when processing complete");
+
+    ok (strcmp (newroot, root_ref) != 0,
+        "modified root has a new blobref");
+
+    ok (kvstxn_mgr_get_reused_dirs (ktm) == 1,
+        "kvstxn_mgr_get_reused_dirs returns 1");
+
+    ok ((entry = cache_lookup (cache, newroot, 1)) != NULL
+        && (newrootdir = cache_entry_get_treeobj (entry)) != NULL,
+        "new root is in the cache");
+
+    ok ((o = treeobj_get_entry ((json_t *)newrootdir, "b")) != NULL
+        && treeobj_is_dirref (o)
+        && (ref = treeobj_get_blobref (o, 0)) != NULL
+        && strcmp (ref, dirb_ref) == 0,
+        "unmodified dir b references its original blobref");
+
+    ok ((o = treeobj_get_entry ((json_t *)newrootdir, "a")) != NULL
+        && treeobj_is_dirref (o)
+        && (ref = treeobj_get_blobref (o, 0)) != NULL
+        && strcmp (ref, dira_ref) != 0,
+        "modified dir a has a new blobref");
+
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "a.x", "3");
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, newroot, "b.y", "2");
+
+    /* original directories in the cache are not modified */
+    verify_value (cache, krm, KVS_PRIMARY_NAMESPACE, root_ref, "a.x", "1");
+
+    kvstxn_mgr_destroy (ktm);
+    kvsroot_mgr_destroy (krm);
+    cache_destroy (cache);
+    json_decref (dira);
+    json_decref (dirb);
+    json_decref (root);
+}
+
 void kvstxn_namespace_prefix (void)
 {
     struct cache *cache;
@@ -3403,6 +3765,7 @@ int main (int argc, char *argv[])
 
     kvstxn_mgr_basic_tests ();
     kvstxn_mgr_merge_tests ();
+    kvstxn_mgr_merge_window_tests ();
     kvstxn_basic_tests ();
     kvstxn_basic_kvstxn_process_test ();
     kvstxn_basic_kvstxn_process_test_normalization ();
@@ -3431,9 +3794,11 @@ int main (int argc, char *argv[])
     kvstxn_process_bad_dirrefs ();
     kvstxn_process_big_fileval ();
     kvstxn_process_giant_dir ();
+    kvstxn_process_sharded_dir ();
     kvstxn_process_append ();
     kvstxn_process_append_errors ();
     kvstxn_process_fallback_merge ();
+    kvstxn_process_cow_reuse ();
     kvstxn_namespace_prefix ();
     kvstxn_namespace_prefix_symlink ();
 
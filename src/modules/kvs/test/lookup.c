@@ -3544,6 +3544,335 @@ void lookup_stall_namespace_prefix_in_symlink (void) {
     json_decref (rootB);
 }
 
+/* check next directory returned by FLUX_KVS_READDIR_RECURSIVE lookup */
+void check_next_subtree (lookup_t *lh, const char *key, json_t *expected,
+                         const char *msg)
+{
+    json_t *dir;
+    char *k = NULL;
+
+    ok ((dir = lookup_next_subtree (lh, &k)) != NULL,
+        "%s: lookup_next_subtree returns a directory", msg);
+    ok (k != NULL && strcmp (k, key) == 0,
+        "%s: lookup_next_subtree returns key %s", msg, key);
+    ok (dir != NULL && json_equal (dir, expected) == true,
+        "%s: lookup_next_subtree returns expected directory", msg);
+    free (k);
+    json_decref (dir);
+}
+
+/* FLUX_KVS_READDIR_RECURSIVE tests */
+void lookup_subtree (void) {
+    json_t *root;
+    json_t *dir1;
+    json_t *dir2;
+    json_t *expected1;
+    json_t *expected2;
+    json_t *dir;
+    struct cache *cache;
+    kvsroot_mgr_t *krm;
+    lookup_t *lh;
+    char *key;
+    char valref_ref[BLOBREF_MAX_STRING_SIZE];
+    char dir1_ref[BLOBREF_MAX_STRING_SIZE];
+    char dir2_ref[BLOBREF_MAX_STRING_SIZE];
+    char root_ref[BLOBREF_MAX_STRING_SIZE];
+
+    ok ((cache = cache_create ()) != NULL,
+        "cache_create works");
+    ok ((krm = kvsroot_mgr_create (NULL, NULL)) != NULL,
+        "kvsroot_mgr_create works");
+
+    /* This cache is
+     *
+     * valref_ref
+     * "abcd"
+     *
+     * dir2_ref
+     * "val" : val to "bar"
+     *
+     * dir1_ref
+     * "val" : val to "foo"
+     * "valref" : valref to valref_ref
+     * "dir2" : dirref to dir2_ref
+     * "link" : symlink to "val"
+     *
+     * root_ref
+     * "dir1" : dirref to dir1_ref
+     */
+
+    blobref_hash ("sha1", "abcd", 4, valref_ref, sizeof (valref_ref));
+
+    dir2 = treeobj_create_dir ();
+    _treeobj_insert_entry_val (dir2, "val", "bar", 3);
+    treeobj_hash ("sha1", dir2, dir2_ref, sizeof (dir2_ref));
+
+    dir1 = treeobj_create_dir ();
+    _treeobj_insert_entry_val (dir1, "val", "foo", 3);
+    _treeobj_insert_entry_valref (dir1, "valref", valref_ref);
+    _treeobj_insert_entry_dirref (dir1, "dir2", dir2_ref);
+    _treeobj_insert_entry_symlink (dir1, "link", "val");
+    treeobj_hash ("sha1", dir1, dir1_ref, sizeof (dir1_ref));
+
+    root = treeobj_create_dir ();
+    _treeobj_insert_entry_dirref (root, "dir1", dir1_ref);
+    treeobj_hash ("sha1", root, root_ref, sizeof (root_ref));
+
+    /* dir1 as returned, with valref resolved */
+    expected1 = treeobj_create_dir ();
+    _treeobj_insert_entry_val (expected1, "val", "foo", 3);
+    _treeobj_insert_entry_val (expected1, "valref", "abcd", 4);
+    _treeobj_insert_entry_dirref (expected1, "dir2", dir2_ref);
+    _treeobj_insert_entry_symlink (expected1, "link", "val");
+
+    expected2 = treeobj_create_dir ();
+    _treeobj_insert_entry_val (expected2, "val", "bar", 3);
+
+    setup_kvsroot (krm, KVS_PRIMARY_NAMESPACE, cache, root_ref, 0);
+
+    (void)cache_insert (cache, create_cache_entry_treeobj (root_ref, root));
+
+    /* errors */
+    errno = 0;
+    ok (lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                       "dir1", FLUX_ROLE_OWNER, 0,
+                       FLUX_KVS_READDIR_RECURSIVE, NULL) == NULL
+        && errno == EINVAL,
+        "lookup_create fails on FLUX_KVS_READDIR_RECURSIVE w/o READDIR");
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "dir1", FLUX_ROLE_OWNER, 0,
+                             FLUX_KVS_READDIR, NULL)) != NULL,
+        "lookup_create works");
+    errno = 0;
+    ok (lookup_set_subtree (lh, -1, NULL) < 0 && errno == EINVAL,
+        "lookup_set_subtree fails w/o FLUX_KVS_READDIR_RECURSIVE");
+    errno = 0;
+    ok (lookup_next_subtree (lh, &key) == NULL && errno == EINVAL,
+        "lookup_next_subtree fails w/o FLUX_KVS_READDIR_RECURSIVE");
+    lookup_destroy (lh);
+
+    /* walk subtree, stalling on each missing ref */
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "dir1", FLUX_ROLE_OWNER, 0,
+                             FLUX_KVS_READDIR | FLUX_KVS_READDIR_RECURSIVE,
+                             NULL)) != NULL,
+        "lookup_create subtree dir1");
+    check_stall (lh, EAGAIN, 1, dir1_ref, "subtree dir1 stall");
+    (void)cache_insert (cache, create_cache_entry_treeobj (dir1_ref, dir1));
+
+    check_stall (lh, EAGAIN, 1, valref_ref, "subtree valref stall");
+    errno = 0;
+    ok (lookup_next_subtree (lh, &key) == NULL && errno == ENOENT,
+        "lookup_next_subtree returns ENOENT while dir1 is stalled");
+    (void)cache_insert (cache, create_cache_entry_raw (valref_ref, "abcd", 4));
+
+    check_stall (lh, EAGAIN, 1, dir2_ref, "subtree dir2 stall");
+    check_next_subtree (lh, "dir1", expected1, "subtree dir1");
+    (void)cache_insert (cache, create_cache_entry_treeobj (dir2_ref, dir2));
+
+    ok (lookup (lh) == LOOKUP_PROCESS_FINISHED,
+        "subtree: lookup finished");
+    check_next_subtree (lh, "dir1.dir2", expected2, "subtree dir1.dir2");
+    errno = 0;
+    ok (lookup_next_subtree (lh, &key) == NULL && errno == ENOENT,
+        "lookup_next_subtree returns ENOENT when done");
+    lookup_destroy (lh);
+
+    /* fully cached, depth limited */
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "dir1", FLUX_ROLE_OWNER, 0,
+                             FLUX_KVS_READDIR | FLUX_KVS_READDIR_RECURSIVE,
+                             NULL)) != NULL,
+        "lookup_create subtree dir1");
+    ok (lookup_set_subtree (lh, 0, NULL) == 0,
+        "lookup_set_subtree maxdepth=0 works");
+    ok (lookup (lh) == LOOKUP_PROCESS_FINISHED,
+        "subtree maxdepth=0: lookup finished");
+    check_next_subtree (lh, "dir1", expected1, "subtree maxdepth=0");
+    ok (lookup_next_subtree (lh, &key) == NULL,
+        "subtree maxdepth=0: no subdirectories returned");
+    lookup_destroy (lh);
+
+    /* fully cached, filtered */
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             ".", FLUX_ROLE_OWNER, 0,
+                             FLUX_KVS_READDIR | FLUX_KVS_READDIR_RECURSIVE,
+                             NULL)) != NULL,
+        "lookup_create subtree .");
+    ok (lookup_set_subtree (lh, -1, "v*") == 0,
+        "lookup_set_subtree pattern=v* works");
+    ok (lookup (lh) == LOOKUP_PROCESS_FINISHED,
+        "subtree pattern: lookup finished");
+    check_next_subtree (lh, ".", root, "subtree pattern root");
+    ok ((dir = lookup_next_subtree (lh, &key)) != NULL
+        && !strcmp (key, "dir1")
+        && treeobj_peek_entry (dir, "link") == NULL
+        && treeobj_peek_entry (dir, "valref") != NULL
+        && treeobj_peek_entry (dir, "dir2") != NULL,
+        "subtree pattern: dir1 entries not matching v* are dropped");
+    free (key);
+    json_decref (dir);
+    check_next_subtree (lh, "dir1.dir2", expected2, "subtree pattern dir2");
+    lookup_destroy (lh);
+
+    /* not a directory */
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "dir1.val", FLUX_ROLE_OWNER, 0,
+                             FLUX_KVS_READDIR | FLUX_KVS_READDIR_RECURSIVE,
+                             NULL)) != NULL,
+        "lookup_create subtree dir1.val");
+    check_error (lh, ENOTDIR, "subtree dir1.val");
+
+    cache_destroy (cache);
+    kvsroot_mgr_destroy (krm);
+    json_decref (root);
+    json_decref (dir1);
+    json_decref (dir2);
+    json_decref (expected1);
+    json_decref (expected2);
+}
+
+/* lookup 'key' with append offset 'offset', expecting 'data' and
+ * 'blobcount' in return */
+void check_append (struct cache *cache, kvsroot_mgr_t *krm, const char *key,
+                   int offset, const char *data, int blobcount,
+                   const char *msg)
+{
+    lookup_t *lh;
+    json_t *val = NULL;
+    json_t *test;
+
+    test = treeobj_create_val (data, strlen (data));
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             key, FLUX_ROLE_OWNER, 0, 0, NULL)) != NULL,
+        "%s: lookup_create works", msg);
+    ok (lookup_set_append_offset (lh, offset) == 0,
+        "%s: lookup_set_append_offset %d works", msg, offset);
+    ok (lookup (lh) == LOOKUP_PROCESS_FINISHED,
+        "%s: lookup finished", msg);
+    ok ((val = lookup_get_value (lh)) != NULL
+        && json_equal (val, test) == true,
+        "%s: lookup_get_value returns \"%s\"", msg, data);
+    ok (lookup_get_blobcount (lh) == blobcount,
+        "%s: lookup_get_blobcount returns %d", msg, blobcount);
+    json_decref (val);
+    json_decref (test);
+    lookup_destroy (lh);
+}
+
+/* FLUX_KVS_WATCH_APPEND tests */
+void lookup_append_offset (void) {
+    json_t *root;
+    struct cache *cache;
+    kvsroot_mgr_t *krm;
+    lookup_t *lh;
+    json_t *test;
+    char ref1[BLOBREF_MAX_STRING_SIZE];
+    char ref2[BLOBREF_MAX_STRING_SIZE];
+    char ref3[BLOBREF_MAX_STRING_SIZE];
+    char root_ref[BLOBREF_MAX_STRING_SIZE];
+
+    ok ((cache = cache_create ()) != NULL,
+        "cache_create works");
+    ok ((krm = kvsroot_mgr_create (NULL, NULL)) != NULL,
+        "kvsroot_mgr_create works");
+
+    /* This cache is
+     *
+     * ref1, ref2, ref3
+     * "abcd", "efgh", "ijkl"
+     *
+     * root_ref
+     * "log" : valref to [ ref1, ref2, ref3 ]
+     * "val" : val to "foo"
+     */
+
+    blobref_hash ("sha1", "abcd", 4, ref1, sizeof (ref1));
+    blobref_hash ("sha1", "efgh", 4, ref2, sizeof (ref2));
+    blobref_hash ("sha1", "ijkl", 4, ref3, sizeof (ref3));
+
+    root = treeobj_create_dir ();
+    _treeobj_insert_entry_valref (root, "log", ref1);
+    treeobj_append_blobref (treeobj_get_entry (root, "log"), ref2);
+    treeobj_append_blobref (treeobj_get_entry (root, "log"), ref3);
+    _treeobj_insert_entry_val (root, "val", "foo", 3);
+    treeobj_hash ("sha1", root, root_ref, sizeof (root_ref));
+
+    setup_kvsroot (krm, KVS_PRIMARY_NAMESPACE, cache, root_ref, 0);
+
+    (void)cache_insert (cache, create_cache_entry_treeobj (root_ref, root));
+    (void)cache_insert (cache, create_cache_entry_raw (ref2, "efgh", 4));
+
+    /* errors */
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "log", FLUX_ROLE_OWNER, 0, FLUX_KVS_TREEOBJ,
+                             NULL)) != NULL,
+        "lookup_create works");
+    errno = 0;
+    ok (lookup_set_append_offset (lh, 1) < 0 && errno == EINVAL,
+        "lookup_set_append_offset fails with FLUX_KVS_TREEOBJ");
+    lookup_destroy (lh);
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "log", FLUX_ROLE_OWNER, 0, 0, NULL)) != NULL,
+        "lookup_create works");
+    errno = 0;
+    ok (lookup_set_append_offset (lh, -1) < 0 && errno == EINVAL,
+        "lookup_set_append_offset fails on negative offset");
+
+    /* without an offset, all missing blobs are loaded */
+    check_stall (lh, EAGAIN, 2, NULL, "log stall w/o offset");
+    lookup_destroy (lh);
+
+    /* blobs before the offset are not loaded */
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "log", FLUX_ROLE_OWNER, 0, 0, NULL)) != NULL,
+        "lookup_create works");
+    ok (lookup_set_append_offset (lh, 1) == 0,
+        "lookup_set_append_offset 1 works");
+    check_stall (lh, EAGAIN, 1, ref3, "log offset 1 stall");
+    (void)cache_insert (cache, create_cache_entry_raw (ref3, "ijkl", 4));
+    test = treeobj_create_val ("efghijkl", 8);
+    check_value (lh, test, "log offset 1");
+    json_decref (test);
+
+    (void)cache_insert (cache, create_cache_entry_raw (ref1, "abcd", 4));
+
+    check_append (cache, krm, "log", 0, "abcdefghijkl", 3, "log offset 0");
+    check_append (cache, krm, "log", 2, "ijkl", 3, "log offset 2");
+    check_append (cache, krm, "log", 3, "", 3, "log offset 3");
+    check_append (cache, krm, "val", 0, "foo", 1, "val offset 0");
+    check_append (cache, krm, "val", 1, "", 1, "val offset 1");
+
+    /* offset beyond value, i.e. value was overwritten */
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "log", FLUX_ROLE_OWNER, 0, 0, NULL)) != NULL,
+        "lookup_create works");
+    ok (lookup_set_append_offset (lh, 4) == 0,
+        "lookup_set_append_offset 4 works");
+    check_error (lh, EINVAL, "log offset 4");
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "val", FLUX_ROLE_OWNER, 0, 0, NULL)) != NULL,
+        "lookup_create works");
+    ok (lookup_set_append_offset (lh, 2) == 0,
+        "lookup_set_append_offset 2 works");
+    check_error (lh, EINVAL, "val offset 2");
+
+    /* blobcount is only returned if append offset set */
+    ok ((lh = lookup_create (cache, krm, 1, KVS_PRIMARY_NAMESPACE, NULL, 0,
+                             "log", FLUX_ROLE_OWNER, 0, 0, NULL)) != NULL,
+        "lookup_create works");
+    ok (lookup (lh) == LOOKUP_PROCESS_FINISHED,
+        "lookup w/o append offset finished");
+    errno = 0;
+    ok (lookup_get_blobcount (lh) < 0 && errno == EINVAL,
+        "lookup_get_blobcount fails w/o append offset");
+    lookup_destroy (lh);
+
+    cache_destroy (cache);
+    kvsroot_mgr_destroy (krm);
+    json_decref (root);
+}
+
 int main (int argc, char *argv[])
 {
     plan (NO_PLAN);
@@ -3567,6 +3896,8 @@ int main (int argc, char *argv[])
     lookup_stall_ref ();
     lookup_stall_namespace_removed ();
     lookup_stall_namespace_prefix_in_symlink ();
+    lookup_subtree ();
+    lookup_append_offset ();
     done_testing ();
     return (0);
 }
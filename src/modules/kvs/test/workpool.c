@@ -0,0 +1,116 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "src/common/libtap/tap.h"
+#include "src/modules/kvs/workpool.h"
+
+struct counter {
+    pthread_mutex_t lock;
+    int calls;
+};
+
+void square_cb (void *item, void *arg)
+{
+    int *n = item;
+    struct counter *c = arg;
+
+    *n = *n * *n;
+    pthread_mutex_lock (&c->lock);
+    c->calls++;
+    pthread_mutex_unlock (&c->lock);
+}
+
+void run_tests (int nthreads)
+{
+    struct workpool *wp;
+    struct counter c = { .lock = PTHREAD_MUTEX_INITIALIZER, .calls = 0 };
+    int values[100];
+    void *items[100];
+    int i, round;
+    bool correct;
+
+    ok ((wp = workpool_create (nthreads)) != NULL,
+        "workpool_create %d works", nthreads);
+    ok (workpool_size (wp) == nthreads,
+        "workpool_size returns %d", nthreads);
+    ok (workpool_run (wp, square_cb, NULL, 0, &c) == 0 && c.calls == 0,
+        "workpool_run with no items works");
+
+    for (round = 0; round < 10; round++) {
+        for (i = 0; i < 100; i++) {
+            values[i] = i + round;
+            items[i] = &values[i];
+        }
+        c.calls = 0;
+        if (workpool_run (wp, square_cb, items, 100, &c) < 0)
+            break;
+        correct = (c.calls == 100);
+        for (i = 0; i < 100; i++) {
+            if (values[i] != (i + round) * (i + round))
+                correct = false;
+        }
+        if (!correct)
+            break;
+    }
+    ok (round == 10,
+        "workpool_run processed 10 batches of 100 items with %d threads",
+        nthreads);
+
+    values[0] = 3;
+    c.calls = 0;
+    ok (workpool_run (wp, square_cb, items, 1, &c) == 0
+        && c.calls == 1 && values[0] == 9,
+        "workpool_run with one item works");
+
+    workpool_destroy (wp);
+}
+
+int main (int argc, char *argv[])
+{
+    struct workpool *wp;
+
+    plan (NO_PLAN);
+
+    errno = 0;
+    ok (workpool_create (-1) == NULL && errno == EINVAL,
+        "workpool_create -1 fails with EINVAL");
+    ok ((wp = workpool_create (1)) != NULL,
+        "workpool_create 1 works");
+    errno = 0;
+    ok (workpool_run (wp, NULL, NULL, 0, NULL) < 0 && errno == EINVAL,
+        "workpool_run fails with EINVAL on NULL function");
+    errno = 0;
+    ok (workpool_run (wp, square_cb, NULL, 1, NULL) < 0 && errno == EINVAL,
+        "workpool_run fails with EINVAL on NULL items");
+    workpool_destroy (wp);
+
+    workpool_destroy (NULL);
+    diag ("workpool_destroy accepts NULL arg");
+    ok (workpool_size (NULL) == 0,
+        "workpool_size NULL returns 0");
+
+    run_tests (0);
+    run_tests (1);
+    run_tests (4);
+
+    done_testing ();
+    return (0);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,160 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "workpool.h"
+
+struct workpool {
+    pthread_t *threads;
+    int nthreads;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;   /* signaled when a batch is posted */
+    pthread_cond_t done_cond;   /* signaled when a batch completes */
+    bool shutdown;
+
+    /* current batch, protected by 'lock' */
+    unsigned int generation;
+    workpool_f fn;
+    void *arg;
+    void **items;
+    int count;
+    int next;                   /* index of next unclaimed item */
+    int remaining;              /* items not yet completed */
+};
+
+/* Claim and process items from the current batch until none are left.
+ * Called with wp->lock held, returns with it held.
+ */
+static void run_items (struct workpool *wp)
+{
+    while (wp->next < wp->count) {
+        void *item = wp->items[wp->next++];
+
+        pthread_mutex_unlock (&wp->lock);
+        wp->fn (item, wp->arg);
+        pthread_mutex_lock (&wp->lock);
+        if (--wp->remaining == 0)
+            pthread_cond_signal (&wp->done_cond);
+    }
+}
+
+static void *worker (void *arg)
+{
+    struct workpool *wp = arg;
+    unsigned int generation = 0;
+
+    pthread_mutex_lock (&wp->lock);
+    for (;;) {
+        while (!wp->shutdown && wp->generation == generation)
+            pthread_cond_wait (&wp->work_cond, &wp->lock);
+        if (wp->shutdown)
+            break;
+        generation = wp->generation;
+        run_items (wp);
+    }
+    pthread_mutex_unlock (&wp->lock);
+    return NULL;
+}
+
+int workpool_run (struct workpool *wp, workpool_f fn, void **items, int count,
+                  void *arg)
+{
+    if (!wp || !fn || count < 0 || (count > 0 && !items)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (count == 0)
+        return 0;
+    pthread_mutex_lock (&wp->lock);
+    wp->fn = fn;
+    wp->arg = arg;
+    wp->items = items;
+    wp->count = count;
+    wp->next = 0;
+    wp->remaining = count;
+    wp->generation++;
+    if (count > 1)
+        pthread_cond_broadcast (&wp->work_cond);
+    run_items (wp);
+    while (wp->remaining > 0)
+        pthread_cond_wait (&wp->done_cond, &wp->lock);
+    wp->items = NULL;
+    wp->count = 0;
+    wp->next = 0;
+    pthread_mutex_unlock (&wp->lock);
+    return 0;
+}
+
+int workpool_size (struct workpool *wp)
+{
+    return wp ? wp->nthreads : 0;
+}
+
+void workpool_destroy (struct workpool *wp)
+{
+    if (wp) {
+        int i;
+
+        pthread_mutex_lock (&wp->lock);
+        wp->shutdown = true;
+        pthread_cond_broadcast (&wp->work_cond);
+        pthread_mutex_unlock (&wp->lock);
+        for (i = 0; i < wp->nthreads; i++)
+            pthread_join (wp->threads[i], NULL);
+        pthread_cond_destroy (&wp->work_cond);
+        pthread_cond_destroy (&wp->done_cond);
+        pthread_mutex_destroy (&wp->lock);
+        free (wp->threads);
+        free (wp);
+    }
+}
+
+struct workpool *workpool_create (int nthreads)
+{
+    struct workpool *wp;
+    int e;
+
+    if (nthreads < 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (!(wp = calloc (1, sizeof (*wp))))
+        return NULL;
+    pthread_mutex_init (&wp->lock, NULL);
+    pthread_cond_init (&wp->work_cond, NULL);
+    pthread_cond_init (&wp->done_cond, NULL);
+    if (nthreads > 0 && !(wp->threads = calloc (nthreads,
+                                                sizeof (wp->threads[0])))) {
+        workpool_destroy (wp);
+        errno = ENOMEM;
+        return NULL;
+    }
+    while (wp->nthreads < nthreads) {
+        if ((e = pthread_create (&wp->threads[wp->nthreads], NULL,
+                                 worker, wp)) != 0) {
+            workpool_destroy (wp);
+            errno = e;
+            return NULL;
+        }
+        wp->nthreads++;
+    }
+    return wp;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,46 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+#ifndef _FLUX_KVS_WORKPOOL_H
+#define _FLUX_KVS_WORKPOOL_H
+
+/* A fixed pool of threads for fork/join parallelism.
+ *
+ * workpool_run() blocks the calling thread until every item has been
+ * processed, so work functions may safely use any state that the
+ * caller does not touch while it waits.  The caller participates in
+ * the work, so a pool of N threads runs up to N+1 items at once.
+ */
+
+struct workpool;
+
+typedef void (*workpool_f)(void *item, void *arg);
+
+/* Create/destroy a pool of 'nthreads' worker threads.
+ */
+struct workpool *workpool_create (int nthreads);
+void workpool_destroy (struct workpool *wp);
+
+/* Call fn (items[i], arg) for each of 'count' items, in no particular
+ * order, returning once all calls have returned.
+ * Returns -1 on error, 0 on success.
+ */
+int workpool_run (struct workpool *wp, workpool_f fn, void **items, int count,
+                  void *arg);
+
+/* Return the number of worker threads.
+ */
+int workpool_size (struct workpool *wp);
+
+#endif /* !_FLUX_KVS_WORKPOOL_H */
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,188 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* dirsize.c - measure single key commit cost as a directory grows
+ *
+ * The directory is doubled in size from --start to --max entries.  At
+ * each size, --samples commits are made that each update one key, and
+ * the average commit time and the average growth of the rank 0 content
+ * cache (i.e. bytes of new tree objects written) per commit are printed:
+ *
+ *   entries commit-ms stored-bytes
+ *
+ * Without directory sharding, stored bytes grow linearly with entries.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <getopt.h>
+#include <inttypes.h>
+#include <flux/core.h>
+
+#include "src/common/libutil/xzmalloc.h"
+#include "src/common/libutil/monotime.h"
+#include "src/common/libutil/log.h"
+
+#define OPTIONS "hp:s:m:n:"
+static const struct option longopts[] = {
+    {"help",            no_argument,        0, 'h'},
+    {"prefix",          required_argument,  0, 'p'},
+    {"start",           required_argument,  0, 's'},
+    {"max",             required_argument,  0, 'm'},
+    {"samples",         required_argument,  0, 'n'},
+    { 0, 0, 0, 0 },
+};
+
+void usage (void)
+{
+    fprintf (stderr,
+"Usage: dirsize [--prefix NAME] [--start N] [--max N] [--samples N]\n"
+);
+    exit (1);
+}
+
+static void commit (flux_t *h, flux_kvs_txn_t *txn)
+{
+    flux_future_t *f;
+
+    if (!(f = flux_kvs_commit (h, 0, txn)) || flux_future_get (f, NULL) < 0)
+        log_err_exit ("flux_kvs_commit");
+    flux_future_destroy (f);
+}
+
+/* Bytes held by the rank 0 content cache.
+ */
+static int64_t content_size (flux_t *h)
+{
+    flux_future_t *f;
+    int64_t size;
+
+    if (!(f = flux_rpc (h, "content.stats.get", NULL, 0, 0))
+        || flux_rpc_get_unpack (f, "{s:I}", "size", &size) < 0)
+        log_err_exit ("content.stats.get");
+    flux_future_destroy (f);
+    return size;
+}
+
+/* Add keys [from, to) to directory 'prefix'.
+ */
+static void grow (flux_t *h, const char *prefix, int from, int to)
+{
+    flux_kvs_txn_t *txn;
+    char *key;
+    int i;
+
+    if (!(txn = flux_kvs_txn_create ()))
+        log_err_exit ("flux_kvs_txn_create");
+    for (i = from; i < to; i++) {
+        key = xasprintf ("%s.key%d", prefix, i);
+        if (flux_kvs_txn_pack (txn, 0, key, "i", i) < 0)
+            log_err_exit ("flux_kvs_txn_pack %s", key);
+        free (key);
+    }
+    commit (h, txn);
+    flux_kvs_txn_destroy (txn);
+}
+
+/* Update one key per commit, 'samples' times.
+ */
+static void measure (flux_t *h, const char *prefix, int entries, int samples,
+                     int *seq)
+{
+    flux_kvs_txn_t *txn;
+    struct timespec t0;
+    int64_t size0;
+    double ms;
+    char *key;
+    int i;
+
+    size0 = content_size (h);
+    monotime (&t0);
+    for (i = 0; i < samples; i++) {
+        key = xasprintf ("%s.key%d", prefix, (*seq * 7919) % entries);
+        if (!(txn = flux_kvs_txn_create ()))
+            log_err_exit ("flux_kvs_txn_create");
+        if (flux_kvs_txn_pack (txn, 0, key, "i", -(*seq)) < 0)
+            log_err_exit ("flux_kvs_txn_pack %s", key);
+        commit (h, txn);
+        flux_kvs_txn_destroy (txn);
+        free (key);
+        (*seq)++;
+    }
+    ms = monotime_since (t0);
+    printf ("%d %.3f %" PRIi64 "\n",
+            entries, ms / samples, (content_size (h) - size0) / samples);
+    fflush (stdout);
+}
+
+int main (int argc, char *argv[])
+{
+    flux_t *h;
+    int ch;
+    char *prefix = "dirsize";
+    int start = 64;
+    int max = 16384;
+    int samples = 10;
+    int entries, seq = 1;
+    flux_kvs_txn_t *txn;
+
+    log_init ("dirsize");
+
+    while ((ch = getopt_long (argc, argv, OPTIONS, longopts, NULL)) != -1) {
+        switch (ch) {
+            case 'p': /* --prefix NAME */
+                prefix = optarg;
+                break;
+            case 's': /* --start N */
+                start = strtoul (optarg, NULL, 10);
+                break;
+            case 'm': /* --max N */
+                max = strtoul (optarg, NULL, 10);
+                break;
+            case 'n': /* --samples N */
+                samples = strtoul (optarg, NULL, 10);
+                break;
+            case 'h': /* --help */
+            default:
+                usage ();
+                break;
+        }
+    }
+    if (optind != argc)
+        usage ();
+    if (start < 1 || max < start || samples < 1)
+        usage ();
+
+    if (!(h = flux_open (NULL, 0)))
+        log_err_exit ("flux_open");
+
+    if (!(txn = flux_kvs_txn_create ()))
+        log_err_exit ("flux_kvs_txn_create");
+    if (flux_kvs_txn_unlink (txn, 0, prefix) < 0)
+        log_err_exit ("flux_kvs_txn_unlink");
+    commit (h, txn);
+    flux_kvs_txn_destroy (txn);
+
+    grow (h, prefix, 0, start);
+    for (entries = start; entries <= max; entries *= 2) {
+        if (entries > start)
+            grow (h, prefix, entries / 2, entries);
+        measure (h, prefix, entries, samples, &seq);
+    }
+
+    flux_close (h);
+    log_fini ();
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,64 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* lookup_multi.c - look up several keys with one kvs.lookup-multi RPC
+ *
+ * For each key, in order, print "key=value", or "key: error" if that
+ * key's lookup failed.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <string.h>
+#include <flux/core.h>
+
+#include "src/common/libutil/log.h"
+
+int main (int argc, char *argv[])
+{
+    flux_t *h;
+    flux_future_t *f;
+    const char *value;
+    int i;
+
+    log_init ("lookup_multi");
+
+    if (argc < 2) {
+        fprintf (stderr, "Usage: lookup_multi key [key...]\n");
+        return (1);
+    }
+    if (!(h = flux_open (NULL, 0)))
+        log_err_exit ("flux_open");
+
+    if (!(f = flux_kvs_lookup_multi (h, 0, (const char **)&argv[1],
+                                     argc - 1)))
+        log_err_exit ("flux_kvs_lookup_multi");
+    for (i = 0; i < argc - 1; i++) {
+        if (flux_kvs_lookup_multi_get (f, i, &value) < 0) {
+            if (errno == EPROTO || errno == ENOSYS || errno == EPERM)
+                log_err_exit ("flux_kvs_lookup_multi_get");
+            printf ("%s: %s\n", flux_kvs_lookup_multi_get_key (f, i),
+                    strerror (errno));
+        }
+        else
+            printf ("%s=%s\n", flux_kvs_lookup_multi_get_key (f, i),
+                    value ? value : "");
+    }
+    flux_future_destroy (f);
+
+    flux_close (h);
+    log_fini ();
+    return (0);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -0,0 +1,141 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* lookup_subtree.c - fetch a KVS subtree with one streaming lookup
+ *
+ * For each directory response, print "key." and then "key.name=value"
+ * for each value in the directory, or "key.name." for subdirectories.
+ * Values are printed from the response itself, which the kvs module has
+ * already resolved.  With --count, print only the number of responses.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <getopt.h>
+#include <jansson.h>
+#include <flux/core.h>
+
+#include "src/common/libkvs/treeobj.h"
+#include "src/common/libutil/log.h"
+
+#define OPTIONS "hd:p:c"
+static const struct option longopts[] = {
+    {"help",            no_argument,        0, 'h'},
+    {"maxdepth",        required_argument,  0, 'd'},
+    {"pattern",         required_argument,  0, 'p'},
+    {"count",           no_argument,        0, 'c'},
+    { 0, 0, 0, 0 },
+};
+
+void usage (void)
+{
+    fprintf (stderr,
+"Usage: lookup_subtree [--maxdepth N] [--pattern GLOB] [--count] key\n"
+);
+    exit (1);
+}
+
+static void print_dir (const char *key, const flux_kvsdir_t *dir,
+                       const char *treeobj)
+{
+    flux_kvsitr_t *itr;
+    const char *name;
+    json_t *obj;
+
+    if (!(obj = treeobj_decode (treeobj)))
+        log_err_exit ("%s: treeobj_decode", key);
+    printf ("%s.\n", key);
+    if (!(itr = flux_kvsitr_create (dir)))
+        log_err_exit ("flux_kvsitr_create");
+    while ((name = flux_kvsitr_next (itr))) {
+        char *nkey = flux_kvsdir_key_at (dir, name);
+
+        if (flux_kvsdir_isdir (dir, name))
+            printf ("%s.\n", nkey);
+        else if (!flux_kvsdir_issymlink (dir, name)) {
+            void *data;
+            int len;
+
+            if (treeobj_decode_val (treeobj_get_entry (obj, name),
+                                    &data, &len) < 0)
+                log_err_exit ("%s", nkey);
+            printf ("%s=%.*s\n", nkey, len, data ? (char *)data : "");
+            free (data);
+        }
+        free (nkey);
+    }
+    flux_kvsitr_destroy (itr);
+    json_decref (obj);
+}
+
+int main (int argc, char *argv[])
+{
+    flux_t *h;
+    flux_future_t *f;
+    int ch;
+    int maxdepth = -1;
+    const char *pattern = NULL;
+    bool count_only = false;
+    const flux_kvsdir_t *dir;
+    const char *treeobj;
+    int count = 0;
+
+    log_init ("lookup_subtree");
+
+    while ((ch = getopt_long (argc, argv, OPTIONS, longopts, NULL)) != -1) {
+        switch (ch) {
+            case 'd': /* --maxdepth N */
+                maxdepth = strtol (optarg, NULL, 10);
+                break;
+            case 'p': /* --pattern GLOB */
+                pattern = optarg;
+                break;
+            case 'c': /* --count */
+                count_only = true;
+                break;
+            case 'h': /* --help */
+            default:
+                usage ();
+                break;
+        }
+    }
+    if (optind != argc - 1)
+        usage ();
+
+    if (!(h = flux_open (NULL, 0)))
+        log_err_exit ("flux_open");
+
+    if (!(f = flux_kvs_lookup_subtree (h, 0, argv[optind], maxdepth,
+                                       pattern)))
+        log_err_exit ("flux_kvs_lookup_subtree");
+    while (flux_kvs_lookup_get_dir (f, &dir) == 0) {
+        if (!count_only) {
+            if (flux_kvs_lookup_get_treeobj (f, &treeobj) < 0)
+                log_err_exit ("flux_kvs_lookup_get_treeobj");
+            print_dir (flux_kvs_lookup_get_key (f), dir, treeobj);
+        }
+        count++;
+        flux_future_reset (f);
+    }
+    if (errno != ENODATA)
+        log_err_exit ("%s", argv[optind]);
+    if (count_only)
+        printf ("%d\n", count);
+    flux_future_destroy (f);
+
+    flux_close (h);
+    log_fini ();
+    return (0);
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
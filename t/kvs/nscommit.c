@@ -0,0 +1,182 @@
+/************************************************************\
+ * Copyright 2019 Lawrence Livermore National Security, LLC
+ * (c.f. AUTHORS, NOTICE.LLNS, COPYING)
+ *
+ * This file is part of the Flux resource manager framework.
+ * For details, see https://github.com/flux-framework.
+ *
+ * SPDX-License-Identifier: LGPL-3.0
+\************************************************************/
+
+/* nscommit.c - measure commit throughput across many namespaces
+ *
+ * Create --namespaces namespaces, as a job manager would create a guest
+ * namespace per job, then for --rounds rounds, commit --keys keys to
+ * every namespace at once and wait for all of the commits to complete.
+ * The total time and commit rate are printed:
+ *
+ *   namespaces commits elapsed-ms commits/s
+ *
+ * With the kvs module's commit-workers=N option, transactions for
+ * different namespaces are processed concurrently.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <getopt.h>
+#include <unistd.h>
+#include <flux/core.h>
+
+#include "src/common/libutil/xzmalloc.h"
+#include "src/common/libutil/monotime.h"
+#include "src/common/libutil/log.h"
+
+#define OPTIONS "hp:n:r:k:"
+static const struct option longopts[] = {
+    {"help",            no_argument,        0, 'h'},
+    {"prefix",          required_argument,  0, 'p'},
+    {"namespaces",      required_argument,  0, 'n'},
+    {"rounds",          required_argument,  0, 'r'},
+    {"keys",            required_argument,  0, 'k'},
+    { 0, 0, 0, 0 },
+};
+
+void usage (void)
+{
+    fprintf (stderr,
+"Usage: nscommit [--prefix NAME] [--namespaces N] [--rounds N] [--keys N]\n"
+);
+    exit (1);
+}
+
+static void namespace_create (flux_t *h, const char *ns)
+{
+    flux_future_t *f;
+
+    if (!(f = flux_kvs_namespace_create (h, ns, getuid (), 0))
+        || flux_future_get (f, NULL) < 0)
+        log_err_exit ("flux_kvs_namespace_create %s", ns);
+    flux_future_destroy (f);
+}
+
+static void namespace_remove (flux_t *h, const char *ns)
+{
+    flux_future_t *f;
+
+    if (!(f = flux_kvs_namespace_remove (h, ns))
+        || flux_future_get (f, NULL) < 0)
+        log_err_exit ("flux_kvs_namespace_remove %s", ns);
+    flux_future_destroy (f);
+}
+
+/* Send a commit of 'keys' keys in round 'round' to namespace 'ns'.
+ */
+static flux_future_t *commit_send (flux_t *h, const char *ns, int round,
+                                   int keys)
+{
+    flux_kvs_txn_t *txn;
+    flux_future_t *f;
+    char *key;
+    int i;
+
+    if (!(txn = flux_kvs_txn_create ()))
+        log_err_exit ("flux_kvs_txn_create");
+    for (i = 0; i < keys; i++) {
+        key = xasprintf ("round%d.task%d.state", round, i);
+        if (flux_kvs_txn_pack (txn, 0, key, "{s:i s:i s:s}",
+                               "round", round,
+                               "task", i,
+                               "state", "running") < 0)
+            log_err_exit ("flux_kvs_txn_pack %s", key);
+        free (key);
+    }
+    if (flux_kvs_set_namespace (h, ns) < 0)
+        log_err_exit ("flux_kvs_set_namespace %s", ns);
+    if (!(f = flux_kvs_commit (h, 0, txn)))
+        log_err_exit ("flux_kvs_commit %s", ns);
+    flux_kvs_txn_destroy (txn);
+    return f;
+}
+
+int main (int argc, char *argv[])
+{
+    flux_t *h;
+    int ch;
+    char *prefix = "nscommit";
+    int namespaces = 64;
+    int rounds = 10;
+    int keys = 16;
+    char **ns;
+    flux_future_t **f;
+    struct timespec t0;
+    double ms;
+    int i, r;
+
+    log_init ("nscommit");
+
+    while ((ch = getopt_long (argc, argv, OPTIONS, longopts, NULL)) != -1) {
+        switch (ch) {
+            case 'p': /* --prefix NAME */
+                prefix = optarg;
+                break;
+            case 'n': /* --namespaces N */
+                namespaces = strtoul (optarg, NULL, 10);
+                break;
+            case 'r': /* --rounds N */
+                rounds = strtoul (optarg, NULL, 10);
+                break;
+            case 'k': /* --keys N */
+                keys = strtoul (optarg, NULL, 10);
+                break;
+            case 'h': /* --help */
+            default:
+                usage ();
+                break;
+        }
+    }
+    if (optind != argc)
+        usage ();
+    if (namespaces < 1 || rounds < 1 || keys < 1)
+        usage ();
+
+    if (!(h = flux_open (NULL, 0)))
+        log_err_exit ("flux_open");
+
+    ns = xzmalloc (namespaces * sizeof (ns[0]));
+    f = xzmalloc (namespaces * sizeof (f[0]));
+    for (i = 0; i < namespaces; i++) {
+        ns[i] = xasprintf ("%s-%d", prefix, i);
+        namespace_create (h, ns[i]);
+    }
+
+    monotime (&t0);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < namespaces; i++)
+            f[i] = commit_send (h, ns[i], r, keys);
+        for (i = 0; i < namespaces; i++) {
+            if (flux_future_get (f[i], NULL) < 0)
+                log_err_exit ("flux_kvs_commit %s", ns[i]);
+            flux_future_destroy (f[i]);
+        }
+    }
+    ms = monotime_since (t0);
+    printf ("%d %d %.3f %.1f\n", namespaces, namespaces * rounds, ms,
+            namespaces * rounds / (ms / 1000));
+    fflush (stdout);
+
+    for (i = 0; i < namespaces; i++) {
+        namespace_remove (h, ns[i]);
+        free (ns[i]);
+    }
+    free (ns);
+    free (f);
+
+    flux_close (h);
+    log_fini ();
+    return 0;
+}
+
+/*
+ * vi:tabstop=4 shiftwidth=4 expandtab
+ */
@@ -37,6 +37,8 @@ void test_pingself (flux_t *h, uint32_t nodeid);
 void test_pingupstream (flux_t *h, uint32_t nodeid);
 void test_flush (flux_t *h, uint32_t nodeid);
 void test_clog (flux_t *h, uint32_t nodeid);
+void test_flood (flux_t *h, uint32_t nodeid);
+void test_rtt (flux_t *h, uint32_t nodeid);
 
 typedef struct {
     const char *name;
@@ -56,6 +58,8 @@ static test_t tests[] = {
     { "pingupstream", &test_pingupstream},
     { "flush", &test_flush},
     { "clog", &test_clog},
+    { "flood", &test_flood},
+    { "rtt", &test_rtt},
 };
 
 test_t *test_lookup (const char *name)
@@ -77,7 +81,7 @@ static const struct option longopts[] = {
 void usage (void)
 {
     fprintf (stderr,
-"Usage: treq [--rank N] {null | echo | err | src | sink | nsrc | putmsg | pingzero | pingself | pingupstream | clog | flush}\n"
+"Usage: treq [--rank N] {null | echo | err | src | sink | nsrc | putmsg | pingzero | pingself | pingupstream | clog | flush | flood | rtt}\n"
 );
     exit (1);
 }
@@ -325,6 +329,67 @@ void test_clog (flux_t *h, uint32_t nodeid)
     flux_future_destroy (f);
 }
 
+/* Send 10K echo requests before collecting any responses, so that they
+ * cross the local connector in bursts in both directions, and report
+ * the throughput.  Every other request carries a payload large enough
+ * that it is not copied when it is forwarded.
+ */
+void test_flood (flux_t *h, uint32_t nodeid)
+{
+    const int count = 10000;
+    flux_future_t **f;
+    struct timespec t0;
+    char pad[1024];
+    const char *s;
+    double ms;
+    int i, seq;
+
+    memset (pad, 'x', sizeof (pad) - 1);
+    pad[sizeof (pad) - 1] = '\0';
+    f = xzmalloc (count * sizeof (f[0]));
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        if (!(f[i] = flux_rpc_pack (h, "req.echo", nodeid, 0,
+                                    "{s:i s:s}", "seq", i,
+                                    "pad", i % 2 ? pad : "")))
+            log_err_exit ("%s: req.echo %d", __FUNCTION__, i);
+    }
+    for (i = 0; i < count; i++) {
+        if (flux_rpc_get_unpack (f[i], "{s:i s:s}", "seq", &seq,
+                                 "pad", &s) < 0)
+            log_err_exit ("%s: req.echo %d", __FUNCTION__, i);
+        if (seq != i || strlen (s) != (i % 2 ? sizeof (pad) - 1 : 0))
+            log_msg_exit ("%s: response %d has wrong payload", __FUNCTION__, i);
+        flux_future_destroy (f[i]);
+    }
+    ms = monotime_since (t0);
+    printf ("flood: %d rpcs in %.1fms (%.0f rpc/s)\n",
+            count, ms, count * 1E3 / ms);
+    free (f);
+}
+
+/* Time sequential RPCs, each waiting for the previous response.
+ */
+void test_rtt (flux_t *h, uint32_t nodeid)
+{
+    const int count = 10000;
+    flux_future_t *f;
+    struct timespec t0;
+    double ms;
+    int i;
+
+    monotime (&t0);
+    for (i = 0; i < count; i++) {
+        if (!(f = flux_rpc (h, "req.null", NULL, nodeid, 0))
+                 || flux_future_get (f, NULL) < 0)
+            log_err_exit ("%s: req.null %d", __FUNCTION__, i);
+        flux_future_destroy (f);
+    }
+    ms = monotime_since (t0);
+    printf ("rtt: %d rpcs in %.1fms (%.1fus/rpc)\n",
+            count, ms, ms * 1E3 / count);
+}
+
 /*
  * vi:tabstop=4 shiftwidth=4 expandtab
  */
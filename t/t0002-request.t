@@ -69,6 +69,16 @@ test_expect_success 'request: 10K responses received in order, with deferrals' '
 	${FLUX_BUILD_DIR}/t/request/treq putmsg 
 '
 
+test_expect_success 'request: 10K pipelined rpcs (flood)' '
+	${FLUX_BUILD_DIR}/t/request/treq flood >flood.out &&
+	cat flood.out &&
+	grep "^flood: 10000 rpcs" flood.out
+'
+
+test_expect_success 'request: 10K pipelined rpcs to rank 1 (flood)' '
+	${FLUX_BUILD_DIR}/t/request/treq --rank 1 flood
+'
+
 test_expect_success 'request: proxy ping 0 from 1 is 4 hops' '
 	${FLUX_BUILD_DIR}/t/request/treq --rank 1 pingzero | grep hops=4
 '
@@ -158,4 +158,105 @@ test_expect_success 'store 1K blobs from all ranks using async RPC' '
 	flux exec -n flux content spam 1024 256
 '
 
+# Write 8192 blobs in batches of 64, allowing 16 batches to be outstanding
+test_expect_success 'store 8K blobs from rank 0 using batched RPC' '
+	flux content spam --batch=64 8192 16
+'
+
+test_expect_success 'store 1K blobs from all ranks using batched RPC' '
+	flux exec -n flux content spam --batch=32 1024 8
+'
+
+test_expect_success 'batched stores are counted in content stats' '
+	REQS=`flux module stats --type int --parse store-requests content` &&
+	BLOBS=`flux module stats --type int --parse store-blobs content` &&
+	test $REQS -lt $BLOBS
+'
+
+test_expect_success 'loads of cached blobs are counted as hits' '
+	HITS=`flux module stats --type int --parse hits content` &&
+	flux content load `cat 4k.0.hash` >/dev/null &&
+	HITS2=`flux module stats --type int --parse hits content` &&
+	test $HITS2 -gt $HITS
+'
+
+test_expect_success 'loads of uncached blobs are counted as misses on rank 1' '
+	MISSES=`flux exec -n -r 1 flux module stats --type int \
+		--parse misses content` &&
+	echo miss-test | flux content store >miss.hash &&
+	flux exec -n -r 1 flux content load `cat miss.hash` >/dev/null &&
+	MISSES2=`flux exec -n -r 1 flux module stats --type int \
+		--parse misses content` &&
+	test $MISSES2 -gt $MISSES
+'
+
+# Entries on rank 1 are clean (write-through), so they may be evicted.
+# With the size target at 1 byte and no age restriction, the 1m blob
+# should be purged on the next heartbeat, while small entries remain.
+test_expect_success 'rank 1 cache purges large entries to reach size target' '
+	flux exec -n -r 1 flux content load `cat 1m.0.hash` >/dev/null &&
+	flux exec -n -r 1 flux setattr content.purge-old-entry 0 &&
+	flux exec -n -r 1 flux setattr content.purge-target-size 1 &&
+	for i in `seq 1 30`; do \
+		SIZE=`flux exec -n -r 1 flux module stats --type int \
+			--parse size content` && \
+		test $SIZE -lt 1048576 && break; \
+		sleep 1; \
+	done &&
+	test $SIZE -lt 1048576 &&
+	EVICT=`flux exec -n -r 1 flux module stats --type int \
+		--parse evictions content` &&
+	test $EVICT -gt 0 &&
+	COUNT=`flux exec -n -r 1 flux module stats --type int \
+		--parse count content` &&
+	test $COUNT -gt 0
+'
+
+test_expect_success 'evicted blob can be reloaded on rank 1' '
+	flux exec -n -r 1 sh -c "flux content load `cat 1m.0.hash` \
+		| $BLOBREF $HASHFUN" >1m.0.reload &&
+	test_cmp 1m.0.hash 1m.0.reload &&
+	flux exec -n -r 1 flux setattr content.purge-target-size 16777216 &&
+	flux exec -n -r 1 flux setattr content.purge-old-entry 5
+'
+
+test_expect_success 'rank 0 dirty entries are not evicted' '
+	flux setattr content.purge-old-entry 0 &&
+	flux setattr content.purge-target-size 1 &&
+	flux setattr content.purge-target-entries 1 &&
+	sleep 3 &&
+	DIRTY=`flux module stats --type int --parse dirty content` &&
+	TOTAL=`flux module stats --type int --parse count content` &&
+	test $DIRTY -eq $TOTAL &&
+	flux content load `cat 1m.0.hash` >/dev/null &&
+	flux setattr content.purge-target-entries 1048576 &&
+	flux setattr content.purge-target-size 16777216 &&
+	flux setattr content.purge-old-entry 5
+'
+
+test_expect_success 'blob stored compressed from rank 1 stays compressed on rank 0' '
+	seq 1 20000 >z.store &&
+	flux exec -n -r 1 flux setattr content.compress 1 &&
+	flux exec -n -r 1 sh -c "flux content store <z.store" >z.hash &&
+	$BLOBREF $HASHFUN <z.store >z.hash.expected &&
+	test_cmp z.hash.expected z.hash &&
+	COMP=`flux module stats --type int --parse compressed content` &&
+	test $COMP -gt 0
+'
+
+test_expect_success 'compressed blob loads correctly on rank 0' '
+	flux content load `cat z.hash` >z.load0 &&
+	test_cmp z.store z.load0
+'
+
+test_expect_success 'compressed blob loads correctly on rank 2 via load-batch' '
+	flux exec -n -r 2 flux setattr content.compress 1 &&
+	flux exec -n -r 2 sh -c "flux content load `cat z.hash`" >z.load2 &&
+	test_cmp z.store z.load2 &&
+	INFL=`flux exec -n -r 2 flux module stats --type int \
+		--parse inflations content` &&
+	test $INFL -gt 0 &&
+	flux exec -n -r 1,2 flux setattr content.compress 0
+'
+
 test_done
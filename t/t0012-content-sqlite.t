@@ -134,6 +134,10 @@ test_expect_success 'check that content returned dirty' '
 	test $NDIRTY -eq $ECOUNT
 '
 
+test_expect_success 'unload reported entries returned and throughput' '
+	flux dmesg | grep "entries returned to cache in .*entries/s"
+'
+
 test_expect_success 'load 64b blob from cache' '
         HASHSTR=`cat 64.0.hash` &&
         flux content load ${HASHSTR} >64.0.load2 &&
@@ -207,5 +211,117 @@ test_expect_success 'remove content-sqlite module on rank 0' '
 	flux module remove --rank 0 content-sqlite
 '
 
+test_expect_success 'unload returns more than one batch of entries' '
+	flux module load --rank 0 content-sqlite &&
+	flux content spam 4096 256 &&
+	run_timeout 10 flux content flush &&
+	flux content dropcache &&
+	run_timeout 60 flux module remove --rank 0 content-sqlite &&
+	ECOUNT=`flux module stats --type int --parse count content` &&
+	test $ECOUNT -ge 4096
+'
+
+# Group commit mode
+
+test_expect_success 'load content-sqlite module with group commit' '
+	flux module load --rank 0 content-sqlite \
+		group-commit=16 group-commit-window=0.05
+'
+
+test_expect_success 'content previously stored is still available' '
+        HASHSTR=`cat 4k.0.hash` &&
+        flux content load --bypass-cache ${HASHSTR} >4k.0.load4 &&
+        test_cmp 4k.0.store 4k.0.load4
+'
+
+test_expect_success 'single store bypassing cache commits after window' '
+        dd if=/dev/urandom count=1 bs=4096 >4k.1.store 2>/dev/null &&
+        flux content store --bypass-cache <4k.1.store >4k.1.hash &&
+        HASHSTR=`cat 4k.1.hash` &&
+        flux content load --bypass-cache ${HASHSTR} >4k.1.load &&
+        test_cmp 4k.1.store 4k.1.load
+'
+
+test_expect_success 'batched flush is absorbed by group commit' '
+	flux setattr content.flush-batch-limit 16 &&
+        store_junk groupcommit 200 &&
+	run_timeout 10 flux content flush &&
+	NDIRTY=`flux module stats --type int --parse dirty content` &&
+	test ${NDIRTY} -eq 0
+'
+
+test_expect_success 'async stores are absorbed by group commit' '
+	flux content spam 1024 256
+'
+
+test_expect_success 'group commit with window only works' '
+	flux module remove --rank 0 content-sqlite &&
+	flux module load --rank 0 content-sqlite \
+		group-commit=100000 group-commit-window=0.01 &&
+        store_junk groupwindow 20 &&
+	run_timeout 10 flux content flush
+'
+
+test_expect_success 'remove content-sqlite module on rank 0' '
+	flux module remove --rank 0 content-sqlite
+'
+
+
+# Worker pool mode
+
+test_expect_success 'load content-sqlite module with 4 workers' '
+	flux module load --rank 0 content-sqlite workers=4
+'
+
+test_expect_success 'load 1m blob bypassing cache via worker' '
+        HASHSTR=`cat 1m.0.hash` &&
+        flux content load --bypass-cache ${HASHSTR} >1m.0.load5 &&
+        test_cmp 1m.0.store 1m.0.load5
+'
+
+test_expect_success 'load 0b blob bypassing cache via worker' '
+        HASHSTR=`cat 0.0.hash` &&
+        flux content load --bypass-cache ${HASHSTR} >0.0.load5 &&
+        test_cmp 0.0.store 0.0.load5
+'
+
+test_expect_success 'store blobs bypassing cache via worker' '
+        dd if=/dev/urandom count=64 bs=4096 >256k.2.store 2>/dev/null &&
+        flux content store --bypass-cache <256k.2.store >256k.2.hash &&
+        HASHSTR=`cat 256k.2.hash` &&
+        flux content load --bypass-cache ${HASHSTR} >256k.2.load &&
+        test_cmp 256k.2.store 256k.2.load
+'
+
+test_expect_success 'load of unknown blob via worker fails' '
+        test_must_fail flux content load --bypass-cache \
+		${HASHFUN}-0000000000000000000000000000000000000000
+'
+
+test_expect_success 'loads run concurrently with a large store' '
+        dd if=/dev/urandom count=256 bs=4096 >1m.2.store 2>/dev/null &&
+        flux content store --bypass-cache <1m.2.store >1m.2.hash &
+        HASHSTR=`cat 4k.0.hash` &&
+        (for i in `seq 1 16`; do \
+            flux content load --bypass-cache ${HASHSTR} || exit 1; \
+        done) >4k.0.load16 &&
+        wait &&
+        for i in `seq 1 16`; do cat 4k.0.store; done >4k.0.expect16 &&
+        test_cmp 4k.0.expect16 4k.0.load16
+'
+
+test_expect_success 'async stores with workers and group commit' '
+	flux module remove --rank 0 content-sqlite &&
+	flux module load --rank 0 content-sqlite workers=4 group-commit=64 &&
+	flux content spam 1024 256 &&
+	run_timeout 10 flux content flush
+'
+
+test_expect_success 'unload with workers returns content to cache' '
+	flux module remove --rank 0 content-sqlite &&
+        HASHSTR=`cat 256k.2.hash` &&
+        flux content load ${HASHSTR} >256k.2.load2 &&
+        test_cmp 256k.2.store 256k.2.load2
+'
 
 test_done
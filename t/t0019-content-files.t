@@ -0,0 +1,191 @@
+#!/bin/sh
+
+test_description='Test content-files service'
+
+. `dirname $0`/sharness.sh
+
+if test "$TEST_LONG" = "t"; then
+    test_set_prereq LONGTEST
+fi
+
+# Size the session to one more than the number of cores, minimum of 4
+SIZE=$(test_size_large)
+test_under_flux ${SIZE} minimal
+echo "# $0: flux session size will be ${SIZE}"
+
+BLOBREF=${FLUX_BUILD_DIR}/t/kvs/blobref
+
+MAXBLOB=`flux getattr content.blob-size-limit`
+HASHFUN=`flux getattr content.hash`
+SEGDIR=`flux getattr broker.rundir`/content-files
+
+store_junk() {
+    local name=$1
+    local n=$2
+    for i in `seq 1 $n`; do \
+        echo "$name:$i" | flux content store >/dev/null || return 1
+    done
+}
+
+test_expect_success 'load content-files module on rank 0' '
+	flux module load --rank 0 content-files
+'
+
+test_expect_success 'store 100 blobs on rank 0' '
+	store_junk test 100 &&
+	run_timeout 10 flux content flush &&
+	OBJECTS=`flux module stats --type int --parse objects content-files` &&
+	test $OBJECTS -ge 100
+'
+
+test_expect_success 'store blobs bypassing cache' '
+	cat /dev/null >0.0.store &&
+        flux content store --bypass-cache <0.0.store >0.0.hash &&
+        dd if=/dev/urandom count=1 bs=64 >64.0.store 2>/dev/null &&
+        flux content store --bypass-cache <64.0.store >64.0.hash &&
+        dd if=/dev/urandom count=1 bs=4096 >4k.0.store 2>/dev/null &&
+        flux content store --bypass-cache <4k.0.store >4k.0.hash &&
+        dd if=/dev/urandom count=256 bs=4096 >1m.0.store 2>/dev/null &&
+        flux content store --bypass-cache <1m.0.store >1m.0.hash
+'
+
+test_expect_success 'storing a blob twice does not append it again' '
+	BYTES=`flux module stats --type int --parse bytes content-files` &&
+        flux content store --bypass-cache <4k.0.store &&
+	BYTES2=`flux module stats --type int --parse bytes content-files` &&
+	test $BYTES -eq $BYTES2
+'
+
+test_expect_success LONGTEST "cannot store blob that exceeds max size of $MAXBLOB" '
+        dd if=/dev/zero count=$(($MAXBLOB/4096+1)) bs=4096 \
+			skip=$(($MAXBLOB/4096)) >toobig 2>/dev/null &&
+        test_must_fail flux content store --bypass-cache <toobig
+'
+
+for size in 0 64 4k 1m; do
+	test_expect_success "load ${size} blob bypassing cache" "
+		HASHSTR=\`cat ${size}.0.hash\` &&
+		flux content load --bypass-cache \${HASHSTR} >${size}.0.load &&
+		test_cmp ${size}.0.store ${size}.0.load
+	"
+done
+
+test_expect_success 'load of unknown blob fails with ENOENT' '
+        test_must_fail flux content load --bypass-cache \
+		${HASHFUN}-0000000000000000000000000000000000000000 2>enoent.err &&
+	grep "No such file or directory" enoent.err
+'
+
+test_expect_success 'load and verify 1m blob on all ranks' '
+        HASHSTR=`cat 1m.0.hash` &&
+        flux exec -n echo ${HASHSTR} >1m.0.all.expect &&
+        flux exec -n sh -c "flux content load ${HASHSTR} | $BLOBREF $HASHFUN" \
+                                                >1m.0.all.output &&
+        test_cmp 1m.0.all.expect 1m.0.all.output
+'
+
+test_expect_success 'drop rank 0 cache and unload content-files' '
+        run_timeout 10 flux content flush &&
+        flux content dropcache &&
+	flux module remove --rank 0 content-files
+'
+
+test_expect_success 'content was returned to cache dirty' '
+	NDIRTY=`flux module stats --type int --parse dirty content` &&
+	ECOUNT=`flux module stats --type int --parse count content` &&
+	test $NDIRTY -eq $ECOUNT &&
+        HASHSTR=`cat 1m.0.hash` &&
+        flux content load ${HASHSTR} >1m.0.load2 &&
+        test_cmp 1m.0.store 1m.0.load2
+'
+
+test_expect_success 'torn record at tail of last segment is truncated' '
+	LAST=`ls $SEGDIR/*.seg | tail -1` &&
+	SIZE=`stat --format "%s" $LAST` &&
+	printf "\146\154\170\103\000\001\000\000garbage" >>$LAST &&
+	flux module load --rank 0 content-files &&
+	test `stat --format "%s" $LAST` -eq $SIZE
+'
+
+test_expect_success 'segments were recovered on reload' '
+	OBJECTS=`flux module stats --type int --parse objects content-files` &&
+	test $OBJECTS -ge 104 &&
+        HASHSTR=`cat 1m.0.hash` &&
+        flux content load --bypass-cache ${HASHSTR} >1m.0.load3 &&
+        test_cmp 1m.0.store 1m.0.load3
+'
+
+test_expect_success 'small segment-size rolls segments' '
+	flux module remove --rank 0 content-files &&
+	flux module load --rank 0 content-files segment-size=65536 &&
+	SEGS=`flux module stats --type int --parse segments content-files` &&
+	flux content spam 512 64 &&
+	run_timeout 10 flux content flush &&
+	SEGS2=`flux module stats --type int --parse segments content-files` &&
+	test $SEGS2 -gt $(($SEGS+1))
+'
+
+test_expect_success 'blob larger than segment-size gets its own segment' '
+	dd if=/dev/urandom count=32 bs=4096 >128k.0.store 2>/dev/null &&
+	flux content store --bypass-cache <128k.0.store >128k.0.hash &&
+	HASHSTR=`cat 128k.0.hash` &&
+	flux content load --bypass-cache ${HASHSTR} >128k.0.load &&
+	test_cmp 128k.0.store 128k.0.load
+'
+
+segments_wait_removed() {
+	local path=$1
+	local i=0
+	while test -f $path && test $i -lt 50; do
+		flux module stats content-files >/dev/null || return 1
+		sleep 0.1
+		i=$(($i+1))
+	done
+	test ! -f $path
+}
+
+test_expect_success 'dead records recovered in active segment are compacted once it is sealed' '
+	flux module remove --rank 0 content-files &&
+	LAST=`ls $SEGDIR/*.seg | tail -1` &&
+	ID=`basename $LAST .seg` &&
+	DUP=$SEGDIR/`printf "%08d" $(expr $ID + 1)`.seg &&
+	cp $LAST $DUP &&
+	flux module load --rank 0 content-files segment-size=65536 &&
+	SEGS=`flux module stats --type int --parse segments content-files` &&
+	test -f $DUP &&
+	dd if=/dev/urandom count=32 bs=4096 >128k.1.store 2>/dev/null &&
+	flux content store --bypass-cache <128k.1.store &&
+	segments_wait_removed $DUP &&
+	SEGS2=`flux module stats --type int --parse segments content-files` &&
+	test $SEGS2 -le $SEGS
+'
+
+test_expect_success 'remove content-files module on rank 0' '
+	flux module remove --rank 0 content-files
+'
+
+# Benchmark: time to store and flush 8K blobs from the rank 0 cache to each
+# backing store.  Timings are reported but not compared, to avoid
+# spurious failures on loaded test systems.
+
+bench_flush() {
+	local module=$1
+	local t0 t1
+	flux module load --rank 0 $module || return 1
+	run_timeout 60 flux content flush || return 1
+	t0=$(date +%s.%N)
+	flux content spam 8192 1024 >/dev/null || return 1
+	run_timeout 60 flux content flush || return 1
+	t1=$(date +%s.%N)
+	flux module remove --rank 0 $module || return 1
+	echo "$t0 $t1" | awk "{ printf \"%.3f\", \$2 - \$1 }"
+}
+
+test_expect_success 'benchmark: content-files vs content-sqlite' '
+	flux setattr content.flush-batch-limit 256 &&
+	T_FILES=$(bench_flush content-files) &&
+	T_SQLITE=$(bench_flush content-sqlite) &&
+	echo "# store+flush: content-files ${T_FILES}s content-sqlite ${T_SQLITE}s"
+'
+
+test_done
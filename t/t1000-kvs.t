@@ -1003,4 +1003,122 @@ test_expect_success 'kvs: get --label works' '
 	flux kvs get --label test.ZZZ |grep test.ZZZ=42
 '
 
+#
+# Multi-key lookup
+#
+
+test_expect_success 'kvs: lookup_multi returns values in key order' '
+	flux kvs put test.multi.a=1 test.multi.b=2 test.multi.c.d=3 &&
+	${FLUX_BUILD_DIR}/t/kvs/lookup_multi \
+		test.multi.c.d test.multi.a test.multi.b >multi.out &&
+	cat >multi.exp <<-EOF &&
+	test.multi.c.d=3
+	test.multi.a=1
+	test.multi.b=2
+	EOF
+	test_cmp multi.exp multi.out
+'
+test_expect_success 'kvs: lookup_multi fails missing keys individually' '
+	${FLUX_BUILD_DIR}/t/kvs/lookup_multi \
+		test.multi.a test.multi.nokey test.multi.b >multi2.out &&
+	grep "^test.multi.a=1\$" multi2.out &&
+	grep "^test.multi.nokey: No such file or directory\$" multi2.out &&
+	grep "^test.multi.b=2\$" multi2.out
+'
+test_expect_success 'kvs: lookup_multi handles duplicate keys' '
+	${FLUX_BUILD_DIR}/t/kvs/lookup_multi \
+		test.multi.a test.multi..a test.multi.a >multi3.out &&
+	test $(grep -c "=1\$" multi3.out) -eq 3
+'
+test_expect_success 'kvs: lookup_multi reports directory per key' '
+	${FLUX_BUILD_DIR}/t/kvs/lookup_multi \
+		test.multi.c test.multi.c.d >multi4.out &&
+	grep "^test.multi.c: Is a directory\$" multi4.out &&
+	grep "^test.multi.c.d=3\$" multi4.out
+'
+test_expect_success 'kvs: lookup_multi fails on other namespace prefix' '
+	${FLUX_BUILD_DIR}/t/kvs/lookup_multi \
+		ns:nosuchns/test.multi.a test.multi.a >multi5.out &&
+	grep "^ns:nosuchns/test.multi.a: Invalid argument\$" multi5.out &&
+	grep "^test.multi.a=1\$" multi5.out
+'
+test_expect_success 'kvs: lookup_multi loads uncached keys after dropcache' '
+	flux kvs put test.multi.e.f=4 test.multi.e.g=5 &&
+	flux kvs dropcache &&
+	${FLUX_BUILD_DIR}/t/kvs/lookup_multi \
+		test.multi.e.f test.multi.c.d test.multi.e.g >multi6.out &&
+	cat >multi6.exp <<-EOF &&
+	test.multi.e.f=4
+	test.multi.c.d=3
+	test.multi.e.g=5
+	EOF
+	test_cmp multi6.exp multi6.out
+'
+test_expect_success 'kvs: lookup_multi on rank 1 loads uncached keys' '
+	flux kvs dropcache --all &&
+	flux exec -n -r 1 ${FLUX_BUILD_DIR}/t/kvs/lookup_multi \
+		test.multi.e.f test.multi.nokey test.multi.c.d >multi7.out &&
+	grep "^test.multi.e.f=4\$" multi7.out &&
+	grep "^test.multi.nokey: No such file or directory\$" multi7.out &&
+	grep "^test.multi.c.d=3\$" multi7.out
+'
+
+#
+# Recursive directory lookup
+#
+
+test_expect_success 'kvs: lookup_subtree fetches whole subtree' '
+	flux kvs put test.subtree.a=1 test.subtree.b.c=2 test.subtree.b.d.e=3 &&
+	${FLUX_BUILD_DIR}/t/kvs/lookup_subtree test.subtree \
+		| LC_ALL=C sort >subtree.out &&
+	cat >subtree.exp <<-EOF &&
+	test.subtree.
+	test.subtree.a=1
+	test.subtree.b.
+	test.subtree.b.
+	test.subtree.b.c=2
+	test.subtree.b.d.
+	test.subtree.b.d.
+	test.subtree.b.d.e=3
+	EOF
+	test_cmp subtree.exp subtree.out
+'
+test_expect_success 'kvs: lookup_subtree --maxdepth limits depth' '
+	test $(${FLUX_BUILD_DIR}/t/kvs/lookup_subtree --count \
+		--maxdepth=0 test.subtree) -eq 1 &&
+	test $(${FLUX_BUILD_DIR}/t/kvs/lookup_subtree --count \
+		--maxdepth=1 test.subtree) -eq 2 &&
+	test $(${FLUX_BUILD_DIR}/t/kvs/lookup_subtree --count \
+		test.subtree) -eq 3
+'
+test_expect_success 'kvs: lookup_subtree --pattern filters values' '
+	${FLUX_BUILD_DIR}/t/kvs/lookup_subtree --pattern="c*" test.subtree \
+		| LC_ALL=C sort >subtree2.out &&
+	cat >subtree2.exp <<-EOF &&
+	test.subtree.
+	test.subtree.b.
+	test.subtree.b.
+	test.subtree.b.c=2
+	test.subtree.b.d.
+	test.subtree.b.d.
+	EOF
+	test_cmp subtree2.exp subtree2.out
+'
+test_expect_success 'kvs: lookup_subtree resolves appended values' '
+	flux kvs put test.subtree.log=foo &&
+	flux kvs put --append test.subtree.log=bar &&
+	${FLUX_BUILD_DIR}/t/kvs/lookup_subtree --maxdepth=0 test.subtree \
+		| grep "^test.subtree.log=foobar\$"
+'
+test_expect_success 'kvs: lookup_subtree works on root directory' '
+	test $(${FLUX_BUILD_DIR}/t/kvs/lookup_subtree --count \
+		--maxdepth=0 .) -eq 1
+'
+test_expect_success 'kvs: lookup_subtree fails on missing key' '
+	test_must_fail ${FLUX_BUILD_DIR}/t/kvs/lookup_subtree test.subtree.nokey
+'
+test_expect_success 'kvs: lookup_subtree fails on value' '
+	test_must_fail ${FLUX_BUILD_DIR}/t/kvs/lookup_subtree test.subtree.a
+'
+
 test_done
@@ -395,4 +395,43 @@ test_expect_success 'kvs: test invalid fence arguments on rank 1' '
         grep "flux_future_get: Invalid argument" invalid_output
 '
 
+#
+# content cache prefetch on setroot
+#
+
+test_expect_success 'content.prefetch=1 on rank 1 prefetches new root blobs' '
+        flux exec -n -r 1 flux setattr content.prefetch 1 &&
+        P=`flux exec -n -r 1 flux module stats --type int \
+                --parse prefetch content` &&
+        flux kvs put --json $DIR.prefetch.a=1 $DIR.prefetch.b.c=2 &&
+        for i in `seq 1 20`; do \
+                P2=`flux exec -n -r 1 flux module stats --type int \
+                        --parse prefetch content` && \
+                test $P2 -gt $P && break; \
+                sleep 0.5; \
+        done &&
+        test $P2 -gt $P &&
+        flux exec -n -r 1 flux kvs get --json $DIR.prefetch.b.c &&
+        flux exec -n -r 1 flux setattr content.prefetch 0
+'
+
+# Concurrent loads may not overlap on a given try, so retry a few times.
+test_expect_success 'content cache coalesces concurrent loads of a blob' '
+        LAST=$((${SIZE}-1)) &&
+        REF=`dd if=/dev/urandom bs=4096 count=1 2>/dev/null \
+                | flux content store` &&
+        C=`flux exec -n -r $LAST flux module stats --type int \
+                --parse load-coalesced content` &&
+        for i in `seq 1 10`; do \
+                flux exec -n -r $LAST flux content dropcache && \
+                flux exec -n -r $LAST sh -c "for j in \`seq 1 8\`; do \
+                        flux content load $REF >/dev/null & \
+                        done; wait" && \
+                C2=`flux exec -n -r $LAST flux module stats --type int \
+                        --parse load-coalesced content` && \
+                test $C2 -gt $C && break; \
+        done &&
+        test $C2 -gt $C
+'
+
 test_done
@@ -113,6 +113,174 @@ test_expect_success LONGTEST 'kvs: store 1,000,000 keys in one dir' '
 	${FLUX_BUILD_DIR}/t/kvs/torture --prefix $DIR.bigdir2 --count 1000000
 '
 
+# sharded directories
+#
+# dirsize prints "entries commit-ms stored-bytes" for single key commits
+# as a directory doubles in size.  Once a directory is split into an hdir,
+# the bytes stored per commit should no longer grow with its size.
+
+test_expect_success 'kvs: single key commit cost as directory grows' '
+	${FLUX_BUILD_DIR}/t/kvs/dirsize --prefix $DIR.dirsize \
+		--start 64 --max 16384 --samples 10 >dirsize.out &&
+	sed -e "s/^/# /" dirsize.out &&
+	test $(wc -l <dirsize.out) -eq 9 &&
+	test $(tail -1 dirsize.out | cut -d" " -f3) -lt 65536
+'
+
+test_expect_success 'kvs: sharded directory can be listed and read' '
+	test $(flux kvs dir $DIR.dirsize | wc -l) -eq 16384 &&
+	test $(flux kvs ls -1 $DIR.dirsize | wc -l) -eq 16384 &&
+	flux kvs get $DIR.dirsize.key12345 &&
+	test $(flux kvs get $DIR.dirsize.key16383) -eq 16383
+'
+
+test_expect_success 'kvs: sharded directory can be read after dropcache' '
+	flux kvs dropcache &&
+	test $(flux kvs get $DIR.dirsize.key16383) -eq 16383 &&
+	test $(flux kvs dir $DIR.dirsize | wc -l) -eq 16384
+'
+
+test_expect_success 'kvs: keys can be added to and removed from sharded directory' '
+	flux kvs put $DIR.dirsize.newkey=foo &&
+	test "$(flux kvs get $DIR.dirsize.newkey)" = "foo" &&
+	flux kvs unlink $DIR.dirsize.key0 $DIR.dirsize.newkey &&
+	test_must_fail flux kvs get $DIR.dirsize.key0 &&
+	test $(flux kvs dir $DIR.dirsize | wc -l) -eq 16383
+'
+
+test_expect_success 'kvs: subdirectory of sharded directory works' '
+	flux kvs put $DIR.dirsize.subdir.a=42 &&
+	test $(flux kvs get $DIR.dirsize.subdir.a) -eq 42 &&
+	flux kvs unlink -R $DIR.dirsize &&
+	test_must_fail flux kvs get $DIR.dirsize.subdir.a
+'
+
+# content batching benchmark
+#
+# Compare the number of content.store messages received by the rank 0
+# content cache per key committed, with and without KVS content batching.
+
+store_msgs_per_key() {
+	local prefix=$1
+	local before=`flux module stats --type int --parse store-requests content`
+	${FLUX_BUILD_DIR}/t/kvs/torture --prefix $prefix --count 1000 || return 1
+	local after=`flux module stats --type int --parse store-requests content`
+	echo $before $after | awk "{ printf \"%.3f\", (\$2 - \$1) / 1000 }"
+}
+
+test_expect_success 'kvs: content batching reduces store messages per key' '
+	BATCHED=$(store_msgs_per_key $DIR.cbatch.on) &&
+	flux module remove -r 0 kvs &&
+	flux module load -r 0 kvs content-batch=0 &&
+	UNBATCHED=$(store_msgs_per_key $DIR.cbatch.off) &&
+	flux module remove -r 0 kvs &&
+	flux module load -r 0 kvs &&
+	echo "# store messages per key: batched=$BATCHED unbatched=$UNBATCHED" &&
+	echo $BATCHED $UNBATCHED | awk "{ exit (\$1 <= \$2) ? 0 : 1 }"
+'
+
+test_expect_success 'kvs: values round trip with content-compress=1' '
+	flux module remove -r 0 kvs &&
+	flux module load -r 0 kvs content-compress=1 &&
+	VAL="$(seq 1 5000 | tr "\n" " ")" &&
+	flux kvs put $DIR.compress.big="$VAL" &&
+	${FLUX_BUILD_DIR}/t/kvs/torture --prefix $DIR.compress --count 100 &&
+	flux kvs dropcache &&
+	test "$(flux kvs get $DIR.compress.big)" = "$VAL" &&
+	flux module remove -r 0 kvs &&
+	flux module load -r 0 kvs
+'
+
+# parallel commit benchmark
+#
+# nscommit prints "namespaces commits elapsed-ms commits/s" for rounds
+# of commits to many namespaces at once, as with a guest namespace per job.
+# With commit-workers=N, transactions for different namespaces should be
+# processed together on the commit pool.
+
+nscommit_rate() {
+	local prefix=$1
+	${FLUX_BUILD_DIR}/t/kvs/nscommit --prefix $prefix \
+		--namespaces 64 --rounds 10 --keys 64 >$prefix.out || return 1
+	cut -d" " -f4 $prefix.out
+}
+
+test_expect_success 'kvs: commits to many namespaces with commit-workers=4' '
+	SERIAL=$(nscommit_rate nscommit-serial) &&
+	flux module remove -r 0 kvs &&
+	flux module load -r 0 kvs commit-workers=4 &&
+	PARALLEL=$(nscommit_rate nscommit-parallel) &&
+	echo "# commits/s: serial=$SERIAL commit-workers=4=$PARALLEL" &&
+	test $(flux module stats --type int \
+		--parse "commit.#parallel batches" kvs) -gt 0
+'
+
+test_expect_success 'kvs: primary namespace works with commit-workers=4' '
+	${FLUX_BUILD_DIR}/t/kvs/torture --prefix $DIR.parallel --count 100 &&
+	flux kvs dropcache &&
+	flux kvs get $DIR.parallel.key99 &&
+	flux module remove -r 0 kvs &&
+	flux module load -r 0 kvs
+'
+
+# copy-on-write directories
+#
+# Commit single keys under a deep path whose directories each hold 200
+# entries (below the hdir split size).  Only directories along the key
+# path are copied and rehashed, so the cost should not depend on the
+# size of their siblings.
+
+test_expect_success 'kvs: commits under wide directories on a deep path' '
+	for d in a a.b a.b.c a.b.c.d; do
+		${FLUX_BUILD_DIR}/t/kvs/torture --prefix $DIR.cow.$d \
+			--count 200 || return 1
+	done &&
+	${FLUX_BUILD_DIR}/t/kvs/commit --stats 4 100 $DIR.cow.a.b.c.d \
+		>cow.out &&
+	sed -e "s/^/# /" cow.out &&
+	test $(flux kvs dir $DIR.cow.a.b.c.d | wc -l) -eq 201 &&
+	flux kvs get $DIR.cow.a.b.key199
+'
+
+# adaptive merge window
+#
+# With merge-delay, a ready transaction may be held while more arrive so
+# bursts of small commits are merged in larger batches.  Compare the
+# merge size and commit latency percentiles from kvs.stats.get with and
+# without the window.
+
+merge_stats() {
+	local name=$1
+	flux module stats --clear kvs &&
+	${FLUX_BUILD_DIR}/t/kvs/commit --stats 16 100 $DIR.$name >$name.out &&
+	echo "# $name: merge size p50=$(flux module stats --type double \
+		--parse "commit.merge size.p50" kvs)" \
+		"p99=$(flux module stats --type double \
+		--parse "commit.merge size.p99" kvs)" \
+		"latency usec p50=$(flux module stats --type double \
+		--parse "commit.latency (usec).p50" kvs)" \
+		"p99=$(flux module stats --type double \
+		--parse "commit.latency (usec).p99" kvs)"
+}
+
+test_expect_success 'kvs: commits with and without merge window' '
+	merge_stats merge-nowindow &&
+	flux module remove -r 0 kvs &&
+	flux module load -r 0 kvs merge-delay=2 merge-batch=64 &&
+	merge_stats merge-window &&
+	test $(flux module stats --type int \
+		--parse "commit.merge size.count" kvs) -gt 0 &&
+	test $(flux module stats --type int \
+		--parse "commit.merge delay (ms)" kvs) -eq 2
+'
+
+test_expect_success 'kvs: merge window does not affect no-merge commits' '
+	${FLUX_BUILD_DIR}/t/kvs/commit --nomerge 1 4 20 $DIR.merge-nomerge &&
+	test $(flux kvs dir -R $DIR.merge-nomerge | wc -l) -eq 80 &&
+	flux module remove -r 0 kvs &&
+	flux module load -r 0 kvs
+'
+
 # kvs merging tests
 
 # If transaction-merge=1 and we set KVS_NO_MERGE on all commits, this test
@@ -44,6 +44,28 @@ test_expect_success NO_CHAIN_LINT 'kvs-watch stats reports active watcher' '
        wait $pid
 '
 
+test_expect_success NO_CHAIN_LINT 'kvs-watch shares one lookup among watchers of a key' '
+	flux kvs put test.shared=0 &&
+	pids="" &&
+	for i in $(seq 1 8); do
+		flux kvs get --watch --count=2 test.shared >shared.$i.out &
+		pids="$pids $!"
+	done &&
+	for i in $(seq 1 8); do
+		$waitfile --count=1 --timeout=10 --pattern="[0-9]+" shared.$i.out \
+			|| return 1
+	done &&
+	before=$(flux module stats --parse=lookups kvs-watch) &&
+	flux kvs put --no-merge test.shared=1 &&
+	wait $pids &&
+	after=$(flux module stats --parse=lookups kvs-watch) &&
+	test $((after-before)) -eq 1 &&
+	printf "0\n1\n" >shared.exp &&
+	for i in $(seq 1 8); do
+		test_cmp shared.exp shared.$i.out || return 1
+	done
+'
+
 # Check that stdin contains an integer on each line that
 # is one more than the integer on the previous line.
 test_monotonicity() {
@@ -43,4 +43,15 @@ test_expect_success NO_CHAIN_LINT 'flux kvs eventlog get --watch returns append
 	wait $pid &&
 	test_cmp get_d.exp get_d.out
 '
+
+test_expect_success NO_CHAIN_LINT 'flux kvs eventlog get --watch fails if eventlog is overwritten' '
+	for i in $(seq 1 3); do \
+		flux kvs eventlog append --timestamp=$i test.e foo; \
+	done &&
+	flux kvs eventlog get --unformatted --watch --count=10 test.e >get_e.out &
+	pid=$! &&
+	$waitfile --count=3 --timeout=10 --pattern="foo" get_e.out &&
+	flux kvs put test.e="4.000000 bar" &&
+	! wait $pid
+'
 test_done
@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+
+test_description='Test shm:// connector
+
+Verify that clients can exchange messages with the broker through
+shared memory, and compare round trip times with local://.
+'
+
+. `dirname $0`/sharness.sh
+test_under_flux 2 kvs
+
+SHM_URI=$(echo $FLUX_URI | sed -e 's|^local://|shm://|')
+TREQ=${FLUX_BUILD_DIR}/t/request/treq
+
+# local.shm fails with ENOSYS if the broker was built without memfd_create
+if FLUX_URI=$SHM_URI flux getattr rank >/dev/null 2>&1; then
+	test_set_prereq SHM
+fi
+
+test_expect_success 'shm: load req module on rank 0' '
+	flux module load --rank=0 ${FLUX_BUILD_DIR}/t/request/.libs/req.so
+'
+
+test_expect_success 'shm: load req module on rank 1' '
+	flux module load --rank=1 ${FLUX_BUILD_DIR}/t/request/.libs/req.so
+'
+
+test_expect_success SHM 'shm: flux getattr works over shm://' '
+	FLUX_URI=$SHM_URI flux getattr rank >rank.out &&
+	test "$(cat rank.out)" = "0"
+'
+
+test_expect_success SHM 'shm: simple rpc with no payload' '
+	FLUX_URI=$SHM_URI $TREQ null
+'
+
+test_expect_success SHM 'shm: rpc with echoed payload' '
+	FLUX_URI=$SHM_URI $TREQ echo
+'
+
+test_expect_success SHM 'shm: rpc to rank 1' '
+	FLUX_URI=$SHM_URI $TREQ --rank 1 echo
+'
+
+test_expect_success SHM 'shm: rpc with error response' '
+	FLUX_URI=$SHM_URI $TREQ err
+'
+
+test_expect_success SHM 'shm: 10K responses to one request (nsrc)' '
+	FLUX_URI=$SHM_URI $TREQ nsrc
+'
+
+test_expect_success SHM 'shm: 10K pipelined rpcs fill the rings (flood)' '
+	FLUX_URI=$SHM_URI $TREQ flood >flood.out &&
+	cat flood.out &&
+	grep "^flood: 10000 rpcs" flood.out
+'
+
+test_expect_success SHM 'shm: event subscription works' '
+	FLUX_URI=$SHM_URI run_timeout 10 flux event sub --count=1 hb
+'
+
+test_expect_success SHM 'shm: payload larger than a ring record' '
+	dd if=/dev/urandom bs=4096 count=1024 2>/dev/null | base64 -w0 \
+		>big.in &&
+	flux kvs put --raw test.big=- <big.in &&
+	FLUX_URI=$SHM_URI flux kvs get --raw test.big >big.out &&
+	test_cmp big.in big.out
+'
+
+test_expect_success SHM 'shm: sequential rpc round trip time vs local://' '
+	$TREQ rtt >rtt.local &&
+	FLUX_URI=$SHM_URI $TREQ rtt >rtt.shm &&
+	echo "local://: $(cat rtt.local)" &&
+	echo "shm://:   $(cat rtt.shm)" &&
+	grep "^rtt: 10000 rpcs" rtt.shm
+'
+
+test_expect_success SHM 'shm: pipelined rpc throughput vs local://' '
+	$TREQ flood >flood.local &&
+	FLUX_URI=$SHM_URI $TREQ flood >flood.shm &&
+	echo "local://: $(cat flood.local)" &&
+	echo "shm://:   $(cat flood.shm)"
+'
+
+test_expect_success 'shm: unload req module on rank 1' '
+	flux module remove --rank=1 req
+'
+
+test_expect_success 'shm: unload req module on rank 0' '
+	flux module remove --rank=0 req
+'
+
+test_done
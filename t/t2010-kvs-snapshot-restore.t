@@ -38,4 +38,122 @@ test_expect_success 'recover KVS snapshot from persist-directory in new instance
 	test_cmp testkey.exp testkey.out
 '
 
+test_expect_success 'run instance with binary treeobj encoding' '
+	run_timeout 10 \
+	    flux start -o,--setattr=persist-directory=$PERSISTDIR \
+	        -o,--setattr=kvs.treeobj-encoding=binary \
+	        "flux kvs put --treeobj snap=- <$PERSISTDIR/kvsroot.final && \
+		    flux kvs put bintest=43 && \
+		    flux kvs get snap.testkey >testkey2.out && \
+		    flux kvs get bintest >bintest.out && \
+		    flux content load \$(flux kvs getroot --blobref) \
+		        | head -c2 | od -An -tx1 >rootblob.out" &&
+	test_cmp testkey.exp testkey2.out &&
+	echo 43 >bintest.exp &&
+	test_cmp bintest.exp bintest.out &&
+	echo " 00 54" >rootblob.exp &&
+	test_cmp rootblob.exp rootblob.out
+'
+
+test_expect_success 'binary treeobjs are readable with json encoding' '
+	run_timeout 10 \
+	    flux start -o,--setattr=persist-directory=$PERSISTDIR \
+	        "flux kvs put --treeobj snap=- <$PERSISTDIR/kvsroot.final && \
+		    flux kvs get snap.bintest >bintest2.out" &&
+	test_cmp bintest.exp bintest2.out
+'
+
+test_expect_success 'invalid kvs.treeobj-encoding fails' '
+	test_must_fail run_timeout 10 \
+	    flux start -o,--setattr=kvs.treeobj-encoding=foo /bin/true
+'
+
+test_expect_success 'created persist-directory for checkpoint tests' '
+	CKPTDIR=$(mktemp -d --tmpdir=$(pwd))
+'
+
+test_expect_success 'run instance that populates the KVS' '
+	flux start -o,--setattr=persist-directory=$CKPTDIR \
+	    "flux kvs put ckpt.a.b.c=42 ckpt.d=43 && \
+	     flux kvs getroot --sequence >seq1.out"
+'
+
+test_expect_success 'KVS is restored from checkpoint without kvsroot.final' '
+	run_timeout 10 \
+	    flux start -o,--setattr=persist-directory=$CKPTDIR \
+	        "flux kvs get ckpt.a.b.c >ckpt_abc.out && \
+		 flux kvs get ckpt.d >ckpt_d.out && \
+		 flux kvs getroot --sequence >seq2.out && \
+		 flux module stats --type int --parse checkpoint.#primed kvs \
+		     >primed.out" &&
+	echo 42 >ckpt_abc.exp &&
+	echo 43 >ckpt_d.exp &&
+	test_cmp ckpt_abc.exp ckpt_abc.out &&
+	test_cmp ckpt_d.exp ckpt_d.out
+'
+
+test_expect_success 'root sequence number continues from checkpoint' '
+	test $(cat seq2.out) -ge $(cat seq1.out)
+'
+
+test_expect_success 'cache was primed with hot directories' '
+	test $(cat primed.out) -gt 0
+'
+
+test_expect_success 'KVS is restored from checkpoint after module reload' '
+	run_timeout 10 \
+	    flux start -o,--setattr=persist-directory=$CKPTDIR \
+	        "flux kvs put ckpt.e=44 && \
+		 flux module remove kvs-watch && \
+		 flux module remove kvs && \
+		 flux module load kvs && \
+		 flux module load kvs-watch && \
+		 flux kvs get ckpt.e >ckpt_e.out" &&
+	echo 44 >ckpt_e.exp &&
+	test_cmp ckpt_e.exp ckpt_e.out
+'
+
+test_expect_success 'KVS starts empty without a checkpoint' '
+	EMPTYDIR=$(mktemp -d --tmpdir=$(pwd)) &&
+	run_timeout 10 \
+	    flux start -o,--setattr=persist-directory=$EMPTYDIR \
+	        "! flux kvs get ckpt.d"
+'
+
+command -v sqlite3 >/dev/null && test_set_prereq SQLITE3
+
+test_expect_success SQLITE3 'checkpoint is kept in content database' '
+	sqlite3 $CKPTDIR/content/sqlite \
+	    "SELECT value FROM checkpt WHERE key = '"'"'kvs-primary'"'"'" \
+	    >checkpt.out &&
+	grep -q rootref checkpt.out
+'
+
+test_expect_success SQLITE3 'create content database with legacy schema' '
+	LEGACYDIR=$(mktemp -d --tmpdir=$(pwd)) &&
+	mkdir $LEGACYDIR/content &&
+	printf "legacy blob" >legacy.blob &&
+	LEGACYHASH=$(sha1sum legacy.blob | cut -d" " -f1) &&
+	sqlite3 $LEGACYDIR/content/sqlite \
+	    "CREATE TABLE objects(hash CHAR(20) PRIMARY KEY, size INT, object BLOB);
+	     INSERT INTO objects VALUES (CAST(X'"'"'$LEGACYHASH'"'"' AS TEXT),
+	         -1, CAST('"'"'legacy blob'"'"' AS BLOB));"
+'
+
+test_expect_success SQLITE3 'legacy content can be loaded by new instance' '
+	run_timeout 10 \
+	    flux start -o,--setattr=persist-directory=$LEGACYDIR \
+	        flux content load --bypass-cache sha1-$LEGACYHASH >legacy.out &&
+	test_cmp legacy.blob legacy.out
+'
+
+test_expect_success SQLITE3 'content database was migrated to schema v2' '
+	test $(sqlite3 $LEGACYDIR/content/sqlite "PRAGMA user_version") -eq 2 &&
+	test $(sqlite3 $LEGACYDIR/content/sqlite \
+	    "SELECT count(*) FROM objects_small
+	     WHERE hash = X'"'"'$LEGACYHASH'"'"'") -eq 1 &&
+	test $(sqlite3 $LEGACYDIR/content/sqlite \
+	    "SELECT count(*) FROM sqlite_master WHERE name = '"'"'objects'"'"'") -eq 0
+'
+
 test_done